@@ -0,0 +1,688 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyLP/lp_problem.hpp"
+#include "TeensyOpt/TeensyLP/qp_problem.hpp"
+#include "TeensyOpt/TeensyMat/factorize.hpp"
+#include "TeensyOpt/TeensyMat/linalg.hpp"
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+
+namespace teensylp {
+/*! Options of ActiveSetQP*/
+template <typename Scalar> struct ActiveSetOptions {
+  /*! Maximum number of additions and removals of working set constraints
+   * per solve*/
+  size_t max_iterations = 10000;
+  /*! Violation of a constraint (relative to 1 + |bound|) that is
+   * tolerated*/
+  Scalar feasibility_tolerance = 1e-9;
+  /*! Constraints whose normals make an angle with a sine below this with
+   * the span of the working set normals are treated as linearly
+   * dependent on them*/
+  Scalar dependence_tolerance = 1e-10;
+};
+
+/*! Dual active set method of Goldfarb and Idnani for dense, strictly
+ * convex QPs
+ *
+ *     minimize 1/2 x^T H x + g^T x
+ *     subject to lower_i <= a_i^T x <= upper_i
+ *
+ * with H positive definite. Starting from the unconstrained minimum, the
+ * most violated constraint is added to the working set in every step,
+ * dropping working constraints whose multipliers reach zero on the way,
+ * so the iterates stay dual feasible and the first primal feasible one
+ * is optimal. Equality rows (lower == upper) are added first and never
+ * dropped.
+ *
+ * With H = L L^T and N the normals of the working set, the method keeps
+ * J = L^-T Q and R from the QR factorization L^-1 N = Q [R; 0]. Adding or
+ * dropping a constraint updates J and R by Givens rotations in O(n^2)
+ * instead of refactoring. J is stored transposed, so its columns are
+ * contiguous.
+ *
+ * Constraint rows live in one growable row major block, so constraints
+ * can be added between solves. Every solve after the first is hot started
+ * from the previous working set: only the constraints whose rows changed
+ * are dropped from the factorization, the iterate is recomputed from the
+ * remaining ones and constraints with multipliers of the wrong sign are
+ * dropped, which restores the invariants of the method. A new Hessian is
+ * refactored and the previous working set added back.
+ * */
+template <typename Scalar> class ActiveSetQP {
+  /*! Number of variables*/
+  size_t n;
+  /*! Options of the solves*/
+  ActiveSetOptions<Scalar> options;
+  /*! The Hessian H and the linear cost g*/
+  teensymat::Matrix<Scalar> hessian;
+  std::vector<Scalar> gradient;
+  /*! Constraint rows (row major, n per row), growable*/
+  std::vector<Scalar> rows;
+  /*! Bounds of the constraints*/
+  std::vector<Scalar> lower, upper;
+  /*! Whether the row of a constraint changed since the last solve*/
+  std::vector<bool> row_changed;
+  /*! Whether the Hessian changed since the last solve*/
+  bool hessian_changed;
+  /*! J^T (row j is column j of J)*/
+  teensymat::Matrix<Scalar> jt;
+  /*! R (upper triangular, the leading q by q block is used)*/
+  teensymat::Matrix<Scalar> r_factor;
+  /*! The working set: constraint indices, sides (1 for the lower bound,
+   * -1 for the upper one) and multipliers u (of the normal side * a_i)*/
+  std::vector<size_t> working;
+  std::vector<int> working_side;
+  std::vector<Scalar> multipliers;
+  /*! Side of each constraint in the working set, 0 if it is not*/
+  std::vector<int> side;
+  /*! Equality rows found redundant in the current solve*/
+  std::vector<bool> redundant;
+  /*! The iterate*/
+  std::vector<Scalar> x;
+  /*! Workspace: J^T n_p, the step direction z, R^-1 d and the normal*/
+  std::vector<Scalar> d, z, r, normal;
+  /*! Counters*/
+  size_t num_factorizations, num_updates, iterations;
+
+  // SECTION: Constraint data
+  Scalar const *row(size_t i) const { return &this->rows[i * this->n]; }
+  bool is_equality(size_t i) const {
+    return this->lower[i] == this->upper[i];
+  }
+  /*! Right hand side b of the constraint side * a_i^T x >= b*/
+  Scalar rhs(size_t i, int side) const {
+    return side > 0 ? this->lower[i] : -this->upper[i];
+  }
+  /*! Slack side * a_i^T x - b of a side of a constraint*/
+  Scalar slack(size_t i, int side) const {
+    return side * teensymat::dot(this->n, this->row(i), this->x.data()) -
+           this->rhs(i, side);
+  }
+  /*! Whether a slack counts as a violation*/
+  bool violated(Scalar slack, Scalar bound) const {
+    return slack <
+           -this->options.feasibility_tolerance * (1 + std::abs(bound));
+  }
+
+  // SECTION: Factorization updates
+  size_t working_size() const { return this->working.size(); }
+  Scalar *jt_col(size_t j) { return &(*this->jt.get_data())[j * this->n]; }
+  Scalar &r_at(size_t i, size_t j) {
+    return (*this->r_factor.get_data())[i * this->n + j];
+  }
+  /*! Factor H and set J = L^-T with an empty working set*/
+  void factor_hessian() {
+    size_t n = this->n;
+    teensymat::CholeskyFactorization<Scalar> cholesky{this->hessian};
+    // L^T is upper triangular, and so is its inverse J
+    teensymat::Matrix<Scalar> upper{n, n};
+    Scalar *u = upper.get_data()->data();
+    auto const &factor = cholesky.get_factor();
+    for (size_t i = 0; i < n; i++) {
+      for (size_t j = 0; j <= i; j++) {
+        u[j * n + i] = *factor(i, j);
+      }
+    }
+    teensymat::factorize_detail::invert_upper_inplace(n, u, n);
+    Scalar *jt = this->jt.get_data()->data();
+    for (size_t i = 0; i < n; i++) {
+      for (size_t j = 0; j < n; j++) {
+        jt[j * n + i] = u[i * n + j];
+      }
+    }
+    std::fill(this->r_factor.get_data()->begin(),
+              this->r_factor.get_data()->end(), Scalar{0});
+    this->num_factorizations++;
+  }
+  /*! Load the normal of a side of a constraint and compute d = J^T n_p,
+   * the step z = J_2 d_2 in the null space of the working set and
+   * r = R^-1 d_1.
+   *
+   * @return z^T n_p = ||d_2||^2, or zero if the normal is linearly
+   * dependent on the working set
+   * */
+  Scalar directions(size_t i, int side) {
+    size_t n = this->n;
+    size_t q = this->working_size();
+    Scalar const *a = this->row(i);
+    for (size_t k = 0; k < n; k++) {
+      this->normal[k] = side * a[k];
+    }
+    Scalar norm = 0;
+    Scalar projected = 0;
+    std::fill(this->z.begin(), this->z.end(), Scalar{0});
+    for (size_t j = 0; j < n; j++) {
+      Scalar value = teensymat::dot(n, this->jt_col(j), this->normal.data());
+      this->d[j] = value;
+      norm += value * value;
+      if (j >= q) {
+        projected += value * value;
+        teensymat::axpy(n, value, this->jt_col(j), this->z.data());
+      }
+    }
+    for (size_t j = q; j-- > 0;) {
+      Scalar sum = this->d[j];
+      for (size_t k = j + 1; k < q; k++) {
+        sum -= this->r_at(j, k) * this->r[k];
+      }
+      this->r[j] = sum / this->r_at(j, j);
+    }
+    Scalar tolerance = this->options.dependence_tolerance;
+    return projected <= tolerance * tolerance * norm ? Scalar{0} : projected;
+  }
+  /*! Rotate columns j and k of J so that (d_j, d_k) becomes (h, 0),
+   * applying the same rotation to d*/
+  void rotate_j(size_t j, size_t k, Scalar *first, Scalar *second) {
+    Scalar h = std::hypot(*first, *second);
+    if (h == Scalar{0}) {
+      return;
+    }
+    Scalar c = *first / h;
+    Scalar s = *second / h;
+    *first = h;
+    *second = 0;
+    Scalar *col_j = this->jt_col(j);
+    Scalar *col_k = this->jt_col(k);
+    for (size_t i = 0; i < this->n; i++) {
+      Scalar a = col_j[i];
+      Scalar b = col_k[i];
+      col_j[i] = c * a + s * b;
+      col_k[i] = c * b - s * a;
+    }
+  }
+  /*! Add the side of a constraint whose d = J^T n_p is current to the
+   * working set (with multiplier u)*/
+  void add_working(size_t i, int side, Scalar u) {
+    size_t q = this->working_size();
+    for (size_t j = this->n - 1; j > q; j--) {
+      this->rotate_j(j - 1, j, &this->d[j - 1], &this->d[j]);
+    }
+    for (size_t k = 0; k <= q; k++) {
+      this->r_at(k, q) = this->d[k];
+    }
+    this->working.push_back(i);
+    this->working_side.push_back(side);
+    this->multipliers.push_back(u);
+    this->side[i] = side;
+    this->num_updates++;
+  }
+  /*! Drop the constraint at position l of the working set, restoring the
+   * triangular R by rotations*/
+  void drop_working(size_t l) {
+    size_t q = this->working_size();
+    for (size_t i = 0; i < q; i++) {
+      for (size_t j = l; j + 1 < q; j++) {
+        this->r_at(i, j) = this->r_at(i, j + 1);
+      }
+      this->r_at(i, q - 1) = 0;
+    }
+    // R is upper Hessenberg from column l on
+    for (size_t j = l; j + 1 < q; j++) {
+      Scalar a = this->r_at(j, j);
+      Scalar b = this->r_at(j + 1, j);
+      Scalar h = std::hypot(a, b);
+      if (h == Scalar{0}) {
+        continue;
+      }
+      Scalar c = a / h;
+      Scalar s = b / h;
+      for (size_t k = j; k + 1 < q; k++) {
+        Scalar top = this->r_at(j, k);
+        Scalar bottom = this->r_at(j + 1, k);
+        this->r_at(j, k) = c * top + s * bottom;
+        this->r_at(j + 1, k) = c * bottom - s * top;
+      }
+      Scalar *col_j = this->jt_col(j);
+      Scalar *col_k = this->jt_col(j + 1);
+      for (size_t i = 0; i < this->n; i++) {
+        Scalar top = col_j[i];
+        Scalar bottom = col_k[i];
+        col_j[i] = c * top + s * bottom;
+        col_k[i] = c * bottom - s * top;
+      }
+    }
+    this->side[this->working[l]] = 0;
+    this->working.erase(this->working.begin() + l);
+    this->working_side.erase(this->working_side.begin() + l);
+    this->multipliers.erase(this->multipliers.begin() + l);
+    this->num_updates++;
+  }
+
+  // SECTION: Hot start
+  /*! Bring the factorization up to date with the data: refactor after a
+   * new Hessian (adding the previous working set back), and drop working
+   * constraints whose rows changed or whose sides are gone*/
+  void update_working_set() {
+    std::vector<size_t> previous;
+    std::vector<int> previous_side;
+    if (this->hessian_changed) {
+      previous = this->working;
+      previous_side = this->working_side;
+      for (size_t i : this->working) {
+        this->side[i] = 0;
+      }
+      this->working.clear();
+      this->working_side.clear();
+      this->multipliers.clear();
+      this->factor_hessian();
+      this->hessian_changed = false;
+    }
+    for (size_t l = this->working_size(); l-- > 0;) {
+      size_t i = this->working[l];
+      int side = this->working_side[l];
+      if (this->row_changed[i] || !std::isfinite(this->rhs(i, side))) {
+        this->drop_working(l);
+      }
+    }
+    for (size_t k = 0; k < previous.size(); k++) {
+      size_t i = previous[k];
+      if (!this->row_changed[i] &&
+          std::isfinite(this->rhs(i, previous_side[k])) &&
+          this->directions(i, previous_side[k]) > Scalar{0}) {
+        this->add_working(i, previous_side[k], 0);
+      }
+    }
+    std::fill(this->row_changed.begin(), this->row_changed.end(), false);
+  }
+  /*! Set x to the minimum over the working set as equalities,
+   *
+   *     x = -J_2 J_2^T g + J_1 R^-T b,
+   *
+   * and the multipliers to R^-1 J_1^T (H x + g)*/
+  void working_set_minimum() {
+    size_t n = this->n;
+    size_t q = this->working_size();
+    std::fill(this->x.begin(), this->x.end(), Scalar{0});
+    // R^T w = b, in r
+    for (size_t j = 0; j < q; j++) {
+      Scalar sum = this->rhs(this->working[j], this->working_side[j]);
+      for (size_t k = 0; k < j; k++) {
+        sum -= this->r_at(k, j) * this->r[k];
+      }
+      this->r[j] = sum / this->r_at(j, j);
+    }
+    for (size_t j = 0; j < n; j++) {
+      Scalar *col = this->jt_col(j);
+      Scalar weight =
+          j < q ? this->r[j]
+                : -teensymat::dot(n, col, this->gradient.data());
+      teensymat::axpy(n, weight, col, this->x.data());
+    }
+    // Multipliers from the stationarity H x + g = N u
+    std::copy(this->gradient.begin(), this->gradient.end(), this->z.begin());
+    teensymat::gemv(n, n, Scalar{1}, this->hessian.get_data()->data(), n,
+                    this->x.data(), this->z.data());
+    for (size_t j = 0; j < q; j++) {
+      this->d[j] = teensymat::dot(n, this->jt_col(j), this->z.data());
+    }
+    for (size_t j = q; j-- > 0;) {
+      Scalar sum = this->d[j];
+      for (size_t k = j + 1; k < q; k++) {
+        sum -= this->r_at(j, k) * this->multipliers[k];
+      }
+      this->multipliers[j] = sum / this->r_at(j, j);
+    }
+  }
+  /*! Recompute the iterate of the working set and drop inequality
+   * constraints with negative multipliers (the most negative first) until
+   * the iterate is dual feasible*/
+  void restore_dual_feasibility() {
+    while (true) {
+      this->working_set_minimum();
+      size_t worst = this->working_size();
+      Scalar most_negative = -this->options.feasibility_tolerance;
+      for (size_t j = 0; j < this->working_size(); j++) {
+        if (!this->is_equality(this->working[j]) &&
+            this->multipliers[j] < most_negative) {
+          most_negative = this->multipliers[j];
+          worst = j;
+        }
+      }
+      if (worst == this->working_size()) {
+        return;
+      }
+      this->drop_working(worst);
+    }
+  }
+
+  // SECTION: Iterations
+  /*! Choose the constraint to add: an equality row outside the working
+   * set if there is one, else the most violated side of an inequality.
+   *
+   * @return Whether a constraint was chosen, with its index and side
+   * */
+  bool choose(size_t &chosen, int &chosen_side) {
+    size_t m = this->get_num_constraints();
+    Scalar worst = 0;
+    bool found = false;
+    for (size_t i = 0; i < m; i++) {
+      if (this->side[i] != 0) {
+        continue;
+      }
+      Scalar activity = teensymat::dot(this->n, this->row(i), this->x.data());
+      if (this->is_equality(i)) {
+        Scalar residual = activity - this->lower[i];
+        if (this->redundant[i] && !this->violated(-std::abs(residual),
+                                                  this->lower[i])) {
+          continue;
+        }
+        chosen = i;
+        chosen_side = residual > 0 ? -1 : 1;
+        return true;
+      }
+      for (int s : {1, -1}) {
+        Scalar bound = s > 0 ? this->lower[i] : this->upper[i];
+        if (!std::isfinite(bound)) {
+          continue;
+        }
+        Scalar value = s * (activity - bound);
+        // Relative violation, so rows of any scale compare
+        Scalar relative = value / (1 + std::abs(bound));
+        if (this->violated(value, bound) && relative < worst) {
+          worst = relative;
+          chosen = i;
+          chosen_side = s;
+          found = true;
+        }
+      }
+    }
+    return found;
+  }
+  /*! Add a violated constraint, taking partial steps that drop working
+   * constraints until it can be added.
+   *
+   * @return LPStatus::optimal once the constraint is added (or found
+   * redundant), else why it could not be
+   * */
+  LPStatus add_violated(size_t p, int side) {
+    Scalar slack = this->slack(p, side);
+    Scalar u_p = 0;
+    while (true) {
+      if (this->iterations >= this->options.max_iterations) {
+        return LPStatus::iteration_limit;
+      }
+      this->iterations++;
+      Scalar projected = this->directions(p, side);
+      size_t q = this->working_size();
+      // Largest dual step keeping the inequality multipliers nonnegative
+      Scalar inf = std::numeric_limits<Scalar>::infinity();
+      Scalar partial = inf;
+      size_t leaving = q;
+      for (size_t j = 0; j < q; j++) {
+        if (this->r[j] > 0 && !this->is_equality(this->working[j])) {
+          Scalar ratio = this->multipliers[j] / this->r[j];
+          if (ratio < partial) {
+            partial = ratio;
+            leaving = j;
+          }
+        }
+      }
+      Scalar full = projected > Scalar{0} ? -slack / projected : inf;
+      Scalar step = std::min(partial, full);
+      if (step == inf) {
+        if (this->is_equality(p) &&
+            !this->violated(-std::abs(slack), this->lower[p])) {
+          // Satisfied and dependent on the working set
+          this->redundant[p] = true;
+          return LPStatus::optimal;
+        }
+        return LPStatus::infeasible;
+      }
+      if (full < inf) {
+        teensymat::axpy(this->n, step, this->z.data(), this->x.data());
+      }
+      for (size_t j = 0; j < q; j++) {
+        this->multipliers[j] -= step * this->r[j];
+      }
+      u_p += step;
+      if (full <= partial) {
+        this->add_working(p, side, u_p);
+        return LPStatus::optimal;
+      }
+      this->drop_working(leaving);
+      slack = this->slack(p, side);
+    }
+  }
+
+public:
+  // SECTION: Constructors
+  /*! Set up the solver for a QP without constraints.
+   *
+   * Throws std::runtime_error if the Hessian is not square or does not
+   * match the linear cost. That it is positive definite is only checked
+   * when solving.
+   *
+   * @param hessian The Hessian H (positive definite, the lower triangle
+   * is read)
+   * @param gradient The linear cost g
+   * @param options Options of the solves
+   * */
+  ActiveSetQP(teensymat::Matrix<Scalar> const &hessian,
+              std::vector<Scalar> gradient,
+              ActiveSetOptions<Scalar> const &options = {})
+      : n(gradient.size()), options(options), gradient(std::move(gradient)),
+        hessian_changed(true), jt(n, n), r_factor(n, n), x(n, 0), d(n, 0),
+        z(n, 0), r(n, 0), normal(n, 0), num_factorizations(0),
+        num_updates(0), iterations(0) {
+    this->set_hessian(hessian);
+  }
+
+  // SECTION: Problem data
+  /*! Add a constraint lower <= a^T x <= upper (lower == upper for an
+   * equality).
+   *
+   * @return The index of the constraint
+   * */
+  size_t add_constraint(std::vector<Scalar> const &row, Scalar lower,
+                        Scalar upper) {
+    if (row.size() != this->n) {
+      throw std::range_error("Constraint row has the wrong length");
+    }
+    if (lower > upper) {
+      throw std::range_error("Constraint has lower bound above upper bound");
+    }
+    this->rows.insert(this->rows.end(), row.begin(), row.end());
+    this->lower.push_back(lower);
+    this->upper.push_back(upper);
+    this->row_changed.push_back(false);
+    this->side.push_back(0);
+    this->redundant.push_back(false);
+    return this->lower.size() - 1;
+  }
+  /*! Replace the row of a constraint. Only this constraint is dropped from
+   * the working set of the next solve.*/
+  void set_constraint_row(size_t index, std::vector<Scalar> const &row) {
+    if (index >= this->get_num_constraints() || row.size() != this->n) {
+      throw std::range_error("Constraint does not exist or row has the "
+                             "wrong length");
+    }
+    std::copy(row.begin(), row.end(), this->rows.begin() + index * this->n);
+    this->row_changed[index] = true;
+  }
+  /*! Replace the bounds of a constraint (keeping the factorization)*/
+  void set_constraint_bounds(size_t index, Scalar lower, Scalar upper) {
+    if (index >= this->get_num_constraints() || lower > upper) {
+      throw std::range_error("Constraint does not exist or bounds are "
+                             "crossed");
+    }
+    // Switching between equality and inequality changes the row's role
+    if ((this->lower[index] == this->upper[index]) != (lower == upper)) {
+      this->row_changed[index] = true;
+    }
+    this->lower[index] = lower;
+    this->upper[index] = upper;
+  }
+  /*! Replace the linear cost (keeping the factorization)*/
+  void set_gradient(std::vector<Scalar> gradient) {
+    if (gradient.size() != this->n) {
+      throw std::range_error("Gradient has the wrong length");
+    }
+    this->gradient = std::move(gradient);
+  }
+  /*! Replace the Hessian, which is refactored by the next solve*/
+  void set_hessian(teensymat::Matrix<Scalar> const &hessian) {
+    if (hessian.get_nrows() != this->n || hessian.get_ncols() != this->n) {
+      throw std::runtime_error("Hessian does not match the gradient");
+    }
+    // Symmetric copy from the lower triangle
+    this->hessian = teensymat::Matrix<Scalar>{this->n, this->n};
+    for (size_t i = 0; i < this->n; i++) {
+      for (size_t j = 0; j <= i; j++) {
+        *this->hessian(i, j) = *hessian(i, j);
+        *this->hessian(j, i) = *hessian(i, j);
+      }
+    }
+    this->hessian_changed = true;
+  }
+
+  // SECTION: Getters
+  /*! Get the number of variables*/
+  size_t get_num_variables() const { return this->n; }
+  /*! Get the number of constraints*/
+  size_t get_num_constraints() const { return this->lower.size(); }
+  /*! Get the constraints in the working set*/
+  std::vector<size_t> const &get_working_set() const {
+    return this->working;
+  }
+  /*! Get the number of Cholesky factorizations of the Hessian*/
+  size_t get_num_factorizations() const { return this->num_factorizations; }
+  /*! Get the number of updates (additions and removals) of the working set
+   * factorization*/
+  size_t get_num_updates() const { return this->num_updates; }
+
+  // SECTION: Solving
+  /*! Solve the QP, hot started from the working set of the previous solve.
+   *
+   * Throws std::runtime_error if the Hessian is not positive definite.
+   *
+   * @return The solution, with the row duals of the constraints and the
+   * constraints of the working set marked at their bounds
+   * */
+  LPSolution<Scalar> solve() {
+    size_t n = this->n;
+    size_t m = this->get_num_constraints();
+    this->iterations = 0;
+    std::fill(this->redundant.begin(), this->redundant.end(), false);
+    this->update_working_set();
+    this->restore_dual_feasibility();
+    LPSolution<Scalar> solution;
+    solution.status = LPStatus::optimal;
+    size_t p = 0;
+    int side = 0;
+    while (solution.status == LPStatus::optimal && this->choose(p, side)) {
+      solution.status = this->add_violated(p, side);
+    }
+    solution.iterations = this->iterations;
+    solution.x = this->x;
+    solution.row_activity.assign(m, 0);
+    solution.row_duals.assign(m, 0);
+    solution.row_status.assign(m, BasisStatus::basic);
+    for (size_t i = 0; i < m; i++) {
+      solution.row_activity[i] =
+          teensymat::dot(n, this->row(i), this->x.data());
+    }
+    for (size_t j = 0; j < this->working_size(); j++) {
+      size_t i = this->working[j];
+      solution.row_duals[i] = this->working_side[j] * this->multipliers[j];
+      solution.row_status[i] = this->working_side[j] > 0
+                                   ? BasisStatus::at_lower
+                                   : BasisStatus::at_upper;
+    }
+    // Reduced costs H x + g - A^T y, zero up to rounding
+    solution.reduced_costs = this->gradient;
+    teensymat::gemv(n, n, Scalar{1}, this->hessian.get_data()->data(), n,
+                    this->x.data(), solution.reduced_costs.data());
+    for (size_t j = 0; j < this->working_size(); j++) {
+      size_t i = this->working[j];
+      teensymat::axpy(n, -solution.row_duals[i], this->row(i),
+                      solution.reduced_costs.data());
+    }
+    std::vector<Scalar> product(n, 0);
+    teensymat::gemv(n, n, Scalar{0.5}, this->hessian.get_data()->data(), n,
+                    this->x.data(), product.data());
+    teensymat::axpy(n, Scalar{1}, this->gradient.data(), product.data());
+    solution.objective = teensymat::dot(n, product.data(), this->x.data());
+    return solution;
+  }
+};
+
+/*! Solve a strictly convex QPProblem with ActiveSetQP, densifying it. The
+ * finite column bounds become constraint rows, whose duals are returned
+ * as the reduced costs.
+ *
+ * Throws std::runtime_error if the Hessian is not positive definite (so
+ * LPs cannot be solved this way).
+ *
+ * @param problem The QP to solve
+ * @param options Options of the solve
+ * @return The solution
+ * */
+template <typename Scalar>
+LPSolution<Scalar>
+solve_active_set(QPProblem<Scalar> const &problem,
+                 ActiveSetOptions<Scalar> const &options = {}) {
+  problem.validate();
+  size_t m = problem.get_nrows();
+  size_t n = problem.get_ncols();
+  // The Hessian is given by its upper triangle, the solver reads the lower
+  teensymat::Matrix<Scalar> hessian{n, n};
+  if (!problem.is_linear()) {
+    teensymat::Matrix<Scalar> upper = problem.hessian.to_dense();
+    for (size_t i = 0; i < n; i++) {
+      for (size_t j = i; j < n; j++) {
+        *hessian(j, i) = *upper(i, j);
+      }
+    }
+  }
+  ActiveSetQP<Scalar> solver{hessian, problem.objective, options};
+  teensymat::Matrix<Scalar> dense = problem.constraints.to_dense();
+  std::vector<Scalar> row(n);
+  for (size_t i = 0; i < m; i++) {
+    for (size_t j = 0; j < n; j++) {
+      row[j] = *dense(i, j);
+    }
+    solver.add_constraint(row, problem.row_lower[i], problem.row_upper[i]);
+  }
+  // Index of the bound row of each column (m + n if it has none)
+  std::vector<size_t> bound_rows(n, m + n);
+  for (size_t j = 0; j < n; j++) {
+    if (std::isfinite(problem.col_lower[j]) ||
+        std::isfinite(problem.col_upper[j])) {
+      std::fill(row.begin(), row.end(), Scalar{0});
+      row[j] = 1;
+      bound_rows[j] = solver.add_constraint(row, problem.col_lower[j],
+                                            problem.col_upper[j]);
+    }
+  }
+  LPSolution<Scalar> result = solver.solve();
+  LPSolution<Scalar> solution;
+  solution.status = result.status;
+  solution.objective = result.objective + problem.objective_offset;
+  solution.x = std::move(result.x);
+  solution.iterations = result.iterations;
+  solution.row_activity.assign(result.row_activity.begin(),
+                               result.row_activity.begin() + m);
+  solution.row_duals.assign(result.row_duals.begin(),
+                            result.row_duals.begin() + m);
+  solution.row_status.assign(result.row_status.begin(),
+                             result.row_status.begin() + m);
+  solution.reduced_costs.assign(n, 0);
+  solution.col_status.assign(n, BasisStatus::basic);
+  for (size_t j = 0; j < n; j++) {
+    if (bound_rows[j] < m + n) {
+      solution.reduced_costs[j] = result.row_duals[bound_rows[j]];
+      solution.col_status[j] = result.row_status[bound_rows[j]];
+    }
+  }
+  return solution;
+}
+} // namespace teensylp
@@ -0,0 +1,1079 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyLP/lp_problem.hpp"
+#include "TeensyOpt/TeensyLP/qp_problem.hpp"
+#include "TeensyOpt/TeensyMat/scaling.hpp"
+#include "TeensyOpt/TeensyMat/sparse_core.hpp"
+#include "TeensyOpt/TeensyMat/sparse_ldlt.hpp"
+
+namespace teensylp {
+/*! Options of ADMM*/
+template <typename Scalar> struct ADMMOptions {
+  /*! Maximum number of iterations*/
+  size_t max_iterations = 4000;
+  /*! Absolute tolerance of the primal and dual residuals*/
+  Scalar absolute_tolerance = 1e-4;
+  /*! Tolerance of the residuals relative to the size of the terms*/
+  Scalar relative_tolerance = 1e-4;
+  /*! Tolerance of the infeasibility certificates*/
+  Scalar infeasibility_tolerance = 1e-5;
+  /*! Initial penalty parameter rho*/
+  Scalar rho = 0.1;
+  /*! Proximal term on x, keeping the linear system quasi definite*/
+  Scalar sigma = 1e-6;
+  /*! Over relaxation parameter alpha, in (0, 2)*/
+  Scalar relaxation = 1.6;
+  /*! Adapt rho to balance the primal and dual residuals*/
+  bool adaptive_rho = true;
+  /*! rho is only changed (and the linear system refactored) when the
+   * balancing value differs from it by more than this factor*/
+  Scalar adaptive_rho_tolerance = 5;
+  /*! Minimum number of iterations between rho updates*/
+  size_t adaptive_rho_interval = 25;
+  /*! Iterations between termination checks*/
+  size_t check_interval = 5;
+  /*! Number of Ruiz equilibration passes over the linear system*/
+  size_t scaling_iterations = 10;
+  /*! Refine the solution by solving the linear system of its active
+   * constraints*/
+  bool polish = true;
+  /*! Regularization of the active constraints in polishing*/
+  Scalar polish_regularization = 1e-6;
+  /*! Maximum iterative refinement steps of polishing (refinement stops
+   * early once a correction is negligible)*/
+  size_t polish_refinement_steps = 3;
+  /*! Before iterating from a warm start, polish it and stop if the
+   * polished point already meets the tolerances. When the active set did
+   * not change (as between the solves of model predictive control) this
+   * takes no iterations at all*/
+  bool polish_warm_start = true;
+  /*! Start each solve from the final iterate of the previous one*/
+  bool warm_start = true;
+};
+
+/*! Operator splitting (ADMM) method for QPProblem, in the form of OSQP.
+ *
+ * Column bounds are stacked under the rows as identity rows, giving
+ *
+ *     minimize 1/2 x^T P x + q^T x  s.t.  z = A x,  l <= z <= u.
+ *
+ * Each iteration solves the quasi definite system
+ *
+ *     [P + sigma I   A^T       ] [x~]   [sigma x - q   ]
+ *     [A             -diag(1/rho)] [nu] = [z - y / rho ]
+ *
+ * then projects z onto the bounds and updates the duals y. The system is
+ * Ruiz equilibrated and factored once with SparseLDLT, with the bound rows
+ * eliminated into its diagonal; only a change of rho (adaptive_rho)
+ * refactors it, with the same symbolic analysis. The iterations, rho
+ * updates and polishing work in buffers sized at setup, so after the first
+ * solve only the returned LPSolution is allocated.
+ *
+ * Termination is checked every check_interval iterations on the unscaled
+ * residuals, together with the infeasibility certificates given by the
+ * differences of successive iterates. Polishing then solves the equality
+ * constrained QP of the guessed active set for a higher accuracy
+ * solution.
+ *
+ * For repeated solves, update replaces the problem data keeping the
+ * scaling and the factorization when possible, and the next solve starts
+ * from the last iterate (or from set_starting_point). That warm start is
+ * polished before iterating, so a solve whose active set did not change
+ * costs one polishing and no iterations.
+ * */
+template <typename Scalar> class ADMM {
+  /*! Smallest and largest rho*/
+  static constexpr double rho_min = 1e-6;
+  static constexpr double rho_max = 1e6;
+  /*! Factor applied to rho for equality constraints*/
+  static constexpr double equality_rho_factor = 1e3;
+  /*! Relative size of a polishing correction ending the refinement*/
+  static constexpr double polish_refinement_tolerance = 1e-12;
+
+  /*! The problem as given*/
+  QPProblem<Scalar> problem;
+  /*! Options of the solve*/
+  ADMMOptions<Scalar> options;
+  /*! The number of rows of the problem*/
+  size_t nrows;
+  /*! The number of variables*/
+  size_t ncols;
+  /*! The number of constraints (rows and bounded columns)*/
+  size_t nconstraints;
+  /*! Variables with a finite bound, in the order of their constraints*/
+  std::vector<size_t> bounded;
+  /*! The scaled constraint matrix A (nconstraints by ncols) and A^T*/
+  teensymat::SparseMatrix<Scalar> constraints, constraints_t;
+  /*! The scaled upper triangle of P*/
+  teensymat::SparseMatrix<Scalar> hessian;
+  /*! Scaled costs*/
+  std::vector<Scalar> cost;
+  /*! Scaled bounds of each constraint*/
+  std::vector<Scalar> lower, upper;
+  /*! Scaling of the linear system: row_scale for the constraints (E),
+   * col_scale for the variables (D)*/
+  teensymat::Scaling<Scalar> scaling;
+  /*! Scaling of the objective*/
+  Scalar cost_scale;
+  /*! The scalar rho, and its value and inverse for each constraint*/
+  Scalar rho;
+  std::vector<Scalar> rho_vector, rho_inverse;
+  /*! The linear system of the variables and rows (upper triangle)*/
+  teensymat::SparseMatrix<Scalar> kkt;
+  /*! Position of the diagonal of each column in the values of kkt*/
+  std::vector<size_t> diagonal_entry;
+  /*! Diagonal of P + sigma I, before adding the bound rows*/
+  std::vector<Scalar> diagonal_base;
+  /*! Scaled coefficient of each bound row*/
+  std::vector<Scalar> bound_coefficient;
+  /*! Factorization of kkt*/
+  teensymat::SparseLDLT<Scalar> ldlt;
+  /*! The linear system of polishing (same pattern as kkt), its
+   * factorization, and its rho for each constraint*/
+  teensymat::SparseMatrix<Scalar> polish_kkt;
+  teensymat::SparseLDLT<Scalar> polish_ldlt;
+  std::vector<Scalar> polish_rho;
+  /*! Whether polish_ldlt is a factorization of the current data*/
+  bool polish_factored;
+  /*! Number of symbolic analyses and numeric factorizations performed*/
+  size_t analyses, factorizations;
+  /*! The iterate and its previous values (for infeasibility detection
+   * and polishing)*/
+  std::vector<Scalar> x, z, y, x_previous, y_previous, z_previous;
+  /*! Active side (-1 lower, 1 upper, 0 inactive) of each constraint and
+   * the solution of polishing*/
+  std::vector<signed char> active;
+  std::vector<Scalar> polish_solution;
+  /*! Right hand side and solution of the linear system, and of its part
+   * without the bound rows*/
+  std::vector<Scalar> rhs, reduced;
+  /*! Products A x, P x, A^T y of the termination checks*/
+  std::vector<Scalar> ax, px, aty;
+  /*! Unscaled residuals of the last check*/
+  Scalar primal_residual, dual_residual;
+  /*! Number of iterations performed in the current solve*/
+  size_t iterations;
+  /*! Whether the last solution was polished*/
+  bool polished;
+  /*! Whether the iterate holds a previous solution or a starting point*/
+  bool started;
+
+  // SECTION: Setup
+  /*! The unscaled stacked constraint matrix [A; I_bounded]*/
+  teensymat::SparseMatrix<Scalar> stacked() const {
+    size_t m = this->nrows;
+    auto const &matrix = this->problem.constraints;
+    std::vector<size_t> rows, cols;
+    std::vector<Scalar> vals;
+    auto const &col_ptr = matrix.get_col_ptr();
+    auto const &row_idx = matrix.get_row_idx();
+    Scalar const *values = matrix.get_values()->data();
+    for (size_t j = 0; j < this->ncols; j++) {
+      for (size_t k = col_ptr[j]; k < col_ptr[j + 1]; k++) {
+        rows.push_back(row_idx[k]);
+        cols.push_back(j);
+        vals.push_back(values[k]);
+      }
+    }
+    for (size_t k = 0; k < this->bounded.size(); k++) {
+      rows.push_back(m + k);
+      cols.push_back(this->bounded[k]);
+      vals.push_back(1);
+    }
+    return teensymat::SparseMatrix<Scalar>::from_triplets(
+        this->nconstraints, this->ncols, rows, cols, vals);
+  }
+  /*! Ruiz equilibration of [P A^T; A 0], and the scaling of the costs*/
+  void compute_scaling(teensymat::SparseMatrix<Scalar> const &stacked) {
+    size_t n = this->ncols;
+    size_t size = n + this->nconstraints;
+    std::vector<size_t> rows, cols;
+    std::vector<Scalar> vals;
+    auto add = [&](size_t i, size_t j, Scalar value) {
+      rows.push_back(i);
+      cols.push_back(j);
+      vals.push_back(value);
+      if (i != j) {
+        rows.push_back(j);
+        cols.push_back(i);
+        vals.push_back(value);
+      }
+    };
+    auto const &p_ptr = this->problem.hessian.get_col_ptr();
+    auto const &p_idx = this->problem.hessian.get_row_idx();
+    Scalar const *p_values = this->problem.hessian.get_values()->data();
+    for (size_t j = 0; j < this->problem.hessian.get_ncols(); j++) {
+      for (size_t k = p_ptr[j]; k < p_ptr[j + 1]; k++) {
+        add(p_idx[k], j, p_values[k]);
+      }
+    }
+    auto const &a_ptr = stacked.get_col_ptr();
+    auto const &a_idx = stacked.get_row_idx();
+    Scalar const *a_values = stacked.get_values()->data();
+    for (size_t j = 0; j < n; j++) {
+      for (size_t k = a_ptr[j]; k < a_ptr[j + 1]; k++) {
+        add(n + a_idx[k], j, a_values[k]);
+      }
+    }
+    auto full = teensymat::SparseMatrix<Scalar>::from_triplets(size, size,
+                                                               rows, cols,
+                                                               vals);
+    // The matrix is symmetric, so the row and column factors agree
+    teensymat::Scaling<Scalar> ruiz = teensymat::ruiz_scaling(
+        full, this->options.scaling_iterations, Scalar(1e-3));
+    this->scaling.col_scale.assign(ruiz.col_scale.begin(),
+                                   ruiz.col_scale.begin() + n);
+    this->scaling.row_scale.assign(ruiz.col_scale.begin() + n,
+                                   ruiz.col_scale.end());
+    // Cost scaling from the mean column norm of the scaled P and |q|
+    Scalar mean = 0;
+    for (size_t j = 0; j < this->problem.hessian.get_ncols(); j++) {
+      Scalar largest = 0;
+      for (size_t k = p_ptr[j]; k < p_ptr[j + 1]; k++) {
+        largest = std::max(largest, std::abs(p_values[k]) *
+                                        this->scaling.col_scale[p_idx[k]] *
+                                        this->scaling.col_scale[j]);
+      }
+      mean += largest / static_cast<Scalar>(n);
+    }
+    Scalar cost_norm = 0;
+    for (size_t j = 0; j < n; j++) {
+      cost_norm = std::max(cost_norm, std::abs(this->problem.objective[j]) *
+                                          this->scaling.col_scale[j]);
+    }
+    Scalar norm = std::max(mean, cost_norm);
+    this->cost_scale =
+        norm < Scalar(1e-4) ? Scalar{1} : 1 / std::min(norm, Scalar(1e4));
+  }
+  /*! Scale the costs and the bounds of the constraints*/
+  void load_vectors() {
+    size_t m = this->nrows;
+    auto const &row_scale = this->scaling.row_scale;
+    auto const &col_scale = this->scaling.col_scale;
+    this->cost.resize(this->ncols);
+    for (size_t j = 0; j < this->ncols; j++) {
+      this->cost[j] = this->cost_scale * col_scale[j] *
+                      this->problem.objective[j];
+    }
+    this->lower.resize(this->nconstraints);
+    this->upper.resize(this->nconstraints);
+    for (size_t i = 0; i < m; i++) {
+      this->lower[i] = this->problem.row_lower[i] * row_scale[i];
+      this->upper[i] = this->problem.row_upper[i] * row_scale[i];
+    }
+    for (size_t k = 0; k < this->bounded.size(); k++) {
+      size_t j = this->bounded[k];
+      this->lower[m + k] = this->problem.col_lower[j] * row_scale[m + k];
+      this->upper[m + k] = this->problem.col_upper[j] * row_scale[m + k];
+    }
+  }
+  /*! Set rho for each constraint: larger for equalities, smallest for
+   * constraints without bounds*/
+  void compute_rho_vector() {
+    for (size_t i = 0; i < this->nconstraints; i++) {
+      Scalar value = this->rho;
+      if (!std::isfinite(this->lower[i]) && !std::isfinite(this->upper[i])) {
+        value = Scalar(rho_min);
+      } else if (this->upper[i] - this->lower[i] <= Scalar(1e-12)) {
+        value = this->rho * Scalar(equality_rho_factor);
+      }
+      this->rho_vector[i] = value;
+      this->rho_inverse[i] = 1 / value;
+    }
+  }
+  /*! Scale the problem data and assemble, analyze (when its pattern
+   * changed or rescale is set) and factor the linear system.
+   *
+   * @param rescale Recompute the scaling (otherwise the current one is
+   * applied to the new data)
+   * */
+  void setup(bool rescale) {
+    size_t n = this->ncols;
+    size_t m = this->nrows;
+    this->bounded.clear();
+    for (size_t j = 0; j < n; j++) {
+      if (std::isfinite(this->problem.col_lower[j]) ||
+          std::isfinite(this->problem.col_upper[j])) {
+        this->bounded.push_back(j);
+      }
+    }
+    size_t previous = this->nconstraints;
+    this->nconstraints = m + this->bounded.size();
+    rescale = rescale || previous != this->nconstraints;
+    this->constraints = this->stacked();
+    if (rescale) {
+      this->compute_scaling(this->constraints);
+    }
+    auto const &col_scale = this->scaling.col_scale;
+    Scalar c = this->cost_scale;
+    teensymat::apply_scaling(this->constraints, this->scaling);
+    this->constraints_t = this->constraints.transpose();
+    this->hessian = this->problem.is_linear()
+                        ? teensymat::SparseMatrix<Scalar>(n, n)
+                        : this->problem.hessian;
+    {
+      auto const &col_ptr = this->hessian.get_col_ptr();
+      auto const &row_idx = this->hessian.get_row_idx();
+      Scalar *values = this->hessian.get_values()->data();
+      for (size_t j = 0; j < n; j++) {
+        for (size_t k = col_ptr[j]; k < col_ptr[j + 1]; k++) {
+          values[k] *= c * col_scale[row_idx[k]] * col_scale[j];
+        }
+      }
+    }
+    this->load_vectors();
+    this->rho_vector.resize(this->nconstraints);
+    this->rho_inverse.resize(this->nconstraints);
+    this->compute_rho_vector();
+    // Upper triangle of [P + sigma I, A^T; A, -diag(1/rho)] for the rows
+    // only: the bounds are eliminated into the diagonal (see solve_kkt)
+    size_t size = n + m;
+    std::vector<size_t> rows, cols;
+    std::vector<Scalar> vals;
+    auto const &p_ptr = this->hessian.get_col_ptr();
+    auto const &p_idx = this->hessian.get_row_idx();
+    Scalar const *p_values = this->hessian.get_values()->data();
+    for (size_t j = 0; j < n; j++) {
+      rows.push_back(j);
+      cols.push_back(j);
+      vals.push_back(this->options.sigma);
+      for (size_t k = p_ptr[j]; k < p_ptr[j + 1]; k++) {
+        rows.push_back(p_idx[k]);
+        cols.push_back(j);
+        vals.push_back(p_values[k]);
+      }
+    }
+    auto const &t_ptr = this->constraints_t.get_col_ptr();
+    auto const &t_idx = this->constraints_t.get_row_idx();
+    Scalar const *t_values = this->constraints_t.get_values()->data();
+    for (size_t i = 0; i < m; i++) {
+      for (size_t k = t_ptr[i]; k < t_ptr[i + 1]; k++) {
+        rows.push_back(t_idx[k]);
+        cols.push_back(n + i);
+        vals.push_back(t_values[k]);
+      }
+      rows.push_back(n + i);
+      cols.push_back(n + i);
+      vals.push_back(-this->rho_inverse[i]);
+    }
+    auto kkt = teensymat::SparseMatrix<Scalar>::from_triplets(size, size, rows,
+                                                              cols, vals);
+    bool analyze = this->analyses == 0 ||
+                   kkt.get_col_ptr() != this->kkt.get_col_ptr() ||
+                   kkt.get_row_idx() != this->kkt.get_row_idx();
+    this->kkt = std::move(kkt);
+    // The diagonal is the last entry of each column of the upper triangle
+    Scalar const *kkt_values = this->kkt.get_values()->data();
+    this->diagonal_entry.resize(size);
+    this->diagonal_base.resize(n);
+    for (size_t j = 0; j < size; j++) {
+      this->diagonal_entry[j] = this->kkt.get_col_ptr()[j + 1] - 1;
+    }
+    for (size_t j = 0; j < n; j++) {
+      this->diagonal_base[j] = kkt_values[this->diagonal_entry[j]];
+    }
+    this->bound_coefficient.resize(this->bounded.size());
+    for (size_t k = 0; k < this->bounded.size(); k++) {
+      this->bound_coefficient[k] =
+          this->scaling.row_scale[m + k] * col_scale[this->bounded[k]];
+    }
+    if (analyze) {
+      this->ldlt.analyze(this->kkt);
+      std::vector<signed char> signs(size, 1);
+      std::fill(signs.begin() + n, signs.end(), -1);
+      this->ldlt.set_dynamic_regularization(std::move(signs), Scalar(1e-13),
+                                            Scalar(1e-7));
+      this->analyses++;
+    }
+    this->refactor(this->kkt, this->ldlt, this->rho_vector);
+    if (analyze) {
+      this->polish_ldlt = this->ldlt;
+    }
+    this->polish_kkt = this->kkt;
+    this->polish_rho.resize(this->nconstraints);
+    this->polish_factored = false;
+    this->x.resize(n, 0);
+    this->x_previous.resize(n, 0);
+    this->z.resize(this->nconstraints, 0);
+    this->y.resize(this->nconstraints, 0);
+    this->y_previous.resize(this->nconstraints, 0);
+    this->z_previous.resize(this->nconstraints, 0);
+    this->active.resize(this->nconstraints, 0);
+    this->polish_solution.resize(n + this->nconstraints, 0);
+    this->rhs.resize(n + this->nconstraints, 0);
+    this->reduced.resize(size, 0);
+    this->ax.resize(this->nconstraints, 0);
+    this->px.resize(n, 0);
+    this->aty.resize(n, 0);
+  }
+  /*! Change rho and refactor the linear system*/
+  void set_rho(Scalar value) {
+    this->rho = std::clamp(value, Scalar(rho_min), Scalar(rho_max));
+    this->compute_rho_vector();
+    this->refactor(this->kkt, this->ldlt, this->rho_vector);
+  }
+  /*! Write rho into a linear system and factor it again.
+   *
+   * @param matrix kkt or polish_kkt
+   * @param factor Its factorization
+   * @param rho rho of each constraint
+   * */
+  void refactor(teensymat::SparseMatrix<Scalar> &matrix,
+                teensymat::SparseLDLT<Scalar> &factor,
+                std::vector<Scalar> const &rho) {
+    size_t m = this->nrows;
+    Scalar *values = matrix.get_values()->data();
+    for (size_t j = 0; j < this->ncols; j++) {
+      values[this->diagonal_entry[j]] = this->diagonal_base[j];
+    }
+    for (size_t k = 0; k < this->bounded.size(); k++) {
+      Scalar a = this->bound_coefficient[k];
+      values[this->diagonal_entry[this->bounded[k]]] +=
+          a * a * rho[m + k];
+    }
+    for (size_t i = 0; i < m; i++) {
+      values[this->diagonal_entry[this->ncols + i]] =
+          -1 / rho[i];
+    }
+    factor.factorize(matrix);
+    this->factorizations++;
+  }
+  /*! Solve the full system [P + sigma I, A^T; A, -diag(1/rho)] of all
+   * constraints in place.
+   *
+   * A bound row k of variable j reads a_k x_j - nu_k / rho_k = r_k, so
+   * nu_k = rho_k (a_k x_j - r_k), which adds a_k^2 rho_k to the diagonal
+   * of x_j and a_k rho_k r_k to its right hand side. Only the rows are
+   * left in the factored system.
+   *
+   * @param factor The factorization of kkt or polish_kkt
+   * @param rho The rho it was factored with
+   * @param full The right hand side, and on exit the solution
+   * */
+  void solve_kkt(teensymat::SparseLDLT<Scalar> const &factor,
+                 std::vector<Scalar> const &rho, Scalar *full) {
+    size_t n = this->ncols;
+    size_t m = this->nrows;
+    Scalar *reduced = this->reduced.data();
+    std::copy(full, full + n + m, reduced);
+    for (size_t k = 0; k < this->bounded.size(); k++) {
+      reduced[this->bounded[k]] += this->bound_coefficient[k] *
+                                   rho[m + k] *
+                                   full[n + m + k];
+    }
+    factor.solve_inplace(reduced);
+    std::copy(reduced, reduced + n + m, full);
+    for (size_t k = 0; k < this->bounded.size(); k++) {
+      Scalar &nu = full[n + m + k];
+      nu = rho[m + k] *
+           (this->bound_coefficient[k] * full[this->bounded[k]] - nu);
+    }
+  }
+
+  // SECTION: Starting points
+  /*! Set the scaled iterate from an unscaled x and duals y of the stacked
+   * constraints (in the sign convention of this solver), with z the
+   * projection of A x*/
+  void load_iterate(std::vector<Scalar> const &x_unscaled,
+                    std::vector<Scalar> const &y_unscaled) {
+    for (size_t j = 0; j < this->ncols; j++) {
+      this->x[j] = x_unscaled[j] / this->scaling.col_scale[j];
+    }
+    std::fill(this->z.begin(), this->z.end(), Scalar{0});
+    this->constraints.gaxpy(1, this->x.data(), this->z.data());
+    for (size_t i = 0; i < this->nconstraints; i++) {
+      this->z[i] = std::clamp(this->z[i], this->lower[i], this->upper[i]);
+      this->y[i] =
+          this->cost_scale * y_unscaled[i] / this->scaling.row_scale[i];
+    }
+  }
+  /*! The unscaled x and stacked duals of the current iterate*/
+  std::pair<std::vector<Scalar>, std::vector<Scalar>> unscaled_iterate()
+      const {
+    std::vector<Scalar> x_unscaled(this->x);
+    this->scaling.unscale_primal(x_unscaled);
+    std::vector<Scalar> y_unscaled(this->nconstraints);
+    for (size_t i = 0; i < this->nconstraints; i++) {
+      y_unscaled[i] =
+          this->y[i] * this->scaling.row_scale[i] / this->cost_scale;
+    }
+    return {std::move(x_unscaled), std::move(y_unscaled)};
+  }
+
+  // SECTION: Iterations
+  /*! One ADMM iteration*/
+  void iterate() {
+    size_t n = this->ncols;
+    Scalar alpha = this->options.relaxation;
+    Scalar sigma = this->options.sigma;
+    Scalar *rhs = this->rhs.data();
+    for (size_t j = 0; j < n; j++) {
+      rhs[j] = sigma * this->x[j] - this->cost[j];
+    }
+    for (size_t i = 0; i < this->nconstraints; i++) {
+      rhs[n + i] = this->z[i] - this->rho_inverse[i] * this->y[i];
+    }
+    this->solve_kkt(this->ldlt, this->rho_vector, rhs);
+    for (size_t j = 0; j < n; j++) {
+      this->x_previous[j] = this->x[j];
+      this->x[j] = alpha * rhs[j] + (1 - alpha) * this->x[j];
+    }
+    for (size_t i = 0; i < this->nconstraints; i++) {
+      Scalar z_tilde =
+          this->z[i] + this->rho_inverse[i] * (rhs[n + i] - this->y[i]);
+      Scalar relaxed = alpha * z_tilde + (1 - alpha) * this->z[i];
+      Scalar projected =
+          std::clamp(relaxed + this->rho_inverse[i] * this->y[i],
+                     this->lower[i], this->upper[i]);
+      this->y_previous[i] = this->y[i];
+      this->y[i] += this->rho_vector[i] * (relaxed - projected);
+      this->z[i] = projected;
+    }
+  }
+  /*! result += P v for the scaled upper triangle*/
+  void add_hessian_product(Scalar const *v, Scalar *result) const {
+    auto const &col_ptr = this->hessian.get_col_ptr();
+    auto const &row_idx = this->hessian.get_row_idx();
+    Scalar const *values = this->hessian.get_values()->data();
+    for (size_t j = 0; j < this->ncols; j++) {
+      for (size_t k = col_ptr[j]; k < col_ptr[j + 1]; k++) {
+        size_t i = row_idx[k];
+        result[i] += values[k] * v[j];
+        if (i != j) {
+          result[j] += values[k] * v[i];
+        }
+      }
+    }
+  }
+  /*! Residuals and norms of the current iterate, unscaled and scaled*/
+  struct Residuals {
+    Scalar primal, dual, primal_scale, dual_scale;
+    Scalar scaled_primal, scaled_dual, scaled_primal_scale,
+        scaled_dual_scale;
+  };
+  /*! Compute the residuals of the current iterate (and ax, px, aty)*/
+  Residuals residuals() {
+    size_t n = this->ncols;
+    Scalar c = this->cost_scale;
+    std::fill(this->ax.begin(), this->ax.end(), Scalar{0});
+    this->constraints.gaxpy(1, this->x.data(), this->ax.data());
+    std::fill(this->px.begin(), this->px.end(), Scalar{0});
+    this->add_hessian_product(this->x.data(), this->px.data());
+    std::fill(this->aty.begin(), this->aty.end(), Scalar{0});
+    this->constraints_t.gaxpy(1, this->y.data(), this->aty.data());
+    Residuals result{};
+    for (size_t i = 0; i < this->nconstraints; i++) {
+      Scalar inverse = 1 / this->scaling.row_scale[i];
+      Scalar residual = std::abs(this->ax[i] - this->z[i]);
+      result.primal = std::max(result.primal, residual * inverse);
+      result.primal_scale =
+          std::max({result.primal_scale, std::abs(this->ax[i]) * inverse,
+                    std::abs(this->z[i]) * inverse});
+      result.scaled_primal = std::max(result.scaled_primal, residual);
+      result.scaled_primal_scale =
+          std::max({result.scaled_primal_scale, std::abs(this->ax[i]),
+                    std::abs(this->z[i])});
+    }
+    for (size_t j = 0; j < n; j++) {
+      Scalar inverse = 1 / (c * this->scaling.col_scale[j]);
+      Scalar residual = std::abs(this->px[j] + this->cost[j] + this->aty[j]);
+      result.dual = std::max(result.dual, residual * inverse);
+      result.dual_scale =
+          std::max({result.dual_scale, std::abs(this->px[j]) * inverse,
+                    std::abs(this->aty[j]) * inverse,
+                    std::abs(this->cost[j]) * inverse});
+      result.scaled_dual = std::max(result.scaled_dual, residual);
+      result.scaled_dual_scale =
+          std::max({result.scaled_dual_scale, std::abs(this->px[j]),
+                    std::abs(this->aty[j]), std::abs(this->cost[j])});
+    }
+    return result;
+  }
+  /*! Whether residuals meet the tolerances*/
+  bool converged(Residuals const &residuals) const {
+    Scalar absolute = this->options.absolute_tolerance;
+    Scalar relative = this->options.relative_tolerance;
+    return residuals.primal <=
+               absolute + relative * residuals.primal_scale &&
+           residuals.dual <= absolute + relative * residuals.dual_scale;
+  }
+  /*! Whether the last change of y certifies primal infeasibility: A^T dy
+   * = 0 with u^T max(dy, 0) + l^T min(dy, 0) < 0 (uses aty as workspace)*/
+  bool primal_infeasible() {
+    size_t n = this->ncols;
+    Scalar tolerance = this->options.infeasibility_tolerance;
+    // dy is computed into y_previous, which the next iteration overwrites
+    Scalar *dy = this->y_previous.data();
+    Scalar norm = 0;
+    for (size_t i = 0; i < this->nconstraints; i++) {
+      dy[i] = this->y[i] - dy[i];
+      norm = std::max(norm, std::abs(dy[i] * this->scaling.row_scale[i]));
+    }
+    if (norm <= Scalar(1e-30)) {
+      return false;
+    }
+    Scalar support = 0;
+    for (size_t i = 0; i < this->nconstraints; i++) {
+      Scalar value = dy[i] * this->scaling.row_scale[i] / norm;
+      if (value > tolerance) {
+        if (!std::isfinite(this->upper[i])) {
+          return false;
+        }
+        support += this->upper[i] / this->scaling.row_scale[i] * value;
+      } else if (value < -tolerance) {
+        if (!std::isfinite(this->lower[i])) {
+          return false;
+        }
+        support += this->lower[i] / this->scaling.row_scale[i] * value;
+      }
+    }
+    if (support >= -tolerance) {
+      return false;
+    }
+    std::fill(this->aty.begin(), this->aty.end(), Scalar{0});
+    this->constraints_t.gaxpy(1, dy, this->aty.data());
+    for (size_t j = 0; j < n; j++) {
+      if (std::abs(this->aty[j] / this->scaling.col_scale[j]) / norm >
+          tolerance) {
+        return false;
+      }
+    }
+    return true;
+  }
+  /*! Whether the last change of x certifies dual infeasibility: P dx = 0,
+   * q^T dx < 0 and A dx within the recession cone of the bounds (uses ax
+   * and px as workspaces)*/
+  bool dual_infeasible() {
+    size_t n = this->ncols;
+    Scalar tolerance = this->options.infeasibility_tolerance;
+    Scalar *dx = this->x_previous.data();
+    Scalar norm = 0;
+    for (size_t j = 0; j < n; j++) {
+      dx[j] = this->x[j] - dx[j];
+      norm = std::max(norm, std::abs(dx[j] * this->scaling.col_scale[j]));
+    }
+    if (norm <= Scalar(1e-30)) {
+      return false;
+    }
+    Scalar slope = 0;
+    for (size_t j = 0; j < n; j++) {
+      slope += this->cost[j] * dx[j];
+    }
+    if (slope / this->cost_scale >= -tolerance * norm) {
+      return false;
+    }
+    std::fill(this->px.begin(), this->px.end(), Scalar{0});
+    this->add_hessian_product(dx, this->px.data());
+    for (size_t j = 0; j < n; j++) {
+      if (std::abs(this->px[j]) /
+              (this->cost_scale * this->scaling.col_scale[j]) >
+          tolerance * norm) {
+        return false;
+      }
+    }
+    std::fill(this->ax.begin(), this->ax.end(), Scalar{0});
+    this->constraints.gaxpy(1, dx, this->ax.data());
+    for (size_t i = 0; i < this->nconstraints; i++) {
+      Scalar value = this->ax[i] / this->scaling.row_scale[i];
+      if ((std::isfinite(this->upper[i]) && value > tolerance * norm) ||
+          (std::isfinite(this->lower[i]) && value < -tolerance * norm)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  /*! Balance the scaled residuals by changing rho, refactoring only when
+   * it changes by more than adaptive_rho_tolerance*/
+  void adapt_rho(Residuals const &residuals) {
+    Scalar tiny = Scalar(1e-10);
+    Scalar primal = residuals.scaled_primal /
+                    std::max(residuals.scaled_primal_scale, tiny);
+    Scalar dual =
+        residuals.scaled_dual / std::max(residuals.scaled_dual_scale, tiny);
+    if (primal <= 0 || dual <= 0) {
+      return;
+    }
+    Scalar value = std::clamp(this->rho * std::sqrt(primal / dual),
+                              Scalar(rho_min), Scalar(rho_max));
+    Scalar tolerance = this->options.adaptive_rho_tolerance;
+    if (value > tolerance * this->rho || value * tolerance < this->rho) {
+      this->set_rho(value);
+    }
+  }
+  /*! Run the iterations from the current iterate*/
+  LPStatus run() {
+    size_t interval = std::max<size_t>(1, this->options.check_interval);
+    size_t adapted = 0;
+    while (true) {
+      this->iterate();
+      this->iterations++;
+      bool last = this->iterations >= this->options.max_iterations;
+      if (this->iterations % interval != 0 && !last) {
+        continue;
+      }
+      Residuals current = this->residuals();
+      this->primal_residual = current.primal;
+      this->dual_residual = current.dual;
+      if (this->converged(current)) {
+        return LPStatus::optimal;
+      }
+      if (this->primal_infeasible()) {
+        return LPStatus::infeasible;
+      }
+      if (this->dual_infeasible()) {
+        return LPStatus::unbounded;
+      }
+      if (last) {
+        return LPStatus::iteration_limit;
+      }
+      if (this->options.adaptive_rho &&
+          this->iterations - adapted >= this->options.adaptive_rho_interval) {
+        this->adapt_rho(current);
+        adapted = this->iterations;
+      }
+    }
+  }
+
+  // SECTION: Polishing
+  /*! Whether the duals of the polished point have the signs of their
+   * active sides (equality constraints take either sign)*/
+  bool polished_duals_consistent() const {
+    Scalar tolerance = this->options.absolute_tolerance;
+    for (size_t i = 0; i < this->nconstraints; i++) {
+      if (this->lower[i] == this->upper[i]) {
+        continue;
+      }
+      Scalar dual = this->active[i] * this->y[i] *
+                    this->scaling.row_scale[i] / this->cost_scale;
+      if (dual < -tolerance) {
+        return false;
+      }
+    }
+    return true;
+  }
+  /*! Solve the equality constrained QP of the active constraints guessed
+   * from the signs of y, and keep its solution if its residuals are no
+   * worse (or, for a warm start, if it meets the tolerances).
+   *
+   * The system has the pattern of the iterations, with the diagonal of
+   * the active constraints set to -polish_regularization and that of the
+   * others to -1/rho_min, which decouples them. Its factorization shares
+   * the symbolic analysis of kkt and is only recomputed when the active
+   * set changes. Iterative refinement then removes the regularization.
+   *
+   * @param require_converged Keep the polished point only if it meets the
+   * tolerances with duals consistent with the active set, rather than if
+   * its residuals are no worse than those of the last check
+   * @return Whether the polished point was kept
+   * */
+  bool polish(bool require_converged) {
+    size_t n = this->ncols;
+    size_t size = n + this->nconstraints;
+    bool changed = false;
+    for (size_t i = 0; i < this->nconstraints; i++) {
+      signed char side = 0;
+      if (this->z[i] - this->lower[i] < -this->y[i]) {
+        side = -1;
+      } else if (this->upper[i] - this->z[i] < this->y[i]) {
+        side = 1;
+      }
+      this->active[i] = side;
+      Scalar value = side != 0 ? 1 / this->options.polish_regularization
+                               : Scalar(rho_min);
+      changed = changed || this->polish_rho[i] != value;
+      this->polish_rho[i] = value;
+    }
+    if (changed || !this->polish_factored) {
+      this->refactor(this->polish_kkt, this->polish_ldlt, this->polish_rho);
+      this->polish_factored = true;
+    }
+    // Refine against [P, A_act^T; A_act, 0], starting from zero
+    Scalar *solution = this->polish_solution.data();
+    Scalar *residual = this->rhs.data();
+    std::fill(solution, solution + size, Scalar{0});
+    for (size_t step = 0; step <= this->options.polish_refinement_steps;
+         step++) {
+      std::fill(this->px.begin(), this->px.end(), Scalar{0});
+      this->add_hessian_product(solution, this->px.data());
+      this->constraints_t.gaxpy(1, solution + n, this->px.data());
+      std::fill(this->ax.begin(), this->ax.end(), Scalar{0});
+      this->constraints.gaxpy(1, solution, this->ax.data());
+      for (size_t j = 0; j < n; j++) {
+        residual[j] = -this->cost[j] - this->px[j];
+      }
+      for (size_t i = 0; i < this->nconstraints; i++) {
+        Scalar target = this->active[i] < 0 ? this->lower[i] : this->upper[i];
+        residual[n + i] = this->active[i] != 0 ? target - this->ax[i] : 0;
+      }
+      this->solve_kkt(this->polish_ldlt, this->polish_rho, residual);
+      Scalar correction = 0;
+      Scalar magnitude = 0;
+      for (size_t k = 0; k < n; k++) {
+        solution[k] += residual[k];
+        correction = std::max(correction, std::abs(residual[k]));
+        magnitude = std::max(magnitude, std::abs(solution[k]));
+      }
+      for (size_t i = 0; i < this->nconstraints; i++) {
+        if (this->active[i] == 0) {
+          solution[n + i] = 0;
+          continue;
+        }
+        solution[n + i] += residual[n + i];
+        correction = std::max(correction, std::abs(residual[n + i]));
+        magnitude = std::max(magnitude, std::abs(solution[n + i]));
+      }
+      // The refinement converges linearly with a ratio of about the
+      // regularization, so a negligible correction ends it
+      if (step > 0 && correction <= polish_refinement_tolerance *
+                                        std::max(magnitude, Scalar{1})) {
+        break;
+      }
+    }
+    // Keep the polished point if its residuals are no worse
+    std::copy(this->x.begin(), this->x.end(), this->x_previous.begin());
+    std::copy(this->y.begin(), this->y.end(), this->y_previous.begin());
+    std::copy(this->z.begin(), this->z.end(), this->z_previous.begin());
+    std::copy(solution, solution + n, this->x.begin());
+    std::copy(solution + n, solution + size, this->y.begin());
+    std::fill(this->z.begin(), this->z.end(), Scalar{0});
+    this->constraints.gaxpy(1, this->x.data(), this->z.data());
+    for (size_t i = 0; i < this->nconstraints; i++) {
+      this->z[i] = std::clamp(this->z[i], this->lower[i], this->upper[i]);
+    }
+    Residuals after = this->residuals();
+    Scalar absolute = this->options.absolute_tolerance;
+    bool keep = require_converged
+                    ? this->converged(after) &&
+                          this->polished_duals_consistent()
+                    : after.primal <= std::max(this->primal_residual,
+                                               absolute) &&
+                          after.dual <= std::max(this->dual_residual,
+                                                 absolute);
+    if (keep) {
+      this->primal_residual = after.primal;
+      this->dual_residual = after.dual;
+      this->polished = true;
+    } else {
+      this->x.swap(this->x_previous);
+      this->y.swap(this->y_previous);
+      this->z.swap(this->z_previous);
+    }
+    return keep;
+  }
+  /*! Unscale the current iterate into an LPSolution*/
+  LPSolution<Scalar> make_solution(LPStatus result) const {
+    size_t m = this->nrows;
+    LPSolution<Scalar> solution;
+    solution.status = result;
+    solution.iterations = this->iterations;
+    auto [x_unscaled, y_unscaled] = this->unscaled_iterate();
+    solution.x = std::move(x_unscaled);
+    solution.row_activity = this->problem.constraints.multiply(solution.x);
+    // Row duals in the convention of LPSolution (y >= 0 at lower bounds)
+    solution.row_duals.resize(m);
+    for (size_t i = 0; i < m; i++) {
+      solution.row_duals[i] = -y_unscaled[i];
+    }
+    solution.reduced_costs = this->problem.objective;
+    this->problem.add_hessian_product(solution.x.data(),
+                                      solution.reduced_costs.data());
+    this->problem.constraints.gaxpy_transpose(-1, solution.row_duals.data(),
+                                              solution.reduced_costs.data());
+    solution.objective = this->problem.evaluate(solution.x);
+    return solution;
+  }
+
+public:
+  // SECTION: Constructors
+  /*! Set up the solver for a problem (which is copied and scaled), and
+   * factor its linear system.
+   *
+   * @param problem The QP (or LP) to solve
+   * @param options Options of the solve
+   * */
+  explicit ADMM(QPProblem<Scalar> problem,
+                ADMMOptions<Scalar> const &options = {})
+      : problem(std::move(problem)), options(options),
+        nrows(this->problem.get_nrows()), ncols(this->problem.get_ncols()),
+        nconstraints(0), cost_scale(1), rho(options.rho),
+        polish_factored(false), analyses(0), factorizations(0),
+        primal_residual(0), dual_residual(0), iterations(0), polished(false),
+        started(false) {
+    this->problem.validate();
+    if (!(options.relaxation > 0 && options.relaxation < 2)) {
+      throw std::runtime_error("Relaxation must be in (0, 2)");
+    }
+    this->rho = std::clamp(this->rho, Scalar(rho_min), Scalar(rho_max));
+    this->setup(true);
+  }
+  ADMM(ADMM const &) = delete;
+  ADMM &operator=(ADMM const &) = delete;
+
+  // SECTION: Getters
+  /*! Get the current rho*/
+  Scalar get_rho() const { return this->rho; }
+  /*! Get the number of symbolic analyses of the linear system*/
+  size_t get_num_analyses() const { return this->analyses; }
+  /*! Get the number of numeric factorizations (one at setup, plus one per
+   * rho update or data update)*/
+  size_t get_num_factorizations() const { return this->factorizations; }
+  /*! Get the unscaled primal residual ||A x - z|| of the last check*/
+  Scalar get_primal_residual() const { return this->primal_residual; }
+  /*! Get the unscaled dual residual ||P x + q + A^T y|| of the last
+   * check*/
+  Scalar get_dual_residual() const { return this->dual_residual; }
+  /*! Get whether the last solution was polished*/
+  bool get_polished() const { return this->polished; }
+
+  // SECTION: Warm starts
+  /*! Start the next solve from a solution of this problem or a similar one
+   * (its x, row duals and reduced costs are used).
+   *
+   * Throws std::range_error if the lengths do not match the problem.
+   *
+   * @param solution The starting point
+   * */
+  void set_starting_point(LPSolution<Scalar> const &solution) {
+    size_t m = this->nrows;
+    if (solution.x.size() != this->ncols ||
+        solution.row_duals.size() != m ||
+        solution.reduced_costs.size() != this->ncols) {
+      throw std::range_error("Starting point does not match the problem");
+    }
+    // Duals of the stacked constraints: -y for rows, and -d for the
+    // bounded columns
+    std::vector<Scalar> duals(this->nconstraints);
+    for (size_t i = 0; i < m; i++) {
+      duals[i] = -solution.row_duals[i];
+    }
+    for (size_t k = 0; k < this->bounded.size(); k++) {
+      duals[m + k] = -solution.reduced_costs[this->bounded[k]];
+    }
+    this->load_iterate(solution.x, duals);
+    this->started = true;
+  }
+  /*! Replace the data of the problem. The scaling, symbolic analysis and
+   * factorization are kept as far as the changes allow: new costs or
+   * bounds only rescale vectors (a refactorization is needed if a bound
+   * turns a constraint into an equality or a free one), new matrix values
+   * or a new set of bounded columns refactor, and a new sparsity pattern
+   * also recomputes the scaling. The next solve
+   * starts from the last iterate when warm_start is set.
+   *
+   * Throws std::range_error if the dimensions differ from the current
+   * problem.
+   *
+   * @param problem The new problem
+   * @return The parts of the problem which changed
+   * */
+  ProblemChanges update(QPProblem<Scalar> problem) {
+    ProblemChanges changes = compare_problems(this->problem, problem);
+    if (!changes.any()) {
+      return changes;
+    }
+    auto [x_unscaled, y_unscaled] = this->unscaled_iterate();
+    std::vector<size_t> previous_bounded = this->bounded;
+    auto const &before = this->problem.hessian;
+    bool same_hessian = before.get_col_ptr() == problem.hessian.get_col_ptr() &&
+                        before.get_row_idx() == problem.hessian.get_row_idx() &&
+                        *before.get_values() == *problem.hessian.get_values();
+    bool same_bounded = true;
+    for (size_t j = 0; j < this->ncols && same_bounded; j++) {
+      same_bounded = (std::isfinite(problem.col_lower[j]) ||
+                      std::isfinite(problem.col_upper[j])) ==
+                     (std::isfinite(this->problem.col_lower[j]) ||
+                      std::isfinite(this->problem.col_upper[j]));
+    }
+    this->problem = std::move(problem);
+    if (changes.values || !same_hessian || !same_bounded) {
+      this->setup(changes.pattern);
+    } else {
+      // Only vectors changed: the matrix is refactored only if a
+      // constraint became (or stopped being) an equality or free
+      std::vector<Scalar> previous_rho = this->rho_vector;
+      this->load_vectors();
+      this->compute_rho_vector();
+      if (this->rho_vector != previous_rho) {
+        this->refactor(this->kkt, this->ldlt, this->rho_vector);
+      }
+    }
+    if (this->bounded == previous_bounded) {
+      this->load_iterate(x_unscaled, y_unscaled);
+    } else {
+      // The duals of the bounds cannot be mapped
+      this->load_iterate(x_unscaled,
+                         std::vector<Scalar>(this->nconstraints, 0));
+    }
+    return changes;
+  }
+
+  // SECTION: Solving
+  /*! Solve the problem, from the current iterate when warm_start is set
+   * (zero initially) and from zero otherwise. A warm start is polished
+   * first when polish_warm_start is set, and returned without iterating
+   * if that meets the tolerances.
+   *
+   * @return The solution (without basis statuses)
+   * */
+  LPSolution<Scalar> solve() {
+    if (!this->options.warm_start) {
+      std::fill(this->x.begin(), this->x.end(), Scalar{0});
+      std::fill(this->z.begin(), this->z.end(), Scalar{0});
+      std::fill(this->y.begin(), this->y.end(), Scalar{0});
+      this->started = false;
+    }
+    this->iterations = 0;
+    this->polished = false;
+    for (size_t i = 0; i < this->nconstraints; i++) {
+      if (this->lower[i] > this->upper[i]) {
+        this->started = false;
+        return this->make_solution(LPStatus::infeasible);
+      }
+    }
+    if (this->started && this->options.polish &&
+        this->options.polish_warm_start && this->polish(true)) {
+      return this->make_solution(LPStatus::optimal);
+    }
+    LPStatus result = this->run();
+    if (result == LPStatus::optimal && this->options.polish) {
+      this->polish(false);
+    }
+    this->started = result == LPStatus::optimal;
+    return this->make_solution(result);
+  }
+};
+
+/*! Solve a QP with the ADMM method (see ADMM).
+ *
+ * @param problem The QP to solve
+ * @param options Options of the solve
+ * @return The solution
+ * */
+template <typename Scalar>
+LPSolution<Scalar> solve_admm(QPProblem<Scalar> const &problem,
+                              ADMMOptions<Scalar> const &options = {}) {
+  ADMM<Scalar> solver{problem, options};
+  return solver.solve();
+}
+/*! Solve an LP with the ADMM method (see ADMM).
+ *
+ * @param problem The LP to solve
+ * @param options Options of the solve
+ * @return The solution
+ * */
+template <typename Scalar>
+LPSolution<Scalar> solve_admm(LPProblem<Scalar> const &problem,
+                              ADMMOptions<Scalar> const &options = {}) {
+  ADMM<Scalar> solver{QPProblem<Scalar>{problem}, options};
+  return solver.solve();
+}
+} // namespace teensylp
@@ -0,0 +1,488 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/indexed_vector.hpp"
+#include "TeensyOpt/TeensyMat/sparse_core.hpp"
+
+namespace teensylp {
+/*! Sparse LU factorization of a simplex basis, with product form updates.
+ *
+ * Variable j < n is column j of the constraint matrix A, and variable n + i
+ * is the logical of row i, whose column is -e_i (so that A x - r = 0). A
+ * basis is the list of the m variables at each basis position, and B is the
+ * matrix with their columns in position order.
+ *
+ * The factorization P B Q = L U is computed left looking (Gilbert-Peierls),
+ * with columns taken sparsest first and threshold partial pivoting which
+ * prefers rows with few nonzeros. Both L and U are kept by columns and by
+ * rows, so that the solves with B (FTRAN) and with B^T (BTRAN) only visit
+ * the entries reachable from the nonzeros of the right hand side when it is
+ * sparse. Basis changes append an eta vector (product form of the inverse)
+ * until the basis is refactorized.
+ * */
+template <typename Scalar> class BasisFactor {
+public:
+  /*! Marker for "no index"*/
+  static constexpr size_t npos = std::numeric_limits<size_t>::max();
+  /*! Entries whose magnitude falls below this are dropped from solutions*/
+  static constexpr Scalar drop_tolerance = 1e-14;
+  /*! Pivots must be at least this fraction of the largest candidate*/
+  static constexpr Scalar pivot_threshold = 0.1;
+  /*! Columns whose candidate pivots are all below this are singular*/
+  static constexpr Scalar singular_tolerance = 1e-11;
+  /*! Right hand sides denser than this fraction use the dense solves*/
+  static constexpr double hypersparse_density = 0.05;
+
+private:
+  /*! The number of rows of A (and size of the basis)*/
+  size_t nrows;
+  /*! The constraint matrix, owned by the caller*/
+  teensymat::SparseMatrix<Scalar> const *constraints;
+  /*! Strictly lower part of L by columns, in pivot order*/
+  std::vector<size_t> l_ptr, l_idx;
+  std::vector<Scalar> l_val;
+  /*! Strictly lower part of L by rows, in pivot order*/
+  std::vector<size_t> lt_ptr, lt_idx;
+  std::vector<Scalar> lt_val;
+  /*! Strictly upper part of U by columns, in pivot order*/
+  std::vector<size_t> u_ptr, u_idx;
+  std::vector<Scalar> u_val;
+  /*! Strictly upper part of U by rows, in pivot order*/
+  std::vector<size_t> ut_ptr, ut_idx;
+  std::vector<Scalar> ut_val;
+  /*! Diagonal of U*/
+  std::vector<Scalar> u_diag;
+  /*! Pivot step of each row (P)*/
+  std::vector<size_t> row_to_step;
+  /*! Row pivoted at each step*/
+  std::vector<size_t> step_to_row;
+  /*! Basis position factorized at each step (Q)*/
+  std::vector<size_t> step_to_position;
+  /*! Step at which each basis position was factorized*/
+  std::vector<size_t> position_to_step;
+  /*! Eta file: start of each eta in eta_index and eta_value*/
+  std::vector<size_t> eta_start;
+  /*! Basis position replaced by each eta*/
+  std::vector<size_t> eta_position;
+  /*! Pivot value of each eta*/
+  std::vector<Scalar> eta_pivot;
+  /*! Off pivot entries of the etas*/
+  std::vector<size_t> eta_index;
+  std::vector<Scalar> eta_value;
+  /*! Workspace of the solves (in pivot order)*/
+  mutable teensymat::IndexedVector<Scalar> work;
+  /*! Workspace of the depth first searches*/
+  mutable std::vector<size_t> dfs_node, dfs_next, postorder;
+  mutable std::vector<char> marked;
+
+  // SECTION: Helpers
+  /*! Call func(row, value) for every entry of the column of a variable*/
+  template <typename Func> void for_each_entry(size_t var, Func &&func) const {
+    size_t ncols = this->constraints->get_ncols();
+    if (var >= ncols) {
+      func(var - ncols, Scalar{-1});
+      return;
+    }
+    auto const &col_ptr = this->constraints->get_col_ptr();
+    auto const &row_idx = this->constraints->get_row_idx();
+    Scalar const *values = this->constraints->get_values()->data();
+    for (size_t k = col_ptr[var]; k < col_ptr[var + 1]; k++) {
+      func(row_idx[k], values[k]);
+    }
+  }
+  /*! Depth first search of the nodes reachable from starts in the graph with
+   * edges node -> idx[ptr[c]..ptr[c + 1]) where c = column_of(node) (no
+   * edges if c is npos). Leaves the reached nodes in postorder, so that the
+   * reverse of this->postorder is a topological order.*/
+  template <typename ColumnOf>
+  void reach(std::vector<size_t> const &starts, std::vector<size_t> const &ptr,
+             std::vector<size_t> const &idx, ColumnOf column_of) const {
+    this->postorder.clear();
+    for (size_t start : starts) {
+      if (this->marked[start]) {
+        continue;
+      }
+      this->marked[start] = 1;
+      size_t col = column_of(start);
+      this->dfs_node.push_back(start);
+      this->dfs_next.push_back(col == npos ? 0 : ptr[col]);
+      while (!this->dfs_node.empty()) {
+        size_t node = this->dfs_node.back();
+        size_t node_col = column_of(node);
+        size_t end = node_col == npos ? 0 : ptr[node_col + 1];
+        size_t &next = this->dfs_next.back();
+        size_t child = npos;
+        while (next < end) {
+          size_t candidate = idx[next++];
+          if (!this->marked[candidate]) {
+            child = candidate;
+            break;
+          }
+        }
+        if (child == npos) {
+          this->postorder.push_back(node);
+          this->dfs_node.pop_back();
+          this->dfs_next.pop_back();
+        } else {
+          this->marked[child] = 1;
+          size_t child_col = column_of(child);
+          this->dfs_node.push_back(child);
+          this->dfs_next.push_back(child_col == npos ? 0 : ptr[child_col]);
+        }
+      }
+    }
+    for (size_t node : this->postorder) {
+      this->marked[node] = 0;
+    }
+  }
+  /*! Solve T z = x in place for a triangular T given by columns, with unit
+   * diagonal if diag is null.
+   *
+   * @param x Right hand side, overwritten with the solution
+   * @param lower Whether T is lower (otherwise upper) triangular
+   * */
+  void triangular_solve(teensymat::IndexedVector<Scalar> &x,
+                        std::vector<size_t> const &ptr,
+                        std::vector<size_t> const &idx,
+                        std::vector<Scalar> const &val, Scalar const *diag,
+                        bool lower) const {
+    Scalar *values = x.values.data();
+    auto eliminate = [&](size_t j) {
+      Scalar xj = values[j];
+      if (xj == Scalar{0}) {
+        return;
+      }
+      if (diag != nullptr) {
+        xj /= diag[j];
+        values[j] = xj;
+      }
+      for (size_t p = ptr[j]; p < ptr[j + 1]; p++) {
+        values[idx[p]] -= val[p] * xj;
+      }
+    };
+    if (x.get_density() < hypersparse_density) {
+      this->reach(x.index, ptr, idx, [](size_t node) { return node; });
+      for (size_t k = this->postorder.size(); k-- > 0;) {
+        eliminate(this->postorder[k]);
+      }
+      x.index.swap(this->postorder);
+      x.drop_small(drop_tolerance);
+      return;
+    }
+    if (lower) {
+      for (size_t j = 0; j < this->nrows; j++) {
+        eliminate(j);
+      }
+    } else {
+      for (size_t j = this->nrows; j-- > 0;) {
+        eliminate(j);
+      }
+    }
+    x.rebuild_index();
+    x.drop_small(drop_tolerance);
+  }
+  /*! Build the row wise copy of a matrix given by columns*/
+  void transpose_factor(std::vector<size_t> const &ptr,
+                        std::vector<size_t> const &idx,
+                        std::vector<Scalar> const &val,
+                        std::vector<size_t> &t_ptr, std::vector<size_t> &t_idx,
+                        std::vector<Scalar> &t_val) const {
+    t_ptr.assign(this->nrows + 1, 0);
+    for (size_t i : idx) {
+      t_ptr[i + 1]++;
+    }
+    std::partial_sum(t_ptr.begin(), t_ptr.end(), t_ptr.begin());
+    std::vector<size_t> next(t_ptr.begin(), t_ptr.end() - 1);
+    t_idx.resize(idx.size());
+    t_val.resize(idx.size());
+    for (size_t j = 0; j < this->nrows; j++) {
+      for (size_t p = ptr[j]; p < ptr[j + 1]; p++) {
+        size_t position = next[idx[p]]++;
+        t_idx[position] = j;
+        t_val[position] = val[p];
+      }
+    }
+  }
+
+public:
+  // SECTION: Constructors
+  /*! Construct the factor of the slack basis of a constraint matrix.
+   *
+   * @param constraints The constraint matrix A, which must outlive the
+   * factor
+   * */
+  explicit BasisFactor(teensymat::SparseMatrix<Scalar> const &constraints)
+      : nrows(constraints.get_nrows()), constraints(&constraints),
+        work(constraints.get_nrows()), marked(constraints.get_nrows(), 0) {
+    std::vector<size_t> basic(this->nrows);
+    for (size_t i = 0; i < this->nrows; i++) {
+      basic[i] = constraints.get_ncols() + i;
+    }
+    this->factorize(basic);
+  }
+
+  // SECTION: Getters
+  /*! Get the number of basis updates since the last factorization*/
+  size_t get_num_updates() const { return this->eta_position.size(); }
+  /*! Get the number of stored entries of L and U (including the diagonal)*/
+  size_t get_factor_nnz() const {
+    return this->l_idx.size() + this->u_idx.size() + this->nrows;
+  }
+  /*! Get the number of stored entries of the eta file*/
+  size_t get_eta_nnz() const {
+    return this->eta_index.size() + this->eta_position.size();
+  }
+
+  // SECTION: Factorization
+  /*! Factorize a basis, discarding all updates.
+   *
+   * If the basis is singular, the variables of the dependent positions are
+   * replaced by logicals of rows without a pivot, so the factorized basis is
+   * always nonsingular.
+   *
+   * @param basic Variable at each basis position, modified if singular
+   * @return (position, variable) for every variable removed from the basis
+   * */
+  std::vector<std::pair<size_t, size_t>> factorize(std::vector<size_t> &basic) {
+    size_t m = this->nrows;
+    if (basic.size() != m) {
+      throw std::range_error("Basis has the wrong number of variables");
+    }
+    // Sparsest columns first (logicals are singletons and go first)
+    std::vector<size_t> col_count(m, 0);
+    std::vector<size_t> row_count(m, 0);
+    for (size_t p = 0; p < m; p++) {
+      this->for_each_entry(basic[p], [&](size_t row, Scalar) {
+        col_count[p]++;
+        row_count[row]++;
+      });
+    }
+    std::vector<size_t> order(m);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return col_count[a] < col_count[b];
+    });
+
+    this->l_ptr.assign(1, 0);
+    this->l_idx.clear();
+    this->l_val.clear();
+    this->u_ptr.assign(1, 0);
+    this->u_idx.clear();
+    this->u_val.clear();
+    this->u_diag.clear();
+    this->row_to_step.assign(m, npos);
+    this->step_to_position.clear();
+    std::vector<size_t> deficient;
+    std::vector<Scalar> &x = this->work.values;
+    std::vector<size_t> starts;
+    auto column_of = [this](size_t row) { return this->row_to_step[row]; };
+    size_t step = 0;
+    for (size_t position : order) {
+      // Solve L x = B(:, position) with the columns of L found so far
+      starts.clear();
+      this->for_each_entry(basic[position], [&](size_t row, Scalar value) {
+        starts.push_back(row);
+        x[row] = value;
+      });
+      this->reach(starts, this->l_ptr, this->l_idx, column_of);
+      for (size_t k = this->postorder.size(); k-- > 0;) {
+        size_t row = this->postorder[k];
+        size_t col = this->row_to_step[row];
+        if (col == npos || x[row] == Scalar{0}) {
+          continue;
+        }
+        for (size_t p = this->l_ptr[col]; p < this->l_ptr[col + 1]; p++) {
+          x[this->l_idx[p]] -= this->l_val[p] * x[row];
+        }
+      }
+      // Threshold pivoting among the rows without a pivot, preferring short
+      // rows to limit fill
+      Scalar largest = 0;
+      for (size_t row : this->postorder) {
+        if (this->row_to_step[row] == npos) {
+          largest = std::max(largest, std::abs(x[row]));
+        }
+      }
+      if (largest <= singular_tolerance) {
+        deficient.push_back(position);
+        for (size_t row : this->postorder) {
+          x[row] = 0;
+        }
+        continue;
+      }
+      size_t pivot_row = npos;
+      for (size_t row : this->postorder) {
+        Scalar magnitude = std::abs(x[row]);
+        if (this->row_to_step[row] != npos ||
+            magnitude < pivot_threshold * largest) {
+          continue;
+        }
+        if (pivot_row == npos || row_count[row] < row_count[pivot_row] ||
+            (row_count[row] == row_count[pivot_row] &&
+             magnitude > std::abs(x[pivot_row]))) {
+          pivot_row = row;
+        }
+      }
+      Scalar pivot = x[pivot_row];
+      for (size_t row : this->postorder) {
+        Scalar value = x[row];
+        x[row] = 0;
+        if (value == Scalar{0} || row == pivot_row) {
+          continue;
+        }
+        if (this->row_to_step[row] != npos) {
+          this->u_idx.push_back(this->row_to_step[row]);
+          this->u_val.push_back(value);
+        } else {
+          this->l_idx.push_back(row);
+          this->l_val.push_back(value / pivot);
+        }
+      }
+      this->u_diag.push_back(pivot);
+      this->row_to_step[pivot_row] = step;
+      this->step_to_position.push_back(position);
+      this->l_ptr.push_back(this->l_idx.size());
+      this->u_ptr.push_back(this->u_idx.size());
+      step++;
+    }
+    // Replace dependent columns by logicals of the rows left without pivot
+    std::vector<std::pair<size_t, size_t>> replaced;
+    size_t free_row = 0;
+    for (size_t position : deficient) {
+      while (this->row_to_step[free_row] != npos) {
+        free_row++;
+      }
+      replaced.emplace_back(position, basic[position]);
+      basic[position] = this->constraints->get_ncols() + free_row;
+      this->u_diag.push_back(-1);
+      this->row_to_step[free_row] = step;
+      this->step_to_position.push_back(position);
+      this->l_ptr.push_back(this->l_idx.size());
+      this->u_ptr.push_back(this->u_idx.size());
+      step++;
+    }
+    // Renumber the rows of L into pivot order
+    for (size_t &row : this->l_idx) {
+      row = this->row_to_step[row];
+    }
+    this->step_to_row.assign(m, 0);
+    this->position_to_step.assign(m, 0);
+    for (size_t row = 0; row < m; row++) {
+      this->step_to_row[this->row_to_step[row]] = row;
+    }
+    for (size_t k = 0; k < m; k++) {
+      this->position_to_step[this->step_to_position[k]] = k;
+    }
+    this->transpose_factor(this->l_ptr, this->l_idx, this->l_val, this->lt_ptr,
+                           this->lt_idx, this->lt_val);
+    this->transpose_factor(this->u_ptr, this->u_idx, this->u_val, this->ut_ptr,
+                           this->ut_idx, this->ut_val);
+    this->eta_start.assign(1, 0);
+    this->eta_position.clear();
+    this->eta_pivot.clear();
+    this->eta_index.clear();
+    this->eta_value.clear();
+    return replaced;
+  }
+  /*! Record the replacement of the variable at a basis position.
+   *
+   * @param position The basis position which changes
+   * @param column The FTRAN of the entering column (B^-1 a_q, indexed by
+   * basis position)
+   * */
+  void update(size_t position, teensymat::IndexedVector<Scalar> const &column) {
+    this->eta_position.push_back(position);
+    this->eta_pivot.push_back(column.values[position]);
+    for (size_t i : column.index) {
+      if (i != position) {
+        this->eta_index.push_back(i);
+        this->eta_value.push_back(column.values[i]);
+      }
+    }
+    this->eta_start.push_back(this->eta_index.size());
+  }
+
+  // SECTION: Solves
+  /*! Solve B z = a in place (FTRAN).
+   *
+   * @param rhs On entry a, indexed by row; on exit z, indexed by basis
+   * position
+   * */
+  void ftran(teensymat::IndexedVector<Scalar> &rhs) const {
+    this->work.clear();
+    for (size_t row : rhs.index) {
+      size_t k = this->row_to_step[row];
+      this->work.values[k] = rhs.values[row];
+      this->work.index.push_back(k);
+    }
+    rhs.clear();
+    this->triangular_solve(this->work, this->l_ptr, this->l_idx, this->l_val,
+                           nullptr, true);
+    this->triangular_solve(this->work, this->u_ptr, this->u_idx, this->u_val,
+                           this->u_diag.data(), false);
+    for (size_t k : this->work.index) {
+      size_t position = this->step_to_position[k];
+      rhs.values[position] = this->work.values[k];
+      rhs.index.push_back(position);
+    }
+    this->work.clear();
+    for (size_t e = 0; e < this->eta_position.size(); e++) {
+      size_t position = this->eta_position[e];
+      Scalar value = rhs.values[position];
+      if (value == Scalar{0}) {
+        continue;
+      }
+      value /= this->eta_pivot[e];
+      rhs.values[position] = value;
+      for (size_t p = this->eta_start[e]; p < this->eta_start[e + 1]; p++) {
+        rhs.add(this->eta_index[p], -this->eta_value[p] * value);
+      }
+    }
+    rhs.drop_small(drop_tolerance);
+  }
+  /*! Solve B^T y = e in place (BTRAN).
+   *
+   * @param rhs On entry e, indexed by basis position; on exit y, indexed by
+   * row
+   * */
+  void btran(teensymat::IndexedVector<Scalar> &rhs) const {
+    for (size_t e = this->eta_position.size(); e-- > 0;) {
+      size_t position = this->eta_position[e];
+      Scalar value = rhs.values[position];
+      for (size_t p = this->eta_start[e]; p < this->eta_start[e + 1]; p++) {
+        value -= this->eta_value[p] * rhs.values[this->eta_index[p]];
+      }
+      Scalar solved = value / this->eta_pivot[e];
+      if (solved != rhs.values[position]) {
+        rhs.add(position, solved - rhs.values[position]);
+      }
+    }
+    this->work.clear();
+    for (size_t position : rhs.index) {
+      size_t k = this->position_to_step[position];
+      this->work.values[k] = rhs.values[position];
+      this->work.index.push_back(k);
+    }
+    rhs.clear();
+    this->triangular_solve(this->work, this->ut_ptr, this->ut_idx, this->ut_val,
+                           this->u_diag.data(), true);
+    this->triangular_solve(this->work, this->lt_ptr, this->lt_idx, this->lt_val,
+                           nullptr, false);
+    for (size_t k : this->work.index) {
+      size_t row = this->step_to_row[k];
+      rhs.values[row] = this->work.values[k];
+      rhs.index.push_back(row);
+    }
+    this->work.clear();
+  }
+};
+} // namespace teensylp
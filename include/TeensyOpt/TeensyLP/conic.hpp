@@ -0,0 +1,1085 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyLP/lp_problem.hpp"
+#include "TeensyOpt/TeensyMat/linalg.hpp"
+#include "TeensyOpt/TeensyMat/sparse_core.hpp"
+#include "TeensyOpt/TeensyMat/sparse_ldlt.hpp"
+
+namespace teensylp {
+/*! Kinds of cones of a ConicProblem*/
+enum class ConeType {
+  /*! The nonnegative orthant, s_i >= 0*/
+  nonnegative,
+  /*! The second order cone, s_0 >= ||(s_1, ..., s_{d-1})||*/
+  second_order,
+  /*! The exponential cone (dimension 3), the closure of
+   * {(r, s, t) : s > 0, s exp(r / s) <= t}*/
+  exponential,
+};
+
+/*! One cone of a ConicProblem*/
+struct Cone {
+  /*! Kind of the cone*/
+  ConeType type;
+  /*! Number of rows of the cone*/
+  size_t dim;
+};
+
+/*! A conic program
+ *
+ *     minimize c^T x
+ *     subject to A x = b
+ *                G x + s = h,  s in K
+ *
+ * where K is a product of cones, each taking consecutive rows of G.
+ * */
+template <typename Scalar> struct ConicProblem {
+  /*! The cost c*/
+  std::vector<Scalar> objective;
+  /*! The equality constraints A and b (A may have no rows)*/
+  teensymat::SparseMatrix<Scalar> equality_matrix;
+  std::vector<Scalar> equality_rhs;
+  /*! The cone constraints G and h*/
+  teensymat::SparseMatrix<Scalar> cone_matrix;
+  std::vector<Scalar> cone_rhs;
+  /*! The cones, in the order of the rows of G*/
+  std::vector<Cone> cones;
+
+  /*! Get the number of variables*/
+  size_t get_num_variables() const { return this->objective.size(); }
+  /*! Check the dimensions, throwing std::range_error if they do not match*/
+  void validate() const {
+    size_t n = this->get_num_variables();
+    if (this->equality_matrix.get_ncols() != n ||
+        this->equality_matrix.get_nrows() != this->equality_rhs.size()) {
+      throw std::range_error("Equality constraints do not match the problem");
+    }
+    if (this->cone_matrix.get_ncols() != n ||
+        this->cone_matrix.get_nrows() != this->cone_rhs.size()) {
+      throw std::range_error("Cone constraints do not match the problem");
+    }
+    size_t rows = 0;
+    for (Cone const &cone : this->cones) {
+      if (cone.dim == 0 ||
+          (cone.type == ConeType::exponential && cone.dim != 3)) {
+        throw std::range_error("Cone has an invalid dimension");
+      }
+      rows += cone.dim;
+    }
+    if (rows != this->cone_rhs.size()) {
+      throw std::range_error("Cones do not cover the rows of G");
+    }
+  }
+};
+
+/*! Options of ConicSolver*/
+template <typename Scalar> struct ConicOptions {
+  /*! Maximum number of iterations*/
+  size_t max_iterations = 100;
+  /*! Relative residuals and duality gap of a solution*/
+  Scalar tolerance = 1e-8;
+  /*! Fraction of the step to the boundary taken*/
+  Scalar step_factor = 0.99;
+  /*! Regularization of the linear system (added to the x block,
+   * subtracted from the others)*/
+  Scalar static_regularization = 1e-8;
+  /*! Iterative refinement steps against the unregularized system*/
+  size_t refinement_steps = 10;
+  /*! Second order cones of at most this dimension put their (dense) W^2
+   * into the linear system, larger ones use the sparse expansion*/
+  size_t dense_cone_dim = 4;
+  /*! Steps are shortened until s_k^T z_k / 3 >= exponential_neighborhood
+   * * mu for every exponential cone, keeping the iterates central*/
+  Scalar exponential_neighborhood = 0.01;
+};
+
+/*! Solution of a ConicProblem*/
+template <typename Scalar> struct ConicSolution {
+  /*! Outcome of the solve*/
+  LPStatus status = LPStatus::numerical_error;
+  /*! Objective value c^T x*/
+  Scalar objective = 0;
+  /*! The variables*/
+  std::vector<Scalar> x;
+  /*! The slacks s = h - G x of the cones*/
+  std::vector<Scalar> s;
+  /*! Duals of the equality constraints*/
+  std::vector<Scalar> y;
+  /*! Duals of the cone constraints (in the dual cone), such that
+   * c + A^T y + G^T z = 0*/
+  std::vector<Scalar> z;
+  /*! Number of iterations performed*/
+  size_t iterations = 0;
+};
+
+/*! Primal-dual interior point method for ConicProblem over products of
+ * nonnegative orthants, second order cones and exponential cones.
+ *
+ * Each iteration solves the Newton system
+ *
+ *     [ 0  A^T  G^T ] [dx]   [ -r_x       ]
+ *     [ A   0    0  ] [dy] = [ -r_y       ]
+ *     [ G   0   -H  ] [dz]   [ -r_z - r_c ]
+ *
+ * and recovers ds = r_c - H dz. The symmetric cones use Nesterov-Todd
+ * scaling, H = W^2 with W z = W^-1 s = lambda, with Mehrotra's predictor
+ * and corrector. The exponential cones, which have no such scaling, use
+ * the Hessian of the dual barrier, H = mu grad^2 f(z), and their steps
+ * are shortened to stay in a neighborhood of the central path.
+ *
+ * The dense W^2 of a large second order cone is expanded into sparse
+ * form: W^2 = eta^2 (D + u u^T - v v^T) with D diagonal gives two extra
+ * rows and columns with entries eta v and eta u, so the system keeps the
+ * sparsity of G. Small cones, whose dense blocks are cheap, keep W^2 as
+ * the expansion is less stable near the boundary of the cone (its
+ * entries grow like a^2 while d shrinks like 1 / a^2). With a static
+ * regularization the system is quasi
+ * definite and factored by SparseLDLT with known pivot signs; its
+ * pattern is analyzed once, and each iteration only refactors it.
+ * Iterative refinement against the unregularized system removes the
+ * effect of the regularization.
+ *
+ * Infeasible and unbounded problems are detected from approximate
+ * certificates (A^T y + G^T z ~ 0 with b^T y + h^T z < 0, or A x ~ 0 and
+ * G x + s ~ 0 with c^T x < 0) formed by the diverging iterates, and like
+ * InteriorPoint when the iterates grow beyond a limit.
+ * */
+template <typename Scalar> class ConicSolver {
+public:
+  /*! Marker for "no index"*/
+  static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+private:
+  /*! Iterates growing beyond this are taken as a sign of infeasibility*/
+  static constexpr double divergence_limit = 1e10;
+  /*! Relative residual of the linear solves below which the sparse
+   * expansion of the second order cones is kept*/
+  static constexpr double solve_accuracy = 1e-9;
+  /*! Point in the interior of both the exponential cone and its dual,
+   * used as the starting point of their slacks and duals*/
+  static constexpr double exp_center[3] = {-1.051383945322714,
+                                           0.556409619469370,
+                                           1.258967884768947};
+
+  /*! The problem*/
+  ConicProblem<Scalar> problem;
+  /*! Options of the solve*/
+  ConicOptions<Scalar> options;
+  /*! Number of variables, equality rows and cone rows*/
+  size_t n, p, m;
+  /*! Degree of the cone (barrier parameter)*/
+  size_t degree;
+  /*! Second order cones up to this dimension get dense blocks (starts at
+   * the option, and covers all cones after a fallback)*/
+  size_t dense_dim;
+  /*! First row of each cone, first extra row of the linear system of
+   * each expanded second order cone, and first position in block_entry of
+   * each cone with a dense block (npos if not applicable)*/
+  std::vector<size_t> cone_offset, cone_extra, cone_block;
+  /*! The linear system (upper triangle) and its factorization*/
+  teensymat::SparseMatrix<Scalar> kkt;
+  teensymat::SparseLDLT<Scalar> ldlt;
+  /*! Positions in the values of kkt: the diagonal, the two extra entries
+   * of every expanded second order cone row, the upper triangle of every
+   * dense cone block (row by row)*/
+  std::vector<size_t> diagonal_entry, extra_entry, block_entry;
+  /*! Number of symbolic analyses and numeric factorizations*/
+  size_t analyses, factorizations;
+  /*! Number of iterations performed in the current solve*/
+  size_t iterations;
+  /*! The iterate*/
+  std::vector<Scalar> x, y, z, s;
+  /*! Scaling: lambda, and per cone row the NT point (w_bar for second
+   * order cones, sqrt(s / z) for nonnegative ones); eta per cone*/
+  std::vector<Scalar> lambda, nt_point, eta;
+  /*! Exponential cones: gradient of the dual barrier at z, and H (nine
+   * entries per row of the cone, at its offset * 3)*/
+  std::vector<Scalar> exp_gradient, exp_hessian;
+  /*! Residuals r_x, r_y, r_z*/
+  std::vector<Scalar> rx, ry, rz;
+  /*! Right hand side (solved in place) and residual of the linear system*/
+  std::vector<Scalar> rhs, error;
+  /*! Newton direction*/
+  std::vector<Scalar> dx, dy, dz, ds;
+  /*! Right hand sides of the x, y and z rows of the Newton system (rhs_z
+   * doubles as a workspace while computing r_c)*/
+  std::vector<Scalar> rhs_x, rhs_y, rhs_z;
+  /*! Complementarity right hand side r_c and cone sized workspaces*/
+  std::vector<Scalar> rc, work, work2;
+
+  // SECTION: Setup
+  /*! Position of entry (row, col) in the values of kkt*/
+  size_t kkt_entry(size_t row, size_t col) const {
+    auto const &col_ptr = this->kkt.get_col_ptr();
+    auto const &row_idx = this->kkt.get_row_idx();
+    auto begin = row_idx.begin() + col_ptr[col];
+    auto end = row_idx.begin() + col_ptr[col + 1];
+    return static_cast<size_t>(std::lower_bound(begin, end, row) -
+                               row_idx.begin());
+  }
+  /*! Build the pattern of the linear system and analyze it*/
+  void setup_kkt() {
+    size_t n = this->n;
+    size_t p = this->p;
+    size_t m = this->m;
+    size_t zero = n + p;
+    size_t size = zero + m;
+    this->cone_offset.clear();
+    this->cone_extra.clear();
+    this->cone_block.clear();
+    size_t offset = 0;
+    size_t blocks = 0;
+    for (Cone const &cone : this->problem.cones) {
+      this->cone_offset.push_back(offset);
+      this->cone_extra.push_back(npos);
+      this->cone_block.push_back(npos);
+      if (cone.type == ConeType::second_order &&
+          cone.dim > this->dense_dim) {
+        this->cone_extra.back() = size;
+        size += 2;
+      } else if (cone.type != ConeType::nonnegative) {
+        this->cone_block.back() = blocks;
+        blocks += cone.dim * (cone.dim + 1) / 2;
+      }
+      offset += cone.dim;
+    }
+    std::vector<size_t> rows, cols;
+    std::vector<Scalar> vals;
+    auto add = [&](size_t i, size_t j, Scalar value) {
+      rows.push_back(std::min(i, j));
+      cols.push_back(std::max(i, j));
+      vals.push_back(value);
+    };
+    for (size_t k = 0; k < size; k++) {
+      add(k, k, 0);
+    }
+    auto add_matrix = [&](teensymat::SparseMatrix<Scalar> const &matrix,
+                          size_t first) {
+      auto const &col_ptr = matrix.get_col_ptr();
+      auto const &row_idx = matrix.get_row_idx();
+      Scalar const *values = matrix.get_values()->data();
+      for (size_t j = 0; j < n; j++) {
+        for (size_t k = col_ptr[j]; k < col_ptr[j + 1]; k++) {
+          add(j, first + row_idx[k], values[k]);
+        }
+      }
+    };
+    add_matrix(this->problem.equality_matrix, n);
+    add_matrix(this->problem.cone_matrix, zero);
+    for (size_t c = 0; c < this->problem.cones.size(); c++) {
+      Cone const &cone = this->problem.cones[c];
+      size_t first = zero + this->cone_offset[c];
+      if (this->cone_extra[c] != npos) {
+        for (size_t i = 0; i < cone.dim; i++) {
+          add(first + i, this->cone_extra[c], 0);
+          add(first + i, this->cone_extra[c] + 1, 0);
+        }
+      } else if (this->cone_block[c] != npos) {
+        for (size_t i = 0; i < cone.dim; i++) {
+          for (size_t j = i + 1; j < cone.dim; j++) {
+            add(first + i, first + j, 0);
+          }
+        }
+      }
+    }
+    this->kkt = teensymat::SparseMatrix<Scalar>::from_triplets(size, size,
+                                                               rows, cols,
+                                                               vals);
+    this->diagonal_entry.resize(size);
+    for (size_t k = 0; k < size; k++) {
+      this->diagonal_entry[k] = this->kkt_entry(k, k);
+    }
+    this->extra_entry.assign(2 * m, npos);
+    this->block_entry.assign(blocks, npos);
+    for (size_t c = 0; c < this->problem.cones.size(); c++) {
+      Cone const &cone = this->problem.cones[c];
+      size_t offset = this->cone_offset[c];
+      if (this->cone_extra[c] != npos) {
+        for (size_t i = 0; i < cone.dim; i++) {
+          size_t row = zero + offset + i;
+          this->extra_entry[2 * (offset + i)] =
+              this->kkt_entry(row, this->cone_extra[c]);
+          this->extra_entry[2 * (offset + i) + 1] =
+              this->kkt_entry(row, this->cone_extra[c] + 1);
+        }
+      } else if (this->cone_block[c] != npos) {
+        size_t slot = this->cone_block[c];
+        for (size_t i = 0; i < cone.dim; i++) {
+          for (size_t j = i; j < cone.dim; j++) {
+            this->block_entry[slot++] =
+                this->kkt_entry(zero + offset + i, zero + offset + j);
+          }
+        }
+      }
+    }
+    this->ldlt.analyze(this->kkt);
+    this->analyses++;
+    // x and the second extra row of each expanded second order cone are
+    // the positive pivots
+    std::vector<signed char> signs(size, -1);
+    std::fill(signs.begin(), signs.begin() + n, 1);
+    for (size_t extra : this->cone_extra) {
+      if (extra != npos) {
+        signs[extra + 1] = 1;
+      }
+    }
+    this->ldlt.set_dynamic_regularization(std::move(signs), Scalar(1e-13),
+                                          Scalar(1e-7));
+    this->rhs.assign(size, 0);
+  }
+
+  // SECTION: Cones
+  /*! Whether a point is in the interior of a cone (primal == true) or of
+   * its dual*/
+  bool interior(ConeType type, size_t dim, Scalar const *v,
+                bool primal) const {
+    switch (type) {
+    case ConeType::nonnegative:
+      return v[0] > 0;
+    case ConeType::second_order: {
+      Scalar tail = teensymat::nrm2(dim - 1, v + 1);
+      return v[0] > tail;
+    }
+    case ConeType::exponential:
+      if (primal) {
+        return v[1] > 0 && v[2] > 0 &&
+               v[1] * std::log(v[2] / v[1]) - v[0] > 0;
+      }
+      return v[0] < 0 && v[2] > 0 &&
+             v[1] - v[0] + v[0] * std::log(-v[0] / v[2]) > 0;
+    }
+    return false;
+  }
+  /*! The Jordan product a o b on a symmetric cone*/
+  static void jordan_product(ConeType type, size_t dim, Scalar const *a,
+                             Scalar const *b, Scalar *out) {
+    if (type == ConeType::nonnegative) {
+      out[0] = a[0] * b[0];
+      return;
+    }
+    Scalar head = teensymat::dot(dim, a, b);
+    for (size_t i = 1; i < dim; i++) {
+      out[i] = a[0] * b[i] + b[0] * a[i];
+    }
+    out[0] = head;
+  }
+  /*! Solve lambda o out = v on a symmetric cone*/
+  static void jordan_divide(ConeType type, size_t dim, Scalar const *lambda,
+                            Scalar const *v, Scalar *out) {
+    if (type == ConeType::nonnegative) {
+      out[0] = v[0] / lambda[0];
+      return;
+    }
+    Scalar det = lambda[0] * lambda[0] -
+                 teensymat::dot(dim - 1, lambda + 1, lambda + 1);
+    Scalar head =
+        (lambda[0] * v[0] - teensymat::dot(dim - 1, lambda + 1, v + 1)) / det;
+    for (size_t i = 1; i < dim; i++) {
+      out[i] = (v[i] - head * lambda[i]) / lambda[0];
+    }
+    out[0] = head;
+  }
+  /*! Apply the NT scaling W (or its inverse) of a symmetric cone*/
+  void apply_w(size_t c, Scalar const *in, Scalar *out, bool inverse) const {
+    Cone const &cone = this->problem.cones[c];
+    size_t offset = this->cone_offset[c];
+    Scalar const *w = &this->nt_point[offset];
+    if (cone.type == ConeType::nonnegative) {
+      out[0] = inverse ? in[0] / w[0] : in[0] * w[0];
+      return;
+    }
+    // W = eta [a, q^T; q, I + q q^T / (1 + a)], and its inverse flips
+    // the sign of q and of eta's power
+    size_t dim = cone.dim;
+    Scalar a = w[0];
+    Scalar sign = inverse ? Scalar{-1} : Scalar{1};
+    Scalar scale = inverse ? 1 / this->eta[c] : this->eta[c];
+    Scalar product = teensymat::dot(dim - 1, w + 1, in + 1);
+    Scalar head = a * in[0] + sign * product;
+    Scalar factor = sign * in[0] + product / (1 + a);
+    for (size_t i = 1; i < dim; i++) {
+      out[i] = scale * (in[i] + factor * w[i]);
+    }
+    out[0] = scale * head;
+  }
+  /*! out = H v over all cone rows*/
+  void apply_h(Scalar const *v, Scalar *out) {
+    for (size_t c = 0; c < this->problem.cones.size(); c++) {
+      Cone const &cone = this->problem.cones[c];
+      size_t offset = this->cone_offset[c];
+      if (cone.type == ConeType::exponential) {
+        Scalar const *h = &this->exp_hessian[3 * offset];
+        for (size_t i = 0; i < 3; i++) {
+          out[offset + i] = teensymat::dot(3, h + 3 * i, v + offset);
+        }
+        continue;
+      }
+      Scalar *temp = &this->work2[offset];
+      this->apply_w(c, v + offset, temp, false);
+      this->apply_w(c, temp, out + offset, false);
+    }
+  }
+  /*! Gradient and Hessian of the barrier of the dual exponential cone,
+   *
+   *     f(u, v, w) = -log(v - u + u log(-u / w)) - log(-u) - log(w),
+   *
+   * at z (the Hessian is scaled by mu)*/
+  void exp_barrier(size_t offset, Scalar mu) {
+    Scalar const *point = &this->z[offset];
+    Scalar u = point[0];
+    Scalar w = point[2];
+    Scalar psi = point[1] - u + u * std::log(-u / w);
+    Scalar grad_psi[3] = {std::log(-u / w), 1, -u / w};
+    Scalar *gradient = &this->exp_gradient[offset];
+    gradient[0] = -grad_psi[0] / psi - 1 / u;
+    gradient[1] = -grad_psi[1] / psi;
+    gradient[2] = -grad_psi[2] / psi - 1 / w;
+    // grad^2 f = grad psi grad psi^T / psi^2 - grad^2 psi / psi
+    //            + diag(1 / u^2, 0, 1 / w^2)
+    Scalar hess_psi[9] = {1 / u, 0, -1 / w, 0, 0, 0, -1 / w, 0, u / (w * w)};
+    Scalar *h = &this->exp_hessian[3 * offset];
+    for (size_t i = 0; i < 3; i++) {
+      for (size_t j = 0; j < 3; j++) {
+        h[3 * i + j] = mu * (grad_psi[i] * grad_psi[j] / (psi * psi) -
+                             hess_psi[3 * i + j] / psi);
+      }
+    }
+    h[0] += mu / (u * u);
+    h[8] += mu / (w * w);
+  }
+  /*! Compute the scalings of the current iterate (identity scalings if
+   * identity is set, for the starting point)*/
+  void compute_scaling(Scalar mu, bool identity) {
+    for (size_t c = 0; c < this->problem.cones.size(); c++) {
+      Cone const &cone = this->problem.cones[c];
+      size_t offset = this->cone_offset[c];
+      size_t dim = cone.dim;
+      Scalar const *sc = &this->s[offset];
+      Scalar const *zc = &this->z[offset];
+      Scalar *w = &this->nt_point[offset];
+      if (cone.type == ConeType::exponential) {
+        if (identity) {
+          Scalar *h = &this->exp_hessian[3 * offset];
+          std::fill(h, h + 9, Scalar{0});
+          h[0] = h[4] = h[8] = 1;
+        } else {
+          this->exp_barrier(offset, mu);
+        }
+        continue;
+      }
+      if (identity) {
+        std::fill(w, w + dim, Scalar{0});
+        w[0] = 1;
+        this->eta[c] = 1;
+        continue;
+      }
+      if (cone.type == ConeType::nonnegative) {
+        w[0] = std::sqrt(sc[0] / zc[0]);
+        this->lambda[offset] = std::sqrt(sc[0] * zc[0]);
+        continue;
+      }
+      Scalar s_det = sc[0] * sc[0] - teensymat::dot(dim - 1, sc + 1, sc + 1);
+      Scalar z_det = zc[0] * zc[0] - teensymat::dot(dim - 1, zc + 1, zc + 1);
+      Scalar s_norm = std::sqrt(s_det);
+      Scalar z_norm = std::sqrt(z_det);
+      Scalar inner = teensymat::dot(dim, sc, zc) / (s_norm * z_norm);
+      Scalar gamma = std::sqrt((1 + inner) / 2);
+      // w_bar = (s_bar + J z_bar) / (2 gamma)
+      w[0] = (sc[0] / s_norm + zc[0] / z_norm) / (2 * gamma);
+      for (size_t i = 1; i < dim; i++) {
+        w[i] = (sc[i] / s_norm - zc[i] / z_norm) / (2 * gamma);
+      }
+      this->eta[c] = std::sqrt(std::sqrt(s_det / z_det));
+      this->apply_w(c, zc, &this->lambda[offset], false);
+    }
+  }
+
+  // SECTION: Linear algebra
+  /*! Assemble and factor the linear system for the current scalings*/
+  void factor() {
+    size_t zero = this->n + this->p;
+    Scalar delta = this->options.static_regularization;
+    Scalar *values = this->kkt.get_values()->data();
+    for (size_t j = 0; j < this->n; j++) {
+      values[this->diagonal_entry[j]] = delta;
+    }
+    for (size_t i = 0; i < this->p; i++) {
+      values[this->diagonal_entry[this->n + i]] = -delta;
+    }
+    for (size_t c = 0; c < this->problem.cones.size(); c++) {
+      Cone const &cone = this->problem.cones[c];
+      size_t offset = this->cone_offset[c];
+      size_t dim = cone.dim;
+      Scalar const *w = &this->nt_point[offset];
+      Scalar e = this->eta[c];
+      if (cone.type == ConeType::nonnegative) {
+        values[this->diagonal_entry[zero + offset]] = -w[0] * w[0] - delta;
+        continue;
+      }
+      if (this->cone_block[c] != npos) {
+        // -H - delta I, with W^2 = eta^2 [2 a^2 - 1, 2 a q^T;
+        // 2 a q, I + 2 q q^T] for second order cones
+        size_t slot = this->cone_block[c];
+        for (size_t i = 0; i < dim; i++) {
+          for (size_t j = i; j < dim; j++) {
+            Scalar h;
+            if (cone.type == ConeType::exponential) {
+              h = this->exp_hessian[3 * offset + 3 * i + j];
+            } else if (i == 0) {
+              h = e * e * 2 * w[0] * w[j];
+              h -= j == 0 ? e * e : Scalar{0};
+            } else {
+              h = e * e * (2 * w[i] * w[j] + (i == j ? 1 : 0));
+            }
+            values[this->block_entry[slot++]] =
+                -h - (i == j ? delta : Scalar{0});
+          }
+        }
+        continue;
+      }
+      // W^2 = eta^2 (D + u u^T - v v^T) with D = diag(d, 1, ..., 1),
+      // u = (u0, u1 q), v = (0, v1 q). Any u1^2 - v1^2 = 2 matches W^2;
+      // v1 is chosen so that D - v v^T stays positive definite, making
+      // the rows of z and the first extra row a negative definite block.
+      // With t = ||q||^2 = a^2 - 1, d is computed in closed form as
+      // 2 a^2 - 1 - u0^2 cancels badly for large a.
+      Scalar tail = teensymat::dot(dim - 1, w + 1, w + 1);
+      Scalar u0 = 0;
+      Scalar u1 = 0;
+      Scalar v1 = 0;
+      Scalar d = 2 * tail + 1;
+      if (tail > 0) {
+        v1 = std::sqrt((4 * tail + 1) / (2 * tail * (2 * tail + 1)));
+        u1 = std::sqrt(2 + v1 * v1);
+        u0 = 2 * w[0] / u1;
+        d /= 8 * tail * tail + 8 * tail + 1;
+      }
+      for (size_t i = 0; i < dim; i++) {
+        values[this->diagonal_entry[zero + offset + i]] =
+            -e * e * (i == 0 ? d : Scalar{1}) - delta;
+        values[this->extra_entry[2 * (offset + i)]] =
+            i == 0 ? Scalar{0} : e * v1 * w[i];
+        values[this->extra_entry[2 * (offset + i) + 1]] =
+            e * (i == 0 ? u0 : u1 * w[i]);
+      }
+      values[this->diagonal_entry[this->cone_extra[c]]] = -1;
+      values[this->diagonal_entry[this->cone_extra[c] + 1]] = 1;
+    }
+    this->ldlt.factorize(this->kkt);
+    this->factorizations++;
+  }
+  /*! Solve the Newton system for right hand sides (r1, r2, r3) of the x,
+   * y and z rows, refining against the unregularized system.
+   *
+   * @return The largest residual of the solution, relative to the largest
+   * right hand side*/
+  Scalar solve_kkt(Scalar const *r1, Scalar const *r2, Scalar const *r3,
+                 Scalar *out_x, Scalar *out_y, Scalar *out_z) {
+    size_t n = this->n;
+    size_t p = this->p;
+    size_t m = this->m;
+    size_t zero = n + p;
+    auto load = [&](Scalar const *a, Scalar const *b, Scalar const *c) {
+      std::fill(this->rhs.begin(), this->rhs.end(), Scalar{0});
+      std::copy(a, a + n, this->rhs.begin());
+      std::copy(b, b + p, this->rhs.begin() + n);
+      std::copy(c, c + m, this->rhs.begin() + zero);
+      this->ldlt.solve_inplace(this->rhs.data());
+    };
+    load(r1, r2, r3);
+    std::copy(this->rhs.begin(), this->rhs.begin() + n, out_x);
+    std::copy(this->rhs.begin() + n, this->rhs.begin() + zero, out_y);
+    std::copy(this->rhs.begin() + zero, this->rhs.begin() + zero + m, out_z);
+    this->error.resize(zero + m);
+    Scalar *e = this->error.data();
+    Scalar scale = 1;
+    for (auto [r, size] : {std::pair{r1, n}, {r2, p}, {r3, m}}) {
+      for (size_t k = 0; k < size; k++) {
+        scale = std::max(scale, std::abs(r[k]));
+      }
+    }
+    Scalar previous = std::numeric_limits<Scalar>::infinity();
+    Scalar largest = 0;
+    for (size_t step = 0; step <= this->options.refinement_steps; step++) {
+      // e = r - K (x, y, z) with K unregularized
+      std::copy(r1, r1 + n, e);
+      std::copy(r2, r2 + p, e + n);
+      std::copy(r3, r3 + m, e + zero);
+      this->problem.equality_matrix.gaxpy_transpose(-1, out_y, e);
+      this->problem.cone_matrix.gaxpy_transpose(-1, out_z, e);
+      this->problem.equality_matrix.gaxpy(-1, out_x, e + n);
+      this->problem.cone_matrix.gaxpy(-1, out_x, e + zero);
+      this->apply_h(out_z, this->work.data());
+      teensymat::axpy(m, Scalar{1}, this->work.data(), e + zero);
+      largest = 0;
+      for (size_t k = 0; k < zero + m; k++) {
+        largest = std::max(largest, std::abs(e[k]));
+      }
+      if (!(largest < previous)) {
+        // The last correction made things worse, so take it back
+        teensymat::axpy(n, Scalar{-1}, this->rhs.data(), out_x);
+        teensymat::axpy(p, Scalar{-1}, this->rhs.data() + n, out_y);
+        teensymat::axpy(m, Scalar{-1}, this->rhs.data() + zero, out_z);
+        largest = previous;
+        break;
+      }
+      if (largest <= Scalar(1e-14) * scale ||
+          step == this->options.refinement_steps) {
+        break;
+      }
+      previous = largest;
+      load(e, e + n, e + zero);
+      teensymat::axpy(n, Scalar{1}, this->rhs.data(), out_x);
+      teensymat::axpy(p, Scalar{1}, this->rhs.data() + n, out_y);
+      teensymat::axpy(m, Scalar{1}, this->rhs.data() + zero, out_z);
+    }
+    return largest / scale;
+  }
+  /*! Newton direction for the complementarity right hand side rc, with
+   * ds = rc - H dz.
+   *
+   * @return The relative residual of the linear solve*/
+  Scalar direction(Scalar *ddx, Scalar *ddy, Scalar *ddz, Scalar *dds) {
+    size_t m = this->m;
+    std::vector<Scalar> &r1 = this->rhs_x;
+    std::vector<Scalar> &r2 = this->rhs_y;
+    std::vector<Scalar> &r3 = this->rhs_z;
+    for (size_t j = 0; j < this->n; j++) {
+      r1[j] = -this->rx[j];
+    }
+    for (size_t i = 0; i < this->p; i++) {
+      r2[i] = -this->ry[i];
+    }
+    for (size_t i = 0; i < m; i++) {
+      r3[i] = -this->rz[i] - this->rc[i];
+    }
+    Scalar residual =
+        this->solve_kkt(r1.data(), r2.data(), r3.data(), ddx, ddy, ddz);
+    this->apply_h(ddz, dds);
+    for (size_t i = 0; i < m; i++) {
+      dds[i] = this->rc[i] - dds[i];
+    }
+    return residual;
+  }
+
+  // SECTION: Iterations
+  /*! Largest step (at most limit) keeping s + alpha ds and z + alpha dz in
+   * the interior of the cones. For exponential cones the step is
+   * shortened until the points are interior, and if central is set until
+   * they are in the neighborhood of the central path.*/
+  Scalar max_step(Scalar const *d_s, Scalar const *d_z, Scalar limit,
+                  bool central) {
+    Scalar step = limit;
+    auto symmetric = [&](ConeType type, size_t dim, Scalar const *v,
+                         Scalar const *d) {
+      if (type == ConeType::nonnegative) {
+        if (d[0] < 0) {
+          step = std::min(step, -v[0] / d[0]);
+        }
+        return;
+      }
+      // Smallest positive root of (v0 + t d0)^2 - ||v1 + t d1||^2, and
+      // v0 + t d0 must stay positive (which catches the double root of
+      // directions along the boundary of -K lost to rounding)
+      if (d[0] < 0) {
+        step = std::min(step, -v[0] / d[0]);
+      }
+      Scalar a = d[0] * d[0] - teensymat::dot(dim - 1, d + 1, d + 1);
+      Scalar b = v[0] * d[0] - teensymat::dot(dim - 1, v + 1, d + 1);
+      Scalar c = v[0] * v[0] - teensymat::dot(dim - 1, v + 1, v + 1);
+      Scalar disc = b * b - a * c;
+      if ((b < 0 || a < 0) && disc >= 0) {
+        step = std::min(step, c / (-b + std::sqrt(disc)));
+      }
+    };
+    for (size_t c = 0; c < this->problem.cones.size(); c++) {
+      Cone const &cone = this->problem.cones[c];
+      if (cone.type != ConeType::exponential) {
+        size_t offset = this->cone_offset[c];
+        symmetric(cone.type, cone.dim, &this->s[offset], d_s + offset);
+        symmetric(cone.type, cone.dim, &this->z[offset], d_z + offset);
+      }
+    }
+    Scalar trial_s[3];
+    Scalar trial_z[3];
+    auto acceptable = [&](Scalar alpha) {
+      Scalar mu = 0;
+      if (central) {
+        for (size_t i = 0; i < this->m; i++) {
+          mu += (this->s[i] + alpha * d_s[i]) * (this->z[i] + alpha * d_z[i]);
+        }
+        mu /= static_cast<Scalar>(this->degree);
+      }
+      for (size_t c = 0; c < this->problem.cones.size(); c++) {
+        if (this->problem.cones[c].type != ConeType::exponential) {
+          continue;
+        }
+        size_t offset = this->cone_offset[c];
+        for (size_t i = 0; i < 3; i++) {
+          trial_s[i] = this->s[offset + i] + alpha * d_s[offset + i];
+          trial_z[i] = this->z[offset + i] + alpha * d_z[offset + i];
+        }
+        if (!this->interior(ConeType::exponential, 3, trial_s, true) ||
+            !this->interior(ConeType::exponential, 3, trial_z, false)) {
+          return false;
+        }
+        if (central && teensymat::dot(3, trial_s, trial_z) / 3 <
+                           this->options.exponential_neighborhood * mu) {
+          return false;
+        }
+      }
+      return true;
+    };
+    for (size_t tries = 0; tries < 100 && !acceptable(step); tries++) {
+      step *= Scalar(0.8);
+    }
+    return step;
+  }
+  /*! Shift a point into the interior of the symmetric cones (by a multiple
+   * of their identity) and put the exponential cones at their center*/
+  void shift_into_cones(Scalar *v) const {
+    Scalar depth = std::numeric_limits<Scalar>::infinity();
+    for (size_t c = 0; c < this->problem.cones.size(); c++) {
+      Cone const &cone = this->problem.cones[c];
+      Scalar const *vc = v + this->cone_offset[c];
+      if (cone.type == ConeType::nonnegative) {
+        depth = std::min(depth, vc[0]);
+      } else if (cone.type == ConeType::second_order) {
+        depth =
+            std::min(depth, vc[0] - teensymat::nrm2(cone.dim - 1, vc + 1));
+      }
+    }
+    Scalar shift = depth < 0 ? 1 - depth : Scalar{0};
+    if (depth >= 0 && depth < 1) {
+      shift = 1;
+    }
+    for (size_t c = 0; c < this->problem.cones.size(); c++) {
+      Cone const &cone = this->problem.cones[c];
+      Scalar *vc = v + this->cone_offset[c];
+      if (cone.type == ConeType::exponential) {
+        for (size_t i = 0; i < 3; i++) {
+          vc[i] = Scalar(exp_center[i]);
+        }
+      } else {
+        vc[0] += shift;
+      }
+    }
+  }
+  /*! Starting point from two least squares problems with H = I: the
+   * primal point minimizes ||G x - h|| subject to A x = b, the dual one
+   * minimizes ||z|| subject to the dual constraints. Both are then
+   * shifted into the cones.*/
+  void initial_point() {
+    size_t n = this->n;
+    size_t p = this->p;
+    size_t m = this->m;
+    this->compute_scaling(0, true);
+    this->factor();
+    std::vector<Scalar> zeros(std::max({n, p, m}), 0);
+    std::vector<Scalar> minus_c(n);
+    for (size_t j = 0; j < n; j++) {
+      minus_c[j] = -this->problem.objective[j];
+    }
+    this->solve_kkt(zeros.data(), this->problem.equality_rhs.data(),
+                    this->problem.cone_rhs.data(), this->x.data(),
+                    this->dy.data(), this->dz.data());
+    for (size_t i = 0; i < m; i++) {
+      this->s[i] = -this->dz[i];
+    }
+    this->solve_kkt(minus_c.data(), zeros.data(), zeros.data(),
+                    this->dx.data(), this->y.data(), this->z.data());
+    this->shift_into_cones(this->s.data());
+    this->shift_into_cones(this->z.data());
+  }
+  /*! Compute the residuals of the current iterate*/
+  void compute_residuals() {
+    this->rx = this->problem.objective;
+    this->problem.equality_matrix.gaxpy_transpose(1, this->y.data(),
+                                                  this->rx.data());
+    this->problem.cone_matrix.gaxpy_transpose(1, this->z.data(),
+                                              this->rx.data());
+    for (size_t i = 0; i < this->p; i++) {
+      this->ry[i] = -this->problem.equality_rhs[i];
+    }
+    this->problem.equality_matrix.gaxpy(1, this->x.data(), this->ry.data());
+    for (size_t i = 0; i < this->m; i++) {
+      this->rz[i] = this->s[i] - this->problem.cone_rhs[i];
+    }
+    this->problem.cone_matrix.gaxpy(1, this->x.data(), this->rz.data());
+  }
+  /*! Largest absolute entry*/
+  static Scalar max_abs(std::vector<Scalar> const &v) {
+    Scalar largest = 0;
+    for (Scalar value : v) {
+      largest = std::max(largest, std::abs(value));
+    }
+    return largest;
+  }
+  /*! Complementarity right hand side of the corrector: for symmetric
+   * cones W (lambda \ (sigma mu e - lambda o lambda - (W^-1 ds) o (W dz)))
+   * with the affine direction, for exponential cones
+   * -s - sigma mu grad f(z)*/
+  void corrector_rhs(Scalar sigma, Scalar mu) {
+    for (size_t c = 0; c < this->problem.cones.size(); c++) {
+      Cone const &cone = this->problem.cones[c];
+      size_t offset = this->cone_offset[c];
+      size_t dim = cone.dim;
+      if (cone.type == ConeType::exponential) {
+        for (size_t i = 0; i < 3; i++) {
+          this->rc[offset + i] = -this->s[offset + i] -
+                                 sigma * mu * this->exp_gradient[offset + i];
+        }
+        continue;
+      }
+      Scalar *scaled_s = &this->work[offset];
+      Scalar *scaled_z = &this->work2[offset];
+      this->apply_w(c, &this->ds[offset], scaled_s, true);
+      this->apply_w(c, &this->dz[offset], scaled_z, false);
+      Scalar *target = &this->rhs_z[offset];
+      jordan_product(cone.type, dim, scaled_s, scaled_z, target);
+      Scalar const *l = &this->lambda[offset];
+      jordan_product(cone.type, dim, l, l, scaled_s);
+      for (size_t i = 0; i < dim; i++) {
+        target[i] = -target[i] - scaled_s[i];
+      }
+      target[0] += sigma * mu;
+      jordan_divide(cone.type, dim, l, target, scaled_z);
+      this->apply_w(c, scaled_z, &this->rc[offset], false);
+    }
+  }
+  /*! Largest entry of A^T y + G^T z (dual == true) or of A x and G x + s
+   * at the current iterate and residuals*/
+  Scalar certificate_residual(bool dual) const {
+    Scalar largest = 0;
+    if (dual) {
+      for (size_t j = 0; j < this->n; j++) {
+        largest = std::max(largest,
+                           std::abs(this->rx[j] - this->problem.objective[j]));
+      }
+      return largest;
+    }
+    for (size_t i = 0; i < this->p; i++) {
+      largest = std::max(largest, std::abs(this->ry[i] +
+                                           this->problem.equality_rhs[i]));
+    }
+    for (size_t i = 0; i < this->m; i++) {
+      largest = std::max(largest,
+                         std::abs(this->rz[i] + this->problem.cone_rhs[i]));
+    }
+    return largest;
+  }
+  /*! Whether any second order cone uses the sparse expansion*/
+  bool expanded() const {
+    return std::any_of(this->cone_extra.begin(), this->cone_extra.end(),
+                       [](size_t extra) { return extra != npos; });
+  }
+  /*! Compute the predictor and the corrector direction (into dx, dy, dz,
+   * ds) with the current factorization.
+   *
+   * @return The largest relative residual of the linear solves*/
+  Scalar predictor_corrector(Scalar mu) {
+    // Predictor: r_c = -s
+    for (size_t i = 0; i < this->m; i++) {
+      this->rc[i] = -this->s[i];
+    }
+    Scalar residual = this->direction(this->dx.data(), this->dy.data(),
+                                      this->dz.data(), this->ds.data());
+    Scalar affine =
+        this->max_step(this->ds.data(), this->dz.data(), 1, false);
+    Scalar affine_mu = 0;
+    for (size_t i = 0; i < this->m; i++) {
+      affine_mu += (this->s[i] + affine * this->ds[i]) *
+                   (this->z[i] + affine * this->dz[i]);
+    }
+    affine_mu /= static_cast<Scalar>(this->degree);
+    Scalar ratio = mu > 0 ? affine_mu / mu : Scalar{0};
+    Scalar sigma = std::clamp(ratio * ratio * ratio, Scalar{0}, Scalar{1});
+    // Corrector
+    this->corrector_rhs(sigma, mu);
+    return std::max(residual,
+                    this->direction(this->dx.data(), this->dy.data(),
+                                    this->dz.data(), this->ds.data()));
+  }
+  /*! Run the predictor-corrector iterations*/
+  LPStatus run() {
+    this->initial_point();
+    Scalar c_norm = max_abs(this->problem.objective);
+    Scalar b_norm = max_abs(this->problem.equality_rhs);
+    Scalar h_norm = max_abs(this->problem.cone_rhs);
+    Scalar tolerance = this->options.tolerance;
+    while (true) {
+      this->compute_residuals();
+      Scalar primal_objective =
+          teensymat::dot(this->n, this->problem.objective.data(),
+                         this->x.data());
+      Scalar dual_objective =
+          -teensymat::dot(this->p, this->problem.equality_rhs.data(),
+                          this->y.data()) -
+          teensymat::dot(this->m, this->problem.cone_rhs.data(),
+                         this->z.data());
+      Scalar gap = teensymat::dot(this->m, this->s.data(), this->z.data());
+      Scalar relative_gap =
+          std::min(gap, std::abs(primal_objective - dual_objective)) /
+          (1 + std::min(std::abs(primal_objective),
+                        std::abs(dual_objective)));
+      if (max_abs(this->ry) <= tolerance * (1 + b_norm) &&
+          max_abs(this->rz) <= tolerance * (1 + h_norm) &&
+          max_abs(this->rx) <= tolerance * (1 + c_norm) &&
+          relative_gap <= tolerance) {
+        return LPStatus::optimal;
+      }
+      // Certificates: A^T y + G^T z ~ 0 with b^T y + h^T z < 0 shows the
+      // problem is infeasible, A x ~ 0 and G x + s ~ 0 with c^T x < 0
+      // that it is unbounded
+      if (dual_objective > 0 &&
+          this->certificate_residual(true) <= tolerance * dual_objective) {
+        return LPStatus::infeasible;
+      }
+      if (primal_objective < 0 &&
+          this->certificate_residual(false) <= -tolerance * primal_objective) {
+        return LPStatus::unbounded;
+      }
+      Scalar dual_norm = std::max(max_abs(this->y), max_abs(this->z));
+      if (!std::isfinite(dual_norm) || !std::isfinite(max_abs(this->x))) {
+        return LPStatus::numerical_error;
+      }
+      if (dual_norm > Scalar(divergence_limit) * (1 + c_norm)) {
+        return LPStatus::infeasible;
+      }
+      if (max_abs(this->x) > Scalar(divergence_limit) * (1 + b_norm + h_norm)) {
+        return LPStatus::unbounded;
+      }
+      if (this->iterations >= this->options.max_iterations) {
+        return LPStatus::iteration_limit;
+      }
+      Scalar mu = gap / static_cast<Scalar>(this->degree);
+      this->compute_scaling(mu, false);
+      this->factor();
+      Scalar residual = this->predictor_corrector(mu);
+      if (residual > Scalar(solve_accuracy) && this->expanded()) {
+        // Close to the boundary of the cones the expansion lost too much
+        // accuracy, so fall back to dense blocks for all cones
+        this->dense_dim = std::numeric_limits<size_t>::max();
+        this->setup_kkt();
+        this->factor();
+        this->predictor_corrector(mu);
+      }
+      Scalar limit = this->max_step(this->ds.data(), this->dz.data(),
+                                    std::numeric_limits<Scalar>::infinity(),
+                                    false);
+      Scalar step = this->max_step(
+          this->ds.data(), this->dz.data(),
+          std::min(Scalar{1}, this->options.step_factor * limit), true);
+      if (!(step > std::numeric_limits<Scalar>::epsilon())) {
+        return LPStatus::numerical_error;
+      }
+      teensymat::axpy(this->n, step, this->dx.data(), this->x.data());
+      teensymat::axpy(this->p, step, this->dy.data(), this->y.data());
+      teensymat::axpy(this->m, step, this->dz.data(), this->z.data());
+      teensymat::axpy(this->m, step, this->ds.data(), this->s.data());
+      this->iterations++;
+    }
+  }
+
+public:
+  // SECTION: Constructors
+  /*! Set up the solver for a problem (which is copied), and analyze the
+   * sparsity pattern of its linear system.
+   *
+   * Throws std::range_error if the dimensions of the problem do not match.
+   *
+   * @param problem The problem to solve
+   * @param options Options of the solve
+   * */
+  explicit ConicSolver(ConicProblem<Scalar> problem,
+                       ConicOptions<Scalar> const &options = {})
+      : problem(std::move(problem)), options(options), n(0), p(0), m(0),
+        degree(0), dense_dim(options.dense_cone_dim), analyses(0),
+        factorizations(0), iterations(0) {
+    this->problem.validate();
+    // Work with one cone per row of the nonnegative orthants
+    std::vector<Cone> cones;
+    for (Cone const &cone : this->problem.cones) {
+      if (cone.type == ConeType::nonnegative) {
+        cones.insert(cones.end(), cone.dim, Cone{ConeType::nonnegative, 1});
+      } else {
+        cones.push_back(cone);
+      }
+    }
+    this->problem.cones = std::move(cones);
+    this->n = this->problem.get_num_variables();
+    this->p = this->problem.equality_rhs.size();
+    this->m = this->problem.cone_rhs.size();
+    for (Cone const &cone : this->problem.cones) {
+      this->degree += cone.type == ConeType::nonnegative ? cone.dim
+                      : cone.type == ConeType::second_order ? 1
+                                                            : 3;
+    }
+    this->degree = std::max<size_t>(this->degree, 1);
+    this->setup_kkt();
+    for (auto *vector : {&this->x, &this->dx, &this->rhs_x, &this->rx}) {
+      vector->assign(this->n, 0);
+    }
+    for (auto *vector : {&this->y, &this->dy, &this->rhs_y, &this->ry}) {
+      vector->assign(this->p, 0);
+    }
+    for (auto *vector :
+         {&this->z, &this->s, &this->dz, &this->ds, &this->rhs_z,
+          &this->rz, &this->rc, &this->work, &this->work2, &this->lambda,
+          &this->nt_point, &this->exp_gradient}) {
+      vector->assign(this->m, 0);
+    }
+    this->exp_hessian.assign(3 * this->m, 0);
+    this->eta.assign(this->problem.cones.size(), 1);
+  }
+
+  // SECTION: Getters
+  /*! Get the number of symbolic analyses of the linear system*/
+  size_t get_num_analyses() const { return this->analyses; }
+  /*! Get the number of numeric factorizations performed (one per
+   * iteration, plus one for the starting point and one after falling back
+   * to dense cone blocks)*/
+  size_t get_num_factorizations() const { return this->factorizations; }
+
+  // SECTION: Solving
+  /*! Solve the problem.
+   *
+   * @return The solution
+   * */
+  ConicSolution<Scalar> solve() {
+    this->iterations = 0;
+    ConicSolution<Scalar> result;
+    result.status = this->run();
+    result.iterations = this->iterations;
+    result.x = this->x;
+    result.s = this->s;
+    result.y = this->y;
+    result.z = this->z;
+    result.objective = teensymat::dot(this->n, this->problem.objective.data(),
+                                      this->x.data());
+    return result;
+  }
+};
+
+/*! Solve a conic program with ConicSolver.
+ *
+ * @param problem The problem to solve
+ * @param options Options of the solve
+ * @return The solution
+ * */
+template <typename Scalar>
+ConicSolution<Scalar> solve_conic(ConicProblem<Scalar> const &problem,
+                                  ConicOptions<Scalar> const &options = {}) {
+  ConicSolver<Scalar> solver{problem, options};
+  return solver.solve();
+}
+} // namespace teensylp
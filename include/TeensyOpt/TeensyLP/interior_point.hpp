@@ -0,0 +1,1227 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyLP/lp_problem.hpp"
+#include "TeensyOpt/TeensyLP/qp_problem.hpp"
+#include "TeensyOpt/TeensyLP/simplex.hpp"
+#include "TeensyOpt/TeensyMat/scaling.hpp"
+#include "TeensyOpt/TeensyMat/sparse_core.hpp"
+#include "TeensyOpt/TeensyMat/sparse_ldlt.hpp"
+
+namespace teensylp {
+/*! Linear system solved for the Newton directions of InteriorPoint*/
+enum class KKTForm {
+  /*! Normal equations when Q is diagonal and there are no free or dense
+   * columns, the augmented system otherwise*/
+  automatic,
+  /*! The normal equations A H^-1 A^T (m by m, positive definite)*/
+  normal_equations,
+  /*! The augmented system [H A^T; A 0] (quasi definite)*/
+  augmented,
+};
+
+/*! Options of InteriorPoint*/
+template <typename Scalar> struct InteriorPointOptions {
+  /*! Maximum number of iterations*/
+  size_t max_iterations = 200;
+  /*! Relative primal and dual residuals and duality gap of a solution (in
+   * the scaled problem)*/
+  Scalar tolerance = 1e-8;
+  /*! The linear system solved at each iteration*/
+  KKTForm kkt_form = KKTForm::automatic;
+  /*! Maximum number of Gondzio centrality correctors per iteration*/
+  size_t max_correctors = 2;
+  /*! Fraction of the step to the boundary taken*/
+  Scalar step_factor = 0.9995;
+  /*! Regularization added to the primal block of the linear system*/
+  Scalar primal_regularization = 1e-10;
+  /*! Regularization subtracted from the dual block of the linear system*/
+  Scalar dual_regularization = 1e-10;
+  /*! Iterative refinement steps against the unregularized system*/
+  size_t refinement_steps = 2;
+  /*! Equilibrate the constraint matrix (geometric then Ruiz scaling)*/
+  bool scale = true;
+  /*! Recover an optimal basis with the simplex method (LPs only)*/
+  bool crossover = false;
+  /*! Options of the simplex run by crossover*/
+  SimplexOptions<Scalar> simplex_options{};
+  /*! Smallest distance to a finite bound and smallest bound dual of a
+   * warm starting point (in the scaled problem)*/
+  Scalar warm_start_shift = 1e-2;
+};
+
+/*! Primal-dual interior point method for QPProblem (and LPs).
+ *
+ * Like RevisedSimplex, rows get logical variables r = A x, so the problem
+ * solved is
+ *
+ *     minimize 1/2 x^T Q x + c^T x  s.t.  [A, -I] x = 0,  l <= x <= u
+ *
+ * over all n + m variables. Fixed variables (including the logicals of
+ * equality rows) are kept at their value, and every finite bound of the
+ * others gets a barrier with its own dual (z_lower, z_upper).
+ *
+ * Each iteration factors one linear system, the normal equations or the
+ * augmented system (KKTForm), with SparseLDLT; its ordering and symbolic
+ * analysis are computed once at construction. The same factorization gives
+ * Mehrotra's predictor and corrector directions, then up to
+ * max_correctors Gondzio correctors which pull outlying complementarity
+ * products back towards the central path. Small regularizations keep the
+ * systems quasi definite, and their effect is removed by iterative
+ * refinement.
+ *
+ * Infeasible and unbounded problems are detected when the dual or primal
+ * iterates diverge. With crossover, the interior solution of an LP is
+ * turned into a starting basis and RevisedSimplex finishes the solve.
+ *
+ * For repeated solves, update replaces the problem data and the next solve
+ * starts from the previous solution moved slightly into the interior (or
+ * any solution given to set_starting_point). The symbolic analysis is
+ * kept unless the sparsity pattern or the set of fixed variables changed.
+ * */
+template <typename Scalar> class InteriorPoint {
+public:
+  /*! Marker for "no index"*/
+  static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+private:
+  /*! A Newton direction*/
+  struct Direction {
+    /*! Change of every variable (zero for fixed ones)*/
+    std::vector<Scalar> dx;
+    /*! Change of the row duals*/
+    std::vector<Scalar> dy;
+    /*! Change of the lower and upper bound duals*/
+    std::vector<Scalar> dzl, dzu;
+    /*! Largest primal and dual steps keeping the iterate nonnegative*/
+    Scalar primal_step = 0, dual_step = 0;
+
+    void resize(size_t total, size_t m) {
+      this->dx.assign(total, 0);
+      this->dy.assign(m, 0);
+      this->dzl.assign(total, 0);
+      this->dzu.assign(total, 0);
+    }
+  };
+
+  /*! Iterates growing beyond this are taken as a sign of infeasibility*/
+  static constexpr double divergence_limit = 1e10;
+
+  /*! The problem as given*/
+  QPProblem<Scalar> problem;
+  /*! Options of the solve*/
+  InteriorPointOptions<Scalar> options;
+  /*! The number of rows*/
+  size_t nrows;
+  /*! The number of structural variables*/
+  size_t ncols;
+  /*! The number of variables (structural and logical)*/
+  size_t total;
+  /*! The scaled constraint matrix*/
+  teensymat::SparseMatrix<Scalar> constraints;
+  /*! The scaled upper triangle of Q*/
+  teensymat::SparseMatrix<Scalar> hessian;
+  /*! The scaling applied to the problem*/
+  teensymat::Scaling<Scalar> scaling;
+  /*! Scaled costs, lower and upper bounds of all variables*/
+  std::vector<Scalar> cost, lower, upper;
+  /*! Whether each variable has a finite lower or upper bound (false for
+   * fixed variables)*/
+  std::vector<char> has_lower, has_upper;
+  /*! Variables which are not fixed*/
+  std::vector<size_t> active;
+  /*! Index of each variable in active (npos if fixed)*/
+  std::vector<size_t> active_index;
+  /*! Number of complementarity pairs*/
+  size_t num_complementarity;
+  /*! Diagonal of Q for each variable*/
+  std::vector<Scalar> hessian_diagonal;
+  /*! The form of the linear system in use*/
+  KKTForm form;
+  /*! The matrix factored at each iteration (upper triangle)*/
+  teensymat::SparseMatrix<Scalar> kkt;
+  /*! Position of the diagonal of each row of kkt in its values*/
+  std::vector<size_t> kkt_diagonal;
+  /*! For the normal equations, the entries of kkt receiving the products
+   * of each pair of entries of each active column*/
+  std::vector<size_t> pair_ptr, pair_entry;
+  /*! Factorization of kkt*/
+  teensymat::SparseLDLT<Scalar> ldlt;
+  /*! Number of symbolic analyses and numeric factorizations performed*/
+  size_t analyses, factorizations;
+  /*! The iterate*/
+  std::vector<Scalar> x, y, zl, zu;
+  /*! Residuals: the dual one for every variable, the primal one per row*/
+  std::vector<Scalar> dual_residual, primal_residual;
+  /*! Diagonal H = Q_jj + z_lower / (x - l) + z_upper / (u - x) + rho*/
+  std::vector<Scalar> h;
+  /*! Complementarity right hand sides*/
+  std::vector<Scalar> rcl, rcu;
+  /*! Right hand sides and solutions of the linear system*/
+  std::vector<Scalar> rhs_primal, rhs_dual, residual_primal, residual_dual,
+      buffer;
+  /*! Directions of the predictor, corrector and centrality correctors*/
+  Direction predictor, corrector, correction;
+  /*! Number of iterations performed in the current solve*/
+  size_t iterations;
+  /*! Whether a solve has run, so its iterate can warm start the next one*/
+  bool solved;
+  /*! Warm starting point of the next solve (empty for the default one)*/
+  LPSolution<Scalar> start;
+
+  // SECTION: Setup
+  /*! Scale the problem data and classify the variables*/
+  void load() {
+    size_t m = this->nrows;
+    size_t n = this->ncols;
+    if (this->options.scale && this->constraints.get_nnz() > 0) {
+      teensymat::Scaling<Scalar> geometric =
+          teensymat::geometric_scaling(this->constraints);
+      teensymat::apply_scaling(this->constraints, geometric);
+      this->scaling = teensymat::ruiz_scaling(this->constraints);
+      teensymat::apply_scaling(this->constraints, this->scaling);
+      for (size_t i = 0; i < m; i++) {
+        this->scaling.row_scale[i] *= geometric.row_scale[i];
+      }
+      for (size_t j = 0; j < n; j++) {
+        this->scaling.col_scale[j] *= geometric.col_scale[j];
+      }
+    } else {
+      this->scaling.row_scale.assign(m, 1);
+      this->scaling.col_scale.assign(n, 1);
+    }
+    this->hessian_diagonal.assign(this->total, 0);
+    if (!this->problem.is_linear()) {
+      // Q_scaled = C Q C
+      auto const &col_ptr = this->hessian.get_col_ptr();
+      auto const &row_idx = this->hessian.get_row_idx();
+      Scalar *values = this->hessian.get_values()->data();
+      for (size_t j = 0; j < n; j++) {
+        for (size_t k = col_ptr[j]; k < col_ptr[j + 1]; k++) {
+          values[k] *= this->scaling.col_scale[row_idx[k]] *
+                       this->scaling.col_scale[j];
+          if (row_idx[k] == j) {
+            this->hessian_diagonal[j] = values[k];
+          }
+        }
+      }
+    }
+    this->cost.assign(this->total, 0);
+    this->lower.resize(this->total);
+    this->upper.resize(this->total);
+    for (size_t j = 0; j < n; j++) {
+      Scalar scale = this->scaling.col_scale[j];
+      this->cost[j] = this->problem.objective[j] * scale;
+      this->lower[j] = this->problem.col_lower[j] / scale;
+      this->upper[j] = this->problem.col_upper[j] / scale;
+    }
+    for (size_t i = 0; i < m; i++) {
+      Scalar scale = this->scaling.row_scale[i];
+      this->lower[n + i] = this->problem.row_lower[i] * scale;
+      this->upper[n + i] = this->problem.row_upper[i] * scale;
+    }
+    this->has_lower.assign(this->total, 0);
+    this->has_upper.assign(this->total, 0);
+    this->active.clear();
+    this->active_index.assign(this->total, npos);
+    this->num_complementarity = 0;
+    for (size_t var = 0; var < this->total; var++) {
+      if (this->lower[var] == this->upper[var]) {
+        continue;
+      }
+      this->active_index[var] = this->active.size();
+      this->active.push_back(var);
+      this->has_lower[var] = std::isfinite(this->lower[var]);
+      this->has_upper[var] = std::isfinite(this->upper[var]);
+      this->num_complementarity += this->has_lower[var] + this->has_upper[var];
+    }
+  }
+  /*! Whether Q is diagonal*/
+  bool hessian_is_diagonal() const {
+    auto const &col_ptr = this->hessian.get_col_ptr();
+    auto const &row_idx = this->hessian.get_row_idx();
+    for (size_t j = 0; j < this->hessian.get_ncols(); j++) {
+      for (size_t k = col_ptr[j]; k < col_ptr[j + 1]; k++) {
+        if (row_idx[k] != j) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+  /*! Whether the normal equations are preferable (Q diagonal, no free or
+   * dense structural columns)*/
+  bool normal_equations_apply() const {
+    if (!this->hessian_is_diagonal()) {
+      return false;
+    }
+    size_t dense = std::max<size_t>(100, this->nrows / 10);
+    auto const &a_ptr = this->constraints.get_col_ptr();
+    for (size_t j = 0; j < this->ncols; j++) {
+      if (this->active_index[j] == npos) {
+        continue;
+      }
+      bool is_free = !this->has_lower[j] && !this->has_upper[j] &&
+                     this->hessian_diagonal[j] == Scalar{0};
+      if (is_free || a_ptr[j + 1] - a_ptr[j] > dense) {
+        return false;
+      }
+    }
+    return true;
+  }
+  /*! Position of entry (row, col) in the values of kkt*/
+  size_t kkt_entry(size_t row, size_t col) const {
+    auto const &col_ptr = this->kkt.get_col_ptr();
+    auto const &row_idx = this->kkt.get_row_idx();
+    auto begin = row_idx.begin() + col_ptr[col];
+    auto end = row_idx.begin() + col_ptr[col + 1];
+    return static_cast<size_t>(std::lower_bound(begin, end, row) -
+                               row_idx.begin());
+  }
+  /*! The form of the linear system for the options and the problem*/
+  KKTForm choose_form() const {
+    if (this->options.kkt_form != KKTForm::automatic) {
+      return this->options.kkt_form;
+    }
+    return this->normal_equations_apply() ? KKTForm::normal_equations
+                                          : KKTForm::augmented;
+  }
+  /*! Build the pattern of the linear system and (unless it is known to be
+   * unchanged) analyze it*/
+  void setup_kkt(bool analyze) {
+    size_t m = this->nrows;
+    size_t n = this->ncols;
+    size_t na = this->active.size();
+    auto const &a_ptr = this->constraints.get_col_ptr();
+    auto const &a_idx = this->constraints.get_row_idx();
+    Scalar const *a_values = this->constraints.get_values()->data();
+    std::vector<size_t> rows, cols;
+    std::vector<Scalar> vals;
+    if (this->form == KKTForm::normal_equations) {
+      for (size_t i = 0; i < m; i++) {
+        rows.push_back(i);
+        cols.push_back(i);
+        vals.push_back(0);
+      }
+      for (size_t var : this->active) {
+        if (var >= n) {
+          continue;
+        }
+        for (size_t p = a_ptr[var]; p < a_ptr[var + 1]; p++) {
+          for (size_t q = p; q < a_ptr[var + 1]; q++) {
+            rows.push_back(a_idx[p]);
+            cols.push_back(a_idx[q]);
+            vals.push_back(0);
+          }
+        }
+      }
+      this->kkt = teensymat::SparseMatrix<Scalar>::from_triplets(m, m, rows,
+                                                                 cols, vals);
+      this->kkt_diagonal.resize(m);
+      for (size_t i = 0; i < m; i++) {
+        this->kkt_diagonal[i] = this->kkt_entry(i, i);
+      }
+      // The pairs, in the order the numeric assembly visits them
+      this->pair_ptr.assign(na + 1, 0);
+      this->pair_entry.clear();
+      for (size_t k = 0; k < na; k++) {
+        size_t var = this->active[k];
+        if (var >= n) {
+          this->pair_entry.push_back(this->kkt_diagonal[var - n]);
+        } else {
+          for (size_t p = a_ptr[var]; p < a_ptr[var + 1]; p++) {
+            for (size_t q = p; q < a_ptr[var + 1]; q++) {
+              this->pair_entry.push_back(this->kkt_entry(a_idx[p], a_idx[q]));
+            }
+          }
+        }
+        this->pair_ptr[k + 1] = this->pair_entry.size();
+      }
+    } else {
+      for (size_t k = 0; k < na + m; k++) {
+        rows.push_back(k);
+        cols.push_back(k);
+        vals.push_back(0);
+      }
+      auto const &q_ptr = this->hessian.get_col_ptr();
+      auto const &q_idx = this->hessian.get_row_idx();
+      Scalar const *q_values = this->hessian.get_values()->data();
+      for (size_t j = 0; j < this->hessian.get_ncols(); j++) {
+        for (size_t p = q_ptr[j]; p < q_ptr[j + 1]; p++) {
+          size_t i = q_idx[p];
+          if (i != j && this->active_index[i] != npos &&
+              this->active_index[j] != npos) {
+            rows.push_back(this->active_index[i]);
+            cols.push_back(this->active_index[j]);
+            vals.push_back(q_values[p]);
+          }
+        }
+      }
+      for (size_t k = 0; k < na; k++) {
+        size_t var = this->active[k];
+        if (var >= n) {
+          rows.push_back(k);
+          cols.push_back(na + var - n);
+          vals.push_back(-1);
+        } else {
+          for (size_t p = a_ptr[var]; p < a_ptr[var + 1]; p++) {
+            rows.push_back(k);
+            cols.push_back(na + a_idx[p]);
+            vals.push_back(a_values[p]);
+          }
+        }
+      }
+      this->kkt = teensymat::SparseMatrix<Scalar>::from_triplets(
+          na + m, na + m, rows, cols, vals);
+      this->kkt_diagonal.resize(na + m);
+      for (size_t k = 0; k < na + m; k++) {
+        this->kkt_diagonal[k] = this->kkt_entry(k, k);
+      }
+    }
+    if (analyze) {
+      this->ldlt.analyze(this->kkt);
+      this->analyses++;
+    }
+    size_t size = this->kkt.get_nrows();
+    std::vector<signed char> signs(size, 1);
+    if (this->form == KKTForm::augmented) {
+      std::fill(signs.begin() + na, signs.end(), -1);
+    }
+    this->ldlt.set_dynamic_regularization(std::move(signs), Scalar(1e-13),
+                                          Scalar(1e-7));
+  }
+
+  // SECTION: Linear algebra
+  /*! result += alpha * [A, -I] v (length m)*/
+  void add_constraint_product(Scalar alpha, Scalar const *v,
+                              Scalar *result) const {
+    this->constraints.gaxpy(alpha, v, result);
+    for (size_t i = 0; i < this->nrows; i++) {
+      result[i] -= alpha * v[this->ncols + i];
+    }
+  }
+  /*! result += alpha * [A, -I]^T w (length n + m)*/
+  void add_constraint_transpose_product(Scalar alpha, Scalar const *w,
+                                        Scalar *result) const {
+    this->constraints.gaxpy_transpose(alpha, w, result);
+    for (size_t i = 0; i < this->nrows; i++) {
+      result[this->ncols + i] -= alpha * w[i];
+    }
+  }
+  /*! result += Q v (the structural part of length n)*/
+  void add_hessian_product(Scalar const *v, Scalar *result) const {
+    auto const &col_ptr = this->hessian.get_col_ptr();
+    auto const &row_idx = this->hessian.get_row_idx();
+    Scalar const *values = this->hessian.get_values()->data();
+    for (size_t j = 0; j < this->hessian.get_ncols(); j++) {
+      for (size_t k = col_ptr[j]; k < col_ptr[j + 1]; k++) {
+        size_t i = row_idx[k];
+        result[i] += values[k] * v[j];
+        if (i != j) {
+          result[j] += values[k] * v[i];
+        }
+      }
+    }
+  }
+  /*! Compute H for the current iterate*/
+  void compute_h() {
+    Scalar rho = this->options.primal_regularization;
+    for (size_t var : this->active) {
+      Scalar value = this->hessian_diagonal[var];
+      if (this->has_lower[var]) {
+        value += this->zl[var] / (this->x[var] - this->lower[var]);
+      }
+      if (this->has_upper[var]) {
+        value += this->zu[var] / (this->upper[var] - this->x[var]);
+      }
+      this->h[var] = value + rho;
+    }
+  }
+  /*! Assemble and factor the linear system for the current H*/
+  void factor() {
+    size_t m = this->nrows;
+    size_t n = this->ncols;
+    size_t na = this->active.size();
+    Scalar delta = this->options.dual_regularization;
+    Scalar *values = this->kkt.get_values()->data();
+    if (this->form == KKTForm::normal_equations) {
+      std::fill(values, values + this->kkt.get_nnz(), Scalar{0});
+      auto const &a_ptr = this->constraints.get_col_ptr();
+      Scalar const *a_values = this->constraints.get_values()->data();
+      for (size_t k = 0; k < na; k++) {
+        size_t var = this->active[k];
+        Scalar inverse = 1 / this->h[var];
+        size_t slot = this->pair_ptr[k];
+        if (var >= n) {
+          values[this->pair_entry[slot]] += inverse;
+          continue;
+        }
+        for (size_t p = a_ptr[var]; p < a_ptr[var + 1]; p++) {
+          Scalar scaled = a_values[p] * inverse;
+          for (size_t q = p; q < a_ptr[var + 1]; q++) {
+            values[this->pair_entry[slot++]] += scaled * a_values[q];
+          }
+        }
+      }
+      for (size_t i = 0; i < m; i++) {
+        values[this->kkt_diagonal[i]] += delta;
+      }
+    } else {
+      for (size_t k = 0; k < na; k++) {
+        values[this->kkt_diagonal[k]] = this->h[this->active[k]];
+      }
+      for (size_t i = 0; i < m; i++) {
+        values[this->kkt_diagonal[na + i]] = -delta;
+      }
+    }
+    this->ldlt.factorize(this->kkt);
+    this->factorizations++;
+  }
+  /*! Solve the regularized system H dx - [A, -I]^T dy = r_dual,
+   * [A, -I] dx = r_primal with the current factorization.
+   *
+   * @param r_dual Right hand side per variable (fixed ones are ignored)
+   * @param r_primal Right hand side per row
+   * @param dx Set to the primal direction (zero for fixed variables)
+   * @param dy Set to the dual direction
+   * */
+  void solve_regularized(Scalar const *r_dual, Scalar const *r_primal,
+                         Scalar *dx, Scalar *dy) {
+    size_t m = this->nrows;
+    size_t na = this->active.size();
+    std::fill(dx, dx + this->total, Scalar{0});
+    if (this->form == KKTForm::normal_equations) {
+      // (A H^-1 A^T + delta) v = A H^-1 r_dual - r_primal, dy = -v
+      for (size_t var : this->active) {
+        dx[var] = r_dual[var] / this->h[var];
+      }
+      Scalar *v = this->buffer.data();
+      for (size_t i = 0; i < m; i++) {
+        v[i] = -r_primal[i];
+      }
+      this->add_constraint_product(1, dx, v);
+      this->ldlt.solve_inplace(v);
+      std::fill(dx, dx + this->total, Scalar{0});
+      for (size_t var : this->active) {
+        dx[var] = r_dual[var];
+      }
+      this->add_constraint_transpose_product(-1, v, dx);
+      for (size_t var = 0; var < this->total; var++) {
+        dx[var] = this->active_index[var] == npos ? Scalar{0}
+                                                  : dx[var] / this->h[var];
+      }
+      for (size_t i = 0; i < m; i++) {
+        dy[i] = -v[i];
+      }
+    } else {
+      Scalar *solution = this->buffer.data();
+      for (size_t k = 0; k < na; k++) {
+        solution[k] = r_dual[this->active[k]];
+      }
+      for (size_t i = 0; i < m; i++) {
+        solution[na + i] = r_primal[i];
+      }
+      this->ldlt.solve_inplace(solution);
+      for (size_t k = 0; k < na; k++) {
+        dx[this->active[k]] = solution[k];
+      }
+      for (size_t i = 0; i < m; i++) {
+        dy[i] = -solution[na + i];
+      }
+    }
+  }
+  /*! Solve the Newton system of solve_regularized, refining the solution
+   * against the system without regularization*/
+  void solve_newton(Scalar const *r_dual, Scalar const *r_primal,
+                    Scalar *dx, Scalar *dy) {
+    this->solve_regularized(r_dual, r_primal, dx, dy);
+    Scalar rho = this->options.primal_regularization;
+    Scalar *e_dual = this->residual_dual.data();
+    Scalar *e_primal = this->residual_primal.data();
+    std::vector<Scalar> &ddx = this->correction.dx;
+    std::vector<Scalar> &ddy = this->correction.dy;
+    for (size_t step = 0; step < this->options.refinement_steps; step++) {
+      // e = r - K dx with K unregularized
+      std::fill(e_dual, e_dual + this->total, Scalar{0});
+      this->add_hessian_product(dx, e_dual);
+      this->add_constraint_transpose_product(-1, dy, e_dual);
+      Scalar largest = 0;
+      for (size_t var : this->active) {
+        Scalar diagonal = this->h[var] - rho - this->hessian_diagonal[var];
+        e_dual[var] = r_dual[var] - e_dual[var] - diagonal * dx[var];
+        largest = std::max(largest, std::abs(e_dual[var]));
+      }
+      std::fill(e_primal, e_primal + this->nrows, Scalar{0});
+      this->add_constraint_product(1, dx, e_primal);
+      for (size_t i = 0; i < this->nrows; i++) {
+        e_primal[i] = r_primal[i] - e_primal[i];
+        largest = std::max(largest, std::abs(e_primal[i]));
+      }
+      if (largest < Scalar(1e-14)) {
+        break;
+      }
+      this->solve_regularized(e_dual, e_primal, ddx.data(), ddy.data());
+      for (size_t var : this->active) {
+        dx[var] += ddx[var];
+      }
+      for (size_t i = 0; i < this->nrows; i++) {
+        dy[i] += ddy[i];
+      }
+    }
+  }
+
+  // SECTION: Iterations
+  /*! Compute the residuals of the current iterate*/
+  void compute_residuals() {
+    std::fill(this->primal_residual.begin(), this->primal_residual.end(),
+              Scalar{0});
+    this->add_constraint_product(-1, this->x.data(),
+                                 this->primal_residual.data());
+    std::copy(this->cost.begin(), this->cost.end(),
+              this->dual_residual.begin());
+    this->add_hessian_product(this->x.data(), this->dual_residual.data());
+    this->add_constraint_transpose_product(-1, this->y.data(),
+                                           this->dual_residual.data());
+    for (size_t var : this->active) {
+      this->dual_residual[var] += this->zu[var] - this->zl[var];
+    }
+  }
+  /*! Average complementarity product*/
+  Scalar complementarity() const {
+    if (this->num_complementarity == 0) {
+      return 0;
+    }
+    Scalar sum = 0;
+    for (size_t var : this->active) {
+      if (this->has_lower[var]) {
+        sum += (this->x[var] - this->lower[var]) * this->zl[var];
+      }
+      if (this->has_upper[var]) {
+        sum += (this->upper[var] - this->x[var]) * this->zu[var];
+      }
+    }
+    return sum / static_cast<Scalar>(this->num_complementarity);
+  }
+  /*! Primal and dual objectives of the current iterate*/
+  std::pair<Scalar, Scalar> objectives() const {
+    std::vector<Scalar> qx(this->total, 0);
+    this->add_hessian_product(this->x.data(), qx.data());
+    Scalar quadratic = 0;
+    Scalar primal = 0;
+    for (size_t var = 0; var < this->total; var++) {
+      quadratic += this->x[var] * qx[var] / 2;
+      primal += this->cost[var] * this->x[var];
+    }
+    Scalar dual = -quadratic;
+    for (size_t var = 0; var < this->total; var++) {
+      if (this->active_index[var] == npos) {
+        // The dual of a fixed variable is its reduced cost
+        Scalar reduced = this->dual_residual[var];
+        dual += reduced * this->lower[var];
+        continue;
+      }
+      if (this->has_lower[var]) {
+        dual += this->lower[var] * this->zl[var];
+      }
+      if (this->has_upper[var]) {
+        dual -= this->upper[var] * this->zu[var];
+      }
+    }
+    return {primal + quadratic, dual};
+  }
+  /*! Complete a direction from its dx: the bound dual changes for the
+   * complementarity right hand sides, and the largest steps*/
+  void finish_direction(Direction &direction) const {
+    for (size_t var : this->active) {
+      Scalar dx = direction.dx[var];
+      if (this->has_lower[var]) {
+        direction.dzl[var] = (this->rcl[var] - this->zl[var] * dx) /
+                             (this->x[var] - this->lower[var]);
+      }
+      if (this->has_upper[var]) {
+        direction.dzu[var] = (this->rcu[var] + this->zu[var] * dx) /
+                             (this->upper[var] - this->x[var]);
+      }
+    }
+    this->step_lengths(direction);
+  }
+  /*! Compute a direction for the complementarity right hand sides in
+   * rcl and rcu, with (or without) the primal and dual residuals*/
+  void compute_direction(Direction &direction, bool with_residuals) {
+    Scalar *r_dual = this->rhs_dual.data();
+    Scalar *r_primal = this->rhs_primal.data();
+    for (size_t var : this->active) {
+      Scalar value = with_residuals ? -this->dual_residual[var] : Scalar{0};
+      if (this->has_lower[var]) {
+        value += this->rcl[var] / (this->x[var] - this->lower[var]);
+      }
+      if (this->has_upper[var]) {
+        value -= this->rcu[var] / (this->upper[var] - this->x[var]);
+      }
+      r_dual[var] = value;
+    }
+    for (size_t i = 0; i < this->nrows; i++) {
+      r_primal[i] = with_residuals ? this->primal_residual[i] : Scalar{0};
+    }
+    this->solve_newton(r_dual, r_primal, direction.dx.data(),
+                       direction.dy.data());
+    this->finish_direction(direction);
+  }
+  /*! Average complementarity after steps along a direction*/
+  Scalar complementarity_after(Direction const &direction, Scalar primal_step,
+                               Scalar dual_step) const {
+    Scalar sum = 0;
+    for (size_t var : this->active) {
+      Scalar dx = primal_step * direction.dx[var];
+      if (this->has_lower[var]) {
+        sum += (this->x[var] - this->lower[var] + dx) *
+               (this->zl[var] + dual_step * direction.dzl[var]);
+      }
+      if (this->has_upper[var]) {
+        sum += (this->upper[var] - this->x[var] - dx) *
+               (this->zu[var] + dual_step * direction.dzu[var]);
+      }
+    }
+    return sum / static_cast<Scalar>(this->num_complementarity);
+  }
+  /*! Add Gondzio correctors to the corrector direction while they enlarge
+   * the steps.
+   *
+   * @param target The centering target sigma * mu
+   * */
+  void centrality_correctors(Scalar target) {
+    Direction &current = this->corrector;
+    Scalar const enlarge = Scalar(0.1);
+    Scalar const lowest = Scalar(0.1) * target;
+    Scalar const highest = 10 * target;
+    for (size_t k = 0; k < this->options.max_correctors; k++) {
+      if (current.primal_step >= 1 && current.dual_step >= 1) {
+        return;
+      }
+      Scalar trial_primal = std::min(Scalar{1}, current.primal_step + enlarge);
+      Scalar trial_dual = std::min(Scalar{1}, current.dual_step + enlarge);
+      // Move the complementarity products at the trial step into
+      // [lowest, highest]
+      auto project = [&](Scalar product) {
+        if (product < lowest) {
+          return lowest - product;
+        }
+        if (product > highest) {
+          return std::max(highest - product, -highest);
+        }
+        return Scalar{0};
+      };
+      std::fill(this->rcl.begin(), this->rcl.end(), Scalar{0});
+      std::fill(this->rcu.begin(), this->rcu.end(), Scalar{0});
+      for (size_t var : this->active) {
+        Scalar dx = trial_primal * current.dx[var];
+        if (this->has_lower[var]) {
+          this->rcl[var] = project((this->x[var] - this->lower[var] + dx) *
+                                   (this->zl[var] +
+                                    trial_dual * current.dzl[var]));
+        }
+        if (this->has_upper[var]) {
+          this->rcu[var] = project((this->upper[var] - this->x[var] - dx) *
+                                   (this->zu[var] +
+                                    trial_dual * current.dzu[var]));
+        }
+      }
+      // The correction only changes the complementarity products
+      this->compute_direction(this->predictor, false);
+      Direction &trial = this->predictor;
+      for (size_t var = 0; var < this->total; var++) {
+        trial.dx[var] += current.dx[var];
+        trial.dzl[var] += current.dzl[var];
+        trial.dzu[var] += current.dzu[var];
+      }
+      for (size_t i = 0; i < this->nrows; i++) {
+        trial.dy[i] += current.dy[i];
+      }
+      this->step_lengths(trial);
+      if (trial.primal_step + trial.dual_step <
+          Scalar(1.01) * (current.primal_step + current.dual_step)) {
+        return;
+      }
+      std::swap(this->predictor, this->corrector);
+    }
+  }
+  /*! Largest steps along a direction keeping the iterate nonnegative*/
+  void step_lengths(Direction &direction) const {
+    Scalar primal_step = 1;
+    Scalar dual_step = 1;
+    for (size_t var : this->active) {
+      Scalar dx = direction.dx[var];
+      if (this->has_lower[var]) {
+        if (dx < 0) {
+          primal_step =
+              std::min(primal_step, (this->x[var] - this->lower[var]) / -dx);
+        }
+        if (direction.dzl[var] < 0) {
+          dual_step = std::min(dual_step, this->zl[var] / -direction.dzl[var]);
+        }
+      }
+      if (this->has_upper[var]) {
+        if (dx > 0) {
+          primal_step =
+              std::min(primal_step, (this->upper[var] - this->x[var]) / dx);
+        }
+        if (direction.dzu[var] < 0) {
+          dual_step = std::min(dual_step, this->zu[var] / -direction.dzu[var]);
+        }
+      }
+    }
+    if (!this->problem.is_linear()) {
+      // The dual residual depends on x, so both take the same step
+      primal_step = dual_step = std::min(primal_step, dual_step);
+    }
+    direction.primal_step = primal_step;
+    direction.dual_step = dual_step;
+  }
+  /*! Starting point: the least norm solution of the constraints pushed
+   * inside the bounds, and duals from the least squares fit of the costs*/
+  void initial_point() {
+    size_t m = this->nrows;
+    for (size_t var = 0; var < this->total; var++) {
+      this->x[var] = this->active_index[var] == npos ? this->lower[var] : 0;
+      this->zl[var] = 0;
+      this->zu[var] = 0;
+    }
+    std::fill(this->y.begin(), this->y.end(), Scalar{0});
+    // Factor with H = Q_jj + 1
+    for (size_t var : this->active) {
+      this->h[var] = this->hessian_diagonal[var] + 1;
+    }
+    this->factor();
+    // Least norm correction of x to [A, -I] x = 0
+    this->compute_residuals();
+    std::vector<Scalar> zero(this->total, 0);
+    this->solve_newton(zero.data(), this->primal_residual.data(),
+                       this->predictor.dx.data(), this->predictor.dy.data());
+    for (size_t var : this->active) {
+      this->x[var] += this->predictor.dx[var];
+    }
+    for (size_t var : this->active) {
+      Scalar &value = this->x[var];
+      if (this->has_lower[var] && this->has_upper[var]) {
+        Scalar margin = std::min(Scalar{1},
+                                 (this->upper[var] - this->lower[var]) / 4);
+        value = std::clamp(value, this->lower[var] + margin,
+                           this->upper[var] - margin);
+      } else if (this->has_lower[var]) {
+        value = std::max(value, this->lower[var] + 1);
+      } else if (this->has_upper[var]) {
+        value = std::min(value, this->upper[var] - 1);
+      }
+    }
+    // Least squares duals: g - [A, -I]^T y with g = c + Q x
+    std::vector<Scalar> gradient(this->cost);
+    this->add_hessian_product(this->x.data(), gradient.data());
+    std::fill(this->primal_residual.begin(), this->primal_residual.end(),
+              Scalar{0});
+    this->solve_newton(gradient.data(), this->primal_residual.data(),
+                       this->predictor.dx.data(), this->predictor.dy.data());
+    for (size_t i = 0; i < m; i++) {
+      this->y[i] = -this->predictor.dy[i];
+    }
+    for (size_t var : this->active) {
+      Scalar reduced = this->predictor.dx[var];
+      this->zl[var] = this->has_lower[var] ? std::max(Scalar{1}, reduced) : 0;
+      this->zu[var] = this->has_upper[var] ? std::max(Scalar{1}, -reduced) : 0;
+    }
+  }
+  /*! Starting point from the solution in start, with every distance to a
+   * finite bound and every bound dual at least warm_start_shift*/
+  void warm_point() {
+    size_t m = this->nrows;
+    size_t n = this->ncols;
+    Scalar shift = this->options.warm_start_shift;
+    // Bound duals z_lower - z_upper are the reduced costs of the
+    // structurals and the row duals for the logicals
+    std::vector<Scalar> reduced(this->total);
+    for (size_t j = 0; j < n; j++) {
+      this->x[j] = this->start.x[j] / this->scaling.col_scale[j];
+      reduced[j] = this->start.reduced_costs[j] * this->scaling.col_scale[j];
+    }
+    for (size_t i = 0; i < m; i++) {
+      Scalar scale = this->scaling.row_scale[i];
+      this->x[n + i] = this->start.row_activity[i] * scale;
+      this->y[i] = this->start.row_duals[i] / scale;
+      reduced[n + i] = this->y[i];
+    }
+    for (size_t var = 0; var < this->total; var++) {
+      this->zl[var] = 0;
+      this->zu[var] = 0;
+      if (this->active_index[var] == npos) {
+        this->x[var] = this->lower[var];
+        continue;
+      }
+      Scalar &value = this->x[var];
+      if (this->has_lower[var] && this->has_upper[var]) {
+        Scalar margin =
+            std::min(shift, (this->upper[var] - this->lower[var]) / 4);
+        value = std::clamp(value, this->lower[var] + margin,
+                           this->upper[var] - margin);
+      } else if (this->has_lower[var]) {
+        value = std::max(value, this->lower[var] + shift);
+      } else if (this->has_upper[var]) {
+        value = std::min(value, this->upper[var] - shift);
+      }
+      if (this->has_lower[var]) {
+        this->zl[var] = std::max(shift, reduced[var]);
+      }
+      if (this->has_upper[var]) {
+        this->zu[var] = std::max(shift, -reduced[var]);
+      }
+    }
+  }
+  /*! Run the predictor-corrector iterations*/
+  LPStatus run() {
+    for (size_t var = 0; var < this->total; var++) {
+      if (this->lower[var] > this->upper[var]) {
+        return LPStatus::infeasible;
+      }
+    }
+    if (this->start.x.empty()) {
+      this->initial_point();
+    } else {
+      this->warm_point();
+      this->start = {};
+    }
+    Scalar cost_norm = 0;
+    for (Scalar c : this->cost) {
+      cost_norm = std::max(cost_norm, std::abs(c));
+    }
+    Scalar tolerance = this->options.tolerance;
+    while (true) {
+      this->compute_residuals();
+      Scalar x_norm = 0;
+      Scalar dual_norm = 0;
+      for (size_t var = 0; var < this->total; var++) {
+        x_norm = std::max(x_norm, std::abs(this->x[var]));
+        dual_norm = std::max(
+            {dual_norm, std::abs(this->zl[var]), std::abs(this->zu[var])});
+      }
+      for (Scalar value : this->y) {
+        dual_norm = std::max(dual_norm, std::abs(value));
+      }
+      Scalar primal_error = 0;
+      for (Scalar value : this->primal_residual) {
+        primal_error = std::max(primal_error, std::abs(value));
+      }
+      Scalar dual_error = 0;
+      for (size_t var : this->active) {
+        dual_error = std::max(dual_error, std::abs(this->dual_residual[var]));
+      }
+      auto [primal_objective, dual_objective] = this->objectives();
+      Scalar gap = std::abs(primal_objective - dual_objective) /
+                   (1 + std::abs(primal_objective));
+      if (primal_error <= tolerance * (1 + x_norm) &&
+          dual_error <= tolerance * (1 + cost_norm) && gap <= tolerance) {
+        return LPStatus::optimal;
+      }
+      if (dual_norm > Scalar(divergence_limit) * (1 + cost_norm)) {
+        return LPStatus::infeasible;
+      }
+      if (x_norm > Scalar(divergence_limit)) {
+        return LPStatus::unbounded;
+      }
+      if (this->iterations >= this->options.max_iterations) {
+        return LPStatus::iteration_limit;
+      }
+      Scalar mu = this->complementarity();
+      this->compute_h();
+      this->factor();
+      // Predictor (affine scaling) direction
+      for (size_t var : this->active) {
+        this->rcl[var] = this->has_lower[var]
+                             ? -(this->x[var] - this->lower[var]) *
+                                   this->zl[var]
+                             : Scalar{0};
+        this->rcu[var] = this->has_upper[var]
+                             ? -(this->upper[var] - this->x[var]) *
+                                   this->zu[var]
+                             : Scalar{0};
+      }
+      this->compute_direction(this->predictor, true);
+      Direction const &affine = this->predictor;
+      Scalar sigma = 0;
+      if (this->num_complementarity > 0 && mu > 0) {
+        Scalar ratio = this->complementarity_after(
+                           affine, affine.primal_step, affine.dual_step) /
+                       mu;
+        sigma = std::clamp(ratio * ratio * ratio, Scalar{0}, Scalar{1});
+      }
+      // Corrector, with the second order term of the predictor
+      Scalar target = sigma * mu;
+      for (size_t var : this->active) {
+        Scalar dx = affine.dx[var];
+        if (this->has_lower[var]) {
+          this->rcl[var] = target -
+                           (this->x[var] - this->lower[var]) * this->zl[var] -
+                           dx * affine.dzl[var];
+        }
+        if (this->has_upper[var]) {
+          this->rcu[var] = target -
+                           (this->upper[var] - this->x[var]) * this->zu[var] +
+                           dx * affine.dzu[var];
+        }
+      }
+      this->compute_direction(this->corrector, true);
+      if (this->num_complementarity > 0) {
+        this->centrality_correctors(target);
+      }
+      // Step
+      Direction const &step = this->corrector;
+      Scalar primal_step =
+          std::min(Scalar{1}, this->options.step_factor * step.primal_step);
+      Scalar dual_step =
+          std::min(Scalar{1}, this->options.step_factor * step.dual_step);
+      for (size_t var : this->active) {
+        this->x[var] += primal_step * step.dx[var];
+        this->zl[var] += dual_step * step.dzl[var];
+        this->zu[var] += dual_step * step.dzu[var];
+      }
+      for (size_t i = 0; i < this->nrows; i++) {
+        this->y[i] += dual_step * step.dy[i];
+      }
+      this->iterations++;
+    }
+  }
+  /*! Choose a basis from the interior solution (the nrows variables
+   * farthest from their bounds relative to their duals) and finish the
+   * solve with the simplex method*/
+  LPSolution<Scalar> crossover() {
+    size_t n = this->ncols;
+    std::vector<Scalar> score(this->total, 0);
+    std::vector<BasisStatus> status(this->total, BasisStatus::at_lower);
+    Scalar const infinite = std::numeric_limits<Scalar>::infinity();
+    for (size_t var : this->active) {
+      Scalar to_lower = this->has_lower[var]
+                            ? (this->x[var] - this->lower[var]) / this->zl[var]
+                            : infinite;
+      Scalar to_upper = this->has_upper[var]
+                            ? (this->upper[var] - this->x[var]) / this->zu[var]
+                            : infinite;
+      score[var] = std::min(to_lower, to_upper);
+      if (this->has_lower[var] || this->has_upper[var]) {
+        status[var] = to_lower <= to_upper ? BasisStatus::at_lower
+                                           : BasisStatus::at_upper;
+      } else {
+        status[var] = BasisStatus::free;
+      }
+    }
+    std::vector<size_t> order(this->active);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return score[a] > score[b];
+    });
+    for (size_t k = 0; k < std::min(this->nrows, order.size()); k++) {
+      status[order[k]] = BasisStatus::basic;
+    }
+    // Too few active variables: complete with logicals of fixed rows
+    size_t count = std::min(this->nrows, order.size());
+    for (size_t i = 0; i < this->nrows && count < this->nrows; i++) {
+      if (status[n + i] != BasisStatus::basic) {
+        status[n + i] = BasisStatus::basic;
+        count++;
+      }
+    }
+    RevisedSimplex<Scalar> simplex{this->problem,
+                                   this->options.simplex_options};
+    simplex.set_basis(
+        std::vector<BasisStatus>(status.begin(), status.begin() + n),
+        std::vector<BasisStatus>(status.begin() + n, status.end()));
+    LPSolution<Scalar> solution = simplex.solve();
+    solution.iterations += this->iterations;
+    return solution;
+  }
+  /*! Unscale the current iterate into an LPSolution*/
+  LPSolution<Scalar> make_solution(LPStatus result) const {
+    size_t n = this->ncols;
+    LPSolution<Scalar> solution;
+    solution.status = result;
+    solution.iterations = this->iterations;
+    solution.x.assign(this->x.begin(), this->x.begin() + n);
+    this->scaling.unscale_primal(solution.x);
+    solution.row_activity = this->problem.constraints.multiply(solution.x);
+    solution.row_duals = this->y;
+    this->scaling.unscale_dual(solution.row_duals);
+    // Reduced costs c + Q x - A^T y from the original data
+    solution.reduced_costs = this->problem.objective;
+    this->problem.add_hessian_product(solution.x.data(),
+                                      solution.reduced_costs.data());
+    this->problem.constraints.gaxpy_transpose(-1, solution.row_duals.data(),
+                                              solution.reduced_costs.data());
+    solution.objective = this->problem.evaluate(solution.x);
+    return solution;
+  }
+
+public:
+  // SECTION: Constructors
+  /*! Set up the solver for a problem (which is copied and scaled), and
+   * analyze the sparsity pattern of its linear system.
+   *
+   * @param problem The QP (or LP) to solve
+   * @param options Options of the solve
+   * */
+  explicit InteriorPoint(QPProblem<Scalar> problem,
+                         InteriorPointOptions<Scalar> const &options = {})
+      : problem(std::move(problem)), options(options),
+        nrows(this->problem.get_nrows()), ncols(this->problem.get_ncols()),
+        total(nrows + ncols), analyses(0), factorizations(0), iterations(0),
+        solved(false) {
+    this->problem.validate();
+    this->constraints = this->problem.constraints;
+    this->hessian = this->problem.is_linear()
+                        ? teensymat::SparseMatrix<Scalar>(ncols, ncols)
+                        : this->problem.hessian;
+    this->load();
+    this->form = this->choose_form();
+    if (this->form == KKTForm::normal_equations &&
+        !this->hessian_is_diagonal()) {
+      throw std::runtime_error(
+          "The normal equations need a diagonal quadratic term");
+    }
+    this->setup_kkt(true);
+    this->x.assign(this->total, 0);
+    this->y.assign(this->nrows, 0);
+    this->zl.assign(this->total, 0);
+    this->zu.assign(this->total, 0);
+    this->dual_residual.assign(this->total, 0);
+    this->primal_residual.assign(this->nrows, 0);
+    this->h.assign(this->total, 1);
+    this->rcl.assign(this->total, 0);
+    this->rcu.assign(this->total, 0);
+    this->rhs_dual.assign(this->total, 0);
+    this->rhs_primal.assign(this->nrows, 0);
+    this->residual_dual.assign(this->total, 0);
+    this->residual_primal.assign(this->nrows, 0);
+    this->buffer.assign(this->kkt.get_nrows(), 0);
+    this->predictor.resize(this->total, this->nrows);
+    this->corrector.resize(this->total, this->nrows);
+    this->correction.resize(this->total, this->nrows);
+  }
+  InteriorPoint(InteriorPoint const &) = delete;
+  InteriorPoint &operator=(InteriorPoint const &) = delete;
+
+  // SECTION: Getters
+  /*! Get the form of the linear system in use*/
+  KKTForm get_kkt_form() const { return this->form; }
+  /*! Get the number of symbolic analyses of the linear system (one at
+   * construction, plus one per update changing its structure)*/
+  size_t get_num_analyses() const { return this->analyses; }
+  /*! Get the number of numeric factorizations performed (one per
+   * iteration, plus one for each default starting point)*/
+  size_t get_num_factorizations() const { return this->factorizations; }
+
+  // SECTION: Warm starts
+  /*! Start the next solve from a solution of this problem or a similar one
+   * (its x, row activities, row duals and reduced costs are used), moved
+   * into the interior by warm_start_shift.
+   *
+   * Throws std::range_error if the lengths do not match the problem.
+   *
+   * @param solution The starting point
+   * */
+  void set_starting_point(LPSolution<Scalar> const &solution) {
+    if (solution.x.size() != this->ncols ||
+        solution.reduced_costs.size() != this->ncols ||
+        solution.row_activity.size() != this->nrows ||
+        solution.row_duals.size() != this->nrows) {
+      throw std::range_error("Starting point does not match the problem");
+    }
+    this->start = solution;
+  }
+  /*! Replace the data of the problem. The next solve starts from the last
+   * iterate of the previous one (unless set_starting_point is called), and
+   * the symbolic analysis of the linear system is reused when its sparsity
+   * pattern and the set of fixed variables are unchanged.
+   *
+   * Throws std::range_error if the dimensions differ from the current
+   * problem, and std::runtime_error if the normal equations were requested
+   * and Q is no longer diagonal.
+   *
+   * @param problem The new problem
+   * @return The parts of the problem which changed
+   * */
+  ProblemChanges update(QPProblem<Scalar> problem) {
+    ProblemChanges changes = compare_problems(this->problem, problem);
+    if (this->solved && this->start.x.empty()) {
+      this->start = this->make_solution(LPStatus::optimal);
+    }
+    if (!changes.any()) {
+      return changes;
+    }
+    std::vector<size_t> previous_active = std::move(this->active);
+    KKTForm previous_form = this->form;
+    this->problem = std::move(problem);
+    this->constraints = this->problem.constraints;
+    this->hessian = this->problem.is_linear()
+                        ? teensymat::SparseMatrix<Scalar>(this->ncols, this->ncols)
+                        : this->problem.hessian;
+    this->load();
+    this->form = this->choose_form();
+    if (this->form == KKTForm::normal_equations &&
+        !this->hessian_is_diagonal()) {
+      throw std::runtime_error(
+          "The normal equations need a diagonal quadratic term");
+    }
+    this->setup_kkt(changes.pattern || this->form != previous_form ||
+                    this->active != previous_active);
+    this->buffer.assign(this->kkt.get_nrows(), 0);
+    return changes;
+  }
+  /*! Get the number of entries of the factor of the linear system*/
+  size_t get_factor_nnz() const { return this->ldlt.get_factor_nnz(); }
+
+  // SECTION: Solving
+  /*! Solve the problem.
+   *
+   * @return The solution (with basis statuses only after crossover)
+   * */
+  LPSolution<Scalar> solve() {
+    this->iterations = 0;
+    LPStatus result = this->run();
+    this->solved = true;
+    if (result == LPStatus::optimal && this->options.crossover &&
+        this->problem.is_linear()) {
+      return this->crossover();
+    }
+    return this->make_solution(result);
+  }
+};
+
+/*! Solve a QP with the interior point method (see InteriorPoint).
+ *
+ * @param problem The QP to solve
+ * @param options Options of the solve
+ * @return The solution
+ * */
+template <typename Scalar>
+LPSolution<Scalar>
+solve_interior_point(QPProblem<Scalar> const &problem,
+                     InteriorPointOptions<Scalar> const &options = {}) {
+  InteriorPoint<Scalar> solver{problem, options};
+  return solver.solve();
+}
+/*! Solve an LP with the interior point method (see InteriorPoint).
+ *
+ * @param problem The LP to solve
+ * @param options Options of the solve
+ * @return The solution
+ * */
+template <typename Scalar>
+LPSolution<Scalar>
+solve_interior_point(LPProblem<Scalar> const &problem,
+                     InteriorPointOptions<Scalar> const &options = {}) {
+  InteriorPoint<Scalar> solver{QPProblem<Scalar>{problem}, options};
+  return solver.solve();
+}
+} // namespace teensylp
@@ -0,0 +1,168 @@
+#pragma once
+// std includes
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/sparse_core.hpp"
+
+namespace teensylp {
+/*! A linear program in bounded form:
+ *
+ *     minimize    objective^T x + objective_offset
+ *     subject to  row_lower <= A x <= row_upper
+ *                 col_lower <=  x  <= col_upper
+ *
+ * Missing bounds are represented by infinities, and equality rows have
+ * row_lower == row_upper.
+ * */
+template <typename Scalar> struct LPProblem {
+  /*! The constraint matrix A (one column per variable)*/
+  teensymat::SparseMatrix<Scalar> constraints;
+  /*! Cost of each variable*/
+  std::vector<Scalar> objective;
+  /*! Constant term of the objective*/
+  Scalar objective_offset = 0;
+  /*! Lower bound of each row activity*/
+  std::vector<Scalar> row_lower;
+  /*! Upper bound of each row activity*/
+  std::vector<Scalar> row_upper;
+  /*! Lower bound of each variable*/
+  std::vector<Scalar> col_lower;
+  /*! Upper bound of each variable*/
+  std::vector<Scalar> col_upper;
+
+  /*! Get the number of rows (constraints)*/
+  size_t get_nrows() const { return this->constraints.get_nrows(); }
+  /*! Get the number of columns (variables)*/
+  size_t get_ncols() const { return this->constraints.get_ncols(); }
+  /*! Check that all arrays have lengths matching the constraint matrix,
+   * throwing std::range_error otherwise*/
+  void validate() const {
+    size_t m = this->get_nrows();
+    size_t n = this->get_ncols();
+    if (this->objective.size() != n || this->col_lower.size() != n ||
+        this->col_upper.size() != n) {
+      throw std::range_error("Column data does not match the constraints");
+    }
+    if (this->row_lower.size() != m || this->row_upper.size() != m) {
+      throw std::range_error("Row data does not match the constraints");
+    }
+  }
+  /*! The objective value (including the offset) at x*/
+  Scalar evaluate(std::vector<Scalar> const &x) const {
+    Scalar value = this->objective_offset;
+    for (size_t j = 0; j < x.size(); j++) {
+      value += this->objective[j] * x[j];
+    }
+    return value;
+  }
+};
+
+/*! Parts of a problem which differ from another one of the same
+ * dimensions, telling a solver what it can keep when it resumes*/
+struct ProblemChanges {
+  /*! The costs or the constant term of the objective (for a QPProblem,
+   * also the values of Q)*/
+  bool objective = false;
+  /*! The row or column bounds*/
+  bool bounds = false;
+  /*! The values of the constraint matrix*/
+  bool values = false;
+  /*! The sparsity pattern of the constraint matrix (for a QPProblem, also
+   * that of Q)*/
+  bool pattern = false;
+
+  /*! Whether anything changed*/
+  bool any() const {
+    return this->objective || this->bounds || this->values || this->pattern;
+  }
+};
+
+/*! Compare two problems with the same dimensions.
+ *
+ * Throws std::range_error if the dimensions differ.
+ *
+ * @param before The problem previously solved
+ * @param after The problem to solve next
+ * @return The parts of the problem which changed
+ * */
+template <typename Scalar>
+ProblemChanges compare_problems(LPProblem<Scalar> const &before,
+                                LPProblem<Scalar> const &after) {
+  before.validate();
+  after.validate();
+  if (before.get_nrows() != after.get_nrows() ||
+      before.get_ncols() != after.get_ncols()) {
+    throw std::range_error("Problems must have the same dimensions");
+  }
+  ProblemChanges changes;
+  changes.objective = before.objective != after.objective ||
+                      before.objective_offset != after.objective_offset;
+  changes.bounds = before.row_lower != after.row_lower ||
+                   before.row_upper != after.row_upper ||
+                   before.col_lower != after.col_lower ||
+                   before.col_upper != after.col_upper;
+  changes.pattern =
+      before.constraints.get_col_ptr() != after.constraints.get_col_ptr() ||
+      before.constraints.get_row_idx() != after.constraints.get_row_idx();
+  changes.values = changes.pattern || *before.constraints.get_values() !=
+                                          *after.constraints.get_values();
+  return changes;
+}
+
+/*! Infinity used for missing bounds*/
+template <typename Scalar>
+constexpr Scalar infinity = std::numeric_limits<Scalar>::infinity();
+
+/*! Outcome of an LP solve*/
+enum class LPStatus {
+  /*! An optimal solution was found*/
+  optimal,
+  /*! The constraints can not be satisfied*/
+  infeasible,
+  /*! The objective is unbounded below*/
+  unbounded,
+  /*! The iteration limit was reached*/
+  iteration_limit,
+  /*! The solver could not make progress for numerical reasons*/
+  numerical_error,
+};
+
+/*! Status of a variable (structural or row logical) in a simplex basis*/
+enum class BasisStatus {
+  /*! In the basis*/
+  basic,
+  /*! Nonbasic at its lower bound*/
+  at_lower,
+  /*! Nonbasic at its upper bound*/
+  at_upper,
+  /*! Nonbasic free variable, at zero*/
+  free,
+};
+
+/*! Solution of an LP, and the basis it came from (if any)*/
+template <typename Scalar> struct LPSolution {
+  /*! Outcome of the solve*/
+  LPStatus status = LPStatus::numerical_error;
+  /*! Objective value (including the offset)*/
+  Scalar objective = 0;
+  /*! Value of each variable*/
+  std::vector<Scalar> x;
+  /*! Activity A x of each row*/
+  std::vector<Scalar> row_activity;
+  /*! Dual value of each row, such that objective - A^T row_duals =
+   * reduced_costs*/
+  std::vector<Scalar> row_duals;
+  /*! Reduced cost of each variable*/
+  std::vector<Scalar> reduced_costs;
+  /*! Basis status of each variable (empty for non basis solvers)*/
+  std::vector<BasisStatus> col_status;
+  /*! Basis status of each row logical (empty for non basis solvers)*/
+  std::vector<BasisStatus> row_status;
+  /*! Number of iterations performed*/
+  size_t iterations = 0;
+};
+} // namespace teensylp
@@ -0,0 +1,1495 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyLP/lp_problem.hpp"
+#include "TeensyOpt/TeensyLP/qp_problem.hpp"
+#include "TeensyOpt/TeensyMat/linalg.hpp"
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+#include "TeensyOpt/TeensyMat/sparse_core.hpp"
+
+namespace teensylp {
+/*! One stage of an MPCProblem. Every member may be left empty, meaning
+ * zero (matrices and vectors) or no bound (bound vectors).
+ *
+ * The stage couples its state x (length nx) and input u (length nu):
+ *
+ *     cost        1/2 x^T Q x + u^T S x + 1/2 u^T R u + q^T x + r^T u
+ *     dynamics    x_next = A x + B u + c
+ *     bounds      state_lower <= x <= state_upper,
+ *                 input_lower <= u <= input_upper
+ *     constraints constraint_lower <= C x + D u <= constraint_upper
+ *
+ * The terminal stage has no input, so its dynamics, input costs and input
+ * bounds are ignored (D must be empty).
+ * */
+template <typename Scalar> struct MPCStage {
+  /*! State transition A (nx by nx)*/
+  teensymat::Matrix<Scalar> state_transition;
+  /*! Input matrix B (nx by nu)*/
+  teensymat::Matrix<Scalar> input_matrix;
+  /*! Constant c of the dynamics (length nx)*/
+  std::vector<Scalar> offset;
+  /*! Hessian Q of the state (nx by nx, symmetric)*/
+  teensymat::Matrix<Scalar> state_cost;
+  /*! Hessian R of the input (nu by nu, symmetric)*/
+  teensymat::Matrix<Scalar> input_cost;
+  /*! Cross term S (nu by nx)*/
+  teensymat::Matrix<Scalar> cross_cost;
+  /*! Linear cost q of the state*/
+  std::vector<Scalar> state_gradient;
+  /*! Linear cost r of the input*/
+  std::vector<Scalar> input_gradient;
+  /*! Bounds of the state*/
+  std::vector<Scalar> state_lower, state_upper;
+  /*! Bounds of the input*/
+  std::vector<Scalar> input_lower, input_upper;
+  /*! State part C of the general constraints (ng by nx)*/
+  teensymat::Matrix<Scalar> constraint_state;
+  /*! Input part D of the general constraints (ng by nu)*/
+  teensymat::Matrix<Scalar> constraint_input;
+  /*! Bounds of the general constraints (length ng)*/
+  std::vector<Scalar> constraint_lower, constraint_upper;
+};
+
+/*! A model predictive control QP over stages 0, ..., N (the last one is
+ * terminal), starting from a fixed initial state x_0. The variables are
+ * the inputs u_0, ..., u_{N-1} and the states x_1, ..., x_N; bounds of
+ * x_0 are ignored.
+ * */
+template <typename Scalar> struct MPCProblem {
+  /*! The stages (N + 1 of them, N >= 1)*/
+  std::vector<MPCStage<Scalar>> stages;
+  /*! The initial state x_0*/
+  std::vector<Scalar> initial_state;
+
+  /*! Get the horizon N*/
+  size_t get_horizon() const {
+    return this->stages.empty() ? 0 : this->stages.size() - 1;
+  }
+  /*! Get the dimension of the state*/
+  size_t get_state_dim() const { return this->initial_state.size(); }
+  /*! Get the dimension of the input*/
+  size_t get_input_dim() const {
+    return this->stages.empty()
+               ? 0
+               : this->stages[0].input_matrix.get_ncols();
+  }
+  /*! Get the number of general constraints of a stage*/
+  size_t get_num_constraints(size_t stage) const {
+    return this->stages[stage].constraint_lower.size();
+  }
+  /*! Check the shapes of all blocks, throwing std::range_error if one does
+   * not match the dimensions*/
+  void validate() const {
+    if (this->stages.size() < 2) {
+      throw std::range_error("An MPCProblem needs at least two stages");
+    }
+    size_t nx = this->get_state_dim();
+    size_t nu = this->get_input_dim();
+    auto check_matrix = [](teensymat::Matrix<Scalar> const &matrix,
+                           size_t nrows, size_t ncols, bool optional) {
+      bool empty = matrix.get_nrows() == 0 && matrix.get_ncols() == 0;
+      if ((empty && !optional && nrows * ncols > 0) ||
+          (!empty &&
+           (matrix.get_nrows() != nrows || matrix.get_ncols() != ncols))) {
+        throw std::range_error("Stage matrix does not match the dimensions");
+      }
+    };
+    auto check_vector = [](std::vector<Scalar> const &vector, size_t size) {
+      if (!vector.empty() && vector.size() != size) {
+        throw std::range_error("Stage vector does not match the dimensions");
+      }
+    };
+    for (size_t k = 0; k < this->stages.size(); k++) {
+      auto const &stage = this->stages[k];
+      bool terminal = k + 1 == this->stages.size();
+      size_t ng = stage.constraint_lower.size();
+      if (stage.constraint_upper.size() != ng) {
+        throw std::range_error("Constraint bounds differ in length");
+      }
+      check_matrix(stage.state_cost, nx, nx, true);
+      check_vector(stage.state_gradient, nx);
+      check_vector(stage.state_lower, nx);
+      check_vector(stage.state_upper, nx);
+      check_matrix(stage.constraint_state, ng, nx, true);
+      if (terminal) {
+        check_matrix(stage.constraint_input, 0, 0, true);
+        continue;
+      }
+      check_matrix(stage.state_transition, nx, nx, false);
+      check_matrix(stage.input_matrix, nx, nu, false);
+      check_vector(stage.offset, nx);
+      check_matrix(stage.input_cost, nu, nu, true);
+      check_matrix(stage.cross_cost, nu, nx, true);
+      check_vector(stage.input_gradient, nu);
+      check_vector(stage.input_lower, nu);
+      check_vector(stage.input_upper, nu);
+      check_matrix(stage.constraint_input, ng, nu, true);
+    }
+  }
+  /*! The same problem as a sparse QPProblem, with the variables ordered
+   * u_0, x_1, u_1, x_2, ..., u_{N-1}, x_N, the dynamics as the first
+   * N * nx (equality) rows and the general constraints after them. The
+   * terms of the fixed x_0 are moved into the bounds, the costs and the
+   * objective offset.*/
+  QPProblem<Scalar> to_qp() const {
+    this->validate();
+    size_t nx = this->get_state_dim();
+    size_t nu = this->get_input_dim();
+    size_t horizon = this->get_horizon();
+    size_t stage_size = nx + nu;
+    size_t n = horizon * stage_size;
+    // Column of u_k and of x_k (k >= 1)
+    auto input_col = [&](size_t k) { return k * stage_size; };
+    auto state_col = [&](size_t k) { return (k - 1) * stage_size + nu; };
+    auto entry = [](teensymat::Matrix<Scalar> const &matrix, size_t i,
+                    size_t j) {
+      return matrix.get_nrows() == 0 ? Scalar{0} : *matrix(i, j);
+    };
+    auto value = [](std::vector<Scalar> const &vector, size_t i,
+                    Scalar missing) {
+      return vector.empty() ? missing : vector[i];
+    };
+    Scalar inf = infinity<Scalar>;
+    std::vector<Scalar> const &x0 = this->initial_state;
+    QPProblem<Scalar> problem;
+    problem.objective.assign(n, 0);
+    problem.col_lower.assign(n, -inf);
+    problem.col_upper.assign(n, inf);
+    std::vector<size_t> rows, cols, h_rows, h_cols;
+    std::vector<Scalar> vals, h_vals;
+    auto add = [&](size_t i, size_t j, Scalar v) {
+      if (v != Scalar{0}) {
+        rows.push_back(i);
+        cols.push_back(j);
+        vals.push_back(v);
+      }
+    };
+    auto add_hessian = [&](size_t i, size_t j, Scalar v) {
+      // Upper triangle only
+      if (v != Scalar{0} && i <= j) {
+        h_rows.push_back(i);
+        h_cols.push_back(j);
+        h_vals.push_back(v);
+      }
+    };
+    // Dynamics rows: A x_k + B u_k - x_{k+1} = -c_k
+    for (size_t k = 0; k < horizon; k++) {
+      auto const &stage = this->stages[k];
+      for (size_t i = 0; i < nx; i++) {
+        size_t row = k * nx + i;
+        Scalar rhs = -value(stage.offset, i, 0);
+        for (size_t j = 0; j < nx; j++) {
+          Scalar a = entry(stage.state_transition, i, j);
+          if (k == 0) {
+            rhs -= a * x0[j];
+          } else {
+            add(row, state_col(k) + j, a);
+          }
+        }
+        for (size_t j = 0; j < nu; j++) {
+          add(row, input_col(k) + j, entry(stage.input_matrix, i, j));
+        }
+        add(row, state_col(k + 1) + i, -1);
+        problem.row_lower.push_back(rhs);
+        problem.row_upper.push_back(rhs);
+      }
+    }
+    size_t row = horizon * nx;
+    for (size_t k = 0; k <= horizon; k++) {
+      auto const &stage = this->stages[k];
+      bool terminal = k == horizon;
+      // Costs
+      for (size_t i = 0; i < nx; i++) {
+        Scalar gradient = value(stage.state_gradient, i, 0);
+        if (k == 0) {
+          problem.objective_offset += gradient * x0[i];
+          for (size_t j = 0; j < nx; j++) {
+            problem.objective_offset +=
+                entry(stage.state_cost, i, j) * x0[i] * x0[j] / 2;
+          }
+          continue;
+        }
+        problem.objective[state_col(k) + i] = gradient;
+        for (size_t j = 0; j < nx; j++) {
+          add_hessian(state_col(k) + i, state_col(k) + j,
+                      entry(stage.state_cost, i, j));
+        }
+      }
+      if (!terminal) {
+        for (size_t i = 0; i < nu; i++) {
+          Scalar gradient = value(stage.input_gradient, i, 0);
+          for (size_t j = 0; j < nu; j++) {
+            add_hessian(input_col(k) + i, input_col(k) + j,
+                        entry(stage.input_cost, i, j));
+          }
+          for (size_t j = 0; j < nx; j++) {
+            Scalar s = entry(stage.cross_cost, i, j);
+            if (k == 0) {
+              gradient += s * x0[j];
+            } else {
+              // x_k comes before u_k in the ordering
+              add_hessian(state_col(k) + j, input_col(k) + i, s);
+            }
+          }
+          problem.objective[input_col(k) + i] = gradient;
+          problem.col_lower[input_col(k) + i] =
+              value(stage.input_lower, i, -inf);
+          problem.col_upper[input_col(k) + i] =
+              value(stage.input_upper, i, inf);
+        }
+      }
+      if (k > 0) {
+        for (size_t i = 0; i < nx; i++) {
+          problem.col_lower[state_col(k) + i] =
+              value(stage.state_lower, i, -inf);
+          problem.col_upper[state_col(k) + i] =
+              value(stage.state_upper, i, inf);
+        }
+      }
+      // General constraints
+      for (size_t g = 0; g < stage.constraint_lower.size(); g++) {
+        Scalar shift = 0;
+        for (size_t j = 0; j < nx; j++) {
+          Scalar coefficient = entry(stage.constraint_state, g, j);
+          if (k == 0) {
+            shift += coefficient * x0[j];
+          } else {
+            add(row, state_col(k) + j, coefficient);
+          }
+        }
+        if (!terminal) {
+          for (size_t j = 0; j < nu; j++) {
+            add(row, input_col(k) + j, entry(stage.constraint_input, g, j));
+          }
+        }
+        problem.row_lower.push_back(stage.constraint_lower[g] - shift);
+        problem.row_upper.push_back(stage.constraint_upper[g] - shift);
+        row++;
+      }
+    }
+    problem.constraints = teensymat::SparseMatrix<Scalar>::from_triplets(
+        row, n, rows, cols, vals);
+    problem.hessian = teensymat::SparseMatrix<Scalar>::from_triplets(
+        n, n, h_rows, h_cols, h_vals);
+    return problem;
+  }
+};
+
+/*! How MPCSolver solves its Newton systems*/
+enum class MPCForm {
+  /*! The condensed form when its estimated cost is lower, Riccati
+   * otherwise*/
+  automatic,
+  /*! Riccati recursion over the stages, O(N (nx + nu)^3)*/
+  riccati,
+  /*! Eliminate the states and factor the dense Hessian of the inputs,
+   * O((N nu)^3), which pays off for short horizons*/
+  condensed,
+};
+
+/*! Options of MPCSolver*/
+template <typename Scalar> struct MPCOptions {
+  /*! Maximum number of iterations*/
+  size_t max_iterations = 50;
+  /*! Residuals and complementarity of a solution, relative to the size of
+   * the data*/
+  Scalar tolerance = 1e-8;
+  /*! Fraction of the step to the boundary taken*/
+  Scalar step_factor = 0.995;
+  /*! Added to the diagonals of Q and R, so that singular costs of bounded
+   * variables can still be factored*/
+  Scalar regularization = 1e-10;
+  /*! The linear system solved at each iteration*/
+  MPCForm form = MPCForm::automatic;
+};
+
+/*! Solution of an MPCProblem*/
+template <typename Scalar> struct MPCSolution {
+  /*! Outcome of the solve*/
+  LPStatus status = LPStatus::numerical_error;
+  /*! Objective value*/
+  Scalar objective = 0;
+  /*! States x_0, ..., x_N*/
+  std::vector<std::vector<Scalar>> states;
+  /*! Inputs u_0, ..., u_{N-1}*/
+  std::vector<std::vector<Scalar>> inputs;
+  /*! Multipliers lambda_1, ..., lambda_N of the dynamics, such that
+   * lambda_{k+1} is the gradient of the optimal cost to go at x_{k+1}*/
+  std::vector<std::vector<Scalar>> costates;
+  /*! Number of iterations performed*/
+  size_t iterations = 0;
+};
+
+namespace mpc_detail {
+/*! The size D if it is fixed at compile time (nonzero), else the runtime
+ * size*/
+template <size_t D> constexpr size_t extent(size_t runtime) {
+  return D == 0 ? runtime : D;
+}
+/*! C (m by n) += alpha * A (m by k) * B (k by n), contiguous row major.
+ * Fixed sizes M, N, K (nonzero) let the compiler unroll the loops.*/
+template <size_t M, size_t N, size_t K, typename Scalar>
+void gemm_nn(size_t m_runtime, size_t n_runtime, size_t k_runtime,
+             Scalar alpha, Scalar const *a, Scalar const *b, Scalar *c) {
+  size_t const m = extent<M>(m_runtime);
+  size_t const n = extent<N>(n_runtime);
+  size_t const k = extent<K>(k_runtime);
+  for (size_t i = 0; i < m; i++) {
+    for (size_t p = 0; p < k; p++) {
+      Scalar a_ip = alpha * a[i * k + p];
+      for (size_t j = 0; j < n; j++) {
+        c[i * n + j] += a_ip * b[p * n + j];
+      }
+    }
+  }
+}
+/*! C (m by n) += alpha * A^T * B with A (k by m) and B (k by n)*/
+template <size_t M, size_t N, size_t K, typename Scalar>
+void gemm_tn(size_t m_runtime, size_t n_runtime, size_t k_runtime,
+             Scalar alpha, Scalar const *a, Scalar const *b, Scalar *c) {
+  size_t const m = extent<M>(m_runtime);
+  size_t const n = extent<N>(n_runtime);
+  size_t const k = extent<K>(k_runtime);
+  for (size_t p = 0; p < k; p++) {
+    for (size_t i = 0; i < m; i++) {
+      Scalar a_pi = alpha * a[p * m + i];
+      for (size_t j = 0; j < n; j++) {
+        c[i * n + j] += a_pi * b[p * n + j];
+      }
+    }
+  }
+}
+/*! y (length m) += alpha * A x for A (m by n)*/
+template <size_t M, size_t N, typename Scalar>
+void gemv_n(size_t m_runtime, size_t n_runtime, Scalar alpha,
+            Scalar const *a, Scalar const *x, Scalar *y) {
+  size_t const m = extent<M>(m_runtime);
+  size_t const n = extent<N>(n_runtime);
+  for (size_t i = 0; i < m; i++) {
+    Scalar sum = 0;
+    for (size_t j = 0; j < n; j++) {
+      sum += a[i * n + j] * x[j];
+    }
+    y[i] += alpha * sum;
+  }
+}
+/*! y (length n) += alpha * A^T x for A (m by n)*/
+template <size_t M, size_t N, typename Scalar>
+void gemv_t(size_t m_runtime, size_t n_runtime, Scalar alpha,
+            Scalar const *a, Scalar const *x, Scalar *y) {
+  size_t const m = extent<M>(m_runtime);
+  size_t const n = extent<N>(n_runtime);
+  for (size_t i = 0; i < m; i++) {
+    Scalar scaled = alpha * x[i];
+    for (size_t j = 0; j < n; j++) {
+      y[j] += a[i * n + j] * scaled;
+    }
+  }
+}
+/*! Make a square matrix symmetric by averaging it with its transpose*/
+template <size_t N, typename Scalar>
+void symmetrize(size_t n_runtime, Scalar *a) {
+  size_t const n = extent<N>(n_runtime);
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < i; j++) {
+      Scalar mean = (a[i * n + j] + a[j * n + i]) / 2;
+      a[i * n + j] = mean;
+      a[j * n + i] = mean;
+    }
+  }
+}
+/*! Cholesky factorization in place (L in the lower triangle of a).
+ *
+ * @return Whether the matrix is positive definite
+ * */
+template <typename Scalar> bool cholesky(size_t n, Scalar *a) {
+  for (size_t i = 0; i < n; i++) {
+    Scalar *row_i = a + i * n;
+    for (size_t j = 0; j < i; j++) {
+      Scalar *row_j = a + j * n;
+      row_i[j] = (row_i[j] - teensymat::dot(j, row_i, row_j)) / row_j[j];
+    }
+    Scalar diagonal = row_i[i] - teensymat::dot(i, row_i, row_i);
+    if (!(diagonal > 0)) {
+      return false;
+    }
+    row_i[i] = std::sqrt(diagonal);
+  }
+  return true;
+}
+/*! Solve L L^T X = B in place for B with ncols columns (row major, n by
+ * ncols), given L from cholesky*/
+template <typename Scalar>
+void cholesky_solve(size_t n, Scalar const *l, size_t ncols, Scalar *b) {
+  for (size_t i = 0; i < n; i++) {
+    Scalar *row = b + i * ncols;
+    for (size_t j = 0; j < i; j++) {
+      teensymat::axpy(ncols, -l[i * n + j], b + j * ncols, row);
+    }
+    teensymat::scal(ncols, 1 / l[i * n + i], row);
+  }
+  for (size_t i = n; i-- > 0;) {
+    Scalar *row = b + i * ncols;
+    for (size_t j = i + 1; j < n; j++) {
+      teensymat::axpy(ncols, -l[j * n + i], b + j * ncols, row);
+    }
+    teensymat::scal(ncols, 1 / l[i * n + i], row);
+  }
+}
+} // namespace mpc_detail
+
+/*! Primal-dual interior point method for MPCProblem which keeps the stage
+ * structure.
+ *
+ * Every finite side of a bound or general constraint gets a slack and a
+ * dual. Eliminating them from the Newton system leaves an equality
+ * constrained LQ problem over the horizon, with the barrier terms added
+ * to the stage costs. It is solved by Riccati recursion (MPCForm): a
+ * backward pass computes the cost to go x^T P_k x / 2 + p_k^T x and the
+ * feedback u = K_k x + k_k from Cholesky factors of the input Hessians,
+ * and a forward pass rolls the dynamics out. The factorization pass runs
+ * once per iteration and serves both Mehrotra's predictor and corrector.
+ * For state dimensions up to 8 the stage kernels are compiled for the
+ * fixed size.
+ *
+ * The condensed form instead writes the states in terms of the inputs
+ * and factors the dense (N nu by N nu) Hessian of the inputs, which is
+ * cheaper when N nu is small.
+ *
+ * All work arrays are allocated at construction, so solve only allocates
+ * its MPCSolution. A problem whose input Hessian is not positive definite
+ * (after the barrier terms and the regularization) ends with
+ * LPStatus::numerical_error, and one whose duals diverge is reported
+ * infeasible.
+ * */
+template <typename Scalar> class MPCSolver {
+  /*! Largest fixed state dimension of the kernels*/
+  static constexpr size_t max_fixed_dim = 8;
+  /*! Dual size marking divergence (relative to the size of the data)*/
+  static constexpr double divergence = 1e12;
+
+  /*! The problem*/
+  MPCProblem<Scalar> problem;
+  /*! Options of the solve*/
+  MPCOptions<Scalar> options;
+  /*! Dimensions: horizon, state, input*/
+  size_t horizon, nx, nu;
+  /*! The form of the Newton systems*/
+  MPCForm form;
+  /*! Stage data, contiguous per stage: A, B, c (N stages), Q, q (N + 1),
+   * R, S, r (N)*/
+  std::vector<Scalar> a, b, c, q_matrix, q_vector, r_matrix, s_matrix,
+      r_vector;
+  /*! Constraint rows of each stage: the nx state bounds, the nu input
+   * bounds (none at the terminal stage) and the general constraints, in
+   * this order. row_offset[k] is the first row of stage k.*/
+  std::vector<size_t> row_offset;
+  /*! General constraint matrices C and D, by row*/
+  std::vector<Scalar> c_matrix, d_matrix;
+  /*! Bounds of each row (infinite for missing sides, and for the state
+   * bounds of x_0)*/
+  std::vector<Scalar> lower, upper;
+  /*! Size of the data, for relative tolerances*/
+  Scalar data_scale;
+  /*! The iterate: states (x_0 fixed), inputs and costates (lambda_0
+   * unused)*/
+  std::vector<Scalar> x, u, lambda;
+  /*! Slacks and duals of the lower and upper sides of each row (zero for
+   * missing sides)*/
+  std::vector<Scalar> s_lower, s_upper, z_lower, z_upper;
+  /*! Residuals: stationarity (x and u parts), dynamics, and primal
+   * residuals of the rows*/
+  std::vector<Scalar> rd_x, rd_u, dynamics, rp_lower, rp_upper;
+  /*! Row activities, and complementarity targets of the Newton system*/
+  std::vector<Scalar> activity, rc_lower, rc_upper;
+  /*! Stage Hessians with the barrier terms, and LQ gradients*/
+  std::vector<Scalar> qt, rt, st, gx, gu;
+  /*! Riccati factors: P, p (N + 1 stages), H_ux, Cholesky factor of
+   * H_uu, K, k (N stages), and temporaries*/
+  std::vector<Scalar> p_matrix, p_vector, h_ux, l_uu, gain, feedforward,
+      work_f, work_g, work_v;
+  /*! Condensed form: states in terms of inputs (Gamma, N nx by N nu),
+   * the dense Hessian and its temporaries*/
+  std::vector<Scalar> gamma, hessian, work_t, condensed_rhs, free_states;
+  /*! The direction (states, inputs, costates, slacks and duals) and the
+   * affine direction's products for Mehrotra's corrector*/
+  std::vector<Scalar> dx, du, dlambda, ds_lower, ds_upper, dz_lower,
+      dz_upper;
+  /*! Number of finite sides*/
+  size_t num_sides;
+  /*! Number of iterations performed by the last solve*/
+  size_t iterations;
+
+  // SECTION: Setup
+  /*! Copy a stage matrix (empty meaning zero) into contiguous storage*/
+  static void copy_matrix(teensymat::Matrix<Scalar> const &matrix,
+                          size_t nrows, size_t ncols, Scalar *out) {
+    if (matrix.get_nrows() == 0) {
+      std::fill(out, out + nrows * ncols, Scalar{0});
+      return;
+    }
+    for (size_t i = 0; i < nrows; i++) {
+      for (size_t j = 0; j < ncols; j++) {
+        out[i * ncols + j] = *matrix(i, j);
+      }
+    }
+  }
+  /*! Copy a stage vector (empty meaning the given value)*/
+  static void copy_vector(std::vector<Scalar> const &vector, size_t size,
+                          Scalar missing, Scalar *out) {
+    for (size_t i = 0; i < size; i++) {
+      out[i] = vector.empty() ? missing : vector[i];
+    }
+  }
+  /*! Copy the problem into the stage arrays and allocate the workspace*/
+  void setup() {
+    size_t n = this->horizon;
+    size_t nx = this->nx;
+    size_t nu = this->nu;
+    Scalar inf = infinity<Scalar>;
+    this->a.resize(n * nx * nx);
+    this->b.resize(n * nx * nu);
+    this->c.resize(n * nx);
+    this->q_matrix.resize((n + 1) * nx * nx);
+    this->q_vector.resize((n + 1) * nx);
+    this->r_matrix.resize(n * nu * nu);
+    this->s_matrix.resize(n * nu * nx);
+    this->r_vector.resize(n * nu);
+    this->row_offset.assign(n + 2, 0);
+    for (size_t k = 0; k <= n; k++) {
+      size_t rows =
+          nx + (k < n ? nu : 0) + this->problem.get_num_constraints(k);
+      this->row_offset[k + 1] = this->row_offset[k] + rows;
+    }
+    size_t total = this->row_offset[n + 1];
+    this->lower.resize(total);
+    this->upper.resize(total);
+    this->c_matrix.clear();
+    this->d_matrix.clear();
+    Scalar scale = 0;
+    auto grow = [&scale](Scalar const *begin, Scalar const *end) {
+      for (; begin != end; begin++) {
+        if (std::isfinite(*begin)) {
+          scale = std::max(scale, std::abs(*begin));
+        }
+      }
+    };
+    for (size_t k = 0; k <= n; k++) {
+      auto const &stage = this->problem.stages[k];
+      copy_matrix(stage.state_cost, nx, nx, &this->q_matrix[k * nx * nx]);
+      copy_vector(stage.state_gradient, nx, 0, &this->q_vector[k * nx]);
+      grow(&this->q_vector[k * nx], &this->q_vector[k * nx] + nx);
+      Scalar *low = &this->lower[this->row_offset[k]];
+      Scalar *high = &this->upper[this->row_offset[k]];
+      copy_vector(stage.state_lower, nx, -inf, low);
+      copy_vector(stage.state_upper, nx, inf, high);
+      if (k == 0) {
+        // x_0 is fixed
+        std::fill(low, low + nx, -inf);
+        std::fill(high, high + nx, inf);
+      }
+      if (k < n) {
+        copy_matrix(stage.state_transition, nx, nx, &this->a[k * nx * nx]);
+        copy_matrix(stage.input_matrix, nx, nu, &this->b[k * nx * nu]);
+        copy_vector(stage.offset, nx, 0, &this->c[k * nx]);
+        copy_matrix(stage.input_cost, nu, nu, &this->r_matrix[k * nu * nu]);
+        copy_matrix(stage.cross_cost, nu, nx, &this->s_matrix[k * nu * nx]);
+        copy_vector(stage.input_gradient, nu, 0, &this->r_vector[k * nu]);
+        copy_vector(stage.input_lower, nu, -inf, low + nx);
+        copy_vector(stage.input_upper, nu, inf, high + nx);
+        grow(&this->c[k * nx], &this->c[k * nx] + nx);
+        grow(&this->r_vector[k * nu], &this->r_vector[k * nu] + nu);
+      }
+      size_t ng = this->problem.get_num_constraints(k);
+      size_t first = nx + (k < n ? nu : 0);
+      std::vector<Scalar> block(ng * std::max(nx, nu));
+      copy_matrix(stage.constraint_state, ng, nx, block.data());
+      this->c_matrix.insert(this->c_matrix.end(), block.begin(),
+                            block.begin() + ng * nx);
+      if (k < n) {
+        copy_matrix(stage.constraint_input, ng, nu, block.data());
+      } else {
+        std::fill(block.begin(), block.end(), Scalar{0});
+      }
+      this->d_matrix.insert(this->d_matrix.end(), block.begin(),
+                            block.begin() + ng * nu);
+      std::copy(stage.constraint_lower.begin(), stage.constraint_lower.end(),
+                low + first);
+      std::copy(stage.constraint_upper.begin(), stage.constraint_upper.end(),
+                high + first);
+    }
+    grow(this->lower.data(), this->lower.data() + total);
+    grow(this->upper.data(), this->upper.data() + total);
+    grow(this->problem.initial_state.data(),
+         this->problem.initial_state.data() + nx);
+    this->data_scale = 1 + scale;
+    this->num_sides = 0;
+    for (size_t i = 0; i < total; i++) {
+      this->num_sides += std::isfinite(this->lower[i]);
+      this->num_sides += std::isfinite(this->upper[i]);
+    }
+    // Iterate and workspace
+    for (auto *vector : {&this->x, &this->lambda, &this->rd_x, &this->gx,
+                         &this->p_vector, &this->dx, &this->dlambda}) {
+      vector->assign((n + 1) * nx, 0);
+    }
+    for (auto *vector : {&this->u, &this->rd_u, &this->gu,
+                         &this->feedforward, &this->du}) {
+      vector->assign(n * nu, 0);
+    }
+    this->dynamics.assign(n * nx, 0);
+    for (auto *vector :
+         {&this->s_lower, &this->s_upper, &this->z_lower, &this->z_upper,
+          &this->rp_lower, &this->rp_upper, &this->activity, &this->rc_lower,
+          &this->rc_upper, &this->ds_lower, &this->ds_upper, &this->dz_lower,
+          &this->dz_upper}) {
+      vector->assign(total, 0);
+    }
+    this->qt.assign((n + 1) * nx * nx, 0);
+    this->p_matrix.assign((n + 1) * nx * nx, 0);
+    this->rt.assign(n * nu * nu, 0);
+    this->l_uu.assign(n * nu * nu, 0);
+    this->st.assign(n * nu * nx, 0);
+    this->h_ux.assign(n * nu * nx, 0);
+    this->gain.assign(n * nu * nx, 0);
+    this->work_f.assign(nx * nx, 0);
+    this->work_g.assign(nx * nu, 0);
+    this->work_v.assign(nx, 0);
+    if (this->form == MPCForm::condensed) {
+      this->setup_condensed();
+    }
+  }
+  /*! Choose the form from estimated operation counts*/
+  MPCForm choose_form() const {
+    if (this->options.form != MPCForm::automatic) {
+      return this->options.form;
+    }
+    double n = static_cast<double>(this->horizon);
+    double nx = static_cast<double>(this->nx);
+    double nu = static_cast<double>(this->nu);
+    double riccati = n * (2 * nx * nx * nx + 3 * nx * nx * nu +
+                          2 * nx * nu * nu + nu * nu * nu / 3);
+    double condensed = n * n * nx * nx * nu / 2 +
+                       n * n * n * (nu * nu * nx / 3 + nu * nu * nu / 3);
+    return condensed < riccati ? MPCForm::condensed : MPCForm::riccati;
+  }
+  /*! Compute Gamma, whose block (k, j) = A_{k-1} ... A_{j+1} B_j maps u_j
+   * to x_k (row block k - 1 holds x_k)*/
+  void setup_condensed() {
+    size_t n = this->horizon;
+    size_t nx = this->nx;
+    size_t nu = this->nu;
+    size_t width = n * nu;
+    this->gamma.assign(n * nx * width, 0);
+    for (size_t k = 1; k <= n; k++) {
+      Scalar *block_row = &this->gamma[(k - 1) * nx * width];
+      // Block (k, k - 1) is B_{k-1}
+      for (size_t i = 0; i < nx; i++) {
+        std::copy(&this->b[(k - 1) * nx * nu + i * nu],
+                  &this->b[(k - 1) * nx * nu + i * nu] + nu,
+                  block_row + i * width + (k - 1) * nu);
+      }
+      if (k == 1) {
+        continue;
+      }
+      // Blocks (k, j < k - 1) are A_{k-1} times those of x_{k-1}
+      Scalar const *previous = &this->gamma[(k - 2) * nx * width];
+      Scalar const *transition = &this->a[(k - 1) * nx * nx];
+      for (size_t i = 0; i < nx; i++) {
+        for (size_t p = 0; p < nx; p++) {
+          Scalar coefficient = transition[i * nx + p];
+          for (size_t j = 0; j < (k - 1) * nu; j++) {
+            block_row[i * width + j] += coefficient * previous[p * width + j];
+          }
+        }
+      }
+    }
+    this->hessian.assign(width * width, 0);
+    this->work_t.assign(nx * width, 0);
+    this->condensed_rhs.assign(width, 0);
+    this->free_states.assign((n + 1) * nx, 0);
+  }
+
+  // SECTION: Rows
+  /*! Compute the activities G v of the rows of a stage from states and
+   * inputs*/
+  void row_activities(Scalar const *states, Scalar const *inputs,
+                      Scalar *result) const {
+    size_t n = this->horizon;
+    size_t nx = this->nx;
+    size_t nu = this->nu;
+    size_t general = 0;
+    for (size_t k = 0; k <= n; k++) {
+      Scalar const *xk = states + k * nx;
+      Scalar const *uk = inputs + k * nu;
+      Scalar *out = result + this->row_offset[k];
+      std::copy(xk, xk + nx, out);
+      size_t first = nx;
+      if (k < n) {
+        std::copy(uk, uk + nu, out + nx);
+        first += nu;
+      }
+      size_t ng = this->row_offset[k + 1] - this->row_offset[k] - first;
+      for (size_t g = 0; g < ng; g++) {
+        Scalar value = teensymat::dot(nx, &this->c_matrix[general * nx], xk);
+        if (k < n) {
+          value += teensymat::dot(nu, &this->d_matrix[general * nu], uk);
+        }
+        out[first + g] = value;
+        general++;
+      }
+    }
+  }
+  /*! Add alpha * G^T w to the state and input parts of a gradient*/
+  void add_row_transpose(Scalar alpha, Scalar const *w, Scalar *states,
+                         Scalar *inputs) const {
+    size_t n = this->horizon;
+    size_t nx = this->nx;
+    size_t nu = this->nu;
+    size_t general = 0;
+    for (size_t k = 0; k <= n; k++) {
+      Scalar const *wk = w + this->row_offset[k];
+      Scalar *xk = states + k * nx;
+      Scalar *uk = inputs + k * nu;
+      teensymat::axpy(nx, alpha, wk, xk);
+      size_t first = nx;
+      if (k < n) {
+        teensymat::axpy(nu, alpha, wk + nx, uk);
+        first += nu;
+      }
+      size_t ng = this->row_offset[k + 1] - this->row_offset[k] - first;
+      for (size_t g = 0; g < ng; g++) {
+        Scalar weight = alpha * wk[first + g];
+        teensymat::axpy(nx, weight, &this->c_matrix[general * nx], xk);
+        if (k < n) {
+          teensymat::axpy(nu, weight, &this->d_matrix[general * nu], uk);
+        }
+        general++;
+      }
+    }
+  }
+  /*! Whether a side of a row is present*/
+  bool has_lower(size_t i) const { return std::isfinite(this->lower[i]); }
+  bool has_upper(size_t i) const { return std::isfinite(this->upper[i]); }
+
+  // SECTION: Residuals
+  /*! Compute the residuals of the current iterate, returning the largest
+   * of them and the complementarity mu*/
+  std::pair<Scalar, Scalar> residuals() {
+    size_t n = this->horizon;
+    size_t nx = this->nx;
+    size_t nu = this->nu;
+    size_t total = this->row_offset[n + 1];
+    Scalar largest = 0;
+    // Primal residuals of the rows
+    this->row_activities(this->x.data(), this->u.data(),
+                         this->activity.data());
+    Scalar complementarity = 0;
+    for (size_t i = 0; i < total; i++) {
+      this->rp_lower[i] = 0;
+      this->rp_upper[i] = 0;
+      if (this->has_lower(i)) {
+        this->rp_lower[i] = this->activity[i] - this->lower[i] -
+                            this->s_lower[i];
+        largest = std::max(largest, std::abs(this->rp_lower[i]));
+        complementarity += this->s_lower[i] * this->z_lower[i];
+      }
+      if (this->has_upper(i)) {
+        this->rp_upper[i] = this->upper[i] - this->activity[i] -
+                            this->s_upper[i];
+        largest = std::max(largest, std::abs(this->rp_upper[i]));
+        complementarity += this->s_upper[i] * this->z_upper[i];
+      }
+      // The row dual z_lower - z_upper, kept in rc_lower for now
+      this->rc_lower[i] = this->z_lower[i] - this->z_upper[i];
+    }
+    // Stationarity
+    std::fill(this->rd_x.begin(), this->rd_x.end(), Scalar{0});
+    std::fill(this->rd_u.begin(), this->rd_u.end(), Scalar{0});
+    this->add_row_transpose(-1, this->rc_lower.data(), this->rd_x.data(),
+                            this->rd_u.data());
+    for (size_t k = 0; k <= n; k++) {
+      Scalar *rx = &this->rd_x[k * nx];
+      Scalar const *xk = &this->x[k * nx];
+      teensymat::axpy(nx, Scalar{1}, &this->q_vector[k * nx], rx);
+      mpc_detail::gemv_n<0, 0>(nx, nx, Scalar{1}, &this->q_matrix[k * nx * nx],
+                               xk, rx);
+      teensymat::axpy(nx, Scalar{-1}, &this->lambda[k * nx], rx);
+      if (k == n) {
+        continue;
+      }
+      Scalar *ru = &this->rd_u[k * nu];
+      Scalar const *uk = &this->u[k * nu];
+      Scalar const *next = &this->lambda[(k + 1) * nx];
+      mpc_detail::gemv_t<0, 0>(nu, nx, Scalar{1},
+                               &this->s_matrix[k * nu * nx], uk, rx);
+      mpc_detail::gemv_t<0, 0>(nx, nx, Scalar{1}, &this->a[k * nx * nx], next,
+                               rx);
+      teensymat::axpy(nu, Scalar{1}, &this->r_vector[k * nu], ru);
+      mpc_detail::gemv_n<0, 0>(nu, nu, Scalar{1},
+                               &this->r_matrix[k * nu * nu], uk, ru);
+      mpc_detail::gemv_n<0, 0>(nu, nx, Scalar{1},
+                               &this->s_matrix[k * nu * nx], xk, ru);
+      mpc_detail::gemv_t<0, 0>(nx, nu, Scalar{1}, &this->b[k * nx * nu], next,
+                               ru);
+      // Dynamics A x + B u + c - x_next
+      Scalar *e = &this->dynamics[k * nx];
+      std::copy(&this->c[k * nx], &this->c[k * nx] + nx, e);
+      mpc_detail::gemv_n<0, 0>(nx, nx, Scalar{1}, &this->a[k * nx * nx], xk,
+                               e);
+      mpc_detail::gemv_n<0, 0>(nx, nu, Scalar{1}, &this->b[k * nx * nu], uk,
+                               e);
+      teensymat::axpy(nx, Scalar{-1}, &this->x[(k + 1) * nx], e);
+      for (size_t i = 0; i < nx; i++) {
+        largest = std::max(largest, std::abs(e[i]));
+      }
+    }
+    // x_0 is fixed, so its stationarity is not a condition
+    std::fill(this->rd_x.begin(), this->rd_x.begin() + nx, Scalar{0});
+    for (Scalar value : this->rd_x) {
+      largest = std::max(largest, std::abs(value));
+    }
+    for (Scalar value : this->rd_u) {
+      largest = std::max(largest, std::abs(value));
+    }
+    Scalar mu = this->num_sides == 0
+                    ? Scalar{0}
+                    : complementarity / static_cast<Scalar>(this->num_sides);
+    return {largest, mu};
+  }
+
+  // SECTION: Newton systems
+  /*! Stage Hessians with the barrier terms G^T W G, W = z / s*/
+  void barrier_hessians() {
+    size_t n = this->horizon;
+    size_t nx = this->nx;
+    size_t nu = this->nu;
+    Scalar delta = this->options.regularization;
+    std::copy(this->q_matrix.begin(), this->q_matrix.end(), this->qt.begin());
+    std::copy(this->r_matrix.begin(), this->r_matrix.end(), this->rt.begin());
+    std::copy(this->s_matrix.begin(), this->s_matrix.end(), this->st.begin());
+    size_t general = 0;
+    for (size_t k = 0; k <= n; k++) {
+      Scalar *qk = &this->qt[k * nx * nx];
+      Scalar *rk = k < n ? &this->rt[k * nu * nu] : nullptr;
+      Scalar *sk = k < n ? &this->st[k * nu * nx] : nullptr;
+      size_t offset = this->row_offset[k];
+      auto weight = [&](size_t i) {
+        Scalar w = 0;
+        if (this->has_lower(i)) {
+          w += this->z_lower[i] / this->s_lower[i];
+        }
+        if (this->has_upper(i)) {
+          w += this->z_upper[i] / this->s_upper[i];
+        }
+        return w;
+      };
+      for (size_t i = 0; i < nx; i++) {
+        qk[i * nx + i] += delta + weight(offset + i);
+      }
+      size_t first = nx;
+      if (k < n) {
+        for (size_t i = 0; i < nu; i++) {
+          rk[i * nu + i] += delta + weight(offset + nx + i);
+        }
+        first += nu;
+      }
+      size_t ng = this->row_offset[k + 1] - offset - first;
+      for (size_t g = 0; g < ng; g++) {
+        Scalar w = weight(offset + first + g);
+        Scalar const *cg = &this->c_matrix[general * nx];
+        Scalar const *dg = &this->d_matrix[general * nu];
+        general++;
+        if (w == Scalar{0}) {
+          continue;
+        }
+        // Rank one terms w [C; D]^T [C; D]
+        for (size_t i = 0; i < nx; i++) {
+          teensymat::axpy(nx, w * cg[i], cg, qk + i * nx);
+        }
+        if (k < n) {
+          for (size_t i = 0; i < nu; i++) {
+            teensymat::axpy(nu, w * dg[i], dg, rk + i * nu);
+            teensymat::axpy(nx, w * dg[i], cg, sk + i * nx);
+          }
+        }
+      }
+    }
+  }
+  /*! Gradients of the LQ problem for complementarity targets rc_lower and
+   * rc_upper: rd - G^T ((rc_l - z_l rp_l) / s_l - (rc_u - z_u rp_u) / s_u)
+   * (uses activity as workspace)*/
+  void lq_gradients() {
+    size_t total = this->row_offset[this->horizon + 1];
+    for (size_t i = 0; i < total; i++) {
+      Scalar w = 0;
+      if (this->has_lower(i)) {
+        w += (this->rc_lower[i] - this->z_lower[i] * this->rp_lower[i]) /
+             this->s_lower[i];
+      }
+      if (this->has_upper(i)) {
+        w -= (this->rc_upper[i] - this->z_upper[i] * this->rp_upper[i]) /
+             this->s_upper[i];
+      }
+      this->activity[i] = w;
+    }
+    std::copy(this->rd_x.begin(), this->rd_x.end(), this->gx.begin());
+    std::copy(this->rd_u.begin(), this->rd_u.end(), this->gu.begin());
+    this->add_row_transpose(-1, this->activity.data(), this->gx.data(),
+                            this->gu.data());
+  }
+  /*! Call function with the state dimension as a compile time constant
+   * (zero for dimensions above max_fixed_dim)*/
+  template <typename Function> decltype(auto) with_state_dim(Function &&f) {
+    switch (this->nx) {
+    case 1:
+      return f(std::integral_constant<size_t, 1>{});
+    case 2:
+      return f(std::integral_constant<size_t, 2>{});
+    case 3:
+      return f(std::integral_constant<size_t, 3>{});
+    case 4:
+      return f(std::integral_constant<size_t, 4>{});
+    case 5:
+      return f(std::integral_constant<size_t, 5>{});
+    case 6:
+      return f(std::integral_constant<size_t, 6>{});
+    case 7:
+      return f(std::integral_constant<size_t, 7>{});
+    case 8:
+      return f(std::integral_constant<size_t, max_fixed_dim>{});
+    default:
+      return f(std::integral_constant<size_t, 0>{});
+    }
+  }
+  /*! Backward Riccati factorization: P_k, H_ux, the Cholesky factor of
+   * H_uu and K_k of every stage
+   *
+   * @return Whether every H_uu was positive definite
+   * */
+  template <size_t NX> bool factor_riccati() {
+    size_t n = this->horizon;
+    size_t nx = this->nx;
+    size_t nu = this->nu;
+    size_t const nxx = nx * nx;
+    std::copy(&this->qt[n * nxx], &this->qt[n * nxx] + nxx,
+              &this->p_matrix[n * nxx]);
+    for (size_t k = n; k-- > 0;) {
+      Scalar const *p = &this->p_matrix[(k + 1) * nxx];
+      Scalar const *ak = &this->a[k * nxx];
+      Scalar const *bk = &this->b[k * nx * nu];
+      Scalar *f = this->work_f.data();
+      Scalar *g = this->work_g.data();
+      Scalar *hux = &this->h_ux[k * nu * nx];
+      Scalar *luu = &this->l_uu[k * nu * nu];
+      Scalar *gain = &this->gain[k * nu * nx];
+      // F = P A, G = P B
+      std::fill(f, f + nxx, Scalar{0});
+      std::fill(g, g + nx * nu, Scalar{0});
+      mpc_detail::gemm_nn<NX, NX, NX>(nx, nx, nx, Scalar{1}, p, ak, f);
+      mpc_detail::gemm_nn<NX, 0, NX>(nx, nu, nx, Scalar{1}, p, bk, g);
+      // H_ux = S + B^T F, H_uu = R + B^T G
+      std::copy(&this->st[k * nu * nx], &this->st[k * nu * nx] + nu * nx,
+                hux);
+      mpc_detail::gemm_tn<0, NX, NX>(nu, nx, nx, Scalar{1}, bk, f, hux);
+      std::copy(&this->rt[k * nu * nu], &this->rt[k * nu * nu] + nu * nu,
+                luu);
+      mpc_detail::gemm_tn<0, 0, NX>(nu, nu, nx, Scalar{1}, bk, g, luu);
+      if (!mpc_detail::cholesky(nu, luu)) {
+        return false;
+      }
+      // K = -H_uu^-1 H_ux
+      for (size_t i = 0; i < nu * nx; i++) {
+        gain[i] = -hux[i];
+      }
+      mpc_detail::cholesky_solve(nu, luu, nx, gain);
+      if (k == 0) {
+        break;
+      }
+      // P_k = Q + A^T F + H_ux^T K
+      Scalar *pk = &this->p_matrix[k * nxx];
+      std::copy(&this->qt[k * nxx], &this->qt[k * nxx] + nxx, pk);
+      mpc_detail::gemm_tn<NX, NX, NX>(nx, nx, nx, Scalar{1}, ak, f, pk);
+      mpc_detail::gemm_tn<NX, NX, 0>(nx, nx, nu, Scalar{1}, hux, gain, pk);
+      mpc_detail::symmetrize<NX>(nx, pk);
+    }
+    return true;
+  }
+  /*! Solve the LQ problem with gradients gx, gu and dynamics residuals
+   * from the Riccati factorization, giving dx, du and dlambda*/
+  template <size_t NX> void solve_riccati() {
+    size_t n = this->horizon;
+    size_t nx = this->nx;
+    size_t nu = this->nu;
+    size_t const nxx = nx * nx;
+    Scalar *pc = this->work_v.data();
+    std::copy(&this->gx[n * nx], &this->gx[n * nx] + nx,
+              &this->p_vector[n * nx]);
+    for (size_t k = n; k-- > 0;) {
+      Scalar const *e = &this->dynamics[k * nx];
+      // Pc = P_{k+1} e + p_{k+1}
+      std::copy(&this->p_vector[(k + 1) * nx],
+                &this->p_vector[(k + 1) * nx] + nx, pc);
+      mpc_detail::gemv_n<NX, NX>(nx, nx, Scalar{1},
+                                 &this->p_matrix[(k + 1) * nxx], e, pc);
+      // k_k = -H_uu^-1 (g_u + B^T Pc)
+      Scalar *kff = &this->feedforward[k * nu];
+      std::copy(&this->gu[k * nu], &this->gu[k * nu] + nu, kff);
+      mpc_detail::gemv_t<NX, 0>(nx, nu, Scalar{1}, &this->b[k * nx * nu], pc,
+                                kff);
+      teensymat::scal(nu, Scalar{-1}, kff);
+      mpc_detail::cholesky_solve(nu, &this->l_uu[k * nu * nu], 1, kff);
+      if (k == 0) {
+        break;
+      }
+      // p_k = g_x + A^T Pc + H_ux^T k_k
+      Scalar *pk = &this->p_vector[k * nx];
+      std::copy(&this->gx[k * nx], &this->gx[k * nx] + nx, pk);
+      mpc_detail::gemv_t<NX, NX>(nx, nx, Scalar{1}, &this->a[k * nxx], pc,
+                                 pk);
+      mpc_detail::gemv_t<0, NX>(nu, nx, Scalar{1}, &this->h_ux[k * nu * nx],
+                                kff, pk);
+    }
+    std::fill(this->dx.begin(), this->dx.begin() + nx, Scalar{0});
+    for (size_t k = 0; k < n; k++) {
+      Scalar const *dxk = &this->dx[k * nx];
+      Scalar *duk = &this->du[k * nu];
+      Scalar *next = &this->dx[(k + 1) * nx];
+      std::copy(&this->feedforward[k * nu], &this->feedforward[k * nu] + nu,
+                duk);
+      mpc_detail::gemv_n<0, NX>(nu, nx, Scalar{1}, &this->gain[k * nu * nx],
+                                dxk, duk);
+      std::copy(&this->dynamics[k * nx], &this->dynamics[k * nx] + nx, next);
+      mpc_detail::gemv_n<NX, NX>(nx, nx, Scalar{1}, &this->a[k * nxx], dxk,
+                                 next);
+      mpc_detail::gemv_n<NX, 0>(nx, nu, Scalar{1}, &this->b[k * nx * nu], duk,
+                                next);
+      Scalar *dl = &this->dlambda[(k + 1) * nx];
+      std::copy(&this->p_vector[(k + 1) * nx],
+                &this->p_vector[(k + 1) * nx] + nx, dl);
+      mpc_detail::gemv_n<NX, NX>(nx, nx, Scalar{1},
+                                 &this->p_matrix[(k + 1) * nxx], next, dl);
+    }
+  }
+  /*! Assemble and factor the condensed Hessian
+   *
+   *     R + S Gamma + Gamma^T S^T + Gamma^T Q Gamma
+   *
+   * @return Whether it was positive definite
+   * */
+  bool factor_condensed() {
+    size_t n = this->horizon;
+    size_t nx = this->nx;
+    size_t nu = this->nu;
+    size_t width = n * nu;
+    Scalar *h = this->hessian.data();
+    std::fill(this->hessian.begin(), this->hessian.end(), Scalar{0});
+    for (size_t k = 0; k < n; k++) {
+      for (size_t i = 0; i < nu; i++) {
+        std::copy(&this->rt[k * nu * nu + i * nu],
+                  &this->rt[k * nu * nu + i * nu] + nu,
+                  h + (k * nu + i) * width + k * nu);
+      }
+    }
+    for (size_t k = 1; k <= n; k++) {
+      Scalar const *block_row = &this->gamma[(k - 1) * nx * width];
+      size_t columns = k * nu;
+      // T = Q_k Gamma_k, then H += Gamma_k^T T (only the first k blocks of
+      // Gamma_k are nonzero)
+      Scalar *t = this->work_t.data();
+      for (size_t i = 0; i < nx; i++) {
+        std::fill(t + i * width, t + i * width + columns, Scalar{0});
+        for (size_t p = 0; p < nx; p++) {
+          teensymat::axpy(columns, this->qt[k * nx * nx + i * nx + p],
+                          block_row + p * width, t + i * width);
+        }
+      }
+      for (size_t p = 0; p < nx; p++) {
+        for (size_t i = 0; i < columns; i++) {
+          teensymat::axpy(columns, block_row[p * width + i], t + p * width,
+                          h + i * width);
+        }
+      }
+      if (k == n) {
+        continue;
+      }
+      // S_k Gamma_k in row block k, and its transpose in column block k
+      Scalar const *sk = &this->st[k * nu * nx];
+      for (size_t i = 0; i < nu; i++) {
+        for (size_t p = 0; p < nx; p++) {
+          Scalar coefficient = sk[i * nx + p];
+          for (size_t j = 0; j < columns; j++) {
+            Scalar value = coefficient * block_row[p * width + j];
+            h[(k * nu + i) * width + j] += value;
+            h[j * width + k * nu + i] += value;
+          }
+        }
+      }
+    }
+    return mpc_detail::cholesky(width, h);
+  }
+  /*! Solve the LQ problem through the condensed Hessian, giving dx, du and
+   * dlambda*/
+  void solve_condensed() {
+    size_t n = this->horizon;
+    size_t nx = this->nx;
+    size_t nu = this->nu;
+    size_t width = n * nu;
+    // States with zero inputs: xi_{k+1} = A xi_k + e_k, xi_0 = 0
+    Scalar *xi = this->free_states.data();
+    std::fill(xi, xi + nx, Scalar{0});
+    for (size_t k = 0; k < n; k++) {
+      Scalar *next = xi + (k + 1) * nx;
+      std::copy(&this->dynamics[k * nx], &this->dynamics[k * nx] + nx, next);
+      mpc_detail::gemv_n<0, 0>(nx, nx, Scalar{1}, &this->a[k * nx * nx],
+                               xi + k * nx, next);
+    }
+    // Gradient r + S xi + Gamma^T (Q xi + q)
+    Scalar *rhs = this->condensed_rhs.data();
+    std::copy(this->gu.begin(), this->gu.end(), rhs);
+    Scalar *v = this->work_v.data();
+    for (size_t k = 1; k <= n; k++) {
+      std::copy(&this->gx[k * nx], &this->gx[k * nx] + nx, v);
+      mpc_detail::gemv_n<0, 0>(nx, nx, Scalar{1}, &this->qt[k * nx * nx],
+                               xi + k * nx, v);
+      Scalar const *block_row = &this->gamma[(k - 1) * nx * width];
+      for (size_t p = 0; p < nx; p++) {
+        teensymat::axpy(k * nu, v[p], block_row + p * width, rhs);
+      }
+      if (k < n) {
+        mpc_detail::gemv_n<0, 0>(nu, nx, Scalar{1}, &this->st[k * nu * nx],
+                                 xi + k * nx, rhs + k * nu);
+      }
+    }
+    teensymat::scal(width, Scalar{-1}, rhs);
+    mpc_detail::cholesky_solve(width, this->hessian.data(), 1, rhs);
+    std::copy(rhs, rhs + width, this->du.begin());
+    // dx = Gamma du + xi
+    std::copy(xi, xi + (n + 1) * nx, this->dx.begin());
+    for (size_t k = 1; k <= n; k++) {
+      Scalar const *block_row = &this->gamma[(k - 1) * nx * width];
+      for (size_t p = 0; p < nx; p++) {
+        this->dx[k * nx + p] +=
+            teensymat::dot(k * nu, block_row + p * width, rhs);
+      }
+    }
+    // Costates backwards from the stationarity of the states
+    for (size_t k = n; k >= 1; k--) {
+      Scalar *dl = &this->dlambda[k * nx];
+      std::copy(&this->gx[k * nx], &this->gx[k * nx] + nx, dl);
+      mpc_detail::gemv_n<0, 0>(nx, nx, Scalar{1}, &this->qt[k * nx * nx],
+                               &this->dx[k * nx], dl);
+      if (k < n) {
+        mpc_detail::gemv_t<0, 0>(nu, nx, Scalar{1}, &this->st[k * nu * nx],
+                                 &this->du[k * nu], dl);
+        mpc_detail::gemv_t<0, 0>(nx, nx, Scalar{1}, &this->a[k * nx * nx],
+                                 &this->dlambda[(k + 1) * nx], dl);
+      }
+    }
+  }
+  /*! Factor the Newton system of the current iterate*/
+  bool factor() {
+    this->barrier_hessians();
+    if (this->form == MPCForm::condensed) {
+      return this->factor_condensed();
+    }
+    return this->with_state_dim([this](auto dim) {
+      return this->template factor_riccati<decltype(dim)::value>();
+    });
+  }
+  /*! Solve the Newton system for the current complementarity targets, and
+   * recover the directions of the slacks and duals*/
+  void solve_newton() {
+    this->lq_gradients();
+    if (this->form == MPCForm::condensed) {
+      this->solve_condensed();
+    } else {
+      this->with_state_dim([this](auto dim) {
+        this->template solve_riccati<decltype(dim)::value>();
+      });
+    }
+    size_t total = this->row_offset[this->horizon + 1];
+    this->row_activities(this->dx.data(), this->du.data(),
+                         this->activity.data());
+    for (size_t i = 0; i < total; i++) {
+      Scalar change = this->activity[i];
+      if (this->has_lower(i)) {
+        this->ds_lower[i] = change + this->rp_lower[i];
+        this->dz_lower[i] =
+            (this->rc_lower[i] - this->z_lower[i] * this->ds_lower[i]) /
+            this->s_lower[i];
+      }
+      if (this->has_upper(i)) {
+        this->ds_upper[i] = this->rp_upper[i] - change;
+        this->dz_upper[i] =
+            (this->rc_upper[i] - this->z_upper[i] * this->ds_upper[i]) /
+            this->s_upper[i];
+      }
+    }
+  }
+  /*! Largest step in (0, 1] keeping the slacks and duals nonnegative*/
+  Scalar max_step() const {
+    Scalar step = 1;
+    size_t total = this->row_offset[this->horizon + 1];
+    auto limit = [&step](Scalar value, Scalar change) {
+      if (change < 0) {
+        step = std::min(step, -value / change);
+      }
+    };
+    for (size_t i = 0; i < total; i++) {
+      if (this->has_lower(i)) {
+        limit(this->s_lower[i], this->ds_lower[i]);
+        limit(this->z_lower[i], this->dz_lower[i]);
+      }
+      if (this->has_upper(i)) {
+        limit(this->s_upper[i], this->ds_upper[i]);
+        limit(this->z_upper[i], this->dz_upper[i]);
+      }
+    }
+    return step;
+  }
+
+  // SECTION: Iterations
+  /*! Starting point: the inputs clamped to their bounds, the states
+   * rolled out through the dynamics, and unit slacks and duals (slacks
+   * larger where the rows are strictly inside)*/
+  void initialize() {
+    size_t n = this->horizon;
+    size_t nx = this->nx;
+    size_t nu = this->nu;
+    std::copy(this->problem.initial_state.begin(),
+              this->problem.initial_state.end(), this->x.begin());
+    for (size_t k = 0; k < n; k++) {
+      size_t offset = this->row_offset[k] + nx;
+      for (size_t i = 0; i < nu; i++) {
+        Scalar low = this->lower[offset + i];
+        Scalar high = this->upper[offset + i];
+        Scalar value = 0;
+        if (std::isfinite(low) && std::isfinite(high)) {
+          value = (low + high) / 2;
+        } else if (std::isfinite(low)) {
+          value = std::max(value, low + 1);
+        } else if (std::isfinite(high)) {
+          value = std::min(value, high - 1);
+        }
+        this->u[k * nu + i] = value;
+      }
+      Scalar *next = &this->x[(k + 1) * nx];
+      std::copy(&this->c[k * nx], &this->c[k * nx] + nx, next);
+      mpc_detail::gemv_n<0, 0>(nx, nx, Scalar{1}, &this->a[k * nx * nx],
+                               &this->x[k * nx], next);
+      mpc_detail::gemv_n<0, 0>(nx, nu, Scalar{1}, &this->b[k * nx * nu],
+                               &this->u[k * nu], next);
+    }
+    std::fill(this->lambda.begin(), this->lambda.end(), Scalar{0});
+    this->row_activities(this->x.data(), this->u.data(),
+                         this->activity.data());
+    size_t total = this->row_offset[n + 1];
+    for (size_t i = 0; i < total; i++) {
+      this->s_lower[i] = this->z_lower[i] = 0;
+      this->s_upper[i] = this->z_upper[i] = 0;
+      if (this->has_lower(i)) {
+        this->s_lower[i] =
+            std::max(this->activity[i] - this->lower[i], Scalar{1});
+        this->z_lower[i] = 1;
+      }
+      if (this->has_upper(i)) {
+        this->s_upper[i] =
+            std::max(this->upper[i] - this->activity[i], Scalar{1});
+        this->z_upper[i] = 1;
+      }
+    }
+  }
+  /*! Take a step of the given length along the direction*/
+  void step(Scalar length) {
+    teensymat::axpy(this->x.size(), length, this->dx.data(), this->x.data());
+    teensymat::axpy(this->u.size(), length, this->du.data(), this->u.data());
+    teensymat::axpy(this->lambda.size(), length, this->dlambda.data(),
+                    this->lambda.data());
+    size_t total = this->row_offset[this->horizon + 1];
+    teensymat::axpy(total, length, this->ds_lower.data(),
+                    this->s_lower.data());
+    teensymat::axpy(total, length, this->ds_upper.data(),
+                    this->s_upper.data());
+    teensymat::axpy(total, length, this->dz_lower.data(),
+                    this->z_lower.data());
+    teensymat::axpy(total, length, this->dz_upper.data(),
+                    this->z_upper.data());
+  }
+  /*! Run Mehrotra's predictor-corrector iterations*/
+  LPStatus run() {
+    size_t total = this->row_offset[this->horizon + 1];
+    Scalar threshold = this->options.tolerance * this->data_scale;
+    for (this->iterations = 0;; this->iterations++) {
+      auto [residual, mu] = this->residuals();
+      if (!std::isfinite(residual) || !std::isfinite(mu)) {
+        return LPStatus::numerical_error;
+      }
+      if (residual <= threshold && mu <= threshold) {
+        return LPStatus::optimal;
+      }
+      Scalar largest_dual = 0;
+      for (size_t i = 0; i < total; i++) {
+        largest_dual = std::max(
+            {largest_dual, this->z_lower[i], this->z_upper[i]});
+      }
+      if (largest_dual > Scalar(divergence) * this->data_scale) {
+        return LPStatus::infeasible;
+      }
+      if (this->iterations >= this->options.max_iterations) {
+        return LPStatus::iteration_limit;
+      }
+      if (!this->factor()) {
+        return LPStatus::numerical_error;
+      }
+      // Predictor
+      for (size_t i = 0; i < total; i++) {
+        this->rc_lower[i] = -this->s_lower[i] * this->z_lower[i];
+        this->rc_upper[i] = -this->s_upper[i] * this->z_upper[i];
+      }
+      this->solve_newton();
+      if (this->num_sides == 0) {
+        this->step(1);
+        continue;
+      }
+      Scalar affine = this->max_step();
+      Scalar affine_mu = 0;
+      for (size_t i = 0; i < total; i++) {
+        affine_mu += (this->s_lower[i] + affine * this->ds_lower[i]) *
+                     (this->z_lower[i] + affine * this->dz_lower[i]);
+        affine_mu += (this->s_upper[i] + affine * this->ds_upper[i]) *
+                     (this->z_upper[i] + affine * this->dz_upper[i]);
+      }
+      affine_mu /= static_cast<Scalar>(this->num_sides);
+      Scalar ratio = affine_mu / mu;
+      Scalar sigma = ratio * ratio * ratio;
+      // Corrector
+      for (size_t i = 0; i < total; i++) {
+        this->rc_lower[i] = sigma * mu - this->s_lower[i] * this->z_lower[i] -
+                            this->ds_lower[i] * this->dz_lower[i];
+        this->rc_upper[i] = sigma * mu - this->s_upper[i] * this->z_upper[i] -
+                            this->ds_upper[i] * this->dz_upper[i];
+        if (!this->has_lower(i)) {
+          this->rc_lower[i] = 0;
+        }
+        if (!this->has_upper(i)) {
+          this->rc_upper[i] = 0;
+        }
+      }
+      this->solve_newton();
+      this->step(std::min(Scalar{1},
+                          this->options.step_factor * this->max_step()));
+    }
+  }
+  /*! The objective at the current iterate, with the original data*/
+  Scalar evaluate() const {
+    size_t n = this->horizon;
+    size_t nx = this->nx;
+    size_t nu = this->nu;
+    Scalar value = 0;
+    std::vector<Scalar> product(std::max(nx, nu));
+    for (size_t k = 0; k <= n; k++) {
+      Scalar const *xk = &this->x[k * nx];
+      std::fill(product.begin(), product.end(), Scalar{0});
+      mpc_detail::gemv_n<0, 0>(nx, nx, Scalar{0.5},
+                               &this->q_matrix[k * nx * nx], xk,
+                               product.data());
+      teensymat::axpy(nx, Scalar{1}, &this->q_vector[k * nx],
+                      product.data());
+      value += teensymat::dot(nx, product.data(), xk);
+      if (k == n) {
+        continue;
+      }
+      Scalar const *uk = &this->u[k * nu];
+      std::fill(product.begin(), product.end(), Scalar{0});
+      mpc_detail::gemv_n<0, 0>(nu, nu, Scalar{0.5},
+                               &this->r_matrix[k * nu * nu], uk,
+                               product.data());
+      mpc_detail::gemv_n<0, 0>(nu, nx, Scalar{1},
+                               &this->s_matrix[k * nu * nx], xk,
+                               product.data());
+      teensymat::axpy(nu, Scalar{1}, &this->r_vector[k * nu],
+                      product.data());
+      value += teensymat::dot(nu, product.data(), uk);
+    }
+    return value;
+  }
+
+public:
+  // SECTION: Constructors
+  /*! Set up the solver for a problem (which is copied).
+   *
+   * Throws std::range_error if the blocks of the problem do not match its
+   * dimensions.
+   *
+   * @param problem The problem to solve
+   * @param options Options of the solve
+   * */
+  explicit MPCSolver(MPCProblem<Scalar> problem,
+                     MPCOptions<Scalar> const &options = {})
+      : problem(std::move(problem)), options(options), horizon(0), nx(0),
+        nu(0), form(MPCForm::riccati), data_scale(1), num_sides(0),
+        iterations(0) {
+    this->problem.validate();
+    this->horizon = this->problem.get_horizon();
+    this->nx = this->problem.get_state_dim();
+    this->nu = this->problem.get_input_dim();
+    this->form = this->choose_form();
+    this->setup();
+  }
+
+  // SECTION: Getters
+  /*! Get the form of the Newton systems in use*/
+  MPCForm get_form() const { return this->form; }
+  /*! Get the number of iterations of the last solve*/
+  size_t get_iterations() const { return this->iterations; }
+
+  // SECTION: Solving
+  /*! Solve the problem.
+   *
+   * @return The solution
+   * */
+  MPCSolution<Scalar> solve() {
+    this->initialize();
+    MPCSolution<Scalar> solution;
+    solution.status = this->run();
+    solution.iterations = this->iterations;
+    solution.objective = this->evaluate();
+    size_t nx = this->nx;
+    size_t nu = this->nu;
+    for (size_t k = 0; k <= this->horizon; k++) {
+      solution.states.emplace_back(&this->x[k * nx], &this->x[k * nx] + nx);
+      if (k < this->horizon) {
+        solution.inputs.emplace_back(&this->u[k * nu],
+                                     &this->u[k * nu] + nu);
+        solution.costates.emplace_back(&this->lambda[(k + 1) * nx],
+                                       &this->lambda[(k + 1) * nx] + nx);
+      }
+    }
+    return solution;
+  }
+};
+
+/*! Solve an MPCProblem with MPCSolver.
+ *
+ * @param problem The problem to solve
+ * @param options Options of the solve
+ * @return The solution
+ * */
+template <typename Scalar>
+MPCSolution<Scalar> solve_mpc(MPCProblem<Scalar> const &problem,
+                              MPCOptions<Scalar> const &options = {}) {
+  MPCSolver<Scalar> solver{problem, options};
+  return solver.solve();
+}
+} // namespace teensylp
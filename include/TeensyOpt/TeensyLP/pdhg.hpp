@@ -0,0 +1,707 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyLP/lp_problem.hpp"
+#include "TeensyOpt/TeensyMat/parallel.hpp"
+#include "TeensyOpt/TeensyMat/scaling.hpp"
+#include "TeensyOpt/TeensyMat/sparse_core.hpp"
+
+namespace teensylp {
+/*! Options of PrimalDualHybridGradient*/
+template <typename Scalar> struct PDHGOptions {
+  /*! Maximum number of (accepted) iterations*/
+  size_t max_iterations = 100000;
+  /*! Relative primal and dual residuals and duality gap of a solution (in
+   * the original problem)*/
+  Scalar tolerance = 1e-6;
+  /*! Relative violation allowed for a certificate of infeasibility or
+   * unboundedness*/
+  Scalar infeasibility_tolerance = 1e-8;
+  /*! Number of iterations between termination and restart checks*/
+  size_t check_interval = 64;
+  /*! Precondition the constraint matrix (Ruiz then Pock-Chambolle)*/
+  bool scale = true;
+  /*! Number of Ruiz passes of the preconditioner*/
+  size_t ruiz_iterations = 10;
+  /*! Exponent of the Pock-Chambolle part of the preconditioner*/
+  Scalar pock_chambolle_alpha = 1;
+  /*! Restart when the KKT error of the candidate falls below this fraction
+   * of the one at the last restart*/
+  Scalar sufficient_restart = 0.2;
+  /*! Restart when the KKT error is below this fraction of the one at the
+   * last restart and stopped decreasing*/
+  Scalar necessary_restart = 0.8;
+  /*! Restart when the current restart period is longer than this fraction
+   * of all iterations*/
+  Scalar artificial_restart = 0.36;
+  /*! Weight of the new estimate when updating the primal weight*/
+  Scalar primal_weight_smoothing = 0.5;
+};
+
+/*! First order primal-dual method for LPProblem in the style of PDLP:
+ * primal-dual hybrid gradient (PDHG) on the saddle point problem
+ *
+ *     min_x max_y  c^T x - y^T A x + p(y),   l <= x <= u
+ *
+ * where p(y) = row_lower^T y^+ - row_upper^T y^- is the support function of
+ * the row bounds, so y has the sign convention of RevisedSimplex.
+ *
+ * Nothing is factored: an iteration is one product with A and one with
+ * A^T, each a parallel pass over the columns of A or of its stored
+ * transpose, so the memory used is twice the constraint matrix plus a few
+ * vectors. This makes the method suitable for problems too large for the
+ * simplex or interior point solvers, at the price of lower accuracy.
+ *
+ * The method follows PDLP:
+ * - the constraint matrix is preconditioned by Ruiz and Pock-Chambolle
+ *   scaling,
+ * - the step size adapts to a local estimate of ||A||, and a primal weight
+ *   balances the primal and dual step sizes,
+ * - every check_interval iterations the current and the averaged iterates
+ *   are measured by their KKT error, and the method restarts from the
+ *   better one when the error decreased enough,
+ * - the differences of the iterates between checks converge to a
+ *   certificate when the problem is infeasible or unbounded.
+ *
+ * Solutions have no basis statuses.
+ * */
+template <typename Scalar> class PrimalDualHybridGradient {
+  /*! Measures of an iterate*/
+  struct Metrics {
+    /*! Norms of the primal and dual residuals in the scaled problem*/
+    Scalar scaled_primal = 0, scaled_dual = 0;
+    /*! Norms of the primal and dual residuals in the original problem*/
+    Scalar primal = 0, dual = 0;
+    /*! Primal and dual objectives (including the offset)*/
+    Scalar primal_objective = 0, dual_objective = 0;
+
+    /*! The duality gap*/
+    Scalar gap() const {
+      return std::abs(this->primal_objective - this->dual_objective);
+    }
+    /*! The KKT error with primal weight omega, which restarts compare*/
+    Scalar kkt(Scalar omega) const {
+      Scalar primal = omega * this->scaled_primal;
+      Scalar dual = this->scaled_dual / omega;
+      Scalar gap = this->gap();
+      return std::sqrt(primal * primal + dual * dual + gap * gap);
+    }
+  };
+
+  /*! Elements per block of the kernels over vectors*/
+  static constexpr size_t vector_grain = 4096;
+
+  /*! Options of the solve*/
+  PDHGOptions<Scalar> options;
+  /*! The number of rows*/
+  size_t nrows;
+  /*! The number of columns*/
+  size_t ncols;
+  /*! The scaled constraint matrix*/
+  teensymat::SparseMatrix<Scalar> constraints;
+  /*! Its transpose, whose columns are the rows of the constraints*/
+  teensymat::SparseMatrix<Scalar> transposed;
+  /*! The scaling applied to the problem*/
+  teensymat::Scaling<Scalar> scaling;
+  /*! Scaled costs and column bounds*/
+  std::vector<Scalar> cost, col_lower, col_upper;
+  /*! Scaled row bounds*/
+  std::vector<Scalar> row_lower, row_upper;
+  /*! Constant term of the objective*/
+  Scalar objective_offset;
+  /*! Norms of the original costs and finite row bounds*/
+  Scalar cost_norm, bound_norm;
+  /*! Columns (and rows) per block of the products*/
+  size_t col_grain, row_grain;
+
+  /*! The current iterate, with A x and A^T y*/
+  std::vector<Scalar> x, y, ax, aty;
+  /*! The trial iterate of a step*/
+  std::vector<Scalar> x_next, y_next, ax_next, aty_next;
+  /*! Step size weighted sums of the iterates since the last restart*/
+  std::vector<Scalar> x_sum, y_sum, ax_sum, aty_sum;
+  /*! Sum of the step sizes since the last restart*/
+  Scalar weight_sum;
+  /*! The iterate at the last restart*/
+  std::vector<Scalar> x_restart, y_restart;
+  /*! The iterate at the last check, for infeasibility certificates*/
+  std::vector<Scalar> x_check, y_check, ax_check, aty_check;
+  /*! Per block partial sums of the kernels*/
+  std::vector<Scalar> partials;
+
+  /*! Step size eta (tau = eta / omega, sigma = eta * omega)*/
+  Scalar step;
+  /*! Primal weight omega*/
+  Scalar primal_weight;
+  /*! Number of accepted iterations*/
+  size_t iterations;
+  /*! Number of step attempts (accepted or not)*/
+  size_t attempts;
+  /*! Number of restarts*/
+  size_t restarts;
+
+  // SECTION: Setup
+  /*! Scale the problem data*/
+  void load(LPProblem<Scalar> const &problem) {
+    size_t m = this->nrows;
+    size_t n = this->ncols;
+    this->scaling.row_scale.assign(m, 1);
+    this->scaling.col_scale.assign(n, 1);
+    if (this->options.scale && this->constraints.get_nnz() > 0) {
+      if (this->options.ruiz_iterations > 0) {
+        this->scaling = teensymat::ruiz_scaling(
+            this->constraints, this->options.ruiz_iterations);
+        teensymat::apply_scaling(this->constraints, this->scaling);
+      }
+      teensymat::Scaling<Scalar> diagonal = teensymat::pock_chambolle_scaling(
+          this->constraints, this->options.pock_chambolle_alpha);
+      teensymat::apply_scaling(this->constraints, diagonal);
+      for (size_t i = 0; i < m; i++) {
+        this->scaling.row_scale[i] *= diagonal.row_scale[i];
+      }
+      for (size_t j = 0; j < n; j++) {
+        this->scaling.col_scale[j] *= diagonal.col_scale[j];
+      }
+    }
+    this->transposed = this->constraints.transpose();
+    this->cost.resize(n);
+    this->col_lower.resize(n);
+    this->col_upper.resize(n);
+    this->cost_norm = 0;
+    for (size_t j = 0; j < n; j++) {
+      Scalar scale = this->scaling.col_scale[j];
+      this->cost[j] = problem.objective[j] * scale;
+      this->col_lower[j] = problem.col_lower[j] / scale;
+      this->col_upper[j] = problem.col_upper[j] / scale;
+      this->cost_norm += problem.objective[j] * problem.objective[j];
+    }
+    this->row_lower.resize(m);
+    this->row_upper.resize(m);
+    this->bound_norm = 0;
+    for (size_t i = 0; i < m; i++) {
+      Scalar scale = this->scaling.row_scale[i];
+      this->row_lower[i] = problem.row_lower[i] * scale;
+      this->row_upper[i] = problem.row_upper[i] * scale;
+      Scalar bound = 0;
+      for (Scalar value : {problem.row_lower[i], problem.row_upper[i]}) {
+        if (std::isfinite(value)) {
+          bound = std::max(bound, std::abs(value));
+        }
+      }
+      this->bound_norm += bound * bound;
+    }
+    this->cost_norm = std::sqrt(this->cost_norm);
+    this->bound_norm = std::sqrt(this->bound_norm);
+    this->objective_offset = problem.objective_offset;
+  }
+  /*! Grain of a product over the columns of matrix (as gaxpy_transpose)*/
+  static size_t product_grain(teensymat::SparseMatrix<Scalar> const &matrix) {
+    size_t average = matrix.get_nnz() / std::max<size_t>(1, matrix.get_ncols());
+    return std::max<size_t>(64, 16384 / std::max<size_t>(1, average));
+  }
+  /*! Initial step size, primal weight and iterate*/
+  void initialize() {
+    size_t m = this->nrows;
+    size_t n = this->ncols;
+    Scalar largest = 0;
+    for (Scalar value : *this->constraints.get_values()) {
+      largest = std::max(largest, std::abs(value));
+    }
+    this->step = largest > Scalar{0} ? 1 / largest : Scalar{1};
+    // omega = ||c|| / ||b|| in the scaled problem
+    Scalar cost_scaled = 0;
+    for (Scalar value : this->cost) {
+      cost_scaled += value * value;
+    }
+    Scalar bound_scaled = 0;
+    for (size_t i = 0; i < m; i++) {
+      Scalar bound = 0;
+      for (Scalar value : {this->row_lower[i], this->row_upper[i]}) {
+        if (std::isfinite(value)) {
+          bound = std::max(bound, std::abs(value));
+        }
+      }
+      bound_scaled += bound * bound;
+    }
+    cost_scaled = std::sqrt(cost_scaled);
+    bound_scaled = std::sqrt(bound_scaled);
+    this->primal_weight = cost_scaled > Scalar{1e-10} &&
+                                  bound_scaled > Scalar{1e-10}
+                              ? cost_scaled / bound_scaled
+                              : Scalar{1};
+    this->x.resize(n);
+    for (size_t j = 0; j < n; j++) {
+      this->x[j] =
+          std::clamp(Scalar{0}, this->col_lower[j], this->col_upper[j]);
+    }
+    this->y.assign(m, 0);
+    this->ax.assign(m, 0);
+    this->transposed.gaxpy_transpose(1, this->x.data(), this->ax.data());
+    this->aty.assign(n, 0);
+    this->x_next.assign(n, 0);
+    this->y_next.assign(m, 0);
+    this->ax_next.assign(m, 0);
+    this->aty_next.assign(n, 0);
+    this->x_sum.assign(n, 0);
+    this->y_sum.assign(m, 0);
+    this->ax_sum.assign(m, 0);
+    this->aty_sum.assign(n, 0);
+    this->weight_sum = 0;
+    this->x_restart = this->x;
+    this->y_restart = this->y;
+    this->x_check = this->x;
+    this->y_check = this->y;
+    this->ax_check = this->ax;
+    this->aty_check = this->aty;
+    size_t blocks = std::max({(n + this->col_grain - 1) / this->col_grain,
+                              (m + this->row_grain - 1) / this->row_grain,
+                              (n + vector_grain - 1) / vector_grain});
+    this->partials.assign(2 * std::max<size_t>(blocks, 1), 0);
+  }
+
+  // SECTION: Kernels
+  /*! Run kernel(begin, end) -> pair of partial sums over blocks of [0, n)
+   * in parallel, and add up the partial sums in block order (so the result
+   * does not depend on the number of threads)*/
+  template <typename Kernel>
+  std::pair<Scalar, Scalar> reduce(size_t n, size_t grain, Kernel &&kernel) {
+    size_t blocks = (n + grain - 1) / grain;
+    teensymat::parallel_for(n, grain, [&](size_t begin, size_t end) {
+      size_t block = begin / grain;
+      std::pair<Scalar, Scalar> sums = kernel(begin, end);
+      this->partials[2 * block] = sums.first;
+      this->partials[2 * block + 1] = sums.second;
+    });
+    std::pair<Scalar, Scalar> total{0, 0};
+    for (size_t block = 0; block < blocks; block++) {
+      total.first += this->partials[2 * block];
+      total.second += this->partials[2 * block + 1];
+    }
+    return total;
+  }
+  /*! Primal step x_next = proj(x - tau (c - A^T y)).
+   *
+   * @return ||x_next - x||^2
+   * */
+  Scalar primal_step(Scalar tau) {
+    return this
+        ->reduce(this->ncols, vector_grain,
+                 [&](size_t begin, size_t end) {
+                   Scalar sum = 0;
+                   for (size_t j = begin; j < end; j++) {
+                     Scalar value = std::clamp(
+                         this->x[j] - tau * (this->cost[j] - this->aty[j]),
+                         this->col_lower[j], this->col_upper[j]);
+                     this->x_next[j] = value;
+                     sum += (value - this->x[j]) * (value - this->x[j]);
+                   }
+                   return std::pair<Scalar, Scalar>{sum, 0};
+                 })
+        .first;
+  }
+  /*! Dual step: ax_next = A x_next and the proximal step of y at the
+   * extrapolated point 2 x_next - x, fused in one pass over the rows.
+   *
+   * @return ||y_next - y||^2 and (y_next - y)^T A (x_next - x)
+   * */
+  std::pair<Scalar, Scalar> dual_step(Scalar sigma) {
+    std::vector<size_t> const &row_ptr = this->transposed.get_col_ptr();
+    std::vector<size_t> const &col_idx = this->transposed.get_row_idx();
+    Scalar const *values = this->transposed.get_values()->data();
+    return this->reduce(this->nrows, this->row_grain, [&](size_t begin,
+                                                          size_t end) {
+      Scalar squares = 0;
+      Scalar interaction = 0;
+      for (size_t i = begin; i < end; i++) {
+        Scalar product = 0;
+        for (size_t k = row_ptr[i]; k < row_ptr[i + 1]; k++) {
+          product += values[k] * this->x_next[col_idx[k]];
+        }
+        this->ax_next[i] = product;
+        // y_next = argmin y^T A x_bar - p(y) + ||y - y_k||^2 / (2 sigma)
+        Scalar v = this->y[i] - sigma * (2 * product - this->ax[i]);
+        Scalar w = -v / sigma;
+        Scalar value = 0;
+        if (w < this->row_lower[i]) {
+          value = v + sigma * this->row_lower[i];
+        } else if (w > this->row_upper[i]) {
+          value = v + sigma * this->row_upper[i];
+        }
+        this->y_next[i] = value;
+        Scalar change = value - this->y[i];
+        squares += change * change;
+        interaction += change * (product - this->ax[i]);
+      }
+      return std::pair<Scalar, Scalar>{squares, interaction};
+    });
+  }
+  /*! Finish an accepted step of size eta: compute aty_next = A^T y_next,
+   * add the trial iterate to the averages and make it current*/
+  void accept(Scalar eta) {
+    std::vector<size_t> const &col_ptr = this->constraints.get_col_ptr();
+    std::vector<size_t> const &row_idx = this->constraints.get_row_idx();
+    Scalar const *values = this->constraints.get_values()->data();
+    teensymat::parallel_for(
+        this->ncols, this->col_grain, [&](size_t begin, size_t end) {
+          for (size_t j = begin; j < end; j++) {
+            Scalar product = 0;
+            for (size_t k = col_ptr[j]; k < col_ptr[j + 1]; k++) {
+              product += values[k] * this->y_next[row_idx[k]];
+            }
+            this->aty_next[j] = product;
+            this->x_sum[j] += eta * this->x_next[j];
+            this->aty_sum[j] += eta * product;
+          }
+        });
+    teensymat::parallel_for(
+        this->nrows, vector_grain, [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; i++) {
+            this->y_sum[i] += eta * this->y_next[i];
+            this->ax_sum[i] += eta * this->ax_next[i];
+          }
+        });
+    this->weight_sum += eta;
+    std::swap(this->x, this->x_next);
+    std::swap(this->y, this->y_next);
+    std::swap(this->ax, this->ax_next);
+    std::swap(this->aty, this->aty_next);
+  }
+  /*! Take one step with the adaptive step size rule of PDLP: a step is
+   * accepted when eta <= ||dz||_omega^2 / (2 |dy^T A dx|), and eta moves
+   * towards that limit after every attempt*/
+  void take_step() {
+    while (true) {
+      Scalar eta = this->step;
+      Scalar squares_x = this->primal_step(eta / this->primal_weight);
+      auto [squares_y, interaction] =
+          this->dual_step(eta * this->primal_weight);
+      this->attempts++;
+      Scalar norm = this->primal_weight * squares_x +
+                    squares_y / this->primal_weight;
+      Scalar limit = interaction != Scalar{0}
+                         ? norm / (2 * std::abs(interaction))
+                         : std::numeric_limits<Scalar>::infinity();
+      Scalar count = static_cast<Scalar>(this->attempts + 1);
+      this->step = std::min((1 - std::pow(count, Scalar{-0.3})) * limit,
+                            (1 + std::pow(count, Scalar{-0.6})) * eta);
+      if (eta <= limit) {
+        this->accept(eta);
+        return;
+      }
+    }
+  }
+
+  // SECTION: Measuring iterates
+  /*! Measure the iterate given by scale * (x, y, A x, A^T y)*/
+  Metrics measure(std::vector<Scalar> const &xs, std::vector<Scalar> const &ys,
+                  std::vector<Scalar> const &axs,
+                  std::vector<Scalar> const &atys, Scalar scale) const {
+    Metrics metrics;
+    metrics.primal_objective = this->objective_offset;
+    metrics.dual_objective = this->objective_offset;
+    for (size_t i = 0; i < this->nrows; i++) {
+      Scalar activity = scale * axs[i];
+      Scalar violation = activity - std::clamp(activity, this->row_lower[i],
+                                               this->row_upper[i]);
+      Scalar original = violation / this->scaling.row_scale[i];
+      metrics.scaled_primal += violation * violation;
+      metrics.primal += original * original;
+      Scalar dual = scale * ys[i];
+      if (dual > Scalar{0}) {
+        metrics.dual_objective += dual * this->row_lower[i];
+      } else if (dual < Scalar{0}) {
+        metrics.dual_objective += dual * this->row_upper[i];
+      }
+    }
+    for (size_t j = 0; j < this->ncols; j++) {
+      Scalar value = scale * xs[j];
+      Scalar reduced = this->cost[j] - scale * atys[j];
+      Scalar bound_dual = this->bound_dual(j, reduced);
+      Scalar residual = reduced - bound_dual;
+      Scalar original = residual / this->scaling.col_scale[j];
+      metrics.scaled_dual += residual * residual;
+      metrics.dual += original * original;
+      metrics.primal_objective += this->cost[j] * value;
+      if (bound_dual > Scalar{0}) {
+        metrics.dual_objective += bound_dual * this->col_lower[j];
+      } else if (bound_dual < Scalar{0}) {
+        metrics.dual_objective += bound_dual * this->col_upper[j];
+      }
+    }
+    for (Scalar *norm : {&metrics.scaled_primal, &metrics.primal,
+                         &metrics.scaled_dual, &metrics.dual}) {
+      *norm = std::sqrt(*norm);
+    }
+    return metrics;
+  }
+  /*! The part of a reduced cost which the bounds of column j can carry*/
+  Scalar bound_dual(size_t j, Scalar reduced) const {
+    if (reduced > Scalar{0}) {
+      return std::isfinite(this->col_lower[j]) ? reduced : Scalar{0};
+    }
+    return std::isfinite(this->col_upper[j]) ? reduced : Scalar{0};
+  }
+  /*! Whether an iterate solves the problem to the relative tolerance*/
+  bool converged(Metrics const &metrics) const {
+    Scalar tolerance = this->options.tolerance;
+    return metrics.primal <= tolerance * (1 + this->bound_norm) &&
+           metrics.dual <= tolerance * (1 + this->cost_norm) &&
+           metrics.gap() <=
+               tolerance * (1 + std::abs(metrics.primal_objective) +
+                            std::abs(metrics.dual_objective));
+  }
+  /*! Whether the change of x since the last check is a ray along which the
+   * objective decreases without bound (dual infeasibility)*/
+  bool primal_ray() const {
+    Scalar slope = 0;
+    Scalar violation = 0;
+    Scalar largest = 0;
+    for (size_t j = 0; j < this->ncols; j++) {
+      Scalar change = this->x[j] - this->x_check[j];
+      Scalar original = change * this->scaling.col_scale[j];
+      slope += this->cost[j] * change;
+      largest = std::max(largest, std::abs(original));
+      if ((change < Scalar{0} && std::isfinite(this->col_lower[j])) ||
+          (change > Scalar{0} && std::isfinite(this->col_upper[j]))) {
+        violation += original * original;
+      }
+    }
+    for (size_t i = 0; i < this->nrows; i++) {
+      Scalar change = (this->ax[i] - this->ax_check[i]) /
+                      this->scaling.row_scale[i];
+      if ((change < Scalar{0} && std::isfinite(this->row_lower[i])) ||
+          (change > Scalar{0} && std::isfinite(this->row_upper[i]))) {
+        violation += change * change;
+      }
+    }
+    return slope < Scalar{0} && largest > Scalar{0} &&
+           std::sqrt(violation) <=
+               this->options.infeasibility_tolerance * largest;
+  }
+  /*! Whether the change of y since the last check is a dual ray proving
+   * the constraints infeasible (Farkas certificate)*/
+  bool dual_ray() const {
+    Scalar objective = 0;
+    Scalar violation = 0;
+    Scalar largest = 0;
+    for (size_t i = 0; i < this->nrows; i++) {
+      Scalar change = this->y[i] - this->y_check[i];
+      Scalar original = change * this->scaling.row_scale[i];
+      largest = std::max(largest, std::abs(original));
+      Scalar bound =
+          change > Scalar{0} ? this->row_lower[i] : this->row_upper[i];
+      if (change == Scalar{0}) {
+        continue;
+      }
+      if (std::isfinite(bound)) {
+        objective += change * bound;
+      } else {
+        violation += original * original;
+      }
+    }
+    for (size_t j = 0; j < this->ncols; j++) {
+      Scalar reduced = -(this->aty[j] - this->aty_check[j]);
+      Scalar bound_dual = this->bound_dual(j, reduced);
+      Scalar residual = (reduced - bound_dual) / this->scaling.col_scale[j];
+      violation += residual * residual;
+      if (bound_dual > Scalar{0}) {
+        objective += bound_dual * this->col_lower[j];
+      } else if (bound_dual < Scalar{0}) {
+        objective += bound_dual * this->col_upper[j];
+      }
+    }
+    return objective > Scalar{0} && largest > Scalar{0} &&
+           std::sqrt(violation) <=
+               this->options.infeasibility_tolerance * largest;
+  }
+
+  // SECTION: Restarts
+  /*! Replace the current iterate by the average since the last restart*/
+  void use_average() {
+    Scalar inverse = 1 / this->weight_sum;
+    for (size_t j = 0; j < this->ncols; j++) {
+      this->x[j] = inverse * this->x_sum[j];
+      this->aty[j] = inverse * this->aty_sum[j];
+    }
+    for (size_t i = 0; i < this->nrows; i++) {
+      this->y[i] = inverse * this->y_sum[i];
+      this->ax[i] = inverse * this->ax_sum[i];
+    }
+  }
+  /*! Restart from the current iterate, updating the primal weight from the
+   * distance travelled since the last restart*/
+  void restart() {
+    Scalar dx = 0;
+    Scalar dy = 0;
+    for (size_t j = 0; j < this->ncols; j++) {
+      Scalar change = this->x[j] - this->x_restart[j];
+      dx += change * change;
+    }
+    for (size_t i = 0; i < this->nrows; i++) {
+      Scalar change = this->y[i] - this->y_restart[i];
+      dy += change * change;
+    }
+    dx = std::sqrt(dx);
+    dy = std::sqrt(dy);
+    if (dx > Scalar{1e-10} && dy > Scalar{1e-10}) {
+      Scalar theta = this->options.primal_weight_smoothing;
+      this->primal_weight =
+          std::exp(theta * std::log(dy / dx) +
+                   (1 - theta) * std::log(this->primal_weight));
+    }
+    this->x_restart = this->x;
+    this->y_restart = this->y;
+    std::fill(this->x_sum.begin(), this->x_sum.end(), Scalar{0});
+    std::fill(this->y_sum.begin(), this->y_sum.end(), Scalar{0});
+    std::fill(this->ax_sum.begin(), this->ax_sum.end(), Scalar{0});
+    std::fill(this->aty_sum.begin(), this->aty_sum.end(), Scalar{0});
+    this->weight_sum = 0;
+    this->restarts++;
+  }
+
+  // SECTION: Solution
+  /*! Unscale the current iterate into an LPSolution*/
+  LPSolution<Scalar> make_solution(LPStatus result) const {
+    LPSolution<Scalar> solution;
+    solution.status = result;
+    solution.iterations = this->iterations;
+    solution.x = this->x;
+    this->scaling.unscale_primal(solution.x);
+    solution.row_activity.resize(this->nrows);
+    for (size_t i = 0; i < this->nrows; i++) {
+      solution.row_activity[i] = this->ax[i] / this->scaling.row_scale[i];
+    }
+    solution.row_duals = this->y;
+    this->scaling.unscale_dual(solution.row_duals);
+    solution.reduced_costs.resize(this->ncols);
+    solution.objective = this->objective_offset;
+    for (size_t j = 0; j < this->ncols; j++) {
+      solution.reduced_costs[j] = (this->cost[j] - this->aty[j]) /
+                                  this->scaling.col_scale[j];
+      solution.objective += this->cost[j] * this->x[j];
+    }
+    return solution;
+  }
+
+public:
+  // SECTION: Constructors
+  /*! Set up the solver for a problem, whose data is scaled into the
+   * solver (the problem is not referenced afterwards).
+   *
+   * @param problem The LP to solve
+   * @param options Options of the solve
+   * */
+  explicit PrimalDualHybridGradient(LPProblem<Scalar> const &problem,
+                                    PDHGOptions<Scalar> const &options = {})
+      : options(options), nrows(problem.get_nrows()),
+        ncols(problem.get_ncols()), constraints(problem.constraints),
+        iterations(0), attempts(0), restarts(0) {
+    problem.validate();
+    this->load(problem);
+    this->col_grain = product_grain(this->constraints);
+    this->row_grain = product_grain(this->transposed);
+    this->initialize();
+  }
+  PrimalDualHybridGradient(PrimalDualHybridGradient const &) = delete;
+  PrimalDualHybridGradient &
+  operator=(PrimalDualHybridGradient const &) = delete;
+
+  // SECTION: Getters
+  /*! Get the number of restarts performed*/
+  size_t get_num_restarts() const { return this->restarts; }
+  /*! Get the number of step attempts, each costing one product with A
+   * (accepted steps cost another with A^T)*/
+  size_t get_num_attempts() const { return this->attempts; }
+  /*! Get the current primal weight*/
+  Scalar get_primal_weight() const { return this->primal_weight; }
+
+  // SECTION: Solving
+  /*! Solve the problem.
+   *
+   * @return The solution (optimal to the relative tolerance, or the last
+   * iterate when infeasible, unbounded or out of iterations)
+   * */
+  LPSolution<Scalar> solve() {
+    Metrics restart_metrics = this->measure(this->x, this->y, this->ax,
+                                            this->aty, 1);
+    if (this->converged(restart_metrics)) {
+      return this->make_solution(LPStatus::optimal);
+    }
+    Scalar previous_kkt = std::numeric_limits<Scalar>::infinity();
+    size_t last_restart = 0;
+    size_t interval = std::max<size_t>(this->options.check_interval, 1);
+    while (this->iterations < this->options.max_iterations) {
+      this->take_step();
+      this->iterations++;
+      if (this->iterations % interval != 0) {
+        continue;
+      }
+      Metrics current = this->measure(this->x, this->y, this->ax, this->aty, 1);
+      Metrics average = this->measure(this->x_sum, this->y_sum, this->ax_sum,
+                                      this->aty_sum, 1 / this->weight_sum);
+      if (this->converged(current)) {
+        return this->make_solution(LPStatus::optimal);
+      }
+      if (this->converged(average)) {
+        this->use_average();
+        return this->make_solution(LPStatus::optimal);
+      }
+      if (this->dual_ray()) {
+        return this->make_solution(LPStatus::infeasible);
+      }
+      if (this->primal_ray()) {
+        return this->make_solution(LPStatus::unbounded);
+      }
+      // Restart from the better of the current and averaged iterates
+      Scalar omega = this->primal_weight;
+      bool averaged = average.kkt(omega) < current.kkt(omega);
+      Metrics const &candidate = averaged ? average : current;
+      Scalar kkt = candidate.kkt(omega);
+      Scalar reference = restart_metrics.kkt(omega);
+      bool restart =
+          kkt <= this->options.sufficient_restart * reference ||
+          (kkt <= this->options.necessary_restart * reference &&
+           kkt > previous_kkt) ||
+          static_cast<Scalar>(this->iterations - last_restart) >=
+              this->options.artificial_restart *
+                  static_cast<Scalar>(this->iterations);
+      previous_kkt = kkt;
+      if (restart) {
+        if (averaged) {
+          this->use_average();
+        }
+        restart_metrics = candidate;
+        this->restart();
+        previous_kkt = std::numeric_limits<Scalar>::infinity();
+        last_restart = this->iterations;
+      }
+      this->x_check = this->x;
+      this->y_check = this->y;
+      this->ax_check = this->ax;
+      this->aty_check = this->aty;
+    }
+    return this->make_solution(LPStatus::iteration_limit);
+  }
+};
+
+/*! Solve an LP with the primal-dual hybrid gradient method (see
+ * PrimalDualHybridGradient).
+ *
+ * @param problem The LP to solve
+ * @param options Options of the solve
+ * @return The solution
+ * */
+template <typename Scalar>
+LPSolution<Scalar> solve_pdhg(LPProblem<Scalar> const &problem,
+                              PDHGOptions<Scalar> const &options = {}) {
+  PrimalDualHybridGradient<Scalar> solver{problem, options};
+  return solver.solve();
+}
+} // namespace teensylp
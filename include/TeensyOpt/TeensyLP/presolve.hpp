@@ -0,0 +1,1249 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyLP/lp_problem.hpp"
+#include "TeensyOpt/TeensyMat/hash.hpp"
+#include "TeensyOpt/TeensyMat/sparse_core.hpp"
+
+namespace teensylp {
+/*! Outcome of Presolve*/
+enum class PresolveStatus {
+  /*! The reduced problem is equivalent to the original one*/
+  reduced,
+  /*! The constraints can not be satisfied*/
+  infeasible,
+  /*! The dual is infeasible (the problem is unbounded if it is feasible)*/
+  unbounded,
+};
+
+/*! Options of Presolve*/
+template <typename Scalar> struct PresolveOptions {
+  /*! Maximum number of passes over the problem*/
+  size_t max_passes = 20;
+  /*! Relative tolerance of the feasibility tests*/
+  Scalar tolerance = 1e-9;
+  /*! Turn rows with one entry into column bounds*/
+  bool singleton_rows = true;
+  /*! Remove free (or implied free) column singletons of equality rows, and
+   * fold the bounds of cost free column singletons into their row*/
+  bool singleton_columns = true;
+  /*! Substitute out one variable of equality rows with two entries*/
+  bool doubleton_equations = true;
+  /*! Fix columns whose reduced cost has a known sign*/
+  bool dominated_columns = true;
+  /*! Merge rows which are multiples of each other*/
+  bool duplicate_rows = true;
+  /*! Use the bounds on row activities to remove redundant rows and row
+   * sides, and to fix the columns of forcing rows*/
+  bool bound_tightening = true;
+};
+
+/*! Presolve for LPProblem: a sequence of reductions producing a smaller
+ * equivalent problem, recorded on a postsolve stack which maps a solution
+ * of the reduced problem (primal, dual and basis) back to the original.
+ *
+ * The reductions are
+ * - empty, fixed and dominated columns (fixed at a bound),
+ * - empty and singleton rows (the latter become column bounds),
+ * - redundant and forcing rows, and redundant row sides, found from the
+ *   bounds on the row activities,
+ * - doubleton equations a x_j + b x_k = rhs, substituting out x_k,
+ * - free (or implied free) column singletons of equality rows, which are
+ *   substituted out with their row, and cost free column singletons
+ *   (slacks) whose bounds are folded into their row,
+ * - duplicate rows, found by hashing the normalized rows.
+ *
+ * Each pass visits every row and column once, and the passes repeat until
+ * nothing changes (or max_passes). The records on the postsolve stack keep
+ * the entries of removed rows and columns in one flat array, so the stack
+ * holds at most the nonzeros of the problem plus the fill of the
+ * substitutions.
+ *
+ * Postsolve tracks the row duals, reduced costs and row activities of the
+ * problem as the reductions are undone in reverse, moving duals from
+ * column bounds to rows (and between duplicate rows) where a tightened
+ * bound is active. The reduced costs and activities of the result are
+ * recomputed from the original data.
+ * */
+template <typename Scalar> class Presolve {
+public:
+  /*! Marker for "no index"*/
+  static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+private:
+  /*! An entry of a row (index is a column) or of a column (index is a
+   * row); entries with a zero value or an inactive index are dead*/
+  struct Entry {
+    size_t index;
+    Scalar value;
+  };
+  /*! Bounds on the activity of a row, with the infinite contributions
+   * counted separately*/
+  struct Activity {
+    Scalar min = 0, max = 0;
+    size_t min_infinite = 0, max_infinite = 0;
+
+    Scalar lower() const {
+      return this->min_infinite > 0 ? -infinity<Scalar> : this->min;
+    }
+    Scalar upper() const {
+      return this->max_infinite > 0 ? infinity<Scalar> : this->max;
+    }
+  };
+  /*! Kind of a postsolve record, with the scalars it stores*/
+  enum class Reduction {
+    /*! Column fixed at a value: value, cost (entries: the column)*/
+    fixed_column,
+    /*! Row removed with a zero dual (entries: the row)*/
+    free_row,
+    /*! Row with one entry made a column bound: a, old column bounds, row
+     * bounds*/
+    singleton_row,
+    /*! Equation a x_j + b x_k = rhs, x_k substituted: a, b, rhs, cost of
+     * x_k, old bounds of x_j, bounds of x_k (entries: column k)*/
+    doubleton_equation,
+    /*! Cost free column singleton folded into its row: a, column bounds,
+     * old row bounds*/
+    slack_column,
+    /*! Implied free column singleton of an equality row, substituted out
+     * with the row: a, rhs, cost (entries: the rest of the row)*/
+    free_column,
+    /*! Row which is a multiple lambda of another: lambda, old bounds of the
+     * other row, bounds of the row*/
+    duplicate_row,
+    /*! Row whose columns are all fixed at the bound reaching one of its
+     * sides (status tells which) (entries: the row)*/
+    forcing_row,
+  };
+  /*! An entry of the postsolve stack*/
+  struct Record {
+    Reduction kind;
+    size_t row;
+    size_t col;
+    size_t other;
+    BasisStatus status;
+    /*! Range of the stored entries*/
+    size_t begin, end;
+    /*! Offset of the stored scalars*/
+    size_t data;
+  };
+
+  /*! The problem as given*/
+  LPProblem<Scalar> original;
+  /*! Options of the presolve*/
+  PresolveOptions<Scalar> options;
+  /*! Outcome of the presolve*/
+  PresolveStatus result;
+  /*! The number of rows and columns of the original problem*/
+  size_t nrows, ncols;
+
+  /*! Entries of each row and column of the working problem*/
+  std::vector<std::vector<Entry>> row_entries, col_entries;
+  /*! Whether each row and column is still in the problem*/
+  std::vector<char> row_active, col_active;
+  /*! Number of live entries of each row and column*/
+  std::vector<size_t> row_size, col_size;
+  /*! Costs, column bounds and row bounds of the working problem*/
+  std::vector<Scalar> cost, col_lower, col_upper, row_lower, row_upper;
+  /*! Constant term of the working objective*/
+  Scalar objective_offset;
+
+  /*! The postsolve stack*/
+  std::vector<Record> records;
+  /*! Entries of the removed rows and columns*/
+  std::vector<Entry> stored;
+  /*! Scalars of the records*/
+  std::vector<Scalar> scalars;
+  /*! Number of passes made*/
+  size_t passes;
+
+  /*! The reduced problem*/
+  LPProblem<Scalar> reduced;
+  /*! Original index of each row and column of the reduced problem*/
+  std::vector<size_t> row_map, col_map;
+
+  // SECTION: Working problem
+  /*! Whether an entry of a row is live*/
+  bool live_in_row(Entry const &entry) const {
+    return this->col_active[entry.index] && entry.value != Scalar{0};
+  }
+  /*! Whether an entry of a column is live*/
+  bool live_in_col(Entry const &entry) const {
+    return this->row_active[entry.index] && entry.value != Scalar{0};
+  }
+  /*! Whether value exceeds bound by more than the tolerance*/
+  bool exceeds(Scalar value, Scalar bound) const {
+    if (!std::isfinite(bound)) {
+      return value > bound;
+    }
+    return value > bound + this->options.tolerance * (1 + std::abs(bound));
+  }
+  /*! Whether value is within the tolerance of a finite bound*/
+  bool near(Scalar value, Scalar bound) const {
+    return std::isfinite(bound) &&
+           std::abs(value - bound) <=
+               this->options.tolerance * (1 + std::abs(bound));
+  }
+  /*! The entry with the given index in a list, or nullptr*/
+  static Entry *find(std::vector<Entry> &list, size_t index) {
+    for (Entry &entry : list) {
+      if (entry.index == index) {
+        return &entry;
+      }
+    }
+    return nullptr;
+  }
+  /*! The first live entry of a row*/
+  Entry const &first_in_row(size_t row) const {
+    for (Entry const &entry : this->row_entries[row]) {
+      if (this->live_in_row(entry)) {
+        return entry;
+      }
+    }
+    throw std::runtime_error("Row has no live entries");
+  }
+  /*! The first live entry of a column*/
+  Entry const &first_in_col(size_t col) const {
+    for (Entry const &entry : this->col_entries[col]) {
+      if (this->live_in_col(entry)) {
+        return entry;
+      }
+    }
+    throw std::runtime_error("Column has no live entries");
+  }
+  /*! Bounds on the activity of a row*/
+  Activity activity(size_t row) const {
+    Activity bounds;
+    for (Entry const &entry : this->row_entries[row]) {
+      if (!this->live_in_row(entry)) {
+        continue;
+      }
+      auto [low, high] = this->contribution(entry);
+      if (std::isfinite(low)) {
+        bounds.min += low;
+      } else {
+        bounds.min_infinite++;
+      }
+      if (std::isfinite(high)) {
+        bounds.max += high;
+      } else {
+        bounds.max_infinite++;
+      }
+    }
+    return bounds;
+  }
+  /*! Smallest and largest value of a_ij x_j for an entry of a row*/
+  std::pair<Scalar, Scalar> contribution(Entry const &entry) const {
+    Scalar low = entry.value * this->col_lower[entry.index];
+    Scalar high = entry.value * this->col_upper[entry.index];
+    return entry.value > Scalar{0} ? std::pair{low, high}
+                                   : std::pair{high, low};
+  }
+  /*! Add delta to the coefficient of a column in a row (which may create
+   * or cancel an entry)*/
+  void add_coefficient(size_t row, size_t col, Scalar delta) {
+    Entry *in_row = find(this->row_entries[row], col);
+    if (in_row == nullptr) {
+      this->row_entries[row].push_back(Entry{col, delta});
+      this->col_entries[col].push_back(Entry{row, delta});
+      this->row_size[row]++;
+      this->col_size[col]++;
+      return;
+    }
+    Scalar old = in_row->value;
+    Scalar value = old + delta;
+    if (std::abs(value) <= 1e-12 * std::max(std::abs(old), std::abs(delta))) {
+      value = 0;
+    }
+    in_row->value = value;
+    find(this->col_entries[col], row)->value = value;
+    if (old == Scalar{0} && value != Scalar{0}) {
+      this->row_size[row]++;
+      this->col_size[col]++;
+    } else if (old != Scalar{0} && value == Scalar{0}) {
+      this->row_size[row]--;
+      this->col_size[col]--;
+    }
+  }
+
+  // SECTION: Recording
+  /*! Push a record, storing the live entries of a row or column list
+   * (except the one with index skip) and the given scalars*/
+  void record(Reduction kind, size_t row, size_t col, size_t other,
+              BasisStatus status, std::vector<Entry> const *list,
+              bool list_is_row, size_t skip,
+              std::initializer_list<Scalar> values) {
+    Record entry{kind, row, col, other, status, this->stored.size(), 0,
+                 this->scalars.size()};
+    if (list != nullptr) {
+      for (Entry const &item : *list) {
+        bool live = list_is_row ? this->live_in_row(item)
+                                : this->live_in_col(item);
+        if (live && item.index != skip) {
+          this->stored.push_back(item);
+        }
+      }
+    }
+    entry.end = this->stored.size();
+    this->scalars.insert(this->scalars.end(), values);
+    this->records.push_back(entry);
+  }
+  /*! Remove a row from the working problem*/
+  void remove_row(size_t row) {
+    this->row_active[row] = 0;
+    for (Entry const &entry : this->row_entries[row]) {
+      if (this->live_in_row(entry)) {
+        this->col_size[entry.index]--;
+      }
+    }
+  }
+  /*! Remove a column fixed at value, moving its contribution into the row
+   * bounds and the objective*/
+  void fix_column(size_t col, Scalar value, BasisStatus status) {
+    this->record(Reduction::fixed_column, npos, col, npos, status,
+                 &this->col_entries[col], false, npos,
+                 {value, this->cost[col]});
+    this->col_active[col] = 0;
+    for (Entry const &entry : this->col_entries[col]) {
+      if (this->live_in_col(entry)) {
+        this->row_lower[entry.index] -= entry.value * value;
+        this->row_upper[entry.index] -= entry.value * value;
+        this->row_size[entry.index]--;
+      }
+    }
+    this->objective_offset += this->cost[col] * value;
+  }
+  /*! Remove a row whose dual is zero in postsolve*/
+  void free_row(size_t row) {
+    this->record(Reduction::free_row, row, npos, npos, BasisStatus::basic,
+                 &this->row_entries[row], true, npos, {});
+    this->remove_row(row);
+  }
+  /*! Set the bounds of a column, failing when they cross*/
+  bool set_bounds(size_t col, Scalar lower, Scalar upper) {
+    if (this->exceeds(lower, upper)) {
+      this->result = PresolveStatus::infeasible;
+      return false;
+    }
+    if (lower > upper) {
+      lower = upper = (lower + upper) / 2;
+    }
+    this->col_lower[col] = lower;
+    this->col_upper[col] = upper;
+    return true;
+  }
+
+  // SECTION: Column reductions
+  /*! Remove empty, fixed and dominated columns*/
+  bool column_pass() {
+    bool changed = false;
+    Scalar tolerance = this->options.tolerance;
+    for (size_t j = 0; j < this->ncols; j++) {
+      if (!this->col_active[j]) {
+        continue;
+      }
+      Scalar lower = this->col_lower[j];
+      Scalar upper = this->col_upper[j];
+      if (lower == upper) {
+        this->fix_column(j, lower, BasisStatus::at_lower);
+        changed = true;
+        continue;
+      }
+      Scalar c = this->cost[j];
+      // The sign the reduced cost c_j - sum_i a_ij y_i is known to have:
+      // +1 (or -1) when every a_ij y_i is <= 0 (or >= 0) for all duals
+      // with the right signs
+      int sign = 0;
+      if (this->col_size[j] == 0) {
+        sign = c > Scalar{0} ? 1 : (c < Scalar{0} ? -1 : 0);
+        if (sign == 0) {
+          if (std::isfinite(lower)) {
+            this->fix_column(j, lower, BasisStatus::at_lower);
+          } else if (std::isfinite(upper)) {
+            this->fix_column(j, upper, BasisStatus::at_upper);
+          } else {
+            this->fix_column(j, 0, BasisStatus::free);
+          }
+          changed = true;
+          continue;
+        }
+      } else if (this->options.dominated_columns &&
+                 std::abs(c) > tolerance) {
+        bool nonpositive = true;
+        bool nonnegative = true;
+        for (Entry const &entry : this->col_entries[j]) {
+          if (!this->live_in_col(entry)) {
+            continue;
+          }
+          // y_i >= 0 only if the row has a lower side, <= 0 only if it has
+          // an upper side
+          bool y_may_be_positive = std::isfinite(this->row_lower[entry.index]);
+          bool y_may_be_negative = std::isfinite(this->row_upper[entry.index]);
+          bool positive = entry.value > Scalar{0};
+          nonpositive = nonpositive && (positive ? !y_may_be_positive
+                                                 : !y_may_be_negative);
+          nonnegative = nonnegative && (positive ? !y_may_be_negative
+                                                 : !y_may_be_positive);
+        }
+        if (c > Scalar{0} && nonpositive) {
+          sign = 1;
+        } else if (c < Scalar{0} && nonnegative) {
+          sign = -1;
+        }
+      }
+      if (sign == 0) {
+        continue;
+      }
+      Scalar bound = sign > 0 ? lower : upper;
+      if (!std::isfinite(bound)) {
+        this->result = PresolveStatus::unbounded;
+        return changed;
+      }
+      this->fix_column(j, bound,
+                       sign > 0 ? BasisStatus::at_lower
+                                : BasisStatus::at_upper);
+      changed = true;
+    }
+    return changed;
+  }
+  /*! Remove column singletons: implied free ones of equality rows (with
+   * their row) and cost free ones (folding their bounds into the row)*/
+  bool singleton_column_pass() {
+    bool changed = false;
+    for (size_t j = 0; j < this->ncols; j++) {
+      if (!this->col_active[j] || this->col_size[j] != 1) {
+        continue;
+      }
+      Entry const entry = this->first_in_col(j);
+      size_t i = entry.index;
+      Scalar a = entry.value;
+      Scalar lower = this->col_lower[j];
+      Scalar upper = this->col_upper[j];
+      if (this->row_lower[i] == this->row_upper[i]) {
+        // Bounds of x_j = (rhs - rest) / a implied by the rest of the row
+        Scalar rhs = this->row_lower[i];
+        Activity bounds = this->activity(i);
+        auto [low, high] = this->contribution(Entry{j, a});
+        Scalar rest_min =
+            bounds.min_infinite > (std::isfinite(low) ? 0u : 1u)
+                ? -infinity<Scalar>
+                : bounds.min - (std::isfinite(low) ? low : Scalar{0});
+        Scalar rest_max =
+            bounds.max_infinite > (std::isfinite(high) ? 0u : 1u)
+                ? infinity<Scalar>
+                : bounds.max - (std::isfinite(high) ? high : Scalar{0});
+        auto [implied_lower, implied_upper] =
+            divide_bounds(a, rhs - rest_max, rhs - rest_min);
+        bool free =
+            (!std::isfinite(lower) || !this->exceeds(lower, implied_lower)) &&
+            (!std::isfinite(upper) || !this->exceeds(implied_upper, upper));
+        if (free) {
+          this->record(Reduction::free_column, i, j, npos, BasisStatus::basic,
+                       &this->row_entries[i], true, j,
+                       {a, rhs, this->cost[j]});
+          // c_l x_l + c_j (rhs - sum_l a_il x_l) / a
+          Scalar ratio = this->cost[j] / a;
+          for (Entry const &other : this->row_entries[i]) {
+            if (this->live_in_row(other) && other.index != j) {
+              this->cost[other.index] -= ratio * other.value;
+            }
+          }
+          this->objective_offset += ratio * rhs;
+          this->col_active[j] = 0;
+          this->remove_row(i);
+          changed = true;
+          continue;
+        }
+      }
+      if (this->cost[j] != Scalar{0}) {
+        continue;
+      }
+      // rl <= a x_j + rest <= ru with l <= x_j <= u
+      Scalar old_lower = this->row_lower[i];
+      Scalar old_upper = this->row_upper[i];
+      this->record(Reduction::slack_column, i, j, npos, BasisStatus::basic,
+                   nullptr, false, npos,
+                   {a, lower, upper, old_lower, old_upper});
+      if (a > Scalar{0}) {
+        this->row_lower[i] = old_lower - a * upper;
+        this->row_upper[i] = old_upper - a * lower;
+      } else {
+        this->row_lower[i] = old_lower - a * lower;
+        this->row_upper[i] = old_upper - a * upper;
+      }
+      this->col_active[j] = 0;
+      this->row_size[i]--;
+      changed = true;
+    }
+    return changed;
+  }
+
+  // SECTION: Row reductions
+  /*! Remove empty, singleton, redundant and forcing rows, drop redundant
+   * row sides and substitute doubleton equations*/
+  bool row_pass() {
+    bool changed = false;
+    for (size_t i = 0; i < this->nrows; i++) {
+      if (!this->row_active[i]) {
+        continue;
+      }
+      if (this->row_size[i] == 0) {
+        if (this->exceeds(this->row_lower[i], 0) ||
+            this->exceeds(0, this->row_upper[i])) {
+          this->result = PresolveStatus::infeasible;
+          return changed;
+        }
+        this->free_row(i);
+        changed = true;
+        continue;
+      }
+      if (this->row_size[i] == 1 && this->options.singleton_rows) {
+        if (!this->singleton_row(i)) {
+          return changed;
+        }
+        changed = true;
+        continue;
+      }
+      if (this->options.bound_tightening) {
+        int outcome = this->activity_reductions(i);
+        if (outcome < 0) {
+          return changed;
+        }
+        changed = changed || outcome > 0;
+        if (!this->row_active[i]) {
+          continue;
+        }
+      }
+      if (this->row_size[i] == 2 && this->options.doubleton_equations &&
+          this->row_lower[i] == this->row_upper[i]) {
+        if (this->doubleton_equation(i)) {
+          changed = true;
+        }
+        if (this->result != PresolveStatus::reduced) {
+          return changed;
+        }
+      }
+    }
+    return changed;
+  }
+  /*! Turn a row with one entry into bounds of its column*/
+  bool singleton_row(size_t i) {
+    Entry const entry = this->first_in_row(i);
+    size_t j = entry.index;
+    Scalar a = entry.value;
+    Scalar lower = this->col_lower[j];
+    Scalar upper = this->col_upper[j];
+    Scalar implied_lower =
+        (a > Scalar{0} ? this->row_lower[i] : this->row_upper[i]) / a;
+    Scalar implied_upper =
+        (a > Scalar{0} ? this->row_upper[i] : this->row_lower[i]) / a;
+    this->record(Reduction::singleton_row, i, j, npos, BasisStatus::basic,
+                 nullptr, false, npos,
+                 {a, lower, upper, this->row_lower[i], this->row_upper[i]});
+    this->remove_row(i);
+    return this->set_bounds(j, std::max(lower, implied_lower),
+                            std::min(upper, implied_upper));
+  }
+  /*! Reductions from the bounds on the activity of a row.
+   *
+   * @return -1 if the problem is infeasible, 1 if the row changed, 0
+   * otherwise
+   * */
+  int activity_reductions(size_t i) {
+    Activity bounds = this->activity(i);
+    Scalar low = bounds.lower();
+    Scalar high = bounds.upper();
+    Scalar lower = this->row_lower[i];
+    Scalar upper = this->row_upper[i];
+    if (this->exceeds(low, upper) || this->exceeds(lower, high)) {
+      this->result = PresolveStatus::infeasible;
+      return -1;
+    }
+    // Forcing rows: the row can only be satisfied with every column at the
+    // bound reaching one side
+    bool force_lower = std::isfinite(high) && !this->exceeds(high, lower);
+    bool force_upper = std::isfinite(low) && !this->exceeds(upper, low);
+    if (force_lower || force_upper) {
+      this->record(Reduction::forcing_row, i, npos, npos,
+                   force_lower ? BasisStatus::at_lower : BasisStatus::at_upper,
+                   &this->row_entries[i], true, npos, {});
+      this->remove_row(i);
+      for (Entry const &entry : this->row_entries[i]) {
+        if (!this->live_in_row(entry)) {
+          continue;
+        }
+        size_t j = entry.index;
+        bool to_upper = (entry.value > Scalar{0}) == force_lower;
+        if (this->col_lower[j] == this->col_upper[j]) {
+          this->fix_column(j, this->col_lower[j], BasisStatus::at_lower);
+        } else if (to_upper) {
+          this->fix_column(j, this->col_upper[j], BasisStatus::at_upper);
+        } else {
+          this->fix_column(j, this->col_lower[j], BasisStatus::at_lower);
+        }
+      }
+      return 1;
+    }
+    if (low >= lower && high <= upper) {
+      this->free_row(i);
+      return 1;
+    }
+    int changed = 0;
+    if (low >= lower && std::isfinite(lower)) {
+      this->row_lower[i] = -infinity<Scalar>;
+      changed = 1;
+    }
+    if (high <= upper && std::isfinite(upper)) {
+      this->row_upper[i] = infinity<Scalar>;
+      changed = 1;
+    }
+    return changed;
+  }
+  /*! Substitute out one variable of an equation a x_j + b x_k = rhs.
+   *
+   * @return Whether the substitution was made
+   * */
+  bool doubleton_equation(size_t e) {
+    Entry first{npos, 0};
+    Entry second{npos, 0};
+    for (Entry const &entry : this->row_entries[e]) {
+      if (this->live_in_row(entry)) {
+        (first.index == npos ? first : second) = entry;
+      }
+    }
+    // Eliminate the column with fewer entries, unless its coefficient is
+    // much smaller than the other
+    if (this->col_size[second.index] < this->col_size[first.index]) {
+      std::swap(first, second);
+    }
+    if (std::abs(first.value) < 1e-3 * std::abs(second.value)) {
+      std::swap(first, second);
+      if (std::abs(first.value) < 1e-3 * std::abs(second.value)) {
+        return false;
+      }
+    }
+    size_t k = first.index;
+    size_t j = second.index;
+    Scalar b = first.value;
+    Scalar a = second.value;
+    Scalar rhs = this->row_lower[e];
+    Scalar lower_k = this->col_lower[k];
+    Scalar upper_k = this->col_upper[k];
+    Scalar lower_j = this->col_lower[j];
+    Scalar upper_j = this->col_upper[j];
+    this->record(Reduction::doubleton_equation, e, j, k, BasisStatus::basic,
+                 &this->col_entries[k], false, e,
+                 {a, b, rhs, this->cost[k], lower_j, upper_j, lower_k,
+                  upper_k});
+    this->remove_row(e);
+    this->col_active[k] = 0;
+    // x_k = (rhs - a x_j) / b in every other row and the objective
+    Scalar ratio = a / b;
+    for (Entry const &entry : this->col_entries[k]) {
+      size_t r = entry.index;
+      if (!this->row_active[r] || entry.value == Scalar{0}) {
+        continue;
+      }
+      this->row_size[r]--;
+      Scalar shift = entry.value * rhs / b;
+      this->row_lower[r] -= shift;
+      this->row_upper[r] -= shift;
+      this->add_coefficient(r, j, -entry.value * ratio);
+    }
+    this->objective_offset += this->cost[k] * rhs / b;
+    this->cost[j] -= this->cost[k] * ratio;
+    // Bounds of x_k become bounds of x_j = (rhs - b x_k) / a
+    Scalar from_lower = (rhs - b * lower_k) / a;
+    Scalar from_upper = (rhs - b * upper_k) / a;
+    return this->set_bounds(
+        j, std::max(lower_j, std::min(from_lower, from_upper)),
+        std::min(upper_j, std::max(from_lower, from_upper)));
+  }
+  /*! Merge rows which are multiples of an earlier row, found by hashing
+   * the pattern and normalized values of every row*/
+  bool duplicate_row_pass() {
+    bool changed = false;
+    std::vector<Entry> sorted;
+    std::vector<size_t> offset(this->nrows + 1, 0);
+    for (size_t i = 0; i < this->nrows; i++) {
+      if (this->row_active[i] && this->row_size[i] >= 2) {
+        for (Entry const &entry : this->row_entries[i]) {
+          if (this->live_in_row(entry)) {
+            sorted.push_back(entry);
+          }
+        }
+        std::sort(sorted.begin() + offset[i], sorted.end(),
+                  [](Entry const &left, Entry const &right) {
+                    return left.index < right.index;
+                  });
+      }
+      offset[i + 1] = sorted.size();
+    }
+    std::unordered_map<uint64_t, size_t> heads;
+    std::vector<size_t> next(this->nrows, npos);
+    std::vector<uint64_t> key;
+    for (size_t i = 0; i < this->nrows; i++) {
+      if (offset[i] == offset[i + 1]) {
+        continue;
+      }
+      Scalar leading = sorted[offset[i]].value;
+      key.clear();
+      for (size_t p = offset[i]; p < offset[i + 1]; p++) {
+        // Round the normalized values, so rows differing by the rounding
+        // of the multiplication still collide
+        float normalized = static_cast<float>(sorted[p].value / leading);
+        uint32_t bits;
+        std::memcpy(&bits, &normalized, sizeof(bits));
+        key.push_back(sorted[p].index);
+        key.push_back(bits);
+      }
+      uint64_t hash =
+          teensymat::xxhash64(key.data(), key.size() * sizeof(uint64_t));
+      auto [head, inserted] = heads.try_emplace(hash, i);
+      if (inserted) {
+        continue;
+      }
+      size_t match = npos;
+      for (size_t r = head->second; r != npos; r = next[r]) {
+        if (this->row_active[r] && this->is_multiple(sorted, offset, i, r)) {
+          match = r;
+          break;
+        }
+      }
+      if (match == npos) {
+        next[i] = head->second;
+        head->second = i;
+        continue;
+      }
+      if (!this->merge_rows(i, match,
+                            leading / sorted[offset[match]].value)) {
+        return changed;
+      }
+      changed = true;
+    }
+    return changed;
+  }
+  /*! Whether sorted row i is a multiple of sorted row r*/
+  bool is_multiple(std::vector<Entry> const &sorted,
+                   std::vector<size_t> const &offset, size_t i,
+                   size_t r) const {
+    size_t length = offset[i + 1] - offset[i];
+    if (offset[r + 1] - offset[r] != length) {
+      return false;
+    }
+    Scalar lambda = sorted[offset[i]].value / sorted[offset[r]].value;
+    for (size_t p = 0; p < length; p++) {
+      Entry const &left = sorted[offset[i] + p];
+      Entry const &right = sorted[offset[r] + p];
+      if (left.index != right.index ||
+          std::abs(left.value - lambda * right.value) >
+              1e-12 * std::abs(left.value)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  /*! Remove row k = lambda * row i, intersecting its bounds into row i*/
+  bool merge_rows(size_t k, size_t i, Scalar lambda) {
+    Scalar lower = this->row_lower[i];
+    Scalar upper = this->row_upper[i];
+    this->record(Reduction::duplicate_row, k, npos, i, BasisStatus::basic,
+                 nullptr, false, npos,
+                 {lambda, lower, upper, this->row_lower[k],
+                  this->row_upper[k]});
+    this->remove_row(k);
+    Scalar from_lower = this->row_lower[k] / lambda;
+    Scalar from_upper = this->row_upper[k] / lambda;
+    if (lambda < Scalar{0}) {
+      std::swap(from_lower, from_upper);
+    }
+    lower = std::max(lower, from_lower);
+    upper = std::min(upper, from_upper);
+    if (this->exceeds(lower, upper)) {
+      this->result = PresolveStatus::infeasible;
+      return false;
+    }
+    // Rounding in the division can leave an equality as a sliver
+    if (lower > upper || this->near(upper, lower)) {
+      lower = upper = (lower + upper) / 2;
+    }
+    this->row_lower[i] = lower;
+    this->row_upper[i] = upper;
+    return true;
+  }
+
+  // SECTION: Setup
+  /*! Load the working problem*/
+  void load() {
+    size_t m = this->nrows;
+    size_t n = this->ncols;
+    this->row_entries.assign(m, {});
+    this->col_entries.assign(n, {});
+    this->row_size.assign(m, 0);
+    this->col_size.assign(n, 0);
+    auto const &col_ptr = this->original.constraints.get_col_ptr();
+    auto const &row_idx = this->original.constraints.get_row_idx();
+    Scalar const *values = this->original.constraints.get_values()->data();
+    for (size_t j = 0; j < n; j++) {
+      for (size_t k = col_ptr[j]; k < col_ptr[j + 1]; k++) {
+        if (values[k] == Scalar{0}) {
+          continue;
+        }
+        this->col_entries[j].push_back(Entry{row_idx[k], values[k]});
+        this->row_entries[row_idx[k]].push_back(Entry{j, values[k]});
+        this->row_size[row_idx[k]]++;
+        this->col_size[j]++;
+      }
+    }
+    this->row_active.assign(m, 1);
+    this->col_active.assign(n, 1);
+    this->cost = this->original.objective;
+    this->col_lower = this->original.col_lower;
+    this->col_upper = this->original.col_upper;
+    this->row_lower = this->original.row_lower;
+    this->row_upper = this->original.row_upper;
+    this->objective_offset = this->original.objective_offset;
+  }
+  /*! Run the passes until nothing changes*/
+  void run() {
+    for (size_t j = 0; j < this->ncols; j++) {
+      if (!this->set_bounds(j, this->col_lower[j], this->col_upper[j])) {
+        return;
+      }
+    }
+    bool changed = true;
+    while (changed && this->passes < this->options.max_passes) {
+      this->passes++;
+      changed = this->column_pass();
+      if (this->result != PresolveStatus::reduced) {
+        return;
+      }
+      changed = this->row_pass() || changed;
+      if (this->result != PresolveStatus::reduced) {
+        return;
+      }
+      if (this->options.singleton_columns) {
+        changed = this->singleton_column_pass() || changed;
+      }
+      if (this->options.duplicate_rows) {
+        changed = this->duplicate_row_pass() || changed;
+        if (this->result != PresolveStatus::reduced) {
+          return;
+        }
+      }
+    }
+  }
+  /*! Build the reduced problem from the working problem, and release the
+   * working storage*/
+  void build_reduced() {
+    std::vector<size_t> row_position(this->nrows, npos);
+    for (size_t i = 0; i < this->nrows; i++) {
+      if (this->row_active[i]) {
+        row_position[i] = this->row_map.size();
+        this->row_map.push_back(i);
+        this->reduced.row_lower.push_back(this->row_lower[i]);
+        this->reduced.row_upper.push_back(this->row_upper[i]);
+      }
+    }
+    std::vector<size_t> col_ptr{0};
+    std::vector<size_t> row_idx;
+    std::vector<Scalar> values;
+    std::vector<Entry> column;
+    for (size_t j = 0; j < this->ncols; j++) {
+      if (!this->col_active[j]) {
+        continue;
+      }
+      this->col_map.push_back(j);
+      this->reduced.objective.push_back(this->cost[j]);
+      this->reduced.col_lower.push_back(this->col_lower[j]);
+      this->reduced.col_upper.push_back(this->col_upper[j]);
+      column.clear();
+      for (Entry const &entry : this->col_entries[j]) {
+        if (this->live_in_col(entry)) {
+          column.push_back(Entry{row_position[entry.index], entry.value});
+        }
+      }
+      std::sort(column.begin(), column.end(),
+                [](Entry const &left, Entry const &right) {
+                  return left.index < right.index;
+                });
+      for (Entry const &entry : column) {
+        row_idx.push_back(entry.index);
+        values.push_back(entry.value);
+      }
+      col_ptr.push_back(row_idx.size());
+    }
+    this->reduced.constraints = teensymat::SparseMatrix<Scalar>(
+        this->row_map.size(), this->col_map.size(), std::move(col_ptr),
+        std::move(row_idx), std::move(values));
+    this->reduced.objective_offset = this->objective_offset;
+    this->row_entries = {};
+    this->col_entries = {};
+  }
+
+  // SECTION: Postsolve
+  /*! Whether a dual (or reduced cost) of some sign belongs to a bound
+   * implied by a removed row rather than to the variable's own bound, by
+   * which of the two the value is closer to (ties stay with the variable,
+   * and interior solutions are only approximately at either)*/
+  static bool misplaced(Scalar dual, Scalar value, Scalar lower,
+                        Scalar upper, Scalar implied_lower,
+                        Scalar implied_upper) {
+    auto closer = [value](Scalar implied, Scalar own) {
+      return std::abs(value - implied) < std::abs(value - own);
+    };
+    return (dual > Scalar{0} && closer(implied_lower, lower)) ||
+           (dual < Scalar{0} && closer(implied_upper, upper));
+  }
+  /*! Bounds on x from lower <= a x <= upper*/
+  static std::pair<Scalar, Scalar> divide_bounds(Scalar a, Scalar lower,
+                                                 Scalar upper) {
+    if (a > Scalar{0}) {
+      return {lower / a, upper / a};
+    }
+    return {upper / a, lower / a};
+  }
+  /*! Status of a nonbasic variable at the bound closest to its value*/
+  static BasisStatus bound_status(Scalar value, Scalar lower, Scalar upper) {
+    if (!std::isfinite(lower) && !std::isfinite(upper)) {
+      return BasisStatus::free;
+    }
+    if (!std::isfinite(upper)) {
+      return BasisStatus::at_lower;
+    }
+    if (!std::isfinite(lower)) {
+      return BasisStatus::at_upper;
+    }
+    return std::abs(value - lower) <= std::abs(value - upper)
+               ? BasisStatus::at_lower
+               : BasisStatus::at_upper;
+  }
+
+public:
+  // SECTION: Constructors
+  /*! Presolve a problem (which is copied, to map solutions back).
+   *
+   * @param problem The LP to presolve
+   * @param options Options of the presolve
+   * */
+  explicit Presolve(LPProblem<Scalar> problem,
+                    PresolveOptions<Scalar> const &options = {})
+      : original(std::move(problem)), options(options),
+        result(PresolveStatus::reduced),
+        nrows(this->original.get_nrows()), ncols(this->original.get_ncols()),
+        passes(0) {
+    this->original.validate();
+    this->load();
+    this->run();
+    if (this->result == PresolveStatus::reduced) {
+      this->build_reduced();
+    }
+  }
+
+  // SECTION: Getters
+  /*! Get the outcome of the presolve*/
+  PresolveStatus get_status() const { return this->result; }
+  /*! Get the reduced problem (empty unless the status is reduced)*/
+  LPProblem<Scalar> const &get_reduced() const { return this->reduced; }
+  /*! Get the original index of each row of the reduced problem*/
+  std::vector<size_t> const &get_row_map() const { return this->row_map; }
+  /*! Get the original index of each column of the reduced problem*/
+  std::vector<size_t> const &get_col_map() const { return this->col_map; }
+  /*! Get the number of reductions on the postsolve stack*/
+  size_t get_num_reductions() const { return this->records.size(); }
+  /*! Get the number of passes made*/
+  size_t get_num_passes() const { return this->passes; }
+
+  // SECTION: Postsolve
+  /*! Map a solution of the reduced problem back to the original problem.
+   *
+   * Basis statuses are restored when the solution has them, such that
+   * the original basis again has one basic variable per row.
+   *
+   * @param solution Solution of the reduced problem
+   * @return Solution of the original problem
+   * */
+  LPSolution<Scalar> postsolve(LPSolution<Scalar> const &solution) const {
+    if (this->result != PresolveStatus::reduced) {
+      throw std::runtime_error("Presolve did not produce a reduced problem");
+    }
+    size_t m = this->nrows;
+    size_t n = this->ncols;
+    size_t reduced_m = this->row_map.size();
+    size_t reduced_n = this->col_map.size();
+    if (solution.x.size() != reduced_n ||
+        solution.reduced_costs.size() != reduced_n ||
+        solution.row_duals.size() != reduced_m ||
+        solution.row_activity.size() != reduced_m) {
+      throw std::range_error("Solution does not match the reduced problem");
+    }
+    bool with_basis = solution.col_status.size() == reduced_n &&
+                      solution.row_status.size() == reduced_m;
+    std::vector<Scalar> x(n, 0), d(n, 0), y(m, 0), activity(m, 0);
+    std::vector<BasisStatus> col_status(with_basis ? n : 0,
+                                        BasisStatus::basic);
+    std::vector<BasisStatus> row_status(with_basis ? m : 0,
+                                        BasisStatus::basic);
+    for (size_t p = 0; p < reduced_n; p++) {
+      size_t j = this->col_map[p];
+      x[j] = solution.x[p];
+      d[j] = solution.reduced_costs[p];
+      if (with_basis) {
+        col_status[j] = solution.col_status[p];
+      }
+    }
+    for (size_t p = 0; p < reduced_m; p++) {
+      size_t i = this->row_map[p];
+      y[i] = solution.row_duals[p];
+      activity[i] = solution.row_activity[p];
+      if (with_basis) {
+        row_status[i] = solution.row_status[p];
+      }
+    }
+    auto is_basic = [&](std::vector<BasisStatus> const &status,
+                        size_t index) {
+      return with_basis && status[index] == BasisStatus::basic;
+    };
+    auto set_status = [&](std::vector<BasisStatus> &status, size_t index,
+                          BasisStatus value) {
+      if (with_basis) {
+        status[index] = value;
+      }
+    };
+    for (auto record = this->records.rbegin(); record != this->records.rend();
+         record++) {
+      Scalar const *data = this->scalars.data() + record->data;
+      Entry const *begin = this->stored.data() + record->begin;
+      Entry const *end = this->stored.data() + record->end;
+      size_t i = record->row;
+      size_t j = record->col;
+      switch (record->kind) {
+      case Reduction::fixed_column: {
+        x[j] = data[0];
+        d[j] = data[1];
+        for (Entry const *entry = begin; entry != end; entry++) {
+          d[j] -= entry->value * y[entry->index];
+          activity[entry->index] += entry->value * data[0];
+        }
+        set_status(col_status, j, record->status);
+        break;
+      }
+      case Reduction::free_row: {
+        for (Entry const *entry = begin; entry != end; entry++) {
+          activity[i] += entry->value * x[entry->index];
+        }
+        set_status(row_status, i, BasisStatus::basic);
+        break;
+      }
+      case Reduction::singleton_row: {
+        Scalar a = data[0];
+        activity[i] = a * x[j];
+        set_status(row_status, i, BasisStatus::basic);
+        auto [implied_lower, implied_upper] =
+            divide_bounds(a, data[3], data[4]);
+        if (misplaced(d[j], x[j], data[1], data[2], implied_lower,
+                      implied_upper) &&
+            !is_basic(col_status, j)) {
+          // The bound from the row is active: its dual moves to the row
+          y[i] = d[j] / a;
+          d[j] = 0;
+          set_status(col_status, j, BasisStatus::basic);
+          set_status(row_status, i,
+                     bound_status(activity[i], data[3], data[4]));
+        }
+        break;
+      }
+      case Reduction::doubleton_equation: {
+        size_t k = record->other;
+        Scalar a = data[0];
+        Scalar b = data[1];
+        Scalar rhs = data[2];
+        x[k] = (rhs - a * x[j]) / b;
+        Scalar dual_k = data[3];
+        for (Entry const *entry = begin; entry != end; entry++) {
+          dual_k -= entry->value * y[entry->index];
+          activity[entry->index] += entry->value * rhs / b;
+        }
+        activity[i] = rhs;
+        set_status(row_status, i, BasisStatus::at_lower);
+        // Bounds of x_k as bounds of x_j = (rhs - b x_k) / a
+        auto [implied_lower, implied_upper] =
+            divide_bounds(-a / b, data[6] - rhs / b, data[7] - rhs / b);
+        if (misplaced(d[j], x[j], data[4], data[5], implied_lower,
+                      implied_upper) &&
+            !is_basic(col_status, j)) {
+          // The bound from x_k is active: x_k carries the reduced cost
+          Scalar dual_j = d[j] + a / b * dual_k;
+          y[i] = dual_j / a;
+          d[j] = 0;
+          d[k] = dual_k - b * y[i];
+          set_status(col_status, j, BasisStatus::basic);
+          set_status(col_status, k, bound_status(x[k], data[6], data[7]));
+        } else {
+          y[i] = dual_k / b;
+          d[k] = 0;
+          set_status(col_status, k, BasisStatus::basic);
+        }
+        break;
+      }
+      case Reduction::slack_column: {
+        Scalar a = data[0];
+        Scalar lower = data[1];
+        Scalar upper = data[2];
+        Scalar rest = activity[i];
+        // Values of x_j keeping the row within its original bounds
+        Scalar low = (a > Scalar{0} ? data[3] - rest : data[4] - rest) / a;
+        Scalar high = (a > Scalar{0} ? data[4] - rest : data[3] - rest) / a;
+        bool row_basic = !with_basis || row_status[i] == BasisStatus::basic;
+        BasisStatus status = BasisStatus::basic;
+        if (std::isfinite(lower) && !this->exceeds(low, lower) &&
+            !this->exceeds(lower, high)) {
+          x[j] = lower;
+          status = BasisStatus::at_lower;
+        } else if (std::isfinite(upper) && !this->exceeds(low, upper) &&
+                   !this->exceeds(upper, high)) {
+          x[j] = upper;
+          status = BasisStatus::at_upper;
+        } else if (!std::isfinite(low) && !std::isfinite(high)) {
+          x[j] = std::clamp(Scalar{0}, lower, upper);
+          status = bound_status(x[j], lower, upper);
+        } else {
+          x[j] = std::clamp(std::isfinite(low) ? low : high, lower, upper);
+          status = row_basic ? BasisStatus::basic
+                             : bound_status(x[j], lower, upper);
+        }
+        d[j] = -a * y[i];
+        activity[i] = rest + a * x[j];
+        set_status(col_status, j, status);
+        if (status == BasisStatus::basic || !row_basic) {
+          set_status(row_status, i,
+                     bound_status(activity[i], data[3], data[4]));
+        }
+        break;
+      }
+      case Reduction::free_column: {
+        Scalar a = data[0];
+        Scalar rest = 0;
+        for (Entry const *entry = begin; entry != end; entry++) {
+          rest += entry->value * x[entry->index];
+        }
+        x[j] = (data[1] - rest) / a;
+        y[i] = data[2] / a;
+        d[j] = 0;
+        activity[i] = data[1];
+        set_status(col_status, j, BasisStatus::basic);
+        set_status(row_status, i, BasisStatus::at_lower);
+        break;
+      }
+      case Reduction::duplicate_row: {
+        size_t other = record->other;
+        Scalar lambda = data[0];
+        activity[i] = lambda * activity[other];
+        set_status(row_status, i, BasisStatus::basic);
+        auto [implied_lower, implied_upper] =
+            divide_bounds(lambda, data[3], data[4]);
+        if (misplaced(y[other], activity[other], data[1], data[2],
+                      implied_lower, implied_upper) &&
+            !is_basic(row_status, other)) {
+          // The bound from this row is active: the dual moves here
+          y[i] = y[other] / lambda;
+          y[other] = 0;
+          set_status(row_status, other, BasisStatus::basic);
+          set_status(row_status, i,
+                     bound_status(activity[i], data[3], data[4]));
+        }
+        break;
+      }
+      case Reduction::forcing_row: {
+        // The smallest dual of the side's sign making every reduced cost
+        // agree with the bound its column is fixed at
+        bool at_lower = record->status == BasisStatus::at_lower;
+        Scalar dual = 0;
+        size_t entering = npos;
+        for (Entry const *entry = begin; entry != end; entry++) {
+          activity[i] += entry->value * x[entry->index];
+          Scalar ratio = d[entry->index] / entry->value;
+          if (at_lower ? ratio > dual : ratio < dual) {
+            dual = ratio;
+            entering = entry->index;
+          }
+        }
+        y[i] = dual;
+        for (Entry const *entry = begin; entry != end; entry++) {
+          d[entry->index] -= entry->value * dual;
+        }
+        set_status(row_status, i, BasisStatus::basic);
+        if (entering != npos) {
+          d[entering] = 0;
+          set_status(col_status, entering, BasisStatus::basic);
+          set_status(row_status, i, record->status);
+        }
+        break;
+      }
+      }
+    }
+    LPSolution<Scalar> result;
+    result.status = solution.status;
+    result.iterations = solution.iterations;
+    result.x = std::move(x);
+    result.row_activity = this->original.constraints.multiply(result.x);
+    result.row_duals = std::move(y);
+    result.reduced_costs = this->original.objective;
+    this->original.constraints.gaxpy_transpose(-1, result.row_duals.data(),
+                                               result.reduced_costs.data());
+    result.objective = this->original.evaluate(result.x);
+    result.col_status = std::move(col_status);
+    result.row_status = std::move(row_status);
+    return result;
+  }
+};
+
+/*! Presolve a problem, solve the reduced problem and postsolve its
+ * solution.
+ *
+ * When presolve proves the problem infeasible or unbounded, the returned
+ * solution only has its status set. A problem removed entirely by presolve
+ * is not passed to the solver.
+ *
+ * @param problem The LP to solve
+ * @param solver Callable returning the LPSolution of an LPProblem
+ * @param options Options of the presolve
+ * @return The solution of the original problem
+ * */
+template <typename Scalar, typename Solver>
+LPSolution<Scalar>
+solve_presolved(LPProblem<Scalar> const &problem, Solver &&solver,
+                PresolveOptions<Scalar> const &options = {}) {
+  Presolve<Scalar> presolve{problem, options};
+  LPSolution<Scalar> solution;
+  switch (presolve.get_status()) {
+  case PresolveStatus::infeasible:
+    solution.status = LPStatus::infeasible;
+    return solution;
+  case PresolveStatus::unbounded:
+    solution.status = LPStatus::unbounded;
+    return solution;
+  default:
+    break;
+  }
+  LPProblem<Scalar> const &reduced = presolve.get_reduced();
+  if (reduced.get_nrows() == 0 && reduced.get_ncols() == 0) {
+    solution.status = LPStatus::optimal;
+  } else {
+    solution = solver(reduced);
+  }
+  return presolve.postsolve(solution);
+}
+} // namespace teensylp
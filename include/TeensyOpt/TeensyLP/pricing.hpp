@@ -0,0 +1,454 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyLP/lp_problem.hpp"
+#include "TeensyOpt/TeensyMat/indexed_vector.hpp"
+#include "TeensyOpt/TeensyMat/parallel.hpp"
+
+namespace teensylp {
+/*! Pricing rules for choosing the leaving row of the dual simplex*/
+enum class DualPricingRule {
+  /*! Largest bound violation*/
+  dantzig,
+  /*! Largest violation relative to Devex reference weights*/
+  devex,
+  /*! Largest violation relative to the exact norms of the rows of B^-1*/
+  steepest_edge,
+};
+
+/*! Pricing rules for choosing the entering column of the primal simplex*/
+enum class PrimalPricingRule {
+  /*! Largest reduced cost*/
+  dantzig,
+  /*! Largest reduced cost relative to Devex reference weights*/
+  devex,
+};
+
+/*! What a pricing strategy sees of a basis change. Variable j < ncols is a
+ * structural, variable ncols + i the logical of row i (column -e_i).*/
+template <typename Scalar> struct PivotData {
+  /*! Basis position of the leaving variable*/
+  size_t position;
+  /*! The entering variable*/
+  size_t entering;
+  /*! The leaving variable*/
+  size_t leaving;
+  /*! The pivot element*/
+  Scalar alpha;
+  /*! Number of structural variables*/
+  size_t ncols;
+  /*! B^-1 a_q, indexed by basis position*/
+  teensymat::IndexedVector<Scalar> const *column;
+  /*! B^-T e_r, indexed by row (the logical part of the pivot row is -rho)*/
+  teensymat::IndexedVector<Scalar> const *rho;
+  /*! Structural part of the pivot row rho^T A (may be null for the dual
+   * simplex, in which case it is not used)*/
+  teensymat::IndexedVector<Scalar> const *pivot_row;
+  /*! B^-1 rho, indexed by basis position (only if requested)*/
+  teensymat::IndexedVector<Scalar> const *tau;
+  /*! Status of every variable before the change*/
+  std::vector<BasisStatus> const *status;
+  /*! Variable at each basis position before the change*/
+  std::vector<size_t> const *basic;
+};
+
+namespace pricing_detail {
+/*! Entries per task of the parallel pricing scans*/
+constexpr size_t scan_grain = 8192;
+/*! Weights are kept above this to guard against cancellation*/
+constexpr double min_weight = 1e-4;
+/*! Devex reference frameworks are reset when weights grow beyond this*/
+constexpr double devex_reset = 1e6;
+
+/*! Index k in [0, n) maximizing score(k), among those with positive score.
+ * Blocks of entries are scanned in parallel and ties go to the smallest
+ * index, so the choice does not depend on the number of threads.
+ *
+ * @return The index, or n if no score is positive
+ * */
+template <typename Scalar, typename Score>
+size_t parallel_argmax(size_t n, Score &&score) {
+  size_t n_blocks = (n + scan_grain - 1) / scan_grain;
+  std::vector<std::pair<Scalar, size_t>> best(n_blocks, {Scalar{0}, n});
+  teensymat::parallel_for(n, scan_grain, [&](size_t begin, size_t end) {
+    Scalar top = 0;
+    size_t chosen = n;
+    for (size_t k = begin; k < end; k++) {
+      Scalar value = score(k);
+      if (value > top) {
+        top = value;
+        chosen = k;
+      }
+    }
+    best[begin / scan_grain] = {top, chosen};
+  });
+  Scalar top = 0;
+  size_t chosen = n;
+  for (auto const &[value, index] : best) {
+    if (value > top) {
+      top = value;
+      chosen = index;
+    }
+  }
+  return chosen;
+}
+} // namespace pricing_detail
+
+// SECTION: Dual pricing
+/*! Strategy choosing the leaving row of the dual simplex: the basis
+ * position maximizing violation^2 / weight. Subclasses define how the
+ * weights (one per basis position) evolve with basis changes; the base
+ * class keeps them all at one (Dantzig's rule).
+ * */
+template <typename Scalar> class DualPricing {
+protected:
+  /*! Weight of each basis position*/
+  std::vector<Scalar> weights;
+
+public:
+  virtual ~DualPricing() = default;
+  /*! Reset the weights for a new basis (after a basis change the
+   * strategy did not see, such as set_basis or a data change). The base
+   * class sets them all to one.
+   *
+   * @param nrows Number of basis positions
+   * @param status Status of every variable in the new basis
+   * @param row_norm Squared norm of a row of B^-1 of the new basis, given
+   * its position (one BTRAN per call)
+   * */
+  virtual void reset(size_t nrows, std::vector<BasisStatus> const &status,
+                     std::function<Scalar(size_t)> const &row_norm) {
+    (void)status;
+    (void)row_norm;
+    this->weights.assign(nrows, 1);
+  }
+  /*! Whether update needs PivotData::tau (one extra FTRAN per iteration)*/
+  virtual bool needs_tau() const { return false; }
+  /*! Update the weights for a basis change (before it is applied).
+   *
+   * @param pivot The basis change
+   * */
+  virtual void update(PivotData<Scalar> const &pivot) { (void)pivot; }
+  /*! Get the weight of each basis position*/
+  std::vector<Scalar> const &get_weights() const { return this->weights; }
+  /*! Choose the leaving position among candidates.
+   *
+   * @param candidates Basis positions which may be infeasible
+   * @param violation Function giving the bound violation at a position (at
+   * most zero if feasible)
+   * @return Index into candidates of the best position, or
+   * candidates.size() if none is infeasible
+   * */
+  template <typename Violation>
+  size_t choose(std::vector<size_t> const &candidates,
+                Violation &&violation) const {
+    Scalar const *w = this->weights.data();
+    return pricing_detail::parallel_argmax<Scalar>(
+        candidates.size(), [&](size_t k) {
+          size_t position = candidates[k];
+          Scalar value = violation(position);
+          return value > 0 ? value * value / w[position] : Scalar{0};
+        });
+  }
+};
+
+/*! Dual Devex pricing: weights approximate the norms of the rows of
+ * B^-1 [A, -I] restricted to a reference framework of variables (the
+ * nonbasic ones at the last reset), updated from the pivot row and column
+ * at no extra solve.*/
+template <typename Scalar> class DualDevexPricing : public DualPricing<Scalar> {
+private:
+  /*! Whether each variable is in the reference framework*/
+  std::vector<char> reference;
+
+public:
+  void reset(size_t nrows, std::vector<BasisStatus> const &status,
+             std::function<Scalar(size_t)> const &row_norm) override {
+    (void)row_norm;
+    this->weights.assign(nrows, 1);
+    this->reference.resize(status.size());
+    for (size_t var = 0; var < status.size(); var++) {
+      this->reference[var] = status[var] != BasisStatus::basic;
+    }
+  }
+  void update(PivotData<Scalar> const &pivot) override {
+    std::vector<BasisStatus> const &status = *pivot.status;
+    // Reference norm of the pivot row (its basic entry is the leaving one)
+    Scalar norm = this->reference[pivot.leaving] ? 1 : 0;
+    if (pivot.pivot_row != nullptr) {
+      for (size_t j : pivot.pivot_row->index) {
+        if (this->reference[j] && status[j] != BasisStatus::basic) {
+          Scalar value = pivot.pivot_row->values[j];
+          norm += value * value;
+        }
+      }
+    }
+    for (size_t i : pivot.rho->index) {
+      size_t var = pivot.ncols + i;
+      if (this->reference[var] && status[var] != BasisStatus::basic) {
+        Scalar value = pivot.rho->values[i];
+        norm += value * value;
+      }
+    }
+    Scalar pivotal = std::max(norm, this->weights[pivot.position]);
+    Scalar const *values = pivot.column->values.data();
+    for (size_t i : pivot.column->index) {
+      if (i != pivot.position) {
+        Scalar ratio = values[i] / pivot.alpha;
+        this->weights[i] = std::max(this->weights[i], ratio * ratio * pivotal);
+      }
+    }
+    Scalar updated = std::max(pivotal / (pivot.alpha * pivot.alpha), Scalar{1});
+    this->weights[pivot.position] = updated;
+    if (updated > Scalar(pricing_detail::devex_reset)) {
+      // Start a new reference framework from the basis after this change
+      std::vector<BasisStatus> next = status;
+      next[pivot.entering] = BasisStatus::basic;
+      next[pivot.leaving] = BasisStatus::at_lower;
+      this->reset(this->weights.size(), next, {});
+    }
+  }
+};
+
+/*! Dual steepest edge pricing: weights are the exact squared norms of the
+ * rows of B^-1, updated with the Forrest-Goldfarb recurrence which needs
+ * tau = B^-1 rho_r (one extra FTRAN per iteration).
+ *
+ * On a reset the weights are one, which is exact for the slack basis. For
+ * any other basis they are then only reference weights, as in Devex, which
+ * the recurrence carries forward; exact_reset recomputes them instead with
+ * one BTRAN per row, which makes every warm start cost about as much as m
+ * extra solves.*/
+template <typename Scalar>
+class DualSteepestEdgePricing : public DualPricing<Scalar> {
+private:
+  /*! Whether a reset recomputes the exact weights of a non slack basis*/
+  bool exact_reset;
+
+public:
+  /*! Construct the strategy.
+   *
+   * @param exact_reset Recompute exact weights with one BTRAN per row when
+   * reset to a basis other than the slack basis, rather than starting
+   * from one
+   * */
+  explicit DualSteepestEdgePricing(bool exact_reset = false)
+      : exact_reset(exact_reset) {}
+  void reset(size_t nrows, std::vector<BasisStatus> const &status,
+             std::function<Scalar(size_t)> const &row_norm) override {
+    this->weights.assign(nrows, 1);
+    if (!this->exact_reset || !row_norm) {
+      return;
+    }
+    size_t ncols = status.size() - nrows;
+    bool slack = std::all_of(
+        status.begin() + ncols, status.end(),
+        [](BasisStatus value) { return value == BasisStatus::basic; });
+    if (slack) {
+      return;
+    }
+    Scalar floor = Scalar(pricing_detail::min_weight);
+    for (size_t position = 0; position < nrows; position++) {
+      this->weights[position] = std::max(row_norm(position), floor);
+    }
+  }
+  bool needs_tau() const override { return true; }
+  void update(PivotData<Scalar> const &pivot) override {
+    Scalar pivot_weight = 0;
+    for (size_t i : pivot.rho->index) {
+      Scalar value = pivot.rho->values[i];
+      pivot_weight += value * value;
+    }
+    Scalar const *alpha = pivot.column->values.data();
+    Scalar const *tau = pivot.tau->values.data();
+    Scalar floor = Scalar(pricing_detail::min_weight);
+    for (size_t i : pivot.column->index) {
+      if (i == pivot.position) {
+        continue;
+      }
+      Scalar ratio = alpha[i] / pivot.alpha;
+      this->weights[i] =
+          std::max(this->weights[i] + ratio * (ratio * pivot_weight - 2 * tau[i]),
+                   floor);
+    }
+    this->weights[pivot.position] =
+        std::max(pivot_weight / (pivot.alpha * pivot.alpha), floor);
+  }
+};
+
+// SECTION: Primal pricing
+/*! Strategy choosing the entering variable of the primal simplex: the
+ * variable maximizing infeasibility^2 / weight, where infeasibility is the
+ * sign violation of its reduced cost. The base class keeps all weights at
+ * one (Dantzig's rule).
+ *
+ * With more than one block the variables are split into that many
+ * contiguous blocks and only blocks are scanned until one has a candidate
+ * (partial pricing), resuming after it at the next iteration.
+ * */
+template <typename Scalar> class PrimalPricing {
+protected:
+  /*! Weight of each variable*/
+  std::vector<Scalar> weights;
+  /*! Number of blocks of partial pricing (1 for full pricing)*/
+  size_t blocks;
+  /*! Block where the next scan starts*/
+  mutable size_t next_block;
+
+public:
+  /*! Construct the strategy.
+   *
+   * @param blocks Number of blocks of partial pricing, 1 to scan all
+   * variables at every iteration
+   * */
+  explicit PrimalPricing(size_t blocks = 1)
+      : blocks(std::max<size_t>(blocks, 1)), next_block(0) {}
+  virtual ~PrimalPricing() = default;
+  /*! Reset all weights to one.
+   *
+   * @param status Status of every variable in the current basis
+   * */
+  virtual void reset(std::vector<BasisStatus> const &status) {
+    this->weights.assign(status.size(), 1);
+  }
+  /*! Update the weights for a basis change (before it is applied).
+   *
+   * @param pivot The basis change
+   * */
+  virtual void update(PivotData<Scalar> const &pivot) { (void)pivot; }
+  /*! Get the weight of each variable*/
+  std::vector<Scalar> const &get_weights() const { return this->weights; }
+  /*! Choose the entering variable.
+   *
+   * @param total Number of variables
+   * @param infeasibility Function giving the dual infeasibility of a
+   * variable (at most zero if it can not improve the objective)
+   * @return The chosen variable, or total if there is none
+   * */
+  template <typename Infeasibility>
+  size_t choose(size_t total, Infeasibility &&infeasibility) const {
+    Scalar const *w = this->weights.data();
+    auto score = [&](size_t var) {
+      Scalar value = infeasibility(var);
+      return value > 0 ? value * value / w[var] : Scalar{0};
+    };
+    if (this->blocks == 1) {
+      return pricing_detail::parallel_argmax<Scalar>(total, score);
+    }
+    size_t block_size = (total + this->blocks - 1) / this->blocks;
+    for (size_t scanned = 0; scanned < this->blocks; scanned++) {
+      size_t block = (this->next_block + scanned) % this->blocks;
+      size_t begin = std::min(total, block * block_size);
+      size_t end = std::min(total, begin + block_size);
+      size_t chosen = pricing_detail::parallel_argmax<Scalar>(
+          end - begin, [&](size_t k) { return score(begin + k); });
+      if (chosen < end - begin) {
+        this->next_block = (block + 1) % this->blocks;
+        return begin + chosen;
+      }
+    }
+    return total;
+  }
+};
+
+/*! Primal Devex pricing: weights approximate the norms of the edge
+ * directions restricted to a reference framework of variables (the
+ * nonbasic ones at the last reset), updated from the pivot column and row
+ * at no extra solve.*/
+template <typename Scalar>
+class PrimalDevexPricing : public PrimalPricing<Scalar> {
+private:
+  /*! Whether each variable is in the reference framework*/
+  std::vector<char> reference;
+
+public:
+  using PrimalPricing<Scalar>::PrimalPricing;
+  void reset(std::vector<BasisStatus> const &status) override {
+    this->weights.assign(status.size(), 1);
+    this->reference.resize(status.size());
+    for (size_t var = 0; var < status.size(); var++) {
+      this->reference[var] = status[var] != BasisStatus::basic;
+    }
+  }
+  void update(PivotData<Scalar> const &pivot) override {
+    std::vector<BasisStatus> const &status = *pivot.status;
+    // Reference norm of the edge of the entering variable: its own entry
+    // plus the entries of B^-1 a_q of basic reference variables
+    Scalar norm = this->reference[pivot.entering] ? 1 : 0;
+    std::vector<size_t> const &basic = *pivot.basic;
+    for (size_t i : pivot.column->index) {
+      if (this->reference[basic[i]]) {
+        Scalar value = pivot.column->values[i];
+        norm += value * value;
+      }
+    }
+    Scalar pivotal = std::max(norm, this->weights[pivot.entering]);
+    Scalar alpha = pivot.alpha;
+    auto raise = [&](size_t var, Scalar value) {
+      if (status[var] == BasisStatus::basic || var == pivot.entering) {
+        return;
+      }
+      Scalar ratio = value / alpha;
+      this->weights[var] = std::max(this->weights[var], ratio * ratio * pivotal);
+    };
+    if (pivot.pivot_row != nullptr) {
+      for (size_t j : pivot.pivot_row->index) {
+        raise(j, pivot.pivot_row->values[j]);
+      }
+    }
+    for (size_t i : pivot.rho->index) {
+      raise(pivot.ncols + i, -pivot.rho->values[i]);
+    }
+    Scalar updated = std::max(pivotal / (alpha * alpha), Scalar{1});
+    this->weights[pivot.leaving] = updated;
+    if (updated > Scalar(pricing_detail::devex_reset)) {
+      std::vector<BasisStatus> next = status;
+      next[pivot.entering] = BasisStatus::basic;
+      next[pivot.leaving] = BasisStatus::at_lower;
+      this->reset(next);
+    }
+  }
+};
+
+// SECTION: Factories
+/*! Create the dual pricing strategy for a rule.
+ *
+ * @param rule The pricing rule
+ * @param exact_reset Recompute exact steepest edge weights on a reset (see
+ * DualSteepestEdgePricing)
+ * */
+template <typename Scalar>
+std::unique_ptr<DualPricing<Scalar>>
+make_dual_pricing(DualPricingRule rule, bool exact_reset = false) {
+  switch (rule) {
+  case DualPricingRule::devex:
+    return std::make_unique<DualDevexPricing<Scalar>>();
+  case DualPricingRule::steepest_edge:
+    return std::make_unique<DualSteepestEdgePricing<Scalar>>(exact_reset);
+  default:
+    return std::make_unique<DualPricing<Scalar>>();
+  }
+}
+/*! Create the primal pricing strategy for a rule.
+ *
+ * @param rule The pricing rule
+ * @param blocks Number of blocks of partial pricing (1 for full pricing)
+ * */
+template <typename Scalar>
+std::unique_ptr<PrimalPricing<Scalar>>
+make_primal_pricing(PrimalPricingRule rule, size_t blocks = 1) {
+  if (rule == PrimalPricingRule::devex) {
+    return std::make_unique<PrimalDevexPricing<Scalar>>(blocks);
+  }
+  return std::make_unique<PrimalPricing<Scalar>>(blocks);
+}
+} // namespace teensylp
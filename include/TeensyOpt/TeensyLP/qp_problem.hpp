@@ -0,0 +1,110 @@
+#pragma once
+// std includes
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyLP/lp_problem.hpp"
+#include "TeensyOpt/TeensyMat/sparse_core.hpp"
+
+namespace teensylp {
+/*! A convex quadratic program in bounded form:
+ *
+ *     minimize    1/2 x^T Q x + objective^T x + objective_offset
+ *     subject to  row_lower <= A x <= row_upper
+ *                 col_lower <=  x  <= col_upper
+ *
+ * Q (hessian) is symmetric positive semidefinite and given by its upper
+ * triangle; a hessian without entries makes the problem an LP.
+ * */
+template <typename Scalar> struct QPProblem : LPProblem<Scalar> {
+  /*! Upper triangle of the symmetric matrix Q (n by n, or empty)*/
+  teensymat::SparseMatrix<Scalar> hessian;
+
+  /*! Construct an empty problem*/
+  QPProblem() = default;
+  /*! Construct a problem from an LP (with Q = 0)*/
+  QPProblem(LPProblem<Scalar> lp) : LPProblem<Scalar>(std::move(lp)) {}
+
+  /*! Whether Q has no entries*/
+  bool is_linear() const { return this->hessian.get_nnz() == 0; }
+  /*! Check that all arrays have lengths matching the constraint matrix,
+   * throwing std::range_error otherwise*/
+  void validate() const {
+    LPProblem<Scalar>::validate();
+    size_t n = this->get_ncols();
+    if (!this->is_linear() && (this->hessian.get_nrows() != n ||
+                               this->hessian.get_ncols() != n)) {
+      throw std::range_error("Hessian does not match the constraints");
+    }
+    auto const &col_ptr = this->hessian.get_col_ptr();
+    auto const &row_idx = this->hessian.get_row_idx();
+    for (size_t j = 0; j < this->hessian.get_ncols(); j++) {
+      for (size_t k = col_ptr[j]; k < col_ptr[j + 1]; k++) {
+        if (row_idx[k] > j) {
+          throw std::range_error("Hessian must be given by its upper triangle");
+        }
+      }
+    }
+  }
+  /*! Add Q x to result (length n)*/
+  void add_hessian_product(Scalar const *x, Scalar *result) const {
+    auto const &col_ptr = this->hessian.get_col_ptr();
+    auto const &row_idx = this->hessian.get_row_idx();
+    Scalar const *values = this->hessian.get_values()->data();
+    for (size_t j = 0; j < this->hessian.get_ncols(); j++) {
+      for (size_t k = col_ptr[j]; k < col_ptr[j + 1]; k++) {
+        size_t i = row_idx[k];
+        result[i] += values[k] * x[j];
+        if (i != j) {
+          result[j] += values[k] * x[i];
+        }
+      }
+    }
+  }
+  /*! The objective value (including the offset) at x*/
+  Scalar evaluate(std::vector<Scalar> const &x) const {
+    Scalar value = LPProblem<Scalar>::evaluate(x);
+    if (!this->is_linear()) {
+      std::vector<Scalar> product(x.size(), 0);
+      this->add_hessian_product(x.data(), product.data());
+      for (size_t j = 0; j < x.size(); j++) {
+        value += x[j] * product[j] / 2;
+      }
+    }
+    return value;
+  }
+};
+
+/*! Compare two QPs with the same dimensions (see the LPProblem overload;
+ * a change of Q counts as a change of the objective).
+ *
+ * Throws std::range_error if the dimensions differ.
+ *
+ * @param before The problem previously solved
+ * @param after The problem to solve next
+ * @return The parts of the problem which changed
+ * */
+template <typename Scalar>
+ProblemChanges compare_problems(QPProblem<Scalar> const &before,
+                                QPProblem<Scalar> const &after) {
+  before.validate();
+  after.validate();
+  ProblemChanges changes =
+      compare_problems(static_cast<LPProblem<Scalar> const &>(before),
+                       static_cast<LPProblem<Scalar> const &>(after));
+  if (before.is_linear() && after.is_linear()) {
+    return changes;
+  }
+  bool pattern =
+      before.hessian.get_col_ptr() != after.hessian.get_col_ptr() ||
+      before.hessian.get_row_idx() != after.hessian.get_row_idx();
+  changes.pattern = changes.pattern || pattern;
+  changes.objective = changes.objective || pattern ||
+                      *before.hessian.get_values() !=
+                          *after.hessian.get_values();
+  return changes;
+}
+} // namespace teensylp
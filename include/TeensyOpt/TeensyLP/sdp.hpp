@@ -0,0 +1,954 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyLP/lp_problem.hpp"
+#include "TeensyOpt/TeensyMat/eigen.hpp"
+#include "TeensyOpt/TeensyMat/factorize.hpp"
+#include "TeensyOpt/TeensyMat/lbfgs_memory.hpp"
+#include "TeensyOpt/TeensyMat/linalg.hpp"
+#include "TeensyOpt/TeensyMat/linear_operator.hpp"
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+#include "TeensyOpt/TeensyMat/parallel.hpp"
+#include "TeensyOpt/TeensyMat/random.hpp"
+#include "TeensyOpt/TeensyMat/sparse_core.hpp"
+
+namespace teensylp {
+/*! A semidefinite program in standard form
+ *
+ *     minimize <C, X>
+ *     subject to <A_i, X> = b_i,  i = 1, ..., m
+ *                X positive semidefinite
+ *
+ * over symmetric n x n matrices X, where <A, X> = trace(A X). Its dual is
+ *
+ *     maximize b^T y
+ *     subject to C - sum_i y_i A_i = Z,  Z positive semidefinite.
+ *
+ * C and the A_i must be symmetric and stored with both triangles.
+ * */
+template <typename Scalar> struct SDPProblem {
+  /*! The cost C*/
+  teensymat::SparseMatrix<Scalar> objective;
+  /*! The constraint matrices A_i*/
+  std::vector<teensymat::SparseMatrix<Scalar>> constraints;
+  /*! The right hand side b*/
+  std::vector<Scalar> rhs;
+
+  /*! Get the dimension n of the matrix variable*/
+  size_t get_dim() const { return this->objective.get_nrows(); }
+  /*! Get the number of constraints m*/
+  size_t get_num_constraints() const { return this->constraints.size(); }
+  /*! Check the dimensions and the symmetry of the data, throwing
+   * std::range_error if they do not match*/
+  void validate() const {
+    size_t n = this->get_dim();
+    auto check = [n](teensymat::SparseMatrix<Scalar> const &matrix) {
+      if (matrix.get_nrows() != n || matrix.get_ncols() != n) {
+        throw std::range_error("SDP data matrix is not n x n");
+      }
+      auto transposed = matrix.transpose();
+      if (transposed.get_col_ptr() != matrix.get_col_ptr() ||
+          transposed.get_row_idx() != matrix.get_row_idx() ||
+          *transposed.get_values() != *matrix.get_values()) {
+        throw std::range_error("SDP data matrix is not symmetric");
+      }
+    };
+    check(this->objective);
+    for (auto const &constraint : this->constraints) {
+      check(constraint);
+    }
+    if (this->rhs.size() != this->constraints.size()) {
+      throw std::range_error("SDP right hand side does not match the "
+                             "constraints");
+    }
+  }
+};
+
+/*! Algorithms of SDPSolver*/
+enum class SDPMethod {
+  /*! The interior point method up to SDPOptions::max_dense_dim, the low
+   * rank method above*/
+  automatic,
+  /*! Primal-dual interior point method on dense n x n iterates*/
+  interior_point,
+  /*! Burer-Monteiro factorization X = V V^T with an n x r factor V*/
+  low_rank,
+};
+
+/*! Options of SDPSolver*/
+template <typename Scalar> struct SDPOptions {
+  /*! Algorithm to run*/
+  SDPMethod method = SDPMethod::automatic;
+  /*! Largest n solved by the interior point method when method is
+   * automatic*/
+  size_t max_dense_dim = 300;
+  /*! Relative tolerance on the infeasibilities and the duality gap*/
+  Scalar tolerance = 1e-7;
+  /*! Maximum number of interior point iterations*/
+  size_t max_iterations = 100;
+  /*! Fraction of the step to the boundary of the cone taken*/
+  Scalar step_factor = 0.95;
+  /*! Number of columns of the factor V (0 picks the smallest r with
+   * r (r + 1) / 2 > m, for which the factorized problem has no spurious
+   * local minima in general)*/
+  size_t rank = 0;
+  /*! Number of correction pairs kept by L-BFGS*/
+  size_t memory = 8;
+  /*! Maximum number of multiplier updates of the low rank method*/
+  size_t max_outer_iterations = 200;
+  /*! Maximum number of L-BFGS iterations between multiplier updates*/
+  size_t max_inner_iterations = 5000;
+  /*! Initial penalty of the augmented Lagrangian (0 picks
+   * (1 + ||C||) / (1 + ||b||))*/
+  Scalar penalty = 0;
+  /*! Growth of the penalty when the infeasibility stalls*/
+  Scalar penalty_growth = 4;
+  /*! Seed of the random starting factor*/
+  uint64_t seed = 0;
+};
+
+/*! Solution of an SDPProblem*/
+template <typename Scalar> struct SDPSolution {
+  /*! Outcome of the solve*/
+  LPStatus status = LPStatus::numerical_error;
+  /*! Primal objective <C, X>*/
+  Scalar objective = 0;
+  /*! Dual objective b^T y*/
+  Scalar dual_objective = 0;
+  /*! The primal matrix X (interior point method only, the low rank method
+   * never forms it)*/
+  teensymat::Matrix<Scalar> primal;
+  /*! The factor V with X = V V^T (low rank method only)*/
+  teensymat::Matrix<Scalar> factor;
+  /*! The duals y of the constraints*/
+  std::vector<Scalar> duals;
+  /*! The dual slack Z = C - sum_i y_i A_i (interior point method only)*/
+  teensymat::Matrix<Scalar> dual_slack;
+  /*! Number of interior point iterations, or of L-BFGS iterations over
+   * all multiplier updates*/
+  size_t iterations = 0;
+};
+
+namespace sdp_detail {
+/*! Largest dimension whose step lengths use the dense eigensolver*/
+constexpr size_t dense_eigen_dim = 64;
+
+/*! Row major n x n view of a contiguous Matrix*/
+template <typename Scalar> Scalar *raw(teensymat::Matrix<Scalar> &matrix) {
+  return matrix.get_data()->data();
+}
+template <typename Scalar>
+Scalar const *raw(teensymat::Matrix<Scalar> const &matrix) {
+  return matrix.get_data()->data();
+}
+
+/*! Solve L Y = B in place for a lower triangular L and a square B (both
+ * n x n and row major), one row of B at a time*/
+template <typename Scalar>
+void lower_solve_rows(size_t n, Scalar const *l, Scalar *b) {
+  for (size_t i = 0; i < n; i++) {
+    Scalar *row = b + i * n;
+    for (size_t k = 0; k < i; k++) {
+      teensymat::axpy(n, -l[i * n + k], b + k * n, row);
+    }
+    teensymat::scal(n, Scalar{1} / l[i * n + i], row);
+  }
+}
+
+/*! Transpose the n x n row major a in place*/
+template <typename Scalar> void transpose(size_t n, Scalar *a) {
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < i; j++) {
+      std::swap(a[i * n + j], a[j * n + i]);
+    }
+  }
+}
+
+/*! Replace the n x n row major a by (a + a^T) / 2*/
+template <typename Scalar> void symmetrize(size_t n, Scalar *a) {
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < i; j++) {
+      Scalar mean = (a[i * n + j] + a[j * n + i]) / 2;
+      a[i * n + j] = mean;
+      a[j * n + i] = mean;
+    }
+  }
+}
+
+/*! Smallest eigenvalue of a symmetric Matrix*/
+template <typename Scalar>
+Scalar min_eigenvalue(teensymat::Matrix<Scalar> const &matrix) {
+  if (matrix.get_nrows() <= dense_eigen_dim) {
+    return teensymat::symmetric_eigen(matrix).eigenvalues.front();
+  }
+  teensymat::EigenOptions<Scalar> options;
+  options.tolerance = 1e-6;
+  auto result = teensymat::lanczos_eigs(
+      teensymat::LinearOperator<Scalar>::from_matrix(matrix), 1,
+      teensymat::EigenWhich::smallest, options);
+  return result.eigenvalues.front();
+}
+
+/*! First local minimizer a > 0 of q1 a + q2 a^2 + q3 a^3 + q4 a^4 with
+ * q1 < 0, by bisection on the derivative; infinity if the quartic
+ * decreases without bound*/
+template <typename Scalar>
+Scalar quartic_step(Scalar q1, Scalar q2, Scalar q3, Scalar q4) {
+  auto slope = [&](Scalar a) {
+    return q1 + a * (2 * q2 + a * (3 * q3 + a * 4 * q4));
+  };
+  Scalar high = 1;
+  while (slope(high) < 0) {
+    high *= 2;
+    if (high > Scalar{1e30}) {
+      return infinity<Scalar>;
+    }
+  }
+  Scalar low = 0;
+  Scalar eps = std::numeric_limits<Scalar>::epsilon();
+  while (high - low > 4 * eps * high) {
+    Scalar middle = (low + high) / 2;
+    if (slope(middle) < 0) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+  return (low + high) / 2;
+}
+} // namespace sdp_detail
+
+/*! Solver of semidefinite programs (SDPProblem) with two methods.
+ *
+ * The interior point method keeps dense n x n iterates X, Z and takes
+ * HKM (Helmberg-Kojima-Monteiro) Newton steps with Mehrotra's predictor
+ * and corrector. Each iteration eliminates dX and dZ, leaving the m x m
+ * Schur complement system M dy = r with M_ij = <A_i, X A_j Z^-1>, which
+ * is formed entrywise from the nonzeros of sparse pairs of constraints
+ * and with a gemm per dense constraint, and factored by Cholesky. Steps
+ * stay inside the cone through the smallest eigenvalue of
+ * L^-1 dX L^-T (X = L L^T). Memory and time grow like n^2 and n^3, so it
+ * suits moderate n.
+ *
+ * The low rank method (Burer and Monteiro) writes X = V V^T with an
+ * n x r factor, which is positive semidefinite by construction, and
+ * minimizes the augmented Lagrangian
+ *
+ *     <C, V V^T> - y^T r(V) + sigma / 2 ||r(V)||^2,  r(V) = A(V V^T) - b
+ *
+ * over V with L-BFGS (LBFGSMemory), followed by the multiplier update
+ * y <- y - sigma r.
+ * The gradient 2 S V with S = C - sum_i (y_i - sigma r_i) A_i and the
+ * residuals only touch the nonzeros of the data and V, so memory is
+ * O(n r + nnz). The line search is exact: the objective along V + a D is
+ * a quartic in a. At a feasible stationary point the dual slack
+ * C - sum_i y_i A_i is checked for positive semidefiniteness with
+ * Lanczos; a negative eigenvalue (a saddle point of the factorized
+ * problem) adds its eigenvector as a new column of V.
+ * */
+template <typename Scalar> class SDPSolver {
+private:
+  /*! Options of the solve*/
+  SDPOptions<Scalar> options;
+  /*! The method run, after resolving automatic*/
+  SDPMethod method;
+  /*! Dimension of the matrix variable and number of constraints*/
+  size_t n, m;
+  /*! The right hand side b*/
+  std::vector<Scalar> rhs;
+  /*! Nonzeros of A_1, ..., A_m and C (as matrix m), grouped by matrix:
+   * matrix k owns the entries entry_begin[k] to entry_begin[k + 1]*/
+  std::vector<size_t> entry_row, entry_col, entry_begin;
+  std::vector<Scalar> entry_value;
+  /*! Norms ||b|| and ||C||_F used by the relative tolerances*/
+  Scalar rhs_norm, objective_norm;
+  /*! Number of iterations performed in the current solve*/
+  size_t iterations;
+  /*! Duals y*/
+  std::vector<Scalar> y;
+  /*! Interior point iterates X and Z*/
+  teensymat::Matrix<Scalar> x, z;
+  /*! Interior point workspaces: Z^-1, the dual residual R_d,
+   * X R_d Z^-1, the complementarity right hand side R_c, the direction
+   * and two n x n scratch matrices*/
+  teensymat::Matrix<Scalar> zinv, rd, xrdz, rc, dx, dz, work, work2;
+  /*! Interior point primal residual, dual direction and Schur right
+   * hand side*/
+  std::vector<Scalar> rp, dy, schur_rhs;
+  /*! The Schur complement matrix M*/
+  teensymat::Matrix<Scalar> schur;
+  /*! Low rank factor V (n x rank)*/
+  teensymat::Matrix<Scalar> factor;
+  size_t rank;
+  /*! Low rank state: penalty sigma, <C, V V^T> and r(V)*/
+  Scalar penalty, factor_objective;
+  std::vector<Scalar> residual;
+  /*! Low rank workspaces (n x rank each): gradient and search direction*/
+  std::vector<Scalar> gradient, direction;
+  /*! L-BFGS correction pairs*/
+  teensymat::LBFGSMemory<Scalar> memory;
+  /*! Per matrix weights and inner products with the factor*/
+  std::vector<Scalar> weights, inner1, inner2;
+
+  // SECTION: Data
+  /*! <A_k, K> for a dense row major n x n K (k = m is C)*/
+  Scalar inner(size_t k, Scalar const *dense) const {
+    size_t n = this->n;
+    Scalar sum = 0;
+    for (size_t e = this->entry_begin[k]; e < this->entry_begin[k + 1];
+         e++) {
+      sum += this->entry_value[e] *
+             dense[this->entry_row[e] * n + this->entry_col[e]];
+    }
+    return sum;
+  }
+  /*! dense += alpha A_k (k = m is C)*/
+  void add_data(size_t k, Scalar alpha, Scalar *dense) const {
+    size_t n = this->n;
+    for (size_t e = this->entry_begin[k]; e < this->entry_begin[k + 1];
+         e++) {
+      dense[this->entry_row[e] * n + this->entry_col[e]] +=
+          alpha * this->entry_value[e];
+    }
+  }
+  /*! out = C - sum_i w_i A_i*/
+  void dual_matrix(Scalar const *w, Scalar *out) const {
+    std::fill(out, out + this->n * this->n, Scalar{0});
+    this->add_data(this->m, 1, out);
+    for (size_t i = 0; i < this->m; i++) {
+      this->add_data(i, -w[i], out);
+    }
+  }
+  /*! out = a b for n x n row major matrices*/
+  void multiply(Scalar const *a, Scalar const *b, Scalar *out) const {
+    size_t n = this->n;
+    std::fill(out, out + n * n, Scalar{0});
+    teensymat::gemm(n, n, n, Scalar{1}, a, n, b, n, out, n);
+  }
+
+  // SECTION: Interior point method
+  /*! Form the Schur complement M_ij = <A_i, Z^-1 A_j X>. Constraint j
+   * uses the dense route (A_j X, a gemm with Z^-1 and an inner product
+   * per constraint) when that is cheaper than summing
+   * a_rc b_kl X_ck Zinv_lr over all pairs of nonzeros, as SDPA does*/
+  void form_schur() {
+    size_t n = this->n;
+    size_t m = this->m;
+    Scalar const *x = sdp_detail::raw(this->x);
+    Scalar const *zinv = sdp_detail::raw(this->zinv);
+    Scalar *w1 = sdp_detail::raw(this->work);
+    Scalar *w2 = sdp_detail::raw(this->work2);
+    double total = static_cast<double>(this->entry_begin[m]);
+    double cube = static_cast<double>(n) * n * n;
+    std::vector<bool> dense(m);
+    for (size_t j = 0; j < m; j++) {
+      double count = this->entry_begin[j + 1] - this->entry_begin[j];
+      dense[j] = count * total > cube;
+    }
+    for (size_t j = 0; j < m; j++) {
+      if (!dense[j]) {
+        continue;
+      }
+      std::fill(w1, w1 + n * n, Scalar{0});
+      for (size_t e = this->entry_begin[j]; e < this->entry_begin[j + 1];
+           e++) {
+        teensymat::axpy(n, this->entry_value[e],
+                        x + this->entry_col[e] * n,
+                        w1 + this->entry_row[e] * n);
+      }
+      this->multiply(zinv, w1, w2);
+      for (size_t i = 0; i < m; i++) {
+        Scalar value = this->inner(i, w2);
+        *this->schur(i, j) = value;
+        *this->schur(j, i) = value;
+      }
+    }
+    teensymat::parallel_for(m, 1, [&](size_t begin, size_t end) {
+      for (size_t j = begin; j < end; j++) {
+        if (dense[j]) {
+          continue;
+        }
+        for (size_t i = j; i < m; i++) {
+          if (dense[i]) {
+            continue;
+          }
+          Scalar sum = 0;
+          for (size_t e = this->entry_begin[i];
+               e < this->entry_begin[i + 1]; e++) {
+            Scalar const *x_row = x + this->entry_col[e] * n;
+            Scalar const *zinv_col = zinv + this->entry_row[e];
+            Scalar partial = 0;
+            for (size_t f = this->entry_begin[j];
+                 f < this->entry_begin[j + 1]; f++) {
+              partial += this->entry_value[f] * x_row[this->entry_row[f]] *
+                         zinv_col[this->entry_col[f] * n];
+            }
+            sum += this->entry_value[e] * partial;
+          }
+          *this->schur(i, j) = sum;
+          *this->schur(j, i) = sum;
+        }
+      }
+    });
+  }
+  /*! Solve the Newton system for the complementarity right hand side in
+   * rc: dy from the Schur complement, dZ = R_d - sum_i dy_i A_i and
+   * dX = R_c - sym(X dZ Z^-1)*/
+  void newton_direction(
+      teensymat::CholeskyFactorization<Scalar> const &schur_factor) {
+    size_t n = this->n;
+    size_t nn = n * n;
+    Scalar const *rc = sdp_detail::raw(this->rc);
+    Scalar const *xrdz = sdp_detail::raw(this->xrdz);
+    for (size_t i = 0; i < this->m; i++) {
+      this->dy[i] = this->rp[i] - this->inner(i, rc) + this->inner(i, xrdz);
+    }
+    schur_factor.solve_inplace(this->dy.data());
+    Scalar *dz = sdp_detail::raw(this->dz);
+    std::copy(sdp_detail::raw(this->rd), sdp_detail::raw(this->rd) + nn,
+              dz);
+    for (size_t i = 0; i < this->m; i++) {
+      this->add_data(i, -this->dy[i], dz);
+    }
+    Scalar *w1 = sdp_detail::raw(this->work);
+    Scalar *w2 = sdp_detail::raw(this->work2);
+    this->multiply(dz, sdp_detail::raw(this->zinv), w1);
+    this->multiply(sdp_detail::raw(this->x), w1, w2);
+    Scalar *dx = sdp_detail::raw(this->dx);
+    for (size_t i = 0; i < n; i++) {
+      for (size_t j = 0; j < n; j++) {
+        dx[i * n + j] = rc[i * n + j] - (w2[i * n + j] + w2[j * n + i]) / 2;
+      }
+    }
+  }
+  /*! Largest step a with point + a direction positive semidefinite
+   * (infinity if there is none), from the smallest eigenvalue of
+   * L^-1 direction L^-T with point = L L^T*/
+  Scalar step_to_boundary(teensymat::Matrix<Scalar> const &point,
+                          teensymat::Matrix<Scalar> const &direction) {
+    size_t n = this->n;
+    teensymat::CholeskyFactorization<Scalar> cholesky{point};
+    Scalar const *l = sdp_detail::raw(cholesky.get_factor());
+    Scalar *w = sdp_detail::raw(this->work);
+    std::copy(sdp_detail::raw(direction), sdp_detail::raw(direction) + n * n,
+              w);
+    sdp_detail::lower_solve_rows(n, l, w);
+    sdp_detail::transpose(n, w);
+    sdp_detail::lower_solve_rows(n, l, w);
+    sdp_detail::symmetrize(n, w);
+    Scalar lambda = sdp_detail::min_eigenvalue(this->work);
+    return lambda < 0 ? -1 / lambda : infinity<Scalar>;
+  }
+  /*! Shorten step until point + step direction has a Cholesky factor (the
+   * iterative eigensolver may overestimate the smallest eigenvalue)*/
+  Scalar safeguard_step(teensymat::Matrix<Scalar> const &point,
+                        teensymat::Matrix<Scalar> const &direction,
+                        Scalar step) {
+    size_t nn = this->n * this->n;
+    Scalar *w = sdp_detail::raw(this->work);
+    for (size_t attempt = 0; attempt < 50; attempt++) {
+      std::copy(sdp_detail::raw(point), sdp_detail::raw(point) + nn, w);
+      teensymat::axpy(nn, step, sdp_detail::raw(direction), w);
+      try {
+        teensymat::CholeskyFactorization<Scalar> cholesky{this->work};
+        return step;
+      } catch (std::runtime_error const &) {
+        step *= Scalar{0.8};
+      }
+    }
+    return 0;
+  }
+  /*! Run the interior point method from the SDPT3 starting point
+   * X = xi I, Z = eta I, y = 0*/
+  LPStatus run_interior_point() {
+    size_t n = this->n;
+    size_t m = this->m;
+    size_t nn = n * n;
+    for (auto *matrix : {&this->x, &this->z, &this->zinv, &this->rd,
+                         &this->xrdz, &this->rc, &this->dx, &this->dz,
+                         &this->work, &this->work2}) {
+      *matrix = teensymat::Matrix<Scalar>{n, n};
+    }
+    this->schur = teensymat::Matrix<Scalar>{m, m};
+    this->y.assign(m, 0);
+    this->rp.assign(m, 0);
+    this->dy.assign(m, 0);
+    Scalar root_n = std::sqrt(static_cast<Scalar>(n));
+    Scalar xi = std::max(Scalar{10}, root_n);
+    Scalar eta = std::max(xi, this->objective_norm);
+    for (size_t i = 0; i < m; i++) {
+      size_t begin = this->entry_begin[i];
+      Scalar norm = teensymat::nrm2(this->entry_begin[i + 1] - begin,
+                                    this->entry_value.data() + begin);
+      xi = std::max(xi, n * (1 + std::abs(this->rhs[i])) / (1 + norm));
+      eta = std::max(eta, norm);
+    }
+    for (size_t i = 0; i < n; i++) {
+      *this->x(i, i) = xi;
+      *this->z(i, i) = eta;
+    }
+    Scalar *x = sdp_detail::raw(this->x);
+    Scalar *z = sdp_detail::raw(this->z);
+    Scalar *rd = sdp_detail::raw(this->rd);
+    Scalar *rc = sdp_detail::raw(this->rc);
+    Scalar *zinv = sdp_detail::raw(this->zinv);
+    Scalar *dx = sdp_detail::raw(this->dx);
+    Scalar *dz = sdp_detail::raw(this->dz);
+    Scalar *w1 = sdp_detail::raw(this->work);
+    Scalar *w2 = sdp_detail::raw(this->work2);
+    Scalar tolerance = this->options.tolerance;
+    for (;;) {
+      // Residuals, objectives and termination
+      for (size_t i = 0; i < m; i++) {
+        this->rp[i] = this->rhs[i] - this->inner(i, x);
+      }
+      this->dual_matrix(this->y.data(), rd);
+      teensymat::axpy(nn, Scalar{-1}, z, rd);
+      Scalar primal = this->inner(m, x);
+      Scalar dual = teensymat::dot(m, this->rhs.data(), this->y.data());
+      Scalar complementarity = teensymat::dot(nn, x, z);
+      Scalar pinf = teensymat::nrm2(m, this->rp.data()) / (1 + this->rhs_norm);
+      Scalar dinf = teensymat::nrm2(nn, rd) / (1 + this->objective_norm);
+      Scalar gap = std::abs(primal - dual) /
+                   (1 + std::abs(primal) + std::abs(dual));
+      if (pinf <= tolerance && dinf <= tolerance && gap <= tolerance) {
+        return LPStatus::optimal;
+      }
+      // Certificates: sum_i y_i A_i + Z = C - R_d ~ 0 with b^T y > 0, or
+      // A(X) = b - R_p ~ 0 with <C, X> < 0
+      if (dual > 0) {
+        std::fill(w1, w1 + nn, Scalar{0});
+        this->add_data(m, 1, w1);
+        teensymat::axpy(nn, Scalar{-1}, rd, w1);
+        if (teensymat::nrm2(nn, w1) <= tolerance * dual) {
+          return LPStatus::infeasible;
+        }
+      }
+      if (primal < 0) {
+        Scalar sum = 0;
+        for (size_t i = 0; i < m; i++) {
+          Scalar value = this->rhs[i] - this->rp[i];
+          sum += value * value;
+        }
+        if (std::sqrt(sum) <= -tolerance * primal) {
+          return LPStatus::unbounded;
+        }
+      }
+      if (this->iterations >= this->options.max_iterations) {
+        return LPStatus::iteration_limit;
+      }
+      this->iterations++;
+      Scalar mu = complementarity / n;
+
+      // Z^-1, the Schur complement and X R_d Z^-1
+      std::optional<teensymat::CholeskyFactorization<Scalar>> schur_factor;
+      try {
+        this->zinv =
+            teensymat::CholeskyFactorization<Scalar>{this->z}.inverse();
+        zinv = sdp_detail::raw(this->zinv);
+        this->form_schur();
+        schur_factor.emplace(this->schur);
+      } catch (std::runtime_error const &) {
+        return LPStatus::numerical_error;
+      }
+      this->multiply(rd, zinv, w1);
+      this->multiply(x, w1, sdp_detail::raw(this->xrdz));
+
+      // Predictor: R_c = -X
+      for (size_t k = 0; k < nn; k++) {
+        rc[k] = -x[k];
+      }
+      this->newton_direction(*schur_factor);
+      Scalar step_primal =
+          std::min(Scalar{1}, this->step_to_boundary(this->x, this->dx));
+      Scalar step_dual =
+          std::min(Scalar{1}, this->step_to_boundary(this->z, this->dz));
+      Scalar affine =
+          (complementarity + step_dual * teensymat::dot(nn, x, dz) +
+           step_primal * teensymat::dot(nn, dx, z) +
+           step_primal * step_dual * teensymat::dot(nn, dx, dz)) /
+          n;
+      Scalar ratio = std::max(affine, Scalar{0}) / mu;
+      Scalar sigma = std::min(Scalar{1}, ratio * ratio * ratio);
+
+      // Corrector: R_c = sigma mu Z^-1 - X - sym(dX dZ Z^-1)
+      this->multiply(dz, zinv, w1);
+      this->multiply(dx, w1, w2);
+      for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < n; j++) {
+          rc[i * n + j] = sigma * mu * zinv[i * n + j] - x[i * n + j] -
+                          (w2[i * n + j] + w2[j * n + i]) / 2;
+        }
+      }
+      this->newton_direction(*schur_factor);
+      Scalar fraction = this->options.step_factor;
+      step_primal = std::min(
+          Scalar{1}, fraction * this->step_to_boundary(this->x, this->dx));
+      step_dual = std::min(
+          Scalar{1}, fraction * this->step_to_boundary(this->z, this->dz));
+      step_primal = this->safeguard_step(this->x, this->dx, step_primal);
+      step_dual = this->safeguard_step(this->z, this->dz, step_dual);
+      if (step_primal == 0 && step_dual == 0) {
+        return LPStatus::numerical_error;
+      }
+      teensymat::axpy(nn, step_primal, dx, x);
+      teensymat::axpy(nn, step_dual, dz, z);
+      teensymat::axpy(m, step_dual, this->dy.data(), this->y.data());
+    }
+  }
+
+  // SECTION: Low rank method
+  /*! Allocate the workspaces of the low rank method for the current
+   * rank*/
+  void allocate_low_rank() {
+    size_t size = this->n * this->rank;
+    this->gradient.assign(size, 0);
+    this->direction.assign(size, 0);
+    this->memory = teensymat::LBFGSMemory<Scalar>{
+        size, std::max<size_t>(this->options.memory, 1)};
+  }
+  /*! For every matrix k (the A_i, then C), <A_k, U W^T> into out1[k] and,
+   * when out2 is given, <A_k, W W^T> into out2[k], for n x rank row major
+   * U and W*/
+  void factor_inner(Scalar const *u, Scalar const *w, Scalar *out1,
+                    Scalar *out2) const {
+    size_t r = this->rank;
+    for (size_t k = 0; k <= this->m; k++) {
+      Scalar sum1 = 0;
+      Scalar sum2 = 0;
+      for (size_t e = this->entry_begin[k]; e < this->entry_begin[k + 1];
+           e++) {
+        Scalar const *w_col = w + this->entry_col[e] * r;
+        sum1 += this->entry_value[e] *
+                teensymat::dot(r, u + this->entry_row[e] * r, w_col);
+        if (out2 != nullptr) {
+          sum2 += this->entry_value[e] *
+                  teensymat::dot(r, w + this->entry_row[e] * r, w_col);
+        }
+      }
+      out1[k] = sum1;
+      if (out2 != nullptr) {
+        out2[k] = sum2;
+      }
+    }
+  }
+  /*! Recompute <C, V V^T> and r(V) from the factor*/
+  void evaluate_factor() {
+    Scalar const *v = sdp_detail::raw(this->factor);
+    this->factor_inner(v, v, this->inner1.data(), nullptr);
+    this->factor_objective = this->inner1[this->m];
+    for (size_t i = 0; i < this->m; i++) {
+      this->residual[i] = this->inner1[i] - this->rhs[i];
+    }
+  }
+  /*! Gradient 2 S V of the augmented Lagrangian, with
+   * S = C - sum_i (y_i - sigma r_i) A_i*/
+  void evaluate_gradient() {
+    size_t r = this->rank;
+    Scalar const *v = sdp_detail::raw(this->factor);
+    for (size_t i = 0; i < this->m; i++) {
+      this->weights[i] = this->penalty * this->residual[i] - this->y[i];
+    }
+    this->weights[this->m] = 1;
+    std::fill(this->gradient.begin(), this->gradient.end(), Scalar{0});
+    for (size_t k = 0; k <= this->m; k++) {
+      Scalar weight = 2 * this->weights[k];
+      if (weight == Scalar{0}) {
+        continue;
+      }
+      for (size_t e = this->entry_begin[k]; e < this->entry_begin[k + 1];
+           e++) {
+        teensymat::axpy(r, weight * this->entry_value[e],
+                        v + this->entry_col[e] * r,
+                        this->gradient.data() + this->entry_row[e] * r);
+      }
+    }
+  }
+  /*! Minimize the augmented Lagrangian over V with L-BFGS and exact line
+   * searches until the gradient norm is below gradient_tolerance.
+   * Returns false if it is unbounded below*/
+  bool minimize_lagrangian(Scalar gradient_tolerance) {
+    size_t size = this->n * this->rank;
+    size_t m = this->m;
+    Scalar *v = sdp_detail::raw(this->factor);
+    Scalar *g = this->gradient.data();
+    Scalar *d = this->direction.data();
+    this->memory.reset();
+    this->evaluate_gradient();
+    for (size_t inner = 0; inner < this->options.max_inner_iterations;
+         inner++) {
+      if (teensymat::nrm2(size, g) <= gradient_tolerance) {
+        return true;
+      }
+      this->memory.direction(g, d);
+      if (!(teensymat::dot(size, g, d) < 0)) {
+        if (this->memory.get_size() == 0) {
+          return true;
+        }
+        this->memory.reset();
+        continue;
+      }
+
+      // Exact line search on the quartic along V + a D
+      this->factor_inner(v, d, this->inner1.data(), this->inner2.data());
+      Scalar sigma = this->penalty;
+      Scalar q1 = 2 * this->inner1[m];
+      Scalar q2 = this->inner2[m];
+      Scalar q3 = 0;
+      Scalar q4 = 0;
+      for (size_t i = 0; i < m; i++) {
+        Scalar r0 = this->residual[i];
+        Scalar r1 = 2 * this->inner1[i];
+        Scalar r2 = this->inner2[i];
+        q1 += (sigma * r0 - this->y[i]) * r1;
+        q2 += (sigma * r0 - this->y[i]) * r2 + sigma * r1 * r1 / 2;
+        q3 += sigma * r1 * r2;
+        q4 += sigma * r2 * r2 / 2;
+      }
+      Scalar step = sdp_detail::quartic_step(q1, q2, q3, q4);
+      if (step == infinity<Scalar>) {
+        return false;
+      }
+      this->iterations++;
+      this->factor_objective +=
+          step * (2 * this->inner1[m] + step * this->inner2[m]);
+      for (size_t i = 0; i < m; i++) {
+        this->residual[i] +=
+            step * (2 * this->inner1[i] + step * this->inner2[i]);
+      }
+      teensymat::axpy(size, step, d, v);
+
+      // New correction pair s = a D, y = g_new - g_old
+      Scalar *s_new = this->memory.next_s();
+      Scalar *y_new = this->memory.next_y();
+      for (size_t k = 0; k < size; k++) {
+        s_new[k] = step * d[k];
+        y_new[k] = -g[k];
+      }
+      this->evaluate_gradient();
+      teensymat::axpy(size, Scalar{1}, g, y_new);
+      this->memory.commit();
+    }
+    return true;
+  }
+  /*! Smallest eigenpair of the dual slack C - sum_i y_i A_i, matrix free*/
+  teensymat::EigenResult<Scalar> dual_slack_eigen() const {
+    size_t n = this->n;
+    auto apply = [this, n](Scalar const *in, Scalar *out) {
+      std::fill(out, out + n, Scalar{0});
+      for (size_t k = 0; k <= this->m; k++) {
+        Scalar weight = k == this->m ? Scalar{1} : -this->y[k];
+        for (size_t e = this->entry_begin[k]; e < this->entry_begin[k + 1];
+             e++) {
+          out[this->entry_row[e]] +=
+              weight * this->entry_value[e] * in[this->entry_col[e]];
+        }
+      }
+    };
+    teensymat::EigenOptions<Scalar> eigen_options;
+    eigen_options.tolerance = this->options.tolerance;
+    eigen_options.seed = this->options.seed;
+    return teensymat::lanczos_eigs(
+        teensymat::LinearOperator<Scalar>{n, n, apply}, 1,
+        teensymat::EigenWhich::smallest, eigen_options);
+  }
+  /*! Add the unit vector u as a new column a u of V, with a minimizing
+   * the augmented Lagrangian (the new column only enters quadratically)*/
+  void add_column(Scalar const *u) {
+    size_t n = this->n;
+    size_t r = this->rank;
+    teensymat::Matrix<Scalar> grown{n, r + 1};
+    for (size_t i = 0; i < n; i++) {
+      std::copy(this->factor(i, 0), this->factor(i, 0) + r, grown(i, 0));
+    }
+    this->factor = std::move(grown);
+    this->rank = r + 1;
+    this->allocate_low_rank();
+    Scalar *d = this->direction.data();
+    for (size_t i = 0; i < n; i++) {
+      d[i * (r + 1) + r] = u[i];
+    }
+    this->factor_inner(d, d, this->inner2.data(), nullptr);
+    Scalar q2 = this->inner2[this->m];
+    Scalar q4 = 0;
+    for (size_t i = 0; i < this->m; i++) {
+      q2 += (this->penalty * this->residual[i] - this->y[i]) * this->inner2[i];
+      q4 += this->penalty * this->inner2[i] * this->inner2[i] / 2;
+    }
+    Scalar scale = std::sqrt(this->options.tolerance);
+    if (q2 < 0 && q4 > 0) {
+      scale = std::sqrt(-q2 / (2 * q4));
+    }
+    for (size_t i = 0; i < n; i++) {
+      *this->factor(i, r) = scale * u[i];
+    }
+  }
+  /*! Run the augmented Lagrangian method on the factorized problem*/
+  LPStatus run_low_rank() {
+    size_t n = this->n;
+    size_t m = this->m;
+    size_t r = this->options.rank;
+    if (r == 0) {
+      while (r * (r + 1) / 2 <= m) {
+        r++;
+      }
+    }
+    this->rank = std::min(r, n);
+    this->factor = teensymat::random_normal<Scalar>(
+        n, this->rank, this->options.seed, Scalar{0},
+        1 / std::sqrt(static_cast<Scalar>(this->rank)));
+    this->allocate_low_rank();
+    this->y.assign(m, 0);
+    this->residual.assign(m, 0);
+    this->weights.assign(m + 1, 0);
+    this->inner1.assign(m + 1, 0);
+    this->inner2.assign(m + 1, 0);
+    this->penalty = this->options.penalty > 0
+                        ? this->options.penalty
+                        : (1 + this->objective_norm) / (1 + this->rhs_norm);
+    Scalar tolerance = this->options.tolerance;
+    Scalar scale = 1 + this->objective_norm;
+    Scalar previous = infinity<Scalar>;
+    Scalar inner_tolerance = Scalar{0.1};
+    for (size_t outer = 0; outer < this->options.max_outer_iterations;
+         outer++) {
+      this->evaluate_factor();
+      if (!this->minimize_lagrangian(inner_tolerance * scale)) {
+        return LPStatus::unbounded;
+      }
+      // The gradient is now 2 (C - sum_i y_i A_i) V at the updated y
+      Scalar norm = teensymat::nrm2(m, this->residual.data());
+      teensymat::axpy(m, -this->penalty, this->residual.data(),
+                      this->y.data());
+      bool stationary =
+          teensymat::nrm2(this->gradient.size(), this->gradient.data()) <=
+          tolerance * scale;
+      if (norm <= tolerance * (1 + this->rhs_norm) && stationary) {
+        auto eigen = this->dual_slack_eigen();
+        if (eigen.eigenvalues.front() >= -tolerance * scale) {
+          return LPStatus::optimal;
+        }
+        if (this->rank == n) {
+          return LPStatus::numerical_error;
+        }
+        // A saddle point: move along the negative curvature direction
+        std::vector<Scalar> u(n);
+        for (size_t i = 0; i < n; i++) {
+          u[i] = *eigen.eigenvectors(i, 0);
+        }
+        this->evaluate_factor();
+        this->add_column(u.data());
+      }
+      if (norm > previous / 4) {
+        this->penalty *= this->options.penalty_growth;
+      }
+      previous = norm;
+      inner_tolerance = std::max(tolerance, inner_tolerance / 10);
+    }
+    return LPStatus::iteration_limit;
+  }
+
+public:
+  // SECTION: Constructors
+  /*! Set up a solver, flattening the nonzeros of the data.
+   *
+   * Throws std::range_error if the problem is invalid.
+   *
+   * @param problem The problem to solve
+   * @param options Options of the solve
+   * */
+  explicit SDPSolver(SDPProblem<Scalar> const &problem,
+                     SDPOptions<Scalar> options = {})
+      : options(options), n(problem.get_dim()),
+        m(problem.get_num_constraints()), rhs(problem.rhs), rhs_norm(0),
+        objective_norm(0), iterations(0), rank(0), penalty(0),
+        factor_objective(0),
+        memory(0, std::max<size_t>(options.memory, 1)) {
+    problem.validate();
+    this->method = options.method;
+    if (this->method == SDPMethod::automatic) {
+      this->method = this->n <= options.max_dense_dim
+                         ? SDPMethod::interior_point
+                         : SDPMethod::low_rank;
+    }
+    auto append = [this](teensymat::SparseMatrix<Scalar> const &matrix) {
+      this->entry_begin.push_back(this->entry_row.size());
+      auto const &col_ptr = matrix.get_col_ptr();
+      auto const &row_idx = matrix.get_row_idx();
+      auto const &values = *matrix.get_values();
+      for (size_t col = 0; col < this->n; col++) {
+        for (size_t k = col_ptr[col]; k < col_ptr[col + 1]; k++) {
+          this->entry_row.push_back(row_idx[k]);
+          this->entry_col.push_back(col);
+          this->entry_value.push_back(values[k]);
+        }
+      }
+    };
+    for (auto const &constraint : problem.constraints) {
+      append(constraint);
+    }
+    append(problem.objective);
+    this->entry_begin.push_back(this->entry_row.size());
+    size_t begin = this->entry_begin[this->m];
+    this->objective_norm =
+        teensymat::nrm2(this->entry_value.size() - begin,
+                        this->entry_value.data() + begin);
+    this->rhs_norm = teensymat::nrm2(this->m, this->rhs.data());
+  }
+
+  // SECTION: Getters
+  /*! Get the method run by the solver (automatic resolved)*/
+  SDPMethod get_method() const { return this->method; }
+  /*! Get the number of columns of the factor V (low rank method, after a
+   * solve, including columns added to escape saddle points)*/
+  size_t get_rank() const { return this->rank; }
+
+  // SECTION: Solving
+  /*! Solve the problem.
+   *
+   * @return The solution
+   * */
+  SDPSolution<Scalar> solve() {
+    this->iterations = 0;
+    SDPSolution<Scalar> result;
+    if (this->method == SDPMethod::interior_point) {
+      result.status = this->run_interior_point();
+      result.objective = this->inner(this->m, sdp_detail::raw(this->x));
+      result.primal = this->x;
+      result.dual_slack = this->z;
+    } else {
+      result.status = this->run_low_rank();
+      result.objective = this->factor_objective;
+      result.factor = this->factor;
+    }
+    result.duals = this->y;
+    result.dual_objective =
+        teensymat::dot(this->m, this->rhs.data(), this->y.data());
+    result.iterations = this->iterations;
+    return result;
+  }
+};
+
+/*! Solve a semidefinite program with SDPSolver.
+ *
+ * @param problem The problem to solve
+ * @param options Options of the solve
+ * @return The solution
+ * */
+template <typename Scalar>
+SDPSolution<Scalar> solve_sdp(SDPProblem<Scalar> const &problem,
+                              SDPOptions<Scalar> const &options = {}) {
+  SDPSolver<Scalar> solver{problem, options};
+  return solver.solve();
+}
+} // namespace teensylp
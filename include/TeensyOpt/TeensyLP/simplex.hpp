@@ -0,0 +1,1196 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyLP/basis_factor.hpp"
+#include "TeensyOpt/TeensyLP/lp_problem.hpp"
+#include "TeensyOpt/TeensyLP/pricing.hpp"
+#include "TeensyOpt/TeensyMat/indexed_vector.hpp"
+#include "TeensyOpt/TeensyMat/parallel.hpp"
+#include "TeensyOpt/TeensyMat/scaling.hpp"
+#include "TeensyOpt/TeensyMat/sparse_core.hpp"
+
+namespace teensylp {
+/*! Which simplex method is run first*/
+enum class SimplexAlgorithm {
+  /*! Dual simplex (after making the starting basis dual feasible)*/
+  dual,
+  /*! Primal simplex when the starting basis is primal feasible, otherwise
+   * the dual simplex*/
+  primal,
+};
+
+/*! Options of RevisedSimplex*/
+template <typename Scalar> struct SimplexOptions {
+  /*! The method run first*/
+  SimplexAlgorithm algorithm = SimplexAlgorithm::dual;
+  /*! Maximum number of iterations (pivots and bound flips)*/
+  size_t max_iterations = 1000000;
+  /*! Largest bound violation of a feasible point (in the scaled problem)*/
+  Scalar primal_tolerance = 1e-7;
+  /*! Largest reduced cost sign violation of an optimal basis*/
+  Scalar dual_tolerance = 1e-7;
+  /*! Smallest magnitude of an acceptable pivot element*/
+  Scalar pivot_tolerance = 1e-7;
+  /*! Number of basis updates between refactorizations*/
+  size_t refactor_interval = 100;
+  /*! Equilibrate the constraint matrix (geometric then Ruiz scaling)*/
+  bool scale = true;
+  /*! Perturb the costs to avoid stalling on dual degenerate problems*/
+  bool perturb_costs = true;
+  /*! Pricing rule of the dual simplex*/
+  DualPricingRule dual_pricing = DualPricingRule::steepest_edge;
+  /*! Recompute exact dual steepest edge weights (one BTRAN per row) when
+   * a warm start resets them, rather than starting from one*/
+  bool exact_dual_weights = false;
+  /*! Pricing rule of the primal simplex*/
+  PrimalPricingRule primal_pricing = PrimalPricingRule::devex;
+  /*! Number of blocks of partial pricing in the primal simplex (1 to price
+   * all variables at every iteration)*/
+  size_t partial_pricing_blocks = 1;
+};
+
+/*! Bounded revised simplex method for LPProblem.
+ *
+ * Rows get logical variables r = A x, and the solver works on [A, -I] with
+ * bounds on all n + m variables. The basis is kept as a sparse LU
+ * factorization (BasisFactor) with product form updates, and all work per
+ * iteration is proportional to the nonzeros touched: the pivot row is
+ * computed row wise from a transposed copy of A when the BTRAN result is
+ * sparse, and the ratio tests only visit its nonzeros.
+ *
+ * The dual simplex uses the bound flipping (long step) ratio test with
+ * Harris' tolerances. A starting basis which is not dual feasible is made so
+ * by flipping boxed variables and shifting the costs of the others; the
+ * original costs are then restored and the primal simplex (Harris ratio
+ * test, bound flips of the entering variable) removes the remaining dual
+ * infeasibilities. The primal simplex never starts from an infeasible
+ * basis, so no primal phase one is needed.
+ *
+ * Pricing is delegated to DualPricing and PrimalPricing strategies (dual
+ * steepest edge and primal Devex by default), which can be replaced with
+ * set_dual_pricing and set_primal_pricing. The dual simplex only prices the
+ * basis positions which became infeasible since the last full
+ * recomputation of the primal values.
+ * */
+template <typename Scalar> class RevisedSimplex {
+public:
+  /*! Marker for "no index"*/
+  static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+private:
+  /*! The number of rows*/
+  size_t nrows;
+  /*! The number of structural variables*/
+  size_t ncols;
+  /*! Options of the solve*/
+  SimplexOptions<Scalar> options;
+  /*! The scaled constraint matrix (by columns)*/
+  teensymat::SparseMatrix<Scalar> constraints;
+  /*! The scaled constraint matrix by rows*/
+  teensymat::SparseMatrix<Scalar> constraint_rows;
+  /*! The scaling applied to the problem*/
+  teensymat::Scaling<Scalar> scaling;
+  /*! The problem as given, for reporting and to detect changes*/
+  LPProblem<Scalar> problem;
+  /*! Scaled costs of all n + m variables*/
+  std::vector<Scalar> base_cost;
+  /*! Costs in use (base_cost plus shifts and perturbations)*/
+  std::vector<Scalar> cost;
+  /*! Scaled bounds of all n + m variables*/
+  std::vector<Scalar> lower, upper;
+  /*! The basis factorization*/
+  BasisFactor<Scalar> factor;
+  /*! Variable at each basis position*/
+  std::vector<size_t> basic;
+  /*! Basis position of each variable (npos if nonbasic)*/
+  std::vector<size_t> position;
+  /*! Status of each variable*/
+  std::vector<BasisStatus> status;
+  /*! Value of each variable*/
+  std::vector<Scalar> x;
+  /*! Dual value of each row*/
+  std::vector<Scalar> y;
+  /*! Reduced cost of each variable (zero for basic variables)*/
+  std::vector<Scalar> d;
+  /*! FTRAN of the entering column*/
+  teensymat::IndexedVector<Scalar> column;
+  /*! Combined column of the bound flips*/
+  teensymat::IndexedVector<Scalar> flip_column;
+  /*! BTRAN of the leaving row (the logical part of the pivot row is -rho)*/
+  teensymat::IndexedVector<Scalar> rho;
+  /*! Structural part of the pivot row*/
+  teensymat::IndexedVector<Scalar> pivot_row;
+  /*! B^-1 rho, for pricing strategies which need it*/
+  teensymat::IndexedVector<Scalar> tau;
+  /*! Pricing strategy of the dual simplex*/
+  std::unique_ptr<DualPricing<Scalar>> dual_pricing;
+  /*! Pricing strategy of the primal simplex*/
+  std::unique_ptr<PrimalPricing<Scalar>> primal_pricing;
+  /*! Whether the dual pricing weights no longer match the basis*/
+  bool dual_weights_stale;
+  /*! Basis positions which may be primal infeasible*/
+  std::vector<size_t> infeasible;
+  /*! Whether each basis position is in infeasible*/
+  std::vector<char> listed;
+  /*! Whether infeasible must be rebuilt from scratch*/
+  bool infeasible_stale;
+  /*! Number of iterations performed in the current solve*/
+  size_t iterations;
+  /*! Whether the basis was given or kept from a previous solve, so the
+   * primal simplex runs first when it is primal feasible*/
+  bool resumed;
+
+  /*! A candidate of the dual ratio test*/
+  struct Candidate {
+    size_t var;
+    Scalar alpha;
+    Scalar ratio;
+  };
+  /*! Candidates of the dual ratio test*/
+  std::vector<Candidate> candidates;
+  /*! Variables flipped by the dual ratio test*/
+  std::vector<size_t> flips;
+
+  // SECTION: Setup
+  /*! Scale the constraints (copied from the problem) and build the bounds
+   * and costs of all variables*/
+  void load() {
+    size_t m = this->nrows;
+    size_t n = this->ncols;
+    if (this->options.scale && this->constraints.get_nnz() > 0) {
+      teensymat::Scaling<Scalar> geometric =
+          teensymat::geometric_scaling(this->constraints);
+      teensymat::apply_scaling(this->constraints, geometric);
+      this->scaling = teensymat::ruiz_scaling(this->constraints);
+      teensymat::apply_scaling(this->constraints, this->scaling);
+      for (size_t i = 0; i < m; i++) {
+        this->scaling.row_scale[i] *= geometric.row_scale[i];
+      }
+      for (size_t j = 0; j < n; j++) {
+        this->scaling.col_scale[j] *= geometric.col_scale[j];
+      }
+    } else {
+      this->scaling.row_scale.assign(m, 1);
+      this->scaling.col_scale.assign(n, 1);
+    }
+    this->constraint_rows = this->constraints.transpose();
+    this->load_costs_and_bounds();
+  }
+  /*! Build the scaled costs and bounds of all variables*/
+  void load_costs_and_bounds() {
+    size_t m = this->nrows;
+    size_t n = this->ncols;
+    this->base_cost.assign(n + m, 0);
+    this->lower.resize(n + m);
+    this->upper.resize(n + m);
+    for (size_t j = 0; j < n; j++) {
+      Scalar scale = this->scaling.col_scale[j];
+      this->base_cost[j] = this->problem.objective[j] * scale;
+      this->lower[j] = this->problem.col_lower[j] / scale;
+      this->upper[j] = this->problem.col_upper[j] / scale;
+    }
+    for (size_t i = 0; i < m; i++) {
+      Scalar scale = this->scaling.row_scale[i];
+      this->lower[n + i] = this->problem.row_lower[i] * scale;
+      this->upper[n + i] = this->problem.row_upper[i] * scale;
+    }
+    this->cost = this->base_cost;
+  }
+  /*! Status of a nonbasic variable placed at its bound nearest zero*/
+  BasisStatus default_status(size_t var) const {
+    bool has_lower = std::isfinite(this->lower[var]);
+    bool has_upper = std::isfinite(this->upper[var]);
+    if (has_lower && has_upper) {
+      return std::abs(this->lower[var]) <= std::abs(this->upper[var])
+                 ? BasisStatus::at_lower
+                 : BasisStatus::at_upper;
+    }
+    if (has_lower) {
+      return BasisStatus::at_lower;
+    }
+    return has_upper ? BasisStatus::at_upper : BasisStatus::free;
+  }
+  /*! Replace a nonbasic status which does not match the bounds of a
+   * variable by the default one*/
+  void repair_status(size_t var) {
+    BasisStatus value = this->status[var];
+    if ((value == BasisStatus::at_lower && !std::isfinite(this->lower[var])) ||
+        (value == BasisStatus::at_upper && !std::isfinite(this->upper[var])) ||
+        (value == BasisStatus::free && (std::isfinite(this->lower[var]) ||
+                                        std::isfinite(this->upper[var])))) {
+      this->status[var] = this->default_status(var);
+    }
+  }
+  /*! Value of a nonbasic variable given its status*/
+  Scalar nonbasic_value(size_t var) const {
+    switch (this->status[var]) {
+    case BasisStatus::at_lower:
+      return this->lower[var];
+    case BasisStatus::at_upper:
+      return this->upper[var];
+    default:
+      return 0;
+    }
+  }
+  /*! Whether a variable has two finite bounds*/
+  bool is_boxed(size_t var) const {
+    return std::isfinite(this->lower[var]) && std::isfinite(this->upper[var]);
+  }
+  /*! Call func(row, value) for every entry of the column of a variable*/
+  template <typename Func> void for_each_entry(size_t var, Func &&func) const {
+    if (var >= this->ncols) {
+      func(var - this->ncols, Scalar{-1});
+      return;
+    }
+    auto const &col_ptr = this->constraints.get_col_ptr();
+    auto const &row_idx = this->constraints.get_row_idx();
+    Scalar const *values = this->constraints.get_values()->data();
+    for (size_t k = col_ptr[var]; k < col_ptr[var + 1]; k++) {
+      func(row_idx[k], values[k]);
+    }
+  }
+  /*! Put all logicals in the basis*/
+  void set_slack_basis() {
+    size_t m = this->nrows;
+    size_t n = this->ncols;
+    this->basic.resize(m);
+    this->position.assign(n + m, npos);
+    this->status.resize(n + m);
+    for (size_t j = 0; j < n; j++) {
+      this->status[j] = this->default_status(j);
+    }
+    for (size_t i = 0; i < m; i++) {
+      this->basic[i] = n + i;
+      this->position[n + i] = i;
+      this->status[n + i] = BasisStatus::basic;
+    }
+  }
+
+  // SECTION: Basis computations
+  /*! Refactorize the basis and recompute the primal and dual values*/
+  void reinvert() {
+    auto replaced = this->factor.factorize(this->basic);
+    for (auto const &[pos, var] : replaced) {
+      this->position[var] = npos;
+      this->status[var] = this->default_status(var);
+      this->position[this->basic[pos]] = pos;
+      this->status[this->basic[pos]] = BasisStatus::basic;
+    }
+    if (!replaced.empty()) {
+      this->dual_weights_stale = true;
+    }
+    this->compute_primal();
+    this->compute_dual();
+  }
+  /*! Set the nonbasic variables to their bounds and solve for the basic
+   * ones*/
+  void compute_primal() {
+    size_t total = this->ncols + this->nrows;
+    this->column.clear();
+    for (size_t j = 0; j < total; j++) {
+      if (this->status[j] == BasisStatus::basic) {
+        continue;
+      }
+      Scalar value = this->nonbasic_value(j);
+      this->x[j] = value;
+      if (value != Scalar{0}) {
+        this->for_each_entry(j, [&](size_t row, Scalar entry) {
+          this->column.add(row, -entry * value);
+        });
+      }
+    }
+    this->factor.ftran(this->column);
+    for (size_t p = 0; p < this->nrows; p++) {
+      this->x[this->basic[p]] = this->column.values[p];
+    }
+    this->column.clear();
+    this->infeasible_stale = true;
+  }
+  /*! Solve for the duals and recompute all reduced costs*/
+  void compute_dual() {
+    size_t m = this->nrows;
+    size_t n = this->ncols;
+    this->rho.clear();
+    for (size_t p = 0; p < m; p++) {
+      Scalar c = this->cost[this->basic[p]];
+      if (c != Scalar{0}) {
+        this->rho.values[p] = c;
+        this->rho.index.push_back(p);
+      }
+    }
+    this->factor.btran(this->rho);
+    std::fill(this->y.begin(), this->y.end(), Scalar{0});
+    for (size_t i : this->rho.index) {
+      this->y[i] = this->rho.values[i];
+    }
+    this->rho.clear();
+    std::fill(this->d.begin(), this->d.begin() + n, Scalar{0});
+    this->constraints.gaxpy_transpose(-1, this->y.data(), this->d.data());
+    for (size_t j = 0; j < n; j++) {
+      this->d[j] += this->cost[j];
+    }
+    for (size_t i = 0; i < m; i++) {
+      this->d[n + i] = this->cost[n + i] + this->y[i];
+    }
+    for (size_t var : this->basic) {
+      this->d[var] = 0;
+    }
+  }
+  /*! Compute the structural part of the pivot row rho^T A (the logical part
+   * is -rho), row wise when rho is sparse and in parallel by columns
+   * otherwise*/
+  void compute_pivot_row() {
+    this->pivot_row.clear();
+    if (this->rho.get_density() < 0.1) {
+      auto const &row_ptr = this->constraint_rows.get_col_ptr();
+      auto const &col_idx = this->constraint_rows.get_row_idx();
+      Scalar const *values = this->constraint_rows.get_values()->data();
+      for (size_t i : this->rho.index) {
+        Scalar rho_i = this->rho.values[i];
+        for (size_t k = row_ptr[i]; k < row_ptr[i + 1]; k++) {
+          this->pivot_row.add(col_idx[k], rho_i * values[k]);
+        }
+      }
+      return;
+    }
+    auto const &col_ptr = this->constraints.get_col_ptr();
+    auto const &row_idx = this->constraints.get_row_idx();
+    Scalar const *values = this->constraints.get_values()->data();
+    Scalar const *rho_values = this->rho.values.data();
+    Scalar *out = this->pivot_row.values.data();
+    teensymat::parallel_for(this->ncols, 1024, [&](size_t begin, size_t end) {
+      for (size_t j = begin; j < end; j++) {
+        if (this->status[j] == BasisStatus::basic) {
+          continue;
+        }
+        Scalar sum = 0;
+        for (size_t k = col_ptr[j]; k < col_ptr[j + 1]; k++) {
+          sum += values[k] * rho_values[row_idx[k]];
+        }
+        out[j] = sum;
+      }
+    });
+    this->pivot_row.rebuild_index();
+  }
+  /*! Add the cost change making d_var zero to the cost of var*/
+  void shift_cost_to_zero(size_t var) {
+    this->cost[var] -= this->d[var];
+    this->d[var] = 0;
+  }
+  /*! Largest primal bound violation*/
+  Scalar primal_infeasibility() const {
+    Scalar largest = 0;
+    for (size_t var : this->basic) {
+      largest = std::max(largest, this->lower[var] - this->x[var]);
+      largest = std::max(largest, this->x[var] - this->upper[var]);
+    }
+    return largest;
+  }
+  /*! Dual infeasibility of a nonbasic variable (zero if d has the right
+   * sign for its status)*/
+  Scalar dual_infeasibility(size_t var) const {
+    if (this->lower[var] == this->upper[var]) {
+      return 0;
+    }
+    switch (this->status[var]) {
+    case BasisStatus::at_lower:
+      return std::max(Scalar{0}, -this->d[var]);
+    case BasisStatus::at_upper:
+      return std::max(Scalar{0}, this->d[var]);
+    case BasisStatus::free:
+      return std::abs(this->d[var]);
+    default:
+      return 0;
+    }
+  }
+  /*! Largest dual infeasibility*/
+  Scalar dual_infeasibility() const {
+    Scalar largest = 0;
+    for (size_t var = 0; var < this->ncols + this->nrows; var++) {
+      largest = std::max(largest, this->dual_infeasibility(var));
+    }
+    return largest;
+  }
+  /*! Describe the basis change in progress to a pricing strategy*/
+  PivotData<Scalar> pivot_data(size_t pos, size_t entering, size_t leaving,
+                               Scalar alpha) const {
+    return PivotData<Scalar>{pos,          entering,         leaving,
+                             alpha,        this->ncols,      &this->column,
+                             &this->rho,   &this->pivot_row, &this->tau,
+                             &this->status, &this->basic};
+  }
+  /*! Replace the variable at a basis position*/
+  void change_basis(size_t pos, size_t entering, size_t leaving,
+                    BasisStatus leaving_status) {
+    this->factor.update(pos, this->column);
+    this->basic[pos] = entering;
+    this->position[entering] = pos;
+    this->position[leaving] = npos;
+    this->status[entering] = BasisStatus::basic;
+    this->status[leaving] = leaving_status;
+    this->d[entering] = 0;
+  }
+  /*! Update the reduced costs and duals with the pivot row, after the
+   * variable at basis position pos leaves for entering*/
+  void update_duals(size_t entering, size_t leaving, Scalar alpha) {
+    Scalar theta = this->d[entering] / alpha;
+    if (theta == Scalar{0}) {
+      return;
+    }
+    for (size_t j : this->pivot_row.index) {
+      if (this->status[j] != BasisStatus::basic) {
+        this->d[j] -= theta * this->pivot_row.values[j];
+      }
+    }
+    for (size_t i : this->rho.index) {
+      this->y[i] += theta * this->rho.values[i];
+      size_t logical = this->ncols + i;
+      if (this->status[logical] != BasisStatus::basic) {
+        this->d[logical] += theta * this->rho.values[i];
+      }
+    }
+    this->d[leaving] = -theta;
+  }
+
+  // SECTION: Dual simplex
+  /*! Bound violation of the basic variable at a position beyond the
+   * primal tolerance (at most zero if it is feasible)*/
+  Scalar violation(size_t pos) const {
+    size_t var = this->basic[pos];
+    return std::max(this->lower[var] - this->x[var],
+                    this->x[var] - this->upper[var]) -
+           this->options.primal_tolerance;
+  }
+  /*! Add basis positions whose values changed to the infeasible list*/
+  void list_changed(std::vector<size_t> const &positions) {
+    for (size_t p : positions) {
+      if (!this->listed[p]) {
+        this->listed[p] = 1;
+        this->infeasible.push_back(p);
+      }
+    }
+  }
+  /*! Choose the basis position of the leaving variable with the dual
+   * pricing strategy, or npos if the basis is primal feasible*/
+  size_t choose_leaving() {
+    if (this->infeasible_stale) {
+      this->infeasible.clear();
+      for (size_t p = 0; p < this->nrows; p++) {
+        this->listed[p] = this->violation(p) > 0;
+        if (this->listed[p]) {
+          this->infeasible.push_back(p);
+        }
+      }
+      this->infeasible_stale = false;
+    } else {
+      // Drop positions which became feasible
+      size_t kept = 0;
+      for (size_t p : this->infeasible) {
+        if (this->violation(p) > 0) {
+          this->infeasible[kept++] = p;
+        } else {
+          this->listed[p] = 0;
+        }
+      }
+      this->infeasible.resize(kept);
+    }
+    size_t chosen = this->dual_pricing->choose(
+        this->infeasible, [this](size_t p) { return this->violation(p); });
+    return chosen < this->infeasible.size() ? this->infeasible[chosen] : npos;
+  }
+  /*! Bound flipping ratio test of the dual simplex.
+   *
+   * @param slope Primal infeasibility of the leaving variable (the initial
+   * slope of the dual objective)
+   * @param sign -1 if the leaving variable is below its lower bound, +1 if
+   * above its upper bound
+   * @return The entering variable, or npos if the dual is unbounded
+   * */
+  size_t dual_ratio_test(Scalar slope, Scalar sign) {
+    Scalar tolerance = this->options.dual_tolerance;
+    this->candidates.clear();
+    this->flips.clear();
+    auto consider = [&](size_t var, Scalar alpha) {
+      if (this->status[var] == BasisStatus::basic ||
+          this->lower[var] == this->upper[var]) {
+        return;
+      }
+      Scalar signed_alpha = sign * alpha;
+      if (std::abs(signed_alpha) <= this->options.pivot_tolerance) {
+        return;
+      }
+      Scalar dual = this->d[var];
+      switch (this->status[var]) {
+      case BasisStatus::at_lower:
+        if (signed_alpha < 0) {
+          return;
+        }
+        break;
+      case BasisStatus::at_upper:
+        if (signed_alpha > 0) {
+          return;
+        }
+        dual = -dual;
+        break;
+      default:
+        dual = std::abs(dual);
+        break;
+      }
+      this->candidates.push_back(
+          {var, signed_alpha,
+           std::max(Scalar{0}, dual) / std::abs(signed_alpha)});
+    };
+    for (size_t j : this->pivot_row.index) {
+      consider(j, this->pivot_row.values[j]);
+    }
+    for (size_t i : this->rho.index) {
+      consider(this->ncols + i, -this->rho.values[i]);
+    }
+    std::sort(this->candidates.begin(), this->candidates.end(),
+              [](Candidate const &a, Candidate const &b) {
+                return a.ratio < b.ratio;
+              });
+    // Pass breakpoints of boxed variables (which flip to their other bound)
+    // while the dual objective keeps increasing. The leaving variable must
+    // stay infeasible by more than the tolerance, otherwise its row could
+    // be declared infeasible when the flips make it exactly feasible
+    size_t first = 0;
+    while (first < this->candidates.size()) {
+      Candidate const &candidate = this->candidates[first];
+      if (!this->is_boxed(candidate.var)) {
+        break;
+      }
+      Scalar step = std::abs(candidate.alpha) *
+                    (this->upper[candidate.var] - this->lower[candidate.var]);
+      if (slope - step <= this->options.primal_tolerance) {
+        break;
+      }
+      slope -= step;
+      this->flips.push_back(candidate.var);
+      first++;
+    }
+    if (first == this->candidates.size()) {
+      return npos;
+    }
+    // Harris: the largest pivot among the breakpoints within the relaxed
+    // bound on the step
+    Scalar bound = std::numeric_limits<Scalar>::infinity();
+    for (size_t k = first; k < this->candidates.size(); k++) {
+      Candidate const &candidate = this->candidates[k];
+      if (candidate.ratio > bound) {
+        break;
+      }
+      bound = std::min(bound, candidate.ratio +
+                                  tolerance / std::abs(candidate.alpha));
+    }
+    size_t chosen = first;
+    for (size_t k = first; k < this->candidates.size(); k++) {
+      Candidate const &candidate = this->candidates[k];
+      if (candidate.ratio > bound) {
+        break;
+      }
+      if (std::abs(candidate.alpha) >
+          std::abs(this->candidates[chosen].alpha)) {
+        chosen = k;
+      }
+    }
+    return this->candidates[chosen].var;
+  }
+  /*! Move the variables chosen by the ratio test to their other bound and
+   * update the basic variables*/
+  void apply_flips() {
+    if (this->flips.empty()) {
+      return;
+    }
+    this->flip_column.clear();
+    for (size_t var : this->flips) {
+      Scalar old_value = this->x[var];
+      this->status[var] = this->status[var] == BasisStatus::at_lower
+                              ? BasisStatus::at_upper
+                              : BasisStatus::at_lower;
+      Scalar change = this->nonbasic_value(var) - old_value;
+      this->x[var] += change;
+      this->for_each_entry(var, [&](size_t row, Scalar entry) {
+        this->flip_column.add(row, entry * change);
+      });
+    }
+    this->factor.ftran(this->flip_column);
+    for (size_t p : this->flip_column.index) {
+      this->x[this->basic[p]] -= this->flip_column.values[p];
+    }
+  }
+  /*! Load the FTRAN of the column of a variable into this->column*/
+  void ftran_column(size_t var) {
+    this->column.clear();
+    this->for_each_entry(var, [&](size_t row, Scalar entry) {
+      this->column.values[row] = entry;
+      this->column.index.push_back(row);
+    });
+    this->factor.ftran(this->column);
+  }
+  /*! Load the BTRAN of e_pos into this->rho*/
+  void btran_unit(size_t pos) {
+    this->rho.clear();
+    this->rho.values[pos] = 1;
+    this->rho.index.push_back(pos);
+    this->factor.btran(this->rho);
+  }
+  /*! Squared norm of row pos of B^-1 (overwrites this->rho)*/
+  Scalar row_norm_squared(size_t pos) {
+    this->btran_unit(pos);
+    Scalar norm = 0;
+    for (size_t i : this->rho.index) {
+      norm += this->rho.values[i] * this->rho.values[i];
+    }
+    return norm;
+  }
+  /*! Refactorize when the eta file is long*/
+  void maybe_reinvert() {
+    if (this->factor.get_num_updates() >= this->options.refactor_interval ||
+        this->factor.get_eta_nnz() > 2 * this->factor.get_factor_nnz() +
+                                         10 * this->nrows) {
+      this->reinvert();
+    }
+  }
+  /*! Run the dual simplex from a dual feasible basis.
+   *
+   * @return optimal (primal feasible), infeasible, iteration_limit or
+   * numerical_error
+   * */
+  LPStatus dual_phase() {
+    size_t troubles = 0;
+    this->infeasible_stale = true;
+    while (true) {
+      if (this->dual_weights_stale) {
+        this->dual_pricing->reset(
+            this->nrows, this->status,
+            [this](size_t pos) { return this->row_norm_squared(pos); });
+        this->dual_weights_stale = false;
+      }
+      if (this->iterations >= this->options.max_iterations) {
+        return LPStatus::iteration_limit;
+      }
+      this->maybe_reinvert();
+      size_t pos = this->choose_leaving();
+      if (pos == npos) {
+        return LPStatus::optimal;
+      }
+      size_t leaving = this->basic[pos];
+      bool to_lower = this->x[leaving] < this->lower[leaving];
+      Scalar target = to_lower ? this->lower[leaving] : this->upper[leaving];
+      this->btran_unit(pos);
+      this->compute_pivot_row();
+      size_t entering = this->dual_ratio_test(
+          std::abs(this->x[leaving] - target), to_lower ? -1 : 1);
+      if (entering == npos) {
+        if (this->factor.get_num_updates() > 0) {
+          // Confirm with a fresh factorization before declaring
+          this->reinvert();
+          continue;
+        }
+        return LPStatus::infeasible;
+      }
+      this->ftran_column(entering);
+      Scalar alpha = this->column.values[pos];
+      Scalar row_alpha = entering < this->ncols
+                             ? this->pivot_row.values[entering]
+                             : -this->rho.values[entering - this->ncols];
+      if (std::abs(alpha - row_alpha) > 1e-7 * (1 + std::abs(alpha)) ||
+          std::abs(alpha) <= this->options.pivot_tolerance) {
+        if (this->factor.get_num_updates() == 0 || ++troubles > 10) {
+          return LPStatus::numerical_error;
+        }
+        this->reinvert();
+        continue;
+      }
+      // Remove a Harris sized dual infeasibility of the entering variable
+      // so the dual step has the right sign
+      if (this->dual_infeasibility(entering) > 0) {
+        this->shift_cost_to_zero(entering);
+      }
+      if (this->dual_pricing->needs_tau()) {
+        this->tau.clear();
+        for (size_t i : this->rho.index) {
+          this->tau.values[i] = this->rho.values[i];
+          this->tau.index.push_back(i);
+        }
+        this->factor.ftran(this->tau);
+      }
+      this->dual_pricing->update(
+          this->pivot_data(pos, entering, leaving, alpha));
+      this->update_duals(entering, leaving, alpha);
+      this->apply_flips();
+      if (!this->flips.empty()) {
+        this->list_changed(this->flip_column.index);
+      }
+      Scalar theta = (this->x[leaving] - target) / alpha;
+      for (size_t p : this->column.index) {
+        this->x[this->basic[p]] -= theta * this->column.values[p];
+      }
+      this->list_changed(this->column.index);
+      this->x[entering] += theta;
+      this->x[leaving] = target;
+      this->change_basis(pos, entering, leaving,
+                         to_lower ? BasisStatus::at_lower
+                                  : BasisStatus::at_upper);
+      this->iterations++;
+    }
+  }
+  /*! Make the current basis dual feasible: boxed variables move to the
+   * bound matching the sign of their reduced cost, and the costs of the
+   * others are shifted. Optionally perturbs the costs as well.*/
+  void make_dual_feasible(bool perturb) {
+    bool flipped = false;
+    for (size_t var = 0; var < this->ncols + this->nrows; var++) {
+      if (this->status[var] == BasisStatus::basic ||
+          this->lower[var] == this->upper[var]) {
+        continue;
+      }
+      if (perturb) {
+        // Deterministic pseudo random perturbation keeping the sign of d
+        uint64_t hash = (var + 1) * 0x9E3779B97F4A7C15ull;
+        Scalar fraction = Scalar(0.5) + Scalar(hash >> 40) / Scalar(1 << 25);
+        Scalar amount = Scalar(1e-6) * (1 + std::abs(this->cost[var])) *
+                        fraction;
+        Scalar direction = this->status[var] == BasisStatus::at_lower
+                               ? 1
+                               : (this->status[var] == BasisStatus::at_upper
+                                      ? -1
+                                      : 0);
+        this->cost[var] += direction * amount;
+        this->d[var] += direction * amount;
+      }
+      if (this->dual_infeasibility(var) <= this->options.dual_tolerance) {
+        continue;
+      }
+      if (this->is_boxed(var)) {
+        this->status[var] = this->d[var] >= 0 ? BasisStatus::at_lower
+                                              : BasisStatus::at_upper;
+        flipped = true;
+      } else {
+        this->shift_cost_to_zero(var);
+      }
+    }
+    if (flipped) {
+      this->compute_primal();
+    }
+  }
+
+  /*! Whether some variable which can not be flipped is dual infeasible*/
+  bool needs_dual_phase_one() const {
+    for (size_t var = 0; var < this->ncols + this->nrows; var++) {
+      if (!this->is_boxed(var) &&
+          this->dual_infeasibility(var) > this->options.dual_tolerance) {
+        return true;
+      }
+    }
+    return false;
+  }
+  /*! Dual phase one (subproblem approach): with the bounds replaced by
+   * [-1, 1] for free variables, [0, 1] and [-1, 0] for one sided ones and
+   * [0, 0] for boxed ones, every variable can be flipped so the dual simplex
+   * applies, and its optimal basis minimizes the total dual infeasibility
+   * of the original problem.
+   *
+   * @return optimal, iteration_limit or numerical_error
+   * */
+  LPStatus dual_phase_one() {
+    size_t total = this->ncols + this->nrows;
+    std::vector<Scalar> saved_lower(total);
+    std::vector<Scalar> saved_upper(total);
+    for (size_t var = 0; var < total; var++) {
+      saved_lower[var] = this->lower[var];
+      saved_upper[var] = this->upper[var];
+      this->lower[var] = std::isfinite(saved_lower[var]) ? 0 : -1;
+      this->upper[var] = std::isfinite(saved_upper[var]) ? 0 : 1;
+      if (this->status[var] != BasisStatus::basic) {
+        this->status[var] = BasisStatus::at_lower;
+      }
+    }
+    this->make_dual_feasible(false);
+    this->compute_primal();
+    LPStatus result = this->dual_phase();
+    this->lower.swap(saved_lower);
+    this->upper.swap(saved_upper);
+    for (size_t var = 0; var < total; var++) {
+      if (this->status[var] == BasisStatus::basic) {
+        continue;
+      }
+      this->status[var] = this->default_status(var);
+      if (this->is_boxed(var)) {
+        this->status[var] = this->d[var] >= 0 ? BasisStatus::at_lower
+                                              : BasisStatus::at_upper;
+      }
+    }
+    this->compute_primal();
+    return result;
+  }
+
+  // SECTION: Primal simplex
+  /*! Choose the entering variable with the primal pricing strategy, or
+   * npos if the basis is dual feasible*/
+  size_t choose_entering() const {
+    size_t total = this->ncols + this->nrows;
+    size_t chosen = this->primal_pricing->choose(total, [this](size_t var) {
+      return this->dual_infeasibility(var) - this->options.dual_tolerance;
+    });
+    return chosen < total ? chosen : npos;
+  }
+  /*! Harris two pass ratio test of the primal simplex.
+   *
+   * @param direction +1 if the entering variable increases, -1 otherwise
+   * @param step Set to the step length of the entering variable
+   * @return The basis position of the leaving variable, or npos if none
+   * blocks
+   * */
+  size_t primal_ratio_test(Scalar direction, Scalar &step) const {
+    Scalar tolerance = this->options.primal_tolerance;
+    Scalar bound = std::numeric_limits<Scalar>::infinity();
+    for (size_t p : this->column.index) {
+      Scalar alpha = direction * this->column.values[p];
+      size_t var = this->basic[p];
+      if (alpha > this->options.pivot_tolerance &&
+          std::isfinite(this->lower[var])) {
+        bound = std::min(bound,
+                         (this->x[var] - this->lower[var] + tolerance) / alpha);
+      } else if (alpha < -this->options.pivot_tolerance &&
+                 std::isfinite(this->upper[var])) {
+        bound = std::min(
+            bound, (this->upper[var] - this->x[var] + tolerance) / -alpha);
+      }
+    }
+    size_t chosen = npos;
+    Scalar chosen_alpha = 0;
+    step = std::numeric_limits<Scalar>::infinity();
+    if (!std::isfinite(bound)) {
+      return npos;
+    }
+    for (size_t p : this->column.index) {
+      Scalar alpha = direction * this->column.values[p];
+      size_t var = this->basic[p];
+      Scalar ratio;
+      if (alpha > this->options.pivot_tolerance &&
+          std::isfinite(this->lower[var])) {
+        ratio = (this->x[var] - this->lower[var]) / alpha;
+      } else if (alpha < -this->options.pivot_tolerance &&
+                 std::isfinite(this->upper[var])) {
+        ratio = (this->upper[var] - this->x[var]) / -alpha;
+      } else {
+        continue;
+      }
+      if (ratio <= bound && std::abs(alpha) > chosen_alpha) {
+        chosen = p;
+        chosen_alpha = std::abs(alpha);
+        step = std::max(Scalar{0}, ratio);
+      }
+    }
+    return chosen;
+  }
+  /*! Run the primal simplex from a primal feasible basis.
+   *
+   * @return optimal, unbounded, iteration_limit or numerical_error
+   * */
+  LPStatus primal_phase() {
+    size_t troubles = 0;
+    this->primal_pricing->reset(this->status);
+    while (true) {
+      if (this->iterations >= this->options.max_iterations) {
+        return LPStatus::iteration_limit;
+      }
+      this->maybe_reinvert();
+      size_t entering = this->choose_entering();
+      if (entering == npos) {
+        return LPStatus::optimal;
+      }
+      Scalar direction = this->d[entering] < 0 ? 1 : -1;
+      this->ftran_column(entering);
+      Scalar step;
+      size_t pos = this->primal_ratio_test(direction, step);
+      Scalar range = this->upper[entering] - this->lower[entering];
+      if (std::isfinite(range) && range <= step) {
+        // The entering variable reaches its other bound first
+        for (size_t p : this->column.index) {
+          this->x[this->basic[p]] -=
+              direction * range * this->column.values[p];
+        }
+        this->status[entering] = direction > 0 ? BasisStatus::at_upper
+                                               : BasisStatus::at_lower;
+        this->x[entering] = this->nonbasic_value(entering);
+        this->iterations++;
+        continue;
+      }
+      if (pos == npos) {
+        if (this->factor.get_num_updates() > 0) {
+          this->reinvert();
+          continue;
+        }
+        return LPStatus::unbounded;
+      }
+      size_t leaving = this->basic[pos];
+      Scalar alpha = this->column.values[pos];
+      this->btran_unit(pos);
+      this->compute_pivot_row();
+      Scalar row_alpha = entering < this->ncols
+                             ? this->pivot_row.values[entering]
+                             : -this->rho.values[entering - this->ncols];
+      if (std::abs(alpha - row_alpha) > 1e-7 * (1 + std::abs(alpha))) {
+        if (this->factor.get_num_updates() == 0 || ++troubles > 10) {
+          return LPStatus::numerical_error;
+        }
+        this->reinvert();
+        continue;
+      }
+      bool to_lower = direction * alpha > 0;
+      for (size_t p : this->column.index) {
+        this->x[this->basic[p]] -= direction * step * this->column.values[p];
+      }
+      this->x[entering] += direction * step;
+      this->x[leaving] = to_lower ? this->lower[leaving] : this->upper[leaving];
+      this->primal_pricing->update(
+          this->pivot_data(pos, entering, leaving, alpha));
+      this->dual_weights_stale = true;
+      this->update_duals(entering, leaving, alpha);
+      this->change_basis(pos, entering, leaving,
+                         to_lower ? BasisStatus::at_lower
+                                  : BasisStatus::at_upper);
+      this->iterations++;
+    }
+  }
+
+  // SECTION: Driver
+  /*! Run the simplex phases until the basis is optimal for the original
+   * costs (or a limit or certificate is reached)*/
+  LPStatus run() {
+    for (size_t var = 0; var < this->ncols + this->nrows; var++) {
+      if (this->lower[var] > this->upper[var]) {
+        return LPStatus::infeasible;
+      }
+    }
+    bool perturb = this->options.perturb_costs;
+    bool primal_first =
+        this->options.algorithm == SimplexAlgorithm::primal || this->resumed;
+    for (size_t attempt = 0; attempt < 5; attempt++) {
+      this->cost = this->base_cost;
+      this->reinvert();
+      bool primal_feasible =
+          this->primal_infeasibility() <= this->options.primal_tolerance;
+      bool dual_feasible =
+          this->dual_infeasibility() <= this->options.dual_tolerance;
+      if (primal_feasible && dual_feasible) {
+        return LPStatus::optimal;
+      }
+      if (!primal_feasible || (!primal_first && !dual_feasible)) {
+        if (this->needs_dual_phase_one()) {
+          LPStatus result = this->dual_phase_one();
+          if (result != LPStatus::optimal) {
+            return result;
+          }
+        }
+        this->make_dual_feasible(perturb);
+        perturb = false;
+        LPStatus result = this->dual_phase();
+        if (result != LPStatus::optimal) {
+          return result;
+        }
+        this->cost = this->base_cost;
+        this->compute_dual();
+      }
+      LPStatus result = this->primal_phase();
+      if (result != LPStatus::optimal) {
+        return result;
+      }
+    }
+    return LPStatus::numerical_error;
+  }
+  /*! Unscale the current point into an LPSolution*/
+  LPSolution<Scalar> make_solution(LPStatus result) const {
+    size_t m = this->nrows;
+    size_t n = this->ncols;
+    LPSolution<Scalar> solution;
+    solution.status = result;
+    solution.iterations = this->iterations;
+    solution.x.assign(this->x.begin(), this->x.begin() + n);
+    this->scaling.unscale_primal(solution.x);
+    solution.row_activity.resize(m);
+    for (size_t i = 0; i < m; i++) {
+      solution.row_activity[i] = this->x[n + i] / this->scaling.row_scale[i];
+    }
+    solution.row_duals = this->y;
+    this->scaling.unscale_dual(solution.row_duals);
+    solution.reduced_costs.assign(this->d.begin(), this->d.begin() + n);
+    this->scaling.unscale_reduced_costs(solution.reduced_costs);
+    solution.col_status.assign(this->status.begin(),
+                               this->status.begin() + n);
+    solution.row_status.assign(this->status.begin() + n, this->status.end());
+    solution.objective = this->problem.evaluate(solution.x);
+    return solution;
+  }
+
+public:
+  // SECTION: Constructors
+  /*! Set up the solver for a problem (which is copied and scaled).
+   *
+   * @param problem The LP to solve
+   * @param options Options of the solve
+   * */
+  explicit RevisedSimplex(LPProblem<Scalar> const &problem,
+                          SimplexOptions<Scalar> const &options = {})
+      : nrows(problem.get_nrows()), ncols(problem.get_ncols()),
+        options(options),
+        constraints((problem.validate(), problem.constraints)),
+        problem(problem), factor(this->constraints),
+        x(nrows + ncols, 0), y(nrows, 0), d(nrows + ncols, 0),
+        column(nrows), flip_column(nrows), rho(nrows), pivot_row(ncols),
+        tau(nrows),
+        dual_pricing(make_dual_pricing<Scalar>(options.dual_pricing,
+                                               options.exact_dual_weights)),
+        primal_pricing(make_primal_pricing<Scalar>(
+            options.primal_pricing, options.partial_pricing_blocks)),
+        dual_weights_stale(true), listed(nrows, 0), infeasible_stale(true),
+        iterations(0), resumed(false) {
+    // Scaling only changes values, and the slack basis factorized above
+    // does not depend on them
+    this->load();
+    this->set_slack_basis();
+  }
+  RevisedSimplex(RevisedSimplex const &) = delete;
+  RevisedSimplex &operator=(RevisedSimplex const &) = delete;
+
+  // SECTION: Pricing
+  /*! Replace the pricing strategy of the dual simplex (its weights are
+   * reset before the next dual iteration)*/
+  void set_dual_pricing(std::unique_ptr<DualPricing<Scalar>> pricing) {
+    if (!pricing) {
+      throw std::runtime_error("Pricing strategy must not be null");
+    }
+    this->dual_pricing = std::move(pricing);
+    this->dual_weights_stale = true;
+  }
+  /*! Replace the pricing strategy of the primal simplex*/
+  void set_primal_pricing(std::unique_ptr<PrimalPricing<Scalar>> pricing) {
+    if (!pricing) {
+      throw std::runtime_error("Pricing strategy must not be null");
+    }
+    this->primal_pricing = std::move(pricing);
+  }
+  /*! Get the pricing strategy of the dual simplex*/
+  DualPricing<Scalar> const &get_dual_pricing() const {
+    return *this->dual_pricing;
+  }
+
+  // SECTION: Basis
+  /*! Start the next solve from a given basis. Nonbasic statuses which do
+   * not match the bounds of a variable are replaced by the default one, and
+   * a singular basis is repaired with logicals when it is factorized. The
+   * primal simplex runs first if the basis is primal feasible.
+   *
+   * Throws std::range_error if the lengths do not match the problem or the
+   * number of basic variables is not the number of rows.
+   *
+   * @param col_status Status of each structural variable
+   * @param row_status Status of each row logical
+   * */
+  void set_basis(std::vector<BasisStatus> const &col_status,
+                 std::vector<BasisStatus> const &row_status) {
+    size_t m = this->nrows;
+    size_t n = this->ncols;
+    if (col_status.size() != n || row_status.size() != m) {
+      throw std::range_error("Basis does not match the problem");
+    }
+    size_t count = 0;
+    for (BasisStatus value : col_status) {
+      count += value == BasisStatus::basic;
+    }
+    for (BasisStatus value : row_status) {
+      count += value == BasisStatus::basic;
+    }
+    if (count != m) {
+      throw std::range_error("Basis must have one basic variable per row");
+    }
+    size_t next = 0;
+    for (size_t var = 0; var < n + m; var++) {
+      BasisStatus value = var < n ? col_status[var] : row_status[var - n];
+      this->status[var] = value;
+      this->position[var] = npos;
+      if (value == BasisStatus::basic) {
+        this->basic[next] = var;
+        this->position[var] = next++;
+      } else {
+        this->repair_status(var);
+      }
+    }
+    this->dual_weights_stale = true;
+    this->resumed = true;
+  }
+  /*! Replace the data of the problem, keeping the current basis for the
+   * next solve. Only what changed is reloaded: new costs or bounds keep the
+   * scaling and the dual pricing weights, and new constraint values rescale
+   * the problem. After a cost change the basis stays primal feasible and
+   * the primal simplex finishes the solve; after a bound change it stays
+   * dual feasible and the dual simplex does.
+   *
+   * Throws std::range_error if the dimensions differ from the current
+   * problem.
+   *
+   * @param problem The new problem
+   * @return The parts of the problem which changed
+   * */
+  ProblemChanges update(LPProblem<Scalar> const &problem) {
+    ProblemChanges changes = compare_problems(this->problem, problem);
+    if (!changes.any()) {
+      return changes;
+    }
+    this->problem = problem;
+    if (changes.values) {
+      this->constraints = this->problem.constraints;
+      this->load();
+      this->dual_weights_stale = true;
+    } else {
+      this->load_costs_and_bounds();
+    }
+    for (size_t var = 0; var < this->ncols + this->nrows; var++) {
+      if (this->status[var] != BasisStatus::basic) {
+        this->repair_status(var);
+      }
+    }
+    this->resumed = true;
+    return changes;
+  }
+
+  // SECTION: Solving
+  /*! Solve the problem from the current basis (the slack basis initially,
+   * or the final basis of the previous solve).
+   *
+   * @return The solution, with the basis status of every variable and the
+   * number of iterations of this solve
+   * */
+  LPSolution<Scalar> solve() {
+    this->iterations = 0;
+    LPStatus result = this->run();
+    return this->make_solution(result);
+  }
+};
+
+/*! Solve an LP with the revised simplex method (see RevisedSimplex).
+ *
+ * @param problem The LP to solve
+ * @param options Options of the solve
+ * @return The solution, with the optimal basis
+ * */
+template <typename Scalar>
+LPSolution<Scalar> solve_simplex(LPProblem<Scalar> const &problem,
+                                 SimplexOptions<Scalar> const &options = {}) {
+  RevisedSimplex<Scalar> solver{problem, options};
+  return solver.solve();
+}
+} // namespace teensylp
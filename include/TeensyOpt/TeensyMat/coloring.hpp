@@ -0,0 +1,277 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <numeric>
+#include <set>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/sparse_core.hpp"
+
+namespace teensymat {
+/*! Orders in which the greedy colorings visit the vertices*/
+enum class ColoringOrder {
+  /*! Vertex (column) order*/
+  natural,
+  /*! Decreasing degree (Welsh-Powell)*/
+  largest_first,
+  /*! Dynamically, the vertex with the most distinct colors among its
+   * neighbours first, ties going to the largest degree (Brelaz)*/
+  dsatur,
+};
+
+/*! A coloring of the columns of a sparse matrix*/
+struct Coloring {
+  /*! Color of each column, in [0, num_colors)*/
+  std::vector<size_t> colors;
+  /*! Number of colors used*/
+  size_t num_colors = 0;
+  /*! Columns of each color: those of color c are
+   * columns[color_ptr[c]:color_ptr[c+1]], increasing*/
+  std::vector<size_t> color_ptr, columns;
+};
+
+namespace coloring_detail {
+/*! Greedy coloring of a graph.
+ *
+ * Visits the vertices in the given order and gives each the smallest
+ * color that forbid does not rule out. forbid(v, colors, mark) must set
+ * mark[c] = v for every color c that v may not take, at least those of
+ * its neighbours (colors holds the colors so far, n for uncolored).
+ *
+ * @param adjacency Neighbours of each vertex (no self loops, no
+ * duplicates)
+ * @param order Visiting order
+ * @param forbid The rule excluding colors
+ * @return The coloring
+ * */
+template <typename Forbid>
+Coloring greedy(std::vector<std::vector<size_t>> const &adjacency,
+                ColoringOrder order, Forbid &&forbid) {
+  size_t n = adjacency.size();
+  size_t none = n;
+  Coloring result;
+  result.colors.assign(n, none);
+  std::vector<size_t> mark(n + 1, none);
+  auto assign = [&](size_t v) {
+    forbid(v, result.colors, mark);
+    size_t c = 0;
+    while (mark[c] == v) {
+      c++;
+    }
+    result.colors[v] = c;
+    result.num_colors = std::max(result.num_colors, c + 1);
+  };
+  if (order == ColoringOrder::dsatur) {
+    // Queue of uncolored vertices by (saturation, degree, -index)
+    std::vector<size_t> saturation(n, 0);
+    std::set<std::tuple<size_t, size_t, size_t>> queue;
+    for (size_t v = 0; v < n; v++) {
+      queue.emplace(0, adjacency[v].size(), n - v);
+    }
+    while (!queue.empty()) {
+      size_t v = n - std::get<2>(*queue.rbegin());
+      queue.erase(std::prev(queue.end()));
+      assign(v);
+      size_t c = result.colors[v];
+      for (size_t u : adjacency[v]) {
+        if (result.colors[u] != none) {
+          continue;
+        }
+        // Saturation grows unless another neighbour already has color c
+        bool seen = false;
+        for (size_t w : adjacency[u]) {
+          if (w != v && result.colors[w] == c) {
+            seen = true;
+            break;
+          }
+        }
+        if (!seen) {
+          queue.erase({saturation[u], adjacency[u].size(), n - u});
+          saturation[u]++;
+          queue.emplace(saturation[u], adjacency[u].size(), n - u);
+        }
+      }
+    }
+  } else {
+    std::vector<size_t> visit(n);
+    std::iota(visit.begin(), visit.end(), size_t{0});
+    if (order == ColoringOrder::largest_first) {
+      std::stable_sort(visit.begin(), visit.end(), [&](size_t a, size_t b) {
+        return adjacency[a].size() > adjacency[b].size();
+      });
+    }
+    for (size_t v : visit) {
+      assign(v);
+    }
+  }
+  // Group the columns by color
+  result.color_ptr.assign(result.num_colors + 1, 0);
+  for (size_t c : result.colors) {
+    result.color_ptr[c + 1]++;
+  }
+  for (size_t c = 0; c < result.num_colors; c++) {
+    result.color_ptr[c + 1] += result.color_ptr[c];
+  }
+  result.columns.resize(n);
+  std::vector<size_t> next(result.color_ptr.begin(),
+                           result.color_ptr.end() - 1);
+  for (size_t v = 0; v < n; v++) {
+    result.columns[next[result.colors[v]]++] = v;
+  }
+  return result;
+}
+} // namespace coloring_detail
+
+/*! Color the columns of a sparse matrix so that no two columns of the
+ * same color have a nonzero in the same row (a distance-1 coloring of the
+ * column intersection graph).
+ *
+ * Each group of same colored columns can then be estimated from a single
+ * product with the sum of their unit vectors, as in the Curtis, Powell
+ * and Reid finite difference scheme.
+ *
+ * @param pattern The sparse matrix (only its pattern is used)
+ * @param order Visiting order of the greedy coloring
+ * @return The coloring
+ * */
+template <typename Scalar>
+Coloring color_columns(SparseMatrix<Scalar> const &pattern,
+                       ColoringOrder order = ColoringOrder::dsatur) {
+  size_t m = pattern.get_nrows();
+  size_t n = pattern.get_ncols();
+  auto const &col_ptr = pattern.get_col_ptr();
+  auto const &row_idx = pattern.get_row_idx();
+  // Columns of each row
+  std::vector<size_t> row_ptr(m + 1, 0);
+  for (size_t row : row_idx) {
+    row_ptr[row + 1]++;
+  }
+  for (size_t i = 0; i < m; i++) {
+    row_ptr[i + 1] += row_ptr[i];
+  }
+  std::vector<size_t> row_col(row_idx.size());
+  std::vector<size_t> next(row_ptr.begin(), row_ptr.end() - 1);
+  for (size_t j = 0; j < n; j++) {
+    for (size_t p = col_ptr[j]; p < col_ptr[j + 1]; p++) {
+      row_col[next[row_idx[p]]++] = j;
+    }
+  }
+  // Column intersection graph
+  std::vector<std::vector<size_t>> adjacency(n);
+  std::vector<size_t> mark(n, n);
+  for (size_t j = 0; j < n; j++) {
+    mark[j] = j;
+    for (size_t p = col_ptr[j]; p < col_ptr[j + 1]; p++) {
+      size_t row = row_idx[p];
+      for (size_t e = row_ptr[row]; e < row_ptr[row + 1]; e++) {
+        size_t k = row_col[e];
+        if (mark[k] != j) {
+          mark[k] = j;
+          adjacency[j].push_back(k);
+        }
+      }
+    }
+  }
+  return coloring_detail::greedy(
+      adjacency, order,
+      [&](size_t v, std::vector<size_t> const &colors,
+          std::vector<size_t> &forbidden) {
+        for (size_t u : adjacency[v]) {
+          if (colors[u] != n) {
+            forbidden[colors[u]] = v;
+          }
+        }
+      });
+}
+
+/*! Star coloring of a symmetric sparse matrix.
+ *
+ * A distance-1 coloring of the adjacency graph in which every path on
+ * four vertices uses at least three colors. Then for every off-diagonal
+ * nonzero (i, j), either j is the only neighbour of i with its color or
+ * i is the only neighbour of j with its color, so the matrix can be read
+ * directly from its products with the sums of the unit vectors of each
+ * color (Gebremedhin, Manne and Pothen), usually with far fewer colors
+ * than color_columns needs.
+ *
+ * The greedy rule rejects a color for v when it would complete a two
+ * colored path v - w - x - y or u - v - w - x, which takes time
+ * proportional to the cube of the degrees.
+ *
+ * @param pattern The symmetric matrix (only its pattern is used, and
+ * either triangle or both may be given)
+ * @param order Visiting order of the greedy coloring
+ * @return The coloring
+ * */
+template <typename Scalar>
+Coloring color_star(SparseMatrix<Scalar> const &pattern,
+                    ColoringOrder order = ColoringOrder::largest_first) {
+  size_t n = pattern.get_ncols();
+  if (pattern.get_nrows() != n) {
+    throw std::range_error("Star coloring requires a square matrix");
+  }
+  auto const &col_ptr = pattern.get_col_ptr();
+  auto const &row_idx = pattern.get_row_idx();
+  std::vector<std::vector<size_t>> adjacency(n);
+  for (size_t j = 0; j < n; j++) {
+    for (size_t p = col_ptr[j]; p < col_ptr[j + 1]; p++) {
+      size_t i = row_idx[p];
+      if (i != j) {
+        adjacency[i].push_back(j);
+        adjacency[j].push_back(i);
+      }
+    }
+  }
+  for (auto &neighbours : adjacency) {
+    std::sort(neighbours.begin(), neighbours.end());
+    neighbours.erase(std::unique(neighbours.begin(), neighbours.end()),
+                     neighbours.end());
+  }
+  std::vector<size_t> count(n + 1, 0);
+  return coloring_detail::greedy(
+      adjacency, order,
+      [&](size_t v, std::vector<size_t> const &colors,
+          std::vector<size_t> &forbidden) {
+        size_t none = n;
+        for (size_t w : adjacency[v]) {
+          if (colors[w] != none) {
+            forbidden[colors[w]] = v;
+            count[colors[w]]++;
+          }
+        }
+        for (size_t w : adjacency[v]) {
+          size_t a = colors[w];
+          if (a == none) {
+            continue;
+          }
+          for (size_t x : adjacency[w]) {
+            if (x == v || colors[x] == none) {
+              continue;
+            }
+            // u - v - w - x with colors(u) = colors(w)
+            if (count[a] > 1) {
+              forbidden[colors[x]] = v;
+              continue;
+            }
+            // v - w - x - y with colors(y) = colors(w)
+            for (size_t y : adjacency[x]) {
+              if (y != w && colors[y] == a) {
+                forbidden[colors[x]] = v;
+                break;
+              }
+            }
+          }
+        }
+        for (size_t w : adjacency[v]) {
+          if (colors[w] != none) {
+            count[colors[w]] = 0;
+          }
+        }
+      });
+}
+} // namespace teensymat
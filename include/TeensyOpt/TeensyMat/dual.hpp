@@ -0,0 +1,423 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <compare>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+
+namespace teensymat {
+/*! A dual number for forward mode automatic differentiation.
+ *
+ * Holds a value and its derivatives along N directions (the tangents),
+ * so one evaluation of a function on Duals gives N directional
+ * derivatives, e.g. N columns of a Jacobian. N is a compile-time
+ * constant: every operation on the tangents is a loop with a fixed trip
+ * count over contiguous lanes, which the compiler unrolls and vectorizes,
+ * and the type stays trivially copyable so Matrix<Dual> supports hashing
+ * and equals like any other Scalar.
+ *
+ * Arithmetic, comparisons and the conversion to bool (on the values only,
+ * like the branches of the differentiated code) and the usual elementary
+ * functions are provided.
+ * The functions are found by argument dependent lookup, so generic code
+ * should call them unqualified after using std::sqrt etc., as the
+ * TeensyMat kernels do. Scalar may itself be a Dual, giving second
+ * derivatives.
+ * */
+template <typename Scalar, size_t N> class Dual {
+private:
+  /*! The value*/
+  Scalar value;
+  /*! Derivatives along each direction*/
+  std::array<Scalar, N> tangent;
+
+  /*! The Dual with value f and tangents df times those of this one (the
+   * chain rule for a function with derivative df)*/
+  Dual chain(Scalar f, Scalar df) const {
+    Dual result{f};
+    for (size_t k = 0; k < N; k++) {
+      result.tangent[k] = df * this->tangent[k];
+    }
+    return result;
+  }
+
+public:
+  // SECTION: Constructors
+  /*! Construct a zero Dual*/
+  constexpr Dual() : value(0), tangent{} {}
+  /*! Construct a constant (all tangents zero).
+   *
+   * @param value The value
+   * */
+  constexpr Dual(Scalar value) : value(value), tangent{} {}
+  /*! Construct a Dual from its value and tangents.
+   *
+   * @param value The value
+   * @param tangent Derivatives along each direction
+   * */
+  constexpr Dual(Scalar value, std::array<Scalar, N> const &tangent)
+      : value(value), tangent(tangent) {}
+  /*! Construct an independent variable: tangent direction has derivative
+   * one, the others zero.
+   *
+   * @param value The value
+   * @param direction The seeded direction (less than N)
+   * */
+  static Dual variable(Scalar value, size_t direction) {
+    if (direction >= N) {
+      throw std::range_error("Invalid tangent direction");
+    }
+    Dual result{value};
+    result.tangent[direction] = 1;
+    return result;
+  }
+
+  // SECTION: Getters
+  /*! Get the value*/
+  Scalar get_value() const { return this->value; }
+  /*! Get the derivatives along each direction*/
+  std::array<Scalar, N> const &get_tangent() const { return this->tangent; }
+  /*! Get the derivative along one direction*/
+  Scalar get_tangent(size_t direction) const {
+    return this->tangent[direction];
+  }
+  /*! Set the derivative along one direction*/
+  void set_tangent(size_t direction, Scalar derivative) {
+    this->tangent[direction] = derivative;
+  }
+
+  // SECTION: Arithmetic
+  Dual operator+() const { return *this; }
+  Dual operator-() const { return this->chain(-this->value, Scalar{-1}); }
+  Dual &operator+=(Dual const &other) {
+    this->value += other.value;
+    for (size_t k = 0; k < N; k++) {
+      this->tangent[k] += other.tangent[k];
+    }
+    return *this;
+  }
+  Dual &operator-=(Dual const &other) {
+    this->value -= other.value;
+    for (size_t k = 0; k < N; k++) {
+      this->tangent[k] -= other.tangent[k];
+    }
+    return *this;
+  }
+  Dual &operator*=(Dual const &other) {
+    for (size_t k = 0; k < N; k++) {
+      this->tangent[k] =
+          this->tangent[k] * other.value + this->value * other.tangent[k];
+    }
+    this->value *= other.value;
+    return *this;
+  }
+  Dual &operator/=(Dual const &other) {
+    Scalar inverse = Scalar{1} / other.value;
+    this->value *= inverse;
+    for (size_t k = 0; k < N; k++) {
+      this->tangent[k] =
+          (this->tangent[k] - this->value * other.tangent[k]) * inverse;
+    }
+    return *this;
+  }
+  Dual &operator+=(Scalar other) {
+    this->value += other;
+    return *this;
+  }
+  Dual &operator-=(Scalar other) {
+    this->value -= other;
+    return *this;
+  }
+  Dual &operator*=(Scalar other) {
+    this->value *= other;
+    for (size_t k = 0; k < N; k++) {
+      this->tangent[k] *= other;
+    }
+    return *this;
+  }
+  Dual &operator/=(Scalar other) { return *this *= Scalar{1} / other; }
+  friend Dual operator+(Dual lhs, Dual const &rhs) { return lhs += rhs; }
+  friend Dual operator-(Dual lhs, Dual const &rhs) { return lhs -= rhs; }
+  friend Dual operator*(Dual lhs, Dual const &rhs) { return lhs *= rhs; }
+  friend Dual operator/(Dual lhs, Dual const &rhs) { return lhs /= rhs; }
+  friend Dual operator+(Dual lhs, Scalar rhs) { return lhs += rhs; }
+  friend Dual operator-(Dual lhs, Scalar rhs) { return lhs -= rhs; }
+  friend Dual operator*(Dual lhs, Scalar rhs) { return lhs *= rhs; }
+  friend Dual operator/(Dual lhs, Scalar rhs) { return lhs /= rhs; }
+  friend Dual operator+(Scalar lhs, Dual rhs) { return rhs += lhs; }
+  friend Dual operator-(Scalar lhs, Dual const &rhs) {
+    return rhs.chain(lhs - rhs.value, Scalar{-1});
+  }
+  friend Dual operator*(Scalar lhs, Dual rhs) { return rhs *= lhs; }
+  friend Dual operator/(Scalar lhs, Dual const &rhs) {
+    Scalar quotient = lhs / rhs.value;
+    return rhs.chain(quotient, -quotient / rhs.value);
+  }
+
+  // SECTION: Comparisons (of the values)
+  friend bool operator==(Dual const &lhs, Dual const &rhs) {
+    return lhs.value == rhs.value;
+  }
+  friend bool operator==(Dual const &lhs, Scalar rhs) {
+    return lhs.value == rhs;
+  }
+  friend std::partial_ordering operator<=>(Dual const &lhs,
+                                           Dual const &rhs) {
+    return lhs.value <=> rhs.value;
+  }
+  friend std::partial_ordering operator<=>(Dual const &lhs, Scalar rhs) {
+    return lhs.value <=> rhs;
+  }
+  /*! Whether the value is nonzero (as for Matrix::any and all)*/
+  explicit operator bool() const { return static_cast<bool>(this->value); }
+
+  // SECTION: Elementary functions
+  /*! Absolute value (with derivative sign(x), taking +1 at 0)*/
+  friend Dual abs(Dual const &x) { return x.value < 0 ? -x : x; }
+  friend Dual sqrt(Dual const &x) {
+    using std::sqrt;
+    Scalar root = sqrt(x.value);
+    return x.chain(root, Scalar{1} / (2 * root));
+  }
+  friend Dual cbrt(Dual const &x) {
+    using std::cbrt;
+    Scalar root = cbrt(x.value);
+    return x.chain(root, Scalar{1} / (3 * root * root));
+  }
+  friend Dual exp(Dual const &x) {
+    using std::exp;
+    Scalar e = exp(x.value);
+    return x.chain(e, e);
+  }
+  friend Dual expm1(Dual const &x) {
+    using std::exp;
+    using std::expm1;
+    return x.chain(expm1(x.value), exp(x.value));
+  }
+  friend Dual log(Dual const &x) {
+    using std::log;
+    return x.chain(log(x.value), Scalar{1} / x.value);
+  }
+  friend Dual log1p(Dual const &x) {
+    using std::log1p;
+    return x.chain(log1p(x.value), Scalar{1} / (1 + x.value));
+  }
+  friend Dual sin(Dual const &x) {
+    using std::cos;
+    using std::sin;
+    return x.chain(sin(x.value), cos(x.value));
+  }
+  friend Dual cos(Dual const &x) {
+    using std::cos;
+    using std::sin;
+    return x.chain(cos(x.value), -sin(x.value));
+  }
+  friend Dual tan(Dual const &x) {
+    using std::tan;
+    Scalar t = tan(x.value);
+    return x.chain(t, 1 + t * t);
+  }
+  friend Dual asin(Dual const &x) {
+    using std::asin;
+    using std::sqrt;
+    return x.chain(asin(x.value), Scalar{1} / sqrt(1 - x.value * x.value));
+  }
+  friend Dual acos(Dual const &x) {
+    using std::acos;
+    using std::sqrt;
+    return x.chain(acos(x.value), Scalar{-1} / sqrt(1 - x.value * x.value));
+  }
+  friend Dual atan(Dual const &x) {
+    using std::atan;
+    return x.chain(atan(x.value), Scalar{1} / (1 + x.value * x.value));
+  }
+  friend Dual sinh(Dual const &x) {
+    using std::cosh;
+    using std::sinh;
+    return x.chain(sinh(x.value), cosh(x.value));
+  }
+  friend Dual cosh(Dual const &x) {
+    using std::cosh;
+    using std::sinh;
+    return x.chain(cosh(x.value), sinh(x.value));
+  }
+  friend Dual tanh(Dual const &x) {
+    using std::tanh;
+    Scalar t = tanh(x.value);
+    return x.chain(t, 1 - t * t);
+  }
+  friend Dual atan2(Dual const &y, Dual const &x) {
+    using std::atan2;
+    Scalar r2 = x.value * x.value + y.value * y.value;
+    Dual result{atan2(y.value, x.value)};
+    for (size_t k = 0; k < N; k++) {
+      result.tangent[k] =
+          (x.value * y.tangent[k] - y.value * x.tangent[k]) / r2;
+    }
+    return result;
+  }
+  friend Dual hypot(Dual const &x, Dual const &y) {
+    using std::hypot;
+    Scalar h = hypot(x.value, y.value);
+    Dual result{h};
+    for (size_t k = 0; k < N; k++) {
+      result.tangent[k] =
+          (x.value * x.tangent[k] + y.value * y.tangent[k]) / h;
+    }
+    return result;
+  }
+  friend Dual pow(Dual const &x, Scalar p) {
+    using std::pow;
+    // x^0 is constant, so its derivative is zero even where x^(p - 1) is not
+    // finite
+    Scalar derivative = p == 0 ? Scalar{0} : p * pow(x.value, p - 1);
+    return x.chain(pow(x.value, p), derivative);
+  }
+  friend Dual pow(Scalar b, Dual const &p) {
+    using std::log;
+    using std::pow;
+    Scalar power = pow(b, p.value);
+    return p.chain(power, power * log(b));
+  }
+  friend Dual pow(Dual const &x, Dual const &p) {
+    using std::log;
+    using std::pow;
+    Scalar power = pow(x.value, p.value);
+    Scalar dx =
+        p.value == 0 ? Scalar{0} : p.value * pow(x.value, p.value - 1);
+    Scalar dp = x.value > 0 ? power * log(x.value) : Scalar{0};
+    Dual result{power};
+    for (size_t k = 0; k < N; k++) {
+      result.tangent[k] = dx * x.tangent[k] + dp * p.tangent[k];
+    }
+    return result;
+  }
+  friend bool isfinite(Dual const &x) {
+    using std::isfinite;
+    if (!isfinite(x.value)) {
+      return false;
+    }
+    return std::all_of(x.tangent.begin(), x.tangent.end(),
+                       [](Scalar t) { return isfinite(t); });
+  }
+  friend bool isnan(Dual const &x) {
+    using std::isnan;
+    return isnan(x.value);
+  }
+};
+
+/*! Jacobian of a function by forward mode automatic differentiation.
+ *
+ * The function is evaluated on Dual<Scalar, N> with N columns seeded at
+ * a time, so the Jacobian costs ceil(n / N) evaluations.
+ *
+ * @param function Callable as function(x, y) with x the n Dual inputs
+ * and y the m Dual outputs
+ * @param m Number of outputs
+ * @param n Number of inputs
+ * @param x The point
+ * @param jacobian Overwritten with the m x n Jacobian (must have that
+ * shape)
+ * @param value If not nullptr, overwritten with the function at x
+ * */
+template <size_t N, typename Scalar, typename Function>
+void forward_jacobian(Function &&function, size_t m, size_t n,
+                      Scalar const *x, Matrix<Scalar> &jacobian,
+                      Scalar *value = nullptr) {
+  if (jacobian.get_nrows() != m || jacobian.get_ncols() != n) {
+    throw std::range_error("Jacobian has the wrong shape");
+  }
+  std::vector<Dual<Scalar, N>> inputs(x, x + n);
+  std::vector<Dual<Scalar, N>> outputs(m);
+  size_t blocks = std::max<size_t>(1, (n + N - 1) / N);
+  for (size_t block = 0; block < blocks; block++) {
+    size_t begin = block * N;
+    size_t end = std::min(n, begin + N);
+    for (size_t j = begin; j < end; j++) {
+      inputs[j].set_tangent(j - begin, 1);
+    }
+    function(static_cast<Dual<Scalar, N> const *>(inputs.data()),
+             outputs.data());
+    for (size_t i = 0; i < m; i++) {
+      for (size_t j = begin; j < end; j++) {
+        *jacobian(i, j) = outputs[i].get_tangent(j - begin);
+      }
+    }
+    if (value != nullptr && begin == 0) {
+      for (size_t i = 0; i < m; i++) {
+        value[i] = outputs[i].get_value();
+      }
+    }
+    for (size_t j = begin; j < end; j++) {
+      inputs[j].set_tangent(j - begin, 0);
+    }
+  }
+}
+
+/*! Gradient of a function by forward mode automatic differentiation, in
+ * ceil(n / N) evaluations.
+ *
+ * @param function Callable as function(x) with x the n Dual inputs,
+ * returning a Dual
+ * @param n Number of inputs
+ * @param x The point
+ * @param gradient Overwritten with the gradient (n values)
+ * @return The function at x
+ * */
+template <size_t N, typename Scalar, typename Function>
+Scalar forward_gradient(Function &&function, size_t n, Scalar const *x,
+                        Scalar *gradient) {
+  std::vector<Dual<Scalar, N>> inputs(x, x + n);
+  Scalar result = 0;
+  size_t blocks = std::max<size_t>(1, (n + N - 1) / N);
+  for (size_t block = 0; block < blocks; block++) {
+    size_t begin = block * N;
+    size_t end = std::min(n, begin + N);
+    for (size_t j = begin; j < end; j++) {
+      inputs[j].set_tangent(j - begin, 1);
+    }
+    Dual<Scalar, N> output =
+        function(static_cast<Dual<Scalar, N> const *>(inputs.data()));
+    result = output.get_value();
+    for (size_t j = begin; j < end; j++) {
+      gradient[j] = output.get_tangent(j - begin);
+      inputs[j].set_tangent(j - begin, 0);
+    }
+  }
+  return result;
+}
+} // namespace teensymat
+
+namespace std {
+/*! Limits of a Dual are those of its values*/
+template <typename Scalar, size_t N>
+class numeric_limits<teensymat::Dual<Scalar, N>>
+    : public numeric_limits<Scalar> {
+public:
+  static constexpr teensymat::Dual<Scalar, N> min() noexcept {
+    return std::numeric_limits<Scalar>::min();
+  }
+  static constexpr teensymat::Dual<Scalar, N> max() noexcept {
+    return std::numeric_limits<Scalar>::max();
+  }
+  static constexpr teensymat::Dual<Scalar, N> lowest() noexcept {
+    return std::numeric_limits<Scalar>::lowest();
+  }
+  static constexpr teensymat::Dual<Scalar, N> epsilon() noexcept {
+    return std::numeric_limits<Scalar>::epsilon();
+  }
+  static constexpr teensymat::Dual<Scalar, N> infinity() noexcept {
+    return std::numeric_limits<Scalar>::infinity();
+  }
+  static constexpr teensymat::Dual<Scalar, N> quiet_NaN() noexcept {
+    return std::numeric_limits<Scalar>::quiet_NaN();
+  }
+};
+} // namespace std
@@ -0,0 +1,523 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/linalg.hpp"
+#include "TeensyOpt/TeensyMat/linear_operator.hpp"
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+#include "TeensyOpt/TeensyMat/random.hpp"
+
+namespace teensymat {
+/*! Which end of the spectrum an eigensolver should find*/
+enum class EigenWhich {
+  /*! The algebraically largest eigenvalues*/
+  largest,
+  /*! The algebraically smallest eigenvalues*/
+  smallest,
+};
+
+/*! Options of the iterative eigensolvers*/
+template <typename Scalar> struct EigenOptions {
+  /*! Number of basis vectors kept by the solver (0 picks a default from the
+   * number of wanted eigenvalues)*/
+  size_t subspace_size = 0;
+  /*! Maximum number of restarts (Lanczos) or iterations (subspace
+   * iteration)*/
+  size_t max_iterations = 1000;
+  /*! A Ritz pair is converged when its residual norm is below tolerance
+   * times the largest Ritz value magnitude*/
+  Scalar tolerance = 1e-8;
+  /*! Seed of the random starting vectors*/
+  uint64_t seed = 0;
+};
+
+/*! Eigenvalues and eigenvectors found by an eigensolver*/
+template <typename Scalar> struct EigenResult {
+  /*! The eigenvalues, in the order requested*/
+  std::vector<Scalar> eigenvalues;
+  /*! The eigenvectors, column i belongs to eigenvalues[i]*/
+  Matrix<Scalar> eigenvectors;
+  /*! Residual norm ||A v - lambda v|| of each pair*/
+  std::vector<Scalar> residuals;
+  /*! Number of applications of the operator to a vector*/
+  size_t operator_applications = 0;
+  /*! Whether all requested pairs reached the tolerance*/
+  bool converged = false;
+};
+
+/*! Dominant eigenvalue found by power iteration*/
+template <typename Scalar> struct PowerIterationResult {
+  /*! The eigenvalue of largest magnitude*/
+  Scalar eigenvalue = 0;
+  /*! The corresponding unit eigenvector*/
+  std::vector<Scalar> eigenvector;
+  /*! Number of iterations performed*/
+  size_t iterations = 0;
+  /*! Whether the eigenvalue estimate reached the tolerance*/
+  bool converged = false;
+};
+
+namespace eigen_detail {
+/*! Cyclic Jacobi eigenvalue algorithm for a dense symmetric n by n row major
+ * array. Eigenvalues are returned in ascending order, column i of the row
+ * major array vectors holds the eigenvector of values[i].*/
+template <typename Scalar>
+void jacobi(size_t n, std::vector<Scalar> a, std::vector<Scalar> &values,
+            std::vector<Scalar> &vectors, size_t max_sweeps = 100) {
+  std::vector<Scalar> rotated(n * n, 0);
+  for (size_t i = 0; i < n; i++) {
+    rotated[i * n + i] = 1;
+  }
+  Scalar total = 0;
+  for (Scalar value : a) {
+    total += value * value;
+  }
+  Scalar epsilon = std::numeric_limits<Scalar>::epsilon();
+  for (size_t sweep = 0; sweep < max_sweeps; sweep++) {
+    Scalar off_diagonal = 0;
+    for (size_t p = 0; p < n; p++) {
+      for (size_t q = p + 1; q < n; q++) {
+        off_diagonal += a[p * n + q] * a[p * n + q];
+      }
+    }
+    if (off_diagonal <= epsilon * epsilon * total) {
+      break;
+    }
+    for (size_t p = 0; p < n; p++) {
+      for (size_t q = p + 1; q < n; q++) {
+        Scalar apq = a[p * n + q];
+        if (apq == Scalar{0}) {
+          continue;
+        }
+        Scalar theta = (a[q * n + q] - a[p * n + p]) / (2 * apq);
+        Scalar t = 1 / (std::abs(theta) + std::sqrt(theta * theta + 1));
+        if (theta < 0) {
+          t = -t;
+        }
+        Scalar c = 1 / std::sqrt(t * t + 1);
+        Scalar s = t * c;
+        for (size_t k = 0; k < n; k++) {
+          Scalar akp = a[k * n + p];
+          Scalar akq = a[k * n + q];
+          a[k * n + p] = c * akp - s * akq;
+          a[k * n + q] = s * akp + c * akq;
+        }
+        for (size_t k = 0; k < n; k++) {
+          Scalar apk = a[p * n + k];
+          Scalar aqk = a[q * n + k];
+          a[p * n + k] = c * apk - s * aqk;
+          a[q * n + k] = s * apk + c * aqk;
+        }
+        a[p * n + q] = 0;
+        a[q * n + p] = 0;
+        for (size_t k = 0; k < n; k++) {
+          Scalar vkp = rotated[k * n + p];
+          Scalar vkq = rotated[k * n + q];
+          rotated[k * n + p] = c * vkp - s * vkq;
+          rotated[k * n + q] = s * vkp + c * vkq;
+        }
+      }
+    }
+  }
+  std::vector<size_t> order(n);
+  std::iota(order.begin(), order.end(), size_t{0});
+  std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+    return a[lhs * n + lhs] < a[rhs * n + rhs];
+  });
+  values.resize(n);
+  vectors.assign(n * n, 0);
+  for (size_t i = 0; i < n; i++) {
+    values[i] = a[order[i] * n + order[i]];
+    for (size_t k = 0; k < n; k++) {
+      vectors[k * n + i] = rotated[k * n + order[i]];
+    }
+  }
+}
+/*! Fill an array of length n with a random unit vector*/
+template <typename Scalar>
+void random_unit(size_t n, Scalar *out, Philox &generator) {
+  Matrix<Scalar> values{1, n};
+  generator.fill_normal(values);
+  std::copy(values.get_data()->begin(), values.get_data()->begin() + n, out);
+  scal(n, 1 / nrm2(n, out), out);
+}
+/*! Orthogonalize w against the k rows of basis (length n each) twice
+ * (classical Gram-Schmidt with reorthogonalization), accumulating the
+ * coefficients into coefficients (if not null)*/
+template <typename Scalar>
+void orthogonalize(size_t k, size_t n, Scalar const *basis, Scalar *w,
+                   Scalar *coefficients) {
+  std::vector<Scalar> projection(k);
+  for (int pass = 0; pass < 2; pass++) {
+    std::fill(projection.begin(), projection.end(), Scalar{0});
+    gemv<Scalar>(k, n, 1, basis, n, w, projection.data());
+    gemv_transpose<Scalar>(k, n, -1, basis, n, projection.data(), w);
+    if (coefficients != nullptr) {
+      axpy(k, Scalar{1}, projection.data(), coefficients);
+    }
+  }
+}
+/*! Orthonormalize the k rows of block (length n each) in place, replacing
+ * linearly dependent rows by random vectors*/
+template <typename Scalar>
+void orthonormalize_rows(size_t k, size_t n, Scalar *block,
+                         Philox &generator) {
+  for (size_t i = 0; i < k; i++) {
+    Scalar *row = block + i * n;
+    Scalar original = nrm2(n, row);
+    orthogonalize<Scalar>(i, n, block, row, nullptr);
+    Scalar norm = nrm2(n, row);
+    if (!(norm > std::sqrt(std::numeric_limits<Scalar>::epsilon()) *
+                     original)) {
+      random_unit(n, row, generator);
+      orthogonalize<Scalar>(i, n, block, row, nullptr);
+      norm = nrm2(n, row);
+    }
+    scal(n, 1 / norm, row);
+  }
+}
+} // namespace eigen_detail
+
+/*! Compute all eigenvalues and eigenvectors of a dense symmetric Matrix
+ * (cyclic Jacobi, meant for small matrices such as projected problems).
+ *
+ * @param matrix The symmetric Matrix
+ * @return Eigenvalues in ascending order and the corresponding eigenvectors
+ * */
+template <typename Scalar>
+EigenResult<Scalar> symmetric_eigen(Matrix<Scalar> const &matrix) {
+  if (matrix.get_nrows() != matrix.get_ncols()) {
+    throw std::runtime_error("Tried to compute eigenvalues of a non square "
+                             "Matrix");
+  }
+  size_t n = matrix.get_nrows();
+  Matrix<Scalar> copy = contiguous_copy(matrix);
+  std::vector<Scalar> values;
+  std::vector<Scalar> vectors;
+  eigen_detail::jacobi(n, *copy.get_data(), values, vectors);
+  EigenResult<Scalar> result;
+  result.eigenvalues = values;
+  result.eigenvectors = Matrix<Scalar>{n, n, vectors};
+  result.residuals.assign(n, 0);
+  result.converged = true;
+  return result;
+}
+
+/*! Estimate the eigenvalue of largest magnitude of a symmetric operator by
+ * power iteration (one operator application per iteration).
+ *
+ * @param op The symmetric operator
+ * @param max_iterations Maximum number of iterations
+ * @param tolerance Stop when the Rayleigh quotient changes by less than
+ * this, relative to its magnitude
+ * @param seed Seed of the random starting vector
+ * */
+template <typename Scalar>
+PowerIterationResult<Scalar>
+power_iteration(LinearOperator<Scalar> const &op,
+                size_t max_iterations = 1000, Scalar tolerance = 1e-6,
+                uint64_t seed = 0) {
+  size_t n = op.get_ncols();
+  if (op.get_nrows() != n) {
+    throw std::runtime_error("Power iteration needs a square operator");
+  }
+  PowerIterationResult<Scalar> result;
+  result.eigenvector.resize(n);
+  Philox generator{seed};
+  eigen_detail::random_unit(n, result.eigenvector.data(), generator);
+  std::vector<Scalar> image(n);
+  for (size_t iteration = 0; iteration < max_iterations; iteration++) {
+    op.apply(result.eigenvector.data(), image.data());
+    Scalar estimate = dot(n, result.eigenvector.data(), image.data());
+    Scalar norm = nrm2(n, image.data());
+    result.iterations = iteration + 1;
+    bool settled = iteration > 0 && std::abs(estimate - result.eigenvalue) <=
+                                        tolerance * std::abs(estimate);
+    result.eigenvalue = estimate;
+    if (norm == Scalar{0}) {
+      result.converged = true;
+      break;
+    }
+    scal(n, 1 / norm, image.data());
+    std::swap(image, result.eigenvector);
+    if (settled) {
+      result.converged = true;
+      break;
+    }
+  }
+  return result;
+}
+
+/*! Estimate the spectral norm (largest singular value) of an operator by
+ * power iteration on A^T * A. Cheap, and accurate enough for step sizes and
+ * Lipschitz constants; the estimate approaches the norm from below.
+ *
+ * @param op The operator, which must provide its transpose
+ * @param max_iterations Maximum number of iterations
+ * @param tolerance Relative tolerance on the change of the estimate
+ * @param seed Seed of the random starting vector
+ * */
+template <typename Scalar>
+Scalar spectral_norm_estimate(LinearOperator<Scalar> const &op,
+                              size_t max_iterations = 100,
+                              Scalar tolerance = 1e-6, uint64_t seed = 0) {
+  size_t m = op.get_nrows();
+  size_t n = op.get_ncols();
+  std::vector<Scalar> buffer(m);
+  LinearOperator<Scalar> normal{n, n, [&](Scalar const *x, Scalar *y) {
+                                  op.apply(x, buffer.data());
+                                  op.apply_transpose(buffer.data(), y);
+                                }};
+  auto result = power_iteration(normal, max_iterations, tolerance, seed);
+  return std::sqrt(std::max(result.eigenvalue, Scalar{0}));
+}
+
+/*! Find a few extreme eigenvalues of a symmetric operator with the thick
+ * restart Lanczos method (which is mathematically equivalent to implicitly
+ * restarted Lanczos, ARPACK's method for symmetric problems).
+ *
+ * The basis is kept fully orthogonal, and after each restart the best Ritz
+ * vectors are kept so that convergence continues where it left off. Only
+ * operator applications touch the operator; everything else is O(n * m)
+ * dense work on the basis plus small projected eigenproblems.
+ *
+ * @param op The symmetric operator
+ * @param k Number of eigenvalues wanted
+ * @param which Which end of the spectrum to find
+ * @param options Options of the solver
+ * */
+template <typename Scalar>
+EigenResult<Scalar> lanczos_eigs(LinearOperator<Scalar> const &op, size_t k,
+                                 EigenWhich which = EigenWhich::largest,
+                                 EigenOptions<Scalar> const &options = {}) {
+  size_t n = op.get_ncols();
+  if (op.get_nrows() != n) {
+    throw std::runtime_error("Lanczos needs a square operator");
+  }
+  if (k == 0 || k > n) {
+    throw std::range_error("Invalid number of eigenvalues requested");
+  }
+  size_t m = options.subspace_size != 0
+                 ? options.subspace_size
+                 : std::max(2 * k + 1, k + 20);
+  m = std::min(std::max(m, k + 1), n);
+  Philox generator{options.seed};
+  // Rows 0..m-1 hold the basis, row m the next Lanczos vector
+  std::vector<Scalar> basis((m + 1) * n, 0);
+  std::vector<Scalar> projected(m * m, 0);
+  std::vector<Scalar> coefficients(m);
+  std::vector<Scalar> values;
+  std::vector<Scalar> vectors;
+  std::vector<size_t> order(m);
+  EigenResult<Scalar> result;
+  eigen_detail::random_unit(n, basis.data(), generator);
+  size_t start = 0;
+  Scalar beta = 0;
+  for (size_t restart = 0;; restart++) {
+    // Extend the basis from start to m vectors
+    for (size_t j = start; j < m; j++) {
+      Scalar *w = basis.data() + (j + 1) * n;
+      op.apply(basis.data() + j * n, w);
+      result.operator_applications++;
+      std::fill(coefficients.begin(), coefficients.end(), Scalar{0});
+      eigen_detail::orthogonalize<Scalar>(j + 1, n, basis.data(), w,
+                                          coefficients.data());
+      for (size_t i = 0; i <= j; i++) {
+        projected[i * m + j] = coefficients[i];
+        projected[j * m + i] = coefficients[i];
+      }
+      beta = nrm2(n, w);
+      Scalar scale = std::abs(coefficients[j]) + beta;
+      if (!(beta > std::numeric_limits<Scalar>::epsilon() * scale)) {
+        // Invariant subspace found, continue with a fresh direction
+        beta = 0;
+        if (j + 1 < m) {
+          eigen_detail::random_unit(n, w, generator);
+          eigen_detail::orthogonalize<Scalar>(j + 1, n, basis.data(), w,
+                                              nullptr);
+          scal(n, 1 / nrm2(n, w), w);
+        } else {
+          std::fill(w, w + n, Scalar{0});
+        }
+        continue;
+      }
+      scal(n, 1 / beta, w);
+      if (j + 1 < m) {
+        projected[(j + 1) * m + j] = beta;
+        projected[j * m + j + 1] = beta;
+      }
+    }
+    // Rayleigh-Ritz on the projected matrix
+    eigen_detail::jacobi(m, projected, values, vectors);
+    std::iota(order.begin(), order.end(), size_t{0});
+    if (which == EigenWhich::largest) {
+      std::reverse(order.begin(), order.end());
+    }
+    Scalar spectrum_scale = std::max(std::abs(values.front()),
+                                     std::abs(values.back()));
+    bool all_converged = true;
+    for (size_t i = 0; i < k; i++) {
+      Scalar residual = std::abs(beta * vectors[(m - 1) * m + order[i]]);
+      all_converged =
+          all_converged && residual <= options.tolerance * spectrum_scale;
+    }
+    bool finished = all_converged || restart + 1 >= options.max_iterations;
+    // Number of Ritz vectors kept (the eigenvectors when finished)
+    size_t keep = finished ? k : std::min(m - 1, k + (m - k) / 2);
+    std::vector<Scalar> rotation(keep * m);
+    for (size_t i = 0; i < keep; i++) {
+      for (size_t l = 0; l < m; l++) {
+        rotation[i * m + l] = vectors[l * m + order[i]];
+      }
+    }
+    std::vector<Scalar> ritz_vectors(keep * n, 0);
+    gemm<Scalar>(keep, n, m, 1, rotation.data(), m, basis.data(), n,
+                 ritz_vectors.data(), n);
+    if (finished) {
+      result.eigenvalues.resize(k);
+      result.residuals.resize(k);
+      result.eigenvectors = Matrix<Scalar>{n, k};
+      Scalar *out = result.eigenvectors.get_data()->data();
+      for (size_t i = 0; i < k; i++) {
+        result.eigenvalues[i] = values[order[i]];
+        result.residuals[i] =
+            std::abs(beta * vectors[(m - 1) * m + order[i]]);
+        for (size_t row = 0; row < n; row++) {
+          out[row * k + i] = ritz_vectors[i * n + row];
+        }
+      }
+      result.converged = all_converged;
+      return result;
+    }
+    // Thick restart: kept Ritz vectors, then the last Lanczos vector
+    std::copy(basis.begin() + m * n, basis.begin() + (m + 1) * n,
+              basis.begin() + keep * n);
+    std::copy(ritz_vectors.begin(), ritz_vectors.end(), basis.begin());
+    std::fill(projected.begin(), projected.end(), Scalar{0});
+    for (size_t i = 0; i < keep; i++) {
+      projected[i * m + i] = values[order[i]];
+    }
+    start = keep;
+  }
+}
+
+/*! Find the k eigenvalues of largest magnitude of a symmetric operator by
+ * block subspace iteration with Rayleigh-Ritz projection.
+ *
+ * Every iteration applies the operator to a whole block of vectors at once
+ * (a single gemm for operators built from a dense Matrix) and does its
+ * projections and rotations with gemm, so it makes good use of the memory
+ * hierarchy, at the cost of slower convergence than lanczos_eigs when the
+ * wanted eigenvalues are poorly separated.
+ *
+ * @param op The symmetric operator
+ * @param k Number of eigenvalues wanted
+ * @param options Options of the solver (subspace_size is the block size)
+ * @return Eigenvalues ordered by decreasing magnitude
+ * */
+template <typename Scalar>
+EigenResult<Scalar>
+subspace_iteration_eigs(LinearOperator<Scalar> const &op, size_t k,
+                        EigenOptions<Scalar> const &options = {}) {
+  size_t n = op.get_ncols();
+  if (op.get_nrows() != n) {
+    throw std::runtime_error("Subspace iteration needs a square operator");
+  }
+  if (k == 0 || k > n) {
+    throw std::range_error("Invalid number of eigenvalues requested");
+  }
+  size_t b = options.subspace_size != 0 ? options.subspace_size
+                                        : k + std::max<size_t>(2, k / 2);
+  b = std::min(std::max(b, k), n);
+  Philox generator{options.seed};
+  Matrix<Scalar> random_block{b, n};
+  generator.fill_normal(random_block);
+  std::vector<Scalar> block = *random_block.get_data();
+  std::vector<Scalar> image(b * n);
+  std::vector<Scalar> projected(b * b);
+  std::vector<Scalar> rotation(b * b);
+  std::vector<Scalar> rotated(b * n);
+  std::vector<Scalar> values;
+  std::vector<Scalar> vectors;
+  std::vector<size_t> order(b);
+  std::vector<Scalar> residuals(b);
+  eigen_detail::orthonormalize_rows(b, n, block.data(), generator);
+  EigenResult<Scalar> result;
+  for (size_t iteration = 0; iteration < options.max_iterations;
+       iteration++) {
+    op.apply_block(b, block.data(), image.data());
+    result.operator_applications += b;
+    // H = X * (A X)^T, symmetrized
+    std::fill(projected.begin(), projected.end(), Scalar{0});
+    gemm_nt<Scalar>(b, b, n, 1, block.data(), n, image.data(), n,
+                    projected.data(), b);
+    for (size_t i = 0; i < b; i++) {
+      for (size_t j = i + 1; j < b; j++) {
+        Scalar average = (projected[i * b + j] + projected[j * b + i]) / 2;
+        projected[i * b + j] = average;
+        projected[j * b + i] = average;
+      }
+    }
+    eigen_detail::jacobi(b, projected, values, vectors);
+    std::iota(order.begin(), order.end(), size_t{0});
+    std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+      return std::abs(values[lhs]) > std::abs(values[rhs]);
+    });
+    for (size_t i = 0; i < b; i++) {
+      for (size_t l = 0; l < b; l++) {
+        rotation[i * b + l] = vectors[l * b + order[i]];
+      }
+    }
+    // Rotate both the block and its image onto the Ritz vectors
+    std::fill(rotated.begin(), rotated.end(), Scalar{0});
+    gemm<Scalar>(b, n, b, 1, rotation.data(), b, block.data(), n,
+                 rotated.data(), n);
+    std::swap(block, rotated);
+    std::fill(rotated.begin(), rotated.end(), Scalar{0});
+    gemm<Scalar>(b, n, b, 1, rotation.data(), b, image.data(), n,
+                 rotated.data(), n);
+    std::swap(image, rotated);
+    Scalar scale = std::abs(values[order[0]]);
+    bool all_converged = true;
+    for (size_t i = 0; i < b; i++) {
+      Scalar theta = values[order[i]];
+      Scalar sum = 0;
+      for (size_t l = 0; l < n; l++) {
+        Scalar difference = image[i * n + l] - theta * block[i * n + l];
+        sum += difference * difference;
+      }
+      residuals[i] = std::sqrt(sum);
+      if (i < k) {
+        all_converged = all_converged && residuals[i] <= options.tolerance * scale;
+      }
+    }
+    bool finished =
+        all_converged || iteration + 1 >= options.max_iterations;
+    if (finished) {
+      result.eigenvalues.resize(k);
+      result.residuals.assign(residuals.begin(), residuals.begin() + k);
+      result.eigenvectors = Matrix<Scalar>{n, k};
+      Scalar *out = result.eigenvectors.get_data()->data();
+      for (size_t i = 0; i < k; i++) {
+        result.eigenvalues[i] = values[order[i]];
+        for (size_t row = 0; row < n; row++) {
+          out[row * k + i] = block[i * n + row];
+        }
+      }
+      result.converged = all_converged;
+      return result;
+    }
+    std::swap(block, image);
+    eigen_detail::orthonormalize_rows(b, n, block.data(), generator);
+  }
+  return result;
+}
+} // namespace teensymat
@@ -0,0 +1,614 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/linalg.hpp"
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+
+namespace teensymat {
+namespace factorize_detail {
+/*! Width of the panels of the blocked algorithms*/
+constexpr size_t block_size = 64;
+
+/*! Invert an upper triangular (row major, n by n, row stride lda) array in
+ * place, blocked so that most of the work is done by gemm.*/
+template <typename Scalar>
+void invert_upper_inplace(size_t n, Scalar *a, size_t lda) {
+  std::vector<Scalar> row_buffer;
+  for (size_t j = 0; j < n; j += block_size) {
+    size_t jb = std::min(block_size, n - j);
+    // Rows [0, j) of the block column: A01 = inv(U00) * A01, computed top
+    // down in place since row i only needs rows k >= i
+    row_buffer.assign(jb, 0);
+    for (size_t i = 0; i < j; i++) {
+      std::fill(row_buffer.begin(), row_buffer.end(), Scalar{0});
+      for (size_t k = i; k < j; k++) {
+        axpy(jb, a[i * lda + k], a + k * lda + j, row_buffer.data());
+      }
+      std::copy(row_buffer.begin(), row_buffer.end(), a + i * lda + j);
+    }
+    // A01 = -A01 * inv(U11), forward substitution along each row
+    for (size_t i = 0; i < j; i++) {
+      Scalar *row = a + i * lda + j;
+      for (size_t c = 0; c < jb; c++) {
+        Scalar value = row[c];
+        for (size_t l = 0; l < c; l++) {
+          value -= row[l] * a[(j + l) * lda + j + c];
+        }
+        row[c] = value / a[(j + c) * lda + j + c];
+      }
+      scal(jb, Scalar{-1}, row);
+    }
+    // Invert the diagonal block itself, column by column
+    for (size_t c = 0; c < jb; c++) {
+      size_t col = j + c;
+      if (a[col * lda + col] == Scalar{0}) {
+        throw std::runtime_error("Matrix is singular");
+      }
+      a[col * lda + col] = Scalar{1} / a[col * lda + col];
+      Scalar minus_diagonal = -a[col * lda + col];
+      // x = inv(U)[j:col, j:col] * U[j:col, col], top down in place
+      for (size_t i = j; i < col; i++) {
+        Scalar value = 0;
+        for (size_t k = i; k < col; k++) {
+          value += a[i * lda + k] * a[k * lda + col];
+        }
+        a[i * lda + col] = value * minus_diagonal;
+      }
+    }
+  }
+}
+
+/*! Cholesky factor a symmetric positive definite (row major, n by n, row
+ * stride lda) array in place, row oriented (Cholesky-Crout) so the inner
+ * products are contiguous. Only the lower triangle is read, and L
+ * overwrites it; the strict upper triangle is left as it was.
+ *
+ * @return false (leaving a partially factored array) if a pivot is not
+ * positive
+ * */
+template <typename Scalar>
+bool cholesky_inplace(size_t n, Scalar *a, size_t lda) {
+  using std::sqrt;
+  for (size_t i = 0; i < n; i++) {
+    Scalar *row_i = a + i * lda;
+    for (size_t j = 0; j < i; j++) {
+      Scalar *row_j = a + j * lda;
+      row_i[j] = (row_i[j] - dot(j, row_i, row_j)) / row_j[j];
+    }
+    Scalar diagonal = row_i[i] - dot(i, row_i, row_i);
+    if (!(diagonal > 0)) {
+      return false;
+    }
+    row_i[i] = sqrt(diagonal);
+  }
+  return true;
+}
+
+/*! Solve L * L^T * x = b in place, for L from cholesky_inplace.
+ *
+ * @param n Dimension
+ * @param a The factored array (row stride lda)
+ * @param lda Row stride of a
+ * @param rhs On entry b, on exit x (length n)
+ * */
+template <typename Scalar>
+void cholesky_solve_inplace(size_t n, Scalar const *a, size_t lda,
+                            Scalar *rhs) {
+  for (size_t i = 0; i < n; i++) {
+    rhs[i] = (rhs[i] - dot(i, a + i * lda, rhs)) / a[i * lda + i];
+  }
+  for (size_t i = n; i-- > 0;) {
+    rhs[i] /= a[i * lda + i];
+    axpy(i, -rhs[i], a + i * lda, rhs);
+  }
+}
+
+/*! Estimate ||inv(A)||_1 by Hager's method with Higham's refinements (as
+ * in LAPACK's lacon), from a handful of solves with A and A^T.
+ *
+ * @param n Dimension of A
+ * @param solve Overwrites x (length n) with inv(A) x
+ * @param solve_transpose Overwrites x with inv(A^T) x
+ * @return The estimate, a lower bound almost always within a factor of a
+ * few of the true value
+ * */
+template <typename Scalar, typename Solve, typename SolveTranspose>
+Scalar inverse_norm_1_estimate(size_t n, Solve &&solve,
+                               SolveTranspose &&solve_transpose) {
+  using std::abs;
+  if (n == 0) {
+    return 0;
+  }
+  constexpr size_t max_iterations = 5;
+  std::vector<Scalar> x(n, Scalar{1} / static_cast<Scalar>(n));
+  std::vector<Scalar> signs(n, 0);
+  Scalar estimate = 0;
+  for (size_t iteration = 0; iteration < max_iterations; iteration++) {
+    solve(x.data());
+    Scalar new_estimate = asum(n, x.data());
+    if (iteration > 0 && new_estimate <= estimate) {
+      break;
+    }
+    estimate = new_estimate;
+    bool signs_repeated = iteration > 0;
+    for (size_t i = 0; i < n; i++) {
+      Scalar sign = x[i] >= 0 ? Scalar{1} : Scalar{-1};
+      signs_repeated = signs_repeated && sign == signs[i];
+      signs[i] = sign;
+    }
+    if (signs_repeated) {
+      break;
+    }
+    x = signs;
+    solve_transpose(x.data());
+    size_t best = 0;
+    for (size_t i = 1; i < n; i++) {
+      if (abs(x[i]) > abs(x[best])) {
+        best = i;
+      }
+    }
+    std::fill(x.begin(), x.end(), Scalar{0});
+    x[best] = 1;
+  }
+  // Alternative estimate, guards against the worst cases of Hager's method
+  for (size_t i = 0; i < n; i++) {
+    Scalar magnitude = 1 + static_cast<Scalar>(i) /
+                               static_cast<Scalar>(std::max<size_t>(1, n - 1));
+    x[i] = i % 2 == 0 ? magnitude : -magnitude;
+  }
+  solve(x.data());
+  Scalar alternative = 2 * asum(n, x.data()) / (3 * static_cast<Scalar>(n));
+  return std::max(estimate, alternative);
+}
+} // namespace factorize_detail
+
+/*! LU factorization with partial pivoting, P * A = L * U.
+ *
+ * The factorization is computed once on construction by a blocked right
+ * looking algorithm (panels factored column by column, trailing matrix
+ * updated with gemm), after which systems, determinants, the inverse and
+ * condition number estimates can be obtained cheaply.
+ * */
+template <typename Scalar> class LUFactorization {
+private:
+  /*! L (strictly below the diagonal, unit diagonal implied) and U, stored
+   * contiguously in row major order*/
+  Matrix<Scalar> factors;
+  /*! Row i was swapped with row pivots[i] at step i*/
+  std::vector<size_t> pivots;
+  /*! Number of rows and columns*/
+  size_t n;
+  /*! The 1-norm of the factored Matrix*/
+  Scalar matrix_norm_1;
+  /*! Whether a zero pivot was encountered*/
+  bool singular;
+
+  Scalar *raw() { return this->factors.get_data()->data(); }
+  Scalar const *raw() const { return this->factors.get_data()->data(); }
+
+  /*! Factor the columns [j, j + jb) (rows j to n), and apply the row swaps
+   * to the rest of the Matrix*/
+  void factor_panel(size_t j, size_t jb) {
+    using std::abs;
+    Scalar *a = this->raw();
+    size_t n = this->n;
+    for (size_t col = j; col < j + jb; col++) {
+      size_t pivot_row = col;
+      Scalar largest = abs(a[col * n + col]);
+      for (size_t row = col + 1; row < n; row++) {
+        if (abs(a[row * n + col]) > largest) {
+          largest = abs(a[row * n + col]);
+          pivot_row = row;
+        }
+      }
+      this->pivots[col] = pivot_row;
+      if (pivot_row != col) {
+        std::swap_ranges(a + col * n, a + (col + 1) * n, a + pivot_row * n);
+      }
+      Scalar pivot = a[col * n + col];
+      if (pivot == Scalar{0}) {
+        this->singular = true;
+        continue;
+      }
+      // Eliminate below the pivot, only within the panel
+      Scalar inverse_pivot = Scalar{1} / pivot;
+      for (size_t row = col + 1; row < n; row++) {
+        Scalar multiplier = a[row * n + col] * inverse_pivot;
+        a[row * n + col] = multiplier;
+        if (multiplier != Scalar{0}) {
+          axpy(j + jb - col - 1, -multiplier, a + col * n + col + 1,
+               a + row * n + col + 1);
+        }
+      }
+    }
+  }
+
+public:
+  // SECTION: Constructors
+  /*! Factor a square Matrix.
+   *
+   * @param matrix The Matrix to factor
+   * */
+  explicit LUFactorization(Matrix<Scalar> const &matrix)
+      : factors(contiguous_copy(matrix)), pivots(matrix.get_nrows()),
+        n(matrix.get_nrows()), matrix_norm_1(norm_1(matrix)),
+        singular(false) {
+    if (matrix.get_nrows() != matrix.get_ncols()) {
+      throw std::runtime_error("Tried to LU factor a non square Matrix");
+    }
+    Scalar *a = this->raw();
+    size_t n = this->n;
+    for (size_t j = 0; j < n; j += factorize_detail::block_size) {
+      size_t jb = std::min(factorize_detail::block_size, n - j);
+      this->factor_panel(j, jb);
+      size_t rest = n - j - jb;
+      if (rest == 0) {
+        continue;
+      }
+      // U12 = inv(L11) * A12 (unit lower forward substitution)
+      for (size_t row = j + 1; row < j + jb; row++) {
+        for (size_t k = j; k < row; k++) {
+          axpy(rest, -a[row * n + k], a + k * n + j + jb,
+               a + row * n + j + jb);
+        }
+      }
+      // A22 -= L21 * U12
+      gemm<Scalar>(rest, rest, jb, -1, a + (j + jb) * n + j, n,
+                   a + j * n + j + jb, n, a + (j + jb) * n + j + jb, n);
+    }
+  }
+
+  // SECTION: Getters
+  /*! Get the number of rows (and columns) of the factored Matrix*/
+  size_t get_size() const { return this->n; }
+  /*! Whether the factored Matrix is exactly singular*/
+  bool is_singular() const { return this->singular; }
+  /*! Get the combined L and U factors (L has an implied unit diagonal)*/
+  Matrix<Scalar> const &get_factors() const { return this->factors; }
+  /*! Get the pivot sequence, row i was swapped with row pivots[i]*/
+  std::vector<size_t> const &get_pivots() const { return this->pivots; }
+
+  // SECTION: Solves
+  /*! Solve A * x = b in place.
+   *
+   * @param rhs On entry b, on exit x (length n)
+   * */
+  void solve_inplace(Scalar *rhs) const {
+    if (this->singular) {
+      throw std::runtime_error("Matrix is singular");
+    }
+    Scalar const *a = this->raw();
+    size_t n = this->n;
+    for (size_t i = 0; i < n; i++) {
+      std::swap(rhs[i], rhs[this->pivots[i]]);
+    }
+    for (size_t i = 0; i < n; i++) {
+      rhs[i] -= dot(i, a + i * n, rhs);
+    }
+    for (size_t i = n; i-- > 0;) {
+      rhs[i] = (rhs[i] - dot(n - i - 1, a + i * n + i + 1, rhs + i + 1)) /
+               a[i * n + i];
+    }
+  }
+  /*! Solve A^T * x = b in place.
+   *
+   * @param rhs On entry b, on exit x (length n)
+   * */
+  void solve_transpose_inplace(Scalar *rhs) const {
+    if (this->singular) {
+      throw std::runtime_error("Matrix is singular");
+    }
+    Scalar const *a = this->raw();
+    size_t n = this->n;
+    // U^T w = b, column oriented so the inner loop runs along rows of U
+    for (size_t i = 0; i < n; i++) {
+      rhs[i] /= a[i * n + i];
+      axpy(n - i - 1, -rhs[i], a + i * n + i + 1, rhs + i + 1);
+    }
+    // L^T v = w
+    for (size_t i = n; i-- > 0;) {
+      axpy(i, -rhs[i], a + i * n, rhs);
+    }
+    for (size_t i = n; i-- > 0;) {
+      std::swap(rhs[i], rhs[this->pivots[i]]);
+    }
+  }
+  /*! Solve A * x = b.
+   *
+   * @param rhs The right hand side b
+   * @return The solution x
+   * */
+  std::vector<Scalar> solve(std::vector<Scalar> rhs) const {
+    if (rhs.size() != this->n) {
+      throw std::runtime_error("Right hand side has the wrong length");
+    }
+    this->solve_inplace(rhs.data());
+    return rhs;
+  }
+
+  // SECTION: Derived quantities
+  /*! The determinant of the factored Matrix. For large matrices prefer
+   * log_abs_det, as the determinant easily over- or underflows.*/
+  Scalar determinant() const {
+    Scalar const *a = this->raw();
+    Scalar result = 1;
+    for (size_t i = 0; i < this->n; i++) {
+      result *= a[i * this->n + i];
+      if (this->pivots[i] != i) {
+        result = -result;
+      }
+    }
+    return result;
+  }
+  /*! The sign of the determinant (-1, 0 or 1)*/
+  Scalar determinant_sign() const {
+    if (this->singular) {
+      return 0;
+    }
+    Scalar const *a = this->raw();
+    Scalar sign = 1;
+    for (size_t i = 0; i < this->n; i++) {
+      if ((a[i * this->n + i] < 0) != (this->pivots[i] != i)) {
+        sign = -sign;
+      }
+    }
+    return sign;
+  }
+  /*! The natural logarithm of the absolute value of the determinant (minus
+   * infinity for a singular Matrix)*/
+  Scalar log_abs_det() const {
+    using std::abs;
+    using std::log;
+    if (this->singular) {
+      return -std::numeric_limits<Scalar>::infinity();
+    }
+    Scalar const *a = this->raw();
+    Scalar result = 0;
+    for (size_t i = 0; i < this->n; i++) {
+      result += log(abs(a[i * this->n + i]));
+    }
+    return result;
+  }
+  /*! Compute the inverse of the factored Matrix.
+   *
+   * Works in place on a copy of the factors (inv(U) first, then
+   * inv(A) * L = inv(U) by blocks of columns, then the column interchanges),
+   * as LAPACK's getri does. Only form the inverse when it is really needed;
+   * solve is cheaper and more accurate for systems.
+   * */
+  Matrix<Scalar> inverse() const {
+    if (this->singular) {
+      throw std::runtime_error("Matrix is singular");
+    }
+    size_t n = this->n;
+    Matrix<Scalar> result = this->factors;
+    Scalar *a = result.get_data()->data();
+    factorize_detail::invert_upper_inplace(n, a, n);
+    size_t block = factorize_detail::block_size;
+    std::vector<Scalar> panel;
+    size_t n_blocks = (n + block - 1) / block;
+    for (size_t b = n_blocks; b-- > 0;) {
+      size_t j = b * block;
+      size_t jb = std::min(block, n - j);
+      // Move the L part of the panel (rows j..n) out of the result
+      panel.assign(n * jb, 0);
+      for (size_t row = j; row < n; row++) {
+        for (size_t c = 0; c < jb; c++) {
+          if (row > j + c) {
+            panel[row * jb + c] = a[row * n + j + c];
+            a[row * n + j + c] = 0;
+          }
+        }
+      }
+      // X[:, panel] -= X[:, after] * L[after, panel]
+      if (j + jb < n) {
+        gemm<Scalar>(n, jb, n - j - jb, -1, a + j + jb, n,
+                     panel.data() + (j + jb) * jb, jb, a + j, n);
+      }
+      // X[:, panel] = X[:, panel] * inv(L11), back substitution on columns
+      for (size_t row = 0; row < n; row++) {
+        Scalar *x = a + row * n + j;
+        for (size_t c = jb; c-- > 0;) {
+          for (size_t l = c + 1; l < jb; l++) {
+            x[c] -= x[l] * panel[(j + l) * jb + c];
+          }
+        }
+      }
+    }
+    for (size_t j = n; j-- > 0;) {
+      if (this->pivots[j] != j) {
+        result.swap_col(j, this->pivots[j]);
+      }
+    }
+    return result;
+  }
+  /*! Estimate the 1-norm condition number ||A||_1 * ||inv(A)||_1.
+   *
+   * Uses Hager's method with Higham's refinements (as in LAPACK's lacon),
+   * which needs a handful of solves with A and A^T, so O(n^2) work on top of
+   * the factorization. The estimate is a lower bound which is almost always
+   * within a factor of a few of the true value.
+   *
+   * @return The estimate (infinity for a singular Matrix)
+   * */
+  Scalar condition_estimate() const {
+    if (this->singular) {
+      return std::numeric_limits<Scalar>::infinity();
+    }
+    return this->matrix_norm_1 *
+           factorize_detail::inverse_norm_1_estimate<Scalar>(
+               this->n, [this](Scalar *x) { this->solve_inplace(x); },
+               [this](Scalar *x) { this->solve_transpose_inplace(x); });
+  }
+};
+
+/*! Cholesky factorization A = L * L^T of a symmetric positive definite
+ * Matrix (only the lower triangle of A is read).
+ * */
+template <typename Scalar> class CholeskyFactorization {
+private:
+  /*! L stored in the lower triangle, contiguously in row major order*/
+  Matrix<Scalar> factor;
+  /*! Number of rows and columns*/
+  size_t n;
+  /*! The 1-norm of the factored Matrix*/
+  Scalar matrix_norm_1;
+
+  Scalar *raw() { return this->factor.get_data()->data(); }
+  Scalar const *raw() const { return this->factor.get_data()->data(); }
+
+public:
+  // SECTION: Constructors
+  /*! Factor a symmetric positive definite Matrix.
+   *
+   * Throws std::runtime_error if the Matrix is not positive definite.
+   *
+   * @param matrix The Matrix to factor
+   * */
+  explicit CholeskyFactorization(Matrix<Scalar> const &matrix)
+      : factor(contiguous_copy(matrix)), n(matrix.get_nrows()),
+        matrix_norm_1(0) {
+    using std::abs;
+    if (matrix.get_nrows() != matrix.get_ncols()) {
+      throw std::runtime_error("Tried to Cholesky factor a non square Matrix");
+    }
+    Scalar *a = this->raw();
+    size_t n = this->n;
+    // 1-norm of the symmetric Matrix from its lower triangle
+    std::vector<Scalar> column_sums(n, 0);
+    for (size_t i = 0; i < n; i++) {
+      for (size_t j = 0; j < i; j++) {
+        column_sums[j] += abs(a[i * n + j]);
+        column_sums[i] += abs(a[i * n + j]);
+      }
+      column_sums[i] += abs(a[i * n + i]);
+    }
+    for (Scalar sum : column_sums) {
+      this->matrix_norm_1 = std::max(this->matrix_norm_1, sum);
+    }
+    if (!factorize_detail::cholesky_inplace(n, a, n)) {
+      throw std::runtime_error("Matrix is not positive definite");
+    }
+    for (size_t i = 0; i < n; i++) {
+      std::fill(a + i * n + i + 1, a + (i + 1) * n, Scalar{0});
+    }
+  }
+
+  // SECTION: Getters
+  /*! Get the number of rows (and columns) of the factored Matrix*/
+  size_t get_size() const { return this->n; }
+  /*! Get the lower triangular factor L*/
+  Matrix<Scalar> const &get_factor() const { return this->factor; }
+
+  // SECTION: Solves
+  /*! Solve A * x = b in place.
+   *
+   * @param rhs On entry b, on exit x (length n)
+   * */
+  void solve_inplace(Scalar *rhs) const {
+    factorize_detail::cholesky_solve_inplace(this->n, this->raw(), this->n,
+                                             rhs);
+  }
+  /*! Solve A * x = b.
+   *
+   * @param rhs The right hand side b
+   * @return The solution x
+   * */
+  std::vector<Scalar> solve(std::vector<Scalar> rhs) const {
+    if (rhs.size() != this->n) {
+      throw std::runtime_error("Right hand side has the wrong length");
+    }
+    this->solve_inplace(rhs.data());
+    return rhs;
+  }
+
+  // SECTION: Derived quantities
+  /*! The determinant of the factored Matrix*/
+  Scalar determinant() const {
+    Scalar const *a = this->raw();
+    Scalar result = 1;
+    for (size_t i = 0; i < this->n; i++) {
+      result *= a[i * this->n + i] * a[i * this->n + i];
+    }
+    return result;
+  }
+  /*! The natural logarithm of the determinant (which is positive)*/
+  Scalar log_abs_det() const {
+    using std::log;
+    Scalar const *a = this->raw();
+    Scalar result = 0;
+    for (size_t i = 0; i < this->n; i++) {
+      result += 2 * log(a[i * this->n + i]);
+    }
+    return result;
+  }
+  /*! Compute the inverse of the factored Matrix, as inv(L)^T * inv(L) with
+   * inv(L) computed in place by blocks.*/
+  Matrix<Scalar> inverse() const {
+    size_t n = this->n;
+    // inv(L) is the transpose of inv(L^T), which is upper triangular
+    Matrix<Scalar> upper{n, n};
+    Scalar *u = upper.get_data()->data();
+    Scalar const *a = this->raw();
+    for (size_t i = 0; i < n; i++) {
+      for (size_t j = 0; j <= i; j++) {
+        u[j * n + i] = a[i * n + j];
+      }
+    }
+    factorize_detail::invert_upper_inplace(n, u, n);
+    // inv(A) = inv(L^T) * inv(L^T)^T, only rows j >= i contribute
+    Matrix<Scalar> result{n, n};
+    Scalar *out = result.get_data()->data();
+    parallel_for(n, 16, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        for (size_t j = i; j < n; j++) {
+          size_t start = std::max(i, j);
+          Scalar value = dot(n - start, u + i * n + start, u + j * n + start);
+          out[i * n + j] = value;
+          out[j * n + i] = value;
+        }
+      }
+    });
+    return result;
+  }
+  /*! Estimate the 1-norm condition number ||A||_1 * ||inv(A)||_1, using the
+   * same Hager/Higham estimator as LUFactorization (A is symmetric, so only
+   * solves with A are needed).*/
+  Scalar condition_estimate() const {
+    auto solve = [this](Scalar *x) { this->solve_inplace(x); };
+    return this->matrix_norm_1 *
+           factorize_detail::inverse_norm_1_estimate<Scalar>(this->n, solve,
+                                                             solve);
+  }
+};
+
+// SECTION: Convenience functions
+/*! Determinant of a square Matrix (via LU factorization).*/
+template <typename Scalar> Scalar determinant(Matrix<Scalar> const &matrix) {
+  return LUFactorization<Scalar>{matrix}.determinant();
+}
+/*! Log of the absolute value of the determinant of a square Matrix (via LU
+ * factorization).*/
+template <typename Scalar> Scalar log_abs_det(Matrix<Scalar> const &matrix) {
+  return LUFactorization<Scalar>{matrix}.log_abs_det();
+}
+/*! Inverse of a square Matrix (via LU factorization). Throws
+ * std::runtime_error if the Matrix is singular.*/
+template <typename Scalar> Matrix<Scalar> inverse(Matrix<Scalar> const &matrix) {
+  return LUFactorization<Scalar>{matrix}.inverse();
+}
+/*! Estimate of the 1-norm condition number of a square Matrix (via LU
+ * factorization).*/
+template <typename Scalar>
+Scalar condition_estimate(Matrix<Scalar> const &matrix) {
+  return LUFactorization<Scalar>{matrix}.condition_estimate();
+}
+} // namespace teensymat
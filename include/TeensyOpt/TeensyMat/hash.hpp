@@ -0,0 +1,177 @@
+#pragma once
+// std includes
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/parallel.hpp"
+
+namespace teensymat {
+namespace hash_detail {
+constexpr uint64_t prime_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t prime_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t prime_3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t prime_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t prime_5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t rotl(uint64_t value, int amount) {
+  return (value << amount) | (value >> (64 - amount));
+}
+inline uint64_t read_64(unsigned char const *bytes) {
+  uint64_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+inline uint32_t read_32(unsigned char const *bytes) {
+  uint32_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+inline uint64_t round(uint64_t accumulator, uint64_t input) {
+  accumulator += input * prime_2;
+  accumulator = rotl(accumulator, 31);
+  return accumulator * prime_1;
+}
+inline uint64_t merge_round(uint64_t accumulator, uint64_t value) {
+  accumulator ^= round(0, value);
+  return accumulator * prime_1 + prime_4;
+}
+
+/*! A cached hash tagged with the version of the object it was computed
+ * for, safe to read and fill from concurrent const calls.
+ *
+ * The tag (one more than the version, 0 when empty) is published with
+ * release ordering after the hash is stored, so a reader that sees the
+ * tag it expects also sees the hash. Concurrent writers for the same
+ * version store the same hash, so their race is benign.
+ * */
+class HashCache {
+private:
+  std::atomic<uint64_t> hash{0};
+  std::atomic<size_t> tag{0};
+
+public:
+  HashCache() = default;
+  HashCache(HashCache const &other) { *this = other; }
+  HashCache &operator=(HashCache const &other) {
+    this->hash.store(other.hash.load(std::memory_order_relaxed),
+                     std::memory_order_relaxed);
+    this->tag.store(other.tag.load(std::memory_order_acquire),
+                    std::memory_order_release);
+    return *this;
+  }
+  /*! Get the hash cached for version, if there is one*/
+  bool get(size_t version, uint64_t &result) const {
+    if (this->tag.load(std::memory_order_acquire) != version + 1) {
+      return false;
+    }
+    result = this->hash.load(std::memory_order_relaxed);
+    return true;
+  }
+  /*! Cache the hash of version*/
+  void set(size_t version, uint64_t value) {
+    this->hash.store(value, std::memory_order_relaxed);
+    this->tag.store(version + 1, std::memory_order_release);
+  }
+};
+} // namespace hash_detail
+
+/*! Compute the 64 bit xxHash (XXH64) of a block of memory.
+ *
+ * This is a fast non-cryptographic hash, suitable for detecting changes in
+ * data but not for security purposes. Words are read in native byte order,
+ * so hashes match the reference implementation on little endian machines.
+ *
+ * @param data Pointer to the first byte to hash
+ * @param length Number of bytes to hash
+ * @param seed Seed of the hash
+ * @return The hash value
+ * */
+inline uint64_t xxhash64(void const *data, size_t length, uint64_t seed = 0) {
+  using namespace hash_detail;
+  unsigned char const *bytes = static_cast<unsigned char const *>(data);
+  unsigned char const *end = bytes + length;
+  uint64_t hash;
+  if (length >= 32) {
+    // Four independent accumulators, so the stripes pipeline well
+    uint64_t acc_1 = seed + prime_1 + prime_2;
+    uint64_t acc_2 = seed + prime_2;
+    uint64_t acc_3 = seed;
+    uint64_t acc_4 = seed - prime_1;
+    unsigned char const *stripe_limit = end - 32;
+    do {
+      acc_1 = round(acc_1, read_64(bytes));
+      acc_2 = round(acc_2, read_64(bytes + 8));
+      acc_3 = round(acc_3, read_64(bytes + 16));
+      acc_4 = round(acc_4, read_64(bytes + 24));
+      bytes += 32;
+    } while (bytes <= stripe_limit);
+    hash = rotl(acc_1, 1) + rotl(acc_2, 7) + rotl(acc_3, 12) + rotl(acc_4, 18);
+    hash = merge_round(hash, acc_1);
+    hash = merge_round(hash, acc_2);
+    hash = merge_round(hash, acc_3);
+    hash = merge_round(hash, acc_4);
+  } else {
+    hash = seed + prime_5;
+  }
+  hash += static_cast<uint64_t>(length);
+  while (bytes + 8 <= end) {
+    hash ^= round(0, read_64(bytes));
+    hash = rotl(hash, 27) * prime_1 + prime_4;
+    bytes += 8;
+  }
+  if (bytes + 4 <= end) {
+    hash ^= static_cast<uint64_t>(read_32(bytes)) * prime_1;
+    hash = rotl(hash, 23) * prime_2 + prime_3;
+    bytes += 4;
+  }
+  while (bytes < end) {
+    hash ^= static_cast<uint64_t>(*bytes) * prime_5;
+    hash = rotl(hash, 11) * prime_1;
+    bytes++;
+  }
+  hash ^= hash >> 33;
+  hash *= prime_2;
+  hash ^= hash >> 29;
+  hash *= prime_3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+/*! Number of bytes hashed by each task of parallel_hash*/
+constexpr size_t hash_chunk_bytes = size_t{1} << 16;
+
+/*! Hash a block of memory by hashing fixed size chunks in parallel, and then
+ * hashing the list of chunk hashes.
+ *
+ * The chunking does not depend on the number of threads, so the result is
+ * the same for any thread count (but differs from xxhash64 of the whole
+ * block once it is longer than one chunk).
+ *
+ * @param data Pointer to the first byte to hash
+ * @param length Number of bytes to hash
+ * @param seed Seed of the hash
+ * @return The hash value
+ * */
+inline uint64_t parallel_hash(void const *data, size_t length,
+                              uint64_t seed = 0) {
+  if (length <= hash_chunk_bytes) {
+    return xxhash64(data, length, seed);
+  }
+  unsigned char const *bytes = static_cast<unsigned char const *>(data);
+  size_t n_chunks = (length + hash_chunk_bytes - 1) / hash_chunk_bytes;
+  std::vector<uint64_t> chunk_hashes(n_chunks);
+  parallel_for(n_chunks, 1, [&](size_t begin, size_t end) {
+    for (size_t chunk = begin; chunk < end; chunk++) {
+      size_t offset = chunk * hash_chunk_bytes;
+      size_t chunk_length = std::min(hash_chunk_bytes, length - offset);
+      chunk_hashes[chunk] = xxhash64(bytes + offset, chunk_length, seed);
+    }
+  });
+  return xxhash64(chunk_hashes.data(), n_chunks * sizeof(uint64_t),
+                  seed ^ static_cast<uint64_t>(length));
+}
+} // namespace teensymat
@@ -0,0 +1,102 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace teensymat {
+/*! A dense array together with the list of its (possibly) nonzero
+ * positions.
+ *
+ * Operations on hypersparse vectors (a handful of nonzeros out of millions)
+ * only touch the listed positions, while the dense array keeps random
+ * access O(1). Entries which cancel to exactly zero after being listed are
+ * stored as a tiny marker value so that they are not listed twice.
+ * */
+template <typename Scalar> struct IndexedVector {
+  /*! Values of all positions (zero where not listed)*/
+  std::vector<Scalar> values;
+  /*! Positions which may be nonzero, without duplicates*/
+  std::vector<size_t> index;
+
+  /*! Value marking listed positions whose value cancelled to zero*/
+  static constexpr Scalar tiny = std::numeric_limits<Scalar>::min();
+
+  // SECTION: Constructors
+  /*! Construct an empty IndexedVector*/
+  IndexedVector() = default;
+  /*! Construct an all zero IndexedVector of the given length*/
+  explicit IndexedVector(size_t size) : values(size, 0) {
+    this->index.reserve(size);
+  }
+
+  // SECTION: Getters
+  /*! Get the length of the vector*/
+  size_t get_size() const { return this->values.size(); }
+  /*! Get the number of listed positions*/
+  size_t get_count() const { return this->index.size(); }
+  /*! Get the fraction of positions which are listed*/
+  double get_density() const {
+    return this->values.empty()
+               ? 0.0
+               : static_cast<double>(this->index.size()) /
+                     static_cast<double>(this->values.size());
+  }
+
+  // SECTION: Modification
+  /*! Set all entries to zero, in time proportional to the number of listed
+   * positions (or the length, if that is smaller)*/
+  void clear() {
+    if (this->index.size() * 4 > this->values.size()) {
+      std::fill(this->values.begin(), this->values.end(), Scalar{0});
+    } else {
+      for (size_t i : this->index) {
+        this->values[i] = 0;
+      }
+    }
+    this->index.clear();
+  }
+  /*! Add a value to a position, listing it if needed.
+   *
+   * @param i The position
+   * @param value The value to add
+   * */
+  void add(size_t i, Scalar value) {
+    Scalar current = this->values[i];
+    if (current == Scalar{0}) {
+      this->index.push_back(i);
+      this->values[i] = value == Scalar{0} ? tiny : value;
+    } else {
+      Scalar sum = current + value;
+      this->values[i] = sum == Scalar{0} ? tiny : sum;
+    }
+  }
+  /*! Rebuild the list of positions from the dense array, after it has been
+   * written to directly.*/
+  void rebuild_index() {
+    this->index.clear();
+    for (size_t i = 0; i < this->values.size(); i++) {
+      if (this->values[i] != Scalar{0}) {
+        this->index.push_back(i);
+      }
+    }
+  }
+  /*! Zero and unlist entries whose magnitude is at most tolerance.
+   *
+   * @param tolerance Largest magnitude which is dropped
+   * */
+  void drop_small(Scalar tolerance) {
+    size_t kept = 0;
+    for (size_t i : this->index) {
+      if (std::abs(this->values[i]) > tolerance) {
+        this->index[kept++] = i;
+      } else {
+        this->values[i] = 0;
+      }
+    }
+    this->index.resize(kept);
+  }
+};
+} // namespace teensymat
@@ -0,0 +1,167 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/linalg.hpp"
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+
+namespace teensymat {
+/*! Limited memory BFGS approximation of an inverse Hessian.
+ *
+ * Keeps the last few correction pairs s_k = x_{k+1} - x_k and
+ * y_k = g_{k+1} - g_k in a ring buffer, preallocated as one contiguous
+ * Matrix (row k holds s_k and row capacity + 1 + k holds y_k), so adding
+ * a pair or applying the approximation allocates nothing. New pairs are
+ * written in place through next_s and next_y and then committed; the
+ * ring has one spare slot, so a pair that is written but not committed
+ * never overwrites a stored one.
+ * */
+template <typename Scalar> class LBFGSMemory {
+private:
+  /*! Number of variables*/
+  size_t n;
+  /*! Maximum number of correction pairs, and slots of the ring*/
+  size_t capacity, slots;
+  /*! The correction pairs*/
+  Matrix<Scalar> history;
+  /*! 1 / (s_k^T y_k) of each slot, and the two loop coefficients*/
+  std::vector<Scalar> rho, alpha;
+  /*! Number of stored pairs and slot of the newest one*/
+  size_t stored, newest;
+  /*! Initial inverse Hessian gamma I, gamma = s^T y / y^T y of the newest
+   * pair*/
+  Scalar scaling;
+
+  /*! Slot of the j-th newest pair (j = 0 is the newest)*/
+  size_t slot(size_t j) const {
+    return (this->newest + this->slots - j) % this->slots;
+  }
+  /*! Slot the next pair is written to*/
+  size_t next_slot() const { return (this->newest + 1) % this->slots; }
+  Scalar *s_row(size_t slot) { return this->history(slot, 0); }
+  Scalar *y_row(size_t slot) { return this->history(this->slots + slot, 0); }
+
+public:
+  // SECTION: Constructors
+  /*! Allocate the memory.
+   *
+   * Throws std::range_error if capacity is zero.
+   *
+   * @param n Number of variables
+   * @param capacity Maximum number of correction pairs
+   * */
+  LBFGSMemory(size_t n, size_t capacity)
+      : n(n), capacity(capacity), slots(capacity + 1),
+        history(2 * (capacity + 1), n), rho(capacity + 1, 0),
+        alpha(capacity + 1, 0), stored(0), newest(capacity), scaling(1) {
+    if (capacity == 0) {
+      throw std::range_error("L-BFGS needs at least one correction pair");
+    }
+  }
+
+  // SECTION: Getters
+  /*! Get the number of variables*/
+  size_t get_dim() const { return this->n; }
+  /*! Get the maximum number of correction pairs*/
+  size_t get_capacity() const { return this->capacity; }
+  /*! Get the number of stored correction pairs*/
+  size_t get_size() const { return this->stored; }
+  /*! Get gamma of the initial inverse Hessian gamma I*/
+  Scalar get_scaling() const { return this->scaling; }
+  /*! Get the k-th stored s (k = 0 is the oldest)*/
+  Scalar const *get_s(size_t k) const {
+    return this->history(this->slot(this->stored - 1 - k), 0);
+  }
+  /*! Get the k-th stored y (k = 0 is the oldest)*/
+  Scalar const *get_y(size_t k) const {
+    return this->history(this->slots + this->slot(this->stored - 1 - k), 0);
+  }
+
+  // SECTION: Updates
+  /*! Buffer to write the next s into*/
+  Scalar *next_s() { return this->s_row(this->next_slot()); }
+  /*! Buffer to write the next y into*/
+  Scalar *next_y() { return this->y_row(this->next_slot()); }
+  /*! Store the pair written to next_s and next_y, given s^T y and
+   * y^T y (when the caller computed them while writing the pair).
+   *
+   * @return Whether the pair was stored (dropping the oldest one when
+   * the memory is full), pairs with s^T y <= 0 (which would make the
+   * approximation indefinite) are skipped
+   * */
+  bool commit(Scalar sy, Scalar yy) {
+    if (!(sy > std::numeric_limits<Scalar>::epsilon() * yy) || !(yy > 0)) {
+      return false;
+    }
+    size_t slot = this->next_slot();
+    this->rho[slot] = 1 / sy;
+    this->scaling = sy / yy;
+    this->newest = slot;
+    this->stored = std::min(this->stored + 1, this->capacity);
+    return true;
+  }
+  /*! Store the pair written to next_s and next_y.
+   *
+   * @return Whether the pair was stored
+   * */
+  bool commit() {
+    size_t slot = this->next_slot();
+    Scalar const *y = this->y_row(slot);
+    return this->commit(dot(this->n, this->s_row(slot), y),
+                        dot(this->n, y, y));
+  }
+  /*! Forget all pairs*/
+  void reset() {
+    this->stored = 0;
+    this->scaling = 1;
+  }
+
+  // SECTION: Products
+  /*! Compute d = -H g by the two loop recursion. Each axpy of a loop is
+   * fused with the dot product of the next pair, so a pair costs one pass
+   * over the data per loop.
+   *
+   * @param gradient The gradient g
+   * @param direction Output d (must not alias gradient)
+   * */
+  void direction(Scalar const *gradient, Scalar *direction) {
+    size_t n = this->n;
+    for (size_t i = 0; i < n; i++) {
+      direction[i] = -gradient[i];
+    }
+    size_t stored = this->stored;
+    if (stored == 0) {
+      return;
+    }
+    Scalar sd = dot(n, this->s_row(this->slot(0)), direction);
+    for (size_t j = 0; j < stored; j++) {
+      size_t slot = this->slot(j);
+      this->alpha[slot] = this->rho[slot] * sd;
+      if (j + 1 < stored) {
+        sd = axpy_dot(n, -this->alpha[slot], this->y_row(slot),
+                                 direction, this->s_row(this->slot(j + 1)));
+      } else {
+        axpy(n, -this->alpha[slot], this->y_row(slot), direction);
+      }
+    }
+    scal(n, this->scaling, direction);
+    Scalar yd =
+        dot(n, this->y_row(this->slot(stored - 1)), direction);
+    for (size_t j = stored; j-- > 0;) {
+      size_t slot = this->slot(j);
+      Scalar step = this->alpha[slot] - this->rho[slot] * yd;
+      if (j > 0) {
+        yd = axpy_dot(n, step, this->s_row(slot), direction,
+                                 this->y_row(this->slot(j - 1)));
+      } else {
+        axpy(n, step, this->s_row(slot), direction);
+      }
+    }
+  }
+};
+} // namespace teensymat
@@ -0,0 +1,338 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+#include "TeensyOpt/TeensyMat/parallel.hpp"
+
+namespace teensymat {
+// SECTION: Vector kernels
+/*! Dot product of two arrays.
+ *
+ * @param n Number of elements
+ * @param x First array
+ * @param y Second array
+ * @return Sum of x[i] * y[i]
+ * */
+template <typename Scalar>
+Scalar dot(size_t n, Scalar const *x, Scalar const *y) {
+  // Four partial sums break the dependency chain so the loop vectorizes
+  Scalar sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    sum0 += x[i] * y[i];
+    sum1 += x[i + 1] * y[i + 1];
+    sum2 += x[i + 2] * y[i + 2];
+    sum3 += x[i + 3] * y[i + 3];
+  }
+  for (; i < n; i++) {
+    sum0 += x[i] * y[i];
+  }
+  return (sum0 + sum1) + (sum2 + sum3);
+}
+/*! Compute y += alpha * x.
+ *
+ * @param n Number of elements
+ * @param alpha Multiplier of x
+ * @param x Array added to y
+ * @param y Array which is updated
+ * */
+template <typename Scalar>
+void axpy(size_t n, Scalar alpha, Scalar const *x, Scalar *y) {
+  for (size_t i = 0; i < n; i++) {
+    y[i] += alpha * x[i];
+  }
+}
+/*! Compute y += alpha * x and return the dot product of z with the updated
+ * y, in a single pass over the arrays.
+ *
+ * @param n Number of elements
+ * @param alpha Multiplier of x
+ * @param x Array added to y
+ * @param y Array which is updated
+ * @param z Array dotted with the updated y
+ * @return Sum of z[i] * (y[i] + alpha * x[i])
+ * */
+template <typename Scalar>
+Scalar axpy_dot(size_t n, Scalar alpha, Scalar const *x, Scalar *y,
+                Scalar const *z) {
+  Scalar sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    y[i] += alpha * x[i];
+    y[i + 1] += alpha * x[i + 1];
+    y[i + 2] += alpha * x[i + 2];
+    y[i + 3] += alpha * x[i + 3];
+    sum0 += z[i] * y[i];
+    sum1 += z[i + 1] * y[i + 1];
+    sum2 += z[i + 2] * y[i + 2];
+    sum3 += z[i + 3] * y[i + 3];
+  }
+  for (; i < n; i++) {
+    y[i] += alpha * x[i];
+    sum0 += z[i] * y[i];
+  }
+  return (sum0 + sum1) + (sum2 + sum3);
+}
+/*! Compute w = alpha * x + y.
+ *
+ * @param n Number of elements
+ * @param alpha Multiplier of x
+ * @param x First array
+ * @param y Second array
+ * @param w Output array (may alias x or y)
+ * */
+template <typename Scalar>
+void waxpy(size_t n, Scalar alpha, Scalar const *x, Scalar const *y,
+           Scalar *w) {
+  for (size_t i = 0; i < n; i++) {
+    w[i] = alpha * x[i] + y[i];
+  }
+}
+/*! Multiply an array by alpha in place.
+ *
+ * @param n Number of elements
+ * @param alpha Multiplier
+ * @param x Array which is scaled
+ * */
+template <typename Scalar> void scal(size_t n, Scalar alpha, Scalar *x) {
+  for (size_t i = 0; i < n; i++) {
+    x[i] *= alpha;
+  }
+}
+/*! Euclidean norm of an array, guarded against overflow.
+ *
+ * @param n Number of elements
+ * @param x The array
+ * */
+template <typename Scalar> Scalar nrm2(size_t n, Scalar const *x) {
+  using std::abs;
+  using std::sqrt;
+  Scalar largest = 0;
+  for (size_t i = 0; i < n; i++) {
+    largest = std::max(largest, abs(x[i]));
+  }
+  if (largest == 0) {
+    return 0;
+  }
+  Scalar sum = 0;
+  for (size_t i = 0; i < n; i++) {
+    Scalar scaled = x[i] / largest;
+    sum += scaled * scaled;
+  }
+  return largest * sqrt(sum);
+}
+/*! Sum of the absolute values of an array.
+ *
+ * @param n Number of elements
+ * @param x The array
+ * */
+template <typename Scalar> Scalar asum(size_t n, Scalar const *x) {
+  using std::abs;
+  Scalar sum = 0;
+  for (size_t i = 0; i < n; i++) {
+    sum += abs(x[i]);
+  }
+  return sum;
+}
+
+// SECTION: Matrix kernels
+/*! Compute C += alpha * A * B for row major arrays.
+ *
+ * The loops are blocked for cache reuse, with a contiguous innermost loop
+ * over the columns of B and C. Large products are split over blocks of rows
+ * of C using the global ThreadPool.
+ *
+ * @param m Number of rows of A and C
+ * @param n Number of columns of B and C
+ * @param k Number of columns of A and rows of B
+ * @param alpha Multiplier of the product
+ * @param a Pointer to A
+ * @param lda Row stride of A
+ * @param b Pointer to B
+ * @param ldb Row stride of B
+ * @param c Pointer to C
+ * @param ldc Row stride of C
+ * */
+template <typename Scalar>
+void gemm(size_t m, size_t n, size_t k, Scalar alpha, Scalar const *a,
+          size_t lda, Scalar const *b, size_t ldb, Scalar *c, size_t ldc) {
+  constexpr size_t block_k = 128;
+  constexpr size_t block_n = 256;
+  // Aim for tasks of about a million multiply-adds
+  size_t row_grain = std::max<size_t>(
+      8, (size_t{1} << 20) / std::max<size_t>(1, n * k));
+  parallel_for(m, row_grain, [&](size_t row_begin, size_t row_end) {
+    for (size_t kk = 0; kk < k; kk += block_k) {
+      size_t k_end = std::min(k, kk + block_k);
+      for (size_t jj = 0; jj < n; jj += block_n) {
+        size_t j_end = std::min(n, jj + block_n);
+        for (size_t i = row_begin; i < row_end; i++) {
+          Scalar *c_row = c + i * ldc;
+          for (size_t p = kk; p < k_end; p++) {
+            Scalar a_ip = alpha * a[i * lda + p];
+            Scalar const *b_row = b + p * ldb;
+            for (size_t j = jj; j < j_end; j++) {
+              c_row[j] += a_ip * b_row[j];
+            }
+          }
+        }
+      }
+    }
+  });
+}
+/*! Compute C += alpha * A * B^T for row major arrays, i.e. every entry of C
+ * is a dot product of a row of A with a row of B. This is the natural
+ * product for blocks of vectors stored one vector per row.
+ *
+ * @param m Number of rows of A and C
+ * @param n Number of rows of B and columns of C
+ * @param k Number of columns of A and B
+ * @param alpha Multiplier of the product
+ * @param a Pointer to A
+ * @param lda Row stride of A
+ * @param b Pointer to B
+ * @param ldb Row stride of B
+ * @param c Pointer to C
+ * @param ldc Row stride of C
+ * */
+template <typename Scalar>
+void gemm_nt(size_t m, size_t n, size_t k, Scalar alpha, Scalar const *a,
+             size_t lda, Scalar const *b, size_t ldb, Scalar *c, size_t ldc) {
+  constexpr size_t block_k = 512;
+  constexpr size_t block_n = 32;
+  size_t row_grain = std::max<size_t>(
+      1, (size_t{1} << 20) / std::max<size_t>(1, n * k));
+  parallel_for(m, row_grain, [&](size_t row_begin, size_t row_end) {
+    for (size_t kk = 0; kk < k; kk += block_k) {
+      size_t k_len = std::min(k, kk + block_k) - kk;
+      for (size_t jj = 0; jj < n; jj += block_n) {
+        size_t j_end = std::min(n, jj + block_n);
+        for (size_t i = row_begin; i < row_end; i++) {
+          for (size_t j = jj; j < j_end; j++) {
+            c[i * ldc + j] +=
+                alpha * dot(k_len, a + i * lda + kk, b + j * ldb + kk);
+          }
+        }
+      }
+    }
+  });
+}
+/*! Compute y += alpha * A * x for a row major array A.
+ *
+ * @param m Number of rows of A
+ * @param n Number of columns of A
+ * @param alpha Multiplier of the product
+ * @param a Pointer to A
+ * @param lda Row stride of A
+ * @param x Array of length n
+ * @param y Array of length m which is updated
+ * */
+template <typename Scalar>
+void gemv(size_t m, size_t n, Scalar alpha, Scalar const *a, size_t lda,
+          Scalar const *x, Scalar *y) {
+  size_t row_grain = std::max<size_t>(16, (size_t{1} << 18) / std::max<size_t>(1, n));
+  parallel_for(m, row_grain, [&](size_t row_begin, size_t row_end) {
+    for (size_t i = row_begin; i < row_end; i++) {
+      y[i] += alpha * dot(n, a + i * lda, x);
+    }
+  });
+}
+/*! Compute y += alpha * A^T * x for a row major array A.
+ *
+ * @param m Number of rows of A
+ * @param n Number of columns of A
+ * @param alpha Multiplier of the product
+ * @param a Pointer to A
+ * @param lda Row stride of A
+ * @param x Array of length m
+ * @param y Array of length n which is updated
+ * */
+template <typename Scalar>
+void gemv_transpose(size_t m, size_t n, Scalar alpha, Scalar const *a,
+                    size_t lda, Scalar const *x, Scalar *y) {
+  for (size_t i = 0; i < m; i++) {
+    axpy(n, alpha * x[i], a + i * lda, y);
+  }
+}
+
+// SECTION: Matrix helpers
+/*! Copy a Matrix into a new Matrix stored contiguously in row major order
+ * (see Matrix::is_contiguous), as expected by the kernels in this file.
+ *
+ * @param matrix The Matrix to copy
+ * @return The contiguous copy
+ * */
+template <typename Scalar>
+Matrix<Scalar> contiguous_copy(Matrix<Scalar> const &matrix) {
+  if (matrix.is_contiguous()) {
+    std::vector<Scalar> data(matrix.get_data()->begin(),
+                             matrix.get_data()->begin() + matrix.get_size());
+    return Matrix<Scalar>{matrix.get_nrows(), matrix.get_ncols(), data};
+  }
+  Matrix<Scalar> result{matrix.get_nrows(), matrix.get_ncols()};
+  Scalar *out = result.get_data()->data();
+  for (size_t row = 0; row < matrix.get_nrows(); row++) {
+    for (size_t col = 0; col < matrix.get_ncols(); col++) {
+      out[row * matrix.get_ncols() + col] = *matrix(row, col);
+    }
+  }
+  return result;
+}
+/*! Create an identity Matrix.
+ *
+ * @param n Number of rows and columns
+ * */
+template <typename Scalar> Matrix<Scalar> identity(size_t n) {
+  Matrix<Scalar> result{n, n};
+  Scalar *out = result.get_data()->data();
+  for (size_t i = 0; i < n; i++) {
+    out[i * n + i] = 1;
+  }
+  return result;
+}
+/*! Matrix product of two matrices (operator* is elementwise).
+ *
+ * @param lhs Left hand side, of shape (m, k)
+ * @param rhs Right hand side, of shape (k, n)
+ * @return New Matrix of shape (m, n)
+ * */
+template <typename Scalar>
+Matrix<Scalar> matmul(Matrix<Scalar> const &lhs, Matrix<Scalar> const &rhs) {
+  if (lhs.get_ncols() != rhs.get_nrows()) {
+    throw std::runtime_error("Tried to multiply Matrices of incompatible shapes");
+  }
+  Matrix<Scalar> a = contiguous_copy(lhs);
+  Matrix<Scalar> b = contiguous_copy(rhs);
+  size_t m = lhs.get_nrows();
+  size_t k = lhs.get_ncols();
+  size_t n = rhs.get_ncols();
+  Matrix<Scalar> result{m, n};
+  gemm<Scalar>(m, n, k, 1, a.get_data()->data(), k, b.get_data()->data(), n,
+               result.get_data()->data(), n);
+  return result;
+}
+/*! The 1-norm (largest absolute column sum) of a Matrix.
+ *
+ * @param matrix The Matrix
+ * */
+template <typename Scalar> Scalar norm_1(Matrix<Scalar> const &matrix) {
+  using std::abs;
+  std::vector<Scalar> column_sums(matrix.get_ncols(), 0);
+  for (size_t row = 0; row < matrix.get_nrows(); row++) {
+    for (size_t col = 0; col < matrix.get_ncols(); col++) {
+      column_sums[col] += abs(*matrix(row, col));
+    }
+  }
+  Scalar largest = 0;
+  for (Scalar sum : column_sums) {
+    largest = std::max(largest, sum);
+  }
+  return largest;
+}
+} // namespace teensymat
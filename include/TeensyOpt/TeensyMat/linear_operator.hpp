@@ -0,0 +1,168 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/linalg.hpp"
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+#include "TeensyOpt/TeensyMat/sparse_core.hpp"
+
+namespace teensymat {
+/*! A matrix-free linear operator, defined by functions computing its action
+ * on vectors.
+ *
+ * Solvers written against this interface work the same on dense matrices,
+ * sparse matrices and implicit operators which are never formed. Blocks of
+ * vectors are stored one vector per row (k vectors of length n form a
+ * contiguous k by n row major array).
+ * */
+template <typename Scalar> class LinearOperator {
+public:
+  /*! Signature of the action on one vector, y = A * x (y is overwritten)*/
+  using Apply = std::function<void(Scalar const *x, Scalar *y)>;
+  /*! Signature of the action on k vectors, Y = X * A^T with one vector per
+   * row (Y is overwritten)*/
+  using ApplyBlock =
+      std::function<void(size_t k, Scalar const *x_block, Scalar *y_block)>;
+
+private:
+  /*! The number of rows of the operator*/
+  size_t nrows;
+  /*! The number of columns of the operator*/
+  size_t ncols;
+  /*! Computes y = A * x*/
+  Apply apply_fn;
+  /*! Computes y = A^T * x (may be empty)*/
+  Apply apply_transpose_fn;
+  /*! Computes A applied to a block of vectors (may be empty)*/
+  ApplyBlock apply_block_fn;
+
+public:
+  // SECTION: Constructors
+  /*! Construct an operator from the functions computing its action.
+   *
+   * @param nrows Number of rows (length of the results of apply)
+   * @param ncols Number of columns (length of the arguments of apply)
+   * @param apply Function computing y = A * x
+   * @param apply_transpose Function computing y = A^T * x, may be empty if
+   * no algorithm needing it is used
+   * @param apply_block Function applying A to a block of vectors, may be
+   * empty in which case the vectors are applied one at a time
+   * */
+  LinearOperator(size_t nrows, size_t ncols, Apply apply,
+                 Apply apply_transpose = {}, ApplyBlock apply_block = {})
+      : nrows(nrows), ncols(ncols), apply_fn(std::move(apply)),
+        apply_transpose_fn(std::move(apply_transpose)),
+        apply_block_fn(std::move(apply_block)) {}
+  /*! Construct an operator from a dense Matrix (a contiguous copy is kept,
+   * and blocks of vectors are applied with a single gemm).
+   *
+   * @param matrix The Matrix
+   * */
+  static LinearOperator from_matrix(Matrix<Scalar> const &matrix) {
+    auto stored =
+        std::make_shared<Matrix<Scalar> const>(contiguous_copy(matrix));
+    size_t m = matrix.get_nrows();
+    size_t n = matrix.get_ncols();
+    return LinearOperator{
+        m, n,
+        [stored, m, n](Scalar const *x, Scalar *y) {
+          std::fill(y, y + m, Scalar{0});
+          gemv<Scalar>(m, n, 1, stored->get_data()->data(), n, x, y);
+        },
+        [stored, m, n](Scalar const *x, Scalar *y) {
+          std::fill(y, y + n, Scalar{0});
+          gemv_transpose<Scalar>(m, n, 1, stored->get_data()->data(), n, x,
+                                 y);
+        },
+        [stored, m, n](size_t k, Scalar const *x_block, Scalar *y_block) {
+          std::fill(y_block, y_block + k * m, Scalar{0});
+          gemm_nt<Scalar>(k, m, n, 1, x_block, n, stored->get_data()->data(),
+                          n, y_block, m);
+        }};
+  }
+  /*! Construct an operator from a SparseMatrix. A copy of the matrix and of
+   * its transpose are kept, so that both products are parallel.
+   *
+   * @param matrix The SparseMatrix
+   * */
+  static LinearOperator from_sparse(SparseMatrix<Scalar> const &matrix) {
+    auto stored = std::make_shared<SparseMatrix<Scalar> const>(matrix);
+    auto transposed =
+        std::make_shared<SparseMatrix<Scalar> const>(matrix.transpose());
+    size_t m = matrix.get_nrows();
+    size_t n = matrix.get_ncols();
+    return LinearOperator{m, n,
+                          [transposed, m](Scalar const *x, Scalar *y) {
+                            std::fill(y, y + m, Scalar{0});
+                            transposed->gaxpy_transpose(1, x, y);
+                          },
+                          [stored, n](Scalar const *x, Scalar *y) {
+                            std::fill(y, y + n, Scalar{0});
+                            stored->gaxpy_transpose(1, x, y);
+                          }};
+  }
+
+  // SECTION: Getters
+  /*! Get the number of rows of the operator.*/
+  size_t get_nrows() const { return this->nrows; }
+  /*! Get the number of columns of the operator.*/
+  size_t get_ncols() const { return this->ncols; }
+  /*! Whether the action of the transpose is available.*/
+  bool has_transpose() const {
+    return static_cast<bool>(this->apply_transpose_fn);
+  }
+
+  // SECTION: Application
+  /*! Compute y = A * x.
+   *
+   * @param x Array of length ncols
+   * @param y Array of length nrows, overwritten with the result
+   * */
+  void apply(Scalar const *x, Scalar *y) const { this->apply_fn(x, y); }
+  /*! Compute y = A^T * x.
+   *
+   * @param x Array of length nrows
+   * @param y Array of length ncols, overwritten with the result
+   * */
+  void apply_transpose(Scalar const *x, Scalar *y) const {
+    if (!this->apply_transpose_fn) {
+      throw std::runtime_error("Operator has no transpose");
+    }
+    this->apply_transpose_fn(x, y);
+  }
+  /*! Apply the operator to k vectors stored one per row.
+   *
+   * @param k Number of vectors
+   * @param x_block k by ncols row major array of vectors
+   * @param y_block k by nrows row major array, overwritten with the results
+   * */
+  void apply_block(size_t k, Scalar const *x_block, Scalar *y_block) const {
+    if (this->apply_block_fn) {
+      this->apply_block_fn(k, x_block, y_block);
+      return;
+    }
+    for (size_t i = 0; i < k; i++) {
+      this->apply_fn(x_block + i * this->ncols, y_block + i * this->nrows);
+    }
+  }
+  /*! Compute A * x.
+   *
+   * @param x Vector of length ncols
+   * @return Vector of length nrows
+   * */
+  std::vector<Scalar> apply(std::vector<Scalar> const &x) const {
+    if (x.size() != this->ncols) {
+      throw std::runtime_error("Vector has the wrong length for product");
+    }
+    std::vector<Scalar> result(this->nrows);
+    this->apply_fn(x.data(), result.data());
+    return result;
+  }
+};
+} // namespace teensymat
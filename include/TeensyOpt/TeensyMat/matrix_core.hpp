@@ -1,11 +1,19 @@
 #pragma once
 // std includes
+#include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <initializer_list>
 #include <stdexcept>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+// Local includes
+#include "TeensyOpt/TeensyMat/hash.hpp"
+#include "TeensyOpt/TeensyMat/parallel.hpp"
+
 namespace teensymat {
 /*! A class representing a two dimensional array*/
 template <typename Scalar> class Matrix {
@@ -22,6 +30,11 @@ private:
   size_t ncols;
   /*! The size of the matrix (the length of the associated linear memory)*/
   size_t matrix_size;
+  /*! Counter incremented whenever the Matrix may have been modified (any
+   * non-const access to its elements)*/
+  size_t version = 0;
+  /*! Cached result of content_hash, tagged with version*/
+  mutable hash_detail::HashCache hash_cache;
 
 public:
   // SECTION: Constructors
@@ -98,21 +111,42 @@ public:
 
   // SECTION: Getters
   /*! Get the number of rows in the Matrix.*/
-  size_t get_nrows() { return this->nrows; }
+  size_t get_nrows() const { return this->nrows; }
   /*! Get the number of columns in the Matrix.*/
-  size_t get_ncols() { return this->ncols; }
+  size_t get_ncols() const { return this->ncols; }
   /*! Get the stride for the rows of the matrix.*/
-  size_t get_row_stride() { return this->row_stride; }
+  size_t get_row_stride() const { return this->row_stride; }
   /*! Get the stride for the columns of the matrix. */
-  size_t get_col_stride() { return this->col_stride; }
-  /*! Get the underlying data vector*/
-  std::vector<Scalar> *get_data() { return &(this->data); }
+  size_t get_col_stride() const { return this->col_stride; }
+  /*! Get the underlying data vector. As the data may be modified through the
+   * returned pointer, this counts as a modification of the Matrix.*/
+  std::vector<Scalar> *get_data() {
+    this->version++;
+    return &(this->data);
+  }
+  /*! Get the underlying data vector (read only)*/
+  std::vector<Scalar> const *get_data() const { return &(this->data); }
   /*! Get the size of the matrix (the total number of elements).*/
-  size_t get_size() { return this->matrix_size; }
+  size_t get_size() const { return this->matrix_size; }
   /*! Get the shape of the matrix (nrows, ncols). */
-  std::pair<size_t, size_t> get_shape() {
+  std::pair<size_t, size_t> get_shape() const {
     return std::pair<size_t, size_t>{this->nrows, this->ncols};
   }
+  /*! Get the mutation counter of the Matrix.
+   *
+   * The counter is incremented by every non-const access to the elements
+   * (operator(), get_data, and all of the modifying operations), so an
+   * unchanged counter guarantees unchanged contents, as long as pointers
+   * returned by earlier accesses are not written through afterwards.
+   * */
+  size_t get_version() const { return this->version; }
+  /*! Whether the elements are stored in row major order with no gaps, i.e.
+   * element (row, col) is at data index row * ncols + col.*/
+  bool is_contiguous() const {
+    return (this->col_stride == 1 || this->ncols <= 1) &&
+           (this->row_stride == this->ncols || this->nrows <= 1) &&
+           this->data.size() >= this->matrix_size;
+  }
   // SECTION: Elementary operations
   /*! Access an element of the matrix by position.
    *
@@ -121,6 +155,24 @@ public:
    * @return Pointer to element of the matrix at position (row,col)
    * */
   Scalar *operator()(size_t row, size_t col) {
+    if (row >= this->nrows || col >= this->ncols) {
+      throw std::range_error("Invalid index");
+    }
+    size_t data_position = row * this->row_stride + col * this->col_stride;
+    if (data_position >= this->matrix_size ||
+        data_position >= this->data.size()) {
+      throw std::range_error("Tried accessing element beyond Matrix data");
+    }
+    this->version++;
+    return &(this->data[data_position]);
+  }
+  /*! Access an element of the matrix by position (read only).
+   *
+   * @param row Row of the element to be accessed
+   * @param col Column of the element to be accessed
+   * @return Pointer to element of the matrix at position (row,col)
+   * */
+  Scalar const *operator()(size_t row, size_t col) const {
     if (row >= this->nrows || col >= this->ncols) {
       throw std::range_error("Invalid index");
     }
@@ -326,7 +378,7 @@ public:
     for (size_t row = 0; row < this->nrows; row++) {
       for (size_t col = 0; col < this->ncols; col++) {
         *result_matrix(row, col) =
-            to_apply(*(*this)(row, col), *(*this)(row, col));
+            to_apply(*(*this)(row, col), *other(row, col));
       }
     }
     return result_matrix;
@@ -347,7 +399,7 @@ public:
     }
     for (size_t row = 0; row < this->nrows; row++) {
       for (size_t col = 0; col < this->ncols; col++) {
-        *(*this)(row, col) = to_apply(*(*this)(row, col), *(*this)(row, col));
+        *(*this)(row, col) = to_apply(*(*this)(row, col), *other(row, col));
       }
     }
   }
@@ -521,5 +573,111 @@ public:
     }
     return all_truthy;
   }
+  // SECTION: Hashing
+  /*! Compute a hash of the shape and contents of the Matrix.
+   *
+   * Elements are hashed by their representation in row major order, so the
+   * hash does not depend on the memory layout, and matrices for which
+   * equals returns true have equal hashes. The hash is cached and only
+   * recomputed when get_version has changed since the last call; the
+   * cache is synchronized, so concurrent calls on a const Matrix are
+   * safe. Large matrices are hashed in parallel, with a result
+   * independent of the number of threads.
+   *
+   * @return The (non-cryptographic) hash value
+   * */
+  uint64_t content_hash() const
+    requires std::is_trivially_copyable_v<Scalar>
+  {
+    uint64_t hash;
+    if (this->hash_cache.get(this->version, hash)) {
+      return hash;
+    }
+    uint64_t shape[2] = {static_cast<uint64_t>(this->nrows),
+                         static_cast<uint64_t>(this->ncols)};
+    uint64_t seed = xxhash64(shape, sizeof(shape));
+    if (this->is_contiguous()) {
+      hash = parallel_hash(this->data.data(),
+                           this->matrix_size * sizeof(Scalar), seed);
+    } else {
+      std::vector<Scalar> row_major(this->matrix_size);
+      for (size_t row = 0; row < this->nrows; row++) {
+        for (size_t col = 0; col < this->ncols; col++) {
+          row_major[row * this->ncols + col] = *(*this)(row, col);
+        }
+      }
+      hash = parallel_hash(row_major.data(),
+                           this->matrix_size * sizeof(Scalar), seed);
+    }
+    this->hash_cache.set(this->version, hash);
+    return hash;
+  }
 }; // namespace template<typenameScalar>class TeensyMatrix
+
+/*! Check whether two matrices have the same shape and identical elements.
+ *
+ * Unlike operator==, no intermediate Matrix is allocated and the comparison
+ * stops at the first difference. For trivially copyable Scalar types the
+ * elements are compared by representation (so NaN equals an identical NaN,
+ * and 0.0 differs from -0.0), which is consistent with content_hash. When
+ * both matrices are stored the same way without gaps, the comparison is a
+ * single (chunked, parallel) memcmp over the data.
+ *
+ * @param lhs First Matrix to compare
+ * @param rhs Second Matrix to compare
+ * @return True if both matrices hold the same values
+ * */
+template <typename Scalar>
+bool equals(Matrix<Scalar> const &lhs, Matrix<Scalar> const &rhs) {
+  if (lhs.get_nrows() != rhs.get_nrows() ||
+      lhs.get_ncols() != rhs.get_ncols()) {
+    return false;
+  }
+  size_t nrows = lhs.get_nrows();
+  size_t ncols = lhs.get_ncols();
+  size_t size = nrows * ncols;
+  if (&lhs == &rhs || size == 0) {
+    return true;
+  }
+  if constexpr (std::is_trivially_copyable_v<Scalar>) {
+    bool same_layout = lhs.get_row_stride() == rhs.get_row_stride() &&
+                       lhs.get_col_stride() == rhs.get_col_stride();
+    // Layouts filling data[0, size) exactly: row major and column major
+    bool dense = (lhs.get_row_stride() == ncols && lhs.get_col_stride() == 1) ||
+                 (lhs.get_row_stride() == 1 && lhs.get_col_stride() == nrows);
+    if (same_layout && dense && lhs.get_data()->size() >= size &&
+        rhs.get_data()->size() >= size) {
+      unsigned char const *lhs_bytes =
+          reinterpret_cast<unsigned char const *>(lhs.get_data()->data());
+      unsigned char const *rhs_bytes =
+          reinterpret_cast<unsigned char const *>(rhs.get_data()->data());
+      size_t n_bytes = size * sizeof(Scalar);
+      std::atomic<bool> mismatch{false};
+      parallel_for(n_bytes, hash_chunk_bytes, [&](size_t begin, size_t end) {
+        if (mismatch.load(std::memory_order_relaxed)) {
+          return;
+        }
+        if (std::memcmp(lhs_bytes + begin, rhs_bytes + begin, end - begin) !=
+            0) {
+          mismatch.store(true, std::memory_order_relaxed);
+        }
+      });
+      return !mismatch.load();
+    }
+  }
+  for (size_t row = 0; row < nrows; row++) {
+    for (size_t col = 0; col < ncols; col++) {
+      if constexpr (std::is_trivially_copyable_v<Scalar>) {
+        if (std::memcmp(lhs(row, col), rhs(row, col), sizeof(Scalar)) != 0) {
+          return false;
+        }
+      } else {
+        if (!(*lhs(row, col) == *rhs(row, col))) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
 } // namespace teensymat
@@ -0,0 +1,227 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace teensymat {
+/*! A small persistent pool of worker threads.
+ *
+ * Work is submitted as a number of independent tasks identified by their
+ * index, which are handed out to the workers (and the calling thread) until
+ * all have run. Calls made from inside a task, or while another thread is
+ * using the pool, run serially on the calling thread instead of blocking.
+ * */
+class ThreadPool {
+private:
+  /*! The worker threads (the calling thread also executes tasks)*/
+  std::vector<std::thread> workers;
+  /*! Guards the job description and the generation counter*/
+  std::mutex state_mutex;
+  /*! Serializes submissions to the pool*/
+  std::mutex submit_mutex;
+  /*! Signalled when a new job is available*/
+  std::condition_variable work_ready;
+  /*! Signalled when the last worker finished the current job*/
+  std::condition_variable work_done;
+  /*! The task of the current job*/
+  std::function<void(size_t)> const *task;
+  /*! Number of tasks in the current job*/
+  size_t n_tasks;
+  /*! Index of the next task to be handed out*/
+  std::atomic<size_t> next_task;
+  /*! Number of workers which have not yet finished the current job*/
+  size_t active_workers;
+  /*! Incremented for every job, used by the workers to detect new work*/
+  size_t generation;
+  /*! Set when the pool is being torn down*/
+  bool stopping;
+  /*! First exception thrown by a task of the current job*/
+  std::exception_ptr error;
+
+  /*! Flag marking threads that are currently executing a task*/
+  static bool &inside_task() {
+    thread_local bool inside = false;
+    return inside;
+  }
+  /*! Execute tasks of the current job until none are left*/
+  void drain() {
+    inside_task() = true;
+    for (size_t index = this->next_task.fetch_add(1); index < this->n_tasks;
+         index = this->next_task.fetch_add(1)) {
+      try {
+        (*this->task)(index);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(this->state_mutex);
+        if (!this->error) {
+          this->error = std::current_exception();
+        }
+      }
+    }
+    inside_task() = false;
+  }
+  /*! Main loop of a worker thread, started while seen_generation was the
+   * current generation*/
+  void worker_loop(size_t seen_generation) {
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(this->state_mutex);
+        this->work_ready.wait(lock, [&] {
+          return this->stopping || this->generation != seen_generation;
+        });
+        if (this->stopping) {
+          return;
+        }
+        seen_generation = this->generation;
+      }
+      this->drain();
+      {
+        std::lock_guard<std::mutex> lock(this->state_mutex);
+        this->active_workers--;
+        if (this->active_workers == 0) {
+          this->work_done.notify_one();
+        }
+      }
+    }
+  }
+  /*! Join all the worker threads*/
+  void stop_workers() {
+    {
+      std::lock_guard<std::mutex> lock(this->state_mutex);
+      this->stopping = true;
+    }
+    this->work_ready.notify_all();
+    for (std::thread &worker : this->workers) {
+      worker.join();
+    }
+    this->workers.clear();
+    this->stopping = false;
+  }
+  /*! Start worker threads so that num_threads threads (including the caller)
+   * execute tasks*/
+  void start_workers(size_t num_threads) {
+    size_t current_generation = this->generation;
+    for (size_t i = 1; i < num_threads; i++) {
+      this->workers.emplace_back(
+          [this, current_generation] { this->worker_loop(current_generation); });
+    }
+  }
+
+public:
+  // SECTION: Constructors
+  /*! Construct a pool in which num_threads threads execute tasks.
+   *
+   * @param num_threads Total number of threads executing tasks, including the
+   * thread submitting the work. A value of 0 uses the hardware concurrency.
+   * */
+  explicit ThreadPool(size_t num_threads = 0)
+      : task(nullptr), n_tasks(0), next_task(0), active_workers(0),
+        generation(0), stopping(false) {
+    this->set_num_threads(num_threads);
+  }
+  ThreadPool(ThreadPool const &) = delete;
+  ThreadPool &operator=(ThreadPool const &) = delete;
+  ~ThreadPool() { this->stop_workers(); }
+
+  /*! Get the pool shared by all of the library's parallel kernels*/
+  static ThreadPool &global() {
+    static ThreadPool pool{};
+    return pool;
+  }
+
+  // SECTION: Getters and setters
+  /*! Get the number of threads executing tasks (including the caller)*/
+  size_t get_num_threads() const { return this->workers.size() + 1; }
+  /*! Change the number of threads executing tasks.
+   *
+   * @param num_threads Total number of threads executing tasks, including the
+   * thread submitting the work. A value of 0 uses the hardware concurrency.
+   * */
+  void set_num_threads(size_t num_threads) {
+    if (num_threads == 0) {
+      num_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    std::lock_guard<std::mutex> submit_lock(this->submit_mutex);
+    this->stop_workers();
+    this->start_workers(num_threads);
+  }
+
+  // SECTION: Execution
+  /*! Run task(i) for every i in [0, n_tasks), and wait for completion.
+   *
+   * The order in which tasks are executed is unspecified. If any task throws,
+   * the first exception is rethrown once all tasks have finished.
+   *
+   * @param n_tasks Number of tasks to run
+   * @param task Function called with the index of each task
+   * */
+  void run(size_t n_tasks, std::function<void(size_t)> const &task) {
+    if (n_tasks == 0) {
+      return;
+    }
+    std::unique_lock<std::mutex> submit_lock(this->submit_mutex,
+                                             std::defer_lock);
+    if (n_tasks == 1 || this->workers.empty() || inside_task() ||
+        !submit_lock.try_lock()) {
+      for (size_t index = 0; index < n_tasks; index++) {
+        task(index);
+      }
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(this->state_mutex);
+      this->task = &task;
+      this->n_tasks = n_tasks;
+      this->next_task.store(0);
+      this->active_workers = this->workers.size();
+      this->error = nullptr;
+      this->generation++;
+    }
+    this->work_ready.notify_all();
+    this->drain();
+    std::exception_ptr job_error;
+    {
+      std::unique_lock<std::mutex> lock(this->state_mutex);
+      this->work_done.wait(lock, [&] { return this->active_workers == 0; });
+      this->task = nullptr;
+      job_error = this->error;
+      this->error = nullptr;
+    }
+    if (job_error) {
+      std::rethrow_exception(job_error);
+    }
+  }
+};
+
+/*! Split the range [0, n) into blocks of grain elements and call
+ * func(begin, end) for each block, using the global ThreadPool.
+ *
+ * The decomposition only depends on n and grain, never on the number of
+ * threads, so kernels which reduce per block are reproducible.
+ *
+ * @param n Length of the range
+ * @param grain Number of elements per block (the last block may be shorter)
+ * @param func Function accepting the (begin, end) bounds of a block
+ * */
+template <typename Func> void parallel_for(size_t n, size_t grain, Func &&func) {
+  if (n == 0) {
+    return;
+  }
+  grain = std::max<size_t>(grain, 1);
+  size_t n_blocks = (n + grain - 1) / grain;
+  if (n_blocks == 1) {
+    func(size_t{0}, n);
+    return;
+  }
+  ThreadPool::global().run(n_blocks, [&](size_t block) {
+    size_t begin = block * grain;
+    func(begin, std::min(n, begin + grain));
+  });
+}
+} // namespace teensymat
@@ -0,0 +1,289 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numbers>
+#include <type_traits>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+#include "TeensyOpt/TeensyMat/parallel.hpp"
+
+namespace teensymat {
+namespace random_detail {
+constexpr uint32_t philox_m0 = 0xD2511F53U;
+constexpr uint32_t philox_m1 = 0xCD9E8D57U;
+constexpr uint32_t philox_w0 = 0x9E3779B9U;
+constexpr uint32_t philox_w1 = 0xBB67AE85U;
+/*! Number of counter blocks generated together, the rounds are written over
+ * arrays of this many lanes so that they can be vectorized*/
+constexpr size_t batch_blocks = 16;
+/*! Number of counter blocks generated by each task of a parallel fill*/
+constexpr size_t blocks_per_task = 8192;
+
+/*! Run the ten Philox4x32 rounds on a batch of counters in place
+ * (structure of arrays layout, one array per counter word)*/
+inline void philox_batch(uint32_t *c0, uint32_t *c1, uint32_t *c2,
+                         uint32_t *c3, uint32_t key0, uint32_t key1) {
+  for (int round = 0; round < 10; round++) {
+    for (size_t lane = 0; lane < batch_blocks; lane++) {
+      uint64_t product0 = static_cast<uint64_t>(philox_m0) * c0[lane];
+      uint64_t product1 = static_cast<uint64_t>(philox_m1) * c2[lane];
+      uint32_t new_c0 = static_cast<uint32_t>(product1 >> 32) ^ c1[lane] ^ key0;
+      uint32_t new_c2 = static_cast<uint32_t>(product0 >> 32) ^ c3[lane] ^ key1;
+      c1[lane] = static_cast<uint32_t>(product1);
+      c3[lane] = static_cast<uint32_t>(product0);
+      c0[lane] = new_c0;
+      c2[lane] = new_c2;
+    }
+    key0 += philox_w0;
+    key1 += philox_w1;
+  }
+}
+/*! Uniform double in [0, 1) from 64 random bits*/
+inline double to_unit_closed_open(uint32_t low, uint32_t high, double) {
+  uint64_t bits = (static_cast<uint64_t>(high) << 32) | low;
+  return static_cast<double>(bits >> 11) * 0x1.0p-53;
+}
+/*! Uniform double in (0, 1] from 64 random bits*/
+inline double to_unit_open_closed(uint32_t low, uint32_t high, double) {
+  uint64_t bits = (static_cast<uint64_t>(high) << 32) | low;
+  return static_cast<double>((bits >> 11) + 1) * 0x1.0p-53;
+}
+/*! Uniform float in [0, 1) from 32 random bits*/
+inline float to_unit_closed_open(uint32_t bits, float) {
+  return static_cast<float>(bits >> 8) * 0x1.0p-24f;
+}
+/*! Uniform float in (0, 1] from 32 random bits*/
+inline float to_unit_open_closed(uint32_t bits, float) {
+  return static_cast<float>((bits >> 8) + 1) * 0x1.0p-24f;
+}
+} // namespace random_detail
+
+/*! Counter based random number generator (Philox4x32-10).
+ *
+ * Every block of random bits is a pure function of the seed, the stream and
+ * the block index, so Matrix fills can be split across threads (or across
+ * processes, using set_position/skip_ahead) and still give exactly the same
+ * values as a serial fill. Each fill starts at a fresh block and advances
+ * the position past the blocks it used.
+ * */
+class Philox {
+private:
+  /*! The key derived from the seed*/
+  uint32_t key[2];
+  /*! Upper half of the counter, selects an independent stream*/
+  uint64_t stream;
+  /*! Index of the next block of the stream that will be used*/
+  uint64_t position;
+
+  /*! Generate the blocks [first, first + batch_blocks) into the lanes of
+   * words*/
+  void generate_batch(uint64_t first, uint32_t (&words)[4][random_detail::
+                                                             batch_blocks]) const {
+    for (size_t lane = 0; lane < random_detail::batch_blocks; lane++) {
+      uint64_t index = first + lane;
+      words[0][lane] = static_cast<uint32_t>(index);
+      words[1][lane] = static_cast<uint32_t>(index >> 32);
+      words[2][lane] = static_cast<uint32_t>(this->stream);
+      words[3][lane] = static_cast<uint32_t>(this->stream >> 32);
+    }
+    random_detail::philox_batch(words[0], words[1], words[2], words[3],
+                                this->key[0], this->key[1]);
+  }
+  /*! Fill size values in row major order, where transform turns the words
+   * of one block into values_per_block(Scalar) values*/
+  template <typename Scalar, typename Transform>
+  void fill(Matrix<Scalar> &matrix, Transform transform) {
+    constexpr size_t per_block = values_per_block<Scalar>();
+    size_t nrows = matrix.get_nrows();
+    size_t ncols = matrix.get_ncols();
+    size_t size = nrows * ncols;
+    size_t row_stride = matrix.get_row_stride();
+    size_t col_stride = matrix.get_col_stride();
+    bool contiguous = matrix.is_contiguous();
+    Scalar *data = matrix.get_data()->data();
+    uint64_t n_blocks = (size + per_block - 1) / per_block;
+    uint64_t start = this->position;
+    size_t n_batches =
+        (n_blocks + random_detail::batch_blocks - 1) / random_detail::batch_blocks;
+    size_t grain = random_detail::blocks_per_task / random_detail::batch_blocks;
+    parallel_for(n_batches, grain, [&](size_t begin, size_t end) {
+      uint32_t words[4][random_detail::batch_blocks];
+      Scalar values[random_detail::batch_blocks * per_block];
+      for (size_t batch = begin; batch < end; batch++) {
+        uint64_t first_block = batch * random_detail::batch_blocks;
+        this->generate_batch(start + first_block, words);
+        for (size_t lane = 0; lane < random_detail::batch_blocks; lane++) {
+          transform(words[0][lane], words[1][lane], words[2][lane],
+                    words[3][lane], &values[lane * per_block]);
+        }
+        size_t first_element = first_block * per_block;
+        size_t last_element =
+            std::min(size, first_element + random_detail::batch_blocks * per_block);
+        for (size_t element = first_element; element < last_element;
+             element++) {
+          Scalar value = values[element - first_element];
+          if (contiguous) {
+            data[element] = value;
+          } else {
+            size_t row = element / ncols;
+            size_t col = element % ncols;
+            data[row * row_stride + col * col_stride] = value;
+          }
+        }
+      }
+    });
+    this->position += n_blocks;
+  }
+
+public:
+  // SECTION: Constructors
+  /*! Construct a generator.
+   *
+   * @param seed Seed of the generator
+   * @param stream Index of an independent stream of random numbers for the
+   * same seed (for instance one per worker)
+   * */
+  explicit Philox(uint64_t seed, uint64_t stream = 0)
+      : key{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)},
+        stream(stream), position(0) {}
+
+  // SECTION: Getters and setters
+  /*! Get the index of the next block which will be used*/
+  uint64_t get_position() const { return this->position; }
+  /*! Set the index of the next block which will be used.
+   *
+   * @param position The index of the block
+   * */
+  void set_position(uint64_t position) { this->position = position; }
+  /*! Skip blocks of the stream without generating them (O(1)).
+   *
+   * @param n_blocks Number of blocks to skip
+   * */
+  void skip_ahead(uint64_t n_blocks) { this->position += n_blocks; }
+  /*! Number of Scalar values produced from each block of random bits*/
+  template <typename Scalar> static constexpr size_t values_per_block() {
+    static_assert(std::is_same_v<Scalar, float> ||
+                      std::is_same_v<Scalar, double>,
+                  "Random fills are only available for float and double");
+    return std::is_same_v<Scalar, float> ? 4 : 2;
+  }
+  /*! Number of blocks consumed by filling a Matrix with size elements, for
+   * computing the positions of shards*/
+  template <typename Scalar> static constexpr uint64_t blocks_for(size_t size) {
+    return (size + values_per_block<Scalar>() - 1) / values_per_block<Scalar>();
+  }
+
+  // SECTION: Generation
+  /*! Get the random bits of one block.
+   *
+   * @param index Index of the block in the stream
+   * @return The four 32 bit words of the block
+   * */
+  std::array<uint32_t, 4> block(uint64_t index) const {
+    uint32_t words[4][random_detail::batch_blocks];
+    this->generate_batch(index, words);
+    return {words[0][0], words[1][0], words[2][0], words[3][0]};
+  }
+  /*! Fill a Matrix with values uniformly distributed in [low, high).
+   *
+   * low + (high - low) u can round up to high even though u < 1, so the
+   * values are clamped to the largest Scalar below high.
+   *
+   * @param matrix The Matrix to fill
+   * @param low Lower bound of the values
+   * @param high Upper bound of the values
+   * */
+  template <typename Scalar>
+  void fill_uniform(Matrix<Scalar> &matrix, Scalar low = 0, Scalar high = 1) {
+    Scalar width = high - low;
+    Scalar top = std::nextafter(high, low);
+    this->fill(matrix, [low, width, top](uint32_t w0, uint32_t w1,
+                                         uint32_t w2, uint32_t w3,
+                                         Scalar *out) {
+      using random_detail::to_unit_closed_open;
+      if constexpr (std::is_same_v<Scalar, float>) {
+        out[0] = std::min(low + width * to_unit_closed_open(w0, Scalar{}), top);
+        out[1] = std::min(low + width * to_unit_closed_open(w1, Scalar{}), top);
+        out[2] = std::min(low + width * to_unit_closed_open(w2, Scalar{}), top);
+        out[3] = std::min(low + width * to_unit_closed_open(w3, Scalar{}), top);
+      } else {
+        out[0] =
+            std::min(low + width * to_unit_closed_open(w0, w1, Scalar{}), top);
+        out[1] =
+            std::min(low + width * to_unit_closed_open(w2, w3, Scalar{}), top);
+      }
+    });
+  }
+  /*! Fill a Matrix with normally distributed values (Box-Muller transform).
+   *
+   * @param matrix The Matrix to fill
+   * @param mean Mean of the values
+   * @param stddev Standard deviation of the values
+   * */
+  template <typename Scalar>
+  void fill_normal(Matrix<Scalar> &matrix, Scalar mean = 0,
+                   Scalar stddev = 1) {
+    this->fill(matrix, [mean, stddev](uint32_t w0, uint32_t w1, uint32_t w2,
+                                      uint32_t w3, Scalar *out) {
+      using random_detail::to_unit_closed_open;
+      using random_detail::to_unit_open_closed;
+      constexpr Scalar two_pi = 2 * std::numbers::pi_v<Scalar>;
+      if constexpr (std::is_same_v<Scalar, float>) {
+        Scalar radius_a =
+            stddev * std::sqrt(-2 * std::log(to_unit_open_closed(w0, Scalar{})));
+        Scalar angle_a = two_pi * to_unit_closed_open(w1, Scalar{});
+        Scalar radius_b =
+            stddev * std::sqrt(-2 * std::log(to_unit_open_closed(w2, Scalar{})));
+        Scalar angle_b = two_pi * to_unit_closed_open(w3, Scalar{});
+        out[0] = mean + radius_a * std::cos(angle_a);
+        out[1] = mean + radius_a * std::sin(angle_a);
+        out[2] = mean + radius_b * std::cos(angle_b);
+        out[3] = mean + radius_b * std::sin(angle_b);
+      } else {
+        Scalar radius = stddev * std::sqrt(-2 * std::log(to_unit_open_closed(
+                                                     w0, w1, Scalar{})));
+        Scalar angle = two_pi * to_unit_closed_open(w2, w3, Scalar{});
+        out[0] = mean + radius * std::cos(angle);
+        out[1] = mean + radius * std::sin(angle);
+      }
+    });
+  }
+};
+
+/*! Create a Matrix of values uniformly distributed in [low, high).
+ *
+ * @param nrows Number of rows the new Matrix will have
+ * @param ncols Number of columns the new Matrix will have
+ * @param seed Seed of the Philox generator
+ * @param low Lower bound of the values
+ * @param high Upper bound of the values
+ * */
+template <typename Scalar>
+Matrix<Scalar> random_uniform(size_t nrows, size_t ncols, uint64_t seed,
+                              Scalar low = 0, Scalar high = 1) {
+  Matrix<Scalar> result{nrows, ncols};
+  Philox{seed}.fill_uniform(result, low, high);
+  return result;
+}
+/*! Create a Matrix of normally distributed values.
+ *
+ * @param nrows Number of rows the new Matrix will have
+ * @param ncols Number of columns the new Matrix will have
+ * @param seed Seed of the Philox generator
+ * @param mean Mean of the values
+ * @param stddev Standard deviation of the values
+ * */
+template <typename Scalar>
+Matrix<Scalar> random_normal(size_t nrows, size_t ncols, uint64_t seed,
+                             Scalar mean = 0, Scalar stddev = 1) {
+  Matrix<Scalar> result{nrows, ncols};
+  Philox{seed}.fill_normal(result, mean, stddev);
+  return result;
+}
+} // namespace teensymat
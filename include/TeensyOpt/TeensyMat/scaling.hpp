@@ -0,0 +1,435 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+#include "TeensyOpt/TeensyMat/parallel.hpp"
+#include "TeensyOpt/TeensyMat/sparse_core.hpp"
+
+namespace teensymat {
+/*! Row and column scaling factors, representing the scaled Matrix
+ * diag(row_scale) * A * diag(col_scale).
+ *
+ * For a problem A * x = b with variables x, the scaled problem has variables
+ * x_scaled = x / col_scale and right hand side row_scale * b. The helper
+ * functions convert vectors between the original and scaled spaces.
+ * */
+template <typename Scalar> struct Scaling {
+  /*! Factor applied to each row*/
+  std::vector<Scalar> row_scale;
+  /*! Factor applied to each column*/
+  std::vector<Scalar> col_scale;
+
+  /*! Map primal values (or variable bounds) into the scaled space,
+   * x_scaled = x / col_scale*/
+  void scale_primal(std::vector<Scalar> &x) const {
+    for (size_t j = 0; j < x.size(); j++) {
+      x[j] /= this->col_scale[j];
+    }
+  }
+  /*! Map a scaled primal solution back, x = col_scale * x_scaled*/
+  void unscale_primal(std::vector<Scalar> &x) const {
+    for (size_t j = 0; j < x.size(); j++) {
+      x[j] *= this->col_scale[j];
+    }
+  }
+  /*! Map row values (right hand sides, row bounds) into the scaled space,
+   * b_scaled = row_scale * b*/
+  void scale_rows(std::vector<Scalar> &b) const {
+    for (size_t i = 0; i < b.size(); i++) {
+      b[i] *= this->row_scale[i];
+    }
+  }
+  /*! Map column values (objective coefficients) into the scaled space,
+   * c_scaled = col_scale * c*/
+  void scale_cols(std::vector<Scalar> &c) const {
+    for (size_t j = 0; j < c.size(); j++) {
+      c[j] *= this->col_scale[j];
+    }
+  }
+  /*! Map scaled dual values of the rows back, y = row_scale * y_scaled*/
+  void unscale_dual(std::vector<Scalar> &y) const {
+    for (size_t i = 0; i < y.size(); i++) {
+      y[i] *= this->row_scale[i];
+    }
+  }
+  /*! Map scaled reduced costs back, z = z_scaled / col_scale*/
+  void unscale_reduced_costs(std::vector<Scalar> &z) const {
+    for (size_t j = 0; j < z.size(); j++) {
+      z[j] /= this->col_scale[j];
+    }
+  }
+};
+
+namespace scaling_detail {
+/*! Largest and smallest nonzero absolute values of the rows and columns of
+ * the implicitly scaled Matrix diag(row_scale) * A * diag(col_scale)*/
+template <typename Scalar> struct Extrema {
+  std::vector<Scalar> row_max;
+  std::vector<Scalar> row_min;
+  std::vector<Scalar> col_max;
+  std::vector<Scalar> col_min;
+
+  Extrema(size_t nrows, size_t ncols)
+      : row_max(nrows, 0),
+        row_min(nrows, std::numeric_limits<Scalar>::infinity()),
+        col_max(ncols, 0),
+        col_min(ncols, std::numeric_limits<Scalar>::infinity()) {}
+};
+/*! Largest number of blocks the passes are split into*/
+constexpr size_t max_blocks = 64;
+/*! Grain of a pass over n rows or columns. Each block keeps a partial copy
+ * of the extrema along the other dimension, so there are no more blocks
+ * than threads (the extrema reduce in any order, so the result does not
+ * depend on the split)*/
+inline size_t block_grain(size_t n) {
+  size_t blocks = std::min(max_blocks, ThreadPool::global().get_num_threads());
+  return std::max<size_t>(1, (n + blocks - 1) / blocks);
+}
+
+/*! One parallel pass over a dense Matrix, in blocks of rows (row extrema are
+ * owned by their block, column extrema are reduced over blocks)*/
+template <typename Scalar>
+Extrema<Scalar> extrema(Matrix<Scalar> const &matrix,
+                        std::vector<Scalar> const &row_scale,
+                        std::vector<Scalar> const &col_scale) {
+  size_t nrows = matrix.get_nrows();
+  size_t ncols = matrix.get_ncols();
+  Extrema<Scalar> result{nrows, ncols};
+  size_t grain = block_grain(nrows);
+  size_t n_blocks = (nrows + grain - 1) / grain;
+  std::vector<Extrema<Scalar>> partial(n_blocks, Extrema<Scalar>{0, ncols});
+  Scalar const *data = matrix.get_data()->data();
+  size_t row_stride = matrix.get_row_stride();
+  size_t col_stride = matrix.get_col_stride();
+  parallel_for(nrows, grain, [&](size_t begin, size_t end) {
+    Extrema<Scalar> &block = partial[begin / grain];
+    for (size_t row = begin; row < end; row++) {
+      Scalar row_max = 0;
+      Scalar row_min = std::numeric_limits<Scalar>::infinity();
+      for (size_t col = 0; col < ncols; col++) {
+        Scalar value = std::abs(data[row * row_stride + col * col_stride]) *
+                       row_scale[row] * col_scale[col];
+        if (value == Scalar{0}) {
+          continue;
+        }
+        row_max = std::max(row_max, value);
+        row_min = std::min(row_min, value);
+        block.col_max[col] = std::max(block.col_max[col], value);
+        block.col_min[col] = std::min(block.col_min[col], value);
+      }
+      result.row_max[row] = row_max;
+      result.row_min[row] = row_min;
+    }
+  });
+  for (Extrema<Scalar> const &block : partial) {
+    for (size_t col = 0; col < ncols; col++) {
+      result.col_max[col] = std::max(result.col_max[col], block.col_max[col]);
+      result.col_min[col] = std::min(result.col_min[col], block.col_min[col]);
+    }
+  }
+  return result;
+}
+/*! One parallel pass over a SparseMatrix, in blocks of columns (column
+ * extrema are owned by their block, row extrema are reduced over blocks)*/
+template <typename Scalar>
+Extrema<Scalar> extrema(SparseMatrix<Scalar> const &matrix,
+                        std::vector<Scalar> const &row_scale,
+                        std::vector<Scalar> const &col_scale) {
+  size_t nrows = matrix.get_nrows();
+  size_t ncols = matrix.get_ncols();
+  Extrema<Scalar> result{nrows, ncols};
+  size_t grain = block_grain(ncols);
+  size_t n_blocks = (ncols + grain - 1) / grain;
+  std::vector<Extrema<Scalar>> partial(n_blocks, Extrema<Scalar>{nrows, 0});
+  std::vector<size_t> const &col_ptr = matrix.get_col_ptr();
+  std::vector<size_t> const &row_idx = matrix.get_row_idx();
+  std::vector<Scalar> const &values = *matrix.get_values();
+  parallel_for(ncols, grain, [&](size_t begin, size_t end) {
+    Extrema<Scalar> &block = partial[begin / grain];
+    for (size_t col = begin; col < end; col++) {
+      Scalar col_max = 0;
+      Scalar col_min = std::numeric_limits<Scalar>::infinity();
+      for (size_t k = col_ptr[col]; k < col_ptr[col + 1]; k++) {
+        size_t row = row_idx[k];
+        Scalar value = std::abs(values[k]) * row_scale[row] * col_scale[col];
+        if (value == Scalar{0}) {
+          continue;
+        }
+        col_max = std::max(col_max, value);
+        col_min = std::min(col_min, value);
+        block.row_max[row] = std::max(block.row_max[row], value);
+        block.row_min[row] = std::min(block.row_min[row], value);
+      }
+      result.col_max[col] = col_max;
+      result.col_min[col] = col_min;
+    }
+  });
+  for (Extrema<Scalar> const &block : partial) {
+    for (size_t row = 0; row < nrows; row++) {
+      result.row_max[row] = std::max(result.row_max[row], block.row_max[row]);
+      result.row_min[row] = std::min(result.row_min[row], block.row_min[row]);
+    }
+  }
+  return result;
+}
+/*! Round every factor to the nearest power of two, so that applying the
+ * scaling introduces no rounding error*/
+template <typename Scalar> void round_to_power_of_two(std::vector<Scalar> &scales) {
+  for (Scalar &scale : scales) {
+    int exponent = static_cast<int>(std::lround(std::log2(scale)));
+    scale = std::ldexp(Scalar{1}, exponent);
+  }
+}
+
+template <typename MatrixType, typename Scalar>
+Scaling<Scalar> ruiz(MatrixType const &matrix, size_t max_iterations,
+                     Scalar tolerance, bool power_of_two) {
+  Scaling<Scalar> scaling{std::vector<Scalar>(matrix.get_nrows(), 1),
+                          std::vector<Scalar>(matrix.get_ncols(), 1)};
+  for (size_t iteration = 0; iteration < max_iterations; iteration++) {
+    Extrema<Scalar> norms =
+        extrema(matrix, scaling.row_scale, scaling.col_scale);
+    Scalar deviation = 0;
+    for (size_t i = 0; i < norms.row_max.size(); i++) {
+      if (norms.row_max[i] > 0) {
+        deviation = std::max(deviation, std::abs(1 - norms.row_max[i]));
+        scaling.row_scale[i] /= std::sqrt(norms.row_max[i]);
+      }
+    }
+    for (size_t j = 0; j < norms.col_max.size(); j++) {
+      if (norms.col_max[j] > 0) {
+        deviation = std::max(deviation, std::abs(1 - norms.col_max[j]));
+        scaling.col_scale[j] /= std::sqrt(norms.col_max[j]);
+      }
+    }
+    if (deviation <= tolerance) {
+      break;
+    }
+  }
+  if (power_of_two) {
+    round_to_power_of_two(scaling.row_scale);
+    round_to_power_of_two(scaling.col_scale);
+  }
+  return scaling;
+}
+
+template <typename MatrixType, typename Scalar>
+Scaling<Scalar> geometric(MatrixType const &matrix, size_t max_iterations,
+                          Scalar tolerance, bool power_of_two) {
+  Scaling<Scalar> scaling{std::vector<Scalar>(matrix.get_nrows(), 1),
+                          std::vector<Scalar>(matrix.get_ncols(), 1)};
+  Scalar previous_spread = std::numeric_limits<Scalar>::infinity();
+  for (size_t iteration = 0; iteration < max_iterations; iteration++) {
+    Extrema<Scalar> norms =
+        extrema(matrix, scaling.row_scale, scaling.col_scale);
+    // Spread of the magnitudes, measured over the columns
+    Scalar spread = 1;
+    for (size_t j = 0; j < norms.col_max.size(); j++) {
+      if (norms.col_max[j] > 0) {
+        spread = std::max(spread, norms.col_max[j] / norms.col_min[j]);
+      }
+    }
+    if (spread > (1 - tolerance) * previous_spread) {
+      break;
+    }
+    previous_spread = spread;
+    // Rows and columns are updated together, so each takes half a step
+    for (size_t i = 0; i < norms.row_max.size(); i++) {
+      if (norms.row_max[i] > 0) {
+        scaling.row_scale[i] /=
+            std::sqrt(std::sqrt(norms.row_max[i] * norms.row_min[i]));
+      }
+    }
+    for (size_t j = 0; j < norms.col_max.size(); j++) {
+      if (norms.col_max[j] > 0) {
+        scaling.col_scale[j] /=
+            std::sqrt(std::sqrt(norms.col_max[j] * norms.col_min[j]));
+      }
+    }
+  }
+  if (power_of_two) {
+    round_to_power_of_two(scaling.row_scale);
+    round_to_power_of_two(scaling.col_scale);
+  }
+  return scaling;
+}
+} // namespace scaling_detail
+
+// SECTION: Norms
+/*! Largest absolute value in each row of a Matrix*/
+template <typename Scalar>
+std::vector<Scalar> row_norms_inf(Matrix<Scalar> const &matrix) {
+  std::vector<Scalar> ones_rows(matrix.get_nrows(), 1);
+  std::vector<Scalar> ones_cols(matrix.get_ncols(), 1);
+  return scaling_detail::extrema(matrix, ones_rows, ones_cols).row_max;
+}
+/*! Largest absolute value in each column of a Matrix*/
+template <typename Scalar>
+std::vector<Scalar> col_norms_inf(Matrix<Scalar> const &matrix) {
+  std::vector<Scalar> ones_rows(matrix.get_nrows(), 1);
+  std::vector<Scalar> ones_cols(matrix.get_ncols(), 1);
+  return scaling_detail::extrema(matrix, ones_rows, ones_cols).col_max;
+}
+/*! Largest absolute value in each row of a SparseMatrix*/
+template <typename Scalar>
+std::vector<Scalar> row_norms_inf(SparseMatrix<Scalar> const &matrix) {
+  std::vector<Scalar> ones_rows(matrix.get_nrows(), 1);
+  std::vector<Scalar> ones_cols(matrix.get_ncols(), 1);
+  return scaling_detail::extrema(matrix, ones_rows, ones_cols).row_max;
+}
+/*! Largest absolute value in each column of a SparseMatrix*/
+template <typename Scalar>
+std::vector<Scalar> col_norms_inf(SparseMatrix<Scalar> const &matrix) {
+  std::vector<Scalar> ones_rows(matrix.get_nrows(), 1);
+  std::vector<Scalar> ones_cols(matrix.get_ncols(), 1);
+  return scaling_detail::extrema(matrix, ones_rows, ones_cols).col_max;
+}
+
+// SECTION: Computing scaling factors
+/*! Compute Ruiz equilibration factors, which drive the infinity norm of
+ * every row and column of the scaled Matrix towards one.
+ *
+ * Each iteration is one parallel pass over the entries, which reads the
+ * Matrix without modifying it; use apply_scaling to scale it afterwards.
+ *
+ * @param matrix The Matrix to equilibrate
+ * @param max_iterations Maximum number of passes
+ * @param tolerance Stop once all row and column norms are within this of one
+ * @param power_of_two Round the factors to powers of two
+ * */
+template <typename Scalar>
+Scaling<Scalar> ruiz_scaling(Matrix<Scalar> const &matrix,
+                             size_t max_iterations = 20,
+                             Scalar tolerance = 1e-3,
+                             bool power_of_two = true) {
+  return scaling_detail::ruiz(matrix, max_iterations, tolerance,
+                              power_of_two);
+}
+/*! Compute Ruiz equilibration factors of a SparseMatrix (see the dense
+ * overload).*/
+template <typename Scalar>
+Scaling<Scalar> ruiz_scaling(SparseMatrix<Scalar> const &matrix,
+                             size_t max_iterations = 20,
+                             Scalar tolerance = 1e-3,
+                             bool power_of_two = true) {
+  return scaling_detail::ruiz(matrix, max_iterations, tolerance,
+                              power_of_two);
+}
+/*! Compute geometric mean scaling factors, which drive the product of the
+ * largest and smallest nonzero magnitude of every row and column towards
+ * one, reducing the spread of the magnitudes.
+ *
+ * Each iteration is one parallel pass over the entries (row and column
+ * factors are updated simultaneously with a damped step). Iterations stop
+ * when the spread improves by less than the relative tolerance.
+ *
+ * @param matrix The Matrix to scale
+ * @param max_iterations Maximum number of passes
+ * @param tolerance Minimum relative improvement of the spread per pass
+ * @param power_of_two Round the factors to powers of two
+ * */
+template <typename Scalar>
+Scaling<Scalar> geometric_scaling(Matrix<Scalar> const &matrix,
+                                  size_t max_iterations = 8,
+                                  Scalar tolerance = 0.1,
+                                  bool power_of_two = true) {
+  return scaling_detail::geometric(matrix, max_iterations, tolerance,
+                                   power_of_two);
+}
+/*! Compute geometric mean scaling factors of a SparseMatrix (see the dense
+ * overload).*/
+template <typename Scalar>
+Scaling<Scalar> geometric_scaling(SparseMatrix<Scalar> const &matrix,
+                                  size_t max_iterations = 8,
+                                  Scalar tolerance = 0.1,
+                                  bool power_of_two = true) {
+  return scaling_detail::geometric(matrix, max_iterations, tolerance,
+                                   power_of_two);
+}
+/*! Compute the diagonal preconditioner of Pock and Chambolle, with
+ * row_scale[i] = 1 / sqrt(sum_j |a_ij|^(2 - alpha)) and
+ * col_scale[j] = 1 / sqrt(sum_i |a_ij|^alpha).
+ *
+ * With these factors the scaled Matrix has operator norm at most one, which
+ * suits first order primal-dual methods. It is a single pass over the
+ * entries; empty rows and columns get a factor of one.
+ *
+ * @param matrix The SparseMatrix to scale
+ * @param alpha Exponent in [0, 2] splitting the weight between rows and
+ * columns
+ * */
+template <typename Scalar>
+Scaling<Scalar> pock_chambolle_scaling(SparseMatrix<Scalar> const &matrix,
+                                       Scalar alpha = 1) {
+  size_t nrows = matrix.get_nrows();
+  size_t ncols = matrix.get_ncols();
+  std::vector<size_t> const &col_ptr = matrix.get_col_ptr();
+  std::vector<size_t> const &row_idx = matrix.get_row_idx();
+  Scalar const *values = matrix.get_values()->data();
+  Scaling<Scalar> scaling{std::vector<Scalar>(nrows, 0),
+                          std::vector<Scalar>(ncols, 0)};
+  for (size_t col = 0; col < ncols; col++) {
+    for (size_t k = col_ptr[col]; k < col_ptr[col + 1]; k++) {
+      Scalar magnitude = std::abs(values[k]);
+      if (magnitude == Scalar{0}) {
+        continue;
+      }
+      scaling.row_scale[row_idx[k]] += std::pow(magnitude, 2 - alpha);
+      scaling.col_scale[col] += std::pow(magnitude, alpha);
+    }
+  }
+  for (std::vector<Scalar> *scales : {&scaling.row_scale, &scaling.col_scale}) {
+    for (Scalar &scale : *scales) {
+      scale = scale > Scalar{0} ? 1 / std::sqrt(scale) : Scalar{1};
+    }
+  }
+  return scaling;
+}
+
+// SECTION: Applying scaling factors
+/*! Replace a Matrix by diag(row_scale) * A * diag(col_scale).
+ *
+ * @param matrix The Matrix to scale
+ * @param scaling The factors to apply
+ * */
+template <typename Scalar>
+void apply_scaling(Matrix<Scalar> &matrix, Scaling<Scalar> const &scaling) {
+  size_t ncols = matrix.get_ncols();
+  size_t row_stride = matrix.get_row_stride();
+  size_t col_stride = matrix.get_col_stride();
+  Scalar *data = matrix.get_data()->data();
+  parallel_for(matrix.get_nrows(), 64, [&](size_t begin, size_t end) {
+    for (size_t row = begin; row < end; row++) {
+      for (size_t col = 0; col < ncols; col++) {
+        data[row * row_stride + col * col_stride] *=
+            scaling.row_scale[row] * scaling.col_scale[col];
+      }
+    }
+  });
+}
+/*! Replace a SparseMatrix by diag(row_scale) * A * diag(col_scale).
+ *
+ * @param matrix The SparseMatrix to scale
+ * @param scaling The factors to apply
+ * */
+template <typename Scalar>
+void apply_scaling(SparseMatrix<Scalar> &matrix,
+                   Scaling<Scalar> const &scaling) {
+  std::vector<size_t> const &col_ptr = matrix.get_col_ptr();
+  std::vector<size_t> const &row_idx = matrix.get_row_idx();
+  std::vector<Scalar> &values = *matrix.get_values();
+  parallel_for(matrix.get_ncols(), 256, [&](size_t begin, size_t end) {
+    for (size_t col = begin; col < end; col++) {
+      for (size_t k = col_ptr[col]; k < col_ptr[col + 1]; k++) {
+        values[k] *= scaling.row_scale[row_idx[k]] * scaling.col_scale[col];
+      }
+    }
+  });
+}
+} // namespace teensymat
@@ -0,0 +1,290 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+#include "TeensyOpt/TeensyMat/parallel.hpp"
+
+namespace teensymat {
+/*! A sparse two dimensional array in compressed sparse column (CSC) format.
+ *
+ * The nonzeros of column j are stored at positions [col_ptr[j],
+ * col_ptr[j + 1]) of row_idx and values, with strictly increasing row
+ * indices within each column.
+ * */
+template <typename Scalar> class SparseMatrix {
+private:
+  /*! The number of rows of the SparseMatrix*/
+  size_t nrows;
+  /*! The number of columns of the SparseMatrix*/
+  size_t ncols;
+  /*! Start of each column in row_idx and values (length ncols + 1)*/
+  std::vector<size_t> col_ptr;
+  /*! Row index of each stored entry*/
+  std::vector<size_t> row_idx;
+  /*! Value of each stored entry*/
+  std::vector<Scalar> values;
+
+public:
+  // SECTION: Constructors
+  /*! Construct an empty SparseMatrix with no rows or columns*/
+  SparseMatrix() : nrows(0), ncols(0), col_ptr(1, 0) {}
+  /*! Construct a SparseMatrix with no stored entries.
+   *
+   * @param nrows Number of rows the new SparseMatrix will have
+   * @param ncols Number of columns the new SparseMatrix will have
+   * */
+  SparseMatrix(size_t nrows, size_t ncols)
+      : nrows(nrows), ncols(ncols), col_ptr(ncols + 1, 0) {}
+  /*! Construct a SparseMatrix from its CSC arrays.
+   *
+   * @param nrows Number of rows the new SparseMatrix will have
+   * @param ncols Number of columns the new SparseMatrix will have
+   * @param col_ptr Start of each column in row_idx and values (length
+   * ncols + 1)
+   * @param row_idx Row index of each entry, increasing within each column
+   * @param values Value of each entry
+   * */
+  SparseMatrix(size_t nrows, size_t ncols, std::vector<size_t> col_ptr,
+               std::vector<size_t> row_idx, std::vector<Scalar> values)
+      : nrows(nrows), ncols(ncols), col_ptr(std::move(col_ptr)),
+        row_idx(std::move(row_idx)), values(std::move(values)) {
+    if (this->col_ptr.size() != ncols + 1 || this->col_ptr[0] != 0 ||
+        this->col_ptr[ncols] != this->row_idx.size() ||
+        this->row_idx.size() != this->values.size()) {
+      throw std::range_error("Inconsistent CSC arrays");
+    }
+    for (size_t col = 0; col < ncols; col++) {
+      if (this->col_ptr[col] > this->col_ptr[col + 1]) {
+        throw std::range_error("Column pointers must be nondecreasing");
+      }
+      for (size_t k = this->col_ptr[col]; k < this->col_ptr[col + 1]; k++) {
+        if (this->row_idx[k] >= nrows ||
+            (k > this->col_ptr[col] &&
+             this->row_idx[k] <= this->row_idx[k - 1])) {
+          throw std::range_error(
+              "Row indices must be in range and increasing within a column");
+        }
+      }
+    }
+  }
+  /*! Construct a SparseMatrix from (row, col, value) triplets, in any order.
+   * Entries with the same position are summed.
+   *
+   * @param nrows Number of rows the new SparseMatrix will have
+   * @param ncols Number of columns the new SparseMatrix will have
+   * @param rows Row index of each triplet
+   * @param cols Column index of each triplet
+   * @param vals Value of each triplet
+   * */
+  static SparseMatrix from_triplets(size_t nrows, size_t ncols,
+                                    std::vector<size_t> const &rows,
+                                    std::vector<size_t> const &cols,
+                                    std::vector<Scalar> const &vals) {
+    if (rows.size() != cols.size() || rows.size() != vals.size()) {
+      throw std::range_error("Triplet arrays have different lengths");
+    }
+    // Bucket by column, then sort each column by row and merge duplicates
+    std::vector<size_t> counts(ncols + 1, 0);
+    for (size_t k = 0; k < rows.size(); k++) {
+      if (rows[k] >= nrows || cols[k] >= ncols) {
+        throw std::range_error("Triplet index out of range");
+      }
+      counts[cols[k] + 1]++;
+    }
+    std::partial_sum(counts.begin(), counts.end(), counts.begin());
+    std::vector<size_t> order(rows.size());
+    std::vector<size_t> next(counts.begin(), counts.end() - 1);
+    for (size_t k = 0; k < rows.size(); k++) {
+      order[next[cols[k]]++] = k;
+    }
+    std::vector<size_t> col_ptr(ncols + 1, 0);
+    std::vector<size_t> row_idx;
+    std::vector<Scalar> values;
+    row_idx.reserve(rows.size());
+    values.reserve(rows.size());
+    for (size_t col = 0; col < ncols; col++) {
+      std::sort(order.begin() + counts[col], order.begin() + counts[col + 1],
+                [&](size_t lhs, size_t rhs) { return rows[lhs] < rows[rhs]; });
+      for (size_t k = counts[col]; k < counts[col + 1]; k++) {
+        size_t entry = order[k];
+        if (row_idx.size() > col_ptr[col] && row_idx.back() == rows[entry]) {
+          values.back() += vals[entry];
+        } else {
+          row_idx.push_back(rows[entry]);
+          values.push_back(vals[entry]);
+        }
+      }
+      col_ptr[col + 1] = row_idx.size();
+    }
+    return SparseMatrix{nrows, ncols, std::move(col_ptr), std::move(row_idx),
+                        std::move(values)};
+  }
+  /*! Construct a SparseMatrix holding the entries of a dense Matrix whose
+   * absolute value is larger than drop_tolerance.
+   *
+   * @param dense The Matrix to convert
+   * @param drop_tolerance Entries with absolute value at most this are not
+   * stored
+   * */
+  static SparseMatrix from_dense(Matrix<Scalar> const &dense,
+                                 Scalar drop_tolerance = 0) {
+    size_t nrows = dense.get_nrows();
+    size_t ncols = dense.get_ncols();
+    std::vector<size_t> col_ptr(ncols + 1, 0);
+    std::vector<size_t> row_idx;
+    std::vector<Scalar> values;
+    for (size_t col = 0; col < ncols; col++) {
+      for (size_t row = 0; row < nrows; row++) {
+        Scalar value = *dense(row, col);
+        if (value > drop_tolerance || -value > drop_tolerance) {
+          row_idx.push_back(row);
+          values.push_back(value);
+        }
+      }
+      col_ptr[col + 1] = row_idx.size();
+    }
+    return SparseMatrix{nrows, ncols, std::move(col_ptr), std::move(row_idx),
+                        std::move(values)};
+  }
+
+  // SECTION: Getters
+  /*! Get the number of rows in the SparseMatrix.*/
+  size_t get_nrows() const { return this->nrows; }
+  /*! Get the number of columns in the SparseMatrix.*/
+  size_t get_ncols() const { return this->ncols; }
+  /*! Get the number of stored entries.*/
+  size_t get_nnz() const { return this->row_idx.size(); }
+  /*! Get the column pointers (length ncols + 1).*/
+  std::vector<size_t> const &get_col_ptr() const { return this->col_ptr; }
+  /*! Get the row index of each stored entry.*/
+  std::vector<size_t> const &get_row_idx() const { return this->row_idx; }
+  /*! Get the values of the stored entries. The sparsity pattern can not be
+   * changed through this pointer, only the values.*/
+  std::vector<Scalar> *get_values() { return &(this->values); }
+  /*! Get the values of the stored entries (read only).*/
+  std::vector<Scalar> const *get_values() const { return &(this->values); }
+  /*! Get the value at a position (zero if no entry is stored there).
+   *
+   * @param row Row of the element
+   * @param col Column of the element
+   * */
+  Scalar coeff(size_t row, size_t col) const {
+    if (row >= this->nrows || col >= this->ncols) {
+      throw std::range_error("Invalid index");
+    }
+    auto begin = this->row_idx.begin() + this->col_ptr[col];
+    auto end = this->row_idx.begin() + this->col_ptr[col + 1];
+    auto found = std::lower_bound(begin, end, row);
+    if (found == end || *found != row) {
+      return 0;
+    }
+    return this->values[found - this->row_idx.begin()];
+  }
+
+  // SECTION: Conversions
+  /*! Return a dense copy of the SparseMatrix*/
+  Matrix<Scalar> to_dense() const {
+    Matrix<Scalar> result{this->nrows, this->ncols};
+    Scalar *out = result.get_data()->data();
+    for (size_t col = 0; col < this->ncols; col++) {
+      for (size_t k = this->col_ptr[col]; k < this->col_ptr[col + 1]; k++) {
+        out[this->row_idx[k] * this->ncols + col] = this->values[k];
+      }
+    }
+    return result;
+  }
+  /*! Return the transpose as a new SparseMatrix (equivalently, the CSR form
+   * of this one)*/
+  SparseMatrix transpose() const {
+    std::vector<size_t> t_col_ptr(this->nrows + 1, 0);
+    for (size_t row : this->row_idx) {
+      t_col_ptr[row + 1]++;
+    }
+    std::partial_sum(t_col_ptr.begin(), t_col_ptr.end(), t_col_ptr.begin());
+    std::vector<size_t> next(t_col_ptr.begin(), t_col_ptr.end() - 1);
+    std::vector<size_t> t_row_idx(this->get_nnz());
+    std::vector<Scalar> t_values(this->get_nnz());
+    // Columns are visited in order, so rows of the result come out sorted
+    for (size_t col = 0; col < this->ncols; col++) {
+      for (size_t k = this->col_ptr[col]; k < this->col_ptr[col + 1]; k++) {
+        size_t position = next[this->row_idx[k]]++;
+        t_row_idx[position] = col;
+        t_values[position] = this->values[k];
+      }
+    }
+    return SparseMatrix{this->ncols, this->nrows, std::move(t_col_ptr),
+                        std::move(t_row_idx), std::move(t_values)};
+  }
+
+  // SECTION: Products
+  /*! Compute y += alpha * A * x (serial, as CSC scatters into y; keep the
+   * transpose around and use gaxpy_transpose for a parallel product).
+   *
+   * @param alpha Multiplier of the product
+   * @param x Array of length ncols
+   * @param y Array of length nrows which is updated
+   * */
+  void gaxpy(Scalar alpha, Scalar const *x, Scalar *y) const {
+    for (size_t col = 0; col < this->ncols; col++) {
+      Scalar scaled = alpha * x[col];
+      if (scaled == Scalar{0}) {
+        continue;
+      }
+      for (size_t k = this->col_ptr[col]; k < this->col_ptr[col + 1]; k++) {
+        y[this->row_idx[k]] += scaled * this->values[k];
+      }
+    }
+  }
+  /*! Compute y += alpha * A^T * x, in parallel over blocks of columns.
+   *
+   * @param alpha Multiplier of the product
+   * @param x Array of length nrows
+   * @param y Array of length ncols which is updated
+   * */
+  void gaxpy_transpose(Scalar alpha, Scalar const *x, Scalar *y) const {
+    size_t average = this->get_nnz() / std::max<size_t>(1, this->ncols);
+    size_t grain = std::max<size_t>(64, 16384 / std::max<size_t>(1, average));
+    parallel_for(this->ncols, grain, [&](size_t begin, size_t end) {
+      for (size_t col = begin; col < end; col++) {
+        Scalar sum = 0;
+        for (size_t k = this->col_ptr[col]; k < this->col_ptr[col + 1]; k++) {
+          sum += this->values[k] * x[this->row_idx[k]];
+        }
+        y[col] += alpha * sum;
+      }
+    });
+  }
+  /*! Compute A * x.
+   *
+   * @param x Vector of length ncols
+   * @return Vector of length nrows
+   * */
+  std::vector<Scalar> multiply(std::vector<Scalar> const &x) const {
+    if (x.size() != this->ncols) {
+      throw std::runtime_error("Vector has the wrong length for product");
+    }
+    std::vector<Scalar> result(this->nrows, 0);
+    this->gaxpy(1, x.data(), result.data());
+    return result;
+  }
+  /*! Compute A^T * x.
+   *
+   * @param x Vector of length nrows
+   * @return Vector of length ncols
+   * */
+  std::vector<Scalar> multiply_transpose(std::vector<Scalar> const &x) const {
+    if (x.size() != this->nrows) {
+      throw std::runtime_error("Vector has the wrong length for product");
+    }
+    std::vector<Scalar> result(this->ncols, 0);
+    this->gaxpy_transpose(1, x.data(), result.data());
+    return result;
+  }
+};
+} // namespace teensymat
@@ -0,0 +1,498 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <set>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/sparse_core.hpp"
+
+namespace teensymat {
+/*! Fill reducing orderings of SparseLDLT*/
+enum class Ordering {
+  /*! Factor in the given order*/
+  natural,
+  /*! Approximate minimum degree on the quotient graph, with dense rows
+   * last*/
+  minimum_degree,
+};
+
+namespace ldlt_detail {
+/*! Approximate minimum degree ordering of a symmetric pattern.
+ *
+ * Works on the quotient graph: an eliminated node becomes an element
+ * standing for the clique of its neighbours, elements adjacent to it are
+ * absorbed, and the degree of each neighbour is bounded as in AMD by
+ * |A_i| + |L_p| + sum of |L_e \ L_p| over its other elements. Nodes whose
+ * initial degree exceeds max(16, 10 sqrt(n)) are ordered last, so a few
+ * dense rows do not make the graph dense.
+ *
+ * @param adjacency Neighbours of each node (no self loops, no duplicates)
+ * @return The order, order[k] being the node eliminated k-th
+ * */
+inline std::vector<size_t>
+minimum_degree(std::vector<std::vector<size_t>> adjacency) {
+  size_t n = adjacency.size();
+  size_t dense = std::max<size_t>(
+      16, static_cast<size_t>(10 * std::sqrt(static_cast<double>(n))));
+  // State of each node: a variable, an element, or neither (absorbed
+  // elements and postponed dense nodes)
+  constexpr char variable = 0;
+  constexpr char element = 1;
+  constexpr char removed = 2;
+  std::vector<char> state(n, variable);
+  std::vector<size_t> postponed;
+  for (size_t v = 0; v < n; v++) {
+    if (adjacency[v].size() > dense) {
+      state[v] = removed;
+      postponed.push_back(v);
+    }
+  }
+  if (!postponed.empty()) {
+    for (size_t v = 0; v < n; v++) {
+      auto &neighbours = adjacency[v];
+      neighbours.erase(std::remove_if(neighbours.begin(), neighbours.end(),
+                                      [&](size_t u) {
+                                        return state[u] != variable;
+                                      }),
+                       neighbours.end());
+    }
+  }
+  // Elements adjacent to each variable, and variables of each element
+  std::vector<std::vector<size_t>> elements(n);
+  std::vector<std::vector<size_t>> members(n);
+  std::vector<size_t> degree(n, 0);
+  std::set<std::pair<size_t, size_t>> queue;
+  size_t remaining = 0;
+  for (size_t v = 0; v < n; v++) {
+    if (state[v] == variable) {
+      degree[v] = adjacency[v].size();
+      queue.emplace(degree[v], v);
+      remaining++;
+    }
+  }
+  std::vector<size_t> order;
+  order.reserve(n);
+  std::vector<size_t> mark(n, 0), weight(n, 0), weight_mark(n, 0);
+  size_t stamp = 0;
+  while (!queue.empty()) {
+    size_t p = queue.begin()->second;
+    queue.erase(queue.begin());
+    order.push_back(p);
+    remaining--;
+    state[p] = element;
+    // L_p: the variables adjacent to p directly or through its elements,
+    // which are absorbed
+    stamp++;
+    mark[p] = stamp;
+    std::vector<size_t> &pivot_members = members[p];
+    for (size_t v : adjacency[p]) {
+      if (state[v] == variable && mark[v] != stamp) {
+        mark[v] = stamp;
+        pivot_members.push_back(v);
+      }
+    }
+    for (size_t e : elements[p]) {
+      if (state[e] != element) {
+        continue;
+      }
+      for (size_t v : members[e]) {
+        if (state[v] == variable && mark[v] != stamp) {
+          mark[v] = stamp;
+          pivot_members.push_back(v);
+        }
+      }
+      state[e] = removed;
+      std::vector<size_t>().swap(members[e]);
+    }
+    std::vector<size_t>().swap(adjacency[p]);
+    std::vector<size_t>().swap(elements[p]);
+    // |L_e \ L_p| for the other elements of the variables in L_p
+    for (size_t i : pivot_members) {
+      for (size_t e : elements[i]) {
+        if (state[e] != element) {
+          continue;
+        }
+        if (weight_mark[e] != stamp) {
+          weight_mark[e] = stamp;
+          weight[e] = members[e].size();
+        }
+        weight[e]--;
+      }
+    }
+    size_t clique = pivot_members.size();
+    for (size_t i : pivot_members) {
+      queue.erase({degree[i], i});
+      size_t external = 0;
+      size_t kept = 0;
+      for (size_t e : elements[i]) {
+        if (state[e] != element) {
+          continue;
+        }
+        if (weight[e] == 0) {
+          // L_e is inside L_p (aggressive absorption)
+          state[e] = removed;
+          std::vector<size_t>().swap(members[e]);
+          continue;
+        }
+        elements[i][kept++] = e;
+        external += weight[e];
+      }
+      elements[i].resize(kept);
+      elements[i].push_back(p);
+      // Edges inside L_p are now represented by the element p
+      kept = 0;
+      for (size_t j : adjacency[i]) {
+        if (state[j] == variable && mark[j] != stamp) {
+          adjacency[i][kept++] = j;
+        }
+      }
+      adjacency[i].resize(kept);
+      degree[i] =
+          std::min(remaining - 1, adjacency[i].size() + clique - 1 + external);
+      queue.emplace(degree[i], i);
+    }
+  }
+  order.insert(order.end(), postponed.begin(), postponed.end());
+  return order;
+}
+} // namespace ldlt_detail
+
+/*! Sparse LDL^T factorization P A P^T = L D L^T of a symmetric matrix,
+ * with L unit lower triangular and D diagonal.
+ *
+ * The factorization is split in two: analyze computes the fill reducing
+ * ordering, the elimination tree and the pattern of L, and factorize
+ * computes the values (up-looking, one row of L at a time). Matrices with
+ * the same pattern are refactored without repeating the analysis, which is
+ * how interior point and operator splitting methods use it.
+ *
+ * No pivoting is done, so the matrix should be positive definite or quasi
+ * definite. For the latter, set_dynamic_regularization gives the expected
+ * sign of each pivot, and pivots which are too small or of the wrong sign
+ * are replaced.
+ * */
+template <typename Scalar> class SparseLDLT {
+public:
+  /*! Marker for "no index"*/
+  static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+private:
+  /*! Number of rows and columns*/
+  size_t n;
+  /*! Original index of each pivot*/
+  std::vector<size_t> permutation;
+  /*! Pivot of each original index*/
+  std::vector<size_t> inverse_permutation;
+  /*! Number of entries of the analyzed matrix*/
+  size_t matrix_nnz;
+  /*! Entry of C (below) holding each entry of the matrix, npos for the
+   * ignored lower triangle*/
+  std::vector<size_t> entry_map;
+  /*! Upper triangle of the permuted matrix C = P A P^T in CSC*/
+  std::vector<size_t> c_ptr, c_idx;
+  std::vector<Scalar> c_values;
+  /*! Parent of each node in the elimination tree (npos for roots)*/
+  std::vector<size_t> parent;
+  /*! Column pointers, row indices and values of L (without the unit
+   * diagonal)*/
+  std::vector<size_t> l_ptr, l_idx;
+  std::vector<Scalar> l_values;
+  /*! The diagonal D*/
+  std::vector<Scalar> diagonal;
+  /*! Expected sign of each pivot (by original index), empty if not
+   * regularized*/
+  std::vector<signed char> signs;
+  /*! Pivots with sign * d <= threshold are replaced*/
+  Scalar regularization_threshold;
+  /*! Magnitude of replaced pivots*/
+  Scalar regularization_value;
+  /*! Number of pivots replaced by the last factorize*/
+  size_t num_regularized;
+  /*! Workspaces of factorize and the solves*/
+  std::vector<Scalar> work;
+  mutable std::vector<Scalar> solve_work;
+  std::vector<size_t> pattern, flag, count;
+
+public:
+  // SECTION: Constructors
+  /*! Construct an empty factorization (analyze before factorizing)*/
+  SparseLDLT()
+      : n(0), matrix_nnz(0), regularization_threshold(0),
+        regularization_value(0), num_regularized(0) {}
+  /*! Analyze and factor a symmetric matrix.
+   *
+   * @param matrix The matrix (only its upper triangle is read)
+   * @param ordering The fill reducing ordering
+   * */
+  explicit SparseLDLT(SparseMatrix<Scalar> const &matrix,
+                      Ordering ordering = Ordering::minimum_degree)
+      : SparseLDLT() {
+    this->analyze(matrix, ordering);
+    this->factorize(matrix);
+  }
+
+  // SECTION: Factorization
+  /*! Compute the ordering and the pattern of L for a symmetric matrix.
+   *
+   * @param matrix The matrix (only its upper triangle is read)
+   * @param ordering The fill reducing ordering
+   * */
+  void analyze(SparseMatrix<Scalar> const &matrix,
+               Ordering ordering = Ordering::minimum_degree) {
+    if (matrix.get_nrows() != matrix.get_ncols()) {
+      throw std::runtime_error("Tried to LDL^T factor a non square matrix");
+    }
+    size_t n = matrix.get_nrows();
+    this->n = n;
+    this->matrix_nnz = matrix.get_nnz();
+    auto const &col_ptr = matrix.get_col_ptr();
+    auto const &row_idx = matrix.get_row_idx();
+    // Ordering
+    this->permutation.resize(n);
+    if (ordering == Ordering::minimum_degree) {
+      std::vector<std::vector<size_t>> adjacency(n);
+      for (size_t j = 0; j < n; j++) {
+        for (size_t k = col_ptr[j]; k < col_ptr[j + 1]; k++) {
+          size_t i = row_idx[k];
+          if (i < j) {
+            adjacency[i].push_back(j);
+            adjacency[j].push_back(i);
+          }
+        }
+      }
+      for (auto &neighbours : adjacency) {
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()),
+                         neighbours.end());
+      }
+      this->permutation = ldlt_detail::minimum_degree(std::move(adjacency));
+    } else {
+      for (size_t k = 0; k < n; k++) {
+        this->permutation[k] = k;
+      }
+    }
+    this->inverse_permutation.resize(n);
+    for (size_t k = 0; k < n; k++) {
+      this->inverse_permutation[this->permutation[k]] = k;
+    }
+    // Upper triangle of C = P A P^T, remembering where each entry goes
+    this->c_ptr.assign(n + 1, 0);
+    for (size_t j = 0; j < n; j++) {
+      for (size_t k = col_ptr[j]; k < col_ptr[j + 1]; k++) {
+        if (row_idx[k] <= j) {
+          size_t pi = this->inverse_permutation[row_idx[k]];
+          size_t pj = this->inverse_permutation[j];
+          this->c_ptr[std::max(pi, pj) + 1]++;
+        }
+      }
+    }
+    for (size_t k = 0; k < n; k++) {
+      this->c_ptr[k + 1] += this->c_ptr[k];
+    }
+    std::vector<size_t> next(this->c_ptr.begin(), this->c_ptr.end() - 1);
+    this->c_idx.resize(this->c_ptr[n]);
+    this->c_values.assign(this->c_ptr[n], 0);
+    this->entry_map.assign(matrix.get_nnz(), npos);
+    for (size_t j = 0; j < n; j++) {
+      for (size_t k = col_ptr[j]; k < col_ptr[j + 1]; k++) {
+        if (row_idx[k] <= j) {
+          size_t pi = this->inverse_permutation[row_idx[k]];
+          size_t pj = this->inverse_permutation[j];
+          size_t slot = next[std::max(pi, pj)]++;
+          this->c_idx[slot] = std::min(pi, pj);
+          this->entry_map[k] = slot;
+        }
+      }
+    }
+    // Elimination tree and column counts of L: row k of L is the set of
+    // nodes reached walking up the tree from the entries of column k of C
+    this->parent.assign(n, npos);
+    this->flag.assign(n, npos);
+    this->count.assign(n, 0);
+    for (size_t k = 0; k < n; k++) {
+      this->flag[k] = k;
+      for (size_t p = this->c_ptr[k]; p < this->c_ptr[k + 1]; p++) {
+        for (size_t i = this->c_idx[p]; this->flag[i] != k;
+             i = this->parent[i]) {
+          if (this->parent[i] == npos) {
+            this->parent[i] = k;
+          }
+          this->count[i]++;
+          this->flag[i] = k;
+        }
+      }
+    }
+    this->l_ptr.assign(n + 1, 0);
+    for (size_t k = 0; k < n; k++) {
+      this->l_ptr[k + 1] = this->l_ptr[k] + this->count[k];
+    }
+    this->l_idx.resize(this->l_ptr[n]);
+    this->l_values.resize(this->l_ptr[n]);
+    this->diagonal.assign(n, 0);
+    this->work.assign(n, 0);
+    this->solve_work.assign(n, 0);
+    this->pattern.assign(n, 0);
+  }
+  /*! Set the expected sign of each pivot of a quasi definite matrix. Pivots
+   * d with sign * d <= threshold are replaced by sign * value.
+   *
+   * @param signs +1 or -1 for each row (original order), empty to disable
+   * @param threshold Smallest acceptable signed pivot
+   * @param value Magnitude of replaced pivots
+   * */
+  void set_dynamic_regularization(std::vector<signed char> signs,
+                                  Scalar threshold, Scalar value) {
+    this->signs = std::move(signs);
+    this->regularization_threshold = threshold;
+    this->regularization_value = value;
+  }
+  /*! Compute L and D for a matrix with the pattern given to analyze.
+   *
+   * Throws std::runtime_error on a zero pivot (without regularization).
+   *
+   * @param matrix The matrix (only its upper triangle is read)
+   * */
+  void factorize(SparseMatrix<Scalar> const &matrix) {
+    size_t n = this->n;
+    if (matrix.get_nrows() != n || matrix.get_nnz() != this->matrix_nnz) {
+      throw std::runtime_error(
+          "Matrix does not have the analyzed sparsity pattern");
+    }
+    Scalar const *values = matrix.get_values()->data();
+    std::fill(this->c_values.begin(), this->c_values.end(), Scalar{0});
+    for (size_t k = 0; k < this->matrix_nnz; k++) {
+      if (this->entry_map[k] != npos) {
+        this->c_values[this->entry_map[k]] += values[k];
+      }
+    }
+    bool regularize = !this->signs.empty();
+    this->num_regularized = 0;
+    Scalar *y = this->work.data();
+    size_t *pattern = this->pattern.data();
+    for (size_t k = 0; k < n; k++) {
+      // Scatter column k of C and find the pattern of row k of L in
+      // topological order
+      size_t top = n;
+      this->flag[k] = k;
+      this->count[k] = 0;
+      for (size_t p = this->c_ptr[k]; p < this->c_ptr[k + 1]; p++) {
+        size_t i = this->c_idx[p];
+        y[i] += this->c_values[p];
+        size_t length = 0;
+        for (; this->flag[i] != k; i = this->parent[i]) {
+          pattern[length++] = i;
+          this->flag[i] = k;
+        }
+        while (length > 0) {
+          pattern[--top] = pattern[--length];
+        }
+      }
+      Scalar d = y[k];
+      y[k] = 0;
+      for (; top < n; top++) {
+        size_t i = pattern[top];
+        Scalar yi = y[i];
+        y[i] = 0;
+        size_t end = this->l_ptr[i] + this->count[i];
+        for (size_t p = this->l_ptr[i]; p < end; p++) {
+          y[this->l_idx[p]] -= this->l_values[p] * yi;
+        }
+        Scalar l_ki = yi / this->diagonal[i];
+        d -= l_ki * yi;
+        this->l_idx[end] = k;
+        this->l_values[end] = l_ki;
+        this->count[i]++;
+      }
+      if (regularize) {
+        Scalar sign = this->signs[this->permutation[k]] < 0 ? -1 : 1;
+        if (!(sign * d > this->regularization_threshold)) {
+          d = sign * this->regularization_value;
+          this->num_regularized++;
+        }
+      } else if (d == Scalar{0} || !std::isfinite(d)) {
+        throw std::runtime_error("Matrix is singular");
+      }
+      this->diagonal[k] = d;
+    }
+  }
+
+  // SECTION: Getters
+  /*! Get the number of rows (and columns) of the factored matrix*/
+  size_t get_size() const { return this->n; }
+  /*! Get the number of entries of L (without its diagonal)*/
+  size_t get_factor_nnz() const {
+    return this->l_ptr.empty() ? 0 : this->l_ptr[this->n];
+  }
+  /*! Get the ordering: the original index of each pivot*/
+  std::vector<size_t> const &get_permutation() const {
+    return this->permutation;
+  }
+  /*! Get the elimination tree (npos for roots)*/
+  std::vector<size_t> const &get_parent() const { return this->parent; }
+  /*! Get the diagonal D (in pivot order)*/
+  std::vector<Scalar> const &get_diagonal() const { return this->diagonal; }
+  /*! Get the number of pivots replaced by the last factorize*/
+  size_t get_num_regularized() const { return this->num_regularized; }
+  /*! Get the number of positive and negative pivots*/
+  std::pair<size_t, size_t> get_inertia() const {
+    size_t positive = 0;
+    for (Scalar d : this->diagonal) {
+      positive += d > 0;
+    }
+    return {positive, this->n - positive};
+  }
+
+  // SECTION: Solves
+  /*! Solve A * x = b in place (not safe to call concurrently on the same
+   * factorization, as it uses a workspace).
+   *
+   * @param rhs On entry b, on exit x (length n)
+   * */
+  void solve_inplace(Scalar *rhs) const {
+    size_t n = this->n;
+    Scalar *x = this->solve_work.data();
+    for (size_t k = 0; k < n; k++) {
+      x[k] = rhs[this->permutation[k]];
+    }
+    for (size_t j = 0; j < n; j++) {
+      Scalar xj = x[j];
+      if (xj != Scalar{0}) {
+        for (size_t p = this->l_ptr[j]; p < this->l_ptr[j + 1]; p++) {
+          x[this->l_idx[p]] -= this->l_values[p] * xj;
+        }
+      }
+    }
+    for (size_t j = 0; j < n; j++) {
+      x[j] /= this->diagonal[j];
+    }
+    for (size_t j = n; j-- > 0;) {
+      Scalar sum = x[j];
+      for (size_t p = this->l_ptr[j]; p < this->l_ptr[j + 1]; p++) {
+        sum -= this->l_values[p] * x[this->l_idx[p]];
+      }
+      x[j] = sum;
+    }
+    for (size_t k = 0; k < n; k++) {
+      rhs[this->permutation[k]] = x[k];
+    }
+  }
+  /*! Solve A * x = b.
+   *
+   * @param rhs The right hand side b
+   * @return The solution x
+   * */
+  std::vector<Scalar> solve(std::vector<Scalar> rhs) const {
+    if (rhs.size() != this->n) {
+      throw std::range_error("Right hand side does not match the matrix");
+    }
+    this->solve_inplace(rhs.data());
+    return rhs;
+  }
+};
+} // namespace teensymat
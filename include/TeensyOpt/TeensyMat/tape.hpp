@@ -0,0 +1,680 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/linalg.hpp"
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+
+namespace teensymat {
+template <typename Scalar> class Tape;
+
+/*! Operations recorded by a Tape*/
+enum class TapeOp {
+  /*! A variable or constant set by the caller*/
+  input,
+  /*! Elementwise a + b (a 1 x 1 operand is broadcast)*/
+  add,
+  /*! Elementwise a - b (a 1 x 1 operand is broadcast)*/
+  subtract,
+  /*! Elementwise a * b (a 1 x 1 operand is broadcast)*/
+  multiply,
+  /*! Elementwise a / b (a 1 x 1 operand is broadcast)*/
+  divide,
+  /*! a + c for a constant c*/
+  add_constant,
+  /*! c * a for a constant c*/
+  scale,
+  /*! Matrix product a b*/
+  matmul,
+  /*! a^T*/
+  transpose,
+  /*! Sum of the elements of a (1 x 1)*/
+  sum,
+  /*! Sum of the elementwise product of a and b (1 x 1)*/
+  dot,
+  /*! Elementwise exp(a)*/
+  exp,
+  /*! Elementwise log(a)*/
+  log,
+  /*! Elementwise sqrt(a)*/
+  sqrt,
+  /*! Elementwise tanh(a)*/
+  tanh,
+  /*! Elementwise a^2*/
+  square,
+};
+
+/*! A Matrix valued node recorded on a Tape (a cheap handle; the values
+ * live in the Tape)*/
+template <typename Scalar> struct TapeVariable {
+  /*! The Tape holding the node*/
+  Tape<Scalar> *tape = nullptr;
+  /*! Index of the node on the Tape*/
+  size_t index = 0;
+};
+
+/*! A reverse mode automatic differentiation tape over Matrix values.
+ *
+ * Every node is a whole Matrix (stored row major) produced by one
+ * operation: elementwise arithmetic and functions, matrix products,
+ * transposes and reductions, each with a hand-written adjoint. The tape
+ * therefore grows with the number of operations rather than the number
+ * of scalars, and the backward pass costs a small multiple of the
+ * forward one (a matrix product needs two products of the same size, an
+ * elementwise operation one pass).
+ *
+ * Values and adjoints are carved out of two arenas, addressed by offset.
+ * reset() empties the tape but keeps the arenas' storage, so recording
+ * the same computation again allocates nothing. A recorded tape can also
+ * be replayed: set_value changes an input in place and forward()
+ * recomputes every node without recording anything.
+ *
+ * Typical use:
+ *
+ *     Tape<double> tape;
+ *     auto x = tape.variable(x0);
+ *     auto f = sum(square(matmul(a_node, x) - b_node));
+ *     tape.backward(f);
+ *     Matrix<double> g = tape.get_gradient(x);
+ * */
+template <typename Scalar> class Tape {
+private:
+  /*! A recorded operation*/
+  struct Node {
+    /*! The operation*/
+    TapeOp op;
+    /*! Shape of the value*/
+    size_t nrows, ncols;
+    /*! Offset of the value (and adjoint) in the arenas*/
+    size_t offset;
+    /*! Operands (indices of earlier nodes)*/
+    size_t lhs, rhs;
+    /*! Constant of add_constant and scale*/
+    Scalar constant;
+    /*! Whether the node depends on a variable (else its adjoint is not
+     * propagated)*/
+    bool active;
+  };
+  /*! The recorded nodes, in order*/
+  std::vector<Node> nodes;
+  /*! Arena of node values*/
+  std::vector<Scalar> values;
+  /*! Arena of adjoints, parallel to values*/
+  std::vector<Scalar> adjoints;
+  /*! Scratch space of the matrix product adjoints*/
+  std::vector<Scalar> scratch;
+
+  size_t size(Node const &node) const { return node.nrows * node.ncols; }
+  Scalar *value(size_t index) {
+    return this->values.data() + this->nodes[index].offset;
+  }
+  Scalar *adjoint(size_t index) {
+    return this->adjoints.data() + this->nodes[index].offset;
+  }
+  /*! Append a node and compute its value*/
+  TapeVariable<Scalar> record(TapeOp op, size_t nrows, size_t ncols,
+                              size_t lhs, size_t rhs, Scalar constant,
+                              bool active) {
+    size_t offset = this->values.size();
+    this->values.resize(offset + nrows * ncols);
+    this->nodes.push_back(
+        Node{op, nrows, ncols, offset, lhs, rhs, constant, active});
+    size_t index = this->nodes.size() - 1;
+    this->evaluate(index);
+    return TapeVariable<Scalar>{this, index};
+  }
+  /*! Check that a variable belongs to this tape*/
+  void check(TapeVariable<Scalar> variable) const {
+    if (variable.tape != this || variable.index >= this->nodes.size()) {
+      throw std::runtime_error("Variable was not recorded on this Tape");
+    }
+  }
+  /*! Check that a variable is an input of this tape*/
+  void check_input(TapeVariable<Scalar> variable) const {
+    this->check(variable);
+    if (this->nodes[variable.index].op != TapeOp::input) {
+      throw std::runtime_error("Only inputs of a Tape can be set");
+    }
+  }
+
+  // SECTION: Forward and backward passes of each operation
+  /*! Compute the value of a node from its operands*/
+  void evaluate(size_t index) {
+    using std::exp;
+    using std::log;
+    using std::sqrt;
+    using std::tanh;
+    Node const &node = this->nodes[index];
+    if (node.op == TapeOp::input) {
+      return;
+    }
+    Node const &a_node = this->nodes[node.lhs];
+    Node const &b_node = this->nodes[node.rhs];
+    Scalar *out = this->value(index);
+    Scalar const *a = this->value(node.lhs);
+    Scalar const *b = this->value(node.rhs);
+    size_t n = this->size(node);
+    // Strides of the operands of elementwise operations (0 if broadcast)
+    size_t sa = this->size(a_node) == 1 ? 0 : 1;
+    size_t sb = this->size(b_node) == 1 ? 0 : 1;
+    switch (node.op) {
+    case TapeOp::input:
+      break;
+    case TapeOp::add:
+      for (size_t k = 0; k < n; k++) {
+        out[k] = a[k * sa] + b[k * sb];
+      }
+      break;
+    case TapeOp::subtract:
+      for (size_t k = 0; k < n; k++) {
+        out[k] = a[k * sa] - b[k * sb];
+      }
+      break;
+    case TapeOp::multiply:
+      for (size_t k = 0; k < n; k++) {
+        out[k] = a[k * sa] * b[k * sb];
+      }
+      break;
+    case TapeOp::divide:
+      for (size_t k = 0; k < n; k++) {
+        out[k] = a[k * sa] / b[k * sb];
+      }
+      break;
+    case TapeOp::add_constant:
+      for (size_t k = 0; k < n; k++) {
+        out[k] = a[k] + node.constant;
+      }
+      break;
+    case TapeOp::scale:
+      for (size_t k = 0; k < n; k++) {
+        out[k] = node.constant * a[k];
+      }
+      break;
+    case TapeOp::matmul:
+      std::fill(out, out + n, Scalar{0});
+      gemm(node.nrows, node.ncols, a_node.ncols, Scalar{1}, a, a_node.ncols,
+           b, node.ncols, out, node.ncols);
+      break;
+    case TapeOp::transpose:
+      for (size_t i = 0; i < a_node.nrows; i++) {
+        for (size_t j = 0; j < a_node.ncols; j++) {
+          out[j * a_node.nrows + i] = a[i * a_node.ncols + j];
+        }
+      }
+      break;
+    case TapeOp::sum: {
+      Scalar total = 0;
+      for (size_t k = 0; k < this->size(a_node); k++) {
+        total += a[k];
+      }
+      out[0] = total;
+      break;
+    }
+    case TapeOp::dot:
+      out[0] = teensymat::dot(this->size(a_node), a, b);
+      break;
+    case TapeOp::exp:
+      for (size_t k = 0; k < n; k++) {
+        out[k] = exp(a[k]);
+      }
+      break;
+    case TapeOp::log:
+      for (size_t k = 0; k < n; k++) {
+        out[k] = log(a[k]);
+      }
+      break;
+    case TapeOp::sqrt:
+      for (size_t k = 0; k < n; k++) {
+        out[k] = sqrt(a[k]);
+      }
+      break;
+    case TapeOp::tanh:
+      for (size_t k = 0; k < n; k++) {
+        out[k] = tanh(a[k]);
+      }
+      break;
+    case TapeOp::square:
+      for (size_t k = 0; k < n; k++) {
+        out[k] = a[k] * a[k];
+      }
+      break;
+    }
+  }
+  /*! Add the contributions of a node's adjoint to those of its operands*/
+  void propagate(size_t index) {
+    Node const &node = this->nodes[index];
+    if (node.op == TapeOp::input) {
+      return;
+    }
+    Node const &a_node = this->nodes[node.lhs];
+    Node const &b_node = this->nodes[node.rhs];
+    bool into_a = a_node.active;
+    bool into_b = b_node.active;
+    Scalar const *g = this->adjoint(index);
+    Scalar const *out = this->value(index);
+    Scalar *ga = this->adjoint(node.lhs);
+    Scalar *gb = this->adjoint(node.rhs);
+    Scalar const *a = this->value(node.lhs);
+    Scalar const *b = this->value(node.rhs);
+    size_t n = this->size(node);
+    size_t sa = this->size(a_node) == 1 ? 0 : 1;
+    size_t sb = this->size(b_node) == 1 ? 0 : 1;
+    switch (node.op) {
+    case TapeOp::input:
+      break;
+    case TapeOp::add:
+    case TapeOp::subtract: {
+      Scalar sign = node.op == TapeOp::add ? Scalar{1} : Scalar{-1};
+      for (size_t k = 0; k < n && into_a; k++) {
+        ga[k * sa] += g[k];
+      }
+      for (size_t k = 0; k < n && into_b; k++) {
+        gb[k * sb] += sign * g[k];
+      }
+      break;
+    }
+    case TapeOp::multiply:
+      for (size_t k = 0; k < n && into_a; k++) {
+        ga[k * sa] += g[k] * b[k * sb];
+      }
+      for (size_t k = 0; k < n && into_b; k++) {
+        gb[k * sb] += g[k] * a[k * sa];
+      }
+      break;
+    case TapeOp::divide:
+      // d(a / b) = da / b - (a / b) db / b
+      for (size_t k = 0; k < n; k++) {
+        Scalar gk = g[k] / b[k * sb];
+        if (into_a) {
+          ga[k * sa] += gk;
+        }
+        if (into_b) {
+          gb[k * sb] -= gk * out[k];
+        }
+      }
+      break;
+    case TapeOp::add_constant:
+      axpy(n, Scalar{1}, g, ga);
+      break;
+    case TapeOp::scale:
+      axpy(n, node.constant, g, ga);
+      break;
+    case TapeOp::matmul: {
+      size_t m = node.nrows;
+      size_t k = a_node.ncols;
+      size_t p = node.ncols;
+      if (into_a) {
+        // dA += dC B^T
+        gemm_nt(m, k, p, Scalar{1}, g, p, b, p, ga, k);
+      }
+      if (into_b) {
+        // dB += A^T dC, with A^T formed in the scratch space
+        this->scratch.resize(m * k);
+        Scalar *at = this->scratch.data();
+        for (size_t i = 0; i < m; i++) {
+          for (size_t j = 0; j < k; j++) {
+            at[j * m + i] = a[i * k + j];
+          }
+        }
+        gemm(k, p, m, Scalar{1}, at, m, g, p, gb, p);
+      }
+      break;
+    }
+    case TapeOp::transpose:
+      for (size_t i = 0; i < a_node.nrows; i++) {
+        for (size_t j = 0; j < a_node.ncols; j++) {
+          ga[i * a_node.ncols + j] += g[j * a_node.nrows + i];
+        }
+      }
+      break;
+    case TapeOp::sum:
+      for (size_t k = 0; k < this->size(a_node); k++) {
+        ga[k] += g[0];
+      }
+      break;
+    case TapeOp::dot:
+      if (into_a) {
+        axpy(this->size(a_node), g[0], b, ga);
+      }
+      if (into_b) {
+        axpy(this->size(b_node), g[0], a, gb);
+      }
+      break;
+    case TapeOp::exp:
+      for (size_t k = 0; k < n; k++) {
+        ga[k] += g[k] * out[k];
+      }
+      break;
+    case TapeOp::log:
+      for (size_t k = 0; k < n; k++) {
+        ga[k] += g[k] / a[k];
+      }
+      break;
+    case TapeOp::sqrt:
+      for (size_t k = 0; k < n; k++) {
+        ga[k] += g[k] / (2 * out[k]);
+      }
+      break;
+    case TapeOp::tanh:
+      for (size_t k = 0; k < n; k++) {
+        ga[k] += g[k] * (1 - out[k] * out[k]);
+      }
+      break;
+    case TapeOp::square:
+      for (size_t k = 0; k < n; k++) {
+        ga[k] += 2 * g[k] * a[k];
+      }
+      break;
+    }
+  }
+
+public:
+  // SECTION: Recording
+  /*! Record an input the gradient is taken with respect to.
+   *
+   * @param matrix Its initial value
+   * */
+  TapeVariable<Scalar> variable(Matrix<Scalar> const &matrix) {
+    return this->input(matrix, true);
+  }
+  /*! Record an input that is held constant (no adjoint is propagated
+   * into it or into nodes depending only on constants).
+   *
+   * @param matrix Its value
+   * */
+  TapeVariable<Scalar> constant(Matrix<Scalar> const &matrix) {
+    return this->input(matrix, false);
+  }
+  /*! Record an input.
+   *
+   * @param matrix Its value
+   * @param active Whether gradients are taken with respect to it
+   * */
+  TapeVariable<Scalar> input(Matrix<Scalar> const &matrix, bool active) {
+    size_t index = this->nodes.size();
+    TapeVariable<Scalar> result =
+        this->record(TapeOp::input, matrix.get_nrows(), matrix.get_ncols(),
+                     index, index, Scalar{0}, active);
+    this->set_value(result, matrix);
+    return result;
+  }
+  /*! Record a binary operation.
+   *
+   * Elementwise operations need operands of the same shape, or one of
+   * them 1 x 1 (broadcast); matmul needs compatible shapes and dot equal
+   * sizes.
+   *
+   * @param op The operation
+   * @param lhs First operand
+   * @param rhs Second operand
+   * */
+  TapeVariable<Scalar> apply(TapeOp op, TapeVariable<Scalar> lhs,
+                             TapeVariable<Scalar> rhs) {
+    this->check(lhs);
+    this->check(rhs);
+    Node const &a = this->nodes[lhs.index];
+    Node const &b = this->nodes[rhs.index];
+    size_t nrows = a.nrows;
+    size_t ncols = a.ncols;
+    switch (op) {
+    case TapeOp::add:
+    case TapeOp::subtract:
+    case TapeOp::multiply:
+    case TapeOp::divide:
+      if (this->size(a) == 1) {
+        nrows = b.nrows;
+        ncols = b.ncols;
+      } else if (this->size(b) != 1 &&
+                 (a.nrows != b.nrows || a.ncols != b.ncols)) {
+        throw std::runtime_error(
+            "Tried to combine Matrices of different shapes");
+      }
+      break;
+    case TapeOp::matmul:
+      if (a.ncols != b.nrows) {
+        throw std::runtime_error(
+            "Tried to multiply Matrices of incompatible shapes");
+      }
+      ncols = b.ncols;
+      break;
+    case TapeOp::dot:
+      if (this->size(a) != this->size(b)) {
+        throw std::runtime_error("Tried to dot Matrices of different sizes");
+      }
+      nrows = 1;
+      ncols = 1;
+      break;
+    default:
+      throw std::runtime_error("Not a binary Tape operation");
+    }
+    return this->record(op, nrows, ncols, lhs.index, rhs.index, Scalar{0},
+                        a.active || b.active);
+  }
+  /*! Record a unary operation.
+   *
+   * @param op The operation
+   * @param operand Its operand
+   * @param constant The constant of add_constant and scale
+   * */
+  TapeVariable<Scalar> apply(TapeOp op, TapeVariable<Scalar> operand,
+                             Scalar constant = 0) {
+    this->check(operand);
+    Node const &a = this->nodes[operand.index];
+    size_t nrows = a.nrows;
+    size_t ncols = a.ncols;
+    switch (op) {
+    case TapeOp::transpose:
+      std::swap(nrows, ncols);
+      break;
+    case TapeOp::sum:
+      nrows = 1;
+      ncols = 1;
+      break;
+    case TapeOp::add_constant:
+    case TapeOp::scale:
+    case TapeOp::exp:
+    case TapeOp::log:
+    case TapeOp::sqrt:
+    case TapeOp::tanh:
+    case TapeOp::square:
+      break;
+    default:
+      throw std::runtime_error("Not a unary Tape operation");
+    }
+    return this->record(op, nrows, ncols, operand.index, operand.index,
+                        constant, a.active);
+  }
+  /*! Discard every node, keeping the arenas' storage for the next
+   * recording*/
+  void reset() {
+    this->nodes.clear();
+    this->values.clear();
+    this->adjoints.clear();
+  }
+
+  // SECTION: Replay and gradients
+  /*! Change the value of an input in place (call forward() afterwards
+   * to update the nodes depending on it).
+   *
+   * @param input The input
+   * @param data Its new value (row major)
+   * */
+  void set_value(TapeVariable<Scalar> input, Scalar const *data) {
+    this->check_input(input);
+    std::copy(data, data + this->size(this->nodes[input.index]),
+              this->value(input.index));
+  }
+  /*! Change the value of an input in place.
+   *
+   * @param input The input
+   * @param matrix Its new value (of the same shape)
+   * */
+  void set_value(TapeVariable<Scalar> input, Matrix<Scalar> const &matrix) {
+    this->check_input(input);
+    Node const &node = this->nodes[input.index];
+    if (matrix.get_nrows() != node.nrows || matrix.get_ncols() != node.ncols) {
+      throw std::runtime_error("Matrix does not have the shape of the input");
+    }
+    Scalar *out = this->value(input.index);
+    for (size_t row = 0; row < node.nrows; row++) {
+      for (size_t col = 0; col < node.ncols; col++) {
+        out[row * node.ncols + col] = *matrix(row, col);
+      }
+    }
+  }
+  /*! Recompute every node from the current inputs, in recording order*/
+  void forward() {
+    for (size_t index = 0; index < this->nodes.size(); index++) {
+      this->evaluate(index);
+    }
+  }
+  /*! Compute the adjoints of every node with respect to a 1 x 1 output,
+   * in one reverse sweep from it.
+   *
+   * @param output The output
+   * */
+  void backward(TapeVariable<Scalar> output) {
+    this->check(output);
+    if (this->size(this->nodes[output.index]) != 1) {
+      throw std::range_error("Gradients need a 1 x 1 output");
+    }
+    this->adjoints.assign(this->values.size(), Scalar{0});
+    *this->adjoint(output.index) = 1;
+    for (size_t index = output.index + 1; index-- > 0;) {
+      if (this->nodes[index].active) {
+        this->propagate(index);
+      }
+    }
+  }
+
+  // SECTION: Getters
+  /*! Get the number of recorded nodes*/
+  size_t get_num_nodes() const { return this->nodes.size(); }
+  /*! Get the number of Scalars held in the value arena*/
+  size_t get_arena_size() const { return this->values.size(); }
+  /*! Get the shape of a node*/
+  std::pair<size_t, size_t> get_shape(TapeVariable<Scalar> node) const {
+    this->check(node);
+    return {this->nodes[node.index].nrows, this->nodes[node.index].ncols};
+  }
+  /*! Get the value of a node (row major, valid until the next
+   * recording)*/
+  Scalar const *get_value_data(TapeVariable<Scalar> node) {
+    this->check(node);
+    return this->value(node.index);
+  }
+  /*! Get the adjoint of a node from the last backward (row major, valid
+   * until the next recording)*/
+  Scalar const *get_gradient_data(TapeVariable<Scalar> node) {
+    this->check(node);
+    if (this->adjoints.size() != this->values.size()) {
+      throw std::runtime_error("No gradient has been computed");
+    }
+    return this->adjoint(node.index);
+  }
+  /*! Get the value of a node as a Matrix*/
+  Matrix<Scalar> get_value(TapeVariable<Scalar> node) {
+    Scalar const *data = this->get_value_data(node);
+    auto [nrows, ncols] = this->get_shape(node);
+    return Matrix<Scalar>{nrows, ncols,
+                          std::vector<Scalar>(data, data + nrows * ncols)};
+  }
+  /*! Get the adjoint of a node from the last backward as a Matrix*/
+  Matrix<Scalar> get_gradient(TapeVariable<Scalar> node) {
+    Scalar const *data = this->get_gradient_data(node);
+    auto [nrows, ncols] = this->get_shape(node);
+    return Matrix<Scalar>{nrows, ncols,
+                          std::vector<Scalar>(data, data + nrows * ncols)};
+  }
+};
+
+// SECTION: Recording operators
+template <typename Scalar>
+TapeVariable<Scalar> operator+(TapeVariable<Scalar> lhs,
+                               TapeVariable<Scalar> rhs) {
+  return lhs.tape->apply(TapeOp::add, lhs, rhs);
+}
+template <typename Scalar>
+TapeVariable<Scalar> operator-(TapeVariable<Scalar> lhs,
+                               TapeVariable<Scalar> rhs) {
+  return lhs.tape->apply(TapeOp::subtract, lhs, rhs);
+}
+/*! Elementwise product, like Matrix::operator* (see matmul)*/
+template <typename Scalar>
+TapeVariable<Scalar> operator*(TapeVariable<Scalar> lhs,
+                               TapeVariable<Scalar> rhs) {
+  return lhs.tape->apply(TapeOp::multiply, lhs, rhs);
+}
+template <typename Scalar>
+TapeVariable<Scalar> operator/(TapeVariable<Scalar> lhs,
+                               TapeVariable<Scalar> rhs) {
+  return lhs.tape->apply(TapeOp::divide, lhs, rhs);
+}
+template <typename Scalar>
+TapeVariable<Scalar> operator+(TapeVariable<Scalar> lhs,
+                               std::type_identity_t<Scalar> rhs) {
+  return lhs.tape->apply(TapeOp::add_constant, lhs, rhs);
+}
+template <typename Scalar>
+TapeVariable<Scalar> operator-(TapeVariable<Scalar> lhs,
+                               std::type_identity_t<Scalar> rhs) {
+  return lhs.tape->apply(TapeOp::add_constant, lhs, -rhs);
+}
+template <typename Scalar>
+TapeVariable<Scalar> operator*(std::type_identity_t<Scalar> lhs,
+                               TapeVariable<Scalar> rhs) {
+  return rhs.tape->apply(TapeOp::scale, rhs, lhs);
+}
+template <typename Scalar>
+TapeVariable<Scalar> operator*(TapeVariable<Scalar> lhs,
+                               std::type_identity_t<Scalar> rhs) {
+  return lhs.tape->apply(TapeOp::scale, lhs, rhs);
+}
+template <typename Scalar>
+TapeVariable<Scalar> operator-(TapeVariable<Scalar> operand) {
+  return operand.tape->apply(TapeOp::scale, operand, Scalar{-1});
+}
+/*! Matrix product of two nodes*/
+template <typename Scalar>
+TapeVariable<Scalar> matmul(TapeVariable<Scalar> lhs,
+                            TapeVariable<Scalar> rhs) {
+  return lhs.tape->apply(TapeOp::matmul, lhs, rhs);
+}
+/*! Transpose of a node*/
+template <typename Scalar>
+TapeVariable<Scalar> transpose(TapeVariable<Scalar> operand) {
+  return operand.tape->apply(TapeOp::transpose, operand);
+}
+/*! Sum of the elements of a node*/
+template <typename Scalar> TapeVariable<Scalar> sum(TapeVariable<Scalar> a) {
+  return a.tape->apply(TapeOp::sum, a);
+}
+/*! Sum of the elementwise product of two nodes of the same size*/
+template <typename Scalar>
+TapeVariable<Scalar> dot(TapeVariable<Scalar> lhs, TapeVariable<Scalar> rhs) {
+  return lhs.tape->apply(TapeOp::dot, lhs, rhs);
+}
+template <typename Scalar> TapeVariable<Scalar> exp(TapeVariable<Scalar> a) {
+  return a.tape->apply(TapeOp::exp, a);
+}
+template <typename Scalar> TapeVariable<Scalar> log(TapeVariable<Scalar> a) {
+  return a.tape->apply(TapeOp::log, a);
+}
+template <typename Scalar> TapeVariable<Scalar> sqrt(TapeVariable<Scalar> a) {
+  return a.tape->apply(TapeOp::sqrt, a);
+}
+template <typename Scalar> TapeVariable<Scalar> tanh(TapeVariable<Scalar> a) {
+  return a.tape->apply(TapeOp::tanh, a);
+}
+template <typename Scalar>
+TapeVariable<Scalar> square(TapeVariable<Scalar> a) {
+  return a.tape->apply(TapeOp::square, a);
+}
+} // namespace teensymat
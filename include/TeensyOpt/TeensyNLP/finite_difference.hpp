@@ -0,0 +1,439 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/coloring.hpp"
+#include "TeensyOpt/TeensyMat/parallel.hpp"
+#include "TeensyOpt/TeensyMat/sparse_core.hpp"
+#include "TeensyOpt/TeensyNLP/nlls.hpp"
+#include "TeensyOpt/TeensyNLP/nlp_problem.hpp"
+
+namespace teensynlp {
+/*! Difference formulas of the finite difference estimates*/
+enum class DifferenceFormula {
+  /*! (f(x + h) - f(x)) / h, one evaluation per color*/
+  forward,
+  /*! (f(x + h) - f(x - h)) / 2h, two evaluations per color*/
+  central,
+};
+
+/*! Options of SparseJacobianFD and SparseHessianFD*/
+template <typename Scalar> struct FiniteDifferenceOptions {
+  /*! Difference formula*/
+  DifferenceFormula formula = DifferenceFormula::forward;
+  /*! Visiting order of the coloring*/
+  teensymat::ColoringOrder order = teensymat::ColoringOrder::dsatur;
+  /*! Relative step, h_j = step max(|x_j|, 1) (0 for sqrt(eps) with
+   * forward differences and cbrt(eps) with central ones)*/
+  Scalar step = 0;
+  /*! Evaluate the colors on the global ThreadPool. Off by default, since
+   * it requires the function to be safe to call concurrently*/
+  bool parallel = false;
+};
+
+namespace finite_difference_detail {
+/*! Perturbed points and function values shared by the sparse finite
+ * difference estimators: the colors are dealt out to slots, each with its
+ * own buffers, which run concurrently*/
+template <typename Scalar> class Slots {
+private:
+  /*! Number of variables and of function values*/
+  size_t n, m;
+  /*! Number of slots*/
+  size_t count;
+  /*! Perturbed point, and values at +h and -h, of each slot*/
+  std::vector<Scalar> points, plus, minus;
+
+public:
+  Slots() : n(0), m(0), count(0) {}
+  /*! Allocate buffers for up to count slots*/
+  Slots(size_t n, size_t m, size_t count, bool central)
+      : n(n), m(m), count(std::max<size_t>(count, 1)),
+        points(this->count * n), plus(this->count * m),
+        minus(central ? this->count * m : 0) {}
+  /*! Get the number of slots*/
+  size_t get_count() const { return this->count; }
+  /*! Get the point of a slot*/
+  Scalar *point(size_t slot) { return this->points.data() + slot * this->n; }
+  /*! Get the values at x + h of a slot*/
+  Scalar *value_plus(size_t slot) {
+    return this->plus.data() + slot * this->m;
+  }
+  /*! Get the values at x - h of a slot*/
+  Scalar *value_minus(size_t slot) {
+    return this->minus.data() + slot * this->m;
+  }
+};
+
+/*! Steps h_j = step max(|x_j|, 1), rounded so that x_j + h_j - x_j = h_j
+ * exactly*/
+template <typename Scalar>
+void compute_steps(Scalar const *x, size_t n, Scalar step, Scalar *h) {
+  for (size_t j = 0; j < n; j++) {
+    Scalar shifted = x[j] + step * std::max(std::abs(x[j]), Scalar{1});
+    h[j] = shifted - x[j];
+  }
+}
+
+/*! Default relative step of a formula*/
+template <typename Scalar>
+Scalar default_step(FiniteDifferenceOptions<Scalar> const &options) {
+  if (options.step > 0) {
+    return options.step;
+  }
+  Scalar eps = std::numeric_limits<Scalar>::epsilon();
+  return options.formula == DifferenceFormula::central ? std::cbrt(eps)
+                                                       : std::sqrt(eps);
+}
+
+/*! Evaluate the differences of every color and hand each to scatter.
+ *
+ * For color c, evaluate(point, values) is called at x + h d_c (and
+ * x - h d_c), where d_c is the sum of the unit vectors of the columns of
+ * color c, and scatter(c, difference) receives f(x + h d_c) - f(x) (or
+ * (f(x + h d_c) - f(x - h d_c)) / 2) in the slot's plus buffer.
+ * */
+template <typename Scalar, typename Evaluate, typename Scatter>
+void evaluate_colors(teensymat::Coloring const &coloring, Slots<Scalar> &slots,
+                     Scalar const *x, Scalar const *base, Scalar const *h,
+                     size_t n, size_t m, bool central, bool parallel,
+                     Evaluate const &evaluate, Scatter const &scatter) {
+  size_t colors = coloring.num_colors;
+  size_t count = parallel ? std::min(slots.get_count(), colors) : 1;
+  auto run_slot = [&](size_t slot) {
+    Scalar *point = slots.point(slot);
+    Scalar *plus = slots.value_plus(slot);
+    Scalar *minus = slots.value_minus(slot);
+    std::copy(x, x + n, point);
+    for (size_t c = slot; c < colors; c += count) {
+      size_t begin = coloring.color_ptr[c];
+      size_t end = coloring.color_ptr[c + 1];
+      for (size_t k = begin; k < end; k++) {
+        size_t j = coloring.columns[k];
+        point[j] = x[j] + h[j];
+      }
+      evaluate(point, plus);
+      if (central) {
+        for (size_t k = begin; k < end; k++) {
+          size_t j = coloring.columns[k];
+          point[j] = x[j] - h[j];
+        }
+        evaluate(point, minus);
+        for (size_t i = 0; i < m; i++) {
+          plus[i] = (plus[i] - minus[i]) / 2;
+        }
+      } else {
+        for (size_t i = 0; i < m; i++) {
+          plus[i] -= base[i];
+        }
+      }
+      for (size_t k = begin; k < end; k++) {
+        size_t j = coloring.columns[k];
+        point[j] = x[j];
+      }
+      scatter(c, plus);
+    }
+  };
+  if (count > 1) {
+    teensymat::ThreadPool::global().run(count, run_slot);
+  } else if (count == 1) {
+    run_slot(0);
+  }
+}
+} // namespace finite_difference_detail
+
+/*! Finite difference estimates of sparse Jacobians.
+ *
+ * The columns of the sparsity pattern are colored once (color_columns),
+ * so that columns of one color share no row: a single evaluation at x
+ * plus a step along all of them gives each of their nonzeros, and the
+ * Jacobian costs one evaluation per color instead of one per column (two
+ * with central differences). With FiniteDifferenceOptions::parallel the
+ * colors are evaluated concurrently, each worker with its own point and
+ * value buffers allocated by the constructor, and the differences are
+ * written straight into the values of the CSC Jacobian.
+ * */
+template <typename Scalar> class SparseJacobianFD {
+private:
+  /*! Options of the estimates*/
+  FiniteDifferenceOptions<Scalar> options;
+  /*! The sparsity pattern*/
+  teensymat::SparseMatrix<Scalar> pattern;
+  /*! Coloring of its columns*/
+  teensymat::Coloring coloring;
+  /*! Buffers of the concurrent evaluations*/
+  finite_difference_detail::Slots<Scalar> slots;
+  /*! Function values at x, and the steps*/
+  std::vector<Scalar> base, steps;
+  /*! Number of evaluations of the last estimate*/
+  size_t evaluations;
+
+public:
+  // SECTION: Constructors
+  /*! Prepare the estimates of a Jacobian.
+   *
+   * @param pattern Sparsity pattern of the Jacobian (m x n; its values are
+   * ignored)
+   * @param options Options of the estimates
+   * */
+  explicit SparseJacobianFD(teensymat::SparseMatrix<Scalar> pattern,
+                            FiniteDifferenceOptions<Scalar> options = {})
+      : options(options), pattern(std::move(pattern)), evaluations(0) {
+    size_t m = this->pattern.get_nrows();
+    size_t n = this->pattern.get_ncols();
+    this->coloring = teensymat::color_columns(this->pattern, options.order);
+    this->slots = finite_difference_detail::Slots<Scalar>{
+        n, m, teensymat::ThreadPool::global().get_num_threads(),
+        options.formula == DifferenceFormula::central};
+    this->base.assign(m, 0);
+    this->steps.assign(n, 0);
+  }
+
+  // SECTION: Getters
+  /*! Get the sparsity pattern*/
+  teensymat::SparseMatrix<Scalar> const &get_pattern() const {
+    return this->pattern;
+  }
+  /*! Get the coloring of the columns*/
+  teensymat::Coloring const &get_coloring() const { return this->coloring; }
+  /*! Get the number of colors*/
+  size_t get_num_colors() const { return this->coloring.num_colors; }
+  /*! Get the number of function evaluations of the last estimate*/
+  size_t get_evaluations() const { return this->evaluations; }
+
+  // SECTION: Estimates
+  /*! Estimate the Jacobian of a function.
+   *
+   * @param function The function (m values of n variables)
+   * @param x The point
+   * @param jacobian Overwritten with the estimate; must have the pattern
+   * given to the constructor
+   * @param value The function at x, or nullptr to evaluate it (unused by
+   * central differences)
+   * */
+  void estimate(Residual<Scalar> const &function, Scalar const *x,
+                teensymat::SparseMatrix<Scalar> &jacobian,
+                Scalar const *value = nullptr) {
+    size_t m = this->pattern.get_nrows();
+    size_t n = this->pattern.get_ncols();
+    if (jacobian.get_nnz() != this->pattern.get_nnz() ||
+        jacobian.get_ncols() != n || jacobian.get_nrows() != m) {
+      throw std::range_error("Jacobian does not have the sparsity pattern");
+    }
+    bool central = this->options.formula == DifferenceFormula::central;
+    this->evaluations = 0;
+    if (!central && value == nullptr) {
+      function(x, this->base.data());
+      this->evaluations++;
+      value = this->base.data();
+    }
+    finite_difference_detail::compute_steps(
+        x, n, finite_difference_detail::default_step(this->options),
+        this->steps.data());
+    auto const &col_ptr = this->pattern.get_col_ptr();
+    auto const &row_idx = this->pattern.get_row_idx();
+    Scalar *values = jacobian.get_values()->data();
+    Scalar const *h = this->steps.data();
+    auto const &coloring = this->coloring;
+    finite_difference_detail::evaluate_colors(
+        coloring, this->slots, x, value, h, n, m, central,
+        this->options.parallel,
+        function,
+        [&](size_t c, Scalar const *difference) {
+          for (size_t k = coloring.color_ptr[c]; k < coloring.color_ptr[c + 1];
+               k++) {
+            size_t j = coloring.columns[k];
+            for (size_t p = col_ptr[j]; p < col_ptr[j + 1]; p++) {
+              values[p] = difference[row_idx[p]] / h[j];
+            }
+          }
+        });
+    this->evaluations += (central ? 2 : 1) * coloring.num_colors;
+  }
+  /*! The estimate as a Jacobian for LeastSquares, which passes it the
+   * residuals at x so that forward differences need no evaluation there.
+   *
+   * @param function The function whose Jacobian is estimated
+   * @return A SparseJacobianWithResidual holding a copy of function and
+   * referring to this estimator, which must outlive it
+   * */
+  SparseJacobianWithResidual<Scalar> as_jacobian(Residual<Scalar> function) {
+    return [this, function = std::move(function)](
+               Scalar const *x, Scalar const *residual,
+               teensymat::SparseMatrix<Scalar> &jacobian) {
+      this->estimate(function, x, jacobian, residual);
+    };
+  }
+};
+
+/*! Finite difference estimates of sparse Hessians from gradients.
+ *
+ * The symmetric pattern is star colored once (color_star): a distance-1
+ * coloring in which every path on four vertices has at least three
+ * colors. Each nonzero (i, j) is then the only contribution of its color
+ * to row i of one gradient difference, or symmetrically to row j, so the
+ * Hessian is read directly from one gradient evaluation per color (two
+ * with central differences), typically many fewer than the column
+ * coloring of the same pattern needs. Colors may be evaluated
+ * concurrently as in SparseJacobianFD, and the entries are written into
+ * the CSC values.
+ * */
+template <typename Scalar> class SparseHessianFD {
+private:
+  /*! Options of the estimates*/
+  FiniteDifferenceOptions<Scalar> options;
+  /*! The sparsity pattern*/
+  teensymat::SparseMatrix<Scalar> pattern;
+  /*! Star coloring of the symmetric pattern*/
+  teensymat::Coloring coloring;
+  /*! Entries recovered from each color: those of color c are
+   * entry[entry_ptr[c]:entry_ptr[c+1]], read from row source_row and
+   * divided by the step of column source_column*/
+  std::vector<size_t> entry_ptr, entry, source_row, source_column;
+  /*! Buffers of the concurrent evaluations*/
+  finite_difference_detail::Slots<Scalar> slots;
+  /*! Gradient at x, and the steps*/
+  std::vector<Scalar> base, steps;
+  /*! Number of evaluations of the last estimate*/
+  size_t evaluations;
+
+public:
+  // SECTION: Constructors
+  /*! Prepare the estimates of a Hessian.
+   *
+   * @param pattern Sparsity pattern of the Hessian (n x n; either
+   * triangle or both may be given, and its values are ignored)
+   * @param options Options of the estimates
+   * */
+  explicit SparseHessianFD(teensymat::SparseMatrix<Scalar> pattern,
+                           FiniteDifferenceOptions<Scalar> options = {})
+      : options(options), pattern(std::move(pattern)), evaluations(0) {
+    size_t n = this->pattern.get_ncols();
+    this->coloring = teensymat::color_star(this->pattern, options.order);
+    auto const &col_ptr = this->pattern.get_col_ptr();
+    auto const &row_idx = this->pattern.get_row_idx();
+    auto const &colors = this->coloring.colors;
+    // Number of neighbours of each color, one vertex at a time
+    std::vector<std::vector<size_t>> adjacency(n);
+    for (size_t j = 0; j < n; j++) {
+      for (size_t p = col_ptr[j]; p < col_ptr[j + 1]; p++) {
+        size_t i = row_idx[p];
+        if (i != j) {
+          adjacency[i].push_back(j);
+          adjacency[j].push_back(i);
+        }
+      }
+    }
+    for (auto &neighbours : adjacency) {
+      std::sort(neighbours.begin(), neighbours.end());
+      neighbours.erase(std::unique(neighbours.begin(), neighbours.end()),
+                       neighbours.end());
+    }
+    auto unique_in_row = [&](size_t i, size_t j) {
+      size_t matches = 0;
+      for (size_t k : adjacency[i]) {
+        matches += colors[k] == colors[j];
+      }
+      return matches == 1;
+    };
+    // Source of each entry, grouped by color
+    size_t nnz = row_idx.size();
+    std::vector<size_t> color_of(nnz);
+    this->source_row.resize(nnz);
+    this->source_column.resize(nnz);
+    this->entry_ptr.assign(this->coloring.num_colors + 1, 0);
+    for (size_t j = 0; j < n; j++) {
+      for (size_t p = col_ptr[j]; p < col_ptr[j + 1]; p++) {
+        size_t i = row_idx[p];
+        if (i == j || unique_in_row(i, j)) {
+          this->source_row[p] = i;
+          this->source_column[p] = j;
+        } else {
+          this->source_row[p] = j;
+          this->source_column[p] = i;
+        }
+        color_of[p] = colors[this->source_column[p]];
+        this->entry_ptr[color_of[p] + 1]++;
+      }
+    }
+    for (size_t c = 0; c < this->coloring.num_colors; c++) {
+      this->entry_ptr[c + 1] += this->entry_ptr[c];
+    }
+    this->entry.resize(nnz);
+    std::vector<size_t> next(this->entry_ptr.begin(),
+                             this->entry_ptr.end() - 1);
+    for (size_t p = 0; p < nnz; p++) {
+      this->entry[next[color_of[p]]++] = p;
+    }
+    this->slots = finite_difference_detail::Slots<Scalar>{
+        n, n, teensymat::ThreadPool::global().get_num_threads(),
+        options.formula == DifferenceFormula::central};
+    this->base.assign(n, 0);
+    this->steps.assign(n, 0);
+  }
+
+  // SECTION: Getters
+  /*! Get the sparsity pattern*/
+  teensymat::SparseMatrix<Scalar> const &get_pattern() const {
+    return this->pattern;
+  }
+  /*! Get the star coloring*/
+  teensymat::Coloring const &get_coloring() const { return this->coloring; }
+  /*! Get the number of colors*/
+  size_t get_num_colors() const { return this->coloring.num_colors; }
+  /*! Get the number of gradient evaluations of the last estimate*/
+  size_t get_evaluations() const { return this->evaluations; }
+
+  // SECTION: Estimates
+  /*! Estimate the Hessian of an objective from its gradients.
+   *
+   * @param objective The objective and its gradient
+   * @param x The point
+   * @param hessian Overwritten with the estimate; must have the pattern
+   * given to the constructor
+   * @param gradient The gradient at x, or nullptr to evaluate it (unused
+   * by central differences)
+   * */
+  void estimate(Objective<Scalar> const &objective, Scalar const *x,
+                teensymat::SparseMatrix<Scalar> &hessian,
+                Scalar const *gradient = nullptr) {
+    size_t n = this->pattern.get_ncols();
+    if (hessian.get_nnz() != this->pattern.get_nnz() ||
+        hessian.get_ncols() != n || hessian.get_nrows() != n) {
+      throw std::range_error("Hessian does not have the sparsity pattern");
+    }
+    bool central = this->options.formula == DifferenceFormula::central;
+    this->evaluations = 0;
+    if (!central && gradient == nullptr) {
+      objective(x, this->base.data());
+      this->evaluations++;
+      gradient = this->base.data();
+    }
+    finite_difference_detail::compute_steps(
+        x, n, finite_difference_detail::default_step(this->options),
+        this->steps.data());
+    Scalar *values = hessian.get_values()->data();
+    Scalar const *h = this->steps.data();
+    finite_difference_detail::evaluate_colors(
+        this->coloring, this->slots, x, gradient, h, n, n, central,
+        this->options.parallel,
+        objective,
+        [&](size_t c, Scalar const *difference) {
+          for (size_t k = this->entry_ptr[c]; k < this->entry_ptr[c + 1];
+               k++) {
+            size_t p = this->entry[k];
+            values[p] = difference[this->source_row[p]] /
+                        h[this->source_column[p]];
+          }
+        });
+    this->evaluations += (central ? 2 : 1) * this->coloring.num_colors;
+  }
+};
+} // namespace teensynlp
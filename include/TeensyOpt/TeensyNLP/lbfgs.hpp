@@ -0,0 +1,200 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/lbfgs_memory.hpp"
+#include "TeensyOpt/TeensyMat/linalg.hpp"
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+#include "TeensyOpt/TeensyNLP/line_search.hpp"
+#include "TeensyOpt/TeensyNLP/nlp_problem.hpp"
+
+namespace teensynlp {
+/*! Options of LBFGS*/
+template <typename Scalar> struct LBFGSOptions {
+  /*! Number of correction pairs kept*/
+  size_t memory = 10;
+  /*! Maximum number of iterations*/
+  size_t max_iterations = 1000;
+  /*! Converged when the infinity norm of the gradient is below this*/
+  Scalar gradient_tolerance = 1e-6;
+  /*! Stop when f_k - f_{k+1} <= function_tolerance * max(|f_k|, |f_{k+1}|,
+   * 1) (0 disables the test)*/
+  Scalar function_tolerance = 0;
+  /*! Options of the line search*/
+  LineSearchOptions<Scalar> line_search = {};
+};
+
+/*! Limited memory BFGS minimizer of smooth unconstrained objectives.
+ *
+ * Directions come from teensymat::LBFGSMemory and steps from a
+ * LineSearch (More and Thuente's strong Wolfe search by default). The
+ * point is kept in the caller's buffer and one internal buffer, which swap
+ * roles when a step is accepted, and the line search writes gradients
+ * into two internal buffers, so the value and gradient of the accepted
+ * trial point are reused without evaluating it again. All storage is
+ * allocated by the constructor: an iteration allocates nothing.
+ * */
+template <typename Scalar> class LBFGS {
+private:
+  /*! Options of the solve*/
+  LBFGSOptions<Scalar> options;
+  /*! Number of variables*/
+  size_t n;
+  /*! The inverse Hessian approximation*/
+  teensymat::LBFGSMemory<Scalar> memory;
+  /*! Search direction and second point buffer*/
+  std::vector<Scalar> direction, point;
+  /*! Gradient at the current point and at the trial point*/
+  std::vector<Scalar> gradient, trial_gradient;
+  /*! The line search*/
+  LineSearch<Scalar> search;
+  /*! Number of evaluations in the current solve*/
+  size_t evaluations;
+
+public:
+  // SECTION: Constructors
+  /*! Allocate a minimizer.
+   *
+   * @param n Number of variables
+   * @param options Options of the solves
+   * */
+  explicit LBFGS(size_t n, LBFGSOptions<Scalar> options = {})
+      : options(options), n(n), memory(n, options.memory), direction(n),
+        point(n), gradient(n), trial_gradient(n),
+        search(n, options.line_search), evaluations(0) {}
+
+  // SECTION: Getters
+  /*! Get the number of variables*/
+  size_t get_dim() const { return this->n; }
+  /*! Get the gradient at the point returned by the last solve*/
+  std::vector<Scalar> const &get_gradient() const { return this->gradient; }
+  /*! Get the inverse Hessian approximation of the last solve*/
+  teensymat::LBFGSMemory<Scalar> const &get_memory() const {
+    return this->memory;
+  }
+
+  // SECTION: Solving
+  /*! Minimize an objective.
+   *
+   * @param objective The objective and its gradient
+   * @param x The starting point, overwritten with the final point (n
+   * values)
+   * @return Summary of the solve
+   * */
+  NLPSolution<Scalar> minimize(Objective<Scalar> const &objective,
+                               Scalar *x) {
+    size_t n = this->n;
+    NLPSolution<Scalar> result;
+    this->evaluations = 0;
+    this->memory.reset();
+    Scalar *current = x;
+    Scalar *trial = this->point.data();
+    Scalar *d = this->direction.data();
+    Scalar value = objective(current, this->gradient.data());
+    this->evaluations++;
+    bool stalled = false;
+    for (;;) {
+      Scalar const *g = this->gradient.data();
+      Scalar norm = 0;
+      for (size_t i = 0; i < n; i++) {
+        norm = std::max(norm, std::abs(g[i]));
+      }
+      result.objective = value;
+      result.gradient_norm = norm;
+      if (!std::isfinite(value) || !std::isfinite(norm)) {
+        result.status = NLPStatus::numerical_error;
+        break;
+      }
+      if (norm <= this->options.gradient_tolerance) {
+        result.status = NLPStatus::converged;
+        break;
+      }
+      if (stalled) {
+        result.status = NLPStatus::function_tolerance;
+        break;
+      }
+      if (result.iterations >= this->options.max_iterations) {
+        result.status = NLPStatus::iteration_limit;
+        break;
+      }
+      this->memory.direction(g, d);
+      Scalar slope = teensymat::dot(n, g, d);
+      if (!(slope < 0)) {
+        this->memory.reset();
+        this->memory.direction(g, d);
+        slope = teensymat::dot(n, g, d);
+      }
+      Scalar step = 1;
+      if (this->memory.get_size() == 0) {
+        step = std::min(Scalar{1}, 1 / teensymat::nrm2(n, g));
+      }
+      Scalar trial_value;
+      bool found = this->search.search(objective, current, d, value, slope,
+                                       step, trial,
+                                       this->trial_gradient.data(),
+                                       trial_value);
+      this->evaluations += this->search.get_evaluations();
+      if (!found) {
+        if (this->memory.get_size() > 0) {
+          // Retry along the steepest descent direction
+          this->memory.reset();
+          continue;
+        }
+        result.status = NLPStatus::line_search_failure;
+        break;
+      }
+      // New correction pair, with its products in the same pass
+      Scalar *s = this->memory.next_s();
+      Scalar *y = this->memory.next_y();
+      Scalar const *trial_g = this->trial_gradient.data();
+      Scalar sy = 0;
+      Scalar yy = 0;
+      for (size_t i = 0; i < n; i++) {
+        s[i] = trial[i] - current[i];
+        y[i] = trial_g[i] - g[i];
+        sy += s[i] * y[i];
+        yy += y[i] * y[i];
+      }
+      this->memory.commit(sy, yy);
+      std::swap(current, trial);
+      this->gradient.swap(this->trial_gradient);
+      result.iterations++;
+      Scalar decrease = value - trial_value;
+      Scalar size = std::max({std::abs(value), std::abs(trial_value),
+                              Scalar{1}});
+      value = trial_value;
+      stalled = this->options.function_tolerance > 0 &&
+                decrease <= this->options.function_tolerance * size;
+    }
+    if (current != x) {
+      std::copy(current, current + n, x);
+    }
+    result.evaluations = this->evaluations;
+    return result;
+  }
+};
+
+/*! Minimize an objective with LBFGS.
+ *
+ * @param objective The objective and its gradient
+ * @param x The starting point, overwritten with the final point
+ * @param options Options of the solve
+ * @return Summary of the solve
+ * */
+template <typename Scalar>
+NLPSolution<Scalar>
+minimize_lbfgs(std::type_identity_t<Objective<Scalar>> const &objective,
+               std::vector<Scalar> &x,
+               LBFGSOptions<Scalar> const &options = {}) {
+  LBFGS<Scalar> solver{x.size(), options};
+  return solver.minimize(objective, x.data());
+}
+} // namespace teensynlp
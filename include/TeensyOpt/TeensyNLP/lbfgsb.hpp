@@ -0,0 +1,560 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/factorize.hpp"
+#include "TeensyOpt/TeensyMat/lbfgs_memory.hpp"
+#include "TeensyOpt/TeensyMat/linalg.hpp"
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+#include "TeensyOpt/TeensyNLP/line_search.hpp"
+#include "TeensyOpt/TeensyNLP/nlp_problem.hpp"
+
+namespace teensynlp {
+/*! Options of LBFGSB*/
+template <typename Scalar> struct LBFGSBOptions {
+  /*! Number of correction pairs kept*/
+  size_t memory = 10;
+  /*! Maximum number of iterations*/
+  size_t max_iterations = 1000;
+  /*! Converged when the infinity norm of the projected gradient
+   * P(x - g) - x is below this*/
+  Scalar gradient_tolerance = 1e-6;
+  /*! Stop when f_k - f_{k+1} <= function_tolerance * max(|f_k|, |f_{k+1}|,
+   * 1) (0 disables the test)*/
+  Scalar function_tolerance = 0;
+  /*! Options of the line search*/
+  LineSearchOptions<Scalar> line_search = {};
+};
+
+/*! L-BFGS-B minimizer of smooth objectives subject to bounds
+ * lower <= x <= upper (Byrd, Lu, Nocedal and Zhu).
+ *
+ * The limited memory Hessian is used in its compact form
+ *
+ *     B = theta I - W M W^T,  W = [Y, theta S],
+ *     M = [[-D, L^T], [L, theta S^T S]]^-1
+ *
+ * with D and L the diagonal and strictly lower triangle of S^T Y. S^T Y
+ * and S^T S are kept in Matrix blocks updated with one new row and column
+ * per pair (and shifted when the oldest pair is dropped), and products
+ * with M use a Cholesky factor of the m x m matrix
+ * theta S^T S + L D^-1 L^T. Each iteration:
+ *
+ * 1. finds the generalized Cauchy point, the first minimizer of the model
+ *    along the projected steepest descent path, visiting the breakpoints
+ *    in order through a heap (usually only a few are visited);
+ * 2. minimizes the model over the variables free at the Cauchy point by
+ *    the direct primal method (Sherman-Morrison-Woodbury on the reduced
+ *    B), projecting the result onto the bounds, and falling back to the
+ *    truncated step if the projection is not a descent direction;
+ * 3. searches along d = x_bar - x with a LineSearch, no farther than the
+ *    bounds allow, reusing the value and gradient of the accepted trial
+ *    point.
+ * */
+template <typename Scalar> class LBFGSB {
+private:
+  /*! Options of the solve*/
+  LBFGSBOptions<Scalar> options;
+  /*! Number of variables*/
+  size_t n;
+  /*! The bounds (infinite for missing ones)*/
+  std::vector<Scalar> lower, upper;
+  /*! The correction pairs*/
+  teensymat::LBFGSMemory<Scalar> memory;
+  /*! S^T Y and S^T S of the stored pairs, oldest first, in the leading
+   * block*/
+  teensymat::Matrix<Scalar> sty, sts;
+  /*! Pointers to the stored s and y, oldest first*/
+  std::vector<Scalar const *> s_ptr, y_ptr;
+  /*! theta of the compact form*/
+  Scalar theta;
+  /*! Factor of theta S^T S + L D^-1 L^T (empty without pairs)*/
+  std::optional<teensymat::CholeskyFactorization<Scalar>> middle;
+  /*! Second point buffer, gradient at the current and at the trial point*/
+  std::vector<Scalar> point, gradient, trial_gradient;
+  /*! Generalized Cauchy point, and the search direction (the steepest
+   * descent path while the Cauchy point is computed)*/
+  std::vector<Scalar> cauchy, direction;
+  /*! Breakpoints (t_i, i) of the projected path, kept as a heap*/
+  std::vector<std::pair<Scalar, size_t>> breakpoints;
+  /*! Variables free at the Cauchy point and their reduced gradient*/
+  std::vector<size_t> free_vars;
+  std::vector<Scalar> reduced;
+  /*! Vectors of length 2m: p = W^T d, c = W^T (x_c - x), a row of W and
+   * products with M*/
+  std::vector<Scalar> p, c, w_row, mp, mc, mw, v;
+  /*! W^T Z Z^T W over the free variables*/
+  teensymat::Matrix<Scalar> wzzw;
+  /*! The line search, clamping trials to the bounds*/
+  LineSearch<Scalar> search;
+  /*! Number of evaluations in the current solve*/
+  size_t evaluations;
+
+  // SECTION: Compact representation
+  /*! Add the newest pair to S^T Y and S^T S, first shifting out the
+   * oldest one if it was dropped*/
+  void update_compact(bool dropped) {
+    size_t q = this->memory.get_size();
+    if (dropped) {
+      for (size_t i = 0; i + 1 < q; i++) {
+        for (size_t j = 0; j + 1 < q; j++) {
+          *this->sty(i, j) = *this->sty(i + 1, j + 1);
+          *this->sts(i, j) = *this->sts(i + 1, j + 1);
+        }
+      }
+    }
+    size_t k = q - 1;
+    Scalar const *s_new = this->memory.get_s(k);
+    Scalar const *y_new = this->memory.get_y(k);
+    for (size_t i = 0; i < q; i++) {
+      Scalar const *s = this->memory.get_s(i);
+      *this->sty(k, i) = teensymat::dot(this->n, s_new, this->memory.get_y(i));
+      *this->sty(i, k) = teensymat::dot(this->n, s, y_new);
+      Scalar ss = teensymat::dot(this->n, s_new, s);
+      *this->sts(k, i) = ss;
+      *this->sts(i, k) = ss;
+    }
+  }
+  /*! Set theta and factor theta S^T S + L D^-1 L^T for the current pairs
+   * (forgetting them if the factorization fails)*/
+  void prepare_compact() {
+    size_t q = this->memory.get_size();
+    this->middle.reset();
+    this->theta = q > 0 ? 1 / this->memory.get_scaling() : Scalar{1};
+    for (size_t k = 0; k < q; k++) {
+      this->s_ptr[k] = this->memory.get_s(k);
+      this->y_ptr[k] = this->memory.get_y(k);
+    }
+    if (q == 0) {
+      return;
+    }
+    teensymat::Matrix<Scalar> t{q, q};
+    for (size_t i = 0; i < q; i++) {
+      for (size_t j = 0; j <= i; j++) {
+        Scalar sum = this->theta * *this->sts(i, j);
+        for (size_t k = 0; k < j; k++) {
+          sum += *this->sty(i, k) * *this->sty(j, k) / *this->sty(k, k);
+        }
+        *t(i, j) = sum;
+        *t(j, i) = sum;
+      }
+    }
+    try {
+      this->middle.emplace(t);
+    } catch (std::runtime_error const &) {
+      this->memory.reset();
+    }
+  }
+  /*! out = M in for vectors of length 2q, by block elimination:
+   * u2 = T^-1 (in2 + L D^-1 in1), u1 = D^-1 (L^T u2 - in1)*/
+  void apply_middle(Scalar const *in, Scalar *out) const {
+    size_t q = this->memory.get_size();
+    Scalar *u1 = out;
+    Scalar *u2 = out + q;
+    for (size_t i = 0; i < q; i++) {
+      Scalar sum = in[q + i];
+      for (size_t k = 0; k < i; k++) {
+        sum += *this->sty(i, k) * in[k] / *this->sty(k, k);
+      }
+      u2[i] = sum;
+    }
+    this->middle->solve_inplace(u2);
+    for (size_t k = 0; k < q; k++) {
+      Scalar sum = -in[k];
+      for (size_t i = k + 1; i < q; i++) {
+        sum += *this->sty(i, k) * u2[i];
+      }
+      u1[k] = sum / *this->sty(k, k);
+    }
+  }
+  /*! Row i of W = [Y, theta S] into out*/
+  void get_w_row(size_t i, Scalar *out) const {
+    size_t q = this->memory.get_size();
+    for (size_t k = 0; k < q; k++) {
+      out[k] = this->y_ptr[k][i];
+      out[q + k] = this->theta * this->s_ptr[k][i];
+    }
+  }
+
+  // SECTION: Steps
+  /*! Generalized Cauchy point of the model from x into cauchy, with
+   * c = W^T (cauchy - x)*/
+  void cauchy_point(Scalar const *x, Scalar const *g) {
+    size_t n = this->n;
+    size_t width = 2 * this->memory.get_size();
+    Scalar theta = this->theta;
+    Scalar *d = this->direction.data();
+    this->breakpoints.clear();
+    Scalar slope = 0;
+    for (size_t i = 0; i < n; i++) {
+      Scalar t = infinity<Scalar>;
+      if (g[i] < 0 && this->upper[i] < infinity<Scalar>) {
+        t = (x[i] - this->upper[i]) / g[i];
+      } else if (g[i] > 0 && this->lower[i] > -infinity<Scalar>) {
+        t = (x[i] - this->lower[i]) / g[i];
+      }
+      d[i] = t == 0 ? Scalar{0} : -g[i];
+      if (t > 0 && t < infinity<Scalar>) {
+        this->breakpoints.emplace_back(t, i);
+      }
+      slope -= d[i] * d[i];
+      this->cauchy[i] = x[i];
+    }
+    std::fill(this->c.begin(), this->c.begin() + width, Scalar{0});
+    size_t q = width / 2;
+    for (size_t k = 0; k < q; k++) {
+      this->p[k] = teensymat::dot(n, this->y_ptr[k], d);
+      this->p[q + k] = theta * teensymat::dot(n, this->s_ptr[k], d);
+    }
+    Scalar curvature = -theta * slope;
+    if (width > 0) {
+      this->apply_middle(this->p.data(), this->mp.data());
+      curvature -= teensymat::dot(width, this->p.data(), this->mp.data());
+    }
+    Scalar min_curvature =
+        std::numeric_limits<Scalar>::epsilon() * std::abs(curvature);
+    curvature = std::max(curvature, min_curvature);
+    Scalar step_min = curvature > 0 ? -slope / curvature : Scalar{0};
+    Scalar t_old = 0;
+    auto later = std::greater<std::pair<Scalar, size_t>>{};
+    std::make_heap(this->breakpoints.begin(), this->breakpoints.end(), later);
+    while (!this->breakpoints.empty()) {
+      auto [t, b] = this->breakpoints.front();
+      Scalar dt = t - t_old;
+      if (step_min < dt) {
+        break;
+      }
+      std::pop_heap(this->breakpoints.begin(), this->breakpoints.end(),
+                    later);
+      this->breakpoints.pop_back();
+      // Move to breakpoint b, where x_b reaches its bound
+      Scalar bound = d[b] > 0 ? this->upper[b] : this->lower[b];
+      Scalar z = bound - x[b];
+      this->cauchy[b] = bound;
+      teensymat::axpy(width, dt, this->p.data(), this->c.data());
+      Scalar gb = g[b];
+      slope += dt * curvature + gb * gb + theta * gb * z;
+      curvature -= theta * gb * gb;
+      if (width > 0) {
+        this->get_w_row(b, this->w_row.data());
+        this->apply_middle(this->w_row.data(), this->mw.data());
+        Scalar const *mw = this->mw.data();
+        slope -= gb * teensymat::dot(width, mw, this->c.data());
+        curvature -= 2 * gb * teensymat::dot(width, mw, this->p.data()) +
+                     gb * gb * teensymat::dot(width, mw, this->w_row.data());
+        teensymat::axpy(width, gb, this->w_row.data(), this->p.data());
+      }
+      curvature = std::max(curvature, min_curvature);
+      d[b] = 0;
+      t_old = t;
+      step_min = slope < 0 && curvature > 0 ? -slope / curvature : Scalar{0};
+    }
+    step_min = std::max(step_min, Scalar{0});
+    t_old += step_min;
+    for (size_t i = 0; i < n; i++) {
+      if (d[i] != Scalar{0}) {
+        this->cauchy[i] = x[i] + t_old * d[i];
+      }
+    }
+    teensymat::axpy(width, step_min, this->p.data(), this->c.data());
+  }
+  /*! Minimize the model over the variables free at the Cauchy point,
+   * writing the search direction (from x) into direction*/
+  void subspace_minimization(Scalar const *x, Scalar const *g) {
+    size_t n = this->n;
+    size_t q = this->memory.get_size();
+    size_t width = 2 * q;
+    Scalar theta = this->theta;
+    Scalar const *cauchy = this->cauchy.data();
+    Scalar *d = this->direction.data();
+    this->free_vars.clear();
+    for (size_t i = 0; i < n; i++) {
+      if (cauchy[i] > this->lower[i] && cauchy[i] < this->upper[i]) {
+        this->free_vars.push_back(i);
+      }
+    }
+    size_t count = this->free_vars.size();
+    // Reduced gradient Z^T (g + theta (x_c - x) - W M c)
+    if (width > 0) {
+      this->apply_middle(this->c.data(), this->mc.data());
+    }
+    Scalar *w = this->w_row.data();
+    for (size_t j = 0; j < count; j++) {
+      size_t i = this->free_vars[j];
+      Scalar value = g[i] + theta * (cauchy[i] - x[i]);
+      if (width > 0) {
+        this->get_w_row(i, w);
+        value -= teensymat::dot(width, w, this->mc.data());
+      }
+      this->reduced[j] = value;
+    }
+    // v = N^-1 M W^T Z r with N = I - M W^T Z Z^T W / theta
+    bool solved = width > 0 && count > 0;
+    if (solved) {
+      std::fill(this->v.begin(), this->v.begin() + width, Scalar{0});
+      for (size_t a = 0; a < width; a++) {
+        std::fill(this->wzzw(a, 0), this->wzzw(a, 0) + width, Scalar{0});
+      }
+      for (size_t j = 0; j < count; j++) {
+        this->get_w_row(this->free_vars[j], w);
+        teensymat::axpy(width, this->reduced[j], w, this->v.data());
+        for (size_t a = 0; a < width; a++) {
+          teensymat::axpy(width, w[a], w, this->wzzw(a, 0));
+        }
+      }
+      this->apply_middle(this->v.data(), this->mc.data());
+      teensymat::Matrix<Scalar> system{width, width};
+      for (size_t b = 0; b < width; b++) {
+        // Column b of M W^T Z Z^T W (which is symmetric)
+        this->apply_middle(this->wzzw(b, 0), this->mw.data());
+        for (size_t a = 0; a < width; a++) {
+          *system(a, b) = (a == b ? Scalar{1} : Scalar{0}) -
+                          this->mw[a] / theta;
+        }
+      }
+      teensymat::LUFactorization<Scalar> lu{system};
+      solved = !lu.is_singular();
+      if (solved) {
+        lu.solve_inplace(this->mc.data());
+      }
+    }
+    // Subspace step, projected onto the bounds
+    std::copy(cauchy, cauchy + n, this->point_scratch());
+    Scalar *target = this->point_scratch();
+    for (size_t j = 0; j < count; j++) {
+      size_t i = this->free_vars[j];
+      Scalar step = -this->reduced[j] / theta;
+      if (solved) {
+        this->get_w_row(i, w);
+        step -= teensymat::dot(width, w, this->mc.data()) / (theta * theta);
+      }
+      this->reduced[j] = step;
+      target[i] = std::clamp(cauchy[i] + step, this->lower[i], this->upper[i]);
+    }
+    for (size_t i = 0; i < n; i++) {
+      d[i] = target[i] - x[i];
+    }
+    if (teensymat::dot(n, g, d) < 0) {
+      return;
+    }
+    // Not a descent direction: truncate the step at the bounds instead
+    Scalar fraction = 1;
+    for (size_t j = 0; j < count; j++) {
+      size_t i = this->free_vars[j];
+      Scalar step = this->reduced[j];
+      if (step > 0) {
+        fraction = std::min(fraction, (this->upper[i] - cauchy[i]) / step);
+      } else if (step < 0) {
+        fraction = std::min(fraction, (this->lower[i] - cauchy[i]) / step);
+      }
+    }
+    for (size_t i = 0; i < n; i++) {
+      d[i] = cauchy[i] - x[i];
+    }
+    for (size_t j = 0; j < count; j++) {
+      d[this->free_vars[j]] += fraction * this->reduced[j];
+    }
+  }
+  /*! Scratch point, the trial gradient buffer (free until the line
+   * search)*/
+  Scalar *point_scratch() { return this->trial_gradient.data(); }
+
+public:
+  // SECTION: Constructors
+  /*! Allocate a minimizer.
+   *
+   * Throws std::range_error if the bounds do not have n entries or
+   * lower > upper somewhere.
+   *
+   * @param lower Lower bounds (-infinity for none)
+   * @param upper Upper bounds (infinity for none)
+   * @param options Options of the solves
+   * */
+  LBFGSB(std::vector<Scalar> lower, std::vector<Scalar> upper,
+         LBFGSBOptions<Scalar> options = {})
+      : options(options), n(lower.size()), lower(std::move(lower)),
+        upper(std::move(upper)), memory(this->n, options.memory),
+        sty(options.memory, options.memory),
+        sts(options.memory, options.memory), s_ptr(options.memory),
+        y_ptr(options.memory), theta(1), point(this->n),
+        gradient(this->n), trial_gradient(this->n), cauchy(this->n),
+        direction(this->n), reduced(this->n),
+        p(2 * options.memory), c(2 * options.memory),
+        w_row(2 * options.memory), mp(2 * options.memory),
+        mc(2 * options.memory), mw(2 * options.memory),
+        v(2 * options.memory), wzzw(2 * options.memory, 2 * options.memory),
+        search(this->n, options.line_search), evaluations(0) {
+    if (this->upper.size() != this->n) {
+      throw std::range_error("Bounds of LBFGSB have different lengths");
+    }
+    for (size_t i = 0; i < this->n; i++) {
+      if (!(this->lower[i] <= this->upper[i])) {
+        throw std::range_error("Lower bound above upper bound in LBFGSB");
+      }
+    }
+    this->breakpoints.reserve(this->n);
+    this->free_vars.reserve(this->n);
+    this->search.set_bounds(this->lower.data(), this->upper.data());
+  }
+
+  // SECTION: Getters
+  /*! Get the number of variables*/
+  size_t get_dim() const { return this->n; }
+  /*! Get the gradient at the point returned by the last solve*/
+  std::vector<Scalar> const &get_gradient() const { return this->gradient; }
+  /*! Get S^T Y of the stored pairs (leading block, oldest first)*/
+  teensymat::Matrix<Scalar> const &get_sty() const { return this->sty; }
+  /*! Get the correction pairs of the last solve*/
+  teensymat::LBFGSMemory<Scalar> const &get_memory() const {
+    return this->memory;
+  }
+
+  // SECTION: Solving
+  /*! Minimize an objective within the bounds.
+   *
+   * @param objective The objective and its gradient
+   * @param x The starting point (projected onto the bounds), overwritten
+   * with the final point (n values)
+   * @return Summary of the solve
+   * */
+  NLPSolution<Scalar> minimize(Objective<Scalar> const &objective,
+                               Scalar *x) {
+    size_t n = this->n;
+    NLPSolution<Scalar> result;
+    this->evaluations = 0;
+    this->memory.reset();
+    for (size_t i = 0; i < n; i++) {
+      x[i] = std::clamp(x[i], this->lower[i], this->upper[i]);
+    }
+    Scalar *current = x;
+    Scalar *trial = this->point.data();
+    Scalar value = objective(current, this->gradient.data());
+    this->evaluations++;
+    bool stalled = false;
+    for (;;) {
+      Scalar const *g = this->gradient.data();
+      Scalar norm = 0;
+      for (size_t i = 0; i < n; i++) {
+        Scalar projected =
+            std::clamp(current[i] - g[i], this->lower[i], this->upper[i]);
+        norm = std::max(norm, std::abs(projected - current[i]));
+      }
+      result.objective = value;
+      result.gradient_norm = norm;
+      if (!std::isfinite(value) || !std::isfinite(norm)) {
+        result.status = NLPStatus::numerical_error;
+        break;
+      }
+      if (norm <= this->options.gradient_tolerance) {
+        result.status = NLPStatus::converged;
+        break;
+      }
+      if (stalled) {
+        result.status = NLPStatus::function_tolerance;
+        break;
+      }
+      if (result.iterations >= this->options.max_iterations) {
+        result.status = NLPStatus::iteration_limit;
+        break;
+      }
+      this->prepare_compact();
+      this->cauchy_point(current, g);
+      this->subspace_minimization(current, g);
+      Scalar const *d = this->direction.data();
+      Scalar slope = teensymat::dot(n, g, d);
+      Scalar step = 1;
+      if (this->memory.get_size() == 0) {
+        step = std::min(Scalar{1}, 1 / teensymat::nrm2(n, d));
+      }
+      // Largest step keeping x + step d within the bounds (at least 1)
+      Scalar max_step = infinity<Scalar>;
+      for (size_t i = 0; i < n; i++) {
+        if (d[i] > 0 && this->upper[i] < infinity<Scalar>) {
+          max_step =
+              std::min(max_step, (this->upper[i] - current[i]) / d[i]);
+        } else if (d[i] < 0 && this->lower[i] > -infinity<Scalar>) {
+          max_step =
+              std::min(max_step, (this->lower[i] - current[i]) / d[i]);
+        }
+      }
+      Scalar trial_value;
+      bool found = this->search.search(
+          objective, current, d, value, slope, step, trial,
+          this->trial_gradient.data(), trial_value, std::max(max_step, step));
+      this->evaluations += this->search.get_evaluations();
+      if (!found) {
+        if (this->memory.get_size() > 0) {
+          // Retry from the projected steepest descent path
+          this->memory.reset();
+          continue;
+        }
+        result.status = NLPStatus::line_search_failure;
+        break;
+      }
+      // New correction pair, with its products in the same pass
+      Scalar *s = this->memory.next_s();
+      Scalar *y = this->memory.next_y();
+      Scalar const *trial_g = this->trial_gradient.data();
+      Scalar sy = 0;
+      Scalar yy = 0;
+      for (size_t i = 0; i < n; i++) {
+        s[i] = trial[i] - current[i];
+        y[i] = trial_g[i] - g[i];
+        sy += s[i] * y[i];
+        yy += y[i] * y[i];
+      }
+      bool full = this->memory.get_size() == this->memory.get_capacity();
+      if (this->memory.commit(sy, yy)) {
+        this->update_compact(full);
+      }
+      std::swap(current, trial);
+      this->gradient.swap(this->trial_gradient);
+      result.iterations++;
+      Scalar decrease = value - trial_value;
+      Scalar size = std::max({std::abs(value), std::abs(trial_value),
+                              Scalar{1}});
+      value = trial_value;
+      stalled = this->options.function_tolerance > 0 &&
+                decrease <= this->options.function_tolerance * size;
+    }
+    if (current != x) {
+      std::copy(current, current + n, x);
+    }
+    result.evaluations = this->evaluations;
+    return result;
+  }
+};
+
+/*! Minimize an objective within bounds with LBFGSB.
+ *
+ * @param objective The objective and its gradient
+ * @param x The starting point, overwritten with the final point
+ * @param lower Lower bounds (-infinity for none)
+ * @param upper Upper bounds (infinity for none)
+ * @param options Options of the solve
+ * @return Summary of the solve
+ * */
+template <typename Scalar>
+NLPSolution<Scalar>
+minimize_lbfgsb(std::type_identity_t<Objective<Scalar>> const &objective,
+                std::vector<Scalar> &x, std::vector<Scalar> lower,
+                std::vector<Scalar> upper,
+                LBFGSBOptions<Scalar> const &options = {}) {
+  if (x.size() != lower.size()) {
+    throw std::range_error("Starting point and bounds of LBFGSB have "
+                           "different lengths");
+  }
+  LBFGSB<Scalar> solver{std::move(lower), std::move(upper), options};
+  return solver.minimize(objective, x.data());
+}
+} // namespace teensynlp
@@ -0,0 +1,540 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/linalg.hpp"
+#include "TeensyOpt/TeensyNLP/nlp_problem.hpp"
+
+namespace teensynlp {
+/*! Line search algorithms of LineSearch*/
+enum class LineSearchMethod {
+  /*! More and Thuente: strong Wolfe conditions, with a safeguarded
+   * interval of uncertainty*/
+  more_thuente,
+  /*! Hager and Zhang: Wolfe or approximate Wolfe conditions, with
+   * double secant steps (accurate close to the minimizer, where the
+   * Armijo test is lost to rounding)*/
+  hager_zhang,
+  /*! Backtracking from the initial step until sufficient decrease, with
+   * safeguarded quadratic interpolation*/
+  backtracking,
+};
+
+/*! Options of LineSearch*/
+template <typename Scalar> struct LineSearchOptions {
+  /*! The algorithm*/
+  LineSearchMethod method = LineSearchMethod::more_thuente;
+  /*! Sufficient decrease parameter (c1 of the Wolfe conditions)*/
+  Scalar sufficient_decrease = 1e-4;
+  /*! Curvature parameter (c2 of the Wolfe conditions, unused by
+   * backtracking)*/
+  Scalar curvature = 0.9;
+  /*! Relative error in the objective allowed by the approximate Wolfe
+   * conditions of hager_zhang*/
+  Scalar epsilon = 1e-6;
+  /*! Maximum number of evaluations per search*/
+  size_t max_evaluations = 20;
+};
+
+namespace line_search_detail {
+/*! A trial step with its value and directional derivative*/
+template <typename Scalar> struct Trial {
+  Scalar step;
+  Scalar value;
+  Scalar slope;
+};
+
+/*! Safeguarded step of More and Thuente (dcstep of MINPACK-2): updates
+ * the interval of uncertainty [x, y] (x the best step so far) with the
+ * trial p and returns the next trial step within [low, high]*/
+template <typename Scalar>
+Scalar more_thuente_step(Trial<Scalar> &x, Trial<Scalar> &y,
+                         Trial<Scalar> const &p, bool &bracketed, Scalar low,
+                         Scalar high) {
+  Scalar sign = p.slope * std::copysign(Scalar{1}, x.slope);
+  Scalar next;
+  auto cubic_gamma = [](Scalar theta, Scalar a, Scalar b, bool clip) {
+    Scalar s = std::max({std::abs(theta), std::abs(a), std::abs(b)});
+    Scalar discriminant = (theta / s) * (theta / s) - (a / s) * (b / s);
+    if (clip) {
+      discriminant = std::max(discriminant, Scalar{0});
+    }
+    return s * std::sqrt(discriminant);
+  };
+  if (p.value > x.value) {
+    // Higher value: the minimizer is bracketed, take the closer of the
+    // cubic and quadratic steps (or their average)
+    Scalar theta =
+        3 * (x.value - p.value) / (p.step - x.step) + x.slope + p.slope;
+    Scalar gamma = cubic_gamma(theta, x.slope, p.slope, false);
+    if (p.step < x.step) {
+      gamma = -gamma;
+    }
+    Scalar r = ((gamma - x.slope) + theta) /
+               (((gamma - x.slope) + gamma) + p.slope);
+    Scalar cubic = x.step + r * (p.step - x.step);
+    Scalar quadratic =
+        x.step + ((x.slope / ((x.value - p.value) / (p.step - x.step) +
+                              x.slope)) /
+                  2) *
+                     (p.step - x.step);
+    if (std::abs(cubic - x.step) < std::abs(quadratic - x.step)) {
+      next = cubic;
+    } else {
+      next = cubic + (quadratic - cubic) / 2;
+    }
+    bracketed = true;
+  } else if (sign < 0) {
+    // Derivatives of opposite sign: bracketed, take the farther of the
+    // cubic and secant steps
+    Scalar theta =
+        3 * (x.value - p.value) / (p.step - x.step) + x.slope + p.slope;
+    Scalar gamma = cubic_gamma(theta, x.slope, p.slope, false);
+    if (p.step > x.step) {
+      gamma = -gamma;
+    }
+    Scalar r = ((gamma - p.slope) + theta) /
+               (((gamma - p.slope) + gamma) + x.slope);
+    Scalar cubic = p.step + r * (x.step - p.step);
+    Scalar secant = p.step + (p.slope / (p.slope - x.slope)) *
+                                 (x.step - p.step);
+    next = std::abs(cubic - p.step) > std::abs(secant - p.step) ? cubic
+                                                                : secant;
+    bracketed = true;
+  } else if (std::abs(p.slope) < std::abs(x.slope)) {
+    // Derivative decreasing in magnitude
+    Scalar theta =
+        3 * (x.value - p.value) / (p.step - x.step) + x.slope + p.slope;
+    Scalar gamma = cubic_gamma(theta, x.slope, p.slope, true);
+    if (p.step > x.step) {
+      gamma = -gamma;
+    }
+    Scalar r = ((gamma - p.slope) + theta) /
+               ((gamma + (x.slope - p.slope)) + gamma);
+    Scalar cubic;
+    if (r < 0 && gamma != 0) {
+      cubic = p.step + r * (x.step - p.step);
+    } else {
+      cubic = p.step > x.step ? high : low;
+    }
+    Scalar secant = p.step + (p.slope / (p.slope - x.slope)) *
+                                 (x.step - p.step);
+    if (bracketed) {
+      next = std::abs(cubic - p.step) < std::abs(secant - p.step) ? cubic
+                                                                  : secant;
+      Scalar limit = p.step + Scalar{0.66} * (y.step - p.step);
+      next = p.step > x.step ? std::min(limit, next) : std::max(limit, next);
+    } else {
+      next = std::abs(cubic - p.step) > std::abs(secant - p.step) ? cubic
+                                                                  : secant;
+      next = std::clamp(next, low, high);
+    }
+  } else {
+    // Derivative not decreasing in magnitude
+    if (bracketed) {
+      Scalar theta =
+          3 * (p.value - y.value) / (y.step - p.step) + y.slope + p.slope;
+      Scalar gamma = cubic_gamma(theta, y.slope, p.slope, false);
+      if (p.step > y.step) {
+        gamma = -gamma;
+      }
+      Scalar r = ((gamma - p.slope) + theta) /
+                 (((gamma - p.slope) + gamma) + y.slope);
+      next = p.step + r * (y.step - p.step);
+    } else {
+      next = p.step > x.step ? high : low;
+    }
+  }
+  if (p.value > x.value) {
+    y = p;
+  } else {
+    if (sign < 0) {
+      y = x;
+    }
+    x = p;
+  }
+  return next;
+}
+} // namespace line_search_detail
+
+/*! Line searches for descent methods.
+ *
+ * A search minimizes phi(a) = f(x + a d) approximately from a descent
+ * direction d, evaluating trial points with the fused waxpy kernel into a
+ * caller buffer. The value and gradient of the objective are kept at
+ * each trial and every method accepts the step it evaluated last, so the
+ * caller finds the accepted point, its value and its gradient in its own
+ * buffers and never evaluates it again. A search allocates nothing.
+ * */
+template <typename Scalar> class LineSearch {
+private:
+  using Trial = line_search_detail::Trial<Scalar>;
+  /*! Options of the searches*/
+  LineSearchOptions<Scalar> options;
+  /*! Number of variables*/
+  size_t n;
+  /*! Number of evaluations of the last search*/
+  size_t evaluations;
+  // The current search
+  Objective<Scalar> const *objective;
+  Scalar const *x;
+  Scalar const *d;
+  Scalar *trial;
+  Scalar *trial_gradient;
+  /*! Bounds trial points are clamped to (null for none)*/
+  Scalar const *lower;
+  Scalar const *upper;
+  /*! phi(0) and phi'(0)*/
+  Scalar value, slope;
+  /*! The last trial, which every method accepts on success*/
+  Trial last;
+
+  /*! Evaluate phi at step (infinite value and slope when the objective
+   * is not finite there)*/
+  Trial evaluate(Scalar step) {
+    if (this->lower != nullptr) {
+      for (size_t i = 0; i < this->n; i++) {
+        this->trial[i] = std::clamp(this->x[i] + step * this->d[i],
+                                    this->lower[i], this->upper[i]);
+      }
+    } else {
+      teensymat::waxpy(this->n, step, this->d, this->x, this->trial);
+    }
+    Scalar f = (*this->objective)(this->trial, this->trial_gradient);
+    this->evaluations++;
+    Scalar g = teensymat::dot(this->n, this->trial_gradient, this->d);
+    if (!std::isfinite(f) || !std::isfinite(g)) {
+      this->last = {step, infinity<Scalar>, infinity<Scalar>};
+    } else {
+      this->last = {step, f, g};
+    }
+    return this->last;
+  }
+  /*! Whether the search may evaluate again*/
+  bool can_evaluate() const {
+    return this->evaluations < this->options.max_evaluations;
+  }
+  /*! Whether phi(step) gives sufficient decrease*/
+  bool decreases(Trial const &t) const {
+    return t.value <= this->value +
+                          this->options.sufficient_decrease * t.step *
+                              this->slope;
+  }
+
+  // SECTION: More-Thuente
+  /*! Search of More and Thuente (dcsrch of MINPACK-2), minimizing
+   * phi(a) - c1 phi'(0) a until a step with sufficient decrease is found,
+   * then phi itself*/
+  bool more_thuente(Scalar &step, Scalar max_step) {
+    Scalar const xtol = 1e-10;
+    Scalar gtest = this->options.sufficient_decrease * this->slope;
+    Scalar gtol = -this->options.curvature * this->slope;
+    Trial x{0, this->value, this->slope};
+    Trial y = x;
+    bool bracketed = false;
+    // In the first stage the auxiliary function psi(a) = phi(a) - gtest a
+    // is minimized instead
+    bool first_stage = true;
+    Scalar width = max_step;
+    Scalar width_before = 2 * width;
+    Scalar low = 0;
+    Scalar high = step + 4 * step;
+    while (this->can_evaluate()) {
+      Trial p = this->evaluate(step);
+      if (!std::isfinite(p.value)) {
+        // Not defined there: shrink towards the best step
+        max_step = step;
+        step = x.step + (step - x.step) / 2;
+        continue;
+      }
+      Scalar ftest = this->value + step * gtest;
+      if (first_stage && p.value <= ftest && p.slope >= 0) {
+        first_stage = false;
+      }
+      if (p.value <= ftest && std::abs(p.slope) <= gtol) {
+        return true;
+      }
+      if (step == max_step && p.value <= ftest && p.slope <= gtest) {
+        return true;
+      }
+      if (bracketed &&
+          (step <= low || step >= high || high - low <= xtol * high)) {
+        // Rounding errors prevent progress
+        return this->decreases(p);
+      }
+      if (step == 0) {
+        return false;
+      }
+      if (first_stage && p.value <= x.value && p.value > ftest) {
+        auto shift = [gtest](Trial t) {
+          return Trial{t.step, t.value - t.step * gtest, t.slope - gtest};
+        };
+        Trial xm = shift(x);
+        Trial ym = shift(y);
+        step = line_search_detail::more_thuente_step(xm, ym, shift(p),
+                                                     bracketed, low, high);
+        x = {xm.step, xm.value + xm.step * gtest, xm.slope + gtest};
+        y = {ym.step, ym.value + ym.step * gtest, ym.slope + gtest};
+      } else {
+        step = line_search_detail::more_thuente_step(x, y, p, bracketed, low,
+                                                     high);
+      }
+      if (bracketed) {
+        if (std::abs(y.step - x.step) >= Scalar{0.66} * width_before) {
+          step = x.step + (y.step - x.step) / 2;
+        }
+        width_before = width;
+        width = std::abs(y.step - x.step);
+        low = std::min(x.step, y.step);
+        high = std::max(x.step, y.step);
+      } else {
+        low = step + Scalar{1.1} * (step - x.step);
+        high = step + 4 * (step - x.step);
+      }
+      step = std::clamp(step, Scalar{0}, max_step);
+      if (bracketed &&
+          (step <= low || step >= high || high - low <= xtol * high)) {
+        step = x.step;
+      }
+    }
+    return false;
+  }
+
+  // SECTION: Hager-Zhang
+  /*! Whether the trial satisfies the Wolfe or the approximate Wolfe
+   * conditions*/
+  bool hz_accepts(Trial const &t) const {
+    Scalar sigma = this->options.curvature;
+    Scalar delta = this->options.sufficient_decrease;
+    if (!(t.slope >= sigma * this->slope)) {
+      return false;
+    }
+    return this->decreases(t) ||
+           (t.slope <= (2 * delta - 1) * this->slope &&
+            t.value <= this->value + this->hz_tolerance());
+  }
+  /*! Increase of the objective tolerated by the approximate Wolfe
+   * conditions*/
+  Scalar hz_tolerance() const {
+    return this->options.epsilon * std::abs(this->value);
+  }
+  /*! Evaluate c, returning true when it is accepted (setting accepted) or
+   * the evaluations run out*/
+  bool hz_probe(Scalar c, Trial &t, bool &accepted) {
+    t = this->evaluate(c);
+    accepted = this->hz_accepts(t);
+    return accepted || !this->can_evaluate();
+  }
+  /*! Shrink [a, b], with phi'(b) < 0 and phi(b) too large, until its right
+   * end has a nonnegative slope (step U3 of Hager and Zhang)*/
+  bool hz_bisect(Trial &a, Trial &b, bool &accepted) {
+    for (;;) {
+      Trial t;
+      if (this->hz_probe((a.step + b.step) / 2, t, accepted)) {
+        return true;
+      }
+      if (t.slope >= 0) {
+        b = t;
+        return false;
+      }
+      if (t.value <= this->value + this->hz_tolerance()) {
+        a = t;
+      } else {
+        b = t;
+      }
+    }
+  }
+  /*! Update the bracket [a, b] with a trial at c*/
+  bool hz_update(Trial &a, Trial &b, Scalar c, bool &accepted) {
+    if (!(c > a.step && c < b.step)) {
+      return false;
+    }
+    Trial t;
+    if (this->hz_probe(c, t, accepted)) {
+      return true;
+    }
+    if (t.slope >= 0) {
+      b = t;
+      return false;
+    }
+    if (t.value <= this->value + this->hz_tolerance()) {
+      a = t;
+      return false;
+    }
+    b = t;
+    return this->hz_bisect(a, b, accepted);
+  }
+  /*! Step where the secant of phi' through a and b vanishes*/
+  static Scalar hz_secant(Trial const &a, Trial const &b) {
+    return (a.step * b.slope - b.step * a.slope) / (b.slope - a.slope);
+  }
+  /*! Search of Hager and Zhang: expand until the minimizer is bracketed,
+   * then shrink the bracket with double secant steps*/
+  bool hager_zhang(Scalar &step, Scalar max_step) {
+    Scalar const growth = 5;
+    Scalar const shrink = 0.66;
+    Scalar limit = this->value + this->hz_tolerance();
+    bool accepted = false;
+    Trial a{0, this->value, this->slope};
+    Trial b;
+    // Bracket
+    Trial c;
+    for (;;) {
+      if (this->hz_probe(step, c, accepted)) {
+        return accepted;
+      }
+      if (c.slope >= 0) {
+        b = c;
+        break;
+      }
+      if (c.value > limit) {
+        b = c;
+        if (this->hz_bisect(a, b, accepted)) {
+          return accepted;
+        }
+        break;
+      }
+      a = c;
+      if (step >= max_step) {
+        // Still descending at the largest step
+        return this->decreases(c);
+      }
+      step = std::min(growth * step, max_step);
+    }
+    // Double secant steps, bisecting when the bracket shrinks too slowly
+    for (;;) {
+      Scalar width = b.step - a.step;
+      Trial a_old = a;
+      Trial b_old = b;
+      Scalar c_step = hz_secant(a, b);
+      if (this->hz_update(a, b, c_step, accepted)) {
+        return accepted;
+      }
+      if (b.step == c_step) {
+        if (this->hz_update(a, b, hz_secant(b_old, b), accepted)) {
+          return accepted;
+        }
+      } else if (a.step == c_step) {
+        if (this->hz_update(a, b, hz_secant(a_old, a), accepted)) {
+          return accepted;
+        }
+      }
+      if (b.step - a.step > shrink * width) {
+        if (this->hz_update(a, b, (a.step + b.step) / 2, accepted)) {
+          return accepted;
+        }
+      }
+      if (!(b.step - a.step > 0)) {
+        return false;
+      }
+    }
+  }
+
+  // SECTION: Backtracking
+  /*! Backtrack from step until sufficient decrease*/
+  bool backtracking(Scalar &step) {
+    while (this->can_evaluate()) {
+      Trial t = this->evaluate(step);
+      if (this->decreases(t)) {
+        return true;
+      }
+      Scalar next = step / 2;
+      if (std::isfinite(t.value)) {
+        // Minimizer of the quadratic through phi(0), phi'(0), phi(step)
+        Scalar excess = t.value - this->value - this->slope * step;
+        if (excess > 0) {
+          next = std::clamp(-this->slope * step * step / (2 * excess),
+                            step / 10, step / 2);
+        }
+      }
+      step = next;
+    }
+    return false;
+  }
+
+public:
+  // SECTION: Constructors
+  /*! Create a line search.
+   *
+   * @param n Number of variables
+   * @param options Options of the searches
+   * */
+  explicit LineSearch(size_t n, LineSearchOptions<Scalar> options = {})
+      : options(options), n(n), evaluations(0), objective(nullptr),
+        x(nullptr), d(nullptr), trial(nullptr), trial_gradient(nullptr),
+        lower(nullptr), upper(nullptr), value(0), slope(0), last{0, 0, 0} {}
+
+  // SECTION: Getters
+  /*! Get the options of the searches*/
+  LineSearchOptions<Scalar> const &get_options() const {
+    return this->options;
+  }
+  /*! Get the number of evaluations of the last search*/
+  size_t get_evaluations() const { return this->evaluations; }
+
+  // SECTION: Settings
+  /*! Clamp trial points to lower <= x <= upper (n values each, kept by
+   * the caller), for searches along a feasible segment whose rounding
+   * must not leave the bounds. Null pointers remove the bounds.*/
+  void set_bounds(Scalar const *lower, Scalar const *upper) {
+    this->lower = lower;
+    this->upper = upper;
+  }
+
+  // SECTION: Searching
+  /*! Search along d from x.
+   *
+   * @param objective The objective and its gradient
+   * @param x The current point
+   * @param d The descent direction
+   * @param value f(x)
+   * @param slope g(x)^T d, negative
+   * @param step The first trial step, overwritten with the accepted one
+   * @param trial Buffer for trial points, holding the accepted point on
+   * success
+   * @param trial_gradient Buffer for gradients, holding the gradient at
+   * the accepted point on success
+   * @param trial_value Set to the value at the accepted point
+   * @param max_step Largest step allowed
+   * @return Whether an acceptable step was found
+   * */
+  bool search(Objective<Scalar> const &objective, Scalar const *x,
+              Scalar const *d, Scalar value, Scalar slope, Scalar &step,
+              Scalar *trial, Scalar *trial_gradient, Scalar &trial_value,
+              Scalar max_step = infinity<Scalar>) {
+    this->evaluations = 0;
+    this->objective = &objective;
+    this->x = x;
+    this->d = d;
+    this->trial = trial;
+    this->trial_gradient = trial_gradient;
+    this->value = value;
+    this->slope = slope;
+    step = std::min(step, max_step);
+    if (!(slope < 0) || !(step > 0)) {
+      return false;
+    }
+    bool found = false;
+    switch (this->options.method) {
+    case LineSearchMethod::more_thuente:
+      found = this->more_thuente(step, max_step);
+      break;
+    case LineSearchMethod::hager_zhang:
+      found = this->hager_zhang(step, max_step);
+      break;
+    case LineSearchMethod::backtracking:
+      found = this->backtracking(step);
+      break;
+    }
+    if (found) {
+      step = this->last.step;
+      trial_value = this->last.value;
+    }
+    return found;
+  }
+};
+} // namespace teensynlp
@@ -0,0 +1,256 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/linalg.hpp"
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+#include "TeensyOpt/TeensyNLP/line_search.hpp"
+#include "TeensyOpt/TeensyNLP/nlp_problem.hpp"
+
+namespace teensynlp {
+namespace newton_detail {
+/*! Modified Cholesky factorization of Gill, Murray and Wright, in place.
+ *
+ * Factors A + E = L D L^T with E diagonal and nonnegative, chosen so that
+ * D is safely positive and the entries of L are bounded; E is zero when A
+ * is sufficiently positive definite. Only the lower triangle of A is read.
+ * On return the strict lower triangle of a holds L (unit diagonal
+ * implied) and its diagonal holds D.
+ *
+ * @param a The symmetric matrix, overwritten with the factors
+ * @param work Workspace of n values
+ * @return The largest entry of E
+ * */
+template <typename Scalar>
+Scalar modified_cholesky(teensymat::Matrix<Scalar> &a, Scalar *work) {
+  size_t n = a.get_nrows();
+  Scalar eps = std::numeric_limits<Scalar>::epsilon();
+  Scalar gamma = 0;
+  Scalar xi = 0;
+  for (size_t i = 0; i < n; i++) {
+    Scalar const *row = a(i, 0);
+    gamma = std::max(gamma, std::abs(row[i]));
+    for (size_t j = 0; j < i; j++) {
+      xi = std::max(xi, std::abs(row[j]));
+    }
+  }
+  Scalar beta2 = std::max(gamma, eps);
+  if (n > 1) {
+    beta2 = std::max(beta2, xi / std::sqrt(Scalar(n * n - 1)));
+  }
+  Scalar delta = eps * std::max(gamma + xi, Scalar{1});
+  Scalar added = 0;
+  for (size_t j = 0; j < n; j++) {
+    Scalar *row_j = a(j, 0);
+    for (size_t s = 0; s < j; s++) {
+      work[s] = row_j[s] * *a(s, s);
+    }
+    // Column j of C = A - L D L^T (so far), bounded through theta
+    Scalar theta = 0;
+    for (size_t i = j + 1; i < n; i++) {
+      Scalar *row_i = a(i, 0);
+      row_i[j] -= teensymat::dot(j, row_i, work);
+      theta = std::max(theta, std::abs(row_i[j]));
+    }
+    Scalar c = row_j[j] - teensymat::dot(j, row_j, work);
+    Scalar d = std::max({std::abs(c), theta * theta / beta2, delta});
+    added = std::max(added, d - c);
+    row_j[j] = d;
+    for (size_t i = j + 1; i < n; i++) {
+      *a(i, j) /= d;
+    }
+  }
+  return added;
+}
+
+/*! Solve L D L^T x = b in place with factors from modified_cholesky*/
+template <typename Scalar>
+void ldl_solve(teensymat::Matrix<Scalar> const &factor, Scalar *x) {
+  size_t n = factor.get_nrows();
+  for (size_t i = 0; i < n; i++) {
+    x[i] -= teensymat::dot(i, factor(i, 0), x);
+  }
+  for (size_t i = 0; i < n; i++) {
+    x[i] /= *factor(i, i);
+  }
+  for (size_t i = n; i-- > 0;) {
+    teensymat::axpy(i, -x[i], factor(i, 0), x);
+  }
+}
+} // namespace newton_detail
+
+/*! Options of Newton*/
+template <typename Scalar> struct NewtonOptions {
+  /*! Maximum number of iterations*/
+  size_t max_iterations = 200;
+  /*! Converged when the infinity norm of the gradient is below this*/
+  Scalar gradient_tolerance = 1e-6;
+  /*! Stop when f_k - f_{k+1} <= function_tolerance * max(|f_k|, |f_{k+1}|,
+   * 1) (0 disables the test)*/
+  Scalar function_tolerance = 0;
+  /*! Options of the line search, which starts from the unit step*/
+  LineSearchOptions<Scalar> line_search = {
+      .method = LineSearchMethod::backtracking, .max_evaluations = 30};
+};
+
+/*! Line search Newton minimizer for objectives with dense Hessians.
+ *
+ * Each iteration factors the Hessian with the modified Cholesky
+ * factorization, which leaves sufficiently positive definite Hessians
+ * untouched (those whose pivots stay above its thresholds) and otherwise
+ * adds just enough to the diagonal to give a descent direction, then
+ * searches from the unit step with a LineSearch (backtracking by
+ * default). The Hessian is evaluated into a workspace Matrix and
+ * factored in place, so an iteration allocates nothing.
+ * */
+template <typename Scalar> class Newton {
+private:
+  /*! Options of the solve*/
+  NewtonOptions<Scalar> options;
+  /*! Number of variables*/
+  size_t n;
+  /*! The Hessian, then its modified Cholesky factors*/
+  teensymat::Matrix<Scalar> hessian;
+  /*! Search direction, second point buffer and factorization workspace*/
+  std::vector<Scalar> direction, point, work;
+  /*! Gradient at the current point and at the trial point*/
+  std::vector<Scalar> gradient, trial_gradient;
+  /*! The line search*/
+  LineSearch<Scalar> search;
+  /*! Number of evaluations in the current solve*/
+  size_t evaluations;
+  /*! Number of iterations whose Hessian was modified*/
+  size_t modified;
+
+public:
+  // SECTION: Constructors
+  /*! Allocate a minimizer.
+   *
+   * @param n Number of variables
+   * @param options Options of the solves
+   * */
+  explicit Newton(size_t n, NewtonOptions<Scalar> options = {})
+      : options(options), n(n), hessian(n, n), direction(n), point(n),
+        work(n), gradient(n), trial_gradient(n),
+        search(n, options.line_search), evaluations(0), modified(0) {}
+
+  // SECTION: Getters
+  /*! Get the number of variables*/
+  size_t get_dim() const { return this->n; }
+  /*! Get the gradient at the point returned by the last solve*/
+  std::vector<Scalar> const &get_gradient() const { return this->gradient; }
+  /*! Get the number of iterations of the last solve whose Hessian was not
+   * positive definite enough and had to be modified*/
+  size_t get_modified() const { return this->modified; }
+
+  // SECTION: Solving
+  /*! Minimize an objective.
+   *
+   * @param objective The objective and its gradient
+   * @param hessian The Hessian of the objective
+   * @param x The starting point, overwritten with the final point (n
+   * values)
+   * @return Summary of the solve
+   * */
+  NLPSolution<Scalar> minimize(Objective<Scalar> const &objective,
+                               Hessian<Scalar> const &hessian, Scalar *x) {
+    size_t n = this->n;
+    NLPSolution<Scalar> result;
+    this->evaluations = 0;
+    this->modified = 0;
+    Scalar *current = x;
+    Scalar *trial = this->point.data();
+    Scalar value = objective(current, this->gradient.data());
+    this->evaluations++;
+    bool stalled = false;
+    for (;;) {
+      Scalar const *g = this->gradient.data();
+      Scalar norm = 0;
+      for (size_t i = 0; i < n; i++) {
+        norm = std::max(norm, std::abs(g[i]));
+      }
+      result.objective = value;
+      result.gradient_norm = norm;
+      if (!std::isfinite(value) || !std::isfinite(norm)) {
+        result.status = NLPStatus::numerical_error;
+        break;
+      }
+      if (norm <= this->options.gradient_tolerance) {
+        result.status = NLPStatus::converged;
+        break;
+      }
+      if (stalled) {
+        result.status = NLPStatus::function_tolerance;
+        break;
+      }
+      if (result.iterations >= this->options.max_iterations) {
+        result.status = NLPStatus::iteration_limit;
+        break;
+      }
+      hessian(current, this->hessian);
+      Scalar added =
+          newton_detail::modified_cholesky(this->hessian, this->work.data());
+      if (added > 0) {
+        this->modified++;
+      }
+      Scalar *d = this->direction.data();
+      for (size_t i = 0; i < n; i++) {
+        d[i] = -g[i];
+      }
+      newton_detail::ldl_solve(this->hessian, d);
+      Scalar slope = teensymat::dot(n, g, d);
+      Scalar step = 1;
+      Scalar trial_value;
+      bool found =
+          this->search.search(objective, current, d, value, slope, step,
+                              trial, this->trial_gradient.data(),
+                              trial_value);
+      this->evaluations += this->search.get_evaluations();
+      if (!found) {
+        result.status = !std::isfinite(slope) ? NLPStatus::numerical_error
+                                              : NLPStatus::line_search_failure;
+        break;
+      }
+      std::swap(current, trial);
+      this->gradient.swap(this->trial_gradient);
+      result.iterations++;
+      Scalar decrease = value - trial_value;
+      Scalar size = std::max({std::abs(value), std::abs(trial_value),
+                              Scalar{1}});
+      value = trial_value;
+      stalled = this->options.function_tolerance > 0 &&
+                decrease <= this->options.function_tolerance * size;
+    }
+    if (current != x) {
+      std::copy(current, current + n, x);
+    }
+    result.evaluations = this->evaluations;
+    return result;
+  }
+};
+
+/*! Minimize an objective with Newton.
+ *
+ * @param objective The objective and its gradient
+ * @param hessian The Hessian of the objective
+ * @param x The starting point, overwritten with the final point
+ * @param options Options of the solve
+ * @return Summary of the solve
+ * */
+template <typename Scalar>
+NLPSolution<Scalar>
+minimize_newton(std::type_identity_t<Objective<Scalar>> const &objective,
+                std::type_identity_t<Hessian<Scalar>> const &hessian,
+                std::vector<Scalar> &x,
+                NewtonOptions<Scalar> const &options = {}) {
+  Newton<Scalar> solver{x.size(), options};
+  return solver.minimize(objective, hessian, x.data());
+}
+} // namespace teensynlp
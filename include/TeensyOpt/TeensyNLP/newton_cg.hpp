@@ -0,0 +1,250 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/linalg.hpp"
+#include "TeensyOpt/TeensyNLP/nlp_problem.hpp"
+
+namespace teensynlp {
+/*! Options of NewtonCG*/
+template <typename Scalar> struct NewtonCGOptions {
+  /*! Maximum number of iterations (accepted or rejected steps)*/
+  size_t max_iterations = 1000;
+  /*! Converged when the infinity norm of the gradient is below this*/
+  Scalar gradient_tolerance = 1e-6;
+  /*! Stop when f_k - f_{k+1} <= function_tolerance * max(|f_k|, |f_{k+1}|,
+   * 1) (0 disables the test)*/
+  Scalar function_tolerance = 0;
+  /*! Initial trust region radius*/
+  Scalar initial_radius = 1;
+  /*! Largest trust region radius*/
+  Scalar max_radius = 1e10;
+  /*! A step is accepted when the actual reduction is at least this
+   * fraction of the predicted one*/
+  Scalar acceptance = 0.1;
+  /*! Maximum number of conjugate gradient iterations per step (0 for n)*/
+  size_t max_cg_iterations = 0;
+};
+
+/*! Trust region Newton-CG minimizer using only Hessian-vector products.
+ *
+ * Each step approximately minimizes the quadratic model
+ * g^T z + z^T H z / 2 over ||z|| <= radius with Steihaug's truncated
+ * conjugate gradient method: it stops at the boundary when it meets
+ * negative curvature or leaves the region, and otherwise once the
+ * residual falls below min(1/2, sqrt(||g||)) ||g||, which gives
+ * superlinear convergence. The Hessian is never formed, so memory is a
+ * handful of vectors of length n (all allocated by the constructor) and
+ * the cost of a step is a few Hessian-vector products.
+ * */
+template <typename Scalar> class NewtonCG {
+private:
+  /*! Options of the solve*/
+  NewtonCGOptions<Scalar> options;
+  /*! Number of variables*/
+  size_t n;
+  /*! CG iterate z, residual r = g + H z, search direction and H times it*/
+  std::vector<Scalar> step, residual, search, product;
+  /*! Second point buffer*/
+  std::vector<Scalar> point;
+  /*! Gradient at the current point and at the trial point*/
+  std::vector<Scalar> gradient, trial_gradient;
+  /*! Current trust region radius*/
+  Scalar radius;
+  /*! Number of evaluations and of Hessian-vector products in the current
+   * solve*/
+  size_t evaluations, products;
+
+  /*! Steihaug's method on the model at x (gradient g), leaving the step
+   * in step. Returns the predicted reduction, and whether the step
+   * reached the boundary in boundary*/
+  Scalar steihaug(HessianProduct<Scalar> const &hessian, Scalar const *x,
+                  Scalar const *g, bool &boundary) {
+    size_t n = this->n;
+    Scalar *z = this->step.data();
+    Scalar *r = this->residual.data();
+    Scalar *d = this->search.data();
+    Scalar *hd = this->product.data();
+    Scalar rr = 0;
+    for (size_t i = 0; i < n; i++) {
+      z[i] = 0;
+      r[i] = g[i];
+      d[i] = -g[i];
+      rr += g[i] * g[i];
+    }
+    Scalar tolerance = std::min(Scalar{0.5}, std::sqrt(std::sqrt(rr))) *
+                       std::sqrt(rr);
+    Scalar radius2 = this->radius * this->radius;
+    // ||z||^2, z^T d and ||d||^2, for the distance to the boundary
+    Scalar zz = 0, zd = 0, dd = rr;
+    size_t limit = this->options.max_cg_iterations > 0
+                       ? this->options.max_cg_iterations
+                       : n;
+    boundary = false;
+    for (size_t j = 0; j < limit; j++) {
+      hessian(x, d, hd);
+      this->products++;
+      Scalar dhd = teensymat::dot(n, d, hd);
+      Scalar alpha = rr / dhd;
+      if (!(dhd > 0) || zz + alpha * (2 * zd + alpha * dd) >= radius2) {
+        // Move to the boundary along d
+        Scalar root = std::sqrt(zd * zd + dd * (radius2 - zz));
+        Scalar tau = zd > 0 ? (radius2 - zz) / (zd + root) : (root - zd) / dd;
+        teensymat::axpy(n, tau, d, z);
+        teensymat::axpy(n, tau, hd, r);
+        boundary = true;
+        break;
+      }
+      teensymat::axpy(n, alpha, d, z);
+      Scalar rr_next = teensymat::axpy_dot(n, alpha, hd, r, r);
+      zz += alpha * (2 * zd + alpha * dd);
+      if (std::sqrt(rr_next) <= tolerance) {
+        break;
+      }
+      Scalar beta = rr_next / rr;
+      rr = rr_next;
+      zd = 0;
+      dd = 0;
+      for (size_t i = 0; i < n; i++) {
+        d[i] = beta * d[i] - r[i];
+        zd += z[i] * d[i];
+        dd += d[i] * d[i];
+      }
+    }
+    // With r = g + H z the model is (g^T z + r^T z) / 2
+    return -(teensymat::dot(n, g, z) + teensymat::dot(n, r, z)) / 2;
+  }
+
+public:
+  // SECTION: Constructors
+  /*! Allocate a minimizer.
+   *
+   * @param n Number of variables
+   * @param options Options of the solves
+   * */
+  explicit NewtonCG(size_t n, NewtonCGOptions<Scalar> options = {})
+      : options(options), n(n), step(n), residual(n), search(n), product(n),
+        point(n), gradient(n), trial_gradient(n),
+        radius(options.initial_radius), evaluations(0), products(0) {}
+
+  // SECTION: Getters
+  /*! Get the number of variables*/
+  size_t get_dim() const { return this->n; }
+  /*! Get the gradient at the point returned by the last solve*/
+  std::vector<Scalar> const &get_gradient() const { return this->gradient; }
+  /*! Get the trust region radius at the end of the last solve*/
+  Scalar get_radius() const { return this->radius; }
+  /*! Get the number of Hessian-vector products of the last solve*/
+  size_t get_products() const { return this->products; }
+
+  // SECTION: Solving
+  /*! Minimize an objective.
+   *
+   * @param objective The objective and its gradient
+   * @param hessian Products with the Hessian of the objective
+   * @param x The starting point, overwritten with the final point (n
+   * values)
+   * @return Summary of the solve
+   * */
+  NLPSolution<Scalar> minimize(Objective<Scalar> const &objective,
+                               HessianProduct<Scalar> const &hessian,
+                               Scalar *x) {
+    size_t n = this->n;
+    NLPSolution<Scalar> result;
+    this->evaluations = 0;
+    this->products = 0;
+    this->radius = this->options.initial_radius;
+    Scalar *current = x;
+    Scalar *trial = this->point.data();
+    Scalar value = objective(current, this->gradient.data());
+    this->evaluations++;
+    bool stalled = false;
+    Scalar eps = std::numeric_limits<Scalar>::epsilon();
+    for (;;) {
+      Scalar const *g = this->gradient.data();
+      Scalar norm = 0;
+      for (size_t i = 0; i < n; i++) {
+        norm = std::max(norm, std::abs(g[i]));
+      }
+      result.objective = value;
+      result.gradient_norm = norm;
+      if (!std::isfinite(value) || !std::isfinite(norm)) {
+        result.status = NLPStatus::numerical_error;
+        break;
+      }
+      if (norm <= this->options.gradient_tolerance) {
+        result.status = NLPStatus::converged;
+        break;
+      }
+      if (stalled) {
+        result.status = NLPStatus::function_tolerance;
+        break;
+      }
+      if (result.iterations >= this->options.max_iterations) {
+        result.status = NLPStatus::iteration_limit;
+        break;
+      }
+      if (!(this->radius >
+            eps * std::max(Scalar{1}, teensymat::nrm2(n, current)))) {
+        result.status = NLPStatus::line_search_failure;
+        break;
+      }
+      bool boundary;
+      Scalar predicted = this->steihaug(hessian, current, g, boundary);
+      Scalar const *z = this->step.data();
+      teensymat::waxpy(n, Scalar{1}, z, current, trial);
+      Scalar trial_value = objective(trial, this->trial_gradient.data());
+      this->evaluations++;
+      Scalar ratio = -infinity<Scalar>;
+      if (predicted > 0 && std::isfinite(trial_value)) {
+        ratio = (value - trial_value) / predicted;
+      }
+      if (ratio < Scalar{0.25}) {
+        this->radius = teensymat::nrm2(n, z) / 4;
+      } else if (ratio > Scalar{0.75} && boundary) {
+        this->radius = std::min(2 * this->radius, this->options.max_radius);
+      }
+      result.iterations++;
+      if (ratio > this->options.acceptance) {
+        std::swap(current, trial);
+        this->gradient.swap(this->trial_gradient);
+        Scalar decrease = value - trial_value;
+        Scalar size = std::max({std::abs(value), std::abs(trial_value),
+                                Scalar{1}});
+        value = trial_value;
+        stalled = this->options.function_tolerance > 0 &&
+                  decrease <= this->options.function_tolerance * size;
+      }
+    }
+    if (current != x) {
+      std::copy(current, current + n, x);
+    }
+    result.evaluations = this->evaluations;
+    return result;
+  }
+};
+
+/*! Minimize an objective with NewtonCG.
+ *
+ * @param objective The objective and its gradient
+ * @param hessian Products with the Hessian of the objective
+ * @param x The starting point, overwritten with the final point
+ * @param options Options of the solve
+ * @return Summary of the solve
+ * */
+template <typename Scalar>
+NLPSolution<Scalar> minimize_newton_cg(
+    std::type_identity_t<Objective<Scalar>> const &objective,
+    std::type_identity_t<HessianProduct<Scalar>> const &hessian,
+    std::vector<Scalar> &x, NewtonCGOptions<Scalar> const &options = {}) {
+  NewtonCG<Scalar> solver{x.size(), options};
+  return solver.minimize(objective, hessian, x.data());
+}
+} // namespace teensynlp
@@ -0,0 +1,861 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/factorize.hpp"
+#include "TeensyOpt/TeensyMat/linalg.hpp"
+#include "TeensyOpt/TeensyMat/linear_operator.hpp"
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+#include "TeensyOpt/TeensyMat/sparse_core.hpp"
+#include "TeensyOpt/TeensyMat/sparse_ldlt.hpp"
+#include "TeensyOpt/TeensyNLP/nlp_problem.hpp"
+
+namespace teensynlp {
+/*! Residuals of a least squares problem: writes r(x) (m values) into
+ * residual*/
+template <typename Scalar>
+using Residual = std::function<void(Scalar const *x, Scalar *residual)>;
+
+/*! Dense Jacobian of the residuals: writes J(x) into jacobian (an m x n
+ * workspace owned by the solver). It may also assign another m x n Matrix
+ * to it: a strided one (such as a transpose) is copied to row major
+ * order, and another shape makes the solve throw std::range_error*/
+template <typename Scalar>
+using DenseJacobian = std::function<void(Scalar const *x,
+                                         teensymat::Matrix<Scalar> &jacobian)>;
+
+/*! Sparse Jacobian of the residuals: writes the values of J(x) into
+ * jacobian, which has the sparsity pattern given to the solver (only
+ * its values may be changed)*/
+template <typename Scalar>
+using SparseJacobian = std::function<void(
+    Scalar const *x, teensymat::SparseMatrix<Scalar> &jacobian)>;
+
+/*! Sparse Jacobian which is also given the residuals r(x) the solver
+ * already computed (so that a finite difference estimate does not
+ * evaluate them again), otherwise as SparseJacobian*/
+template <typename Scalar>
+using SparseJacobianWithResidual = std::function<void(
+    Scalar const *x, Scalar const *residual,
+    teensymat::SparseMatrix<Scalar> &jacobian)>;
+
+/*! Matrix-free Jacobian of the residuals: returns J(x) as an operator,
+ * which must provide its transpose*/
+template <typename Scalar>
+using JacobianOperator =
+    std::function<teensymat::LinearOperator<Scalar>(Scalar const *x)>;
+
+/*! Step computations of LeastSquares*/
+enum class NLLSMethod {
+  /*! Levenberg-Marquardt: damped Gauss-Newton steps, with the damping
+   * updated from the ratio of actual to predicted reduction (Nielsen)*/
+  levenberg_marquardt,
+  /*! Powell's dogleg: the Gauss-Newton and Cauchy steps combined within
+   * a trust region*/
+  dogleg,
+};
+
+/*! Linear solvers of the (damped) Gauss-Newton systems*/
+enum class NLLSLinearSolver {
+  /*! Choose from the kind and shape of the Jacobian*/
+  automatic,
+  /*! Householder QR of a dense J (n <= m only); each damping reduces
+   * [R; sqrt(lambda) D] with Givens rotations*/
+  qr,
+  /*! Cholesky factorization of J^T J + lambda D^2, with J^T J formed
+   * once per Jacobian (and its symbolic analysis once per solve for
+   * sparse Jacobians)*/
+  normal_equations,
+  /*! Conjugate gradients on the damped problem (CGLS), for matrix-free
+   * Jacobians*/
+  conjugate_gradient,
+};
+
+/*! Options of LeastSquares*/
+template <typename Scalar> struct NLLSOptions {
+  /*! Step computation*/
+  NLLSMethod method = NLLSMethod::levenberg_marquardt;
+  /*! Linear solver of dense Jacobians (sparse Jacobians always use the
+   * normal equations, matrix-free ones conjugate gradients)*/
+  NLLSLinearSolver linear_solver = NLLSLinearSolver::automatic;
+  /*! Maximum number of iterations (accepted or rejected steps)*/
+  size_t max_iterations = 200;
+  /*! Converged when the infinity norm of J^T r is below this*/
+  Scalar gradient_tolerance = 1e-8;
+  /*! Stop when the step is below step_tolerance (||x|| + step_tolerance)*/
+  Scalar step_tolerance = 1e-10;
+  /*! Stop when f_k - f_{k+1} <= function_tolerance * f_k for an accepted
+   * step, with f = ||r||^2 / 2 (0 disables the test)*/
+  Scalar function_tolerance = 0;
+  /*! Initial damping of levenberg_marquardt, relative to the scaling
+   * D^2 = diag(J^T J)*/
+  Scalar initial_damping = 1e-3;
+  /*! Initial trust region radius of dogleg, relative to max(||x||, 1)*/
+  Scalar initial_radius = 1;
+  /*! Relative residual tolerance of conjugate_gradient*/
+  Scalar cg_tolerance = 1e-8;
+  /*! Maximum number of conjugate gradient iterations per step (0 for
+   * n)*/
+  size_t max_cg_iterations = 0;
+};
+
+/*! Nonlinear least squares solver: minimizes ||r(x)||^2 / 2.
+ *
+ * Steps solve the damped Gauss-Newton system
+ * (J^T J + lambda D^2) p = -J^T r, where D^2 is the largest diagonal of
+ * J^T J seen so far (the identity for matrix-free Jacobians). A
+ * rejected step only changes lambda (or the radius), so the work that
+ * depends on J alone is done once per Jacobian and reused:
+ *
+ * - dense QR: the Householder factorization J = Q R, after which each
+ *   lambda costs the Givens reduction of [R; sqrt(lambda) D], O(n^3 / 3);
+ * - dense normal equations: J^T J (computed as a product of rows of J^T,
+ *   in parallel), after which each lambda costs an in-place Cholesky;
+ * - sparse: the pattern of J^T J and its fill reducing symbolic LDL^T
+ *   analysis are computed once per solver, J^T J once per Jacobian, and
+ *   each lambda is a numeric factorization.
+ *
+ * The automatic choice for dense Jacobians is QR, which does not square
+ * the condition number, unless the problem is underdetermined (m < n)
+ * or so overdetermined (m >= 4 n) that forming J^T J costs about half
+ * as much. Predicted reductions use an explicit product J p, so they
+ * are exact for inexact (conjugate gradient) steps too. All storage is
+ * allocated by the constructors.
+ * */
+template <typename Scalar> class LeastSquares {
+private:
+  /*! Kinds of Jacobians*/
+  enum class Kind { dense, sparse, matrix_free };
+  /*! Options of the solve*/
+  NLLSOptions<Scalar> options;
+  /*! Number of residuals and of variables*/
+  size_t m, n;
+  /*! Kind of the Jacobian and the linear solver used*/
+  Kind kind;
+  NLLSLinearSolver solver;
+  /*! The residuals and the Jacobian (one of the three)*/
+  Residual<Scalar> residual_fn;
+  DenseJacobian<Scalar> dense_fn;
+  SparseJacobianWithResidual<Scalar> sparse_fn;
+  JacobianOperator<Scalar> operator_fn;
+  /*! Dense: J, J^T (Householder vectors after QR), and R or J^T J*/
+  teensymat::Matrix<Scalar> jacobian, jacobian_t, reduced;
+  /*! Dense: factorization workspace*/
+  teensymat::Matrix<Scalar> work_matrix;
+  /*! Dense QR: diagonal of R, Householder coefficients and Q^T r*/
+  std::vector<Scalar> r_diagonal, tau, qtr;
+  /*! Sparse: J, its rows (start, column and entry of each), J^T J
+   * (upper triangle) with its values and diagonal entries, and the
+   * factorization*/
+  teensymat::SparseMatrix<Scalar> sparse_jacobian, normal;
+  std::vector<size_t> row_ptr, row_col, row_entry, normal_diagonal;
+  std::vector<Scalar> normal_values;
+  teensymat::SparseLDLT<Scalar> ldlt;
+  /*! Matrix-free: J at the current point*/
+  std::optional<teensymat::LinearOperator<Scalar>> jacobian_op;
+  /*! Second point buffer, residuals at the current and trial point*/
+  std::vector<Scalar> point, residual, trial_residual;
+  /*! Gradient J^T r, scaling D^2, step, Gauss-Newton step and n and m
+   * length workspaces*/
+  std::vector<Scalar> gradient, scale, step, gauss_newton, work_n, work_n2,
+      work_n3, work_m, work_m2;
+  /*! Number of residual and Jacobian evaluations in the current solve*/
+  size_t evaluations, jacobian_evaluations;
+
+  /*! Set up the storage shared by all kinds of Jacobians*/
+  void allocate() {
+    this->point.assign(this->n, 0);
+    this->residual.assign(this->m, 0);
+    this->trial_residual.assign(this->m, 0);
+    for (auto *v : {&this->gradient, &this->scale, &this->step,
+                    &this->gauss_newton, &this->work_n, &this->work_n2,
+                    &this->work_n3}) {
+      v->assign(this->n, 0);
+    }
+    this->work_m.assign(this->m, 0);
+    this->work_m2.assign(this->m, 0);
+  }
+  /*! Pattern of J^T J and the symbolic analysis, for sparse Jacobians*/
+  void analyze_sparse() {
+    size_t m = this->m;
+    size_t n = this->n;
+    auto const &col_ptr = this->sparse_jacobian.get_col_ptr();
+    auto const &row_idx = this->sparse_jacobian.get_row_idx();
+    // Rows of J
+    this->row_ptr.assign(m + 1, 0);
+    for (size_t row : row_idx) {
+      this->row_ptr[row + 1]++;
+    }
+    for (size_t i = 0; i < m; i++) {
+      this->row_ptr[i + 1] += this->row_ptr[i];
+    }
+    this->row_col.resize(row_idx.size());
+    this->row_entry.resize(row_idx.size());
+    std::vector<size_t> next(this->row_ptr.begin(), this->row_ptr.end() - 1);
+    for (size_t j = 0; j < n; j++) {
+      for (size_t p = col_ptr[j]; p < col_ptr[j + 1]; p++) {
+        size_t slot = next[row_idx[p]]++;
+        this->row_col[slot] = j;
+        this->row_entry[slot] = p;
+      }
+    }
+    // Upper triangle of J^T J, with the whole diagonal
+    std::vector<size_t> normal_ptr(n + 1, 0);
+    std::vector<size_t> normal_idx;
+    std::vector<size_t> mark(n, n);
+    for (size_t j = 0; j < n; j++) {
+      size_t start = normal_idx.size();
+      mark[j] = j;
+      normal_idx.push_back(j);
+      for (size_t p = col_ptr[j]; p < col_ptr[j + 1]; p++) {
+        size_t row = row_idx[p];
+        for (size_t e = this->row_ptr[row]; e < this->row_ptr[row + 1]; e++) {
+          size_t i = this->row_col[e];
+          if (i < j && mark[i] != j) {
+            mark[i] = j;
+            normal_idx.push_back(i);
+          }
+        }
+      }
+      std::sort(normal_idx.begin() + start, normal_idx.end());
+      normal_ptr[j + 1] = normal_idx.size();
+    }
+    this->normal_diagonal.resize(n);
+    for (size_t j = 0; j < n; j++) {
+      this->normal_diagonal[j] = normal_ptr[j + 1] - 1;
+    }
+    size_t nnz = normal_idx.size();
+    this->normal = teensymat::SparseMatrix<Scalar>{
+        n, n, std::move(normal_ptr), std::move(normal_idx),
+        std::vector<Scalar>(nnz, Scalar{0})};
+    this->normal_values.assign(nnz, 0);
+    this->ldlt.analyze(this->normal);
+  }
+
+  // SECTION: Jacobian
+  /*! Evaluate the Jacobian at x, with the gradient J^T r, the scaling
+   * and everything the damped solves reuse*/
+  void evaluate_jacobian(Scalar const *x) {
+    size_t m = this->m;
+    size_t n = this->n;
+    Scalar const *r = this->residual.data();
+    Scalar *g = this->gradient.data();
+    Scalar *column_norms = this->work_n.data();
+    this->jacobian_evaluations++;
+    std::fill(g, g + n, Scalar{0});
+    switch (this->kind) {
+    case Kind::dense: {
+      this->dense_fn(x, this->jacobian);
+      if (this->jacobian.get_shape() != std::pair<size_t, size_t>{m, n}) {
+        throw std::range_error("Jacobian does not have m rows and n "
+                               "columns");
+      }
+      if (!this->jacobian.is_contiguous()) {
+        this->jacobian = teensymat::contiguous_copy(this->jacobian);
+      }
+      Scalar const *j = this->jacobian.get_data()->data();
+      Scalar *jt = this->jacobian_t.get_data()->data();
+      for (size_t i = 0; i < m; i++) {
+        for (size_t k = 0; k < n; k++) {
+          jt[k * m + i] = j[i * n + k];
+        }
+      }
+      teensymat::gemv(n, m, Scalar{1}, jt, m, r, g);
+      for (size_t k = 0; k < n; k++) {
+        column_norms[k] = teensymat::dot(m, jt + k * m, jt + k * m);
+      }
+      if (this->solver == NLLSLinearSolver::qr) {
+        this->factor_qr();
+      } else {
+        Scalar *normal = this->reduced.get_data()->data();
+        std::fill(normal, normal + n * n, Scalar{0});
+        teensymat::gemm_nt(n, n, m, Scalar{1}, jt, m, jt, m, normal, n);
+      }
+      break;
+    }
+    case Kind::sparse: {
+      this->sparse_fn(x, r, this->sparse_jacobian);
+      this->sparse_jacobian.gaxpy_transpose(Scalar{1}, r, g);
+      this->form_normal();
+      for (size_t k = 0; k < n; k++) {
+        column_norms[k] = this->normal_values[this->normal_diagonal[k]];
+      }
+      break;
+    }
+    case Kind::matrix_free: {
+      this->jacobian_op.emplace(this->operator_fn(x));
+      if (!this->jacobian_op->has_transpose()) {
+        throw std::runtime_error(
+            "Matrix-free Jacobian must provide its transpose");
+      }
+      this->jacobian_op->apply_transpose(r, g);
+      std::fill(column_norms, column_norms + n, Scalar{1});
+      break;
+    }
+    }
+    for (size_t k = 0; k < n; k++) {
+      this->scale[k] = std::max(this->scale[k], column_norms[k]);
+    }
+  }
+  /*! Householder QR of J, held as J^T: row k of jacobian_t becomes the
+   * k-th Householder vector, R (upper) is copied to reduced and Q^T r to
+   * qtr*/
+  void factor_qr() {
+    size_t m = this->m;
+    size_t n = this->n;
+    Scalar *jt = this->jacobian_t.get_data()->data();
+    Scalar *qtr = this->work_m.data();
+    std::copy(this->residual.begin(), this->residual.end(), qtr);
+    for (size_t k = 0; k < n; k++) {
+      Scalar *v = jt + k * m + k;
+      size_t length = m - k;
+      Scalar norm = teensymat::nrm2(length, v);
+      if (norm == Scalar{0}) {
+        this->tau[k] = 0;
+        this->r_diagonal[k] = 0;
+        continue;
+      }
+      Scalar alpha = v[0] > 0 ? -norm : norm;
+      v[0] -= alpha;
+      // H = I - tau v v^T with tau = 2 / v^T v = 1 / (norm (norm + |v0|))
+      Scalar tau = -1 / (alpha * v[0]);
+      this->tau[k] = tau;
+      this->r_diagonal[k] = alpha;
+      for (size_t j = k + 1; j < n; j++) {
+        Scalar *column = jt + j * m + k;
+        teensymat::axpy(length, -tau * teensymat::dot(length, v, column), v,
+                        column);
+      }
+      teensymat::axpy(length, -tau * teensymat::dot(length, v, qtr + k), v,
+                      qtr + k);
+    }
+    Scalar *r = this->reduced.get_data()->data();
+    for (size_t k = 0; k < n; k++) {
+      std::fill(r + k * n, r + k * n + k, Scalar{0});
+      r[k * n + k] = this->r_diagonal[k];
+      for (size_t j = k + 1; j < n; j++) {
+        r[k * n + j] = jt[j * m + k];
+      }
+      this->qtr[k] = qtr[k];
+    }
+  }
+  /*! Numeric J^T J (upper triangle) of a sparse Jacobian into
+   * normal_values, column by column through a dense accumulator*/
+  void form_normal() {
+    auto const &col_ptr = this->sparse_jacobian.get_col_ptr();
+    auto const &row_idx = this->sparse_jacobian.get_row_idx();
+    Scalar const *values = this->sparse_jacobian.get_values()->data();
+    auto const &normal_ptr = this->normal.get_col_ptr();
+    auto const &normal_idx = this->normal.get_row_idx();
+    Scalar *w = this->work_n2.data();
+    std::fill(w, w + this->n, Scalar{0});
+    for (size_t j = 0; j < this->n; j++) {
+      for (size_t p = col_ptr[j]; p < col_ptr[j + 1]; p++) {
+        size_t row = row_idx[p];
+        Scalar v = values[p];
+        for (size_t e = this->row_ptr[row]; e < this->row_ptr[row + 1]; e++) {
+          size_t i = this->row_col[e];
+          if (i <= j) {
+            w[i] += values[this->row_entry[e]] * v;
+          }
+        }
+      }
+      for (size_t p = normal_ptr[j]; p < normal_ptr[j + 1]; p++) {
+        this->normal_values[p] = w[normal_idx[p]];
+        w[normal_idx[p]] = 0;
+      }
+    }
+  }
+  /*! out = J v*/
+  void apply_jacobian(Scalar const *v, Scalar *out) {
+    std::fill(out, out + this->m, Scalar{0});
+    switch (this->kind) {
+    case Kind::dense:
+      teensymat::gemv(this->m, this->n, Scalar{1},
+                      this->jacobian.get_data()->data(), this->n, v, out);
+      break;
+    case Kind::sparse:
+      this->sparse_jacobian.gaxpy(Scalar{1}, v, out);
+      break;
+    case Kind::matrix_free:
+      this->jacobian_op->apply(v, out);
+      break;
+    }
+  }
+
+  // SECTION: Damped solves
+  /*! Solve (J^T J + lambda D^2) p = -J^T r into p, returning false if the
+   * system could not be solved*/
+  bool solve_damped(Scalar lambda, Scalar *p) {
+    size_t n = this->n;
+    bool solved = false;
+    switch (this->solver) {
+    case NLLSLinearSolver::qr:
+      solved = this->solve_qr(lambda, p);
+      break;
+    case NLLSLinearSolver::normal_equations:
+      if (this->kind == Kind::dense) {
+        Scalar *a = this->work_matrix.get_data()->data();
+        Scalar const *normal = this->reduced.get_data()->data();
+        std::copy(normal, normal + n * n, a);
+        for (size_t k = 0; k < n; k++) {
+          a[k * n + k] += lambda * this->scale[k];
+        }
+        if (!teensymat::factorize_detail::cholesky_inplace(n, a, n)) {
+          return false;
+        }
+        for (size_t k = 0; k < n; k++) {
+          p[k] = -this->gradient[k];
+        }
+        teensymat::factorize_detail::cholesky_solve_inplace(n, a, n, p);
+        solved = true;
+      } else {
+        Scalar *values = this->normal.get_values()->data();
+        std::copy(this->normal_values.begin(), this->normal_values.end(),
+                  values);
+        for (size_t k = 0; k < n; k++) {
+          values[this->normal_diagonal[k]] += lambda * this->scale[k];
+        }
+        try {
+          this->ldlt.factorize(this->normal);
+        } catch (std::runtime_error const &) {
+          return false;
+        }
+        for (size_t k = 0; k < n; k++) {
+          p[k] = -this->gradient[k];
+        }
+        this->ldlt.solve_inplace(p);
+        solved = true;
+      }
+      break;
+    case NLLSLinearSolver::conjugate_gradient:
+      solved = this->solve_cgls(lambda, p);
+      break;
+    case NLLSLinearSolver::automatic:
+      break;
+    }
+    if (!solved) {
+      return false;
+    }
+    // Rounding (or a negative pivot) may spoil descent
+    Scalar slope = teensymat::dot(n, this->gradient.data(), p);
+    return std::isfinite(slope) && slope < 0;
+  }
+  /*! Damped solve from the QR factorization: reduce [R; sqrt(lambda) D]
+   * to triangular form by Givens rotations (qrsolv of MINPACK), then
+   * back substitute*/
+  bool solve_qr(Scalar lambda, Scalar *p) {
+    size_t n = this->n;
+    Scalar *s = this->work_matrix.get_data()->data();
+    Scalar const *r = this->reduced.get_data()->data();
+    std::copy(r, r + n * n, s);
+    Scalar *b = p;
+    for (size_t k = 0; k < n; k++) {
+      b[k] = -this->qtr[k];
+    }
+    Scalar *row = this->work_n2.data();
+    if (lambda > 0) {
+      for (size_t j = 0; j < n; j++) {
+        // Eliminate the row sqrt(lambda) D_j e_j^T (right hand side 0)
+        std::fill(row + j, row + n, Scalar{0});
+        row[j] = std::sqrt(lambda * this->scale[j]);
+        Scalar extra = 0;
+        for (size_t k = j; k < n; k++) {
+          if (row[k] == Scalar{0}) {
+            continue;
+          }
+          Scalar *s_row = s + k * n;
+          Scalar c, sn;
+          if (std::abs(s_row[k]) < std::abs(row[k])) {
+            Scalar cot = s_row[k] / row[k];
+            sn = 1 / std::sqrt(1 + cot * cot);
+            c = sn * cot;
+          } else {
+            Scalar tan = row[k] / s_row[k];
+            c = 1 / std::sqrt(1 + tan * tan);
+            sn = c * tan;
+          }
+          s_row[k] = c * s_row[k] + sn * row[k];
+          Scalar temp = c * b[k] + sn * extra;
+          extra = -sn * b[k] + c * extra;
+          b[k] = temp;
+          for (size_t i = k + 1; i < n; i++) {
+            temp = c * s_row[i] + sn * row[i];
+            row[i] = -sn * s_row[i] + c * row[i];
+            s_row[i] = temp;
+          }
+        }
+      }
+    }
+    for (size_t k = n; k-- > 0;) {
+      Scalar const *s_row = s + k * n;
+      if (s_row[k] == Scalar{0}) {
+        return false;
+      }
+      Scalar sum = b[k] - teensymat::dot(n - k - 1, s_row + k + 1, p + k + 1);
+      p[k] = sum / s_row[k];
+    }
+    return true;
+  }
+  /*! Damped solve by conjugate gradients on
+   * min ||J p + r||^2 + lambda ||D p||^2 (CGLS)*/
+  bool solve_cgls(Scalar lambda, Scalar *p) {
+    size_t n = this->n;
+    size_t m = this->m;
+    Scalar *d = this->work_n2.data();
+    Scalar *q = this->work_n3.data();
+    Scalar *s = this->work_m.data();
+    Scalar *t = this->work_m2.data();
+    Scalar const *scale = this->scale.data();
+    std::fill(p, p + n, Scalar{0});
+    for (size_t i = 0; i < m; i++) {
+      s[i] = -this->residual[i];
+    }
+    Scalar gamma = 0;
+    for (size_t k = 0; k < n; k++) {
+      q[k] = -this->gradient[k];
+      d[k] = q[k];
+      gamma += q[k] * q[k];
+    }
+    Scalar tolerance = this->options.cg_tolerance * std::sqrt(gamma);
+    size_t limit = this->options.max_cg_iterations > 0
+                       ? this->options.max_cg_iterations
+                       : n;
+    for (size_t it = 0; it < limit && std::sqrt(gamma) > tolerance; it++) {
+      this->jacobian_op->apply(d, t);
+      Scalar delta = teensymat::dot(m, t, t);
+      for (size_t k = 0; k < n; k++) {
+        delta += lambda * scale[k] * d[k] * d[k];
+      }
+      if (!(delta > 0)) {
+        break;
+      }
+      Scalar alpha = gamma / delta;
+      teensymat::axpy(n, alpha, d, p);
+      teensymat::axpy(m, -alpha, t, s);
+      this->jacobian_op->apply_transpose(s, q);
+      Scalar gamma_next = 0;
+      for (size_t k = 0; k < n; k++) {
+        q[k] -= lambda * scale[k] * p[k];
+        gamma_next += q[k] * q[k];
+      }
+      Scalar beta = gamma_next / gamma;
+      gamma = gamma_next;
+      for (size_t k = 0; k < n; k++) {
+        d[k] = q[k] + beta * d[k];
+      }
+    }
+    return true;
+  }
+  /*! Powell's dogleg step for the radius into step (the Gauss-Newton
+   * step is computed once per Jacobian, flagged by have_gauss_newton)*/
+  void dogleg_step(Scalar radius, bool &have_gauss_newton) {
+    size_t n = this->n;
+    Scalar *p = this->step.data();
+    Scalar const *g = this->gradient.data();
+    Scalar *gn = this->gauss_newton.data();
+    if (!have_gauss_newton) {
+      Scalar largest = *std::max_element(this->scale.begin(),
+                                         this->scale.end());
+      Scalar eps = std::numeric_limits<Scalar>::epsilon();
+      // A rank deficient J gets the smallest damping that makes it solvable
+      if (!this->solve_damped(0, gn) &&
+          !this->solve_damped(std::sqrt(eps) * std::max(largest, eps), gn)) {
+        std::fill(gn, gn + n, Scalar{0});
+      }
+      have_gauss_newton = true;
+    }
+    Scalar gn_norm = teensymat::nrm2(n, gn);
+    if (gn_norm <= radius && gn_norm > 0) {
+      std::copy(gn, gn + n, p);
+      return;
+    }
+    // Cauchy point -(g^T g / ||J g||^2) g
+    Scalar gg = teensymat::dot(n, g, g);
+    this->apply_jacobian(g, this->work_m2.data());
+    Scalar jg = teensymat::dot(this->m, this->work_m2.data(),
+                               this->work_m2.data());
+    Scalar g_norm = std::sqrt(gg);
+    Scalar cauchy = jg > 0 ? gg / jg : infinity<Scalar>;
+    if (cauchy * g_norm >= radius || gn_norm == 0) {
+      for (size_t k = 0; k < n; k++) {
+        p[k] = -radius / g_norm * g[k];
+      }
+      return;
+    }
+    // Along the dogleg from the Cauchy point to the Gauss-Newton step
+    Scalar *dir = this->work_n.data();
+    Scalar aa = 0, ab = 0, bb = 0;
+    for (size_t k = 0; k < n; k++) {
+      p[k] = -cauchy * g[k];
+      dir[k] = gn[k] - p[k];
+      aa += p[k] * p[k];
+      ab += p[k] * dir[k];
+      bb += dir[k] * dir[k];
+    }
+    Scalar root = std::sqrt(ab * ab + bb * (radius * radius - aa));
+    Scalar t = ab > 0 ? (radius * radius - aa) / (ab + root) : (root - ab) / bb;
+    teensymat::axpy(n, t, dir, p);
+  }
+  /*! Residuals at x into out, returning ||r||^2 / 2*/
+  Scalar evaluate(Scalar const *x, Scalar *out) {
+    this->residual_fn(x, out);
+    this->evaluations++;
+    return teensymat::dot(this->m, out, out) / 2;
+  }
+
+public:
+  // SECTION: Constructors
+  /*! Solver for a dense Jacobian.
+   *
+   * @param m Number of residuals
+   * @param n Number of variables
+   * @param residual The residuals
+   * @param jacobian Their Jacobian
+   * @param options Options of the solves
+   * */
+  LeastSquares(size_t m, size_t n, Residual<Scalar> residual,
+               DenseJacobian<Scalar> jacobian,
+               NLLSOptions<Scalar> options = {})
+      : options(options), m(m), n(n), kind(Kind::dense),
+        solver(options.linear_solver), residual_fn(std::move(residual)),
+        dense_fn(std::move(jacobian)), jacobian(m, n), jacobian_t(n, m),
+        reduced(n, n), work_matrix(n, n), evaluations(0),
+        jacobian_evaluations(0) {
+    if (this->solver == NLLSLinearSolver::automatic) {
+      this->solver = m < n || m >= 4 * n ? NLLSLinearSolver::normal_equations
+                                         : NLLSLinearSolver::qr;
+    }
+    if (this->solver == NLLSLinearSolver::conjugate_gradient ||
+        (this->solver == NLLSLinearSolver::qr && m < n)) {
+      throw std::range_error("Linear solver not available for this "
+                             "Jacobian");
+    }
+    this->r_diagonal.assign(n, 0);
+    this->tau.assign(n, 0);
+    this->qtr.assign(n, 0);
+    this->allocate();
+  }
+  /*! Solver for a sparse Jacobian.
+   *
+   * @param residual The residuals
+   * @param jacobian Their Jacobian
+   * @param pattern Sparsity pattern of the Jacobian (m x n; its values are
+   * ignored)
+   * @param options Options of the solves
+   * */
+  LeastSquares(Residual<Scalar> residual, SparseJacobian<Scalar> jacobian,
+               teensymat::SparseMatrix<Scalar> pattern,
+               NLLSOptions<Scalar> options = {})
+      : LeastSquares(std::move(residual),
+                     SparseJacobianWithResidual<Scalar>{
+                         [jacobian = std::move(jacobian)](
+                             Scalar const *x, Scalar const *,
+                             teensymat::SparseMatrix<Scalar> &matrix) {
+                           jacobian(x, matrix);
+                         }},
+                     std::move(pattern), options) {}
+  /*! Solver for a sparse Jacobian which reuses the residuals at x (such
+   * as SparseJacobianFD::as_jacobian).
+   *
+   * @param residual The residuals
+   * @param jacobian Their Jacobian
+   * @param pattern Sparsity pattern of the Jacobian (m x n; its values are
+   * ignored)
+   * @param options Options of the solves
+   * */
+  LeastSquares(Residual<Scalar> residual,
+               SparseJacobianWithResidual<Scalar> jacobian,
+               teensymat::SparseMatrix<Scalar> pattern,
+               NLLSOptions<Scalar> options = {})
+      : options(options), m(pattern.get_nrows()), n(pattern.get_ncols()),
+        kind(Kind::sparse), solver(NLLSLinearSolver::normal_equations),
+        residual_fn(std::move(residual)), sparse_fn(std::move(jacobian)),
+        sparse_jacobian(std::move(pattern)), evaluations(0),
+        jacobian_evaluations(0) {
+    this->allocate();
+    this->analyze_sparse();
+  }
+  /*! Solver for a matrix-free Jacobian.
+   *
+   * @param m Number of residuals
+   * @param n Number of variables
+   * @param residual The residuals
+   * @param jacobian Their Jacobian as an operator with a transpose
+   * @param options Options of the solves
+   * */
+  LeastSquares(size_t m, size_t n, Residual<Scalar> residual,
+               JacobianOperator<Scalar> jacobian,
+               NLLSOptions<Scalar> options = {})
+      : options(options), m(m), n(n), kind(Kind::matrix_free),
+        solver(NLLSLinearSolver::conjugate_gradient),
+        residual_fn(std::move(residual)), operator_fn(std::move(jacobian)),
+        evaluations(0), jacobian_evaluations(0) {
+    this->allocate();
+  }
+
+  // SECTION: Getters
+  /*! Get the number of residuals*/
+  size_t get_num_residuals() const { return this->m; }
+  /*! Get the number of variables*/
+  size_t get_dim() const { return this->n; }
+  /*! Get the linear solver used for the steps*/
+  NLLSLinearSolver get_linear_solver() const { return this->solver; }
+  /*! Get the residuals at the point returned by the last solve*/
+  std::vector<Scalar> const &get_residual() const { return this->residual; }
+  /*! Get the gradient J^T r at the point returned by the last solve*/
+  std::vector<Scalar> const &get_gradient() const { return this->gradient; }
+  /*! Get the number of Jacobian evaluations of the last solve*/
+  size_t get_jacobian_evaluations() const {
+    return this->jacobian_evaluations;
+  }
+
+  // SECTION: Solving
+  /*! Minimize ||r(x)||^2 / 2.
+   *
+   * @param x The starting point, overwritten with the final point (n
+   * values)
+   * @return Summary of the solve, with objective ||r||^2 / 2 and the
+   * gradient norm of J^T r
+   * */
+  NLPSolution<Scalar> minimize(Scalar *x) {
+    size_t n = this->n;
+    bool dogleg = this->options.method == NLLSMethod::dogleg;
+    NLPSolution<Scalar> result;
+    this->evaluations = 0;
+    this->jacobian_evaluations = 0;
+    std::fill(this->scale.begin(), this->scale.end(), Scalar{0});
+    Scalar *current = x;
+    Scalar *trial = this->point.data();
+    Scalar value = this->evaluate(current, this->residual.data());
+    if (std::isfinite(value)) {
+      this->evaluate_jacobian(current);
+    }
+    for (Scalar &s : this->scale) {
+      s = s > 0 ? s : Scalar{1};
+    }
+    // Damping (Nielsen's update) and trust region
+    Scalar lambda = this->options.initial_damping;
+    Scalar growth = 2;
+    Scalar radius = this->options.initial_radius *
+                    std::max(teensymat::nrm2(n, current), Scalar{1});
+    bool have_gauss_newton = false;
+    bool stalled = false;
+    Scalar *p = this->step.data();
+    for (;;) {
+      Scalar const *g = this->gradient.data();
+      Scalar norm = 0;
+      for (size_t k = 0; k < n; k++) {
+        norm = std::max(norm, std::abs(g[k]));
+      }
+      result.objective = value;
+      result.gradient_norm = norm;
+      if (!std::isfinite(value) || !std::isfinite(norm)) {
+        result.status = NLPStatus::numerical_error;
+        break;
+      }
+      if (norm <= this->options.gradient_tolerance) {
+        result.status = NLPStatus::converged;
+        break;
+      }
+      if (stalled) {
+        result.status = NLPStatus::function_tolerance;
+        break;
+      }
+      if (result.iterations >= this->options.max_iterations) {
+        result.status = NLPStatus::iteration_limit;
+        break;
+      }
+      bool solved = true;
+      if (dogleg) {
+        this->dogleg_step(radius, have_gauss_newton);
+      } else {
+        solved = this->solve_damped(lambda, p);
+      }
+      Scalar step_norm = solved ? teensymat::nrm2(n, p) : infinity<Scalar>;
+      Scalar x_norm = teensymat::nrm2(n, current);
+      Scalar xtol = this->options.step_tolerance;
+      if (step_norm <= xtol * (x_norm + xtol) ||
+          (dogleg && radius <= xtol * (x_norm + xtol))) {
+        result.status = NLPStatus::step_tolerance;
+        break;
+      }
+      result.iterations++;
+      Scalar ratio = -infinity<Scalar>;
+      Scalar trial_value = infinity<Scalar>;
+      if (solved) {
+        teensymat::waxpy(n, Scalar{1}, p, current, trial);
+        trial_value = this->evaluate(trial, this->trial_residual.data());
+        // Predicted reduction -(g^T p + ||J p||^2 / 2)
+        this->apply_jacobian(p, this->work_m.data());
+        Scalar predicted =
+            -(teensymat::dot(n, g, p) +
+              teensymat::dot(this->m, this->work_m.data(),
+                             this->work_m.data()) /
+                  2);
+        if (predicted > 0 && std::isfinite(trial_value)) {
+          ratio = (value - trial_value) / predicted;
+        }
+      }
+      if (dogleg) {
+        if (ratio < Scalar{0.25}) {
+          radius = step_norm / 4;
+        } else if (ratio > Scalar{0.75}) {
+          radius = std::max(radius, 2 * step_norm);
+        }
+      } else if (ratio > 0) {
+        Scalar cube = 2 * ratio - 1;
+        lambda *= std::max(Scalar{1} / 3, 1 - cube * cube * cube);
+        growth = 2;
+      } else {
+        lambda *= growth;
+        growth *= 2;
+      }
+      if (ratio > (dogleg ? Scalar{1e-4} : Scalar{0})) {
+        std::swap(current, trial);
+        this->residual.swap(this->trial_residual);
+        Scalar decrease = value - trial_value;
+        stalled = this->options.function_tolerance > 0 &&
+                  decrease <= this->options.function_tolerance * value;
+        value = trial_value;
+        this->evaluate_jacobian(current);
+        have_gauss_newton = false;
+      }
+    }
+    if (current != x) {
+      std::copy(current, current + n, x);
+    }
+    result.evaluations = this->evaluations;
+    return result;
+  }
+};
+
+/*! Minimize ||r(x)||^2 / 2 with LeastSquares and a dense Jacobian.
+ *
+ * @param m Number of residuals
+ * @param residual The residuals
+ * @param jacobian Their Jacobian
+ * @param x The starting point, overwritten with the final point
+ * @param options Options of the solve
+ * @return Summary of the solve
+ * */
+template <typename Scalar>
+NLPSolution<Scalar> minimize_least_squares(
+    size_t m, std::type_identity_t<Residual<Scalar>> residual,
+    std::type_identity_t<DenseJacobian<Scalar>> jacobian,
+    std::vector<Scalar> &x, NLLSOptions<Scalar> const &options = {}) {
+  LeastSquares<Scalar> solver{m, x.size(), std::move(residual),
+                              std::move(jacobian), options};
+  return solver.minimize(x.data());
+}
+} // namespace teensynlp
@@ -0,0 +1,66 @@
+#pragma once
+// std includes
+#include <cstddef>
+#include <functional>
+#include <limits>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+
+namespace teensynlp {
+/*! A smooth objective: returns f(x) and writes the gradient of f at x into
+ * gradient (a buffer of the same length as x owned by the caller, usually
+ * the solver, so evaluations allocate nothing)*/
+template <typename Scalar>
+using Objective = std::function<Scalar(Scalar const *x, Scalar *gradient)>;
+
+/*! Second derivatives of an objective: writes the Hessian at x into
+ * hessian (an n x n workspace owned by the solver; only the lower triangle
+ * is read)*/
+template <typename Scalar>
+using Hessian =
+    std::function<void(Scalar const *x, teensymat::Matrix<Scalar> &hessian)>;
+
+/*! Matrix-free second derivatives of an objective: writes the product of
+ * the Hessian at x with v into product (buffers of the same length as x
+ * owned by the caller)*/
+template <typename Scalar>
+using HessianProduct =
+    std::function<void(Scalar const *x, Scalar const *v, Scalar *product)>;
+
+/*! Infinity used for missing bounds*/
+template <typename Scalar>
+constexpr Scalar infinity = std::numeric_limits<Scalar>::infinity();
+
+/*! Outcome of a nonlinear minimization*/
+enum class NLPStatus {
+  /*! The gradient (or the projected gradient) is below the tolerance*/
+  converged,
+  /*! The decrease of the objective fell below the function tolerance*/
+  function_tolerance,
+  /*! The iteration limit was reached*/
+  iteration_limit,
+  /*! No acceptable step was found by the line search (or the trust region
+   * collapsed)*/
+  line_search_failure,
+  /*! The objective or its gradient is not finite*/
+  numerical_error,
+  /*! The step fell below the step tolerance*/
+  step_tolerance,
+};
+
+/*! Summary of a nonlinear minimization (the minimizer itself is written
+ * to the caller's buffer)*/
+template <typename Scalar> struct NLPSolution {
+  /*! Outcome of the solve*/
+  NLPStatus status = NLPStatus::numerical_error;
+  /*! Objective value at the final point*/
+  Scalar objective = 0;
+  /*! Infinity norm of the (projected) gradient at the final point*/
+  Scalar gradient_norm = 0;
+  /*! Number of iterations performed*/
+  size_t iterations = 0;
+  /*! Number of objective and gradient evaluations*/
+  size_t evaluations = 0;
+};
+} // namespace teensynlp
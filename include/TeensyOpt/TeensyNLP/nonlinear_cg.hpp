@@ -0,0 +1,266 @@
+#pragma once
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Local includes
+#include "TeensyOpt/TeensyMat/linalg.hpp"
+#include "TeensyOpt/TeensyNLP/line_search.hpp"
+#include "TeensyOpt/TeensyNLP/nlp_problem.hpp"
+
+namespace teensynlp {
+/*! Choices of beta in NonlinearCG, with y = g_{k+1} - g_k*/
+enum class CGMethod {
+  /*! Polak-Ribiere+: max(0, g_{k+1}^T y / g_k^T g_k)*/
+  polak_ribiere_plus,
+  /*! Hestenes-Stiefel: g_{k+1}^T y / d_k^T y*/
+  hestenes_stiefel,
+  /*! Dai-Yuan: g_{k+1}^T g_{k+1} / d_k^T y*/
+  dai_yuan,
+  /*! CG_DESCENT of Hager and Zhang:
+   * (y - 2 d_k ||y||^2 / d_k^T y)^T g_{k+1} / d_k^T y, truncated below
+   * at -1 / (||d_k|| min(0.01, ||g_k||))*/
+  hager_zhang,
+};
+
+/*! Options of NonlinearCG*/
+template <typename Scalar> struct NonlinearCGOptions {
+  /*! Choice of beta*/
+  CGMethod method = CGMethod::hager_zhang;
+  /*! Maximum number of iterations*/
+  size_t max_iterations = 10000;
+  /*! Converged when the infinity norm of the gradient is below this*/
+  Scalar gradient_tolerance = 1e-6;
+  /*! Stop when f_k - f_{k+1} <= function_tolerance * max(|f_k|, |f_{k+1}|,
+   * 1) (0 disables the test)*/
+  Scalar function_tolerance = 0;
+  /*! Restart along -g after this many iterations (0 for max(n, 50):
+   * restarting every n iterations keeps small problems from ever building
+   * up conjugacy)*/
+  size_t restart_interval = 0;
+  /*! Restart when |g_{k+1}^T g_k| >= restart_threshold ||g_{k+1}||^2,
+   * the test of Powell (usually 0.2; 0 disables it)*/
+  Scalar restart_threshold = 0;
+  /*! Options of the line search (Hager and Zhang's search with their
+   * parameters by default)*/
+  LineSearchOptions<Scalar> line_search = {
+      .method = LineSearchMethod::hager_zhang, .sufficient_decrease = 0.1};
+};
+
+/*! Nonlinear conjugate gradient minimizer.
+ *
+ * Directions are d_{k+1} = -g_{k+1} + beta d_k with beta from one of the
+ * classic formulas, and steps come from a LineSearch. After the search,
+ * one pass over g_{k+1}, g_k and d_k gathers every inner product the
+ * formulas and the restart tests need, and a second pass forms the new
+ * direction; its slope and norm follow from those products, so no
+ * further pass is made. The direction restarts along -g periodically,
+ * whenever beta would not give a descent direction, and optionally when
+ * consecutive gradients are far from orthogonal. Besides the caller's
+ * point the solver keeps four vectors.
+ * */
+template <typename Scalar> class NonlinearCG {
+private:
+  /*! Options of the solve*/
+  NonlinearCGOptions<Scalar> options;
+  /*! Number of variables*/
+  size_t n;
+  /*! Search direction and second point buffer*/
+  std::vector<Scalar> direction, point;
+  /*! Gradient at the current point and at the trial point*/
+  std::vector<Scalar> gradient, trial_gradient;
+  /*! The line search*/
+  LineSearch<Scalar> search;
+  /*! Number of evaluations and of restarts in the current solve*/
+  size_t evaluations, restarts;
+
+  /*! Restart the direction along -g, returning g^T g*/
+  Scalar steepest_descent() {
+    Scalar const *g = this->gradient.data();
+    Scalar *d = this->direction.data();
+    Scalar gg = 0;
+    for (size_t i = 0; i < this->n; i++) {
+      d[i] = -g[i];
+      gg += g[i] * g[i];
+    }
+    return gg;
+  }
+
+public:
+  // SECTION: Constructors
+  /*! Allocate a minimizer.
+   *
+   * @param n Number of variables
+   * @param options Options of the solves
+   * */
+  explicit NonlinearCG(size_t n, NonlinearCGOptions<Scalar> options = {})
+      : options(options), n(n), direction(n), point(n), gradient(n),
+        trial_gradient(n), search(n, options.line_search), evaluations(0),
+        restarts(0) {}
+
+  // SECTION: Getters
+  /*! Get the number of variables*/
+  size_t get_dim() const { return this->n; }
+  /*! Get the gradient at the point returned by the last solve*/
+  std::vector<Scalar> const &get_gradient() const { return this->gradient; }
+  /*! Get the number of restarts of the last solve*/
+  size_t get_restarts() const { return this->restarts; }
+
+  // SECTION: Solving
+  /*! Minimize an objective.
+   *
+   * @param objective The objective and its gradient
+   * @param x The starting point, overwritten with the final point (n
+   * values)
+   * @return Summary of the solve
+   * */
+  NLPSolution<Scalar> minimize(Objective<Scalar> const &objective,
+                               Scalar *x) {
+    size_t n = this->n;
+    NLPSolution<Scalar> result;
+    this->evaluations = 0;
+    this->restarts = 0;
+    size_t interval = this->options.restart_interval > 0
+                          ? this->options.restart_interval
+                          : std::max(n, size_t{50});
+    Scalar *current = x;
+    Scalar *trial = this->point.data();
+    Scalar *d = this->direction.data();
+    Scalar value = objective(current, this->gradient.data());
+    this->evaluations++;
+    // g^T g, d^T d and g^T d at the current point
+    Scalar gg = this->steepest_descent();
+    Scalar dd = gg;
+    Scalar slope = -gg;
+    size_t since_restart = 0;
+    Scalar step = 0;
+    bool stalled = false;
+    for (;;) {
+      Scalar const *g = this->gradient.data();
+      Scalar norm = 0;
+      for (size_t i = 0; i < n; i++) {
+        norm = std::max(norm, std::abs(g[i]));
+      }
+      result.objective = value;
+      result.gradient_norm = norm;
+      if (!std::isfinite(value) || !std::isfinite(norm)) {
+        result.status = NLPStatus::numerical_error;
+        break;
+      }
+      if (norm <= this->options.gradient_tolerance) {
+        result.status = NLPStatus::converged;
+        break;
+      }
+      if (stalled) {
+        result.status = NLPStatus::function_tolerance;
+        break;
+      }
+      if (result.iterations >= this->options.max_iterations) {
+        result.status = NLPStatus::iteration_limit;
+        break;
+      }
+      // First step 1 / ||g||_inf, then the step predicted by the last one
+      Scalar previous_slope = slope;
+      step = result.iterations == 0 ? 1 / norm : step;
+      Scalar trial_value;
+      bool found = this->search.search(objective, current, d, value, slope,
+                                       step, trial,
+                                       this->trial_gradient.data(),
+                                       trial_value);
+      this->evaluations += this->search.get_evaluations();
+      if (!found) {
+        if (since_restart > 0) {
+          this->restarts++;
+          since_restart = 0;
+          gg = this->steepest_descent();
+          dd = gg;
+          slope = -gg;
+          step = 1 / norm;
+          continue;
+        }
+        result.status = NLPStatus::line_search_failure;
+        break;
+      }
+      // Every product of g_{k+1}, g_k and d_k in one pass
+      Scalar const *g_new = this->trial_gradient.data();
+      Scalar gy = 0, dy = 0, yy = 0, gg_new = 0, dg = 0, cross = 0;
+      for (size_t i = 0; i < n; i++) {
+        Scalar y = g_new[i] - g[i];
+        gy += g_new[i] * y;
+        dy += d[i] * y;
+        yy += y * y;
+        gg_new += g_new[i] * g_new[i];
+        dg += d[i] * g_new[i];
+        cross += g_new[i] * g[i];
+      }
+      Scalar beta = 0;
+      switch (this->options.method) {
+      case CGMethod::polak_ribiere_plus:
+        beta = std::max(gy / gg, Scalar{0});
+        break;
+      case CGMethod::hestenes_stiefel:
+        beta = gy / dy;
+        break;
+      case CGMethod::dai_yuan:
+        beta = gg_new / dy;
+        break;
+      case CGMethod::hager_zhang:
+        beta = (gy - 2 * dg * yy / dy) / dy;
+        beta = std::max(beta, -1 / (std::sqrt(dd) *
+                                    std::min(Scalar{0.01}, std::sqrt(gg))));
+        break;
+      }
+      since_restart++;
+      Scalar threshold = this->options.restart_threshold;
+      bool restart = since_restart >= interval ||
+                     (threshold > 0 && std::abs(cross) >= threshold * gg_new) ||
+                     !std::isfinite(beta) || !(beta * dg - gg_new < 0);
+      if (restart) {
+        beta = 0;
+        since_restart = 0;
+        this->restarts++;
+      }
+      for (size_t i = 0; i < n; i++) {
+        d[i] = beta * d[i] - g_new[i];
+      }
+      dd = beta * beta * dd - 2 * beta * dg + gg_new;
+      slope = beta * dg - gg_new;
+      gg = gg_new;
+      step = step * previous_slope / slope;
+      std::swap(current, trial);
+      this->gradient.swap(this->trial_gradient);
+      result.iterations++;
+      Scalar decrease = value - trial_value;
+      Scalar size = std::max({std::abs(value), std::abs(trial_value),
+                              Scalar{1}});
+      value = trial_value;
+      stalled = this->options.function_tolerance > 0 &&
+                decrease <= this->options.function_tolerance * size;
+    }
+    if (current != x) {
+      std::copy(current, current + n, x);
+    }
+    result.evaluations = this->evaluations;
+    return result;
+  }
+};
+
+/*! Minimize an objective with NonlinearCG.
+ *
+ * @param objective The objective and its gradient
+ * @param x The starting point, overwritten with the final point
+ * @param options Options of the solve
+ * @return Summary of the solve
+ * */
+template <typename Scalar>
+NLPSolution<Scalar> minimize_nonlinear_cg(
+    std::type_identity_t<Objective<Scalar>> const &objective,
+    std::vector<Scalar> &x, NonlinearCGOptions<Scalar> const &options = {}) {
+  NonlinearCG<Scalar> solver{x.size(), options};
+  return solver.minimize(objective, x.data());
+}
+} // namespace teensynlp
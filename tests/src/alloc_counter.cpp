@@ -0,0 +1,29 @@
+// Replaces the global operator new and delete for the tests_alloc
+// executable, counting every allocation. Kept in its own translation unit so
+// that the compiler never sees free paired with operator new.
+
+// std includes
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Local Includes
+#include "alloc_counter.hpp"
+
+namespace {
+std::atomic<size_t> allocation_count{0};
+} // namespace
+
+size_t test_alloc::allocations() {
+  return allocation_count.load(std::memory_order_relaxed);
+}
+
+void *operator new(size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (void *pointer = std::malloc(size == 0 ? 1 : size)) {
+    return pointer;
+  }
+  throw std::bad_alloc{};
+}
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+void operator delete(void *pointer, size_t) noexcept { std::free(pointer); }
@@ -0,0 +1,10 @@
+#pragma once
+// Counter of global allocations, for the tests_alloc executable only
+
+// std includes
+#include <cstddef>
+
+namespace test_alloc {
+/*! Number of calls of the global operator new so far*/
+size_t allocations();
+} // namespace test_alloc
@@ -0,0 +1,255 @@
+#pragma once
+// Helpers shared by the LP and QP solver tests
+
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyLP/lp_problem.hpp"
+#include "TeensyOpt/TeensyLP/qp_problem.hpp"
+
+namespace test_lp {
+inline constexpr double inf = teensylp::infinity<double>;
+
+/*! Build an LP from dense data*/
+inline teensylp::LPProblem<double>
+make_problem(size_t m, size_t n, std::vector<double> const &a,
+             std::vector<double> c, std::vector<double> row_lower,
+             std::vector<double> row_upper, std::vector<double> col_lower,
+             std::vector<double> col_upper) {
+  teensylp::LPProblem<double> problem;
+  problem.constraints = teensymat::SparseMatrix<double>::from_dense(
+      teensymat::Matrix<double>{m, n, a});
+  problem.objective = std::move(c);
+  problem.row_lower = std::move(row_lower);
+  problem.row_upper = std::move(row_upper);
+  problem.col_lower = std::move(col_lower);
+  problem.col_upper = std::move(col_upper);
+  return problem;
+}
+
+/*! Largest violation of the optimality conditions of a solution*/
+inline double kkt_error(teensylp::QPProblem<double> const &problem,
+                        teensylp::LPSolution<double> const &solution) {
+  double error = 0.0;
+  // Duals must be nonnegative unless at the upper bound, and nonpositive
+  // unless at the lower bound
+  auto sign_error = [&](double value, double lower, double upper,
+                        double dual) {
+    double scale = 1.0 + std::abs(value);
+    error = std::max(error, (lower - value) / scale);
+    error = std::max(error, (value - upper) / scale);
+    bool at_lower = value - lower <= 1e-6 * scale;
+    bool at_upper = upper - value <= 1e-6 * scale;
+    if (!at_lower) {
+      error = std::max(error, dual);
+    }
+    if (!at_upper) {
+      error = std::max(error, -dual);
+    }
+  };
+  std::vector<double> activity = problem.constraints.multiply(solution.x);
+  std::vector<double> reduced = problem.constraints.multiply_transpose(
+      solution.row_duals);
+  // Gradient of the objective minus A^T y
+  std::vector<double> gradient = problem.objective;
+  problem.add_hessian_product(solution.x.data(), gradient.data());
+  for (size_t j = 0; j < problem.get_ncols(); j++) {
+    reduced[j] = gradient[j] - reduced[j];
+    error = std::max(error, std::abs(reduced[j] - solution.reduced_costs[j]));
+    sign_error(solution.x[j], problem.col_lower[j], problem.col_upper[j],
+               reduced[j]);
+  }
+  for (size_t i = 0; i < problem.get_nrows(); i++) {
+    error = std::max(error, std::abs(activity[i] - solution.row_activity[i]) /
+                                (1.0 + std::abs(activity[i])));
+    sign_error(activity[i], problem.row_lower[i], problem.row_upper[i],
+               solution.row_duals[i]);
+  }
+  return error;
+}
+
+/*! A random feasible and bounded sparse LP with all kinds of bounds*/
+inline teensylp::LPProblem<double> random_problem(size_t m, size_t n,
+                                                  unsigned seed) {
+  std::mt19937 generator{seed};
+  std::uniform_real_distribution<double> uniform{0.0, 1.0};
+  std::normal_distribution<double> normal{0.0, 1.0};
+  std::vector<size_t> rows;
+  std::vector<size_t> cols;
+  std::vector<double> values;
+  for (size_t j = 0; j < n; j++) {
+    for (size_t k = 0; k < 4; k++) {
+      rows.push_back(generator() % m);
+      cols.push_back(j);
+      values.push_back(normal(generator));
+    }
+  }
+  teensylp::LPProblem<double> problem;
+  problem.constraints = teensymat::SparseMatrix<double>::from_triplets(
+      m, n, rows, cols, values);
+  // Feasible point x0 and dual point (y0, z0) with the right signs
+  std::vector<double> x0(n);
+  std::vector<double> z0(n);
+  for (size_t j = 0; j < n; j++) {
+    x0[j] = uniform(generator);
+    switch (j % 4) {
+    case 0: // boxed
+      problem.col_lower.push_back(0.0);
+      problem.col_upper.push_back(1.0 + uniform(generator));
+      z0[j] = normal(generator);
+      break;
+    case 1: // lower bounded
+      problem.col_lower.push_back(0.0);
+      problem.col_upper.push_back(inf);
+      z0[j] = uniform(generator);
+      break;
+    case 2: // upper bounded
+      problem.col_lower.push_back(-inf);
+      problem.col_upper.push_back(1.0);
+      z0[j] = -uniform(generator);
+      break;
+    default: // free
+      problem.col_lower.push_back(-inf);
+      problem.col_upper.push_back(inf);
+      z0[j] = 0.0;
+    }
+  }
+  std::vector<double> activity = problem.constraints.multiply(x0);
+  std::vector<double> y0(m);
+  for (size_t i = 0; i < m; i++) {
+    switch (i % 4) {
+    case 0: // equality
+      problem.row_lower.push_back(activity[i]);
+      problem.row_upper.push_back(activity[i]);
+      y0[i] = normal(generator);
+      break;
+    case 1: // greater equal
+      problem.row_lower.push_back(activity[i] - uniform(generator));
+      problem.row_upper.push_back(inf);
+      y0[i] = uniform(generator);
+      break;
+    case 2: // less equal
+      problem.row_lower.push_back(-inf);
+      problem.row_upper.push_back(activity[i] + uniform(generator));
+      y0[i] = -uniform(generator);
+      break;
+    default: // ranged
+      problem.row_lower.push_back(activity[i] - uniform(generator));
+      problem.row_upper.push_back(activity[i] + uniform(generator));
+      y0[i] = normal(generator);
+    }
+  }
+  problem.objective = problem.constraints.multiply_transpose(y0);
+  for (size_t j = 0; j < n; j++) {
+    problem.objective[j] += z0[j];
+  }
+  return problem;
+}
+
+/*! A random convex QP: a random LP plus a positive diagonal and, unless
+ * diagonal is set, rank one terms coupling neighbouring variables*/
+inline teensylp::QPProblem<double> random_qp(size_t m, size_t n,
+                                             unsigned seed,
+                                             bool diagonal = false) {
+  teensylp::QPProblem<double> problem{random_problem(m, n, seed)};
+  std::mt19937 generator{seed};
+  std::normal_distribution<double> normal{0.0, 1.0};
+  std::vector<size_t> rows, cols;
+  std::vector<double> vals;
+  for (size_t j = 0; j < n; j++) {
+    rows.push_back(j);
+    cols.push_back(j);
+    vals.push_back(0.5 + std::abs(normal(generator)));
+    if (!diagonal && j + 1 < n) {
+      // Rank one terms b b^T with b = e_j + e_{j+1}
+      double weight = std::abs(normal(generator));
+      rows.insert(rows.end(), {j, j, j + 1});
+      cols.insert(cols.end(), {j, j + 1, j + 1});
+      vals.insert(vals.end(), {weight, weight, weight});
+    }
+  }
+  problem.hessian = teensymat::SparseMatrix<double>::from_triplets(
+      n, n, rows, cols, vals);
+  return problem;
+}
+
+/*! A model predictive control QP of a chain of masses: states and inputs
+ * of every stage are the variables, the dynamics are equality rows and
+ * the states and inputs are boxed*/
+inline teensylp::QPProblem<double>
+mpc_qp(size_t horizon, std::vector<double> const &initial) {
+  size_t nx = initial.size();
+  size_t nu = nx / 2;
+  size_t stage = nx + nu;
+  size_t n = horizon * stage;
+  std::vector<size_t> rows, cols;
+  std::vector<double> vals;
+  auto add = [&](size_t i, size_t j, double value) {
+    rows.push_back(i);
+    cols.push_back(j);
+    vals.push_back(value);
+  };
+  teensylp::QPProblem<double> problem;
+  // x_{k+1} = A x_k + B u_k, with x_0 given
+  double dt = 0.1;
+  for (size_t k = 0; k < horizon; k++) {
+    for (size_t i = 0; i < nx; i++) {
+      size_t row = k * nx + i;
+      add(row, k * stage + i, -1.0);
+      double constant = 0;
+      std::vector<double> a(nx, 0.0);
+      a[i] = 1.0;
+      if (i < nu) {
+        // Position: x_i + dt v_i
+        a[nu + i] = dt;
+      } else {
+        // Velocity: v_i + dt (x_{i-1} - 2 x_i + x_{i+1})
+        size_t p = i - nu;
+        a[p] -= 2 * dt;
+        if (p > 0) {
+          a[p - 1] += dt;
+        }
+        if (p + 1 < nu) {
+          a[p + 1] += dt;
+        }
+      }
+      for (size_t j = 0; j < nx; j++) {
+        if (a[j] == 0.0) {
+          continue;
+        }
+        if (k == 0) {
+          constant -= a[j] * initial[j];
+        } else {
+          add(row, (k - 1) * stage + j, a[j]);
+        }
+      }
+      if (i >= nu) {
+        add(row, k * stage + nx + (i - nu), dt);
+      }
+      problem.row_lower.push_back(constant);
+      problem.row_upper.push_back(constant);
+    }
+    for (size_t i = 0; i < stage; i++) {
+      problem.col_lower.push_back(i < nx ? -2.0 : -1.0);
+      problem.col_upper.push_back(i < nx ? 2.0 : 1.0);
+    }
+  }
+  problem.constraints = teensymat::SparseMatrix<double>::from_triplets(
+      horizon * nx, n, rows, cols, vals);
+  std::vector<size_t> diagonal(n);
+  std::vector<double> weights(n);
+  for (size_t j = 0; j < n; j++) {
+    diagonal[j] = j;
+    weights[j] = j % stage < nx ? 1.0 : 0.1;
+  }
+  problem.hessian = teensymat::SparseMatrix<double>::from_triplets(
+      n, n, diagonal, diagonal, weights);
+  problem.objective.assign(n, 0.0);
+  return problem;
+}
+} // namespace test_lp
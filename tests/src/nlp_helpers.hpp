@@ -0,0 +1,41 @@
+#pragma once
+// Helpers shared by the NLP solver tests
+
+// std includes
+#include <cstddef>
+#include <vector>
+
+namespace test_nlp {
+/*! The extended Rosenbrock function (n even), minimized at all ones*/
+inline double rosenbrock(double const *x, double *gradient, size_t n) {
+  double value = 0;
+  for (size_t i = 0; i < n; i += 2) {
+    double a = x[i + 1] - x[i] * x[i];
+    double b = 1 - x[i];
+    value += 100 * a * a + b * b;
+    gradient[i] = -400 * a * x[i] - 2 * b;
+    gradient[i + 1] = 200 * a;
+  }
+  return value;
+}
+
+/*! Product of the Hessian of the extended Rosenbrock function with v*/
+inline void rosenbrock_product(double const *x, double const *v,
+                               double *product, size_t n) {
+  for (size_t i = 0; i < n; i += 2) {
+    double h00 = 1200 * x[i] * x[i] - 400 * x[i + 1] + 2;
+    double h01 = -400 * x[i];
+    product[i] = h00 * v[i] + h01 * v[i + 1];
+    product[i + 1] = h01 * v[i] + 200 * v[i + 1];
+  }
+}
+
+/*! Starting point (-1.2, 1, -1.2, 1, ...) of the Rosenbrock function*/
+inline std::vector<double> rosenbrock_start(size_t n) {
+  std::vector<double> x(n);
+  for (size_t i = 0; i < n; i++) {
+    x[i] = i % 2 == 0 ? -1.2 : 1.0;
+  }
+  return x;
+}
+} // namespace test_nlp
@@ -0,0 +1,214 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyLP/active_set.hpp"
+#include "TeensyOpt/TeensyLP/interior_point.hpp"
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+#include "lp_helpers.hpp"
+
+using test_lp::inf;
+using test_lp::kkt_error;
+using test_lp::make_problem;
+using test_lp::random_qp;
+
+namespace {
+/*! A dense QP with a random positive definite Hessian, a random linear
+ * cost and m random rows boxed around their values at a random point*/
+teensylp::ActiveSetQP<double> random_dense_qp(size_t m, size_t n,
+                                              unsigned seed) {
+  std::mt19937 generator{seed};
+  std::normal_distribution<double> normal{0.0, 1.0};
+  teensymat::Matrix<double> factor{n, n};
+  for (double &value : *factor.get_data()) {
+    value = normal(generator);
+  }
+  teensymat::Matrix<double> hessian{n, n};
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < n; j++) {
+      double sum = i == j ? 1.0 : 0.0;
+      for (size_t k = 0; k < n; k++) {
+        sum += *factor(i, k) * *factor(j, k) / static_cast<double>(n);
+      }
+      *hessian(i, j) = sum;
+    }
+  }
+  std::vector<double> gradient(n);
+  for (double &value : gradient) {
+    value = 5 * normal(generator);
+  }
+  teensylp::ActiveSetQP<double> solver{hessian, gradient};
+  std::vector<double> point(n);
+  for (double &value : point) {
+    value = normal(generator);
+  }
+  std::vector<double> row(n);
+  for (size_t i = 0; i < m; i++) {
+    double center = 0.5 * normal(generator);
+    for (size_t j = 0; j < n; j++) {
+      row[j] = normal(generator);
+      center += row[j] * point[j];
+    }
+    solver.add_constraint(row, center - 1.0, center + 1.0);
+  }
+  return solver;
+}
+} // namespace
+
+TEST_CASE("Active set method on small programs", "[active_set]") {
+  SECTION("Inequality constrained program") {
+    // minimize 1/2 (x1^2 + x2^2) - x1 - x2 with x1 + x2 <= 1
+    teensylp::ActiveSetQP<double> solver{
+        teensymat::Matrix<double>{2, 2, {1, 0, 0, 1}}, {-1, -1}};
+    solver.add_constraint({1, 1}, -inf, 1);
+    auto solution = solver.solve();
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE_THAT(solution.x[0], Catch::Matchers::WithinAbs(0.5, 1e-12));
+    REQUIRE_THAT(solution.objective,
+                 Catch::Matchers::WithinAbs(-0.75, 1e-12));
+    REQUIRE_THAT(solution.row_duals[0],
+                 Catch::Matchers::WithinAbs(-0.5, 1e-12));
+    REQUIRE(solution.row_status[0] == teensylp::BasisStatus::at_upper);
+  }
+  SECTION("Equality constrained program") {
+    // minimize x1^2 + x2^2 + x3^2 with x1 + x2 + x3 = 3, x1 - x2 = 1
+    teensylp::ActiveSetQP<double> solver{
+        teensymat::Matrix<double>{3, 3, {2, 0, 0, 0, 2, 0, 0, 0, 2}},
+        {0, 0, 0}};
+    solver.add_constraint({1, 1, 1}, 3, 3);
+    solver.add_constraint({1, -1, 0}, 1, 1);
+    // Redundant with the first row
+    solver.add_constraint({2, 2, 2}, 6, 6);
+    auto solution = solver.solve();
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE_THAT(solution.x[0], Catch::Matchers::WithinAbs(1.5, 1e-12));
+    REQUIRE_THAT(solution.x[1], Catch::Matchers::WithinAbs(0.5, 1e-12));
+    REQUIRE_THAT(solution.x[2], Catch::Matchers::WithinAbs(1.0, 1e-12));
+    REQUIRE(solver.get_working_set().size() == 2);
+  }
+  SECTION("Infeasible constraints") {
+    teensylp::ActiveSetQP<double> solver{
+        teensymat::Matrix<double>{2, 2, {1, 0, 0, 1}}, {0, 0}};
+    solver.add_constraint({1, 1}, 3, inf);
+    solver.add_constraint({1, 1}, -inf, 1);
+    REQUIRE(solver.solve().status == teensylp::LPStatus::infeasible);
+  }
+  SECTION("Invalid data") {
+    teensylp::ActiveSetQP<double> solver{
+        teensymat::Matrix<double>{2, 2, {1, 0, 0, -1}}, {0, 0}};
+    REQUIRE_THROWS_AS(solver.solve(), std::runtime_error);
+    REQUIRE_THROWS_AS(solver.add_constraint({1, 1, 1}, 0, 1),
+                      std::range_error);
+    REQUIRE_THROWS_AS(solver.add_constraint({1, 1}, 1, 0), std::range_error);
+    REQUIRE_THROWS_AS(
+        (teensylp::ActiveSetQP<double>{teensymat::Matrix<double>{2, 2},
+                                       {0, 0, 0}}),
+        std::runtime_error);
+  }
+}
+
+TEST_CASE("Active set method on random programs", "[active_set]") {
+  SECTION("Sparse programs match the interior point method") {
+    for (unsigned seed : {1u, 2u, 3u}) {
+      auto problem = random_qp(40, 60, seed);
+      auto reference = teensylp::solve_interior_point(problem);
+      REQUIRE(reference.status == teensylp::LPStatus::optimal);
+      auto solution = teensylp::solve_active_set(problem);
+      REQUIRE(solution.status == teensylp::LPStatus::optimal);
+      REQUIRE(kkt_error(problem, solution) < 1e-9);
+      REQUIRE_THAT(solution.objective,
+                   Catch::Matchers::WithinRel(reference.objective, 1e-7));
+    }
+  }
+  SECTION("Dense programs satisfy the optimality conditions") {
+    auto solver = random_dense_qp(100, 50, 4);
+    auto solution = solver.solve();
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE_FALSE(solver.get_working_set().empty());
+    for (size_t j = 0; j < 50; j++) {
+      REQUIRE(std::abs(solution.reduced_costs[j]) < 1e-9);
+    }
+    for (size_t i = 0; i < 100; i++) {
+      bool active = solution.row_status[i] != teensylp::BasisStatus::basic;
+      REQUIRE((active || solution.row_duals[i] == 0.0));
+    }
+  }
+  SECTION("Linear programs are rejected") {
+    auto problem = make_problem(1, 2, {1, 1}, {-1, -1}, {-inf}, {1}, {0, 0},
+                                {inf, inf});
+    REQUIRE_THROWS_AS(
+        teensylp::solve_active_set(teensylp::QPProblem<double>{problem}),
+        std::runtime_error);
+  }
+}
+
+TEST_CASE("Active set method hot starts", "[active_set]") {
+  auto solver = random_dense_qp(100, 50, 5);
+  auto cold = solver.solve();
+  REQUIRE(cold.status == teensylp::LPStatus::optimal);
+  size_t updates = solver.get_num_updates();
+  SECTION("Re-solving the same program does no work") {
+    auto again = solver.solve();
+    REQUIRE(again.status == teensylp::LPStatus::optimal);
+    REQUIRE(again.iterations == 0);
+    REQUIRE(solver.get_num_updates() == updates);
+    REQUIRE_THAT(again.objective,
+                 Catch::Matchers::WithinRel(cold.objective, 1e-12));
+  }
+  SECTION("New and changed constraints") {
+    auto fresh = random_dense_qp(100, 50, 5);
+    std::vector<double> row(50, 0.0);
+    row[0] = 1.0;
+    row[1] = 1.0;
+    double activity = cold.x[0] + cold.x[1];
+    solver.add_constraint(row, -inf, activity - 0.5);
+    fresh.add_constraint(row, -inf, activity - 0.5);
+    // Shift the bounds of a working constraint and change another row
+    size_t shifted = solver.get_working_set()[0];
+    size_t changed = solver.get_working_set()[1];
+    solver.set_constraint_bounds(shifted, cold.row_activity[shifted] - 1.1,
+                                 cold.row_activity[shifted] + 0.9);
+    fresh.set_constraint_bounds(shifted, cold.row_activity[shifted] - 1.1,
+                                cold.row_activity[shifted] + 0.9);
+    row.assign(50, 0.5);
+    solver.set_constraint_row(changed, row);
+    fresh.set_constraint_row(changed, row);
+    auto hot = solver.solve();
+    auto reference = fresh.solve();
+    REQUIRE(hot.status == teensylp::LPStatus::optimal);
+    REQUIRE(solver.get_num_factorizations() == 1);
+    REQUIRE(hot.iterations < reference.iterations);
+    REQUIRE_THAT(hot.objective,
+                 Catch::Matchers::WithinRel(reference.objective, 1e-10));
+    for (size_t j = 0; j < 50; j++) {
+      REQUIRE_THAT(hot.x[j], Catch::Matchers::WithinAbs(reference.x[j], 1e-8));
+    }
+  }
+  SECTION("New linear cost and Hessian") {
+    auto fresh = random_dense_qp(100, 50, 5);
+    std::vector<double> gradient(50, 1.0);
+    teensymat::Matrix<double> hessian{50, 50};
+    for (size_t i = 0; i < 50; i++) {
+      *hessian(i, i) = 2.0;
+    }
+    solver.set_gradient(gradient);
+    fresh.set_gradient(gradient);
+    auto hot = solver.solve();
+    REQUIRE(solver.get_num_factorizations() == 1);
+    REQUIRE_THAT(hot.objective,
+                 Catch::Matchers::WithinRel(fresh.solve().objective, 1e-10));
+    solver.set_hessian(hessian);
+    fresh.set_hessian(hessian);
+    hot = solver.solve();
+    REQUIRE(solver.get_num_factorizations() == 2);
+    REQUIRE_THAT(hot.objective,
+                 Catch::Matchers::WithinRel(fresh.solve().objective, 1e-10));
+  }
+}
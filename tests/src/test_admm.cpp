@@ -0,0 +1,199 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyLP/admm.hpp"
+#include "TeensyOpt/TeensyLP/interior_point.hpp"
+#include "TeensyOpt/TeensyLP/simplex.hpp"
+#include "lp_helpers.hpp"
+
+using test_lp::inf;
+using test_lp::kkt_error;
+using test_lp::make_problem;
+using test_lp::mpc_qp;
+using test_lp::random_problem;
+using test_lp::random_qp;
+
+TEST_CASE("ADMM on small programs", "[admm]") {
+  SECTION("Quadratic program") {
+    // minimize 1/2 (x1^2 + x2^2) - x1 - x2 with x1 + x2 <= 1, x >= 0
+    teensylp::QPProblem<double> problem{make_problem(
+        1, 2, {1, 1}, {-1, -1}, {-inf}, {1}, {0, 0}, {inf, inf})};
+    problem.hessian = teensymat::SparseMatrix<double>::from_triplets(
+        2, 2, {0, 1}, {0, 1}, {1, 1});
+    teensylp::ADMM<double> solver{problem};
+    auto solution = solver.solve();
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE(solver.get_polished());
+    REQUIRE_THAT(solution.x[0], Catch::Matchers::WithinAbs(0.5, 1e-7));
+    REQUIRE_THAT(solution.objective, Catch::Matchers::WithinAbs(-0.75, 1e-7));
+    REQUIRE_THAT(solution.row_duals[0], Catch::Matchers::WithinAbs(-0.5, 1e-7));
+  }
+  SECTION("Textbook linear program") {
+    auto problem = make_problem(3, 2, {1, 0, 0, 2, 3, 2}, {-3, -5},
+                                {-inf, -inf, -inf}, {4, 12, 18}, {0, 0},
+                                {inf, inf});
+    auto solution = teensylp::solve_admm(problem);
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE_THAT(solution.objective, Catch::Matchers::WithinAbs(-36, 1e-6));
+    REQUIRE_THAT(solution.x[0], Catch::Matchers::WithinAbs(2, 1e-6));
+    REQUIRE_THAT(solution.x[1], Catch::Matchers::WithinAbs(6, 1e-6));
+    REQUIRE_THAT(solution.row_duals[2], Catch::Matchers::WithinAbs(-1, 1e-6));
+  }
+  SECTION("Infeasible constraints") {
+    auto problem = make_problem(2, 2, {1, 1, 1, 1}, {1, 1}, {3, -inf},
+                                {inf, 1}, {0, 0}, {inf, inf});
+    REQUIRE(teensylp::solve_admm(problem).status ==
+            teensylp::LPStatus::infeasible);
+    problem = make_problem(1, 2, {1, 1}, {1, 1}, {5}, {5}, {0, 0}, {1, 1});
+    REQUIRE(teensylp::solve_admm(problem).status ==
+            teensylp::LPStatus::infeasible);
+  }
+  SECTION("Unbounded objective") {
+    auto problem = make_problem(1, 2, {1, -1}, {-1, 0}, {-inf}, {1}, {0, 0},
+                                {inf, inf});
+    REQUIRE(teensylp::solve_admm(problem).status ==
+            teensylp::LPStatus::unbounded);
+  }
+  SECTION("Invalid options") {
+    auto problem = make_problem(1, 1, {1}, {1}, {0}, {1}, {0}, {1});
+    teensylp::ADMMOptions<double> options;
+    options.relaxation = 2.0;
+    REQUIRE_THROWS_AS(teensylp::solve_admm(problem, options),
+                      std::runtime_error);
+  }
+}
+
+TEST_CASE("ADMM on random programs", "[admm]") {
+  SECTION("Quadratic programs match the interior point method") {
+    for (unsigned seed : {1u, 2u, 3u}) {
+      auto problem = random_qp(60, 100, seed);
+      auto reference = teensylp::solve_interior_point(problem);
+      REQUIRE(reference.status == teensylp::LPStatus::optimal);
+      teensylp::ADMM<double> solver{problem};
+      auto solution = solver.solve();
+      REQUIRE(solution.status == teensylp::LPStatus::optimal);
+      REQUIRE(solver.get_polished());
+      REQUIRE(kkt_error(problem, solution) < 1e-6);
+      REQUIRE_THAT(solution.objective,
+                   Catch::Matchers::WithinRel(reference.objective, 1e-6));
+    }
+  }
+  SECTION("Without polishing the tolerances are met") {
+    auto problem = random_qp(60, 100, 4);
+    teensylp::ADMMOptions<double> options;
+    options.polish = false;
+    teensylp::ADMM<double> solver{problem, options};
+    auto solution = solver.solve();
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE_FALSE(solver.get_polished());
+    REQUIRE(solver.get_primal_residual() < 1e-3);
+    REQUIRE(solver.get_dual_residual() < 1e-3);
+  }
+  SECTION("Linear programs match the simplex method") {
+    auto problem = random_problem(60, 100, 5);
+    auto reference = teensylp::solve_simplex(problem);
+    auto solution = teensylp::solve_admm(problem);
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE_THAT(solution.objective,
+                 Catch::Matchers::WithinRel(reference.objective, 1e-6));
+  }
+  SECTION("rho updates refactor without a new analysis") {
+    auto problem = random_qp(60, 100, 6);
+    teensylp::ADMMOptions<double> options;
+    options.rho = 1e-4;
+    teensylp::ADMM<double> solver{problem, options};
+    REQUIRE(solver.solve().status == teensylp::LPStatus::optimal);
+    REQUIRE(solver.get_rho() > 1e-4);
+    REQUIRE(solver.get_num_factorizations() > 1);
+    REQUIRE(solver.get_num_analyses() == 1);
+    // Without adaptation the first factorization is the only one
+    options.adaptive_rho = false;
+    options.max_iterations = 50;
+    teensylp::ADMM<double> fixed{problem, options};
+    fixed.solve();
+    REQUIRE(fixed.get_num_factorizations() == 1);
+  }
+}
+
+TEST_CASE("ADMM warm starts", "[admm]") {
+  std::vector<double> initial{1.0, -0.5, 0.8, 0.0, 0.3, -0.2,
+                              0.1, 0.4, -0.1, 0.2};
+  auto problem = mpc_qp(20, initial);
+  auto reference = teensylp::solve_interior_point(problem);
+  REQUIRE(reference.status == teensylp::LPStatus::optimal);
+  teensylp::ADMM<double> solver{problem};
+  auto cold = solver.solve();
+  REQUIRE(cold.status == teensylp::LPStatus::optimal);
+  REQUIRE(kkt_error(problem, cold) < 1e-6);
+  REQUIRE_THAT(cold.objective,
+               Catch::Matchers::WithinRel(reference.objective, 1e-6));
+  SECTION("New initial state") {
+    // The next control step only changes the bounds of the first rows
+    for (double &value : initial) {
+      value *= 0.95;
+    }
+    auto changed = mpc_qp(20, initial);
+    size_t factorizations = solver.get_num_factorizations();
+    auto changes = solver.update(changed);
+    REQUIRE(changes.bounds);
+    REQUIRE_FALSE(changes.values);
+    REQUIRE(solver.get_num_factorizations() == factorizations);
+    auto warm = solver.solve();
+    REQUIRE(warm.status == teensylp::LPStatus::optimal);
+    REQUIRE(kkt_error(changed, warm) < 1e-6);
+    REQUIRE(warm.iterations < cold.iterations);
+    REQUIRE(solver.get_num_analyses() == 1);
+  }
+  SECTION("Polished warm start without iterations") {
+    // A small change of the initial state keeps the active set, so
+    // polishing the warm start already solves the new problem
+    for (double &value : initial) {
+      value *= 0.99;
+    }
+    auto changed = mpc_qp(20, initial);
+    solver.update(changed);
+    auto warm = solver.solve();
+    REQUIRE(warm.status == teensylp::LPStatus::optimal);
+    REQUIRE(warm.iterations == 0);
+    REQUIRE(solver.get_polished());
+    REQUIRE(kkt_error(changed, warm) < 1e-6);
+    // Without it the iterations run first
+    teensylp::ADMMOptions<double> options;
+    options.polish_warm_start = false;
+    teensylp::ADMM<double> iterated{problem, options};
+    iterated.solve();
+    iterated.update(changed);
+    auto reference_warm = iterated.solve();
+    REQUIRE(reference_warm.status == teensylp::LPStatus::optimal);
+    REQUIRE(reference_warm.iterations > 0);
+    REQUIRE_THAT(warm.objective,
+                 Catch::Matchers::WithinRel(reference_warm.objective, 1e-6));
+  }
+  SECTION("Starting point from another solver") {
+    teensylp::ADMM<double> other{problem};
+    other.set_starting_point(reference);
+    auto warm = other.solve();
+    REQUIRE(warm.status == teensylp::LPStatus::optimal);
+    REQUIRE(warm.iterations < cold.iterations);
+    REQUIRE_THROWS_AS(other.set_starting_point(teensylp::LPSolution<double>{}),
+                      std::range_error);
+  }
+  SECTION("New matrix values") {
+    auto changed = problem;
+    (*changed.hessian.get_values())[0] = 2.0;
+    auto changes = solver.update(changed);
+    REQUIRE(changes.objective);
+    auto warm = solver.solve();
+    REQUIRE(warm.status == teensylp::LPStatus::optimal);
+    REQUIRE(kkt_error(changed, warm) < 1e-6);
+    REQUIRE(solver.get_num_analyses() == 1);
+  }
+}
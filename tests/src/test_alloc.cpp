@@ -0,0 +1,84 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+
+// std includes
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyLP/admm.hpp"
+#include "TeensyOpt/TeensyNLP/lbfgs.hpp"
+#include "alloc_counter.hpp"
+#include "lp_helpers.hpp"
+#include "nlp_helpers.hpp"
+
+using test_alloc::allocations;
+using test_lp::mpc_qp;
+using test_nlp::rosenbrock;
+using test_nlp::rosenbrock_start;
+
+TEST_CASE("L-BFGS allocations", "[lbfgs][alloc]") {
+  SECTION("Minimizing allocates nothing after construction") {
+    size_t n = 100;
+    teensynlp::LBFGS<double> solver{n};
+    teensynlp::Objective<double> objective = [n](double const *x,
+                                                 double *gradient) {
+      return rosenbrock(x, gradient, n);
+    };
+    auto x = rosenbrock_start(n);
+    auto start = x;
+    solver.minimize(objective, x.data());
+    std::copy(start.begin(), start.end(), x.begin());
+    size_t before = allocations();
+    auto solution = solver.minimize(objective, x.data());
+    size_t after = allocations();
+    REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+    REQUIRE(solution.iterations > 10);
+    REQUIRE(after == before);
+  }
+}
+
+TEST_CASE("ADMM allocations", "[admm][alloc]") {
+  std::vector<double> initial{1.0, -0.5, 0.8, 0.0, 0.3, -0.2,
+                              0.1, 0.4, -0.1, 0.2};
+  auto problem = mpc_qp(20, initial);
+  // Warm solve of the problem with the initial state scaled, returning the
+  // solution and the number of allocations of solve
+  auto warm_solve = [&](teensylp::ADMM<double> &solver, double scale) {
+    auto changed = initial;
+    for (double &value : changed) {
+      value *= scale;
+    }
+    solver.update(mpc_qp(20, changed));
+    size_t before = allocations();
+    auto solution = solver.solve();
+    size_t after = allocations();
+    return std::pair{std::move(solution), after - before};
+  };
+  // A warm start which polishing already solves returns without iterating,
+  // so its allocations are those of the solution only
+  teensylp::ADMM<double> polished{problem};
+  polished.solve();
+  auto [reference, solution_allocations] = warm_solve(polished, 0.99);
+  REQUIRE(reference.status == teensylp::LPStatus::optimal);
+  REQUIRE(reference.iterations == 0);
+  SECTION("Iterating allocates nothing after the first solve") {
+    teensylp::ADMM<double> solver{problem};
+    solver.solve();
+    auto [solution, count] = warm_solve(solver, 0.95);
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE(solution.iterations > 0);
+    REQUIRE(count == solution_allocations);
+  }
+  SECTION("rho updates only refactor numerically") {
+    teensylp::ADMM<double> solver{problem};
+    solver.solve();
+    double rho = solver.get_rho();
+    auto [solution, count] = warm_solve(solver, 0.8);
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE(solver.get_rho() != rho);
+    REQUIRE(solver.get_num_analyses() == 1);
+    REQUIRE(count == solution_allocations);
+  }
+}
@@ -0,0 +1,163 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+
+// std includes
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyMat/coloring.hpp"
+#include "TeensyOpt/TeensyMat/sparse_core.hpp"
+
+namespace {
+/*! Random symmetric pattern with the given number of off-diagonal pairs,
+ * and a full diagonal*/
+teensymat::SparseMatrix<double> random_symmetric(size_t n, size_t pairs) {
+  std::vector<size_t> rows, cols;
+  std::uint64_t state = 12345;
+  auto next = [&] {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return static_cast<size_t>(state >> 33);
+  };
+  for (size_t i = 0; i < n; i++) {
+    rows.push_back(i);
+    cols.push_back(i);
+  }
+  for (size_t k = 0; k < pairs; k++) {
+    size_t i = next() % n;
+    size_t j = next() % n;
+    if (i != j) {
+      rows.insert(rows.end(), {i, j});
+      cols.insert(cols.end(), {j, i});
+    }
+  }
+  return teensymat::SparseMatrix<double>::from_triplets(
+      n, n, rows, cols, std::vector<double>(rows.size(), 1.0));
+}
+
+/*! Whether no two columns of the same color share a row*/
+bool valid_column_coloring(teensymat::SparseMatrix<double> const &pattern,
+                           teensymat::Coloring const &coloring) {
+  std::vector<size_t> owner(pattern.get_nrows() * coloring.num_colors,
+                            pattern.get_ncols());
+  auto const &col_ptr = pattern.get_col_ptr();
+  auto const &row_idx = pattern.get_row_idx();
+  for (size_t j = 0; j < pattern.get_ncols(); j++) {
+    for (size_t p = col_ptr[j]; p < col_ptr[j + 1]; p++) {
+      size_t &slot =
+          owner[row_idx[p] * coloring.num_colors + coloring.colors[j]];
+      if (slot != pattern.get_ncols()) {
+        return false;
+      }
+      slot = j;
+    }
+  }
+  return true;
+}
+
+/*! Whether a coloring of a symmetric pattern is a star coloring (adjacent
+ * vertices differ and no path on four vertices has two colors)*/
+bool valid_star_coloring(teensymat::SparseMatrix<double> const &pattern,
+                         teensymat::Coloring const &coloring) {
+  size_t n = pattern.get_ncols();
+  std::vector<std::vector<size_t>> adjacency(n);
+  for (size_t j = 0; j < n; j++) {
+    for (size_t i = 0; i < n; i++) {
+      if (i != j && (pattern.coeff(i, j) != 0 || pattern.coeff(j, i) != 0)) {
+        adjacency[j].push_back(i);
+      }
+    }
+  }
+  auto const &colors = coloring.colors;
+  for (size_t w = 0; w < n; w++) {
+    for (size_t x : adjacency[w]) {
+      if (colors[w] == colors[x]) {
+        return false;
+      }
+      for (size_t u : adjacency[w]) {
+        for (size_t y : adjacency[x]) {
+          if (u != x && y != w && u != y && colors[u] == colors[x] &&
+              colors[y] == colors[w]) {
+            return false;
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+} // namespace
+
+TEST_CASE("Column coloring", "[coloring]") {
+  SECTION("Tridiagonal") {
+    size_t n = 30;
+    std::vector<size_t> rows, cols;
+    for (size_t i = 0; i < n; i++) {
+      for (size_t j = i > 0 ? i - 1 : 0; j < std::min(n, i + 2); j++) {
+        rows.push_back(i);
+        cols.push_back(j);
+      }
+    }
+    auto pattern = teensymat::SparseMatrix<double>::from_triplets(
+        n, n, rows, cols, std::vector<double>(rows.size(), 1.0));
+    for (auto order : {teensymat::ColoringOrder::natural,
+                       teensymat::ColoringOrder::largest_first,
+                       teensymat::ColoringOrder::dsatur}) {
+      auto coloring = teensymat::color_columns(pattern, order);
+      REQUIRE(coloring.num_colors == 3);
+      REQUIRE(valid_column_coloring(pattern, coloring));
+      REQUIRE(coloring.color_ptr.back() == n);
+      for (size_t c = 0; c < coloring.num_colors; c++) {
+        for (size_t k = coloring.color_ptr[c]; k < coloring.color_ptr[c + 1];
+             k++) {
+          REQUIRE(coloring.colors[coloring.columns[k]] == c);
+        }
+      }
+    }
+  }
+  SECTION("Random pattern") {
+    auto pattern = random_symmetric(60, 150);
+    for (auto order : {teensymat::ColoringOrder::natural,
+                       teensymat::ColoringOrder::largest_first,
+                       teensymat::ColoringOrder::dsatur}) {
+      auto coloring = teensymat::color_columns(pattern, order);
+      REQUIRE(valid_column_coloring(pattern, coloring));
+      REQUIRE(coloring.num_colors < 60);
+    }
+  }
+}
+
+TEST_CASE("Star coloring", "[coloring]") {
+  SECTION("Arrowhead") {
+    // A dense first row and column needs n column colors but two star
+    // colors
+    size_t n = 20;
+    std::vector<size_t> rows, cols;
+    for (size_t i = 0; i < n; i++) {
+      rows.insert(rows.end(), {i, i, 0});
+      cols.insert(cols.end(), {0, i, i});
+    }
+    auto pattern = teensymat::SparseMatrix<double>::from_triplets(
+        n, n, rows, cols, std::vector<double>(rows.size(), 1.0));
+    REQUIRE(teensymat::color_columns(pattern).num_colors == n);
+    auto coloring = teensymat::color_star(pattern);
+    REQUIRE(coloring.num_colors == 2);
+    REQUIRE(valid_star_coloring(pattern, coloring));
+  }
+  SECTION("Random symmetric patterns") {
+    auto pattern = random_symmetric(60, 150);
+    for (auto order : {teensymat::ColoringOrder::natural,
+                       teensymat::ColoringOrder::largest_first,
+                       teensymat::ColoringOrder::dsatur}) {
+      auto coloring = teensymat::color_star(pattern, order);
+      REQUIRE(valid_star_coloring(pattern, coloring));
+      REQUIRE(coloring.num_colors <=
+              teensymat::color_columns(pattern, order).num_colors);
+    }
+  }
+  SECTION("Rectangular pattern") {
+    teensymat::SparseMatrix<double> pattern{2, 3};
+    REQUIRE_THROWS_AS(teensymat::color_star(pattern), std::range_error);
+  }
+}
@@ -0,0 +1,240 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyLP/conic.hpp"
+#include "TeensyOpt/TeensyLP/interior_point.hpp"
+#include "lp_helpers.hpp"
+
+using test_lp::inf;
+using test_lp::random_problem;
+
+namespace {
+/*! Build a conic program from dense data*/
+teensylp::ConicProblem<double>
+make_conic(size_t n, std::vector<double> c, size_t p,
+           std::vector<double> const &a, std::vector<double> b, size_t m,
+           std::vector<double> const &g, std::vector<double> h,
+           std::vector<teensylp::Cone> cones) {
+  teensylp::ConicProblem<double> problem;
+  problem.objective = std::move(c);
+  problem.equality_matrix = teensymat::SparseMatrix<double>::from_dense(
+      teensymat::Matrix<double>{p, n, a});
+  problem.equality_rhs = std::move(b);
+  problem.cone_matrix = teensymat::SparseMatrix<double>::from_dense(
+      teensymat::Matrix<double>{m, n, g});
+  problem.cone_rhs = std::move(h);
+  problem.cones = std::move(cones);
+  return problem;
+}
+
+/*! Write an LP as a conic program over the nonnegative orthant: ranged
+ * rows and bounds become one cone row per finite side, fixed rows become
+ * equalities*/
+teensylp::ConicProblem<double>
+lp_to_conic(teensylp::LPProblem<double> const &lp) {
+  size_t n = lp.get_ncols();
+  teensymat::Matrix<double> dense = lp.constraints.to_dense();
+  std::vector<double> a, b, g, h;
+  size_t p = 0;
+  size_t m = 0;
+  auto add_row = [&](std::vector<double> const &row, double lower,
+                     double upper) {
+    if (lower == upper) {
+      a.insert(a.end(), row.begin(), row.end());
+      b.push_back(lower);
+      p++;
+      return;
+    }
+    if (lower > -inf) {
+      for (double value : row) {
+        g.push_back(-value);
+      }
+      h.push_back(-lower);
+      m++;
+    }
+    if (upper < inf) {
+      g.insert(g.end(), row.begin(), row.end());
+      h.push_back(upper);
+      m++;
+    }
+  };
+  std::vector<double> row(n);
+  for (size_t i = 0; i < lp.get_nrows(); i++) {
+    for (size_t j = 0; j < n; j++) {
+      row[j] = *dense(i, j);
+    }
+    add_row(row, lp.row_lower[i], lp.row_upper[i]);
+  }
+  for (size_t j = 0; j < n; j++) {
+    std::fill(row.begin(), row.end(), 0.0);
+    row[j] = 1.0;
+    add_row(row, lp.col_lower[j], lp.col_upper[j]);
+  }
+  return make_conic(n, lp.objective, p, a, b, m, g, h,
+                    {{teensylp::ConeType::nonnegative, m}});
+}
+
+/*! Expand a cone into one nonnegative cone per row (for the orthant)*/
+std::vector<teensylp::Cone> orthant(size_t m) {
+  return std::vector<teensylp::Cone>(
+      m, teensylp::Cone{teensylp::ConeType::nonnegative, 1});
+}
+} // namespace
+
+TEST_CASE("Conic problems", "[conic]") {
+  SECTION("Mismatched data throws") {
+    auto problem = make_conic(2, {1, 1}, 0, {}, {}, 2, {1, 0, 0, 1}, {1, 1},
+                              orthant(2));
+    REQUIRE_NOTHROW(problem.validate());
+    problem.cones = {{teensylp::ConeType::second_order, 3}};
+    REQUIRE_THROWS_AS(problem.validate(), std::range_error);
+    problem.cones = {{teensylp::ConeType::exponential, 2}};
+    REQUIRE_THROWS_AS(problem.validate(), std::range_error);
+    problem.cones = orthant(2);
+    problem.equality_rhs = {1.0};
+    REQUIRE_THROWS_AS(teensylp::solve_conic(problem), std::range_error);
+  }
+}
+
+TEST_CASE("Conic solver", "[conic]") {
+  SECTION("Linear programs") {
+    // minimize -x1 - x2 with x1 + 2 x2 <= 4, 3 x1 + x2 <= 6, x >= 0
+    auto problem =
+        make_conic(2, {-1, -1}, 0, {}, {}, 4, {1, 2, 3, 1, -1, 0, 0, -1},
+                   {4, 6, 0, 0}, orthant(4));
+    teensylp::ConicSolver<double> solver{problem};
+    auto solution = solver.solve();
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE_THAT(solution.objective, Catch::Matchers::WithinAbs(-2.8, 1e-7));
+    REQUIRE_THAT(solution.x[0], Catch::Matchers::WithinAbs(1.6, 1e-6));
+    REQUIRE_THAT(solution.x[1], Catch::Matchers::WithinAbs(1.2, 1e-6));
+    REQUIRE(solver.get_num_analyses() == 1);
+    REQUIRE(solver.get_num_factorizations() == solution.iterations + 1);
+  }
+  SECTION("Random linear programs match the interior point method") {
+    for (unsigned seed : {1u, 2u, 3u}) {
+      auto lp = random_problem(20, 30, seed);
+      auto reference = teensylp::solve_interior_point(lp);
+      REQUIRE(reference.status == teensylp::LPStatus::optimal);
+      auto solution = teensylp::solve_conic(lp_to_conic(lp));
+      REQUIRE(solution.status == teensylp::LPStatus::optimal);
+      REQUIRE_THAT(solution.objective,
+                   Catch::Matchers::WithinRel(reference.objective, 1e-6));
+    }
+  }
+  SECTION("Projection onto a hyperplane with a second order cone") {
+    // minimize t with ||x - (1, 2, 3)|| <= t, x1 + x2 + x3 = 0; the
+    // distance to the plane is 6 / sqrt(3)
+    auto problem = make_conic(
+        4, {1, 0, 0, 0}, 1, {0, 1, 1, 1}, {0}, 4,
+        {-1, 0, 0, 0, 0, -1, 0, 0, 0, 0, -1, 0, 0, 0, 0, -1}, {0, -1, -2, -3},
+        {{teensylp::ConeType::second_order, 4}});
+    auto solution = teensylp::solve_conic(problem);
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE_THAT(solution.objective,
+                 Catch::Matchers::WithinAbs(6.0 / std::sqrt(3.0), 1e-7));
+    REQUIRE_THAT(solution.x[1], Catch::Matchers::WithinAbs(-1.0, 1e-6));
+    REQUIRE_THAT(solution.x[3], Catch::Matchers::WithinAbs(1.0, 1e-6));
+  }
+  SECTION("Mixed orthant and second order cones") {
+    // minimize x1 + x2 with ||(x1, x2)|| <= 1 and x1 >= -0.5, both with
+    // a dense block and with the sparse expansion of the cone
+    auto problem = make_conic(2, {1, 1}, 0, {}, {}, 4,
+                              {-1, 0, 0, 0, -1, 0, 0, -1}, {0.5, 1, 0, 0},
+                              {{teensylp::ConeType::nonnegative, 1},
+                               {teensylp::ConeType::second_order, 3}});
+    for (size_t dense : {4, 0}) {
+      teensylp::ConicOptions<double> options;
+      options.dense_cone_dim = dense;
+      auto solution = teensylp::solve_conic(problem, options);
+      REQUIRE(solution.status == teensylp::LPStatus::optimal);
+      REQUIRE_THAT(solution.objective,
+                   Catch::Matchers::WithinAbs(-0.5 - std::sqrt(0.75), 1e-7));
+    }
+  }
+  SECTION("Large second order cones") {
+    // minimize t with ||x - (1, ..., n)|| <= t and sum x_i = 0, the
+    // distance to the plane is n (n + 1) / (2 sqrt(n))
+    size_t dim = 40;
+    size_t n = dim + 1;
+    std::vector<double> c(n, 0.0);
+    c[0] = 1.0;
+    std::vector<double> a(n, 1.0);
+    a[0] = 0.0;
+    std::vector<double> g(n * n, 0.0);
+    std::vector<double> h(n, 0.0);
+    for (size_t i = 0; i < n; i++) {
+      g[i * n + i] = -1.0;
+      h[i] = -static_cast<double>(i);
+    }
+    auto problem = make_conic(n, c, 1, a, {0.0}, n, g, h,
+                              {{teensylp::ConeType::second_order, n}});
+    teensylp::ConicSolver<double> solver{problem};
+    auto solution = solver.solve();
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    double d = static_cast<double>(dim);
+    REQUIRE_THAT(solution.objective,
+                 Catch::Matchers::WithinAbs(d * (d + 1) / (2 * std::sqrt(d)),
+                                            1e-6));
+    REQUIRE(solver.get_num_analyses() <= 2);
+  }
+  SECTION("Exponential cones") {
+    // maximize u with (u, 1, 2) in the exponential cone: u = log(2)
+    auto problem =
+        make_conic(1, {-1}, 0, {}, {}, 3, {-1, 0, 0}, {0, 1, 2},
+                   {{teensylp::ConeType::exponential, 3}});
+    auto solution = teensylp::solve_conic(problem);
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE_THAT(solution.x[0], Catch::Matchers::WithinAbs(std::log(2.0),
+                                                           1e-7));
+  }
+  SECTION("Entropy maximization") {
+    // minimize sum t_i with (-t_i, x_i, 1) in the exponential cone, so
+    // t_i >= x_i log(x_i), and sum x_i = 1: the minimum is -log(n)
+    size_t count = 5;
+    size_t n = 2 * count;
+    std::vector<double> c(n, 0.0);
+    std::vector<double> a(n, 0.0);
+    std::vector<double> g(3 * count * n, 0.0);
+    std::vector<double> h(3 * count, 0.0);
+    std::vector<teensylp::Cone> cones;
+    for (size_t i = 0; i < count; i++) {
+      c[count + i] = 1.0;
+      a[i] = 1.0;
+      g[(3 * i) * n + count + i] = 1.0;
+      g[(3 * i + 1) * n + i] = -1.0;
+      h[3 * i + 2] = 1.0;
+      cones.push_back({teensylp::ConeType::exponential, 3});
+    }
+    auto problem = make_conic(n, c, 1, a, {1.0}, 3 * count, g, h, cones);
+    teensylp::ConicSolver<double> solver{problem};
+    auto solution = solver.solve();
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE_THAT(solution.objective,
+                 Catch::Matchers::WithinAbs(-std::log(5.0), 1e-7));
+    for (size_t i = 0; i < count; i++) {
+      REQUIRE_THAT(solution.x[i], Catch::Matchers::WithinAbs(0.2, 1e-6));
+    }
+    REQUIRE(solver.get_num_analyses() == 1);
+  }
+  SECTION("Infeasible and unbounded problems") {
+    // x >= 1 and x <= 0
+    auto infeasible =
+        make_conic(1, {1}, 0, {}, {}, 2, {-1, 1}, {-1, 0}, orthant(2));
+    REQUIRE(teensylp::solve_conic(infeasible).status ==
+            teensylp::LPStatus::infeasible);
+    // minimize -x1 with ||x2|| <= x1
+    auto unbounded = make_conic(2, {-1, 0}, 0, {}, {}, 2, {-1, 0, 0, -1},
+                                {0, 0}, {{teensylp::ConeType::second_order,
+                                          2}});
+    REQUIRE(teensylp::solve_conic(unbounded).status ==
+            teensylp::LPStatus::unbounded);
+  }
+}
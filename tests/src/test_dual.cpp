@@ -0,0 +1,205 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <cmath>
+#include <limits>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyMat/dual.hpp"
+#include "TeensyOpt/TeensyMat/factorize.hpp"
+#include "TeensyOpt/TeensyMat/linalg.hpp"
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+
+using Dual2 = teensymat::Dual<double, 2>;
+
+TEST_CASE("Dual numbers", "[dual]") {
+  Dual2 x = Dual2::variable(0.5, 0);
+  Dual2 y = Dual2::variable(2.0, 1);
+  SECTION("Arithmetic") {
+    Dual2 f = (x * y + 3 * x - y / x) / (1 + y);
+    // f = (x y + 3 x - y / x) / (1 + y)
+    double num = 0.5 * 2 + 1.5 - 4;
+    double dnum_dx = 2 + 3 + 2 / 0.25;
+    double dnum_dy = 0.5 - 2;
+    REQUIRE_THAT(f.get_value(), Catch::Matchers::WithinAbs(num / 3, 1e-15));
+    REQUIRE_THAT(f.get_tangent(0),
+                 Catch::Matchers::WithinAbs(dnum_dx / 3, 1e-14));
+    REQUIRE_THAT(f.get_tangent(1),
+                 Catch::Matchers::WithinAbs(dnum_dy / 3 - num / 9, 1e-14));
+    REQUIRE((-x).get_tangent(0) == -1);
+    REQUIRE((2 - x).get_tangent(0) == -1);
+  }
+  SECTION("Elementary functions") {
+    REQUIRE_THAT(sin(x).get_tangent(0),
+                 Catch::Matchers::WithinAbs(std::cos(0.5), 1e-15));
+    REQUIRE_THAT(exp(x * y).get_tangent(1),
+                 Catch::Matchers::WithinAbs(0.5 * std::exp(1.0), 1e-14));
+    REQUIRE_THAT(log(y).get_tangent(1), Catch::Matchers::WithinAbs(0.5, 1e-15));
+    REQUIRE_THAT(sqrt(y).get_tangent(1),
+                 Catch::Matchers::WithinAbs(0.5 / std::sqrt(2.0), 1e-15));
+    REQUIRE_THAT(tanh(x).get_tangent(0),
+                 Catch::Matchers::WithinAbs(
+                     1 - std::tanh(0.5) * std::tanh(0.5), 1e-15));
+    REQUIRE_THAT(atan2(y, x).get_tangent(0),
+                 Catch::Matchers::WithinAbs(-2 / 4.25, 1e-15));
+    Dual2 power = pow(x, y);
+    REQUIRE_THAT(power.get_tangent(0),
+                 Catch::Matchers::WithinAbs(2 * 0.5, 1e-15));
+    REQUIRE_THAT(power.get_tangent(1),
+                 Catch::Matchers::WithinAbs(0.25 * std::log(0.5), 1e-15));
+    REQUIRE(abs(-x).get_tangent(0) == 1);
+    Dual2 zero = Dual2::variable(0.0, 0);
+    REQUIRE(pow(zero, 0.5).get_value() == 0);
+    REQUIRE(std::isinf(pow(zero, 0.5).get_tangent(0)));
+    REQUIRE(pow(zero, 0.0).get_value() == 1);
+    REQUIRE(pow(zero, 0.0).get_tangent(0) == 0);
+    REQUIRE(pow(zero, 2.0).get_value() == 0);
+    REQUIRE(pow(zero, 2.0).get_tangent(0) == 0);
+    REQUIRE(std::isinf(pow(zero, -1.0).get_value()));
+    Dual2 zero_power = pow(zero, Dual2::variable(0.0, 1));
+    REQUIRE(zero_power.get_value() == 1);
+    REQUIRE(zero_power.get_tangent(0) == 0);
+    REQUIRE(zero_power.get_tangent(1) == 0);
+    REQUIRE(isfinite(x));
+    REQUIRE_FALSE(isfinite(sqrt(x - x)));
+  }
+  SECTION("Comparisons use the values") {
+    REQUIRE(x < y);
+    REQUIRE(x < 1);
+    REQUIRE(1 > x);
+    REQUIRE(x == 0.5);
+    REQUIRE(Dual2{0.5} == x);
+    REQUIRE(std::max(x, y).get_tangent(1) == 1);
+    REQUIRE(std::numeric_limits<Dual2>::epsilon() ==
+            std::numeric_limits<double>::epsilon());
+  }
+  SECTION("Second derivatives by nesting") {
+    using Inner = teensymat::Dual<double, 1>;
+    using Outer = teensymat::Dual<Inner, 1>;
+    // d^2/dx^2 of x^3 sin(x)
+    Outer z{Inner::variable(1.2, 0), {Inner{1.0}}};
+    Outer f = z * z * z * sin(z);
+    double x0 = 1.2;
+    double second = 6 * x0 * std::sin(x0) + 6 * x0 * x0 * std::cos(x0) -
+                    x0 * x0 * x0 * std::sin(x0);
+    REQUIRE_THAT(f.get_tangent(0).get_tangent(0),
+                 Catch::Matchers::WithinAbs(second, 1e-12));
+  }
+}
+
+TEST_CASE("Matrices of dual numbers", "[dual]") {
+  // A(t) = [[2 + t, 1], [1, 3 t]] at t = 1, differentiated along t
+  Dual2 t = Dual2::variable(1.0, 0);
+  teensymat::Matrix<Dual2> a{2, 2, {2 + t, Dual2{1.0}, Dual2{1.0}, 3 * t}};
+  SECTION("Elementwise operators and products") {
+    auto sum = a + a;
+    REQUIRE(sum(1, 1)->get_tangent(0) == 6);
+    auto scaled = a * t;
+    REQUIRE(scaled(0, 0)->get_tangent(0) == 4);
+    auto product = teensymat::matmul(a, a);
+    // d(A^2)_00 = 2 (2 + t)
+    REQUIRE(product(0, 0)->get_value() == 10);
+    REQUIRE(product(0, 0)->get_tangent(0) == 6);
+    REQUIRE(teensymat::equals(a, a));
+    REQUIRE(a.content_hash() == teensymat::contiguous_copy(a).content_hash());
+  }
+  SECTION("Truthiness uses the values") {
+    // A zero value is false even with a nonzero tangent
+    Dual2 zero = t - 1;
+    REQUIRE(zero.get_tangent(0) == 1);
+    REQUIRE_FALSE(static_cast<bool>(zero));
+    REQUIRE(static_cast<bool>(t));
+    REQUIRE(a.all());
+    teensymat::Matrix<Dual2> b{2, 2, {zero, Dual2{}, Dual2{}, zero}};
+    REQUIRE_FALSE(b.any());
+    *b(0, 1) = t;
+    REQUIRE(b.any());
+    REQUIRE_FALSE(b.all());
+  }
+  SECTION("Derivative of a linear solve") {
+    // x = A^{-1} b, dx/dt = -A^{-1} (dA/dt) x
+    std::vector<Dual2> b{Dual2{1.0}, Dual2{2.0}};
+    teensymat::LUFactorization<Dual2> lu{a};
+    auto x = lu.solve(b);
+    teensymat::Matrix<double> plain{2, 2, {3, 1, 1, 3}};
+    teensymat::LUFactorization<double> plain_lu{plain};
+    auto x0 = plain_lu.solve({1.0, 2.0});
+    std::vector<double> rhs{-x0[0], -3 * x0[1]};
+    auto dx = plain_lu.solve(rhs);
+    for (size_t i = 0; i < 2; i++) {
+      REQUIRE_THAT(x[i].get_value(), Catch::Matchers::WithinAbs(x0[i], 1e-14));
+      REQUIRE_THAT(x[i].get_tangent(0),
+                   Catch::Matchers::WithinAbs(dx[i], 1e-14));
+      REQUIRE(x[i].get_tangent(1) == 0);
+    }
+    teensymat::CholeskyFactorization<Dual2> cholesky{a};
+    auto y = cholesky.solve(b);
+    for (size_t i = 0; i < 2; i++) {
+      REQUIRE_THAT(y[i].get_tangent(0),
+                   Catch::Matchers::WithinAbs(dx[i], 1e-14));
+    }
+    // d log det A = tr(A^{-1} dA/dt) = (3 + 3 * 3) / 8
+    REQUIRE_THAT(cholesky.log_abs_det().get_tangent(0),
+                 Catch::Matchers::WithinAbs(12.0 / 8, 1e-14));
+  }
+}
+
+TEST_CASE("Forward mode derivatives", "[dual]") {
+  SECTION("Jacobian, several columns per evaluation") {
+    // r_i = x_i^2 x_{i+1} - sin(x_i), the last one x_{n-1}^2
+    size_t n = 10;
+    std::vector<double> x(n);
+    for (size_t i = 0; i < n; i++) {
+      x[i] = 0.1 * double(i + 1);
+    }
+    size_t calls = 0;
+    auto function = [&](auto const *z, auto *r) {
+      calls++;
+      for (size_t i = 0; i + 1 < n; i++) {
+        r[i] = z[i] * z[i] * z[i + 1] - sin(z[i]);
+      }
+      r[n - 1] = z[n - 1] * z[n - 1];
+    };
+    teensymat::Matrix<double> jacobian{n, n};
+    std::vector<double> value(n);
+    teensymat::forward_jacobian<4>(function, n, n, x.data(), jacobian,
+                                   value.data());
+    REQUIRE(calls == 3);
+    for (size_t i = 0; i < n; i++) {
+      for (size_t j = 0; j < n; j++) {
+        double expected = 0;
+        if (i + 1 < n && j == i) {
+          expected = 2 * x[i] * x[i + 1] - std::cos(x[i]);
+        } else if (i + 1 < n && j == i + 1) {
+          expected = x[i] * x[i];
+        } else if (i + 1 == n && j == i) {
+          expected = 2 * x[i];
+        }
+        REQUIRE_THAT(*jacobian(i, j),
+                     Catch::Matchers::WithinAbs(expected, 1e-14));
+      }
+    }
+    REQUIRE_THAT(value[n - 1], Catch::Matchers::WithinAbs(1.0, 1e-14));
+    teensymat::Matrix<double> wrong{n, n + 1};
+    REQUIRE_THROWS_AS(
+        teensymat::forward_jacobian<4>(function, n, n, x.data(), wrong),
+        std::range_error);
+  }
+  SECTION("Gradient") {
+    std::vector<double> x{1.0, -2.0, 0.5};
+    std::vector<double> gradient(3);
+    double value = teensymat::forward_gradient<2>(
+        [](auto const *z) { return z[0] * z[1] + exp(z[2]) * z[0]; }, 3,
+        x.data(), gradient.data());
+    REQUIRE_THAT(value,
+                 Catch::Matchers::WithinAbs(-2 + std::exp(0.5), 1e-15));
+    REQUIRE_THAT(gradient[0],
+                 Catch::Matchers::WithinAbs(-2 + std::exp(0.5), 1e-15));
+    REQUIRE_THAT(gradient[1], Catch::Matchers::WithinAbs(1.0, 1e-15));
+    REQUIRE_THAT(gradient[2],
+                 Catch::Matchers::WithinAbs(std::exp(0.5), 1e-15));
+  }
+}
@@ -0,0 +1,139 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <cmath>
+#include <numbers>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyMat/eigen.hpp"
+
+namespace {
+/*! The n by n 1D Laplacian, whose eigenvalues are 2 - 2 cos(j pi / (n + 1))*/
+teensymat::SparseMatrix<double> laplacian(size_t n) {
+  std::vector<size_t> rows;
+  std::vector<size_t> cols;
+  std::vector<double> values;
+  for (size_t i = 0; i < n; i++) {
+    rows.push_back(i);
+    cols.push_back(i);
+    values.push_back(2.0);
+    if (i + 1 < n) {
+      rows.insert(rows.end(), {i, i + 1});
+      cols.insert(cols.end(), {i + 1, i});
+      values.insert(values.end(), {-1.0, -1.0});
+    }
+  }
+  return teensymat::SparseMatrix<double>::from_triplets(n, n, rows, cols,
+                                                        values);
+}
+double laplacian_eigenvalue(size_t n, size_t j) {
+  return 2.0 - 2.0 * std::cos(static_cast<double>(j) * std::numbers::pi /
+                              static_cast<double>(n + 1));
+}
+/*! Largest residual ||A v - lambda v|| over the returned pairs*/
+double largest_residual(teensymat::LinearOperator<double> const &op,
+                        teensymat::EigenResult<double> const &result) {
+  size_t n = op.get_ncols();
+  double largest = 0.0;
+  for (size_t i = 0; i < result.eigenvalues.size(); i++) {
+    std::vector<double> v(n);
+    for (size_t row = 0; row < n; row++) {
+      v[row] = *result.eigenvectors(row, i);
+    }
+    std::vector<double> image = op.apply(v);
+    double sum = 0.0;
+    for (size_t row = 0; row < n; row++) {
+      double difference = image[row] - result.eigenvalues[i] * v[row];
+      sum += difference * difference;
+    }
+    largest = std::max(largest, std::sqrt(sum));
+  }
+  return largest;
+}
+} // namespace
+
+TEST_CASE("Dense symmetric eigenvalues", "[eigen]") {
+  auto test_matrix = teensymat::Matrix<double>{3, 3, {2, 1, 0, 1, 2, 1, 0, 1, 2}};
+  auto result = teensymat::symmetric_eigen(test_matrix);
+  std::vector<double> expected{2 - std::sqrt(2.0), 2.0, 2 + std::sqrt(2.0)};
+  for (size_t i = 0; i < 3; i++) {
+    REQUIRE_THAT(result.eigenvalues[i],
+                 Catch::Matchers::WithinAbs(expected[i], 1e-12));
+  }
+  auto op = teensymat::LinearOperator<double>::from_matrix(test_matrix);
+  REQUIRE(largest_residual(op, result) < 1e-12);
+}
+
+TEST_CASE("Power iteration", "[eigen]") {
+  SECTION("Dominant eigenvalue") {
+    auto test_matrix = teensymat::Matrix<double>{2, 2, {4, 1, 1, 3}};
+    auto op = teensymat::LinearOperator<double>::from_matrix(test_matrix);
+    auto result = teensymat::power_iteration(op, 1000, 1e-12);
+    REQUIRE(result.converged);
+    REQUIRE_THAT(result.eigenvalue,
+                 Catch::Matchers::WithinAbs((7 + std::sqrt(5.0)) / 2, 1e-6));
+  }
+  SECTION("Spectral norm of a rectangular Matrix") {
+    auto test_matrix = teensymat::Matrix<double>{2, 3, {3, 0, 0, 0, 0, -4}};
+    auto op = teensymat::LinearOperator<double>::from_matrix(test_matrix);
+    REQUIRE_THAT(teensymat::spectral_norm_estimate(op, 200, 1e-12),
+                 Catch::Matchers::WithinAbs(4.0, 1e-6));
+  }
+}
+
+TEST_CASE("Lanczos eigensolver", "[eigen]") {
+  size_t n = 400;
+  auto op = teensymat::LinearOperator<double>::from_sparse(laplacian(n));
+  SECTION("Largest eigenvalues") {
+    auto result = teensymat::lanczos_eigs(op, 4, teensymat::EigenWhich::largest);
+    REQUIRE(result.converged);
+    for (size_t i = 0; i < 4; i++) {
+      REQUIRE_THAT(result.eigenvalues[i],
+                   Catch::Matchers::WithinAbs(laplacian_eigenvalue(n, n - i), 1e-7));
+    }
+    REQUIRE(largest_residual(op, result) < 1e-6);
+  }
+  SECTION("Smallest eigenvalues") {
+    teensymat::EigenOptions<double> options;
+    options.subspace_size = 40;
+    auto result =
+        teensymat::lanczos_eigs(op, 3, teensymat::EigenWhich::smallest, options);
+    REQUIRE(result.converged);
+    for (size_t i = 0; i < 3; i++) {
+      REQUIRE_THAT(result.eigenvalues[i],
+                   Catch::Matchers::WithinAbs(laplacian_eigenvalue(n, i + 1), 1e-7));
+    }
+  }
+  SECTION("Operators smaller than the subspace") {
+    auto small = teensymat::LinearOperator<double>::from_sparse(laplacian(5));
+    auto result = teensymat::lanczos_eigs(small, 2);
+    REQUIRE(result.converged);
+    REQUIRE_THAT(result.eigenvalues[0],
+                 Catch::Matchers::WithinAbs(laplacian_eigenvalue(5, 5), 1e-10));
+  }
+}
+
+TEST_CASE("Block subspace iteration", "[eigen]") {
+  // Symmetric Matrix with well separated dominant eigenvalues
+  size_t n = 60;
+  auto test_matrix = teensymat::Matrix<double>{n, n};
+  for (size_t i = 0; i < n; i++) {
+    *test_matrix(i, i) = i < 3 ? 10.0 * static_cast<double>(3 - i) : 1.0 / static_cast<double>(i);
+    if (i + 1 < n) {
+      *test_matrix(i, i + 1) = 0.01;
+      *test_matrix(i + 1, i) = 0.01;
+    }
+  }
+  auto op = teensymat::LinearOperator<double>::from_matrix(test_matrix);
+  auto result = teensymat::subspace_iteration_eigs(op, 3);
+  REQUIRE(result.converged);
+  auto exact = teensymat::symmetric_eigen(test_matrix);
+  for (size_t i = 0; i < 3; i++) {
+    REQUIRE_THAT(result.eigenvalues[i],
+                 Catch::Matchers::WithinAbs(exact.eigenvalues[n - 1 - i], 1e-8));
+  }
+  REQUIRE(largest_residual(op, result) < 1e-6);
+}
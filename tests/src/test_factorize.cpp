@@ -0,0 +1,113 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <cmath>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyMat/factorize.hpp"
+#include "TeensyOpt/TeensyMat/random.hpp"
+
+namespace {
+/*! Largest absolute difference between A * B and the identity*/
+double identity_error(teensymat::Matrix<double> const &a,
+                      teensymat::Matrix<double> const &b) {
+  auto product = teensymat::matmul(a, b);
+  double error = 0.0;
+  for (size_t row = 0; row < product.get_nrows(); row++) {
+    for (size_t col = 0; col < product.get_ncols(); col++) {
+      double expected = row == col ? 1.0 : 0.0;
+      error = std::max(error, std::abs(*product(row, col) - expected));
+    }
+  }
+  return error;
+}
+/*! A random symmetric positive definite Matrix*/
+teensymat::Matrix<double> random_spd(size_t n, uint64_t seed) {
+  auto factor = teensymat::random_normal<double>(n, n, seed);
+  auto result = teensymat::matmul(factor, factor.transpose());
+  for (size_t i = 0; i < n; i++) {
+    *result(i, i) += static_cast<double>(n);
+  }
+  return result;
+}
+} // namespace
+
+TEST_CASE("LU factorization", "[factorize]") {
+  SECTION("Determinant of a small Matrix") {
+    auto test_matrix = teensymat::Matrix<double>{3, 3, {0, 2, 1, 1, 1, 1, 2, 1, 3}};
+    REQUIRE_THAT(teensymat::determinant(test_matrix),
+                 Catch::Matchers::WithinAbs(-3.0, 1e-12));
+    REQUIRE_THAT(teensymat::log_abs_det(test_matrix),
+                 Catch::Matchers::WithinAbs(std::log(3.0), 1e-12));
+    REQUIRE(teensymat::LUFactorization<double>{test_matrix}.determinant_sign() ==
+            -1.0);
+  }
+  SECTION("Solve a system") {
+    auto test_matrix = teensymat::Matrix<double>{3, 3, {0, 2, 1, 1, 1, 1, 2, 1, 3}};
+    auto lu = teensymat::LUFactorization<double>{test_matrix};
+    std::vector<double> x = lu.solve({5, 5, 12});
+    std::vector<double> expected{1, 1, 3};
+    for (size_t i = 0; i < 3; i++) {
+      REQUIRE_THAT(x[i], Catch::Matchers::WithinAbs(expected[i], 1e-12));
+    }
+  }
+  SECTION("Inverse of a Matrix larger than one block") {
+    auto test_matrix = teensymat::random_normal<double>(150, 150, 1);
+    auto inverse = teensymat::inverse(test_matrix);
+    REQUIRE(identity_error(test_matrix, inverse) < 1e-9);
+    REQUIRE(identity_error(inverse, test_matrix) < 1e-9);
+  }
+  SECTION("Singular matrices") {
+    auto test_matrix = teensymat::Matrix<double>{2, 2, {1, 2, 2, 4}};
+    auto lu = teensymat::LUFactorization<double>{test_matrix};
+    REQUIRE(lu.is_singular());
+    REQUIRE(lu.determinant() == 0.0);
+    REQUIRE_THROWS_AS(lu.inverse(), std::runtime_error);
+  }
+  SECTION("Condition number estimate") {
+    // Diagonal Matrix with known condition number 1e6
+    auto test_matrix = teensymat::Matrix<double>{3, 3, {1e3, 0, 0, 0, 1, 0, 0, 0, 1e-3}};
+    REQUIRE_THAT(teensymat::condition_estimate(test_matrix),
+                 Catch::Matchers::WithinRel(1e6, 1e-9));
+    // Estimate is a lower bound, close to the exact value
+    auto random_matrix = teensymat::random_normal<double>(80, 80, 2);
+    double exact = teensymat::norm_1(random_matrix) *
+                   teensymat::norm_1(teensymat::inverse(random_matrix));
+    double estimate = teensymat::condition_estimate(random_matrix);
+    REQUIRE(estimate <= exact * (1 + 1e-9));
+    REQUIRE(estimate >= exact / 10);
+  }
+}
+
+TEST_CASE("Cholesky factorization", "[factorize]") {
+  SECTION("Determinant and solve") {
+    auto test_matrix = teensymat::Matrix<double>{2, 2, {4, 2, 2, 3}};
+    auto cholesky = teensymat::CholeskyFactorization<double>{test_matrix};
+    REQUIRE_THAT(cholesky.determinant(), Catch::Matchers::WithinAbs(8.0, 1e-12));
+    REQUIRE_THAT(cholesky.log_abs_det(),
+                 Catch::Matchers::WithinAbs(std::log(8.0), 1e-12));
+    std::vector<double> x = cholesky.solve({8, 7});
+    REQUIRE_THAT(x[0], Catch::Matchers::WithinAbs(1.25, 1e-12));
+    REQUIRE_THAT(x[1], Catch::Matchers::WithinAbs(1.5, 1e-12));
+  }
+  SECTION("Inverse and condition estimate") {
+    auto test_matrix = random_spd(100, 3);
+    auto cholesky = teensymat::CholeskyFactorization<double>{test_matrix};
+    auto inverse = cholesky.inverse();
+    REQUIRE(identity_error(test_matrix, inverse) < 1e-10);
+    double exact = teensymat::norm_1(test_matrix) * teensymat::norm_1(inverse);
+    double estimate = cholesky.condition_estimate();
+    REQUIRE(estimate <= exact * (1 + 1e-9));
+    REQUIRE(estimate >= exact / 10);
+    REQUIRE_THAT(cholesky.log_abs_det(),
+                 Catch::Matchers::WithinAbs(teensymat::log_abs_det(test_matrix), 1e-8));
+  }
+  SECTION("Indefinite matrices are rejected") {
+    auto test_matrix = teensymat::Matrix<double>{2, 2, {1, 2, 2, 1}};
+    REQUIRE_THROWS_AS(teensymat::CholeskyFactorization<double>{test_matrix},
+                      std::runtime_error);
+  }
+}
@@ -0,0 +1,233 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <cmath>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyMat/sparse_core.hpp"
+#include "TeensyOpt/TeensyNLP/finite_difference.hpp"
+#include "TeensyOpt/TeensyNLP/nlls.hpp"
+
+namespace {
+/*! Pattern of an m x n band matrix with the given half bandwidth*/
+teensymat::SparseMatrix<double> band_pattern(size_t m, size_t n,
+                                             size_t half) {
+  std::vector<size_t> rows, cols;
+  for (size_t i = 0; i < m; i++) {
+    for (size_t j = i > half ? i - half : 0; j < n && j <= i + half; j++) {
+      rows.push_back(i);
+      cols.push_back(j);
+    }
+  }
+  return teensymat::SparseMatrix<double>::from_triplets(
+      m, n, rows, cols, std::vector<double>(rows.size(), 1.0));
+}
+
+/*! Broyden's tridiagonal function
+ * r_i = (3 - 2 x_i) x_i - x_{i-1} - 2 x_{i+1} + 1*/
+void broyden(double const *x, double *r, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    double left = i > 0 ? x[i - 1] : 0;
+    double right = i + 1 < n ? x[i + 1] : 0;
+    r[i] = (3 - 2 * x[i]) * x[i] - left - 2 * right + 1;
+  }
+}
+
+/*! Exact Jacobian entry (i, j) of broyden*/
+double broyden_jacobian(double const *x, size_t i, size_t j) {
+  if (i == j) {
+    return 3 - 4 * x[i];
+  }
+  return j + 1 == i ? -1 : -2;
+}
+
+/*! f(x) = sum_i (x_i x_{i+1})^2 / 2 + sum_i cos(x_i), with gradient*/
+double chain(double const *x, double *gradient, size_t n) {
+  double value = 0;
+  for (size_t i = 0; i < n; i++) {
+    value += std::cos(x[i]);
+    gradient[i] = -std::sin(x[i]);
+  }
+  for (size_t i = 0; i + 1 < n; i++) {
+    double p = x[i] * x[i + 1];
+    value += p * p / 2;
+    gradient[i] += p * x[i + 1];
+    gradient[i + 1] += p * x[i];
+  }
+  return value;
+}
+
+/*! Exact Hessian entry (i, j) of chain*/
+double chain_hessian(double const *x, size_t i, size_t j, size_t n) {
+  if (i == j) {
+    double value = -std::cos(x[i]);
+    if (i > 0) {
+      value += x[i - 1] * x[i - 1];
+    }
+    if (i + 1 < n) {
+      value += x[i + 1] * x[i + 1];
+    }
+    return value;
+  }
+  return 2 * x[i] * x[j];
+}
+} // namespace
+
+TEST_CASE("Sparse finite difference Jacobians", "[finite_difference]") {
+  size_t n = 100;
+  auto function = [n](double const *x, double *r) { broyden(x, r, n); };
+  std::vector<double> x(n);
+  for (size_t i = 0; i < n; i++) {
+    x[i] = std::sin(double(i));
+  }
+  auto check = [&](teensymat::SparseMatrix<double> const &jacobian,
+                   double tolerance) {
+    auto const &col_ptr = jacobian.get_col_ptr();
+    auto const &row_idx = jacobian.get_row_idx();
+    auto const &values = *jacobian.get_values();
+    for (size_t j = 0; j < n; j++) {
+      for (size_t p = col_ptr[j]; p < col_ptr[j + 1]; p++) {
+        REQUIRE_THAT(values[p],
+                     Catch::Matchers::WithinAbs(
+                         broyden_jacobian(x.data(), row_idx[p], j), tolerance));
+      }
+    }
+  };
+  SECTION("Forward differences, one evaluation per color") {
+    teensynlp::SparseJacobianFD<double> fd{band_pattern(n, n, 1)};
+    REQUIRE(fd.get_num_colors() == 3);
+    auto jacobian = fd.get_pattern();
+    fd.estimate(function, x.data(), jacobian);
+    REQUIRE(fd.get_evaluations() == 4);
+    check(jacobian, 1e-6);
+    // With the value at x given, only the colors are evaluated
+    std::vector<double> r(n);
+    function(x.data(), r.data());
+    fd.estimate(function, x.data(), jacobian, r.data());
+    REQUIRE(fd.get_evaluations() == 3);
+    check(jacobian, 1e-6);
+  }
+  SECTION("Central differences, serial and parallel agree") {
+    teensynlp::FiniteDifferenceOptions<double> options;
+    options.formula = teensynlp::DifferenceFormula::central;
+    options.parallel = true;
+    teensynlp::SparseJacobianFD<double> parallel{band_pattern(n, n, 1),
+                                                 options};
+    options.parallel = false;
+    teensynlp::SparseJacobianFD<double> serial{band_pattern(n, n, 1),
+                                               options};
+    auto a = parallel.get_pattern();
+    auto b = serial.get_pattern();
+    parallel.estimate(function, x.data(), a);
+    serial.estimate(function, x.data(), b);
+    REQUIRE(parallel.get_evaluations() == 6);
+    REQUIRE(*a.get_values() == *b.get_values());
+    check(a, 1e-9);
+  }
+  SECTION("Wrong pattern") {
+    teensynlp::SparseJacobianFD<double> fd{band_pattern(n, n, 1)};
+    auto jacobian = band_pattern(n, n, 2);
+    REQUIRE_THROWS_AS(fd.estimate(function, x.data(), jacobian),
+                      std::range_error);
+  }
+  SECTION("Least squares with an estimated Jacobian") {
+    teensynlp::SparseJacobianFD<double> fd{band_pattern(n, n, 1)};
+    teensynlp::LeastSquares<double> problem{function,
+                                            fd.as_jacobian(function),
+                                            fd.get_pattern()};
+    std::vector<double> start(n, -1.0);
+    auto solution = problem.minimize(start.data());
+    REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+    REQUIRE(solution.objective < 1e-16);
+    // The residuals at x come from the solver, so only the colors are
+    // evaluated
+    REQUIRE(fd.get_evaluations() == fd.get_num_colors());
+  }
+}
+
+TEST_CASE("Sparse finite difference Hessians", "[finite_difference]") {
+  size_t n = 60;
+  auto objective = [n](double const *x, double *gradient) {
+    return chain(x, gradient, n);
+  };
+  std::vector<double> x(n);
+  for (size_t i = 0; i < n; i++) {
+    x[i] = std::cos(double(i));
+  }
+  auto check = [&](teensymat::SparseMatrix<double> const &hessian,
+                   double tolerance) {
+    auto const &col_ptr = hessian.get_col_ptr();
+    auto const &row_idx = hessian.get_row_idx();
+    auto const &values = *hessian.get_values();
+    for (size_t j = 0; j < n; j++) {
+      for (size_t p = col_ptr[j]; p < col_ptr[j + 1]; p++) {
+        REQUIRE_THAT(values[p], Catch::Matchers::WithinAbs(
+                                    chain_hessian(x.data(), row_idx[p], j, n),
+                                    tolerance));
+      }
+    }
+  };
+  SECTION("Full pattern") {
+    teensynlp::SparseHessianFD<double> fd{band_pattern(n, n, 1)};
+    REQUIRE(fd.get_num_colors() == 3);
+    auto hessian = fd.get_pattern();
+    fd.estimate(objective, x.data(), hessian);
+    REQUIRE(fd.get_evaluations() == 4);
+    check(hessian, 1e-6);
+  }
+  SECTION("Lower triangle, central differences") {
+    std::vector<size_t> rows, cols;
+    for (size_t j = 0; j < n; j++) {
+      for (size_t i = j; i < n && i <= j + 1; i++) {
+        rows.push_back(i);
+        cols.push_back(j);
+      }
+    }
+    teensynlp::FiniteDifferenceOptions<double> options;
+    options.formula = teensynlp::DifferenceFormula::central;
+    teensynlp::SparseHessianFD<double> fd{
+        teensymat::SparseMatrix<double>::from_triplets(
+            n, n, rows, cols, std::vector<double>(rows.size(), 0.0)),
+        options};
+    auto hessian = fd.get_pattern();
+    fd.estimate(objective, x.data(), hessian);
+    REQUIRE(fd.get_evaluations() == 2 * fd.get_num_colors());
+    check(hessian, 1e-8);
+  }
+  SECTION("Arrowhead, two colors") {
+    // f(x) = x_0 sum_{i>0} x_i^2 / 2
+    auto arrow = [n](double const *x, double *gradient) {
+      double sum = 0;
+      for (size_t i = 1; i < n; i++) {
+        sum += x[i] * x[i] / 2;
+        gradient[i] = x[0] * x[i];
+      }
+      gradient[0] = sum;
+      return x[0] * sum;
+    };
+    std::vector<size_t> rows, cols;
+    for (size_t i = 0; i < n; i++) {
+      rows.insert(rows.end(), {i, 0, i});
+      cols.insert(cols.end(), {0, i, i});
+    }
+    teensynlp::SparseHessianFD<double> fd{
+        teensymat::SparseMatrix<double>::from_triplets(
+            n, n, rows, cols, std::vector<double>(rows.size(), 0.0))};
+    REQUIRE(fd.get_num_colors() == 2);
+    auto hessian = fd.get_pattern();
+    fd.estimate(arrow, x.data(), hessian);
+    REQUIRE(fd.get_evaluations() == 3);
+    for (size_t i = 1; i < n; i++) {
+      REQUIRE_THAT(hessian.coeff(i, 0),
+                   Catch::Matchers::WithinAbs(x[i], 1e-6));
+      REQUIRE_THAT(hessian.coeff(0, i),
+                   Catch::Matchers::WithinAbs(x[i], 1e-6));
+      REQUIRE_THAT(hessian.coeff(i, i),
+                   Catch::Matchers::WithinAbs(x[0], 1e-6));
+    }
+    REQUIRE_THAT(hessian.coeff(0, 0), Catch::Matchers::WithinAbs(0.0, 1e-6));
+  }
+}
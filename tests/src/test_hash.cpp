@@ -0,0 +1,49 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+
+// std includes
+#include <cstring>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyMat/hash.hpp"
+
+TEST_CASE("xxHash64", "[hash]") {
+  SECTION("Reference values") {
+    REQUIRE(teensymat::xxhash64("", 0) == 0xEF46DB3751D8E999ULL);
+    REQUIRE(teensymat::xxhash64("abc", 3) == 0x44BC2CF5AD770999ULL);
+    char const *longer = "Nobody inspects the spammish repetition";
+    REQUIRE(teensymat::xxhash64(longer, std::strlen(longer)) ==
+            0xFBCEA83C8A378BF1ULL);
+  }
+  SECTION("Seed changes the hash") {
+    REQUIRE(teensymat::xxhash64("abc", 3, 1) !=
+            teensymat::xxhash64("abc", 3, 0));
+  }
+}
+
+TEST_CASE("Parallel hashing", "[hash]") {
+  std::vector<unsigned char> bytes(5 * teensymat::hash_chunk_bytes + 17);
+  for (size_t i = 0; i < bytes.size(); i++) {
+    bytes[i] = static_cast<unsigned char>((i * 131) % 251);
+  }
+  SECTION("Short inputs match xxhash64") {
+    REQUIRE(teensymat::parallel_hash(bytes.data(), 100) ==
+            teensymat::xxhash64(bytes.data(), 100));
+  }
+  SECTION("Result does not depend on the number of threads") {
+    auto &pool = teensymat::ThreadPool::global();
+    size_t original_threads = pool.get_num_threads();
+    pool.set_num_threads(1);
+    uint64_t serial = teensymat::parallel_hash(bytes.data(), bytes.size());
+    pool.set_num_threads(4);
+    uint64_t parallel = teensymat::parallel_hash(bytes.data(), bytes.size());
+    pool.set_num_threads(original_threads);
+    REQUIRE(serial == parallel);
+  }
+  SECTION("Changing one byte changes the hash") {
+    uint64_t before = teensymat::parallel_hash(bytes.data(), bytes.size());
+    bytes[3 * teensymat::hash_chunk_bytes + 5] ^= 1;
+    REQUIRE(teensymat::parallel_hash(bytes.data(), bytes.size()) != before);
+  }
+}
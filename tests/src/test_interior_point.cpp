@@ -0,0 +1,182 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyLP/interior_point.hpp"
+#include "TeensyOpt/TeensyLP/simplex.hpp"
+#include "lp_helpers.hpp"
+
+using test_lp::inf;
+using test_lp::kkt_error;
+using test_lp::make_problem;
+using test_lp::random_problem;
+using test_lp::random_qp;
+
+TEST_CASE("Interior point on small programs", "[interior_point]") {
+  SECTION("Textbook maximization with either linear system") {
+    auto problem = make_problem(3, 2, {1, 0, 0, 2, 3, 2}, {-3, -5},
+                                {-inf, -inf, -inf}, {4, 12, 18}, {0, 0},
+                                {inf, inf});
+    for (auto form : {teensylp::KKTForm::normal_equations,
+                      teensylp::KKTForm::augmented}) {
+      teensylp::InteriorPointOptions<double> options;
+      options.kkt_form = form;
+      teensylp::InteriorPoint<double> solver{problem, options};
+      REQUIRE(solver.get_kkt_form() == form);
+      auto solution = solver.solve();
+      REQUIRE(solution.status == teensylp::LPStatus::optimal);
+      REQUIRE_THAT(solution.objective, Catch::Matchers::WithinAbs(-36, 1e-6));
+      REQUIRE_THAT(solution.x[0], Catch::Matchers::WithinAbs(2, 1e-6));
+      REQUIRE_THAT(solution.x[1], Catch::Matchers::WithinAbs(6, 1e-6));
+      REQUIRE_THAT(solution.row_duals[2],
+                   Catch::Matchers::WithinAbs(-1, 1e-6));
+      REQUIRE(kkt_error(problem, solution) < 1e-6);
+      // One numeric factorization per iteration, plus the starting point
+      REQUIRE(solver.get_num_factorizations() == solution.iterations + 1);
+    }
+  }
+  SECTION("Equality rows and free variables") {
+    auto problem = make_problem(2, 3, {1, 1, 0, 0, 1, -1}, {1, 1, 1}, {2, 1},
+                                {2, 1}, {0, 0, -inf}, {inf, inf, inf});
+    teensylp::InteriorPoint<double> solver{problem};
+    REQUIRE(solver.get_kkt_form() == teensylp::KKTForm::augmented);
+    auto solution = solver.solve();
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE_THAT(solution.objective, Catch::Matchers::WithinAbs(1, 1e-6));
+    REQUIRE_THAT(solution.x[2], Catch::Matchers::WithinAbs(-1, 1e-6));
+  }
+  SECTION("Infeasible") {
+    auto problem = make_problem(2, 2, {1, 1, 1, 1}, {1, 1}, {-inf, 3},
+                                {1, inf}, {0, 0}, {inf, inf});
+    REQUIRE(teensylp::solve_interior_point(problem).status ==
+            teensylp::LPStatus::infeasible);
+  }
+  SECTION("Unbounded") {
+    auto problem = make_problem(1, 2, {1, -1}, {-1, -1}, {-inf}, {1}, {0, 0},
+                                {inf, inf});
+    REQUIRE(teensylp::solve_interior_point(problem).status ==
+            teensylp::LPStatus::unbounded);
+  }
+  SECTION("Convex QP with a known solution") {
+    // min 1/2 (x^2 + y^2) - x - y st x + y <= 1 (optimum at (1/2, 1/2))
+    teensylp::QPProblem<double> problem{make_problem(
+        1, 2, {1, 1}, {-1, -1}, {-inf}, {1}, {-inf, -inf}, {inf, inf})};
+    problem.hessian = teensymat::SparseMatrix<double>::from_triplets(
+        2, 2, {0, 1}, {0, 1}, {1.0, 1.0});
+    auto solution = teensylp::solve_interior_point(problem);
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE_THAT(solution.x[0], Catch::Matchers::WithinAbs(0.5, 1e-7));
+    REQUIRE_THAT(solution.objective, Catch::Matchers::WithinAbs(-0.75, 1e-7));
+    REQUIRE_THAT(solution.row_duals[0], Catch::Matchers::WithinAbs(-0.5, 1e-7));
+  }
+}
+
+TEST_CASE("Interior point on random programs", "[interior_point]") {
+  SECTION("Linear programs match the simplex method") {
+    for (unsigned seed : {1u, 2u}) {
+      auto problem = random_problem(120, 200, seed);
+      auto reference = teensylp::solve_simplex(problem);
+      REQUIRE(reference.status == teensylp::LPStatus::optimal);
+      for (auto form : {teensylp::KKTForm::normal_equations,
+                        teensylp::KKTForm::augmented}) {
+        teensylp::InteriorPointOptions<double> options;
+        options.kkt_form = form;
+        auto solution = teensylp::solve_interior_point(problem, options);
+        REQUIRE(solution.status == teensylp::LPStatus::optimal);
+        REQUIRE(kkt_error(problem, solution) < 1e-6);
+        REQUIRE_THAT(solution.objective,
+                     Catch::Matchers::WithinRel(reference.objective, 1e-6));
+      }
+    }
+  }
+  SECTION("Crossover returns an optimal basis") {
+    auto problem = random_problem(100, 160, 3);
+    auto reference = teensylp::solve_simplex(problem);
+    teensylp::InteriorPointOptions<double> options;
+    options.crossover = true;
+    auto solution = teensylp::solve_interior_point(problem, options);
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE(solution.col_status.size() == problem.get_ncols());
+    REQUIRE(kkt_error(problem, solution) < 1e-7);
+    REQUIRE_THAT(solution.objective,
+                 Catch::Matchers::WithinRel(reference.objective, 1e-9));
+  }
+  SECTION("Quadratic programs") {
+    for (bool diagonal : {true, false}) {
+      auto problem = random_qp(60, 100, 4, diagonal);
+      // Tight enough for kkt_error to see which bounds are active
+      teensylp::InteriorPointOptions<double> options;
+      options.tolerance = 1e-10;
+      teensylp::InteriorPoint<double> solver{problem, options};
+      // Free variables with a quadratic term keep the normal equations
+      REQUIRE(solver.get_kkt_form() ==
+              (diagonal ? teensylp::KKTForm::normal_equations
+                        : teensylp::KKTForm::augmented));
+      auto solution = solver.solve();
+      REQUIRE(solution.status == teensylp::LPStatus::optimal);
+      REQUIRE(kkt_error(problem, solution) < 1e-6);
+      // Both linear systems reach the same optimum of a diagonal QP
+      if (diagonal) {
+        options.kkt_form = teensylp::KKTForm::augmented;
+        auto other = teensylp::solve_interior_point(problem, options);
+        REQUIRE(other.status == teensylp::LPStatus::optimal);
+        REQUIRE_THAT(other.objective,
+                     Catch::Matchers::WithinRel(solution.objective, 1e-7));
+      }
+    }
+  }
+}
+
+TEST_CASE("Interior point warm starts", "[interior_point]") {
+  auto problem = random_problem(240, 360, 4);
+  auto cold = teensylp::solve_interior_point(problem);
+  REQUIRE(cold.status == teensylp::LPStatus::optimal);
+  teensylp::InteriorPoint<double> solver{teensylp::QPProblem<double>{problem}};
+  SECTION("Small cost change") {
+    REQUIRE(solver.solve().status == teensylp::LPStatus::optimal);
+    auto changed = problem;
+    std::mt19937 generator{7};
+    std::normal_distribution<double> normal{0.0, 1.0};
+    for (double &cost : changed.objective) {
+      cost *= 1.0 + 0.01 * normal(generator);
+    }
+    auto changes = solver.update(changed);
+    REQUIRE(changes.objective);
+    REQUIRE_FALSE(changes.pattern);
+    auto warm = solver.solve();
+    auto reference = teensylp::solve_interior_point(changed);
+    REQUIRE(warm.status == teensylp::LPStatus::optimal);
+    REQUIRE_THAT(warm.objective,
+                 Catch::Matchers::WithinRel(reference.objective, 1e-7));
+    REQUIRE(warm.iterations < reference.iterations);
+    // The symbolic analysis of the linear system is reused
+    REQUIRE(solver.get_num_analyses() == 1);
+  }
+  SECTION("Starting point from another solver") {
+    solver.set_starting_point(teensylp::solve_simplex(problem));
+    auto warm = solver.solve();
+    REQUIRE(warm.status == teensylp::LPStatus::optimal);
+    REQUIRE_THAT(warm.objective,
+                 Catch::Matchers::WithinRel(cold.objective, 1e-7));
+    REQUIRE(warm.iterations < cold.iterations);
+    REQUIRE_THROWS_AS(solver.set_starting_point(teensylp::LPSolution<double>{}),
+                      std::range_error);
+  }
+  SECTION("New sparsity pattern") {
+    REQUIRE(solver.solve().status == teensylp::LPStatus::optimal);
+    auto changed = random_problem(240, 360, 5);
+    REQUIRE(solver.update(changed).pattern);
+    REQUIRE(solver.get_num_analyses() == 2);
+    auto solution = solver.solve();
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE_THAT(solution.objective,
+                 Catch::Matchers::WithinRel(
+                     teensylp::solve_simplex(changed).objective, 1e-7));
+  }
+}
@@ -0,0 +1,146 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyMat/lbfgs_memory.hpp"
+#include "TeensyOpt/TeensyNLP/lbfgs.hpp"
+#include "nlp_helpers.hpp"
+
+using test_nlp::rosenbrock;
+using test_nlp::rosenbrock_start;
+
+TEST_CASE("L-BFGS memory", "[lbfgs]") {
+  SECTION("The newest pair satisfies the secant equation") {
+    teensymat::LBFGSMemory<double> memory{3, 2};
+    REQUIRE(memory.get_size() == 0);
+    double s[3] = {1.0, -2.0, 0.5};
+    double y[3] = {2.0, -1.0, 1.0};
+    double older_s[3] = {0.0, 1.0, 1.0};
+    double older_y[3] = {0.5, 3.0, 1.0};
+    for (auto pair : {std::pair{older_s, older_y}, std::pair{s, y}}) {
+      std::copy(pair.first, pair.first + 3, memory.next_s());
+      std::copy(pair.second, pair.second + 3, memory.next_y());
+      REQUIRE(memory.commit());
+    }
+    REQUIRE(memory.get_size() == 2);
+    REQUIRE(memory.get_s(1)[0] == 1.0);
+    REQUIRE(memory.get_y(0)[1] == 3.0);
+    double direction[3];
+    memory.direction(y, direction);
+    for (size_t i = 0; i < 3; i++) {
+      REQUIRE_THAT(direction[i], Catch::Matchers::WithinAbs(-s[i], 1e-12));
+    }
+  }
+  SECTION("Pairs with negative curvature are skipped") {
+    teensymat::LBFGSMemory<double> memory{2, 1};
+    double *s = memory.next_s();
+    double *y = memory.next_y();
+    s[0] = 1.0;
+    s[1] = 0.0;
+    y[0] = -1.0;
+    y[1] = 0.0;
+    REQUIRE_FALSE(memory.commit());
+    REQUIRE(memory.get_size() == 0);
+  }
+  SECTION("A skipped pair leaves a full memory intact") {
+    teensymat::LBFGSMemory<double> memory{1, 2};
+    for (double scale : {1.0, 2.0}) {
+      memory.next_s()[0] = scale;
+      memory.next_y()[0] = 3 * scale;
+      REQUIRE(memory.commit());
+    }
+    memory.next_s()[0] = 1.0;
+    memory.next_y()[0] = -1.0;
+    REQUIRE_FALSE(memory.commit());
+    REQUIRE(memory.get_size() == 2);
+    REQUIRE(memory.get_s(0)[0] == 1.0);
+    REQUIRE(memory.get_y(1)[0] == 6.0);
+  }
+  SECTION("No correction pairs throws") {
+    REQUIRE_THROWS_AS((teensymat::LBFGSMemory<double>{3, 0}),
+                      std::range_error);
+  }
+}
+
+TEST_CASE("L-BFGS minimizer", "[lbfgs]") {
+  SECTION("Convex quadratic") {
+    // minimize sum_i (i + 1) x_i^2 / 2 - x_i, with x_i = 1 / (i + 1)
+    size_t n = 50;
+    std::vector<double> x(n, 0.0);
+    auto solution = teensynlp::minimize_lbfgs<double>(
+        [n](double const *x, double *gradient) {
+          double value = 0;
+          for (size_t i = 0; i < n; i++) {
+            double weight = static_cast<double>(i + 1);
+            value += weight * x[i] * x[i] / 2 - x[i];
+            gradient[i] = weight * x[i] - 1;
+          }
+          return value;
+        },
+        x);
+    REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+    REQUIRE(solution.gradient_norm <= 1e-6);
+    for (size_t i = 0; i < n; i++) {
+      REQUIRE_THAT(x[i], Catch::Matchers::WithinAbs(1.0 / (i + 1), 1e-6));
+    }
+  }
+  SECTION("Rosenbrock function") {
+    auto x = rosenbrock_start(2);
+    teensynlp::LBFGSOptions<double> options;
+    options.gradient_tolerance = 1e-10;
+    auto solution = teensynlp::minimize_lbfgs<double>(
+        [](double const *x, double *gradient) {
+          return rosenbrock(x, gradient, 2);
+        },
+        x, options);
+    REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+    REQUIRE(solution.iterations < 100);
+    REQUIRE_THAT(x[0], Catch::Matchers::WithinAbs(1.0, 1e-8));
+    REQUIRE_THAT(x[1], Catch::Matchers::WithinAbs(1.0, 1e-8));
+    REQUIRE(solution.evaluations < 2 * solution.iterations);
+  }
+  SECTION("Extended Rosenbrock function") {
+    size_t n = 1000;
+    teensynlp::LBFGS<double> solver{n};
+    teensynlp::Objective<double> objective = [n](double const *x,
+                                                 double *gradient) {
+      return rosenbrock(x, gradient, n);
+    };
+    auto x = rosenbrock_start(n);
+    auto solution = solver.minimize(objective, x.data());
+    REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+    REQUIRE(solution.iterations > 10);
+    for (size_t i = 0; i < n; i++) {
+      REQUIRE_THAT(x[i], Catch::Matchers::WithinAbs(1.0, 1e-5));
+    }
+    REQUIRE(solver.get_memory().get_size() == 10);
+  }
+  SECTION("Stopping criteria") {
+    auto x = rosenbrock_start(2);
+    teensynlp::LBFGSOptions<double> options;
+    options.max_iterations = 3;
+    auto objective = [](double const *x, double *gradient) {
+      return rosenbrock(x, gradient, 2);
+    };
+    auto solution = teensynlp::minimize_lbfgs<double>(objective, x, options);
+    REQUIRE(solution.status == teensynlp::NLPStatus::iteration_limit);
+    REQUIRE(solution.iterations == 3);
+    options.max_iterations = 1000;
+    options.function_tolerance = 1e-3;
+    x = rosenbrock_start(2);
+    solution = teensynlp::minimize_lbfgs<double>(objective, x, options);
+    REQUIRE(solution.status == teensynlp::NLPStatus::function_tolerance);
+    x = {std::numeric_limits<double>::quiet_NaN(), 1.0};
+    solution = teensynlp::minimize_lbfgs<double>(objective, x);
+    REQUIRE(solution.status == teensynlp::NLPStatus::numerical_error);
+  }
+}
@@ -0,0 +1,132 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyNLP/lbfgsb.hpp"
+#include "nlp_helpers.hpp"
+
+using test_nlp::rosenbrock;
+using test_nlp::rosenbrock_start;
+
+TEST_CASE("L-BFGS-B minimizer", "[lbfgsb]") {
+  SECTION("Separable quadratic with active bounds") {
+    // minimize sum_i (i + 1) x_i^2 / 2 - x_i over [0.2, 0.5]^n, so
+    // x_i = clamp(1 / (i + 1), 0.2, 0.5)
+    size_t n = 20;
+    std::vector<double> x(n, 0.0);
+    std::vector<double> lower(n, 0.2);
+    std::vector<double> upper(n, 0.5);
+    auto solution = teensynlp::minimize_lbfgsb<double>(
+        [n](double const *x, double *gradient) {
+          double value = 0;
+          for (size_t i = 0; i < n; i++) {
+            double weight = static_cast<double>(i + 1);
+            value += weight * x[i] * x[i] / 2 - x[i];
+            gradient[i] = weight * x[i] - 1;
+          }
+          return value;
+        },
+        x, lower, upper);
+    REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+    for (size_t i = 0; i < n; i++) {
+      double expected = std::clamp(1.0 / (i + 1), 0.2, 0.5);
+      REQUIRE_THAT(x[i], Catch::Matchers::WithinAbs(expected, 1e-6));
+    }
+  }
+  SECTION("Coupled quadratic satisfies the optimality conditions") {
+    // minimize x^T A x / 2 - sum_i x_i over [0, 3]^n with A the second
+    // difference matrix, whose unconstrained minimizer leaves the box
+    size_t n = 100;
+    std::vector<double> x(n, 0.0);
+    std::vector<double> lower(n, 0.0);
+    std::vector<double> upper(n, 3.0);
+    teensynlp::Objective<double> objective = [n](double const *x,
+                                                 double *gradient) {
+      double value = 0;
+      for (size_t i = 0; i < n; i++) {
+        double ax = 2 * x[i];
+        if (i > 0) {
+          ax -= x[i - 1];
+        }
+        if (i + 1 < n) {
+          ax -= x[i + 1];
+        }
+        value += x[i] * ax / 2 - x[i];
+        gradient[i] = ax - 1;
+      }
+      return value;
+    };
+    teensynlp::LBFGSB<double> solver{lower, upper};
+    auto solution = solver.minimize(objective, x.data());
+    REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+    auto const &gradient = solver.get_gradient();
+    size_t active = 0;
+    for (size_t i = 0; i < n; i++) {
+      REQUIRE(x[i] >= 0.0);
+      REQUIRE(x[i] <= 3.0);
+      if (x[i] == 3.0) {
+        active++;
+        REQUIRE(gradient[i] <= 1e-6);
+      } else {
+        REQUIRE(std::abs(gradient[i]) <= 1e-6);
+      }
+    }
+    REQUIRE(active > 0);
+    REQUIRE(solver.get_memory().get_size() > 0);
+  }
+  SECTION("Rosenbrock function with an active bound") {
+    // Over [-2, 0.5]^2 the minimizer is (0.5, 0.25)
+    std::vector<double> x = {-1.2, 1.0};
+    teensynlp::LBFGSBOptions<double> options;
+    options.gradient_tolerance = 1e-9;
+    auto solution = teensynlp::minimize_lbfgsb<double>(
+        [](double const *x, double *gradient) {
+          return rosenbrock(x, gradient, 2);
+        },
+        x, {-2.0, -2.0}, {0.5, 0.5}, options);
+    REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+    REQUIRE(x[0] == 0.5);
+    REQUIRE_THAT(x[1], Catch::Matchers::WithinAbs(0.25, 1e-8));
+  }
+  SECTION("Without bounds it minimizes like L-BFGS") {
+    size_t n = 100;
+    auto x = rosenbrock_start(n);
+    std::vector<double> lower(n, -teensynlp::infinity<double>);
+    std::vector<double> upper(n, teensynlp::infinity<double>);
+    auto solution = teensynlp::minimize_lbfgsb<double>(
+        [n](double const *x, double *gradient) {
+          return rosenbrock(x, gradient, n);
+        },
+        x, lower, upper);
+    REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+    for (size_t i = 0; i < n; i++) {
+      REQUIRE_THAT(x[i], Catch::Matchers::WithinAbs(1.0, 1e-5));
+    }
+  }
+  SECTION("Starting outside the bounds") {
+    std::vector<double> x = {5.0, -5.0};
+    auto solution = teensynlp::minimize_lbfgsb<double>(
+        [](double const *x, double *gradient) {
+          gradient[0] = 2 * x[0];
+          gradient[1] = 2 * x[1];
+          return x[0] * x[0] + x[1] * x[1];
+        },
+        x, {1.0, -2.0}, {2.0, -1.0});
+    REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+    REQUIRE(x[0] == 1.0);
+    REQUIRE(x[1] == -1.0);
+  }
+  SECTION("Invalid bounds throw") {
+    REQUIRE_THROWS_AS((teensynlp::LBFGSB<double>{{0.0, 1.0}, {1.0, 0.0}}),
+                      std::range_error);
+    REQUIRE_THROWS_AS((teensynlp::LBFGSB<double>{{0.0}, {1.0, 2.0}}),
+                      std::range_error);
+  }
+}
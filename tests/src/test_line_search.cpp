@@ -0,0 +1,159 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <cmath>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyNLP/line_search.hpp"
+
+namespace {
+/*! sum_i (x_i - i)^4 + x_i^2, whose minimizer along -g from the origin is
+ * far from the unit step*/
+double quartic(double const *x, double *gradient, size_t n) {
+  double value = 0;
+  for (size_t i = 0; i < n; i++) {
+    double t = x[i] - static_cast<double>(i);
+    value += t * t * t * t + x[i] * x[i];
+    gradient[i] = 4 * t * t * t + 2 * x[i];
+  }
+  return value;
+}
+} // namespace
+
+TEST_CASE("Line searches", "[line_search]") {
+  size_t n = 4;
+  teensynlp::Objective<double> objective = [n](double const *x,
+                                               double *gradient) {
+    return quartic(x, gradient, n);
+  };
+  std::vector<double> x(n, 0.0);
+  std::vector<double> g(n);
+  double value = objective(x.data(), g.data());
+  std::vector<double> d(n);
+  for (size_t i = 0; i < n; i++) {
+    d[i] = -g[i];
+  }
+  double slope = 0;
+  for (size_t i = 0; i < n; i++) {
+    slope += g[i] * d[i];
+  }
+  std::vector<double> trial(n);
+  std::vector<double> trial_gradient(n);
+  auto trial_slope = [&]() {
+    double sum = 0;
+    for (size_t i = 0; i < n; i++) {
+      sum += trial_gradient[i] * d[i];
+    }
+    return sum;
+  };
+  auto check_cached = [&](double step, double trial_value) {
+    // The buffers hold the accepted point, its value and its gradient
+    std::vector<double> gradient(n);
+    for (size_t i = 0; i < n; i++) {
+      REQUIRE_THAT(trial[i],
+                   Catch::Matchers::WithinAbs(x[i] + step * d[i], 1e-15));
+    }
+    REQUIRE(objective(trial.data(), gradient.data()) == trial_value);
+    REQUIRE(gradient == trial_gradient);
+  };
+  using Method = teensynlp::LineSearchMethod;
+  SECTION("More-Thuente satisfies the strong Wolfe conditions") {
+    teensynlp::LineSearchOptions<double> options;
+    options.curvature = 0.1;
+    teensynlp::LineSearch<double> search{n, options};
+    double step = 1;
+    double trial_value;
+    REQUIRE(search.search(objective, x.data(), d.data(), value, slope, step,
+                          trial.data(), trial_gradient.data(),
+                          trial_value));
+    REQUIRE(trial_value <= value + 1e-4 * step * slope);
+    REQUIRE(std::abs(trial_slope()) <= -0.1 * slope);
+    REQUIRE(search.get_evaluations() <= 10);
+    check_cached(step, trial_value);
+  }
+  SECTION("Hager-Zhang satisfies the (approximate) Wolfe conditions") {
+    teensynlp::LineSearchOptions<double> options;
+    options.method = Method::hager_zhang;
+    options.sufficient_decrease = 0.1;
+    teensynlp::LineSearch<double> search{n, options};
+    double step = 1;
+    double trial_value;
+    REQUIRE(search.search(objective, x.data(), d.data(), value, slope, step,
+                          trial.data(), trial_gradient.data(),
+                          trial_value));
+    REQUIRE(trial_slope() >= 0.9 * slope);
+    REQUIRE(trial_value <= value);
+    check_cached(step, trial_value);
+  }
+  SECTION("Backtracking gives sufficient decrease") {
+    teensynlp::LineSearchOptions<double> options;
+    options.method = Method::backtracking;
+    teensynlp::LineSearch<double> search{n, options};
+    double step = 1;
+    double trial_value;
+    REQUIRE(search.search(objective, x.data(), d.data(), value, slope, step,
+                          trial.data(), trial_gradient.data(),
+                          trial_value));
+    REQUIRE(step < 1);
+    REQUIRE(trial_value <= value + 1e-4 * step * slope);
+    check_cached(step, trial_value);
+  }
+  SECTION("Steps are limited and trials clamped to the bounds") {
+    for (auto method :
+         {Method::more_thuente, Method::hager_zhang, Method::backtracking}) {
+      teensynlp::LineSearchOptions<double> options;
+      options.method = method;
+      teensynlp::LineSearch<double> search{n, options};
+      std::vector<double> lower(n, -1.0);
+      std::vector<double> upper(n, 1e-3);
+      search.set_bounds(lower.data(), upper.data());
+      double step = 1;
+      double trial_value;
+      REQUIRE(search.search(objective, x.data(), d.data(), value, slope,
+                            step, trial.data(), trial_gradient.data(),
+                            trial_value, 1e-4));
+      REQUIRE(step <= 1e-4);
+      for (size_t i = 0; i < n; i++) {
+        REQUIRE(trial[i] <= 1e-3);
+      }
+    }
+  }
+  SECTION("Steps where the objective is not finite are avoided") {
+    // -log(1 - x) + x^2 along d = 1 is undefined beyond x = 1
+    teensynlp::Objective<double> barrier = [](double const *x,
+                                              double *gradient) {
+      gradient[0] = 1 / (1 - x[0]) + 2 * x[0];
+      return -std::log(1 - x[0]) + x[0] * x[0];
+    };
+    for (auto method :
+         {Method::more_thuente, Method::hager_zhang, Method::backtracking}) {
+      teensynlp::LineSearchOptions<double> options;
+      options.method = method;
+      teensynlp::LineSearch<double> search{1, options};
+      double start = -2;
+      double direction = 1;
+      double gradient;
+      double f0 = barrier(&start, &gradient);
+      double step = 10;
+      double point, point_gradient, trial_value;
+      REQUIRE(search.search(barrier, &start, &direction, f0,
+                            gradient * direction, step, &point,
+                            &point_gradient, trial_value));
+      REQUIRE(point < 1);
+      REQUIRE(std::isfinite(trial_value));
+      REQUIRE(trial_value < f0);
+    }
+  }
+  SECTION("Ascent directions are rejected") {
+    teensynlp::LineSearch<double> search{n};
+    double step = 1;
+    double trial_value;
+    REQUIRE_FALSE(search.search(objective, x.data(), d.data(), value,
+                                -slope, step, trial.data(),
+                                trial_gradient.data(), trial_value));
+    REQUIRE(search.get_evaluations() == 0);
+  }
+}
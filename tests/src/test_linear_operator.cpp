@@ -0,0 +1,49 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+
+// std includes
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyMat/linear_operator.hpp"
+
+TEST_CASE("LinearOperator", "[linear_operator]") {
+  auto dense = teensymat::Matrix<double>{2, 3, {1, 0, 2, 0, 3, 4}};
+  SECTION("From a dense Matrix") {
+    auto op = teensymat::LinearOperator<double>::from_matrix(dense);
+    REQUIRE(op.get_nrows() == 2);
+    REQUIRE(op.get_ncols() == 3);
+    REQUIRE(op.apply(std::vector<double>{1, 2, 3}) == std::vector<double>{7, 18});
+    std::vector<double> transposed(3);
+    std::vector<double> x{1, 2};
+    op.apply_transpose(x.data(), transposed.data());
+    REQUIRE(transposed == std::vector<double>{1, 6, 10});
+  }
+  SECTION("From a SparseMatrix") {
+    auto op = teensymat::LinearOperator<double>::from_sparse(
+        teensymat::SparseMatrix<double>::from_dense(dense));
+    REQUIRE(op.apply(std::vector<double>{1, 2, 3}) == std::vector<double>{7, 18});
+  }
+  SECTION("Blocks of vectors") {
+    auto op = teensymat::LinearOperator<double>::from_matrix(dense);
+    // Two vectors, one per row
+    std::vector<double> block{1, 2, 3, 0, 1, 0};
+    std::vector<double> images(4);
+    op.apply_block(2, block.data(), images.data());
+    REQUIRE(images == std::vector<double>{7, 18, 0, 3});
+  }
+  SECTION("Implicit operators without a transpose") {
+    auto op = teensymat::LinearOperator<double>{
+        2, 2, [](double const *x, double *y) {
+          y[0] = 2 * x[0];
+          y[1] = 3 * x[1];
+        }};
+    REQUIRE_FALSE(op.has_transpose());
+    std::vector<double> x{1, 1};
+    std::vector<double> y(2);
+    REQUIRE_THROWS_AS(op.apply_transpose(x.data(), y.data()),
+                      std::runtime_error);
+    op.apply_block(1, x.data(), y.data());
+    REQUIRE(y == std::vector<double>{2, 3});
+  }
+}
@@ -2,6 +2,10 @@
 #include "catch2/catch_test_macros.hpp"
 #include "catch2/matchers/catch_matchers_floating_point.hpp"
 
+// std includes
+#include <thread>
+#include <vector>
+
 // Local Includes
 #include "TeensyOpt/TeensyMat/matrix_core.hpp"
 
@@ -124,3 +128,79 @@ TEST_CASE("Basic Matrix Operations", "[operations]") {
   }
   // SECTION("FAIL TEST") { REQUIRE(false); }
 }
+
+TEST_CASE("Matrix Equality", "[matrix_core]") {
+  SECTION("Equal matrices") {
+    auto lhs = teensymat::Matrix<double>{2, 3, {1, 2, 3, 4, 5, 6}};
+    auto rhs = teensymat::Matrix<double>{2, 3, {1, 2, 3, 4, 5, 6}};
+    REQUIRE(teensymat::equals(lhs, rhs));
+  }
+  SECTION("Different elements") {
+    auto lhs = teensymat::Matrix<double>{2, 3, {1, 2, 3, 4, 5, 6}};
+    auto rhs = teensymat::Matrix<double>{2, 3, {1, 2, 3, 4, 5, 7}};
+    REQUIRE_FALSE(teensymat::equals(lhs, rhs));
+  }
+  SECTION("Different shapes") {
+    auto lhs = teensymat::Matrix<int>{2, 3, {1, 2, 3, 4, 5, 6}};
+    auto rhs = teensymat::Matrix<int>{3, 2, {1, 2, 3, 4, 5, 6}};
+    REQUIRE_FALSE(teensymat::equals(lhs, rhs));
+  }
+  SECTION("Different memory layouts") {
+    // The transpose of the transpose is stored column major
+    auto lhs = teensymat::Matrix<int>{2, 3, {1, 2, 3, 4, 5, 6}};
+    auto rhs = teensymat::Matrix<int>{3, 2, {1, 4, 2, 5, 3, 6}}.transpose();
+    REQUIRE(teensymat::equals(lhs, rhs));
+    *rhs(1, 2) = 0;
+    REQUIRE_FALSE(teensymat::equals(lhs, rhs));
+  }
+  SECTION("Large matrices") {
+    auto lhs = teensymat::Matrix<double>{300, 400, 1.5};
+    auto rhs = teensymat::Matrix<double>{300, 400, 1.5};
+    REQUIRE(teensymat::equals(lhs, rhs));
+    *rhs(299, 399) = 2.0;
+    REQUIRE_FALSE(teensymat::equals(lhs, rhs));
+  }
+}
+
+TEST_CASE("Matrix Hashing", "[matrix_core]") {
+  SECTION("Equal matrices have equal hashes") {
+    auto lhs = teensymat::Matrix<int>{2, 3, {1, 2, 3, 4, 5, 6}};
+    auto rhs = teensymat::Matrix<int>{3, 2, {1, 4, 2, 5, 3, 6}}.transpose();
+    REQUIRE(lhs.content_hash() == rhs.content_hash());
+  }
+  SECTION("Shape is part of the hash") {
+    auto lhs = teensymat::Matrix<int>{2, 3, {1, 2, 3, 4, 5, 6}};
+    auto rhs = teensymat::Matrix<int>{3, 2, {1, 2, 3, 4, 5, 6}};
+    REQUIRE(lhs.content_hash() != rhs.content_hash());
+  }
+  SECTION("Modifications invalidate the cached hash") {
+    auto test_matrix = teensymat::Matrix<double>{2, 3, {1, 2, 3, 4, 5, 6}};
+    uint64_t before = test_matrix.content_hash();
+    size_t version = test_matrix.get_version();
+    REQUIRE(test_matrix.content_hash() == before);
+    REQUIRE(test_matrix.get_version() == version);
+    test_matrix.mult_row_scalar(1, 2.0);
+    REQUIRE(test_matrix.get_version() != version);
+    REQUIRE(test_matrix.content_hash() != before);
+    test_matrix.div_row_scalar(1, 2.0);
+    REQUIRE(test_matrix.content_hash() == before);
+  }
+  SECTION("Concurrent hashing of a const Matrix") {
+    teensymat::Matrix<double> shared{64, 64, 1.5};
+    auto const &view = shared;
+    uint64_t expected = teensymat::Matrix<double>{64, 64, 1.5}.content_hash();
+    std::vector<uint64_t> hashes(8);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < hashes.size(); t++) {
+      threads.emplace_back([&, t] { hashes[t] = view.content_hash(); });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    for (uint64_t hash : hashes) {
+      REQUIRE(hash == expected);
+    }
+    auto copy = shared;
+    REQUIRE(copy.content_hash() == expected);
+  }
+}
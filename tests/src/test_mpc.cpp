@@ -0,0 +1,229 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyLP/interior_point.hpp"
+#include "TeensyOpt/TeensyLP/mpc.hpp"
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+
+namespace {
+/*! A chain of nx / 2 masses connected by springs, driven by one force per
+ * mass (nu = nx / 2 inputs, unless given), with boxed states and inputs*/
+teensylp::MPCProblem<double> chain_problem(size_t horizon,
+                                           std::vector<double> initial,
+                                           size_t nu = 0) {
+  size_t nx = initial.size();
+  size_t masses = nx / 2;
+  nu = nu == 0 ? masses : nu;
+  double dt = 0.1;
+  teensymat::Matrix<double> a{nx, nx};
+  teensymat::Matrix<double> b{nx, nu};
+  for (size_t i = 0; i < nx; i++) {
+    *a(i, i) = 1.0;
+  }
+  for (size_t p = 0; p < masses; p++) {
+    *a(p, masses + p) = dt;
+    *a(masses + p, p) -= 2 * dt;
+    if (p > 0) {
+      *a(masses + p, p - 1) += dt;
+    }
+    if (p + 1 < masses) {
+      *a(masses + p, p + 1) += dt;
+    }
+    *b(masses + p, p % nu) = dt;
+  }
+  teensymat::Matrix<double> q{nx, nx};
+  teensymat::Matrix<double> r{nu, nu};
+  for (size_t i = 0; i < nx; i++) {
+    *q(i, i) = 1.0;
+  }
+  for (size_t i = 0; i < nu; i++) {
+    *r(i, i) = 0.1;
+  }
+  teensylp::MPCProblem<double> problem;
+  problem.initial_state = std::move(initial);
+  for (size_t k = 0; k <= horizon; k++) {
+    teensylp::MPCStage<double> stage;
+    stage.state_cost = q;
+    stage.state_lower.assign(nx, -2.0);
+    stage.state_upper.assign(nx, 2.0);
+    if (k < horizon) {
+      stage.state_transition = a;
+      stage.input_matrix = b;
+      stage.input_cost = r;
+      stage.input_lower.assign(nu, -1.0);
+      stage.input_upper.assign(nu, 1.0);
+    }
+    problem.stages.push_back(std::move(stage));
+  }
+  return problem;
+}
+
+/*! Random data on top of chain_problem: linear costs, offsets, cross
+ * terms and a general constraint on every stage*/
+teensylp::MPCProblem<double> random_problem(size_t horizon, size_t nx,
+                                            unsigned seed) {
+  std::mt19937 generator{seed};
+  std::uniform_real_distribution<double> uniform{-0.5, 0.5};
+  std::vector<double> initial(nx);
+  for (double &value : initial) {
+    value = uniform(generator);
+  }
+  auto problem = chain_problem(horizon, initial);
+  size_t nu = problem.get_input_dim();
+  for (size_t k = 0; k <= horizon; k++) {
+    auto &stage = problem.stages[k];
+    stage.state_gradient.resize(nx);
+    for (double &value : stage.state_gradient) {
+      value = uniform(generator);
+    }
+    stage.constraint_state = teensymat::Matrix<double>{1, nx};
+    for (size_t j = 0; j < nx; j++) {
+      *stage.constraint_state(0, j) = uniform(generator);
+    }
+    stage.constraint_lower = {-1.0};
+    stage.constraint_upper = {teensylp::infinity<double>};
+    if (k == horizon) {
+      continue;
+    }
+    stage.offset.resize(nx);
+    for (double &value : stage.offset) {
+      value = 0.1 * uniform(generator);
+    }
+    stage.input_gradient.resize(nu);
+    for (double &value : stage.input_gradient) {
+      value = uniform(generator);
+    }
+    stage.cross_cost = teensymat::Matrix<double>{nu, nx};
+    *stage.cross_cost(0, 0) = 0.05;
+    stage.constraint_input = teensymat::Matrix<double>{1, nu};
+    for (size_t j = 0; j < nu; j++) {
+      *stage.constraint_input(0, j) = uniform(generator);
+    }
+  }
+  return problem;
+}
+
+/*! Solve with the interior point method through to_qp and compare the
+ * objective and the states*/
+void require_matches_qp(teensylp::MPCProblem<double> const &problem,
+                        teensylp::MPCSolution<double> const &solution) {
+  auto reference = teensylp::solve_interior_point(problem.to_qp());
+  REQUIRE(reference.status == teensylp::LPStatus::optimal);
+  REQUIRE(solution.status == teensylp::LPStatus::optimal);
+  REQUIRE_THAT(solution.objective,
+               Catch::Matchers::WithinRel(reference.objective, 1e-6));
+  size_t nx = problem.get_state_dim();
+  size_t nu = problem.get_input_dim();
+  for (size_t k = 1; k <= problem.get_horizon(); k++) {
+    for (size_t i = 0; i < nx; i++) {
+      REQUIRE_THAT(solution.states[k][i],
+                   Catch::Matchers::WithinAbs(
+                       reference.x[(k - 1) * (nx + nu) + nu + i], 1e-4));
+    }
+  }
+}
+} // namespace
+
+TEST_CASE("MPC problems", "[mpc]") {
+  SECTION("Conversion to a QP keeps the objective") {
+    auto problem = random_problem(4, 4, 1);
+    auto qp = problem.to_qp();
+    REQUIRE(qp.constraints.get_nrows() == 4 * 4 + 5);
+    REQUIRE(qp.constraints.get_ncols() == 4 * (4 + 2));
+    auto solution = teensylp::solve_mpc(problem);
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    std::vector<double> x;
+    for (size_t k = 0; k < 4; k++) {
+      x.insert(x.end(), solution.inputs[k].begin(), solution.inputs[k].end());
+      x.insert(x.end(), solution.states[k + 1].begin(),
+               solution.states[k + 1].end());
+    }
+    REQUIRE_THAT(qp.evaluate(x),
+                 Catch::Matchers::WithinAbs(solution.objective, 1e-9));
+  }
+  SECTION("Mismatched blocks throw") {
+    auto problem = chain_problem(3, {0.5, 0.0});
+    problem.stages[1].state_transition = teensymat::Matrix<double>{3, 3};
+    REQUIRE_THROWS_AS(problem.validate(), std::range_error);
+    REQUIRE_THROWS_AS(teensylp::solve_mpc(problem), std::range_error);
+    problem = chain_problem(3, {0.5, 0.0});
+    problem.stages[0].input_lower = {0.0, 0.0};
+    REQUIRE_THROWS_AS(teensylp::MPCSolver<double>{problem}, std::range_error);
+    problem.stages.resize(1);
+    REQUIRE_THROWS_AS(problem.validate(), std::range_error);
+  }
+}
+
+TEST_CASE("MPC solver", "[mpc]") {
+  SECTION("Unconstrained problems are solved in one step") {
+    auto problem = chain_problem(10, {1.0, -0.5, 0.2, 0.3});
+    for (auto &stage : problem.stages) {
+      stage.state_lower.clear();
+      stage.state_upper.clear();
+      stage.input_lower.clear();
+      stage.input_upper.clear();
+    }
+    for (auto form : {teensylp::MPCForm::riccati,
+                      teensylp::MPCForm::condensed}) {
+      teensylp::MPCOptions<double> options;
+      options.form = form;
+      teensylp::MPCSolver<double> solver{problem, options};
+      REQUIRE(solver.get_form() == form);
+      auto solution = solver.solve();
+      REQUIRE(solution.iterations == 1);
+      require_matches_qp(problem, solution);
+      // The last costate is the gradient of the terminal cost
+      for (size_t i = 0; i < 4; i++) {
+        REQUIRE_THAT(solution.costates[9][i],
+                     Catch::Matchers::WithinAbs(solution.states[10][i], 1e-8));
+      }
+    }
+  }
+  SECTION("Box constrained problems match the interior point method") {
+    auto problem =
+        chain_problem(20, {1.5, -1.0, 0.8, 0.0, 0.3, -0.2, 0.1, 0.4});
+    require_matches_qp(problem, teensylp::solve_mpc(problem));
+  }
+  SECTION("Riccati and condensed forms agree") {
+    for (size_t nx : {2, 6, 10}) {
+      auto problem = random_problem(8, nx, static_cast<unsigned>(nx));
+      teensylp::MPCOptions<double> options;
+      options.form = teensylp::MPCForm::riccati;
+      auto riccati = teensylp::solve_mpc(problem, options);
+      options.form = teensylp::MPCForm::condensed;
+      auto condensed = teensylp::solve_mpc(problem, options);
+      require_matches_qp(problem, riccati);
+      require_matches_qp(problem, condensed);
+      for (size_t k = 0; k < 8; k++) {
+        for (size_t i = 0; i < nx; i++) {
+          REQUIRE_THAT(condensed.costates[k][i],
+                       Catch::Matchers::WithinAbs(riccati.costates[k][i],
+                                                  1e-5));
+        }
+      }
+    }
+  }
+  SECTION("The automatic form depends on the horizon") {
+    auto problem = chain_problem(40, {1.0, 0.0, 0.0, 0.0}, 1);
+    REQUIRE(teensylp::MPCSolver<double>{problem}.get_form() ==
+            teensylp::MPCForm::riccati);
+    problem = chain_problem(2, {1.0, 0.0, 0.0, 0.0}, 1);
+    REQUIRE(teensylp::MPCSolver<double>{problem}.get_form() ==
+            teensylp::MPCForm::condensed);
+  }
+  SECTION("Infeasible problems are detected") {
+    // The inputs cannot stop the masses in time
+    auto problem = chain_problem(5, {1.9, 1.9, 1.0, 1.0});
+    problem.stages[5].state_upper = {0.0, 0.0, 2.0, 2.0};
+    auto solution = teensylp::solve_mpc(problem);
+    REQUIRE(solution.status != teensylp::LPStatus::optimal);
+  }
+}
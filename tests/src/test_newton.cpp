@@ -0,0 +1,133 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <cmath>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+#include "TeensyOpt/TeensyNLP/newton.hpp"
+
+TEST_CASE("Modified Cholesky factorization", "[newton]") {
+  auto reconstruct = [](teensymat::Matrix<double> const &factor, size_t i,
+                        size_t j) {
+    double sum = 0;
+    for (size_t k = 0; k <= std::min(i, j); k++) {
+      double li = i == k ? 1.0 : *factor(i, k);
+      double lj = j == k ? 1.0 : *factor(j, k);
+      sum += li * *factor(k, k) * lj;
+    }
+    return sum;
+  };
+  std::vector<double> work(3);
+  SECTION("Positive definite matrices are not modified") {
+    teensymat::Matrix<double> a{
+        3, 3, {4.0, 1.0, 0.5, 1.0, 3.0, -1.0, 0.5, -1.0, 2.0}};
+    auto factor = a;
+    REQUIRE(teensynlp::newton_detail::modified_cholesky(factor,
+                                                        work.data()) == 0);
+    for (size_t i = 0; i < 3; i++) {
+      for (size_t j = 0; j < 3; j++) {
+        REQUIRE_THAT(reconstruct(factor, i, j),
+                     Catch::Matchers::WithinAbs(*a(i, j), 1e-12));
+      }
+    }
+    std::vector<double> x = {1.0, 2.0, 3.0};
+    teensynlp::newton_detail::ldl_solve(factor, x.data());
+    std::vector<double> b = {1.0, 2.0, 3.0};
+    for (size_t i = 0; i < 3; i++) {
+      double ax = 0;
+      for (size_t j = 0; j < 3; j++) {
+        ax += *a(i, j) * x[j];
+      }
+      REQUIRE_THAT(ax, Catch::Matchers::WithinAbs(b[i], 1e-12));
+    }
+  }
+  SECTION("Indefinite matrices get a diagonal modification") {
+    teensymat::Matrix<double> a{
+        3, 3, {1.0, 2.0, 0.0, 2.0, 1.0, 0.0, 0.0, 0.0, -3.0}};
+    auto factor = a;
+    double added =
+        teensynlp::newton_detail::modified_cholesky(factor, work.data());
+    REQUIRE(added > 0);
+    for (size_t i = 0; i < 3; i++) {
+      REQUIRE(*factor(i, i) > 0);
+      for (size_t j = 0; j < i; j++) {
+        REQUIRE_THAT(reconstruct(factor, i, j),
+                     Catch::Matchers::WithinAbs(*a(i, j), 1e-12));
+      }
+      double shift = reconstruct(factor, i, i) - *a(i, i);
+      REQUIRE(shift >= -1e-12);
+      REQUIRE(shift <= added + 1e-12);
+    }
+  }
+}
+
+TEST_CASE("Newton minimizer", "[newton]") {
+  SECTION("Convex quadratics take one step") {
+    std::vector<double> x = {5.0, -3.0};
+    auto solution = teensynlp::minimize_newton<double>(
+        [](double const *x, double *gradient) {
+          gradient[0] = 4 * x[0] + x[1] - 1;
+          gradient[1] = x[0] + 2 * x[1];
+          return 2 * x[0] * x[0] + x[0] * x[1] + x[1] * x[1] - x[0];
+        },
+        [](double const *, teensymat::Matrix<double> &hessian) {
+          *hessian(0, 0) = 4;
+          *hessian(1, 0) = 1;
+          *hessian(1, 1) = 2;
+        },
+        x);
+    REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+    REQUIRE(solution.iterations == 1);
+    REQUIRE_THAT(x[0], Catch::Matchers::WithinAbs(2.0 / 7.0, 1e-12));
+    REQUIRE_THAT(x[1], Catch::Matchers::WithinAbs(-1.0 / 7.0, 1e-12));
+  }
+  SECTION("Rosenbrock function") {
+    std::vector<double> x = {-1.2, 1.0};
+    teensynlp::NewtonOptions<double> options;
+    options.gradient_tolerance = 1e-10;
+    auto solution = teensynlp::minimize_newton<double>(
+        [](double const *x, double *gradient) {
+          double a = x[1] - x[0] * x[0];
+          double b = 1 - x[0];
+          gradient[0] = -400 * a * x[0] - 2 * b;
+          gradient[1] = 200 * a;
+          return 100 * a * a + b * b;
+        },
+        [](double const *x, teensymat::Matrix<double> &hessian) {
+          *hessian(0, 0) = 1200 * x[0] * x[0] - 400 * x[1] + 2;
+          *hessian(1, 0) = -400 * x[0];
+          *hessian(1, 1) = 200;
+        },
+        x, options);
+    REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+    REQUIRE(solution.iterations < 50);
+    REQUIRE_THAT(x[0], Catch::Matchers::WithinAbs(1.0, 1e-10));
+    REQUIRE_THAT(x[1], Catch::Matchers::WithinAbs(1.0, 1e-10));
+  }
+  SECTION("Negative curvature at the start") {
+    // x^4 / 4 - x^2 / 2 + y^2 / 2 has a saddle at the origin and minima at
+    // (+-1, 0)
+    teensynlp::Newton<double> solver{2};
+    std::vector<double> x = {0.1, 1.0};
+    auto solution = solver.minimize(
+        [](double const *x, double *gradient) {
+          gradient[0] = x[0] * x[0] * x[0] - x[0];
+          gradient[1] = x[1];
+          return std::pow(x[0], 4) / 4 - x[0] * x[0] / 2 + x[1] * x[1] / 2;
+        },
+        [](double const *x, teensymat::Matrix<double> &hessian) {
+          *hessian(0, 0) = 3 * x[0] * x[0] - 1;
+          *hessian(1, 0) = 0;
+          *hessian(1, 1) = 1;
+        },
+        x.data());
+    REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+    REQUIRE(solver.get_modified() > 0);
+    REQUIRE_THAT(x[0], Catch::Matchers::WithinAbs(1.0, 1e-6));
+    REQUIRE_THAT(x[1], Catch::Matchers::WithinAbs(0.0, 1e-6));
+  }
+}
@@ -0,0 +1,95 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <cmath>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyNLP/newton_cg.hpp"
+#include "nlp_helpers.hpp"
+
+using test_nlp::rosenbrock;
+using test_nlp::rosenbrock_product;
+using test_nlp::rosenbrock_start;
+
+TEST_CASE("Newton-CG minimizer", "[newton_cg]") {
+  SECTION("Coupled quadratic") {
+    // minimize x^T A x / 2 - sum_i x_i with A the second difference matrix
+    // plus the identity
+    size_t n = 500;
+    auto multiply = [n](double const *x, double *ax) {
+      for (size_t i = 0; i < n; i++) {
+        ax[i] = 3 * x[i];
+        if (i > 0) {
+          ax[i] -= x[i - 1];
+        }
+        if (i + 1 < n) {
+          ax[i] -= x[i + 1];
+        }
+      }
+    };
+    std::vector<double> x(n, 0.0);
+    teensynlp::NewtonCGOptions<double> options;
+    options.initial_radius = 100;
+    auto solution = teensynlp::minimize_newton_cg<double>(
+        [&](double const *x, double *gradient) {
+          multiply(x, gradient);
+          double value = 0;
+          for (size_t i = 0; i < n; i++) {
+            value += x[i] * gradient[i] / 2 - x[i];
+            gradient[i] -= 1;
+          }
+          return value;
+        },
+        [&](double const *, double const *v, double *product) {
+          multiply(v, product);
+        },
+        x, options);
+    REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+    REQUIRE(solution.iterations < 10);
+    std::vector<double> ax(n);
+    multiply(x.data(), ax.data());
+    for (size_t i = 0; i < n; i++) {
+      REQUIRE_THAT(ax[i], Catch::Matchers::WithinAbs(1.0, 1e-6));
+    }
+  }
+  SECTION("Extended Rosenbrock function") {
+    size_t n = 10000;
+    teensynlp::NewtonCG<double> solver{n};
+    auto x = rosenbrock_start(n);
+    auto solution = solver.minimize(
+        [n](double const *x, double *gradient) {
+          return rosenbrock(x, gradient, n);
+        },
+        [n](double const *x, double const *v, double *product) {
+          rosenbrock_product(x, v, product, n);
+        },
+        x.data());
+    REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+    REQUIRE(solution.iterations < 100);
+    REQUIRE(solver.get_products() > 0);
+    for (size_t i = 0; i < n; i++) {
+      REQUIRE_THAT(x[i], Catch::Matchers::WithinAbs(1.0, 1e-6));
+    }
+  }
+  SECTION("Negative curvature at the start") {
+    // x^4 / 4 - x^2 / 2 + y^2 / 2 starting near its saddle at the origin
+    std::vector<double> x = {1e-3, 1.0};
+    auto solution = teensynlp::minimize_newton_cg<double>(
+        [](double const *x, double *gradient) {
+          gradient[0] = x[0] * x[0] * x[0] - x[0];
+          gradient[1] = x[1];
+          return std::pow(x[0], 4) / 4 - x[0] * x[0] / 2 + x[1] * x[1] / 2;
+        },
+        [](double const *x, double const *v, double *product) {
+          product[0] = (3 * x[0] * x[0] - 1) * v[0];
+          product[1] = v[1];
+        },
+        x);
+    REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+    REQUIRE_THAT(std::abs(x[0]), Catch::Matchers::WithinAbs(1.0, 1e-6));
+    REQUIRE_THAT(x[1], Catch::Matchers::WithinAbs(0.0, 1e-6));
+  }
+}
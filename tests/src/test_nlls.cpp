@@ -0,0 +1,275 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyMat/linear_operator.hpp"
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+#include "TeensyOpt/TeensyMat/sparse_core.hpp"
+#include "TeensyOpt/TeensyNLP/nlls.hpp"
+
+namespace {
+/*! Data of y = 3 exp(-0.5 t) + 1 at t = 0, 0.25, ..., sampled exactly*/
+std::vector<double> exponential_data(size_t m) {
+  std::vector<double> y(m);
+  for (size_t i = 0; i < m; i++) {
+    y[i] = 3 * std::exp(-0.5 * 0.25 * double(i)) + 1;
+  }
+  return y;
+}
+
+/*! Extended Rosenbrock residuals (n even): 10 (x_{2i+1} - x_{2i}^2) and
+ * 1 - x_{2i}, zero at all ones*/
+void rosenbrock_residual(double const *x, double *r, size_t n) {
+  for (size_t i = 0; i < n; i += 2) {
+    r[i] = 10 * (x[i + 1] - x[i] * x[i]);
+    r[i + 1] = 1 - x[i];
+  }
+}
+
+/*! Pattern of the extended Rosenbrock Jacobian (CSC)*/
+teensymat::SparseMatrix<double> rosenbrock_pattern(size_t n) {
+  std::vector<size_t> col_ptr(n + 1, 0);
+  std::vector<size_t> row_idx;
+  for (size_t j = 0; j < n; j++) {
+    if (j % 2 == 0) {
+      row_idx.push_back(j);
+      row_idx.push_back(j + 1);
+    } else {
+      row_idx.push_back(j - 1);
+    }
+    col_ptr[j + 1] = row_idx.size();
+  }
+  size_t nnz = row_idx.size();
+  return teensymat::SparseMatrix<double>{n, n, std::move(col_ptr),
+                                         std::move(row_idx),
+                                         std::vector<double>(nnz, 0.0)};
+}
+} // namespace
+
+TEST_CASE("Nonlinear least squares", "[nlls]") {
+  size_t m = 40;
+  std::vector<double> y = exponential_data(m);
+  // Fit y = a exp(b t) + c
+  auto residual = [&](double const *x, double *r) {
+    for (size_t i = 0; i < m; i++) {
+      r[i] = x[0] * std::exp(x[1] * 0.25 * double(i)) + x[2] - y[i];
+    }
+  };
+  auto jacobian = [&](double const *x, teensymat::Matrix<double> &j) {
+    for (size_t i = 0; i < m; i++) {
+      double t = 0.25 * double(i);
+      double e = std::exp(x[1] * t);
+      double *row = j(i, 0);
+      row[0] = e;
+      row[1] = x[0] * t * e;
+      row[2] = 1;
+    }
+  };
+  SECTION("Exponential fit, every dense solver") {
+    for (auto method : {teensynlp::NLLSMethod::levenberg_marquardt,
+                        teensynlp::NLLSMethod::dogleg}) {
+      for (auto solver : {teensynlp::NLLSLinearSolver::qr,
+                          teensynlp::NLLSLinearSolver::normal_equations}) {
+        teensynlp::NLLSOptions<double> options;
+        options.method = method;
+        options.linear_solver = solver;
+        teensynlp::LeastSquares<double> problem{m, 3, residual, jacobian,
+                                                options};
+        REQUIRE(problem.get_linear_solver() == solver);
+        std::vector<double> x{1.0, 0.0, 0.0};
+        auto solution = problem.minimize(x.data());
+        REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+        REQUIRE_THAT(x[0], Catch::Matchers::WithinAbs(3.0, 1e-6));
+        REQUIRE_THAT(x[1], Catch::Matchers::WithinAbs(-0.5, 1e-6));
+        REQUIRE_THAT(x[2], Catch::Matchers::WithinAbs(1.0, 1e-6));
+        REQUIRE(solution.objective < 1e-12);
+        REQUIRE(problem.get_jacobian_evaluations() <= solution.iterations + 1);
+      }
+    }
+  }
+  SECTION("Strided dense Jacobian") {
+    // The callback assigns a transposed view, with strides (1, m)
+    auto transposed = [&](double const *x, teensymat::Matrix<double> &j) {
+      teensymat::Matrix<double> jt{3, m};
+      for (size_t i = 0; i < m; i++) {
+        double t = 0.25 * double(i);
+        double e = std::exp(x[1] * t);
+        *jt(0, i) = e;
+        *jt(1, i) = x[0] * t * e;
+        *jt(2, i) = 1;
+      }
+      j = jt.transpose();
+    };
+    for (auto solver : {teensynlp::NLLSLinearSolver::qr,
+                        teensynlp::NLLSLinearSolver::normal_equations}) {
+      teensynlp::NLLSOptions<double> options;
+      options.linear_solver = solver;
+      teensynlp::LeastSquares<double> problem{m, 3, residual, transposed,
+                                              options};
+      std::vector<double> x{1.0, 0.0, 0.0};
+      auto solution = problem.minimize(x.data());
+      REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+      REQUIRE_THAT(x[0], Catch::Matchers::WithinAbs(3.0, 1e-6));
+      REQUIRE_THAT(x[1], Catch::Matchers::WithinAbs(-0.5, 1e-6));
+      REQUIRE_THAT(x[2], Catch::Matchers::WithinAbs(1.0, 1e-6));
+    }
+    teensynlp::LeastSquares<double> wrong_shape{
+        m, 3, residual, [&](double const *, teensymat::Matrix<double> &j) {
+          j = teensymat::Matrix<double>{3, m};
+        }};
+    std::vector<double> x{1.0, 0.0, 0.0};
+    REQUIRE_THROWS_AS(wrong_shape.minimize(x.data()), std::range_error);
+  }
+  SECTION("Rank deficient Jacobian") {
+    // Only x0 + x1 is determined, so J^T J is singular
+    auto deficient = [](double const *x, double *r) {
+      for (size_t i = 0; i < 3; i++) {
+        r[i] = double(i + 1) * (x[0] + x[1] - 1);
+      }
+    };
+    auto deficient_jacobian = [](double const *,
+                                 teensymat::Matrix<double> &j) {
+      for (size_t i = 0; i < 3; i++) {
+        *j(i, 0) = double(i + 1);
+        *j(i, 1) = double(i + 1);
+      }
+    };
+    for (auto method : {teensynlp::NLLSMethod::levenberg_marquardt,
+                        teensynlp::NLLSMethod::dogleg}) {
+      teensynlp::NLLSOptions<double> options;
+      options.method = method;
+      options.linear_solver = teensynlp::NLLSLinearSolver::normal_equations;
+      teensynlp::LeastSquares<double> problem{3, 2, deficient,
+                                              deficient_jacobian, options};
+      std::vector<double> x{2.0, 3.0};
+      auto solution = problem.minimize(x.data());
+      REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+      REQUIRE_THAT(x[0] + x[1], Catch::Matchers::WithinAbs(1.0, 1e-8));
+    }
+  }
+  SECTION("Automatic solver choice") {
+    teensynlp::LeastSquares<double> tall{m, 3, residual, jacobian};
+    REQUIRE(tall.get_linear_solver() ==
+            teensynlp::NLLSLinearSolver::normal_equations);
+    teensynlp::LeastSquares<double> square{
+        2, 2,
+        [](double const *x, double *r) { rosenbrock_residual(x, r, 2); },
+        [](double const *, teensymat::Matrix<double> &) {}};
+    REQUIRE(square.get_linear_solver() == teensynlp::NLLSLinearSolver::qr);
+    teensynlp::NLLSOptions<double> options;
+    options.linear_solver = teensynlp::NLLSLinearSolver::qr;
+    REQUIRE_THROWS_AS((teensynlp::LeastSquares<double>{
+                          1, 2, [](double const *, double *) {},
+                          [](double const *, teensymat::Matrix<double> &) {},
+                          options}),
+                      std::range_error);
+  }
+  SECTION("Rosenbrock, dense") {
+    auto rosenbrock_jacobian = [](double const *x,
+                                  teensymat::Matrix<double> &j) {
+      *j(0, 0) = -20 * x[0];
+      *j(0, 1) = 10;
+      *j(1, 0) = -1;
+      *j(1, 1) = 0;
+    };
+    for (auto method : {teensynlp::NLLSMethod::levenberg_marquardt,
+                        teensynlp::NLLSMethod::dogleg}) {
+      teensynlp::NLLSOptions<double> options;
+      options.method = method;
+      std::vector<double> x{-1.2, 1.0};
+      auto solution = teensynlp::minimize_least_squares<double>(
+          2, [](double const *x, double *r) { rosenbrock_residual(x, r, 2); },
+          rosenbrock_jacobian, x, options);
+      REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+      REQUIRE_THAT(x[0], Catch::Matchers::WithinAbs(1.0, 1e-8));
+      REQUIRE_THAT(x[1], Catch::Matchers::WithinAbs(1.0, 1e-8));
+    }
+  }
+  SECTION("Extended Rosenbrock, sparse") {
+    size_t n = 1000;
+    auto sparse_jacobian = [](double const *x,
+                              teensymat::SparseMatrix<double> &j) {
+      // Columns 2i: -20 x_{2i} (row 2i), -1 (row 2i + 1); columns 2i + 1: 10
+      double *values = j.get_values()->data();
+      size_t n = j.get_ncols();
+      for (size_t i = 0; i < n; i += 2) {
+        values[3 * i / 2] = -20 * x[i];
+        values[3 * i / 2 + 1] = -1;
+        values[3 * i / 2 + 2] = 10;
+      }
+    };
+    for (auto method : {teensynlp::NLLSMethod::levenberg_marquardt,
+                        teensynlp::NLLSMethod::dogleg}) {
+      teensynlp::NLLSOptions<double> options;
+      options.method = method;
+      teensynlp::LeastSquares<double> problem{
+          [n](double const *x, double *r) { rosenbrock_residual(x, r, n); },
+          sparse_jacobian, rosenbrock_pattern(n), options};
+      REQUIRE(problem.get_linear_solver() ==
+              teensynlp::NLLSLinearSolver::normal_equations);
+      std::vector<double> x(n);
+      for (size_t i = 0; i < n; i += 2) {
+        x[i] = -1.2;
+        x[i + 1] = 1.0;
+      }
+      auto solution = problem.minimize(x.data());
+      REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+      for (size_t i = 0; i < n; i++) {
+        REQUIRE_THAT(x[i], Catch::Matchers::WithinAbs(1.0, 1e-8));
+      }
+    }
+  }
+  SECTION("Extended Rosenbrock, matrix-free") {
+    size_t n = 200;
+    auto jacobian_operator = [n](double const *x) {
+      std::vector<double> a(x, x + n);
+      return teensymat::LinearOperator<double>{
+          n, n,
+          [a, n](double const *v, double *out) {
+            for (size_t i = 0; i < n; i += 2) {
+              out[i] = -20 * a[i] * v[i] + 10 * v[i + 1];
+              out[i + 1] = -v[i];
+            }
+          },
+          [a, n](double const *v, double *out) {
+            for (size_t i = 0; i < n; i += 2) {
+              out[i] = -20 * a[i] * v[i] - v[i + 1];
+              out[i + 1] = 10 * v[i];
+            }
+          }};
+    };
+    teensynlp::LeastSquares<double> problem{
+        n, n,
+        [n](double const *x, double *r) { rosenbrock_residual(x, r, n); },
+        teensynlp::JacobianOperator<double>{jacobian_operator}};
+    REQUIRE(problem.get_linear_solver() ==
+            teensynlp::NLLSLinearSolver::conjugate_gradient);
+    std::vector<double> x(n);
+    for (size_t i = 0; i < n; i += 2) {
+      x[i] = -1.2;
+      x[i + 1] = 1.0;
+    }
+    auto solution = problem.minimize(x.data());
+    REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+    for (size_t i = 0; i < n; i++) {
+      REQUIRE_THAT(x[i], Catch::Matchers::WithinAbs(1.0, 1e-6));
+    }
+  }
+  SECTION("Matrix-free Jacobian without a transpose") {
+    teensynlp::LeastSquares<double> problem{
+        2, 2,
+        [](double const *x, double *r) { rosenbrock_residual(x, r, 2); },
+        teensynlp::JacobianOperator<double>{[](double const *) {
+          return teensymat::LinearOperator<double>{
+              2, 2, [](double const *, double *) {}};
+        }}};
+    std::vector<double> x{-1.2, 1.0};
+    REQUIRE_THROWS_AS(problem.minimize(x.data()), std::runtime_error);
+  }
+}
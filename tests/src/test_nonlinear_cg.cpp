@@ -0,0 +1,97 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <cmath>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyNLP/nonlinear_cg.hpp"
+#include "nlp_helpers.hpp"
+
+using test_nlp::rosenbrock;
+using test_nlp::rosenbrock_start;
+
+TEST_CASE("Nonlinear conjugate gradient minimizer", "[nonlinear_cg]") {
+  using Method = teensynlp::CGMethod;
+  auto methods = {Method::polak_ribiere_plus, Method::hestenes_stiefel,
+                  Method::dai_yuan, Method::hager_zhang};
+  teensynlp::NonlinearCGOptions<double> options;
+  SECTION("Convex quadratic") {
+    // minimize sum_i (i + 1) x_i^2 / 2 - x_i, with x_i = 1 / (i + 1)
+    size_t n = 100;
+    for (auto method : methods) {
+      options.method = method;
+      std::vector<double> x(n, 0.0);
+      auto solution = teensynlp::minimize_nonlinear_cg<double>(
+          [n](double const *x, double *gradient) {
+            double value = 0;
+            for (size_t i = 0; i < n; i++) {
+              double weight = static_cast<double>(i + 1);
+              value += weight * x[i] * x[i] / 2 - x[i];
+              gradient[i] = weight * x[i] - 1;
+            }
+            return value;
+          },
+          x, options);
+      REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+      for (size_t i = 0; i < n; i++) {
+        REQUIRE_THAT(x[i], Catch::Matchers::WithinAbs(1.0 / (i + 1), 1e-6));
+      }
+    }
+  }
+  SECTION("Extended Rosenbrock function") {
+    size_t n = 1000;
+    for (auto method : methods) {
+      options.method = method;
+      teensynlp::NonlinearCG<double> solver{n, options};
+      auto x = rosenbrock_start(n);
+      auto solution = solver.minimize(
+          [n](double const *x, double *gradient) {
+            return rosenbrock(x, gradient, n);
+          },
+          x.data());
+      REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+      for (size_t i = 0; i < n; i++) {
+        REQUIRE_THAT(x[i], Catch::Matchers::WithinAbs(1.0, 1e-5));
+      }
+    }
+  }
+  SECTION("Small Rosenbrock functions") {
+    // With n = 2 a restart every n iterations would never let the
+    // directions become conjugate, and steps without decrease must not
+    // stop the solve while the function test is disabled
+    for (auto method : methods) {
+      options.method = method;
+      for (size_t n : {2, 12, 40}) {
+        auto x = rosenbrock_start(n);
+        auto solution = teensynlp::minimize_nonlinear_cg<double>(
+            [n](double const *x, double *gradient) {
+              return rosenbrock(x, gradient, n);
+            },
+            x, options);
+        REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+        REQUIRE(solution.iterations < 1000);
+        for (size_t i = 0; i < n; i++) {
+          REQUIRE_THAT(x[i], Catch::Matchers::WithinAbs(1.0, 1e-5));
+        }
+      }
+    }
+  }
+  SECTION("Restarts") {
+    size_t n = 2;
+    options.restart_interval = 1;
+    options.max_iterations = 10;
+    teensynlp::NonlinearCG<double> solver{n, options};
+    std::vector<double> x = {-1.2, 1.0};
+    auto solution = solver.minimize(
+        [n](double const *x, double *gradient) {
+          return rosenbrock(x, gradient, n);
+        },
+        x.data());
+    // Every iteration restarts, as in steepest descent
+    REQUIRE(solution.status == teensynlp::NLPStatus::iteration_limit);
+    REQUIRE(solver.get_restarts() == 10);
+  }
+}
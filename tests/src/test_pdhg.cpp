@@ -0,0 +1,119 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyLP/pdhg.hpp"
+#include "TeensyOpt/TeensyLP/simplex.hpp"
+#include "lp_helpers.hpp"
+
+using test_lp::inf;
+using test_lp::make_problem;
+using test_lp::random_problem;
+
+namespace {
+/*! Largest relative violation of the row and column bounds*/
+double bound_violation(teensylp::LPProblem<double> const &problem,
+                       teensylp::LPSolution<double> const &solution) {
+  double violation = 0.0;
+  auto check = [&](double value, double lower, double upper) {
+    double scale = 1.0 + std::abs(value);
+    violation = std::max(violation, (lower - value) / scale);
+    violation = std::max(violation, (value - upper) / scale);
+  };
+  std::vector<double> activity = problem.constraints.multiply(solution.x);
+  for (size_t i = 0; i < problem.get_nrows(); i++) {
+    check(activity[i], problem.row_lower[i], problem.row_upper[i]);
+  }
+  for (size_t j = 0; j < problem.get_ncols(); j++) {
+    check(solution.x[j], problem.col_lower[j], problem.col_upper[j]);
+  }
+  return violation;
+}
+} // namespace
+
+TEST_CASE("PDHG on small programs", "[pdhg]") {
+  SECTION("Textbook maximization") {
+    auto problem = make_problem(3, 2, {1, 0, 0, 2, 3, 2}, {-3, -5},
+                                {-inf, -inf, -inf}, {4, 12, 18}, {0, 0},
+                                {inf, inf});
+    auto solution = teensylp::solve_pdhg(problem);
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE_THAT(solution.objective, Catch::Matchers::WithinAbs(-36, 1e-4));
+    REQUIRE_THAT(solution.x[0], Catch::Matchers::WithinAbs(2, 1e-4));
+    REQUIRE_THAT(solution.x[1], Catch::Matchers::WithinAbs(6, 1e-4));
+    REQUIRE_THAT(solution.row_duals[1], Catch::Matchers::WithinAbs(-1.5, 1e-4));
+    REQUIRE_THAT(solution.row_duals[2], Catch::Matchers::WithinAbs(-1, 1e-4));
+    REQUIRE(solution.col_status.empty());
+  }
+  SECTION("Without preconditioning") {
+    auto problem = make_problem(3, 2, {1, 0, 0, 2, 3, 2}, {-3, -5},
+                                {-inf, -inf, -inf}, {4, 12, 18}, {0, 0},
+                                {inf, inf});
+    teensylp::PDHGOptions<double> options;
+    options.scale = false;
+    auto solution = teensylp::solve_pdhg(problem, options);
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE_THAT(solution.objective, Catch::Matchers::WithinAbs(-36, 1e-4));
+  }
+  SECTION("Infeasible constraints") {
+    // x1 + x2 >= 3 and x1 + x2 <= 1
+    auto problem = make_problem(2, 2, {1, 1, 1, 1}, {1, 1}, {3, -inf},
+                                {inf, 1}, {0, 0}, {inf, inf});
+    REQUIRE(teensylp::solve_pdhg(problem).status ==
+            teensylp::LPStatus::infeasible);
+    // x1 + x2 = 5 with 0 <= x <= 1
+    problem = make_problem(1, 2, {1, 1}, {1, 1}, {5}, {5}, {0, 0}, {1, 1});
+    REQUIRE(teensylp::solve_pdhg(problem).status ==
+            teensylp::LPStatus::infeasible);
+  }
+  SECTION("Unbounded objective") {
+    // minimize -x1 with x1 - x2 <= 1
+    auto problem = make_problem(1, 2, {1, -1}, {-1, 0}, {-inf}, {1}, {0, 0},
+                                {inf, inf});
+    REQUIRE(teensylp::solve_pdhg(problem).status ==
+            teensylp::LPStatus::unbounded);
+  }
+  SECTION("Iteration limit") {
+    auto problem = random_problem(50, 80, 3);
+    teensylp::PDHGOptions<double> options;
+    options.max_iterations = 10;
+    auto solution = teensylp::solve_pdhg(problem, options);
+    REQUIRE(solution.status == teensylp::LPStatus::iteration_limit);
+    REQUIRE(solution.iterations == 10);
+  }
+}
+
+TEST_CASE("PDHG on random programs", "[pdhg]") {
+  for (unsigned seed = 1; seed <= 4; seed++) {
+    auto problem = random_problem(60 * seed, 90 * seed, seed);
+    auto reference = teensylp::solve_simplex(problem);
+    REQUIRE(reference.status == teensylp::LPStatus::optimal);
+    teensylp::PrimalDualHybridGradient<double> solver{problem};
+    auto solution = solver.solve();
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE(solver.get_num_restarts() > 0);
+    REQUIRE(solver.get_num_attempts() >= solution.iterations);
+    REQUIRE_THAT(solution.objective,
+                 Catch::Matchers::WithinRel(reference.objective, 1e-5));
+    REQUIRE(bound_violation(problem, solution) < 1e-5);
+    // Row activities and reduced costs are consistent with x and the duals
+    std::vector<double> activity = problem.constraints.multiply(solution.x);
+    std::vector<double> reduced =
+        problem.constraints.multiply_transpose(solution.row_duals);
+    for (size_t i = 0; i < problem.get_nrows(); i++) {
+      REQUIRE_THAT(solution.row_activity[i],
+                   Catch::Matchers::WithinAbs(activity[i], 1e-9));
+    }
+    for (size_t j = 0; j < problem.get_ncols(); j++) {
+      REQUIRE_THAT(solution.reduced_costs[j],
+                   Catch::Matchers::WithinAbs(
+                       problem.objective[j] - reduced[j], 1e-9));
+    }
+  }
+}
@@ -0,0 +1,247 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <random>
+#include <utility>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyLP/interior_point.hpp"
+#include "TeensyOpt/TeensyLP/presolve.hpp"
+#include "TeensyOpt/TeensyLP/simplex.hpp"
+#include "lp_helpers.hpp"
+
+using test_lp::inf;
+using test_lp::kkt_error;
+using test_lp::make_problem;
+using test_lp::random_problem;
+
+namespace {
+/*! A random feasible and bounded LP with every structure presolve removes:
+ * fixed, empty and dominated columns, empty, singleton, duplicate,
+ * forcing and redundant rows, doubleton equations, slack and free column
+ * singletons*/
+teensylp::LPProblem<double> structured_problem(size_t m, size_t n,
+                                               unsigned seed) {
+  std::mt19937 generator{seed};
+  std::uniform_real_distribution<double> uniform{0.0, 1.0};
+  std::normal_distribution<double> normal{0.0, 1.0};
+  auto base = random_problem(m, n, seed);
+  // Recover a feasible point: the midpoint of the finite row and column
+  // bounds is not feasible in general, so solve the base problem instead
+  auto reference = teensylp::solve_simplex(base);
+  std::vector<double> x0 = reference.x;
+  std::vector<double> y0 = reference.row_duals;
+  std::vector<size_t> rows, cols;
+  std::vector<double> vals;
+  auto const &col_ptr = base.constraints.get_col_ptr();
+  auto const &row_idx = base.constraints.get_row_idx();
+  auto const &values = *base.constraints.get_values();
+  for (size_t j = 0; j < n; j++) {
+    for (size_t k = col_ptr[j]; k < col_ptr[j + 1]; k++) {
+      rows.push_back(row_idx[k]);
+      cols.push_back(j);
+      vals.push_back(values[k]);
+    }
+  }
+  teensylp::LPProblem<double> problem = base;
+  size_t nrows = m;
+  size_t ncols = n;
+  auto add_row = [&](std::vector<std::pair<size_t, double>> const &entries,
+                     double lower, double upper) {
+    for (auto [col, value] : entries) {
+      rows.push_back(nrows);
+      cols.push_back(col);
+      vals.push_back(value);
+    }
+    problem.row_lower.push_back(lower);
+    problem.row_upper.push_back(upper);
+    y0.push_back(0.0);
+    return nrows++;
+  };
+  auto add_col = [&](std::vector<std::pair<size_t, double>> const &entries,
+                     double cost, double lower, double upper, double value) {
+    for (auto [row, coefficient] : entries) {
+      rows.push_back(row);
+      cols.push_back(ncols);
+      vals.push_back(coefficient);
+    }
+    problem.objective.push_back(cost);
+    problem.col_lower.push_back(lower);
+    problem.col_upper.push_back(upper);
+    x0.push_back(value);
+    return ncols++;
+  };
+  auto activity = base.constraints.multiply(x0);
+  for (size_t t = 0; t < 3; t++) {
+    size_t j = generator() % n;
+    size_t r = generator() % m;
+    size_t p = generator() % n;
+    size_t q = (p + 1 + generator() % (n - 1)) % n;
+    // Singleton rows (once their fixed column is removed), tight and loose
+    double fixed_value = normal(generator);
+    size_t fixed = add_col({}, normal(generator), 0.5, 0.5, 0.5);
+    add_row({{j, 2.0}, {fixed, fixed_value}},
+            2.0 * x0[j] + 0.5 * fixed_value -
+                (t == 0 ? 0.0 : uniform(generator)),
+            test_lp::inf);
+    // A duplicate of a row, scaled by -2
+    add_row([&] {
+      std::vector<std::pair<size_t, double>> entries;
+      for (size_t c = 0; c < n; c++) {
+        double value = base.constraints.coeff(r, c);
+        if (value != 0.0) {
+          entries.push_back({c, -2.0 * value});
+        }
+      }
+      return entries;
+    }(), -2.0 * activity[r] - uniform(generator), -2.0 * activity[r]);
+    // A doubleton equation
+    add_row({{p, 1.5}, {q, -0.5}}, 1.5 * x0[p] - 0.5 * x0[q],
+            1.5 * x0[p] - 0.5 * x0[q]);
+    // An empty column
+    add_col({}, uniform(generator), -1.0, 2.0, -1.0);
+    // A slack column, with the sign keeping the dual feasible
+    add_col({{r, y0[r] > 0 ? -1.0 : 1.0}}, 0.0, 0.0, test_lp::inf, 0.0);
+    // A free column singleton priced out by the dual of its row
+    size_t e = 4 * (generator() % (m / 4)); // an equality row
+    add_col({{e, 3.0}}, 3.0 * y0[e], -test_lp::inf, test_lp::inf, 0.0);
+    // A forcing row over new boxed columns: sum x <= 0 with x >= 0
+    size_t first = add_col({}, normal(generator), 0.0, 1.0, 0.0);
+    size_t second = add_col({}, normal(generator), 0.0, 1.0, 0.0);
+    add_row({{first, 1.0}, {second, 2.0}}, -test_lp::inf, 0.0);
+    // A redundant row over them
+    add_row({{first, 1.0}, {second, -1.0}}, -5.0, 5.0);
+    // A dominated column in a <= row (whose dual is <= 0)
+    size_t le = 4 * (generator() % (m / 4)) + 2;
+    add_col({{le, 1.0}}, 1.0 + uniform(generator), 0.0, test_lp::inf, 0.0);
+    // An empty row
+    add_row({}, -1.0, 1.0);
+  }
+  problem.constraints = teensymat::SparseMatrix<double>::from_triplets(
+      nrows, ncols, rows, cols, vals);
+  return problem;
+}
+
+/*! Number of basic columns and rows*/
+size_t count_basic(teensylp::LPSolution<double> const &solution) {
+  size_t count = 0;
+  for (auto status : solution.col_status) {
+    count += status == teensylp::BasisStatus::basic;
+  }
+  for (auto status : solution.row_status) {
+    count += status == teensylp::BasisStatus::basic;
+  }
+  return count;
+}
+
+/*! The solver run on the reduced problems*/
+auto simplex = [](teensylp::LPProblem<double> const &problem) {
+  return teensylp::solve_simplex(problem);
+};
+} // namespace
+
+TEST_CASE("Presolve on small programs", "[presolve]") {
+  SECTION("Everything removed") {
+    // x1 = 2 (singleton row), x1 + x2 = 5 (doubleton), x3 >= 0 with
+    // positive cost (dominated)
+    auto problem = make_problem(2, 3, {1, 0, 0, 1, 1, 0}, {1, 2, 3}, {2, 5},
+                                {2, 5}, {0, 0, 0}, {inf, inf, inf});
+    teensylp::Presolve<double> presolve{problem};
+    REQUIRE(presolve.get_status() == teensylp::PresolveStatus::reduced);
+    REQUIRE(presolve.get_reduced().get_nrows() == 0);
+    REQUIRE(presolve.get_reduced().get_ncols() == 0);
+    auto solution = teensylp::solve_presolved(problem, simplex);
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE_THAT(solution.objective, Catch::Matchers::WithinAbs(8, 1e-12));
+    REQUIRE_THAT(solution.x[0], Catch::Matchers::WithinAbs(2, 1e-12));
+    REQUIRE_THAT(solution.x[1], Catch::Matchers::WithinAbs(3, 1e-12));
+    REQUIRE_THAT(solution.x[2], Catch::Matchers::WithinAbs(0, 1e-12));
+    REQUIRE(kkt_error(problem, solution) < 1e-12);
+    REQUIRE(count_basic(solution) == 2);
+  }
+  SECTION("Infeasible singleton rows") {
+    // x1 >= 3 and x1 <= 1 as two singleton rows
+    auto problem = make_problem(2, 2, {1, 0, 1, 0}, {1, 1}, {3, -inf},
+                                {inf, 1}, {0, 0}, {inf, inf});
+    teensylp::Presolve<double> presolve{problem};
+    REQUIRE(presolve.get_status() == teensylp::PresolveStatus::infeasible);
+    REQUIRE(teensylp::solve_presolved(problem, simplex).status ==
+            teensylp::LPStatus::infeasible);
+  }
+  SECTION("Unbounded empty column") {
+    auto problem = make_problem(1, 2, {1, 0}, {1, -1}, {1}, {inf}, {0, 0},
+                                {inf, inf});
+    teensylp::Presolve<double> presolve{problem};
+    REQUIRE(presolve.get_status() == teensylp::PresolveStatus::unbounded);
+    REQUIRE(teensylp::solve_presolved(problem, simplex).status ==
+            teensylp::LPStatus::unbounded);
+  }
+  SECTION("Duplicate rows") {
+    // The second and third rows are -2 and 3 times the first
+    auto problem =
+        make_problem(4, 3, {1, 2, 1, -2, -4, -2, 3, 6, 3, 1, 0, 1},
+                     {-1, -1, -1}, {-inf, -6, -inf, -inf},
+                     {4, inf, 15, 3}, {0, 0, 0}, {inf, inf, inf});
+    teensylp::PresolveOptions<double> options;
+    options.singleton_columns = false;
+    options.dominated_columns = false;
+    options.bound_tightening = false;
+    teensylp::Presolve<double> presolve{problem, options};
+    REQUIRE(presolve.get_reduced().get_nrows() == 2);
+    auto solution = teensylp::solve_presolved(problem, simplex, options);
+    auto reference = teensylp::solve_simplex(problem);
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE_THAT(solution.objective,
+                 Catch::Matchers::WithinAbs(reference.objective, 1e-12));
+    REQUIRE(kkt_error(problem, solution) < 1e-12);
+    REQUIRE(count_basic(solution) == 4);
+  }
+}
+
+TEST_CASE("Presolve on structured programs", "[presolve]") {
+  for (unsigned seed = 1; seed <= 6; seed++) {
+    auto problem = structured_problem(40, 60, seed);
+    auto reference = teensylp::solve_simplex(problem);
+    REQUIRE(reference.status == teensylp::LPStatus::optimal);
+    teensylp::Presolve<double> presolve{problem};
+    REQUIRE(presolve.get_status() == teensylp::PresolveStatus::reduced);
+    REQUIRE(presolve.get_reduced().get_nrows() < problem.get_nrows());
+    REQUIRE(presolve.get_reduced().get_ncols() < problem.get_ncols());
+    REQUIRE(presolve.get_row_map().size() ==
+            presolve.get_reduced().get_nrows());
+    REQUIRE(presolve.get_col_map().size() ==
+            presolve.get_reduced().get_ncols());
+    SECTION("Simplex") {
+      auto solution = presolve.postsolve(
+          teensylp::solve_simplex(presolve.get_reduced()));
+      REQUIRE(solution.status == teensylp::LPStatus::optimal);
+      REQUIRE_THAT(solution.objective,
+                   Catch::Matchers::WithinRel(reference.objective, 1e-10));
+      REQUIRE(kkt_error(problem, solution) < 1e-9);
+      // The postsolved basis is a basis of the original problem, optimal
+      // up to the roundoff
+      REQUIRE(count_basic(solution) == problem.get_nrows());
+      teensylp::RevisedSimplex<double> warm{problem};
+      warm.set_basis(solution.col_status, solution.row_status);
+      auto resolved = warm.solve();
+      REQUIRE(resolved.status == teensylp::LPStatus::optimal);
+      REQUIRE(resolved.iterations <= 5);
+      REQUIRE_THAT(resolved.objective,
+                   Catch::Matchers::WithinRel(reference.objective, 1e-10));
+    }
+    SECTION("Interior point") {
+      auto solution = teensylp::solve_presolved(
+          problem, [](teensylp::LPProblem<double> const &reduced) {
+            return teensylp::solve_interior_point(reduced);
+          });
+      REQUIRE(solution.status == teensylp::LPStatus::optimal);
+      REQUIRE_THAT(solution.objective,
+                   Catch::Matchers::WithinRel(reference.objective, 1e-7));
+      REQUIRE(kkt_error(problem, solution) < 1e-6);
+      REQUIRE(solution.col_status.empty());
+    }
+  }
+}
@@ -0,0 +1,101 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <array>
+#include <cstdint>
+
+// Local Includes
+#include "TeensyOpt/TeensyMat/random.hpp"
+
+TEST_CASE("Philox generator", "[random]") {
+  SECTION("Known answer") {
+    // Random123 known answer test for philox4x32_10, counter and key zero
+    auto generator = teensymat::Philox{0};
+    std::array<uint32_t, 4> expected{0x6627e8d5U, 0xe169c58dU, 0xbc57ac4cU,
+                                     0x9b00dbd8U};
+    REQUIRE(generator.block(0) == expected);
+  }
+  SECTION("Streams differ") {
+    REQUIRE(teensymat::Philox{7, 0}.block(3) !=
+            teensymat::Philox{7, 1}.block(3));
+  }
+}
+
+TEST_CASE("Random Matrix fills", "[random]") {
+  SECTION("Uniform values are in range") {
+    auto test_matrix = teensymat::random_uniform<double>(50, 40, 42, -2.0, 3.0);
+    double sum = 0.0;
+    for (size_t row = 0; row < 50; row++) {
+      for (size_t col = 0; col < 40; col++) {
+        double value = *test_matrix(row, col);
+        REQUIRE(value >= -2.0);
+        REQUIRE(value < 3.0);
+        sum += value;
+      }
+    }
+    REQUIRE_THAT(sum / 2000.0, Catch::Matchers::WithinAbs(0.5, 0.1));
+  }
+  SECTION("Uniform values stay below high when rounding") {
+    // The Scalars are 1 (float) or 2 (double) apart at these bounds, so
+    // low + width u rounds to high for about half of the draws
+    auto floats = teensymat::random_uniform<float>(10, 10, 3, 1e7f, 1e7f + 1);
+    auto doubles = teensymat::random_uniform<double>(10, 10, 3, 1e16, 1e16 + 2);
+    for (size_t row = 0; row < 10; row++) {
+      for (size_t col = 0; col < 10; col++) {
+        REQUIRE(*floats(row, col) == 1e7f);
+        REQUIRE(*doubles(row, col) == 1e16);
+      }
+    }
+  }
+  SECTION("Normal values have the right moments") {
+    auto test_matrix = teensymat::random_normal<float>(100, 100, 3, 1.0f, 2.0f);
+    double sum = 0.0;
+    double sum_squares = 0.0;
+    for (size_t row = 0; row < 100; row++) {
+      for (size_t col = 0; col < 100; col++) {
+        double value = *test_matrix(row, col);
+        sum += value;
+        sum_squares += value * value;
+      }
+    }
+    double mean = sum / 10000.0;
+    double variance = sum_squares / 10000.0 - mean * mean;
+    REQUIRE_THAT(mean, Catch::Matchers::WithinAbs(1.0, 0.1));
+    REQUIRE_THAT(variance, Catch::Matchers::WithinAbs(4.0, 0.3));
+  }
+  SECTION("Results do not depend on the number of threads") {
+    auto &pool = teensymat::ThreadPool::global();
+    size_t original_threads = pool.get_num_threads();
+    pool.set_num_threads(1);
+    auto serial = teensymat::random_normal<double>(300, 301, 11);
+    pool.set_num_threads(3);
+    auto parallel = teensymat::random_normal<double>(300, 301, 11);
+    pool.set_num_threads(original_threads);
+    REQUIRE(teensymat::equals(serial, parallel));
+  }
+  SECTION("Skip ahead reproduces a shard of a larger fill") {
+    auto whole = teensymat::Matrix<double>{6, 10};
+    teensymat::Philox{5}.fill_uniform(whole);
+    // The last three rows use the blocks after the first thirty values
+    auto shard = teensymat::Matrix<double>{3, 10};
+    auto generator = teensymat::Philox{5};
+    generator.skip_ahead(teensymat::Philox::blocks_for<double>(30));
+    generator.fill_uniform(shard);
+    for (size_t row = 0; row < 3; row++) {
+      for (size_t col = 0; col < 10; col++) {
+        REQUIRE(*shard(row, col) == *whole(row + 3, col));
+      }
+    }
+  }
+  SECTION("Consecutive fills continue the stream") {
+    auto generator = teensymat::Philox{9};
+    auto first = teensymat::Matrix<double>{2, 2};
+    auto second = teensymat::Matrix<double>{2, 2};
+    generator.fill_uniform(first);
+    REQUIRE(generator.get_position() == 2);
+    generator.fill_uniform(second);
+    REQUIRE_FALSE(teensymat::equals(first, second));
+  }
+}
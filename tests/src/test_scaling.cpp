@@ -0,0 +1,155 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <cmath>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyMat/factorize.hpp"
+#include "TeensyOpt/TeensyMat/scaling.hpp"
+
+namespace {
+/*! A badly scaled 3x3 Matrix*/
+teensymat::Matrix<double> badly_scaled() {
+  return teensymat::Matrix<double>{
+      3, 3, {1e4, 2e4, 0, 3e-3, 0, 1e-3, 0, 5.0, 2e6}};
+}
+/*! Whether x is a power of two*/
+bool is_power_of_two(double x) {
+  int exponent;
+  return std::frexp(x, &exponent) == 0.5;
+}
+} // namespace
+
+TEST_CASE("Norms", "[scaling]") {
+  auto dense = badly_scaled();
+  auto sparse = teensymat::SparseMatrix<double>::from_dense(dense);
+  REQUIRE(teensymat::row_norms_inf(dense) == std::vector<double>{2e4, 3e-3, 2e6});
+  REQUIRE(teensymat::col_norms_inf(dense) == std::vector<double>{1e4, 2e4, 2e6});
+  REQUIRE(teensymat::row_norms_inf(sparse) == teensymat::row_norms_inf(dense));
+  REQUIRE(teensymat::col_norms_inf(sparse) == teensymat::col_norms_inf(dense));
+}
+
+TEST_CASE("Ruiz equilibration", "[scaling]") {
+  SECTION("Norms approach one") {
+    auto dense = badly_scaled();
+    auto scaling = teensymat::ruiz_scaling(dense, 50, 1e-6, false);
+    teensymat::apply_scaling(dense, scaling);
+    for (double norm : teensymat::row_norms_inf(dense)) {
+      REQUIRE_THAT(norm, Catch::Matchers::WithinAbs(1.0, 1e-5));
+    }
+    for (double norm : teensymat::col_norms_inf(dense)) {
+      REQUIRE_THAT(norm, Catch::Matchers::WithinAbs(1.0, 1e-5));
+    }
+  }
+  SECTION("Dense and sparse agree") {
+    auto dense = badly_scaled();
+    auto sparse = teensymat::SparseMatrix<double>::from_dense(dense);
+    auto dense_scaling = teensymat::ruiz_scaling(dense);
+    auto sparse_scaling = teensymat::ruiz_scaling(sparse);
+    REQUIRE(dense_scaling.row_scale == sparse_scaling.row_scale);
+    REQUIRE(dense_scaling.col_scale == sparse_scaling.col_scale);
+    teensymat::apply_scaling(dense, dense_scaling);
+    teensymat::apply_scaling(sparse, sparse_scaling);
+    REQUIRE(teensymat::equals(sparse.to_dense(), dense));
+  }
+  SECTION("Result does not depend on the number of threads") {
+    // Large enough for the passes to split into several blocks
+    size_t m = 300;
+    size_t n = 200;
+    teensymat::Matrix<double> dense{m, n};
+    for (size_t i = 0; i < m; i++) {
+      for (size_t j = 0; j < n; j++) {
+        if ((i * 37 + j * 11) % 7 == 0) {
+          *dense(i, j) = std::pow(10.0, static_cast<double>((i + j) % 9) - 4);
+        }
+      }
+    }
+    auto sparse = teensymat::SparseMatrix<double>::from_dense(dense);
+    auto &pool = teensymat::ThreadPool::global();
+    size_t original_threads = pool.get_num_threads();
+    pool.set_num_threads(1);
+    auto dense_serial = teensymat::ruiz_scaling(dense);
+    auto sparse_serial = teensymat::ruiz_scaling(sparse);
+    pool.set_num_threads(4);
+    auto dense_parallel = teensymat::ruiz_scaling(dense);
+    auto sparse_parallel = teensymat::ruiz_scaling(sparse);
+    pool.set_num_threads(original_threads);
+    REQUIRE(dense_serial.row_scale == dense_parallel.row_scale);
+    REQUIRE(dense_serial.col_scale == dense_parallel.col_scale);
+    REQUIRE(sparse_serial.row_scale == sparse_parallel.row_scale);
+    REQUIRE(sparse_serial.col_scale == sparse_parallel.col_scale);
+    REQUIRE(sparse_serial.row_scale == dense_serial.row_scale);
+  }
+  SECTION("Power of two factors") {
+    auto scaling = teensymat::ruiz_scaling(badly_scaled());
+    for (double scale : scaling.row_scale) {
+      REQUIRE(is_power_of_two(scale));
+    }
+    for (double scale : scaling.col_scale) {
+      REQUIRE(is_power_of_two(scale));
+    }
+  }
+  SECTION("Solving the scaled system and unscaling") {
+    auto dense = badly_scaled();
+    std::vector<double> expected{1.0, -2.0, 3.0};
+    std::vector<double> rhs(3, 0.0);
+    for (size_t row = 0; row < 3; row++) {
+      for (size_t col = 0; col < 3; col++) {
+        rhs[row] += *dense(row, col) * expected[col];
+      }
+    }
+    auto scaling = teensymat::ruiz_scaling(dense);
+    teensymat::apply_scaling(dense, scaling);
+    scaling.scale_rows(rhs);
+    std::vector<double> x = teensymat::LUFactorization<double>{dense}.solve(rhs);
+    scaling.unscale_primal(x);
+    for (size_t i = 0; i < 3; i++) {
+      REQUIRE_THAT(x[i], Catch::Matchers::WithinRel(expected[i], 1e-10));
+    }
+  }
+}
+
+TEST_CASE("Geometric scaling", "[scaling]") {
+  auto dense = badly_scaled();
+  auto sparse = teensymat::SparseMatrix<double>::from_dense(dense);
+  auto scaling = teensymat::geometric_scaling(sparse);
+  teensymat::apply_scaling(sparse, scaling);
+  // The ratio of largest to smallest magnitude shrinks
+  auto spread = [](std::vector<double> const &values) {
+    double largest = 0.0;
+    double smallest = 1e300;
+    for (double value : values) {
+      largest = std::max(largest, std::abs(value));
+      smallest = std::min(smallest, std::abs(value));
+    }
+    return largest / smallest;
+  };
+  auto original = teensymat::SparseMatrix<double>::from_dense(dense);
+  REQUIRE(spread(*sparse.get_values()) < spread(*original.get_values()) / 1e3);
+}
+
+TEST_CASE("Pock-Chambolle scaling", "[scaling]") {
+  auto sparse = teensymat::SparseMatrix<double>::from_dense(badly_scaled());
+  auto scaling = teensymat::pock_chambolle_scaling(sparse);
+  teensymat::apply_scaling(sparse, scaling);
+  // The scaled matrix has operator norm at most one (power iteration on
+  // A^T A)
+  std::vector<double> x(sparse.get_ncols(), 1.0);
+  double norm = 0.0;
+  for (size_t k = 0; k < 200; k++) {
+    std::vector<double> product =
+        sparse.multiply_transpose(sparse.multiply(x));
+    norm = 0.0;
+    for (double value : product) {
+      norm += value * value;
+    }
+    norm = std::sqrt(norm);
+    for (size_t j = 0; j < x.size(); j++) {
+      x[j] = product[j] / norm;
+    }
+  }
+  REQUIRE(std::sqrt(norm) <= 1.0 + 1e-12);
+}
@@ -0,0 +1,190 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyLP/sdp.hpp"
+#include "TeensyOpt/TeensyMat/eigen.hpp"
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+
+using teensymat::SparseMatrix;
+
+namespace {
+/*! Symmetric n x n matrix with value at (i, j) and (j, i)*/
+SparseMatrix<double> symmetric_entry(size_t n, size_t i, size_t j,
+                                     double value) {
+  if (i == j) {
+    return SparseMatrix<double>::from_triplets(n, n, {i}, {i}, {value});
+  }
+  return SparseMatrix<double>::from_triplets(n, n, {i, j}, {j, i},
+                                             {value, value});
+}
+
+/*! The n x n identity, for the constraint trace(X) = 1*/
+SparseMatrix<double> sparse_identity(size_t n) {
+  std::vector<size_t> index(n);
+  for (size_t i = 0; i < n; i++) {
+    index[i] = i;
+  }
+  return SparseMatrix<double>::from_triplets(n, n, index, index,
+                                             std::vector<double>(n, 1.0));
+}
+
+/*! The max-cut relaxation of a random graph: minimize <-L / 4, X> with
+ * diag(X) = 1, L the Laplacian*/
+teensylp::SDPProblem<double> max_cut(size_t n, double density,
+                                     unsigned seed) {
+  std::mt19937 generator{seed};
+  std::uniform_real_distribution<double> uniform{0.0, 1.0};
+  std::vector<size_t> rows, cols;
+  std::vector<double> values;
+  auto add = [&](size_t i, size_t j, double value) {
+    rows.push_back(i);
+    cols.push_back(j);
+    values.push_back(value);
+  };
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < i; j++) {
+      if (uniform(generator) < density) {
+        add(i, j, 0.25);
+        add(j, i, 0.25);
+        add(i, i, -0.25);
+        add(j, j, -0.25);
+      }
+    }
+  }
+  teensylp::SDPProblem<double> problem;
+  problem.objective = SparseMatrix<double>::from_triplets(n, n, rows, cols,
+                                                          values);
+  for (size_t i = 0; i < n; i++) {
+    problem.constraints.push_back(symmetric_entry(n, i, i, 1.0));
+  }
+  problem.rhs.assign(n, 1.0);
+  return problem;
+}
+
+/*! Solve with the given method*/
+teensylp::SDPSolution<double> solve_with(
+    teensylp::SDPProblem<double> const &problem, teensylp::SDPMethod method) {
+  teensylp::SDPOptions<double> options;
+  options.method = method;
+  return teensylp::solve_sdp(problem, options);
+}
+} // namespace
+
+TEST_CASE("Semidefinite problems", "[sdp]") {
+  teensylp::SDPProblem<double> problem;
+  problem.objective = sparse_identity(3);
+  problem.constraints = {sparse_identity(3)};
+  problem.rhs = {1.0};
+  REQUIRE_NOTHROW(problem.validate());
+  SECTION("Non symmetric data throws") {
+    problem.constraints.push_back(
+        SparseMatrix<double>::from_triplets(3, 3, {0}, {1}, {1.0}));
+    problem.rhs.push_back(0.0);
+    REQUIRE_THROWS_AS(problem.validate(), std::range_error);
+  }
+  SECTION("Mismatched dimensions throw") {
+    problem.constraints.push_back(sparse_identity(4));
+    problem.rhs.push_back(0.0);
+    REQUIRE_THROWS_AS(teensylp::solve_sdp(problem), std::range_error);
+    problem.constraints.pop_back();
+    REQUIRE_THROWS_AS(teensylp::solve_sdp(problem), std::range_error);
+  }
+}
+
+TEST_CASE("Semidefinite programming solver", "[sdp]") {
+  auto methods = {teensylp::SDPMethod::interior_point,
+                  teensylp::SDPMethod::low_rank};
+  SECTION("Smallest eigenvalue") {
+    // minimize <C, X> with trace(X) = 1 gives the smallest eigenvalue of C
+    size_t n = 8;
+    std::mt19937 generator{3};
+    std::normal_distribution<double> normal{0.0, 1.0};
+    teensymat::Matrix<double> dense{n, n};
+    for (size_t i = 0; i < n; i++) {
+      for (size_t j = 0; j <= i; j++) {
+        double value = normal(generator);
+        *dense(i, j) = value;
+        *dense(j, i) = value;
+      }
+    }
+    double lambda = teensymat::symmetric_eigen(dense).eigenvalues.front();
+    teensylp::SDPProblem<double> problem;
+    problem.objective = SparseMatrix<double>::from_dense(dense);
+    problem.constraints = {sparse_identity(n)};
+    problem.rhs = {1.0};
+    for (auto method : methods) {
+      auto solution = solve_with(problem, method);
+      REQUIRE(solution.status == teensylp::LPStatus::optimal);
+      REQUIRE_THAT(solution.objective,
+                   Catch::Matchers::WithinAbs(lambda, 1e-6));
+      REQUIRE_THAT(solution.dual_objective,
+                   Catch::Matchers::WithinAbs(lambda, 1e-6));
+    }
+  }
+  SECTION("Lovasz theta of the five cycle") {
+    // maximize <J, X> with trace(X) = 1 and X_ij = 0 on the edges
+    size_t n = 5;
+    std::vector<size_t> rows, cols;
+    for (size_t i = 0; i < n; i++) {
+      for (size_t j = 0; j < n; j++) {
+        rows.push_back(i);
+        cols.push_back(j);
+      }
+    }
+    teensylp::SDPProblem<double> problem;
+    problem.objective = SparseMatrix<double>::from_triplets(
+        n, n, rows, cols, std::vector<double>(n * n, -1.0));
+    problem.constraints = {sparse_identity(n)};
+    problem.rhs = {1.0};
+    for (size_t i = 0; i < n; i++) {
+      problem.constraints.push_back(symmetric_entry(n, i, (i + 1) % n, 1.0));
+      problem.rhs.push_back(0.0);
+    }
+    for (auto method : methods) {
+      auto solution = solve_with(problem, method);
+      REQUIRE(solution.status == teensylp::LPStatus::optimal);
+      REQUIRE_THAT(solution.objective,
+                   Catch::Matchers::WithinAbs(-std::sqrt(5.0), 1e-6));
+    }
+  }
+  SECTION("Max-cut relaxation with both methods") {
+    auto problem = max_cut(60, 0.2, 7);
+    auto dense = solve_with(problem, teensylp::SDPMethod::interior_point);
+    REQUIRE(dense.status == teensylp::LPStatus::optimal);
+    REQUIRE(dense.primal.get_nrows() == 60);
+    REQUIRE(dense.factor.get_nrows() == 0);
+    teensylp::SDPSolver<double> solver{problem};
+    REQUIRE(solver.get_method() == teensylp::SDPMethod::interior_point);
+    teensylp::SDPOptions<double> options;
+    options.method = teensylp::SDPMethod::low_rank;
+    teensylp::SDPSolver<double> low_rank{problem, options};
+    auto factored = low_rank.solve();
+    REQUIRE(factored.status == teensylp::LPStatus::optimal);
+    REQUIRE(factored.primal.get_nrows() == 0);
+    REQUIRE(factored.factor.get_nrows() == 60);
+    REQUIRE(factored.factor.get_ncols() == low_rank.get_rank());
+    REQUIRE(low_rank.get_rank() < 20);
+    REQUIRE_THAT(factored.objective,
+                 Catch::Matchers::WithinRel(dense.objective, 1e-6));
+    REQUIRE_THAT(factored.dual_objective,
+                 Catch::Matchers::WithinRel(dense.dual_objective, 1e-6));
+  }
+  SECTION("Infeasible problems") {
+    // trace(X) = 1 and X_00 = 2 cannot both hold for X semidefinite
+    teensylp::SDPProblem<double> problem;
+    problem.objective = sparse_identity(3);
+    problem.constraints = {sparse_identity(3), symmetric_entry(3, 0, 0, 1.0)};
+    problem.rhs = {1.0, 2.0};
+    auto solution = solve_with(problem, teensylp::SDPMethod::interior_point);
+    REQUIRE(solution.status == teensylp::LPStatus::infeasible);
+  }
+}
@@ -0,0 +1,466 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyLP/simplex.hpp"
+#include "TeensyOpt/TeensyMat/factorize.hpp"
+#include "lp_helpers.hpp"
+
+using test_lp::inf;
+using test_lp::kkt_error;
+using test_lp::make_problem;
+using test_lp::random_problem;
+
+TEST_CASE("Basis factorization solves", "[simplex]") {
+  size_t m = 40;
+  size_t n = 60;
+  auto problem = random_problem(m, n, 7);
+  auto const &a = problem.constraints;
+  teensylp::BasisFactor<double> factor{a};
+  // A basis mixing structurals and logicals
+  std::vector<size_t> basic(m);
+  for (size_t i = 0; i < m; i++) {
+    basic[i] = i % 3 == 0 ? n + i : i;
+  }
+  auto replaced = factor.factorize(basic);
+  auto dense_basis = [&]() {
+    teensymat::Matrix<double> b{m, m};
+    for (size_t p = 0; p < m; p++) {
+      if (basic[p] >= n) {
+        *b(basic[p] - n, p) = -1.0;
+      } else {
+        for (size_t i = 0; i < m; i++) {
+          *b(i, p) = a.coeff(i, basic[p]);
+        }
+      }
+    }
+    return b;
+  };
+  auto check = [&]() {
+    teensymat::Matrix<double> b = dense_basis();
+    teensymat::LUFactorization<double> lu{b};
+    REQUIRE_FALSE(lu.is_singular());
+    for (size_t trial = 0; trial < 3; trial++) {
+      // FTRAN of a sparse right hand side
+      teensymat::IndexedVector<double> rhs(m);
+      std::vector<double> dense(m, 0.0);
+      for (size_t k = 0; k < 3; k++) {
+        size_t row = (trial * 7 + k * 11) % m;
+        if (dense[row] == 0.0) {
+          rhs.add(row, 1.0 + k);
+          dense[row] = 1.0 + k;
+        }
+      }
+      factor.ftran(rhs);
+      lu.solve_inplace(dense.data());
+      for (size_t i = 0; i < m; i++) {
+        REQUIRE_THAT(rhs.values[i], Catch::Matchers::WithinAbs(dense[i], 1e-9));
+      }
+      // BTRAN of a unit vector
+      teensymat::IndexedVector<double> unit(m);
+      std::vector<double> dense_unit(m, 0.0);
+      unit.add(trial * 5 % m, 1.0);
+      dense_unit[trial * 5 % m] = 1.0;
+      factor.btran(unit);
+      lu.solve_transpose_inplace(dense_unit.data());
+      for (size_t i = 0; i < m; i++) {
+        REQUIRE_THAT(unit.values[i],
+                     Catch::Matchers::WithinAbs(dense_unit[i], 1e-9));
+      }
+    }
+  };
+
+  SECTION("After factorization") {
+    // Dependent columns (if any) were swapped for logicals
+    for (auto const &[position, var] : replaced) {
+      REQUIRE(basic[position] >= n);
+    }
+    check();
+  }
+  SECTION("After product form updates") {
+    for (size_t update = 0; update < 15; update++) {
+      size_t entering = 40 + update;
+      teensymat::IndexedVector<double> column(m);
+      for (size_t k = a.get_col_ptr()[entering];
+           k < a.get_col_ptr()[entering + 1]; k++) {
+        column.add(a.get_row_idx()[k], (*a.get_values())[k]);
+      }
+      factor.ftran(column);
+      // Replace the position with the largest pivot
+      size_t position = 0;
+      for (size_t p = 0; p < m; p++) {
+        if (std::abs(column.values[p]) > std::abs(column.values[position])) {
+          position = p;
+        }
+      }
+      factor.update(position, column);
+      basic[position] = entering;
+    }
+    REQUIRE(factor.get_num_updates() == 15);
+    check();
+  }
+  SECTION("Singular bases are repaired with logicals") {
+    std::vector<size_t> singular(m);
+    for (size_t i = 0; i < m; i++) {
+      singular[i] = n + i;
+    }
+    // Two copies of column 0, in the positions of one of its rows and of
+    // another row
+    size_t row = a.get_row_idx()[0];
+    singular[row] = 0;
+    singular[(row + 1) % m] = 0;
+    auto repaired = factor.factorize(singular);
+    REQUIRE(repaired.size() == 1);
+    REQUIRE(repaired[0].second == 0);
+    basic = singular;
+    check();
+  }
+}
+
+TEST_CASE("Small linear programs", "[simplex]") {
+  SECTION("Textbook maximization") {
+    // max 3x + 5y st x <= 4, 2y <= 12, 3x + 2y <= 18 (optimum 36 at (2, 6))
+    auto problem = make_problem(3, 2, {1, 0, 0, 2, 3, 2}, {-3, -5},
+                                {-inf, -inf, -inf}, {4, 12, 18}, {0, 0},
+                                {inf, inf});
+    for (auto algorithm :
+         {teensylp::SimplexAlgorithm::dual, teensylp::SimplexAlgorithm::primal}) {
+      teensylp::SimplexOptions<double> options;
+      options.algorithm = algorithm;
+      auto solution = teensylp::solve_simplex(problem, options);
+      REQUIRE(solution.status == teensylp::LPStatus::optimal);
+      REQUIRE_THAT(solution.objective, Catch::Matchers::WithinAbs(-36, 1e-9));
+      REQUIRE_THAT(solution.x[0], Catch::Matchers::WithinAbs(2, 1e-9));
+      REQUIRE_THAT(solution.x[1], Catch::Matchers::WithinAbs(6, 1e-9));
+      REQUIRE_THAT(solution.row_duals[1], Catch::Matchers::WithinAbs(-1.5, 1e-9));
+      REQUIRE_THAT(solution.row_duals[2], Catch::Matchers::WithinAbs(-1, 1e-9));
+      REQUIRE(kkt_error(problem, solution) < 1e-9);
+    }
+  }
+  SECTION("Equality rows and free variables") {
+    // min x + y + z st x + y = 2, y - z = 1, z free, x, y >= 0 (optimum 1
+    // at (2, 0, -1))
+    auto problem = make_problem(2, 3, {1, 1, 0, 0, 1, -1}, {1, 1, 1}, {2, 1},
+                                {2, 1}, {0, 0, -inf}, {inf, inf, inf});
+    auto solution = teensylp::solve_simplex(problem);
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE_THAT(solution.objective, Catch::Matchers::WithinAbs(1, 1e-9));
+    REQUIRE_THAT(solution.x[2], Catch::Matchers::WithinAbs(-1, 1e-9));
+    REQUIRE(kkt_error(problem, solution) < 1e-9);
+  }
+  SECTION("Infeasible") {
+    // x + y <= 1 and x + y >= 3
+    auto problem = make_problem(2, 2, {1, 1, 1, 1}, {1, 1}, {-inf, 3},
+                                {1, inf}, {0, 0}, {inf, inf});
+    REQUIRE(teensylp::solve_simplex(problem).status ==
+            teensylp::LPStatus::infeasible);
+  }
+  SECTION("Inconsistent bounds") {
+    auto problem = make_problem(1, 1, {1}, {1}, {0}, {1}, {2}, {1});
+    REQUIRE(teensylp::solve_simplex(problem).status ==
+            teensylp::LPStatus::infeasible);
+  }
+  SECTION("Unbounded") {
+    // min -x - y st x - y <= 1, x, y >= 0
+    auto problem = make_problem(1, 2, {1, -1}, {-1, -1}, {-inf}, {1}, {0, 0},
+                                {inf, inf});
+    REQUIRE(teensylp::solve_simplex(problem).status ==
+            teensylp::LPStatus::unbounded);
+  }
+  SECTION("No rows") {
+    auto problem = make_problem(0, 2, {}, {1, -1}, {}, {}, {-1, -2}, {3, 4});
+    auto solution = teensylp::solve_simplex(problem);
+    REQUIRE(solution.status == teensylp::LPStatus::optimal);
+    REQUIRE_THAT(solution.objective, Catch::Matchers::WithinAbs(-5, 1e-12));
+  }
+}
+
+TEST_CASE("Random sparse linear programs", "[simplex]") {
+  for (unsigned seed : {1u, 2u, 3u}) {
+    auto problem = random_problem(150 + 50 * seed, 250, seed);
+    teensylp::SimplexOptions<double> options;
+    options.refactor_interval = 30;
+    auto dual = teensylp::solve_simplex(problem, options);
+    REQUIRE(dual.status == teensylp::LPStatus::optimal);
+    REQUIRE(kkt_error(problem, dual) < 1e-6);
+
+    options.algorithm = teensylp::SimplexAlgorithm::primal;
+    options.scale = false;
+    options.perturb_costs = false;
+    auto primal = teensylp::solve_simplex(problem, options);
+    REQUIRE(primal.status == teensylp::LPStatus::optimal);
+    REQUIRE(kkt_error(problem, primal) < 1e-6);
+    REQUIRE_THAT(primal.objective,
+                 Catch::Matchers::WithinRel(dual.objective, 1e-8));
+  }
+}
+
+TEST_CASE("Large transportation LP", "[simplex][.][slow]") {
+  // 50k sources with supply 2 and 50k sinks with demand 1, each source
+  // shipping to three sinks: 100k rows and 150k columns
+  size_t half = 50000;
+  std::mt19937 generator{7};
+  std::uniform_real_distribution<double> cost{1.0, 2.0};
+  std::vector<size_t> rows, cols;
+  teensylp::LPProblem<double> problem;
+  for (size_t i = 0; i < half; i++) {
+    for (size_t offset : {0, 1, 7}) {
+      rows.insert(rows.end(), {i, half + (i + offset) % half});
+      cols.insert(cols.end(), 2, problem.objective.size());
+      problem.objective.push_back(cost(generator));
+      problem.col_lower.push_back(0.0);
+      problem.col_upper.push_back(inf);
+    }
+  }
+  problem.constraints = teensymat::SparseMatrix<double>::from_triplets(
+      2 * half, problem.objective.size(), rows, cols,
+      std::vector<double>(rows.size(), 1.0));
+  problem.row_lower.assign(half, -inf);
+  problem.row_upper.assign(half, 2.0);
+  problem.row_lower.insert(problem.row_lower.end(), half, 1.0);
+  problem.row_upper.insert(problem.row_upper.end(), half, inf);
+  auto solution = teensylp::solve_simplex(problem);
+  REQUIRE(solution.status == teensylp::LPStatus::optimal);
+  REQUIRE(kkt_error(problem, solution) < 1e-6);
+}
+
+TEST_CASE("Pricing strategies", "[simplex]") {
+  SECTION("All rules reach the same optimum") {
+    for (unsigned seed : {4u, 5u}) {
+      auto problem = random_problem(120, 200, seed);
+      teensylp::SimplexOptions<double> options;
+      options.dual_pricing = teensylp::DualPricingRule::dantzig;
+      options.primal_pricing = teensylp::PrimalPricingRule::dantzig;
+      auto reference = teensylp::solve_simplex(problem, options);
+      REQUIRE(reference.status == teensylp::LPStatus::optimal);
+      for (auto dual_rule : {teensylp::DualPricingRule::devex,
+                             teensylp::DualPricingRule::steepest_edge}) {
+        for (auto primal_rule : {teensylp::PrimalPricingRule::dantzig,
+                                 teensylp::PrimalPricingRule::devex}) {
+          for (size_t blocks : {size_t{1}, size_t{4}}) {
+            options.dual_pricing = dual_rule;
+            options.primal_pricing = primal_rule;
+            options.partial_pricing_blocks = blocks;
+            options.algorithm = blocks == 1
+                                    ? teensylp::SimplexAlgorithm::dual
+                                    : teensylp::SimplexAlgorithm::primal;
+            auto solution = teensylp::solve_simplex(problem, options);
+            REQUIRE(solution.status == teensylp::LPStatus::optimal);
+            REQUIRE(kkt_error(problem, solution) < 1e-6);
+            REQUIRE_THAT(solution.objective,
+                         Catch::Matchers::WithinRel(reference.objective, 1e-8));
+          }
+        }
+      }
+    }
+  }
+
+  SECTION("Dual steepest edge weights are the row norms of B^-1") {
+    // Records the basis after every update it sees
+    struct Recording : teensylp::DualSteepestEdgePricing<double> {
+      std::vector<size_t> basic;
+      void update(teensylp::PivotData<double> const &pivot) override {
+        teensylp::DualSteepestEdgePricing<double>::update(pivot);
+        this->basic = *pivot.basic;
+        this->basic[pivot.position] = pivot.entering;
+      }
+    };
+    size_t m = 40;
+    size_t n = 70;
+    auto problem = random_problem(m, n, 9);
+    teensylp::SimplexOptions<double> options;
+    options.scale = false;
+    options.max_iterations = 25;
+    teensylp::RevisedSimplex<double> solver{problem, options};
+    auto pricing = std::make_unique<Recording>();
+    Recording const *recording = pricing.get();
+    solver.set_dual_pricing(std::move(pricing));
+    auto solution = solver.solve();
+    REQUIRE(solution.status == teensylp::LPStatus::iteration_limit);
+    auto const &basic = recording->basic;
+    REQUIRE(basic.size() == m);
+    teensymat::Matrix<double> b{m, m};
+    for (size_t p = 0; p < m; p++) {
+      if (basic[p] >= n) {
+        *b(basic[p] - n, p) = -1.0;
+      } else {
+        for (size_t i = 0; i < m; i++) {
+          *b(i, p) = problem.constraints.coeff(i, basic[p]);
+        }
+      }
+    }
+    teensymat::LUFactorization<double> lu{b};
+    REQUIRE_FALSE(lu.is_singular());
+    auto const &weights = solver.get_dual_pricing().get_weights();
+    for (size_t p = 0; p < m; p++) {
+      std::vector<double> row(m, 0.0);
+      row[p] = 1.0;
+      lu.solve_transpose_inplace(row.data());
+      double norm = 0.0;
+      for (double value : row) {
+        norm += value * value;
+      }
+      REQUIRE_THAT(weights[p], Catch::Matchers::WithinRel(norm, 1e-8));
+    }
+  }
+
+  SECTION("Dual steepest edge weights after a warm start") {
+    // Records the weights of the first reset only
+    struct Recording : teensylp::DualSteepestEdgePricing<double> {
+      std::vector<double> initial;
+      explicit Recording(bool exact_reset)
+          : teensylp::DualSteepestEdgePricing<double>(exact_reset) {}
+      void reset(size_t nrows,
+                 std::vector<teensylp::BasisStatus> const &status,
+                 std::function<double(size_t)> const &row_norm) override {
+        teensylp::DualSteepestEdgePricing<double>::reset(nrows, status,
+                                                         row_norm);
+        if (this->initial.empty()) {
+          this->initial = this->weights;
+        }
+      }
+    };
+    size_t m = 40;
+    size_t n = 70;
+    auto problem = random_problem(m, n, 9);
+    teensylp::SimplexOptions<double> options;
+    options.scale = false;
+    auto first = teensylp::solve_simplex(problem, options);
+    REQUIRE(first.status == teensylp::LPStatus::optimal);
+    // Moving the equality rows leaves the basis dual but not primal
+    // feasible, so the dual simplex starts from it
+    for (size_t i = 0; i < m; i += 4) {
+      problem.row_lower[i] += 0.5;
+      problem.row_upper[i] += 0.5;
+    }
+    auto initial_weights = [&](bool exact_reset) {
+      teensylp::RevisedSimplex<double> solver{problem, options};
+      solver.set_basis(first.col_status, first.row_status);
+      auto pricing = std::make_unique<Recording>(exact_reset);
+      Recording const *recording = pricing.get();
+      solver.set_dual_pricing(std::move(pricing));
+      REQUIRE(solver.solve().status == teensylp::LPStatus::optimal);
+      return recording->initial;
+    };
+    // By default the warm start begins from unit reference weights
+    auto reference = initial_weights(false);
+    REQUIRE(reference == std::vector<double>(m, 1.0));
+    auto exact = initial_weights(true);
+    // Basis positions follow the variable order after set_basis
+    teensymat::Matrix<double> b{m, m};
+    size_t p = 0;
+    for (size_t var = 0; var < n + m; var++) {
+      auto status = var < n ? first.col_status[var] : first.row_status[var - n];
+      bool is_basic = status == teensylp::BasisStatus::basic;
+      if (!is_basic) {
+        continue;
+      }
+      if (var >= n) {
+        *b(var - n, p) = -1.0;
+      } else {
+        for (size_t i = 0; i < m; i++) {
+          *b(i, p) = problem.constraints.coeff(i, var);
+        }
+      }
+      p++;
+    }
+    REQUIRE(p == m);
+    teensymat::LUFactorization<double> lu{b};
+    REQUIRE(exact.size() == m);
+    size_t non_unit = 0;
+    for (size_t q = 0; q < m; q++) {
+      std::vector<double> row(m, 0.0);
+      row[q] = 1.0;
+      lu.solve_transpose_inplace(row.data());
+      double norm = 0.0;
+      for (double value : row) {
+        norm += value * value;
+      }
+      REQUIRE_THAT(exact[q], Catch::Matchers::WithinRel(norm, 1e-8));
+      non_unit += std::abs(norm - 1.0) > 1e-8;
+    }
+    REQUIRE(non_unit > 0);
+  }
+}
+
+TEST_CASE("Resolving after data changes", "[simplex]") {
+  auto problem = random_problem(200, 300, 4);
+  teensylp::RevisedSimplex<double> solver{problem};
+  auto first = solver.solve();
+  REQUIRE(first.status == teensylp::LPStatus::optimal);
+  std::mt19937 generator{7};
+  std::normal_distribution<double> normal{0.0, 1.0};
+  SECTION("Unchanged data") {
+    REQUIRE_FALSE(solver.update(problem).any());
+    auto again = solver.solve();
+    REQUIRE(again.status == teensylp::LPStatus::optimal);
+    REQUIRE(again.iterations == 0);
+    REQUIRE(again.objective == first.objective);
+  }
+  SECTION("Small cost change") {
+    auto changed = problem;
+    for (double &cost : changed.objective) {
+      cost *= 1.0 + 0.01 * normal(generator);
+    }
+    auto changes = solver.update(changed);
+    REQUIRE(changes.objective);
+    REQUIRE_FALSE(changes.bounds);
+    REQUIRE_FALSE(changes.values);
+    auto warm = solver.solve();
+    auto cold = teensylp::solve_simplex(changed);
+    REQUIRE(warm.status == teensylp::LPStatus::optimal);
+    REQUIRE(kkt_error(changed, warm) < 1e-6);
+    REQUIRE_THAT(warm.objective,
+                 Catch::Matchers::WithinRel(cold.objective, 1e-9));
+    REQUIRE(10 * warm.iterations < cold.iterations);
+  }
+  SECTION("Small bound change") {
+    auto changed = problem;
+    for (size_t i = 0; i < changed.get_nrows(); i++) {
+      double shift = 0.01 * normal(generator);
+      if (changed.row_lower[i] == changed.row_upper[i]) {
+        changed.row_lower[i] += shift;
+      }
+      changed.row_upper[i] += shift;
+    }
+    auto changes = solver.update(changed);
+    REQUIRE(changes.bounds);
+    REQUIRE_FALSE(changes.objective);
+    auto warm = solver.solve();
+    auto cold = teensylp::solve_simplex(changed);
+    REQUIRE(warm.status == teensylp::LPStatus::optimal);
+    REQUIRE(kkt_error(changed, warm) < 1e-6);
+    REQUIRE_THAT(warm.objective,
+                 Catch::Matchers::WithinRel(cold.objective, 1e-9));
+    REQUIRE(2 * warm.iterations < cold.iterations);
+  }
+  SECTION("New constraint values") {
+    auto changed = problem;
+    for (double &value : *changed.constraints.get_values()) {
+      value *= 1.0 + 0.01 * normal(generator);
+    }
+    auto changes = solver.update(changed);
+    REQUIRE(changes.values);
+    REQUIRE_FALSE(changes.pattern);
+    auto warm = solver.solve();
+    auto cold = teensylp::solve_simplex(changed);
+    REQUIRE(warm.status == teensylp::LPStatus::optimal);
+    REQUIRE(kkt_error(changed, warm) < 1e-6);
+    REQUIRE_THAT(warm.objective,
+                 Catch::Matchers::WithinRel(cold.objective, 1e-9));
+  }
+  SECTION("Different dimensions") {
+    REQUIRE_THROWS_AS(solver.update(random_problem(20, 30, 1)),
+                      std::range_error);
+  }
+}
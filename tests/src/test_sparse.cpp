@@ -0,0 +1,51 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyMat/sparse_core.hpp"
+
+TEST_CASE("SparseMatrix Construction", "[sparse_core]") {
+  SECTION("From triplets") {
+    // Duplicates are summed, order does not matter
+    auto test_matrix = teensymat::SparseMatrix<double>::from_triplets(
+        3, 2, {2, 0, 1, 0}, {1, 0, 1, 0}, {4.0, 1.0, 3.0, 1.0});
+    REQUIRE(test_matrix.get_nnz() == 3);
+    REQUIRE(test_matrix.coeff(0, 0) == 2.0);
+    REQUIRE(test_matrix.coeff(1, 1) == 3.0);
+    REQUIRE(test_matrix.coeff(2, 1) == 4.0);
+    REQUIRE(test_matrix.coeff(2, 0) == 0.0);
+  }
+  SECTION("Invalid CSC arrays") {
+    REQUIRE_THROWS_AS((teensymat::SparseMatrix<double>{2, 1, {0, 2}, {1, 0},
+                                                        {1.0, 2.0}}),
+                      std::range_error);
+  }
+  SECTION("Dense round trip") {
+    auto dense = teensymat::Matrix<double>{2, 3, {1, 0, 2, 0, 3, 0}};
+    auto sparse = teensymat::SparseMatrix<double>::from_dense(dense);
+    REQUIRE(sparse.get_nnz() == 3);
+    REQUIRE(teensymat::equals(sparse.to_dense(), dense));
+  }
+}
+
+TEST_CASE("SparseMatrix Operations", "[sparse_core]") {
+  auto dense = teensymat::Matrix<double>{2, 3, {1, 0, 2, 0, 3, 4}};
+  auto sparse = teensymat::SparseMatrix<double>::from_dense(dense);
+  SECTION("Transpose") {
+    auto transposed = sparse.transpose();
+    REQUIRE(transposed.get_nrows() == 3);
+    REQUIRE(transposed.get_ncols() == 2);
+    REQUIRE(teensymat::equals(transposed.to_dense(),
+                              teensymat::Matrix<double>{3, 2, {1, 0, 0, 3, 2, 4}}));
+  }
+  SECTION("Products") {
+    std::vector<double> product = sparse.multiply({1, 2, 3});
+    REQUIRE(product == std::vector<double>{7, 18});
+    std::vector<double> transpose_product = sparse.multiply_transpose({1, 2});
+    REQUIRE(transpose_product == std::vector<double>{1, 6, 10});
+  }
+}
@@ -0,0 +1,163 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyMat/sparse_ldlt.hpp"
+
+namespace {
+/*! Five point Laplacian (plus shift) on a k by k grid, full storage*/
+teensymat::SparseMatrix<double> grid_laplacian(size_t k, double shift) {
+  std::vector<size_t> rows, cols;
+  std::vector<double> vals;
+  auto add = [&](size_t i, size_t j, double v) {
+    rows.push_back(i);
+    cols.push_back(j);
+    vals.push_back(v);
+  };
+  for (size_t a = 0; a < k; a++) {
+    for (size_t b = 0; b < k; b++) {
+      size_t node = a * k + b;
+      add(node, node, 4.0 + shift);
+      if (a + 1 < k) {
+        add(node, node + k, -1.0);
+        add(node + k, node, -1.0);
+      }
+      if (b + 1 < k) {
+        add(node, node + 1, -1.0);
+        add(node + 1, node, -1.0);
+      }
+    }
+  }
+  return teensymat::SparseMatrix<double>::from_triplets(k * k, k * k, rows,
+                                                        cols, vals);
+}
+/*! Upper triangle of a sparse matrix*/
+teensymat::SparseMatrix<double>
+upper_triangle(teensymat::SparseMatrix<double> const &matrix) {
+  std::vector<size_t> rows, cols;
+  std::vector<double> vals;
+  for (size_t j = 0; j < matrix.get_ncols(); j++) {
+    for (size_t k = matrix.get_col_ptr()[j]; k < matrix.get_col_ptr()[j + 1];
+         k++) {
+      if (matrix.get_row_idx()[k] <= j) {
+        rows.push_back(matrix.get_row_idx()[k]);
+        cols.push_back(j);
+        vals.push_back((*matrix.get_values())[k]);
+      }
+    }
+  }
+  return teensymat::SparseMatrix<double>::from_triplets(
+      matrix.get_nrows(), matrix.get_ncols(), rows, cols, vals);
+}
+/*! Largest entry of A * x - b for a symmetric A in full storage*/
+double residual(teensymat::SparseMatrix<double> const &matrix,
+                std::vector<double> const &x, std::vector<double> const &b) {
+  auto product = matrix.multiply(x);
+  double largest = 0.0;
+  for (size_t i = 0; i < b.size(); i++) {
+    largest = std::max(largest, std::abs(product[i] - b[i]));
+  }
+  return largest;
+}
+} // namespace
+
+TEST_CASE("Sparse LDL^T factorization", "[sparse_ldlt]") {
+  size_t k = 12;
+  auto full = grid_laplacian(k, 0.0);
+  size_t n = full.get_nrows();
+  std::vector<double> b(n);
+  for (size_t i = 0; i < n; i++) {
+    b[i] = std::sin(static_cast<double>(i));
+  }
+
+  SECTION("Solves positive definite systems with either ordering") {
+    teensymat::SparseLDLT<double> natural{full, teensymat::Ordering::natural};
+    teensymat::SparseLDLT<double> ordered{full};
+    REQUIRE(residual(full, natural.solve(b), b) < 1e-10);
+    REQUIRE(residual(full, ordered.solve(b), b) < 1e-10);
+    // The band of the natural order fills in completely
+    REQUIRE(ordered.get_factor_nnz() < natural.get_factor_nnz());
+    REQUIRE(ordered.get_inertia().first == n);
+  }
+
+  SECTION("Only the upper triangle is read") {
+    teensymat::SparseLDLT<double> from_full{full};
+    teensymat::SparseLDLT<double> from_upper{upper_triangle(full)};
+    auto x_full = from_full.solve(b);
+    auto x_upper = from_upper.solve(b);
+    for (size_t i = 0; i < n; i++) {
+      REQUIRE_THAT(x_full[i], Catch::Matchers::WithinAbs(x_upper[i], 1e-12));
+    }
+  }
+
+  SECTION("Refactoring reuses the analysis") {
+    teensymat::SparseLDLT<double> ldlt{full};
+    auto parent = ldlt.get_parent();
+    auto shifted = grid_laplacian(k, 2.5);
+    ldlt.factorize(shifted);
+    REQUIRE(ldlt.get_parent() == parent);
+    REQUIRE(residual(shifted, ldlt.solve(b), b) < 1e-10);
+    teensymat::SparseMatrix<double> other = upper_triangle(full);
+    REQUIRE_THROWS_AS(ldlt.factorize(other), std::runtime_error);
+  }
+
+  SECTION("Quasi definite systems") {
+    // [I + diag, A^T; A, -delta I] with A a 1D difference operator
+    size_t nx = 30;
+    size_t ny = 20;
+    std::vector<size_t> rows, cols;
+    std::vector<double> vals;
+    for (size_t j = 0; j < nx; j++) {
+      rows.push_back(j);
+      cols.push_back(j);
+      vals.push_back(1.0 + 0.1 * static_cast<double>(j));
+    }
+    for (size_t i = 0; i < ny; i++) {
+      rows.push_back(i);
+      cols.push_back(nx + i);
+      vals.push_back(1.0);
+      rows.push_back(i + 5);
+      cols.push_back(nx + i);
+      vals.push_back(-2.0);
+      rows.push_back(nx + i);
+      cols.push_back(nx + i);
+      vals.push_back(-1e-8);
+    }
+    auto kkt = teensymat::SparseMatrix<double>::from_triplets(
+        nx + ny, nx + ny, rows, cols, vals);
+    teensymat::SparseLDLT<double> ldlt{kkt};
+    REQUIRE(ldlt.get_inertia() == std::pair<size_t, size_t>{nx, ny});
+    std::vector<double> rhs(nx + ny, 1.0);
+    auto x = ldlt.solve(rhs);
+    // Compare against the symmetric product computed from the upper part
+    auto transposed = kkt.transpose();
+    auto product = kkt.multiply(x);
+    auto product_t = transposed.multiply(x);
+    for (size_t i = 0; i < nx + ny; i++) {
+      double diag = kkt.coeff(i, i) * x[i];
+      REQUIRE_THAT(product[i] + product_t[i] - diag,
+                   Catch::Matchers::WithinAbs(rhs[i], 1e-8));
+    }
+  }
+
+  SECTION("Dynamic regularization of singular pivots") {
+    // A singular positive semidefinite matrix
+    auto singular = teensymat::SparseMatrix<double>::from_triplets(
+        3, 3, {0, 0, 1, 1, 2}, {0, 1, 0, 1, 2}, {1.0, 1.0, 1.0, 1.0, 2.0});
+    REQUIRE_THROWS_AS(teensymat::SparseLDLT<double>(
+                          singular, teensymat::Ordering::natural),
+                      std::runtime_error);
+    teensymat::SparseLDLT<double> ldlt;
+    ldlt.analyze(singular, teensymat::Ordering::natural);
+    ldlt.set_dynamic_regularization({1, 1, 1}, 1e-12, 1e-8);
+    ldlt.factorize(singular);
+    REQUIRE(ldlt.get_num_regularized() == 1);
+    REQUIRE(ldlt.get_inertia().first == 3);
+  }
+}
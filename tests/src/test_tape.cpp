@@ -0,0 +1,205 @@
+// External Includes
+#include "catch2/catch_test_macros.hpp"
+#include "catch2/matchers/catch_matchers_floating_point.hpp"
+
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+// Local Includes
+#include "TeensyOpt/TeensyMat/matrix_core.hpp"
+#include "TeensyOpt/TeensyMat/tape.hpp"
+#include "TeensyOpt/TeensyNLP/lbfgs.hpp"
+
+using teensymat::Matrix;
+using teensymat::Tape;
+using teensymat::TapeVariable;
+
+namespace {
+/*! A deterministic m x n test Matrix*/
+Matrix<double> filled(size_t m, size_t n, double shift) {
+  std::vector<double> data(m * n);
+  for (size_t k = 0; k < m * n; k++) {
+    data[k] = 0.5 + 0.3 * std::sin(double(k) + shift);
+  }
+  return Matrix<double>{m, n, data};
+}
+
+/*! Check the gradient of a recorded 1 x 1 output with respect to an input
+ * against central differences, replaying the tape for every step*/
+void check_gradient(Tape<double> &tape, TapeVariable<double> input,
+                    TapeVariable<double> output, double tolerance) {
+  tape.backward(output);
+  Matrix<double> gradient = tape.get_gradient(input);
+  Matrix<double> x = tape.get_value(input);
+  auto [m, n] = tape.get_shape(input);
+  double h = 1e-6;
+  for (size_t i = 0; i < m; i++) {
+    for (size_t j = 0; j < n; j++) {
+      double saved = *x(i, j);
+      *x(i, j) = saved + h;
+      tape.set_value(input, x);
+      tape.forward();
+      double up = tape.get_value_data(output)[0];
+      *x(i, j) = saved - h;
+      tape.set_value(input, x);
+      tape.forward();
+      double down = tape.get_value_data(output)[0];
+      *x(i, j) = saved;
+      REQUIRE_THAT(*gradient(i, j),
+                   Catch::Matchers::WithinAbs((up - down) / (2 * h),
+                                              tolerance));
+    }
+  }
+  tape.set_value(input, x);
+  tape.forward();
+}
+} // namespace
+
+TEST_CASE("Tape gradients", "[tape]") {
+  Tape<double> tape;
+  SECTION("Elementwise operations") {
+    auto x = tape.variable(filled(3, 2, 0.0));
+    auto y = tape.variable(filled(3, 2, 1.0));
+    auto f = sum(exp(x) * y - log(y) / sqrt(x) + tanh(x - y) +
+                 square(2.0 * x + 1.0) - (-y));
+    check_gradient(tape, x, f, 1e-7);
+    check_gradient(tape, y, f, 1e-7);
+  }
+  SECTION("Broadcasting a 1 x 1 node") {
+    auto x = tape.variable(filled(4, 3, 0.0));
+    auto s = tape.variable(Matrix<double>{1, 1, {1.5}});
+    auto f = sum(square(x - s) / s + s * x);
+    check_gradient(tape, x, f, 1e-7);
+    check_gradient(tape, s, f, 1e-6);
+  }
+  SECTION("Products, transposes and dot") {
+    auto a = tape.variable(filled(4, 3, 0.0));
+    auto b = tape.variable(filled(3, 5, 2.0));
+    auto c = tape.constant(filled(5, 4, 4.0));
+    auto product = matmul(a, b);
+    REQUIRE(tape.get_shape(product) == std::pair<size_t, size_t>{4, 5});
+    auto square_product = matmul(product, c);
+    auto f = dot(square_product, transpose(tanh(square_product)));
+    check_gradient(tape, a, f, 1e-7);
+    check_gradient(tape, b, f, 1e-7);
+  }
+  SECTION("Constants get no gradient propagated") {
+    auto x = tape.variable(filled(2, 2, 0.0));
+    auto c = tape.constant(filled(2, 2, 1.0));
+    auto f = sum(x * c);
+    tape.backward(f);
+    Matrix<double> c_value = tape.get_value(c);
+    Matrix<double> x_gradient = tape.get_gradient(x);
+    Matrix<double> c_gradient = tape.get_gradient(c);
+    for (size_t i = 0; i < 2; i++) {
+      for (size_t j = 0; j < 2; j++) {
+        REQUIRE(*x_gradient(i, j) == *c_value(i, j));
+        REQUIRE(*c_gradient(i, j) == 0);
+      }
+    }
+  }
+}
+
+TEST_CASE("Tape replay and reset", "[tape]") {
+  Tape<double> tape;
+  SECTION("Replay with new inputs") {
+    // f(x) = ||A x - b||^2, gradient 2 A^T (A x - b)
+    Matrix<double> a_value = filled(5, 3, 0.0);
+    auto a = tape.constant(a_value);
+    auto b = tape.constant(filled(5, 1, 1.0));
+    auto x = tape.variable(filled(3, 1, 2.0));
+    auto f = sum(square(matmul(a, x) - b));
+    size_t nodes = tape.get_num_nodes();
+    std::vector<double> z{1.0, -2.0, 0.5};
+    tape.set_value(x, z.data());
+    tape.forward();
+    tape.backward(f);
+    REQUIRE(tape.get_num_nodes() == nodes);
+    Matrix<double> b_value = tape.get_value(b);
+    std::vector<double> residual(5);
+    double value = 0;
+    for (size_t i = 0; i < 5; i++) {
+      residual[i] = -*b_value(i, 0);
+      for (size_t j = 0; j < 3; j++) {
+        residual[i] += *a_value(i, j) * z[j];
+      }
+      value += residual[i] * residual[i];
+    }
+    REQUIRE_THAT(tape.get_value_data(f)[0],
+                 Catch::Matchers::WithinAbs(value, 1e-14));
+    double const *gradient = tape.get_gradient_data(x);
+    for (size_t j = 0; j < 3; j++) {
+      double expected = 0;
+      for (size_t i = 0; i < 5; i++) {
+        expected += 2 * *a_value(i, j) * residual[i];
+      }
+      REQUIRE_THAT(gradient[j], Catch::Matchers::WithinAbs(expected, 1e-13));
+    }
+  }
+  SECTION("Reset keeps working") {
+    for (size_t pass = 0; pass < 3; pass++) {
+      tape.reset();
+      REQUIRE(tape.get_num_nodes() == 0);
+      auto x = tape.variable(filled(2, 3, double(pass)));
+      auto f = sum(square(x));
+      REQUIRE(tape.get_arena_size() == 2 * 2 * 3 + 1);
+      tape.backward(f);
+      Matrix<double> x_value = tape.get_value(x);
+      Matrix<double> gradient = tape.get_gradient(x);
+      REQUIRE(*gradient(1, 2) == 2 * *x_value(1, 2));
+    }
+  }
+  SECTION("Errors") {
+    Tape<double> other;
+    auto x = tape.variable(filled(2, 3, 0.0));
+    auto y = tape.variable(filled(3, 2, 0.0));
+    auto z = other.variable(filled(2, 3, 0.0));
+    REQUIRE_THROWS_AS(x + y, std::runtime_error);
+    REQUIRE_THROWS_AS(matmul(x, x), std::runtime_error);
+    REQUIRE_THROWS_AS(x + z, std::runtime_error);
+    REQUIRE_THROWS_AS(tape.backward(x), std::range_error);
+    REQUIRE_THROWS_AS(tape.get_gradient(x), std::runtime_error);
+    REQUIRE_THROWS_AS(tape.set_value(exp(x), filled(2, 3, 0.0)),
+                      std::runtime_error);
+    REQUIRE_THROWS_AS(tape.set_value(x, filled(3, 2, 0.0)),
+                      std::runtime_error);
+  }
+}
+
+TEST_CASE("Tape objective for LBFGS", "[tape]") {
+  // Logistic regression on a fixed data set: the tape is recorded once
+  // and replayed at every evaluation
+  size_t m = 40;
+  size_t n = 3;
+  Matrix<double> features = filled(m, n, 0.0);
+  Matrix<double> labels{m, 1};
+  for (size_t i = 0; i < m; i++) {
+    *labels(i, 0) = *features(i, 0) > *features(i, 1) ? 1.0 : 0.0;
+  }
+  Tape<double> tape;
+  auto a = tape.constant(features);
+  auto y = tape.constant(labels);
+  auto w = tape.variable(Matrix<double>{n, 1});
+  // log(1 + exp(z)) - y z, plus a ridge term keeping the minimum finite
+  auto z = matmul(a, w);
+  auto loss = sum(log(exp(z) + 1.0) - y * z) + 0.01 * dot(w, w);
+  size_t nodes = tape.get_num_nodes();
+  teensynlp::Objective<double> objective = [&](double const *x,
+                                               double *gradient) {
+    tape.set_value(w, x);
+    tape.forward();
+    tape.backward(loss);
+    double const *g = tape.get_gradient_data(w);
+    std::copy(g, g + n, gradient);
+    return tape.get_value_data(loss)[0];
+  };
+  std::vector<double> x(n, 0.0);
+  auto solution = teensynlp::minimize_lbfgs(objective, x);
+  REQUIRE(solution.status == teensynlp::NLPStatus::converged);
+  REQUIRE(tape.get_num_nodes() == nodes);
+  REQUIRE(x[0] > 0);
+  REQUIRE(x[1] < 0);
+}